@@ -1,5 +1,6 @@
 #pragma once
 #include <cstdint>
+#include <cstring>
 #include <softfloat.hpp>
 
 extern "C" {
@@ -12,3 +13,84 @@ extern "C" {
    double ___floattidf(__int128);
    double ___floatuntidf(unsigned __int128);
 }
+
+#ifndef EOSIO_PORTABLE_BUILTINS
+#define EOSIO_NATIVE_BUILTINS 1
+#endif
+
+/**
+ * Native versions of the conversions above, for the inputs where a 64 bit cast gives exactly the result of the portable
+ * implementation: truncating a float or double less than 2^63 in magnitude, and converting an integer less than 2^53 in
+ * magnitude, which is exact and so does not depend on the rounding mode.  Everything else, including NaN and saturation,
+ * is left to the portable implementation.  Define EOSIO_PORTABLE_BUILTINS to always use it.
+ */
+namespace eosio { namespace builtins {
+
+   inline __int128 make_int128( uint64_t low, uint64_t high ) {
+      return static_cast<__int128>( ( static_cast<unsigned __int128>( high ) << 64 ) | low );
+   }
+
+   inline unsigned __int128 make_uint128( uint64_t low, uint64_t high ) {
+      return ( static_cast<unsigned __int128>( high ) << 64 ) | low;
+   }
+
+#ifdef EOSIO_NATIVE_BUILTINS
+   inline __int128 fixdfti( uint64_t a ) {
+      double d;
+      memcpy( &d, &a, sizeof(d) );
+      if( d > -0x1p63 && d < 0x1p63 )
+         return static_cast<int64_t>( d );
+      return ___fixdfti( a );
+   }
+
+   inline __int128 fixsfti( uint32_t a ) {
+      float f;
+      memcpy( &f, &a, sizeof(f) );
+      if( f > -0x1p63f && f < 0x1p63f )
+         return static_cast<int64_t>( f );
+      return ___fixsfti( a );
+   }
+
+   inline unsigned __int128 fixunsdfti( uint64_t a ) {
+      double d;
+      memcpy( &d, &a, sizeof(d) );
+      // negative values, -inf included, are 0 in the portable version
+      if( d < 0x1p63 )
+         return d > 0 ? static_cast<int64_t>( d ) : 0;
+      return ___fixunsdfti( a );
+   }
+
+   inline unsigned __int128 fixunssfti( uint32_t a ) {
+      float f;
+      memcpy( &f, &a, sizeof(f) );
+      if( f < 0x1p63f )
+         return f > 0 ? static_cast<int64_t>( f ) : 0;
+      return ___fixunssfti( a );
+   }
+
+   inline double floattidf( __int128 a ) {
+      constexpr __int128 exact = __int128(1) << 53;
+      if( a > -exact && a < exact )
+         return static_cast<double>( static_cast<int64_t>( a ) );
+      return ___floattidf( a );
+   }
+
+   inline double floatuntidf( unsigned __int128 a ) {
+      if( a < ( static_cast<unsigned __int128>(1) << 53 ) )
+         return static_cast<double>( static_cast<int64_t>( a ) );
+      return ___floatuntidf( a );
+   }
+#else
+   inline __int128 fixdfti( uint64_t a )                 { return ___fixdfti( a ); }
+   inline __int128 fixsfti( uint32_t a )                 { return ___fixsfti( a ); }
+   inline unsigned __int128 fixunsdfti( uint64_t a )     { return ___fixunsdfti( a ); }
+   inline unsigned __int128 fixunssfti( uint32_t a )     { return ___fixunssfti( a ); }
+   inline double floattidf( __int128 a )                 { return ___floattidf( a ); }
+   inline double floatuntidf( unsigned __int128 a )      { return ___floatuntidf( a ); }
+#endif
+
+   /// shifts of 128 or more give 0, as the fc::uint128_t based versions did
+   inline unsigned __int128 shl( unsigned __int128 a, uint32_t shift ) { return shift < 128 ? a << shift : 0; }
+   inline unsigned __int128 lshr( unsigned __int128 a, uint32_t shift ) { return shift < 128 ? a >> shift : 0; }
+
+} } // namespace eosio::builtins
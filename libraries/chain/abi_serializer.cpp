@@ -4,9 +4,13 @@
 #include <eosio/chain/asset.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <fc/io/raw.hpp>
+#include <fc/io/json.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <fc/io/varint.hpp>
 
+#include <deque>
+#include <set>
+
 using namespace boost;
 
 
@@ -73,6 +77,334 @@ namespace eosio { namespace chain {
       );
    }
 
+   namespace impl {
+      /**
+       *  Decode plan of one type of an ABI. The type names _binary_to_variant resolves through typedefs, structs and
+       *  variants for every value are resolved once, when the ABI is set, into a graph of these nodes. The same graph is
+       *  the encode plan _variant_to_binary follows.
+       */
+      struct decode_node {
+         enum class kind_type { built_in, array, optional, variant, structure };
+
+         struct field {
+            string             name;
+            const decode_node* type      = nullptr;
+            bool               extension = false;
+            string             json_key;  ///< quoted name and ':'
+         };
+
+         struct alternative {
+            type_name          name;
+            const decode_node* type = nullptr;
+            string             json_name; ///< quoted name
+         };
+
+         kind_type                       kind = kind_type::built_in;
+         abi_serializer::unpack_function unpack;                  ///< built_in
+         abi_serializer::pack_function   pack;                    ///< built_in
+         bool                            unpack_array    = false; ///< built_in
+         bool                            unpack_optional = false; ///< built_in
+         const decode_node*              element = nullptr;       ///< array, optional
+         vector<alternative>             alternatives;            ///< variant
+         const decode_node*              base = nullptr;          ///< structure
+         vector<field>                   fields;                  ///< structure
+         bool                            repeated_names = false;  ///< structure, a field name is also used by a base
+      };
+
+      /**
+       *  Decode plans of every type an ABI refers to. They only follow the path of a successful conversion, and check
+       *  recursion depth and deadline at least as strictly as _binary_to_variant; any failure is redone step by step
+       *  for its detailed error. The plans do not refer to the abi_serializer, so its copies share them.
+       */
+      struct decode_plans {
+         std::deque<decode_node>                         nodes;
+         map<type_name, const decode_node*, std::less<>> by_type;
+
+         const decode_node* find( const std::string_view& type )const {
+            auto itr = by_type.find( type );
+            return itr != by_type.end() ? itr->second : nullptr;
+         }
+
+         static void enter( size_t& depth, const fc::time_point& deadline ) {
+            EOS_ASSERT( ++depth < abi_serializer::max_recursion_depth, abi_recursion_depth_exception, "recursive definition" );
+            EOS_ASSERT( fc::time_point::now() < deadline, abi_serialization_deadline_exception, "serialization time limit exceeded" );
+         }
+
+         static void decode_fields( const decode_node& st, fc::datastream<const char*>& stream, fc::mutable_variant_object& obj,
+                                    size_t depth, const fc::time_point& deadline ) {
+            enter( depth, deadline );
+            if( st.base ) {
+               decode_fields( *st.base, stream, obj, depth, deadline );
+            }
+            for( const auto& field : st.fields ) {
+               if( !stream.remaining() ) {
+                  EOS_ASSERT( field.extension, unpack_exception, "stream unexpectedly ended" );
+                  continue;
+               }
+               obj( field.name, decode( *field.type, stream, depth, deadline ) );
+            }
+         }
+
+         /// @return number of fields written to @ref out
+         static size_t write_fields( const decode_node& st, fc::datastream<const char*>& stream, string& out, size_t written,
+                                     size_t depth, const fc::time_point& deadline ) {
+            enter( depth, deadline );
+            // a variant object keeps the last value of a repeated name, which is not worth reproducing here
+            EOS_ASSERT( !st.repeated_names, unpack_exception, "repeated field name" );
+            if( st.base ) {
+               written = write_fields( *st.base, stream, out, written, depth, deadline );
+            }
+            for( const auto& field : st.fields ) {
+               if( !stream.remaining() ) {
+                  EOS_ASSERT( field.extension, unpack_exception, "stream unexpectedly ended" );
+                  continue;
+               }
+               if( written++ ) out += ',';
+               out += field.json_key;
+               write_json( *field.type, stream, out, depth, deadline );
+            }
+            return written;
+         }
+
+         /// appends what fc::json::to_string of @ref decode would produce
+         static void write_json( const decode_node& n, fc::datastream<const char*>& stream, string& out, size_t depth, const fc::time_point& deadline ) {
+            using kind_type = decode_node::kind_type;
+            if( n.kind == kind_type::built_in ) {
+               EOS_ASSERT( ++depth < abi_serializer::max_recursion_depth, abi_recursion_depth_exception, "recursive definition" );
+               out += fc::json::to_string( n.unpack( stream, n.unpack_array, n.unpack_optional, deadline ), deadline );
+               return;
+            }
+            enter( depth, deadline );
+            switch( n.kind ) {
+               case kind_type::array: {
+                  fc::unsigned_int size;
+                  fc::raw::unpack( stream, size );
+                  out += '[';
+                  for( decltype(size.value) i = 0; i < size; ++i ) {
+                     if( i ) out += ',';
+                     const auto start = out.size();
+                     write_json( *n.element, stream, out, depth, deadline );
+                     EOS_ASSERT( out.compare( start, string::npos, "null" ) != 0, unpack_exception, "invalid packed array" );
+                  }
+                  out += ']';
+                  return;
+               }
+               case kind_type::optional: {
+                  char flag;
+                  fc::raw::unpack( stream, flag );
+                  if( flag ) write_json( *n.element, stream, out, depth, deadline );
+                  else out += "null";
+                  return;
+               }
+               case kind_type::variant: {
+                  fc::unsigned_int select;
+                  fc::raw::unpack( stream, select );
+                  EOS_ASSERT( (size_t)select < n.alternatives.size(), unpack_exception, "invalid variant tag" );
+                  const auto& alt = n.alternatives[select];
+                  out += '[';
+                  out += alt.json_name;
+                  out += ',';
+                  write_json( *alt.type, stream, out, depth, deadline );
+                  out += ']';
+                  return;
+               }
+               default: {
+                  out += '{';
+                  EOS_ASSERT( write_fields( n, stream, out, 0, depth, deadline ) > 0, unpack_exception, "empty struct" );
+                  out += '}';
+                  return;
+               }
+            }
+         }
+
+         static void write_value_fields( const decode_node& st, fc::datastream<const char*>& stream, abi_serializer::value_writer& out,
+                                         size_t& written, size_t depth, const fc::time_point& deadline ) {
+            enter( depth, deadline );
+            EOS_ASSERT( !st.repeated_names, unpack_exception, "repeated field name" );
+            if( st.base ) {
+               write_value_fields( *st.base, stream, out, written, depth, deadline );
+            }
+            for( const auto& field : st.fields ) {
+               if( !stream.remaining() ) {
+                  EOS_ASSERT( field.extension, unpack_exception, "stream unexpectedly ended" );
+                  continue;
+               }
+               ++written;
+               out.key( field.name );
+               write_value( *field.type, stream, out, depth, deadline );
+            }
+         }
+
+         /// passes what @ref decode would return to @ref out
+         /// @return true if the value written is null
+         static bool write_value( const decode_node& n, fc::datastream<const char*>& stream, abi_serializer::value_writer& out,
+                                  size_t depth, const fc::time_point& deadline ) {
+            using kind_type = decode_node::kind_type;
+            if( n.kind == kind_type::built_in ) {
+               EOS_ASSERT( ++depth < abi_serializer::max_recursion_depth, abi_recursion_depth_exception, "recursive definition" );
+               auto v = n.unpack( stream, n.unpack_array, n.unpack_optional, deadline );
+               out.value( v );
+               return v.is_null();
+            }
+            enter( depth, deadline );
+            switch( n.kind ) {
+               case kind_type::array: {
+                  fc::unsigned_int size;
+                  fc::raw::unpack( stream, size );
+                  out.start_array();
+                  for( decltype(size.value) i = 0; i < size; ++i ) {
+                     EOS_ASSERT( !write_value( *n.element, stream, out, depth, deadline ), unpack_exception, "invalid packed array" );
+                  }
+                  out.end_array();
+                  return false;
+               }
+               case kind_type::optional: {
+                  char flag;
+                  fc::raw::unpack( stream, flag );
+                  if( flag ) return write_value( *n.element, stream, out, depth, deadline );
+                  out.value( fc::variant() );
+                  return true;
+               }
+               case kind_type::variant: {
+                  fc::unsigned_int select;
+                  fc::raw::unpack( stream, select );
+                  EOS_ASSERT( (size_t)select < n.alternatives.size(), unpack_exception, "invalid variant tag" );
+                  const auto& alt = n.alternatives[select];
+                  out.start_array();
+                  out.value( fc::variant( alt.name ) );
+                  write_value( *alt.type, stream, out, depth, deadline );
+                  out.end_array();
+                  return false;
+               }
+               default: {
+                  size_t written = 0;
+                  out.start_object();
+                  write_value_fields( n, stream, out, written, depth, deadline );
+                  EOS_ASSERT( written > 0, unpack_exception, "empty struct" );
+                  out.end_object();
+                  return false;
+               }
+            }
+         }
+
+         static fc::variant decode( const decode_node& n, fc::datastream<const char*>& stream, size_t depth, const fc::time_point& deadline ) {
+            using kind_type = decode_node::kind_type;
+            if( n.kind == kind_type::built_in ) {
+               EOS_ASSERT( ++depth < abi_serializer::max_recursion_depth, abi_recursion_depth_exception, "recursive definition" );
+               return n.unpack( stream, n.unpack_array, n.unpack_optional, deadline );
+            }
+            enter( depth, deadline );
+            switch( n.kind ) {
+               case kind_type::array: {
+                  fc::unsigned_int size;
+                  fc::raw::unpack( stream, size );
+                  vector<fc::variant> vars;
+                  vars.reserve( std::min<size_t>( size.value, stream.remaining() ) );
+                  for( decltype(size.value) i = 0; i < size; ++i ) {
+                     auto v = decode( *n.element, stream, depth, deadline );
+                     EOS_ASSERT( !v.is_null(), unpack_exception, "invalid packed array" );
+                     vars.emplace_back( std::move(v) );
+                  }
+                  return fc::variant( std::move(vars) );
+               }
+               case kind_type::optional: {
+                  char flag;
+                  fc::raw::unpack( stream, flag );
+                  return flag ? decode( *n.element, stream, depth, deadline ) : fc::variant();
+               }
+               case kind_type::variant: {
+                  fc::unsigned_int select;
+                  fc::raw::unpack( stream, select );
+                  EOS_ASSERT( (size_t)select < n.alternatives.size(), unpack_exception, "invalid variant tag" );
+                  const auto& alt = n.alternatives[select];
+                  return vector<fc::variant>{ alt.name, decode( *alt.type, stream, depth, deadline ) };
+               }
+               default: {
+                  fc::mutable_variant_object mvo;
+                  decode_fields( n, stream, mvo, depth, deadline );
+                  EOS_ASSERT( mvo.size() > 0, unpack_exception, "empty struct" );
+                  return fc::variant( std::move(mvo) );
+               }
+            }
+         }
+
+         static void encode_fields( const decode_node& st, const fc::variant_object& vo, fc::datastream<char*>& ds,
+                                    bool allow_extensions, size_t depth, const fc::time_point& deadline ) {
+            enter( depth, deadline );
+            if( st.base ) {
+               encode_fields( *st.base, vo, ds, false, depth, deadline );
+            }
+            bool disallow_additional_fields = false;
+            for( const auto& field : st.fields ) {
+               auto itr = vo.find( field.name );
+               if( itr != vo.end() ) {
+                  EOS_ASSERT( !disallow_additional_fields, pack_exception, "unexpected field" );
+                  encode( *field.type, itr->value(), ds, allow_extensions && &field == &st.fields.back(), depth, deadline );
+               } else {
+                  EOS_ASSERT( field.extension && allow_extensions, pack_exception, "missing field" );
+                  disallow_additional_fields = true;
+               }
+            }
+         }
+
+         /// writes what _variant_to_binary would, any failure is redone step by step for its detailed error
+         static void encode( const decode_node& n, const fc::variant& var, fc::datastream<char*>& ds,
+                             bool allow_extensions, size_t depth, const fc::time_point& deadline ) {
+            using kind_type = decode_node::kind_type;
+            if( n.kind == kind_type::built_in ) {
+               EOS_ASSERT( ++depth < abi_serializer::max_recursion_depth, abi_recursion_depth_exception, "recursive definition" );
+               n.pack( var, ds, n.unpack_array, n.unpack_optional, deadline );
+               return;
+            }
+            enter( depth, deadline );
+            switch( n.kind ) {
+               case kind_type::array: {
+                  const auto& vars = var.get_array();
+                  fc::raw::pack( ds, (fc::unsigned_int)vars.size() );
+                  for( const auto& v : vars ) {
+                     encode( *n.element, v, ds, false, depth, deadline );
+                  }
+                  return;
+               }
+               case kind_type::optional: {
+                  char flag = !var.is_null();
+                  fc::raw::pack( ds, flag );
+                  if( flag ) encode( *n.element, var, ds, allow_extensions, depth, deadline );
+                  return;
+               }
+               case kind_type::variant: {
+                  EOS_ASSERT( var.is_array() && var.size() == 2 && var[size_t(0)].is_string(), pack_exception, "invalid variant" );
+                  const auto& name = var[size_t(0)].get_string();
+                  auto alt = std::find_if( n.alternatives.begin(), n.alternatives.end(), [&]( const auto& a ) { return a.name == name; } );
+                  EOS_ASSERT( alt != n.alternatives.end(), pack_exception, "invalid variant type" );
+                  fc::raw::pack( ds, fc::unsigned_int( alt - n.alternatives.begin() ) );
+                  encode( *alt->type, var[size_t(1)], ds, allow_extensions, depth, deadline );
+                  return;
+               }
+               default: {
+                  if( var.is_object() ) {
+                     encode_fields( n, var.get_object(), ds, allow_extensions, depth, deadline );
+                     return;
+                  }
+                  EOS_ASSERT( var.is_array() && !n.base, pack_exception, "invalid struct" );
+                  const auto& va = var.get_array();
+                  for( size_t i = 0; i < n.fields.size(); ++i ) {
+                     const auto& field = n.fields[i];
+                     const bool last = i + 1 == n.fields.size();
+                     if( i < va.size() ) {
+                        encode( *field.type, va[i], ds, allow_extensions && last, depth, deadline );
+                     } else {
+                        EOS_ASSERT( field.extension && allow_extensions, pack_exception, "missing field" );
+                        break;
+                     }
+                  }
+                  return;
+               }
+            }
+         }
+      };
+   }
+
    abi_serializer::abi_serializer( const abi_def& abi, const fc::microseconds& max_serialization_time ) {
       configure_built_in_types();
       set_abi(abi, max_serialization_time);
@@ -81,6 +413,7 @@ namespace eosio { namespace chain {
    void abi_serializer::add_specialized_unpack_pack( const string& name,
                                                      std::pair<abi_serializer::unpack_function, abi_serializer::pack_function> unpack_pack ) {
       built_in_types[name] = std::move( unpack_pack );
+      if( decode_plans ) build_decode_plans();
    }
 
    void abi_serializer::configure_built_in_types() {
@@ -171,6 +504,114 @@ namespace eosio { namespace chain {
       EOS_ASSERT( variants.size() == abi.variants.value.size(), duplicate_abi_variant_def_exception, "duplicate variant definition detected" );
 
       validate(ctx);
+      build_decode_plans();
+   }
+
+   void abi_serializer::build_decode_plans() {
+      using kind_type = impl::decode_node::kind_type;
+      auto plans = std::make_shared<impl::decode_plans>();
+      map<type_name, impl::decode_node*, std::less<>> struct_nodes;
+
+      // mirrors the lookups of _binary_to_variant, nodes are registered before their children for recursive types
+      std::function<const impl::decode_node*(const std::string_view&)> value_node;
+      std::function<const impl::decode_node*(const std::string_view&)> struct_node = [&]( const std::string_view& rtype ) {
+         auto itr = struct_nodes.find( rtype );
+         if( itr != struct_nodes.end() ) return static_cast<const impl::decode_node*>( itr->second );
+         const auto& st = get_struct( rtype );
+         auto& n = plans->nodes.emplace_back();
+         n.kind = kind_type::structure;
+         struct_nodes.emplace( type_name( rtype ), &n );
+         if( st.base != type_name() ) {
+            n.base = struct_node( resolve_type( st.base ) );
+         }
+         std::set<std::string_view> names;
+         for( const auto* b = n.base; b; b = b->base ) {
+            for( const auto& f : b->fields ) names.insert( f.name );
+         }
+         for( const auto& f : st.fields ) {
+            bool extension = ends_with( f.type, "$" );
+            n.repeated_names |= !names.insert( f.name ).second;
+            n.fields.push_back( { f.name, value_node( resolve_type( extension ? _remove_bin_extension( f.type ) : f.type ) ), extension,
+                                  fc::json::to_string( fc::variant( f.name ), fc::time_point::maximum() ) + ':' } );
+         }
+         return static_cast<const impl::decode_node*>( &n );
+      };
+      value_node = [&]( const std::string_view& type ) {
+         if( auto found = plans->find( type ) ) return found;
+         auto rtype = resolve_type( type );
+         auto ftype = fundamental_type( rtype );
+         auto btype = built_in_types.find( ftype );
+         const impl::decode_node* result = nullptr;
+         if( btype != built_in_types.end() ) {
+            auto& n = plans->nodes.emplace_back();
+            n.unpack = btype->second.first;
+            n.pack = btype->second.second;
+            n.unpack_array = is_array( rtype );
+            n.unpack_optional = is_optional( rtype );
+            result = &n;
+            plans->by_type.emplace( type_name( type ), result );
+         } else if( is_array( rtype ) || is_optional( rtype ) ) {
+            auto& n = plans->nodes.emplace_back();
+            n.kind = is_array( rtype ) ? kind_type::array : kind_type::optional;
+            result = &n;
+            plans->by_type.emplace( type_name( type ), result );
+            n.element = value_node( ftype );
+         } else if( auto v_itr = variants.find( rtype ); v_itr != variants.end() ) {
+            auto& n = plans->nodes.emplace_back();
+            n.kind = kind_type::variant;
+            result = &n;
+            plans->by_type.emplace( type_name( type ), result );
+            for( const auto& t : v_itr->second.types ) {
+               n.alternatives.push_back( { t, value_node( t ), fc::json::to_string( fc::variant( t ), fc::time_point::maximum() ) } );
+            }
+         } else {
+            result = struct_node( rtype );
+            plans->by_type.emplace( type_name( type ), result );
+         }
+         return result;
+      };
+
+      try {
+         for( const auto& st : structs ) value_node( st.first );
+         for( const auto& v : variants ) value_node( v.first );
+         for( const auto& td : typedefs ) value_node( td.first );
+         decode_plans = std::move( plans );
+      } catch( ... ) {
+         // not expected for a validated ABI, conversions then all go step by step
+         decode_plans.reset();
+      }
+   }
+
+   bool abi_serializer::_binary_to_variant_with_plan( const std::string_view& type, fc::datastream<const char*>& stream,
+                                                      impl::binary_to_variant_context& ctx, fc::variant& result )const
+   {
+      if( !decode_plans ) return false;
+      const auto* n = decode_plans->find( type );
+      if( !n ) return false;
+      auto ds = stream;
+      try {
+         result = impl::decode_plans::decode( *n, ds, ctx.get_recursion_depth(), ctx.get_deadline() );
+      } catch( ... ) {
+         return false;
+      }
+      stream = ds;
+      return true;
+   }
+
+   bool abi_serializer::_variant_to_binary_with_plan( const std::string_view& type, const fc::variant& var, fc::datastream<char*>& ds,
+                                                      impl::variant_to_binary_context& ctx )const
+   {
+      if( !decode_plans ) return false;
+      const auto* n = decode_plans->find( type );
+      if( !n ) return false;
+      auto out = ds;
+      try {
+         impl::decode_plans::encode( *n, var, out, ctx.extensions_allowed(), ctx.get_recursion_depth(), ctx.get_deadline() );
+      } catch( ... ) {
+         return false;
+      }
+      ds = out;
+      return true;
    }
 
    bool abi_serializer::is_builtin_type(const std::string_view& type)const {
@@ -405,6 +846,8 @@ namespace eosio { namespace chain {
    {
       auto h = ctx.enter_scope();
       fc::datastream<const char*> ds( binary.data(), binary.size() );
+      fc::variant result;
+      if( _binary_to_variant_with_plan(type, ds, ctx, result) ) return result;
       return _binary_to_variant(type, ds, ctx);
    }
 
@@ -414,9 +857,46 @@ namespace eosio { namespace chain {
       return _binary_to_variant(type, binary, ctx);
    }
 
+   void abi_serializer::binary_to_json( const std::string_view& type, const bytes& binary, string& out,
+                                        const fc::microseconds& max_serialization_time, bool short_path )const {
+      impl::binary_to_variant_context ctx(*this, max_serialization_time, type);
+      ctx.short_path = short_path;
+      if( decode_plans ) {
+         if( const auto* n = decode_plans->find( type ) ) {
+            const auto start = out.size();
+            try {
+               fc::datastream<const char*> ds( binary.data(), binary.size() );
+               impl::decode_plans::write_json( *n, ds, out, ctx.get_recursion_depth() + 1, ctx.get_deadline() );
+               return;
+            } catch( ... ) {
+               out.resize( start );
+            }
+         }
+      }
+      // step by step, so failures have their detailed error
+      out += fc::json::to_string( _binary_to_variant(type, binary, ctx), ctx.get_deadline() );
+   }
+
+   bool abi_serializer::binary_to_writer( const std::string_view& type, const bytes& binary, value_writer& writer,
+                                          const fc::microseconds& max_serialization_time )const {
+      if( !decode_plans ) return false;
+      const auto* n = decode_plans->find( type );
+      if( !n ) return false;
+      impl::binary_to_variant_context ctx(*this, max_serialization_time, type);
+      try {
+         fc::datastream<const char*> ds( binary.data(), binary.size() );
+         impl::decode_plans::write_value( *n, ds, writer, ctx.get_recursion_depth() + 1, ctx.get_deadline() );
+         return true;
+      } catch( ... ) {
+         return false;
+      }
+   }
+
    fc::variant abi_serializer::binary_to_variant( const std::string_view& type, fc::datastream<const char*>& binary, const fc::microseconds& max_serialization_time, bool short_path )const {
       impl::binary_to_variant_context ctx(*this, max_serialization_time, type);
       ctx.short_path = short_path;
+      fc::variant result;
+      if( _binary_to_variant_with_plan(type, binary, ctx, result) ) return result;
       return _binary_to_variant(type, binary, ctx);
    }
 
@@ -534,7 +1014,8 @@ namespace eosio { namespace chain {
 
       bytes temp( 1024*1024 );
       fc::datastream<char*> ds(temp.data(), temp.size() );
-      _variant_to_binary(type, var, ds, ctx);
+      if( !_variant_to_binary_with_plan(type, var, ds, ctx) )
+         _variant_to_binary(type, var, ds, ctx);
       temp.resize(ds.tellp());
       return temp;
    } FC_CAPTURE_AND_RETHROW() }
@@ -548,6 +1029,7 @@ namespace eosio { namespace chain {
    void  abi_serializer::variant_to_binary( const std::string_view& type, const fc::variant& var, fc::datastream<char*>& ds, const fc::microseconds& max_serialization_time, bool short_path )const {
       impl::variant_to_binary_context ctx(*this, max_serialization_time, type);
       ctx.short_path = short_path;
+      if( _variant_to_binary_with_plan(type, var, ds, ctx) ) return;
       _variant_to_binary(type, var, ds, ctx);
    }
 
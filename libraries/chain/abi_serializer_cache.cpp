@@ -0,0 +1,141 @@
+#include <eosio/chain/abi_serializer_cache.hpp>
+#include <eosio/chain/account_object.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/member.hpp>
+
+#include <cstring>
+#include <mutex>
+
+namespace eosio { namespace chain {
+
+namespace {
+   using namespace boost::multi_index;
+
+   struct cache_entry {
+      account_name                         account;
+      uint64_t                             abi_sequence = 0;
+      std::string                          packed_abi;
+      abi_serializer_cache::cached_abi_ptr abi;
+
+      bool matches( const shared_blob& current )const {
+         return packed_abi.size() == current.size() && std::memcmp( packed_abi.data(), current.data(), current.size() ) == 0;
+      }
+   };
+
+   struct by_account;
+
+   typedef multi_index_container<
+      cache_entry,
+      indexed_by<
+         sequenced<>,
+         ordered_unique<tag<by_account>,
+            composite_key< cache_entry,
+               member<cache_entry, account_name, &cache_entry::account>,
+               member<cache_entry, uint64_t,     &cache_entry::abi_sequence>
+            >
+         >
+      >
+   > abi_cache_type;
+
+   struct abi_cache {
+      std::mutex                  mtx;
+      abi_cache_type              entries;
+      size_t                      capacity = abi_serializer_cache::default_capacity;
+      abi_serializer_cache::stats counts;
+
+      // callers hold mtx
+      void trim() {
+         while( entries.size() > capacity ) {
+            entries.pop_back();
+            ++counts.evictions;
+         }
+      }
+   };
+
+   abi_cache& cache() {
+      static abi_cache c;
+      return c;
+   }
+}
+
+abi_serializer_cache::cached_abi::cached_abi( abi_def def, const fc::microseconds& max_serialization_time )
+: abi( std::move( def ) )
+, serializer( abi, max_serialization_time )
+{}
+
+abi_serializer_cache::cached_abi_ptr
+abi_serializer_cache::get( const chainbase::database& db, account_name n, const fc::microseconds& max_serialization_time ) {
+   const auto* accnt = db.find<account_object, by_name>( n );
+   if( accnt == nullptr || accnt->abi.size() == 0 ) return {};
+   const uint64_t abi_sequence = db.get<account_metadata_object, by_name>( n ).abi_sequence;
+
+   auto& c = cache();
+   {
+      std::lock_guard<std::mutex> g( c.mtx );
+      auto& idx = c.entries.get<by_account>();
+      auto itr = idx.find( boost::make_tuple( n, abi_sequence ) );
+      if( itr != idx.end() && itr->matches( accnt->abi ) ) {
+         ++c.counts.hits;
+         c.entries.relocate( c.entries.begin(), c.entries.project<0>( itr ) );
+         return itr->abi;
+      }
+      ++c.counts.misses;
+   }
+
+   // load outside of the lock, throws on an ABI that does not unpack or validate so nothing is cached
+   abi_def def;
+   abi_serializer::to_abi( accnt->abi, def );
+   auto result = std::make_shared<const cached_abi>( std::move( def ), max_serialization_time );
+
+   std::lock_guard<std::mutex> g( c.mtx );
+   auto& idx = c.entries.get<by_account>();
+   auto itr = idx.find( boost::make_tuple( n, abi_sequence ) );
+   if( itr != idx.end() ) {
+      idx.modify( itr, [&]( cache_entry& e ) {
+         e.packed_abi.assign( accnt->abi.data(), accnt->abi.size() );
+         e.abi = result;
+      } );
+      c.entries.relocate( c.entries.begin(), c.entries.project<0>( itr ) );
+   } else {
+      c.entries.push_front( cache_entry{ n, abi_sequence, std::string( accnt->abi.data(), accnt->abi.size() ), result } );
+      c.trim();
+   }
+   return result;
+}
+
+std::shared_ptr<const abi_serializer>
+abi_serializer_cache::get_serializer( const chainbase::database& db, account_name n, const fc::microseconds& max_serialization_time ) {
+   auto entry = get( db, n, max_serialization_time );
+   if( !entry ) return {};
+   // shares ownership of the cached entry
+   return std::shared_ptr<const abi_serializer>( entry, &entry->serializer );
+}
+
+void abi_serializer_cache::set_capacity( size_t capacity ) {
+   auto& c = cache();
+   std::lock_guard<std::mutex> g( c.mtx );
+   c.capacity = capacity;
+   c.trim();
+}
+
+abi_serializer_cache::stats abi_serializer_cache::get_stats() {
+   auto& c = cache();
+   std::lock_guard<std::mutex> g( c.mtx );
+   auto result = c.counts;
+   result.size = c.entries.size();
+   result.capacity = c.capacity;
+   return result;
+}
+
+void abi_serializer_cache::clear() {
+   auto& c = cache();
+   std::lock_guard<std::mutex> g( c.mtx );
+   c.entries.clear();
+   c.counts = stats();
+}
+
+} } // eosio::chain
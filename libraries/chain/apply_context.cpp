@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <eosio/chain/apply_context.hpp>
+#include <eosio/chain/state_prefetcher.hpp>
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/transaction_context.hpp>
 #include <eosio/chain/exceptions.hpp>
@@ -49,9 +50,39 @@ apply_context::apply_context(controller& con, transaction_context& trx_ctx, uint
    context_free = trace.context_free;
 }
 
+void apply_context::reset( uint32_t ordinal, uint32_t depth )
+{
+   recurse_depth = depth;
+   first_receiver_action_ordinal = ordinal;
+   action_ordinal = ordinal;
+   privileged = false;
+   intrinsic_calls = 0;
+   db_ops = 0;
+
+   action_trace& trace = trx_context.get_action_trace(action_ordinal);
+   act = &trace.act;
+   receiver = trace.receiver;
+   context_free = trace.context_free;
+
+   idx64.clear();
+   idx128.clear();
+   idx256.clear();
+   idx_double.clear();
+   idx_long_double.clear();
+   keyval_cache.clear();
+   _notified.clear();
+   _inline_actions.clear();
+   _cfa_inline_actions.clear();
+   _pending_console_output.clear();
+   _account_ram_deltas.clear();
+}
+
 void apply_context::exec_one()
 {
    auto start = fc::time_point::now();
+   const auto billable_start = trx_context.billable_time( start );
+   intrinsic_calls = 0;
+   db_ops = 0;
 
    action_receipt r;
    r.receiver         = receiver;
@@ -65,6 +96,8 @@ void apply_context::exec_one()
          privileged = receiver_account->is_privileged();
          auto native = control.find_apply_handler( receiver, act->account, act->name );
          if( native ) {
+            // every native handler modifies state
+            check_writes_allowed();
             if( trx_context.enforce_whiteblacklist && control.is_producing_block() ) {
                control.check_contract_list( receiver );
                control.check_action_list( act->account, act->name );
@@ -114,8 +147,11 @@ void apply_context::exec_one()
    } catch( const fc::exception& e ) {
       action_trace& trace = trx_context.get_action_trace( action_ordinal );
       trace.error_code = controller::convert_exception_to_error_code( e );
-      trace.except = e;
+      if( control.get_trace_level() != trace_level::NONE )
+         trace.except = e;
       finalize_trace( trace, start );
+      record_profile( trace, start, billable_start, true );
+      record_prefetch_history();
       throw;
    }
 
@@ -142,11 +178,14 @@ void apply_context::exec_one()
    }
 
    action_trace& trace = trx_context.get_action_trace( action_ordinal );
-   trace.receipt = r;
+   if( control.get_trace_level() != trace_level::NONE )
+      trace.receipt = r;
 
    trx_context.executed.emplace_back( std::move(r) );
 
    finalize_trace( trace, start );
+   record_profile( trace, start, billable_start, false );
+   record_prefetch_history();
 
    if ( control.contracts_console() ) {
       print_debug(receiver, trace);
@@ -155,15 +194,48 @@ void apply_context::exec_one()
 
 void apply_context::finalize_trace( action_trace& trace, const fc::time_point& start )
 {
-   trace.account_ram_deltas = std::move( _account_ram_deltas );
+   // left behind below the full trace level, so the next action of the transaction reuses their memory
+   if( control.get_trace_level() == trace_level::FULL )
+      trace.account_ram_deltas = std::move( _account_ram_deltas );
    _account_ram_deltas.clear();
 
+   // always empty unless contracts-console is enabled
    trace.console = std::move( _pending_console_output );
    _pending_console_output.clear();
 
    trace.elapsed = fc::time_point::now() - start;
 }
 
+void apply_context::record_profile( const action_trace& trace, const fc::time_point& start, const fc::microseconds& billable_start, bool failed )
+{
+   auto* profiler = control.get_mutable_contract_profiler();
+   if( !profiler ) return;
+
+   contract_profiler::counters c;
+   c.calls           = 1;
+   c.failures        = failed ? 1 : 0;
+   c.billed_cpu_us   = ( trx_context.billable_time( start + trace.elapsed ) - billable_start ).count();
+   c.wall_us         = trace.elapsed.count();
+   c.intrinsic_calls = intrinsic_calls;
+   c.db_ops          = db_ops;
+   profiler->record( receiver, act->account, act->name, c );
+}
+
+void apply_context::record_prefetch_history()
+{
+   auto* prefetcher = control.get_state_prefetcher();
+   if( !prefetcher ) return;
+
+   vector<const void*> objects;
+   keyval_cache.append_objects( objects );
+   idx64.append_objects( objects );
+   idx128.append_objects( objects );
+   idx256.append_objects( objects );
+   idx_double.append_objects( objects );
+   idx_long_double.append_objects( objects );
+   prefetcher->record( receiver, objects );
+}
+
 void apply_context::exec()
 {
    _notified.emplace_back( receiver, action_ordinal );
@@ -346,6 +418,7 @@ void apply_context::execute_context_free_inline( action&& a ) {
 
 
 void apply_context::schedule_deferred_transaction( const uint128_t& sender_id, account_name payer, transaction&& trx, bool replace_existing ) {
+   check_writes_allowed();
    EOS_ASSERT( trx.context_free_actions.size() == 0, cfa_inside_generated_tx, "context free actions are not currently allowed in generated transactions" );
 
    bool enforce_actor_whitelist_blacklist = trx_context.enforce_whiteblacklist && control.is_producing_block()
@@ -528,6 +601,7 @@ void apply_context::schedule_deferred_transaction( const uint128_t& sender_id, a
 }
 
 bool apply_context::cancel_deferred_transaction( const uint128_t& sender_id, account_name sender ) {
+   check_writes_allowed();
    auto& generated_transaction_idx = db.get_mutable_index<generated_transaction_multi_index>();
    const auto* gto = db.find<generated_transaction_object,by_sender_id>(boost::make_tuple(sender, sender_id));
    if ( gto ) {
@@ -558,27 +632,44 @@ uint32_t apply_context::schedule_action( action&& act_to_schedule, account_name
 }
 
 const table_id_object* apply_context::find_table( name code, name scope, name table ) {
-   return db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
+   record_table_read( code, scope, table );
+   auto* cache = lookup_cache();
+   const table_id_object* tab = nullptr;
+   if( cache && cache->find_table( code, scope, table, tab ) )
+      return tab;
+   tab = db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
+   if( cache )
+      cache->cache_table( code, scope, table, tab );
+   return tab;
 }
 
 const table_id_object& apply_context::find_or_create_table( name code, name scope, name table, const account_name &payer ) {
-   const auto* existing_tid =  db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
+   record_table_write( code, scope, table );
+   auto* cache = lookup_cache();
+   const table_id_object* existing_tid = nullptr;
+   if( !cache || !cache->find_table( code, scope, table, existing_tid ) )
+      existing_tid = db.find<table_id_object, by_code_scope_table>(boost::make_tuple(code, scope, table));
    if (existing_tid != nullptr) {
       return *existing_tid;
    }
 
    update_db_usage(payer, config::billable_size_v<table_id_object>);
 
-   return db.create<table_id_object>([&](table_id_object &t_id){
+   const auto& tid = db.create<table_id_object>([&](table_id_object &t_id){
       t_id.code = code;
       t_id.scope = scope;
       t_id.table = table;
       t_id.payer = payer;
    });
+   if( cache )
+      cache->cache_table( code, scope, table, &tid );
+   return tid;
 }
 
 void apply_context::remove_table( const table_id_object& tid ) {
    update_db_usage(tid.payer, - config::billable_size_v<table_id_object>);
+   if( auto* cache = lookup_cache() )
+      cache->remove_table( tid );
    db.remove(tid);
 }
 
@@ -610,6 +701,25 @@ void apply_context::update_db_usage( const account_name& payer, int64_t delta )
    add_ram_usage(payer, delta);
 }
 
+void apply_context::check_writes_allowed()const {
+   EOS_ASSERT( !trx_context.is_read_only, read_only_trx_write_exception,
+               "contract ${c} attempted to modify state in a read-only transaction", ("c", receiver) );
+}
+
+table_lookup_cache* apply_context::lookup_cache() {
+   return trx_context.lookup_cache ? &*trx_context.lookup_cache : nullptr;
+}
+
+void apply_context::record_table_read( name code, name scope, name table ) {
+   if( trx_context.access_set )
+      trx_context.access_set->add_read( code, scope, table );
+}
+
+void apply_context::record_table_write( name code, name scope, name table ) {
+   if( trx_context.access_set )
+      trx_context.access_set->add_write( code, scope, table );
+}
+
 
 int apply_context::get_action( uint32_t type, uint32_t index, char* buffer, size_t buffer_size )const
 {
@@ -658,6 +768,7 @@ int apply_context::db_store_i64( name scope, name table, const account_name& pay
 
 int apply_context::db_store_i64( name code, name scope, name table, const account_name& payer, uint64_t id, const char* buffer, size_t buffer_size ) {
 //   require_write_lock( scope );
+   check_writes_allowed();
    const auto& tab = find_or_create_table( code, scope, table, payer );
    auto tableid = tab.id;
 
@@ -677,15 +788,20 @@ int apply_context::db_store_i64( name code, name scope, name table, const accoun
    int64_t billable_size = (int64_t)(buffer_size + config::billable_size_v<key_value_object>);
    update_db_usage( payer, billable_size);
 
+   if( auto* cache = lookup_cache() )
+      cache->cache_row( tableid, id, &obj );
+
    keyval_cache.cache_table( tab );
    return keyval_cache.add( obj );
 }
 
 void apply_context::db_update_i64( int iterator, account_name payer, const char* buffer, size_t buffer_size ) {
+   check_writes_allowed();
    const key_value_object& obj = keyval_cache.get( iterator );
 
    const auto& table_obj = keyval_cache.get_table( obj.t_id );
    EOS_ASSERT( table_obj.code == receiver, table_access_violation, "db access violation" );
+   record_table_write( table_obj.code, table_obj.scope, table_obj.table );
 
 //   require_write_lock( table_obj.scope );
 
@@ -712,10 +828,12 @@ void apply_context::db_update_i64( int iterator, account_name payer, const char*
 }
 
 void apply_context::db_remove_i64( int iterator ) {
+   check_writes_allowed();
    const key_value_object& obj = keyval_cache.get( iterator );
 
    const auto& table_obj = keyval_cache.get_table( obj.t_id );
    EOS_ASSERT( table_obj.code == receiver, table_access_violation, "db access violation" );
+   record_table_write( table_obj.code, table_obj.scope, table_obj.table );
 
 //   require_write_lock( table_obj.scope );
 
@@ -724,6 +842,8 @@ void apply_context::db_remove_i64( int iterator ) {
    db.modify( table_obj, [&]( auto& t ) {
       --t.count;
    });
+   if( auto* cache = lookup_cache() )
+      cache->cache_row<key_value_object>( obj.t_id, obj.primary_key, nullptr );
    db.remove( obj );
 
    if (table_obj.count == 0) {
@@ -800,7 +920,13 @@ int apply_context::db_find_i64( name code, name scope, name table, uint64_t id )
 
    auto table_end_itr = keyval_cache.cache_table( *tab );
 
-   const key_value_object* obj = db.find<key_value_object, by_scope_primary>( boost::make_tuple( tab->id, id ) );
+   auto* cache = lookup_cache();
+   const key_value_object* obj = nullptr;
+   if( !cache || !cache->find_row( receiver, tab->id, id, obj ) ) {
+      obj = db.find<key_value_object, by_scope_primary>( boost::make_tuple( tab->id, id ) );
+      if( cache )
+         cache->cache_row( tab->id, id, obj );
+   }
    if( !obj ) return table_end_itr;
 
    return keyval_cache.add( *obj );
@@ -847,6 +973,42 @@ int apply_context::db_end_i64( name code, name scope, name table ) {
    return keyval_cache.cache_table( *tab );
 }
 
+/**
+ *  Copies consecutive rows starting at @ref lower_bound into @ref buffer, each as its primary key, the size of its
+ *  value as a uint32_t and the value itself. Rows are read straight off the index, so unlike the iterator API no
+ *  keyval_cache iterators are handed out for them.
+ *
+ *  @return the number of rows copied, which stops short of @ref max_rows at the end of the table or at the first row
+ *  that no longer fits; if not even the first row fits, the negated number of bytes it needs
+ */
+int apply_context::db_read_range_i64( name code, name scope, name table, uint64_t lower_bound, uint32_t max_rows, char* buffer, size_t buffer_size ) {
+   const auto* tab = find_table( code, scope, table );
+   if( !tab ) return 0;
+
+   const auto& idx = db.get_index<key_value_index, by_scope_primary>();
+   size_t offset = 0;
+   int rows = 0;
+   for( auto itr = idx.lower_bound( boost::make_tuple( tab->id, lower_bound ) );
+        itr != idx.end() && itr->t_id == tab->id && static_cast<uint32_t>(rows) < max_rows;
+        ++itr, ++rows )
+   {
+      const uint32_t value_size = itr->value.size();
+      const size_t row_size = sizeof(uint64_t) + sizeof(uint32_t) + value_size;
+      if( row_size > buffer_size - offset ) {
+         if( rows == 0 ) return -static_cast<int>(row_size);
+         break;
+      }
+      memcpy( buffer + offset, &itr->primary_key, sizeof(uint64_t) );
+      offset += sizeof(uint64_t);
+      memcpy( buffer + offset, &value_size, sizeof(uint32_t) );
+      offset += sizeof(uint32_t);
+      memcpy( buffer + offset, itr->value.data(), value_size );
+      offset += value_size;
+   }
+
+   return rows;
+}
+
 uint64_t apply_context::next_global_sequence() {
    const auto& p = control.get_dynamic_global_properties();
    db.modify( p, [&]( auto& dgp ) {
@@ -0,0 +1,96 @@
+#include <eosio/chain/authority_cache.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/member.hpp>
+
+#include <mutex>
+
+namespace eosio { namespace chain {
+
+namespace {
+   using namespace boost::multi_index;
+
+   struct cache_entry {
+      permission_level               level;
+      time_point                     last_updated;
+      authority_cache::authority_ptr auth;
+   };
+
+   struct by_level;
+
+   typedef multi_index_container<
+      cache_entry,
+      indexed_by<
+         sequenced<>,
+         ordered_unique<tag<by_level>, member<cache_entry, permission_level, &cache_entry::level>>
+      >
+   > authority_cache_type;
+}
+
+struct authority_cache::impl {
+   mutable std::mutex     mtx;
+   authority_cache_type   entries;
+   stats                  counts;
+};
+
+authority_cache::authority_cache() : my( new impl() ) {}
+
+authority_cache::~authority_cache() = default;
+
+authority_cache::authority_ptr authority_cache::get( const permission_object& perm, time_point head_block_time ) {
+   const permission_level level{ perm.owner, perm.name };
+   {
+      std::lock_guard<std::mutex> g( my->mtx );
+      auto& idx = my->entries.get<by_level>();
+      auto itr = idx.find( level );
+      if( itr != idx.end() && itr->last_updated == perm.last_updated ) {
+         ++my->counts.hits;
+         my->entries.relocate( my->entries.begin(), my->entries.project<0>( itr ) );
+         return itr->auth;
+      }
+      ++my->counts.misses;
+   }
+
+   auto result = std::make_shared<const authority>( perm.auth.to_authority() );
+   // the authority of a permission updated in the head or pending block may yet be replaced with the same last_updated
+   if( perm.last_updated >= head_block_time ) return result;
+
+   std::lock_guard<std::mutex> g( my->mtx );
+   auto& idx = my->entries.get<by_level>();
+   auto itr = idx.find( level );
+   if( itr != idx.end() ) {
+      idx.modify( itr, [&]( cache_entry& e ) {
+         e.last_updated = perm.last_updated;
+         e.auth = result;
+      } );
+      my->entries.relocate( my->entries.begin(), my->entries.project<0>( itr ) );
+   } else {
+      my->entries.push_front( cache_entry{ level, perm.last_updated, result } );
+      while( my->entries.size() > default_capacity ) {
+         my->entries.pop_back();
+         ++my->counts.evictions;
+      }
+   }
+   return result;
+}
+
+void authority_cache::erase( const permission_object& perm ) {
+   std::lock_guard<std::mutex> g( my->mtx );
+   my->entries.get<by_level>().erase( permission_level{ perm.owner, perm.name } );
+}
+
+void authority_cache::clear() {
+   std::lock_guard<std::mutex> g( my->mtx );
+   my->entries.clear();
+}
+
+authority_cache::stats authority_cache::get_stats()const {
+   std::lock_guard<std::mutex> g( my->mtx );
+   auto result = my->counts;
+   result.size = my->entries.size();
+   return result;
+}
+
+} } // eosio::chain
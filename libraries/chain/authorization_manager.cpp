@@ -110,6 +110,8 @@ namespace eosio { namespace chain {
    }
 
    void authorization_manager::read_from_snapshot( const snapshot_reader_ptr& snapshot ) {
+      _authority_cache.clear();
+      _key_account_index.clear();
       authorization_index_set::walk_indices([this, &snapshot]( auto utils ){
          using section_t = typename decltype(utils)::index_t::value_type;
 
@@ -157,6 +159,8 @@ namespace eosio { namespace chain {
          p.last_updated = creation_time;
          p.auth         = auth;
       });
+      _authority_cache.erase( perm );
+      _key_account_index.add( perm );
       return perm;
    }
 
@@ -188,6 +192,8 @@ namespace eosio { namespace chain {
          p.last_updated = creation_time;
          p.auth         = std::move(auth);
       });
+      _authority_cache.erase( perm );
+      _key_account_index.add( perm );
       return perm;
    }
 
@@ -200,6 +206,8 @@ namespace eosio { namespace chain {
          po.auth = auth;
          po.last_updated = _control.pending_block_time();
       });
+      _authority_cache.erase( permission );
+      _key_account_index.add( permission );
    }
 
    void authorization_manager::remove_permission( const permission_object& permission ) {
@@ -208,10 +216,19 @@ namespace eosio { namespace chain {
       EOS_ASSERT( range.first == range.second, action_validate_exception,
                   "Cannot remove a permission which has children. Remove the children first.");
 
+      _authority_cache.erase( permission );
       _db.get_mutable_index<permission_usage_index>().remove_object( permission.usage_id._id );
       _db.remove( permission );
    }
 
+   void authorization_manager::rebuild_key_account_index() {
+      _key_account_index.rebuild( _db );
+   }
+
+   vector<key_account_index::match> authorization_manager::find_key_accounts( const vector<public_key_type>& keys )const {
+      return _key_account_index.find( _db, keys, _control.last_irreversible_block_time() );
+   }
+
    void authorization_manager::update_permission_usage( const permission_object& permission ) {
       const auto& puo = _db.get<permission_usage_object, by_id>( permission.usage_id );
       _db.modify( puo, [&](permission_usage_object& p) {
@@ -226,15 +243,22 @@ namespace eosio { namespace chain {
    const permission_object*  authorization_manager::find_permission( const permission_level& level )const
    { try {
       EOS_ASSERT( !level.actor.empty() && !level.permission.empty(), invalid_permission, "Invalid permission" );
-      return _db.find<permission_object, by_owner>( boost::make_tuple(level.actor,level.permission) );
+      return _db.find<permission_object, by_owner_hash>( boost::make_tuple(level.actor,level.permission) );
    } EOS_RETHROW_EXCEPTIONS( chain::permission_query_exception, "Failed to retrieve permission: ${level}", ("level", level) ) }
 
    const permission_object&  authorization_manager::get_permission( const permission_level& level )const
    { try {
       EOS_ASSERT( !level.actor.empty() && !level.permission.empty(), invalid_permission, "Invalid permission" );
-      return _db.get<permission_object, by_owner>( boost::make_tuple(level.actor,level.permission) );
+      return _db.get<permission_object, by_owner_hash>( boost::make_tuple(level.actor,level.permission) );
    } EOS_RETHROW_EXCEPTIONS( chain::permission_query_exception, "Failed to retrieve permission: ${level}", ("level", level) ) }
 
+   const authority& authorization_manager::get_authority( const permission_level& level,
+                                                          vector<authority_cache::authority_ptr>& held )const
+   {
+      held.emplace_back( _authority_cache.get( get_permission( level ), _control.head_block_time() ) );
+      return *held.back();
+   }
+
    optional<permission_name> authorization_manager::lookup_linked_permission( account_name authorizer_account,
                                                                               account_name scope,
                                                                               action_name act_name
@@ -243,11 +267,11 @@ namespace eosio { namespace chain {
       try {
          // First look up a specific link for this message act_name
          auto key = boost::make_tuple(authorizer_account, scope, act_name);
-         auto link = _db.find<permission_link_object, by_action_name>(key);
+         auto link = _db.find<permission_link_object, by_action_name_hash>(key);
          // If no specific link found, check for a contract-wide default
          if (link == nullptr) {
             boost::get<2>(key) = {};
-            link = _db.find<permission_link_object, by_action_name>(key);
+            link = _db.find<permission_link_object, by_action_name_hash>(key);
          }
 
          // If no specific or default link found, use active permission
@@ -453,7 +477,8 @@ namespace eosio { namespace chain {
 
       auto effective_provided_delay =  (provided_delay >= delay_max_limit) ? fc::microseconds::maximum() : provided_delay;
 
-      auto checker = make_auth_checker( [&](const permission_level& p){ return get_permission(p).auth; },
+      vector<authority_cache::authority_ptr> held;
+      auto checker = make_auth_checker( [&](const permission_level& p) -> const authority& { return get_authority( p, held ); },
                                         _control.get_global_properties().configuration.max_authority_depth,
                                         provided_keys,
                                         provided_permissions,
@@ -463,6 +488,11 @@ namespace eosio { namespace chain {
 
       map<permission_level, fc::microseconds> permissions_to_satisfy;
 
+      // Actions that repeat an (authorization, contract, action) triple, such as a batch of transfers from one
+      // account, need their minimum permission looked up and checked only once; nothing can modify permissions or
+      // links while the transaction's authorizations are being checked.
+      flat_set<std::tuple<permission_level, account_name, action_name>> relevant_authorizations;
+
       for( const auto& act : actions ) {
          bool special_case = false;
          fc::microseconds delay = effective_provided_delay;
@@ -489,7 +519,7 @@ namespace eosio { namespace chain {
 
             checktime();
 
-            if( !special_case ) {
+            if( !special_case && relevant_authorizations.emplace( declared_auth, act.account, act.name ).second ) {
                auto min_permission_name = lookup_minimum_permission(declared_auth.actor, act.account, act.name);
                if( min_permission_name ) { // since special cases were already handled, it should only be false if the permission is eosio.any
                   const auto& min_permission = get_permission({declared_auth.actor, *min_permission_name});
@@ -554,7 +584,8 @@ namespace eosio { namespace chain {
 
       auto delay_max_limit = fc::seconds( _control.get_global_properties().configuration.max_transaction_delay );
 
-      auto checker = make_auth_checker( [&](const permission_level& p){ return get_permission(p).auth; },
+      vector<authority_cache::authority_ptr> held;
+      auto checker = make_auth_checker( [&](const permission_level& p) -> const authority& { return get_authority( p, held ); },
                                         _control.get_global_properties().configuration.max_authority_depth,
                                         provided_keys,
                                         provided_permissions,
@@ -585,7 +616,8 @@ namespace eosio { namespace chain {
                                                                        fc::microseconds provided_delay
                                                                      )const
    {
-      auto checker = make_auth_checker( [&](const permission_level& p){ return get_permission(p).auth; },
+      vector<authority_cache::authority_ptr> held;
+      auto checker = make_auth_checker( [&](const permission_level& p) -> const authority& { return get_authority( p, held ); },
                                         _control.get_global_properties().configuration.max_authority_depth,
                                         candidate_keys,
                                         {},
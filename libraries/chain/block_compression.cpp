@@ -0,0 +1,159 @@
+#include <eosio/chain/block_compression.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#ifdef EOSIO_CHAIN_ZSTD_ENABLED
+#include <zstd.h>
+#endif
+#ifdef EOSIO_CHAIN_LZ4_ENABLED
+#include <lz4.h>
+#endif
+
+#include <cstring>
+#include <memory>
+
+namespace eosio { namespace chain {
+   namespace bio = boost::iostreams;
+
+   namespace {
+      // throws if more than limit bytes are written, guards against zip bombs
+      struct write_limiter {
+         using char_type = char;
+         using category = bio::multichar_output_filter_tag;
+
+         explicit write_limiter( size_t limit ) : _limit( limit ) {}
+
+         template<typename Sink>
+         std::streamsize write( Sink& sink, const char* s, std::streamsize count ) {
+            EOS_ASSERT( _total + static_cast<size_t>(count) <= _limit, plugin_exception, "Exceeded maximum decompressed block size" );
+            _total += count;
+            return bio::write( sink, s, count );
+         }
+
+         size_t _limit;
+         size_t _total = 0;
+      };
+   }
+
+   bool block_codec_supported( block_codec codec ) {
+      switch( codec ) {
+         case block_codec::zlib:
+            return true;
+#ifdef EOSIO_CHAIN_ZSTD_ENABLED
+         case block_codec::zstd:
+            return true;
+#endif
+#ifdef EOSIO_CHAIN_LZ4_ENABLED
+         case block_codec::lz4:
+            return true;
+#endif
+         default:
+            return false;
+      }
+   }
+
+   block_codec parse_block_codec( const std::string& name ) {
+      block_codec codec;
+      if( name == "zlib" )
+         codec = block_codec::zlib;
+      else if( name == "zstd" )
+         codec = block_codec::zstd;
+      else if( name == "lz4" )
+         codec = block_codec::lz4;
+      else
+         EOS_THROW( plugin_config_exception, "unknown block compression ${c}", ("c", name) );
+      EOS_ASSERT( block_codec_supported( codec ), plugin_config_exception, "nodeos was built without ${c}", ("c", name) );
+      return codec;
+   }
+
+   bytes compress_block( block_codec codec, const char* data, size_t size ) {
+      bytes out;
+      switch( codec ) {
+         case block_codec::zlib: {
+            bio::filtering_ostream comp;
+            comp.push( bio::zlib_compressor( bio::zlib::default_compression ) );
+            comp.push( bio::back_inserter( out ) );
+            bio::write( comp, data, size );
+            bio::close( comp );
+            return out;
+         }
+#ifdef EOSIO_CHAIN_ZSTD_ENABLED
+         case block_codec::zstd: {
+            out.resize( ZSTD_compressBound( size ) );
+            const size_t r = ZSTD_compress( out.data(), out.size(), data, size, 3 );
+            EOS_ASSERT( !ZSTD_isError( r ), plugin_exception, "zstd compression failed: ${e}", ("e", ZSTD_getErrorName( r )) );
+            out.resize( r );
+            return out;
+         }
+#endif
+#ifdef EOSIO_CHAIN_LZ4_ENABLED
+         case block_codec::lz4: {
+            // lz4 blocks do not record their decompressed size, so it precedes the block
+            EOS_ASSERT( size <= LZ4_MAX_INPUT_SIZE, plugin_exception, "block is too big for lz4" );
+            const uint32_t raw_size = size;
+            out.resize( sizeof( raw_size ) + LZ4_compressBound( raw_size ) );
+            memcpy( out.data(), &raw_size, sizeof( raw_size ) );
+            const int r = LZ4_compress_default( data, out.data() + sizeof( raw_size ), raw_size, out.size() - sizeof( raw_size ) );
+            EOS_ASSERT( r > 0 || raw_size == 0, plugin_exception, "lz4 compression failed" );
+            out.resize( sizeof( raw_size ) + r );
+            return out;
+         }
+#endif
+         default:
+            EOS_THROW( plugin_exception, "unsupported block codec ${c}", ("c", static_cast<uint32_t>( codec )) );
+      }
+   }
+
+   bytes decompress_block( block_codec codec, const bytes& in, size_t limit ) {
+      switch( codec ) {
+         case block_codec::zlib: {
+            bytes out;
+            try {
+               bio::filtering_ostream decomp;
+               decomp.push( bio::zlib_decompressor() );
+               decomp.push( write_limiter( limit ) );
+               decomp.push( bio::back_inserter( out ) );
+               bio::write( decomp, in.data(), in.size() );
+               bio::close( decomp );
+            } catch( const fc::exception& ) {
+               throw;
+            } catch( ... ) {
+               fc::unhandled_exception er( FC_LOG_MESSAGE( warn, "block decompression error" ), std::current_exception() );
+               throw er;
+            }
+            return out;
+         }
+#ifdef EOSIO_CHAIN_ZSTD_ENABLED
+         case block_codec::zstd: {
+            const auto raw_size = ZSTD_getFrameContentSize( in.data(), in.size() );
+            EOS_ASSERT( raw_size != ZSTD_CONTENTSIZE_ERROR && raw_size != ZSTD_CONTENTSIZE_UNKNOWN, plugin_exception,
+                        "corrupt zstd block" );
+            EOS_ASSERT( raw_size <= limit, plugin_exception, "Exceeded maximum decompressed block size" );
+            bytes out( raw_size );
+            const size_t r = ZSTD_decompress( out.data(), out.size(), in.data(), in.size() );
+            EOS_ASSERT( !ZSTD_isError( r ) && r == raw_size, plugin_exception, "zstd decompression failed: ${e}",
+                        ("e", ZSTD_isError( r ) ? ZSTD_getErrorName( r ) : "size mismatch") );
+            return out;
+         }
+#endif
+#ifdef EOSIO_CHAIN_LZ4_ENABLED
+         case block_codec::lz4: {
+            uint32_t raw_size = 0;
+            EOS_ASSERT( in.size() >= sizeof( raw_size ), plugin_exception, "corrupt lz4 block" );
+            memcpy( &raw_size, in.data(), sizeof( raw_size ) );
+            EOS_ASSERT( raw_size <= limit, plugin_exception, "Exceeded maximum decompressed block size" );
+            bytes out( raw_size );
+            const int r = LZ4_decompress_safe( in.data() + sizeof( raw_size ), out.data(), in.size() - sizeof( raw_size ), raw_size );
+            EOS_ASSERT( r >= 0 && static_cast<uint32_t>( r ) == raw_size, plugin_exception, "corrupt lz4 block" );
+            return out;
+         }
+#endif
+         default:
+            EOS_THROW( plugin_exception, "unsupported block codec ${c}", ("c", static_cast<uint32_t>( codec )) );
+      }
+   }
+
+} } // namespace eosio::chain
@@ -1,10 +1,19 @@
 #include <eosio/chain/block_log.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <fstream>
+#include <future>
 #include <fc/bitutil.hpp>
 #include <fc/io/cfile.hpp>
 #include <fc/io/raw.hpp>
+#include <fc/scoped_exit.hpp>
+#include <boost/filesystem/operations.hpp>
 
+#include <algorithm>
+#include <cstdio>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
 
 #define LOG_READ  (std::ios::in | std::ios::binary)
 #define LOG_WRITE (std::ios::out | std::ios::binary | std::ios::app)
@@ -20,6 +29,29 @@
 #define FC_FOPEN(p, m) _wfopen(p, FC_PREL(m))
 #endif
 
+namespace eosio { namespace chain { namespace detail {
+   /// header of a compressed shard of a block log, see block_log.hpp
+   struct shard_header {
+      uint32_t    magic = 0;
+      uint32_t    version = 0;
+      uint8_t     codec = 0;
+      uint32_t    first_block = 0;
+      uint32_t    last_block = 0;
+      fc::sha256  chain_id;
+   };
+
+   /// index entry of a chunk of a compressed shard
+   struct shard_chunk {
+      uint32_t              first_block = 0;
+      uint64_t              pos = 0;
+      uint32_t              size = 0;
+      std::vector<uint32_t> block_ends; ///< where each block of the chunk ends, once decompressed
+   };
+} } }
+
+FC_REFLECT( eosio::chain::detail::shard_header, (magic)(version)(codec)(first_block)(last_block)(chain_id) )
+FC_REFLECT( eosio::chain::detail::shard_chunk, (first_block)(pos)(size)(block_ends) )
+
 namespace eosio { namespace chain {
 
    const uint32_t block_log::min_supported_version = 1;
@@ -37,6 +69,33 @@ namespace eosio { namespace chain {
    namespace detail {
       using unique_file = std::unique_ptr<FILE, decltype(&fclose)>;
 
+      constexpr uint32_t shard_magic = 0x44524853; // "SHRD"
+      constexpr uint32_t shard_version = 1;
+      constexpr size_t   shard_header_size = 4 + 4 + 1 + 4 + 4 + 32;
+
+      /// a compressed shard of a block log, keeping the chunk read last decompressed for reads of the blocks after it
+      class block_log_shard {
+      public:
+         explicit block_log_shard(const fc::path& file_name);
+
+         uint32_t          first_block() const { return _header.first_block; }
+         uint32_t          last_block() const { return _header.last_block; }
+         const fc::sha256& chain_id() const { return _header.chain_id; }
+
+         /// the packed block_num, which has to be in this shard
+         std::vector<char> read_block(uint32_t block_num);
+
+      private:
+         void read(char* d, size_t size, uint64_t pos);
+
+         unique_file                 _file;
+         std::string                 _file_name;
+         shard_header                _header;
+         std::vector<shard_chunk>    _chunks;
+         size_t                      _cached_chunk = std::numeric_limits<size_t>::max();
+         bytes                       _cached;
+      };
+
       class block_log_impl {
          public:
             signed_block_ptr         head;
@@ -47,6 +106,12 @@ namespace eosio { namespace chain {
             bool                     genesis_written_to_block_log = false;
             uint32_t                 version = 0;
             uint32_t                 first_block_num = 0;
+            fc::optional<log_sync>   sync;
+            std::vector<std::unique_ptr<block_log_shard>> shards; ///< by first block
+
+            void open_shards(const fc::path& data_dir);
+            /// the packed block from the shards, empty when none of them has it
+            std::vector<char> read_shard_block(uint32_t block_num);
 
             inline void check_open_files() {
                if( !open_files ) {
@@ -72,7 +137,7 @@ namespace eosio { namespace chain {
 
             void flush();
 
-            uint64_t append(const signed_block_ptr& b);
+            uint64_t append(const signed_block_ptr& b, const std::vector<char>& packed_block);
 
             template <typename ChainContext, typename Lambda>
             static fc::optional<ChainContext> extract_chain_context( const fc::path& data_dir, Lambda&& lambda );
@@ -104,7 +169,11 @@ namespace eosio { namespace chain {
          uint32_t first_block_num() const { return _first_block_num; }
          constexpr static uint32_t      _buf_len                          = 1U << 24;
       private:
-         void update_buffer();
+         // reads into the current buffer the section ending at the current position, then prefetches the one before it if @ref prefetch
+         void update_buffer(bool prefetch = true);
+         void read_section(char* buf, uint64_t start, uint64_t end);
+         void start_prefetch();
+         void wait_for_prefetch();
 
          unique_file                    _file;
          uint32_t                       _version                          = 0;
@@ -120,6 +189,12 @@ namespace eosio { namespace chain {
          std::string                    _block_file_name;
          constexpr static int64_t       _unset_position                   = -1;
          constexpr static uint64_t      _position_size                    = sizeof(_current_position_in_file);
+
+         // the section preceding the current buffer is read on a background thread while the current one is walked
+         std::unique_ptr<char[]>        _prefetch_buffer_ptr;
+         uint64_t                       _prefetch_start                   = 0;
+         uint64_t                       _prefetch_end                     = 0;
+         std::future<void>              _prefetch; // declared last so an in flight read completes before other members are destroyed
       };
 
       constexpr uint64_t buffer_location_to_file_location(uint32_t buffer_location) { return buffer_location << 3; }
@@ -181,6 +256,119 @@ namespace eosio { namespace chain {
       };
    }
 
+   detail::block_log_shard::block_log_shard(const fc::path& file_name)
+   : _file(FC_FOPEN(file_name.generic_string().c_str(), "rb"), &fclose)
+   , _file_name(file_name.generic_string()) {
+      EOS_ASSERT( _file, block_log_not_found, "cannot read file ${file}", ("file", _file_name) );
+      const uint64_t file_size = fc::file_size(file_name);
+      EOS_ASSERT( file_size >= shard_header_size + sizeof(uint64_t), block_log_exception, "${file} is truncated", ("file", _file_name) );
+
+      std::vector<char> data(shard_header_size);
+      read(data.data(), data.size(), 0);
+      fc::raw::unpack(data, _header);
+      EOS_ASSERT( _header.magic == shard_magic && _header.version == shard_version, block_log_unsupported_version,
+                  "${file} is not a block log shard of version ${v}", ("file", _file_name)("v", shard_version) );
+      EOS_ASSERT( _header.first_block > 0 && _header.first_block <= _header.last_block, block_log_exception,
+                  "${file} has an invalid block range", ("file", _file_name) );
+      EOS_ASSERT( block_codec_supported(static_cast<block_codec>(_header.codec)), block_log_exception,
+                  "${file} is compressed with codec ${c}, which this build does not have", ("file", _file_name)("c", _header.codec) );
+
+      uint64_t index_pos = 0;
+      read((char*)&index_pos, sizeof(index_pos), file_size - sizeof(index_pos));
+      EOS_ASSERT( index_pos >= shard_header_size && index_pos < file_size - sizeof(index_pos), block_log_exception,
+                  "${file} has an invalid chunk index position", ("file", _file_name) );
+      data.resize(file_size - sizeof(index_pos) - index_pos);
+      read(data.data(), data.size(), index_pos);
+      fc::raw::unpack(data, _chunks);
+
+      // the chunks cover the range of the shard in order, each within the chunk data
+      uint32_t next_block = _header.first_block;
+      for (const auto& c : _chunks) {
+         EOS_ASSERT( c.first_block == next_block && !c.block_ends.empty() && c.pos >= shard_header_size && c.pos + c.size <= index_pos &&
+                     std::is_sorted(c.block_ends.begin(), c.block_ends.end()), block_log_exception,
+                     "${file} has an invalid chunk index entry for block ${b}", ("file", _file_name)("b", c.first_block) );
+         next_block = c.first_block + c.block_ends.size();
+      }
+      EOS_ASSERT( next_block == _header.last_block + 1, block_log_exception,
+                  "the chunks of ${file} do not hold its blocks ${f} through ${l}",
+                  ("file", _file_name)("f", _header.first_block)("l", _header.last_block) );
+   }
+
+   void detail::block_log_shard::read(char* d, size_t size, uint64_t pos) {
+      auto status = fseek(_file.get(), pos, SEEK_SET);
+      EOS_ASSERT( status == 0, block_log_exception, "${file} seek failed", ("file", _file_name) );
+      EOS_ASSERT( size == 0 || fread(d, size, 1, _file.get()) == 1, block_log_exception, "${file} read failed", ("file", _file_name) );
+   }
+
+   std::vector<char> detail::block_log_shard::read_block(uint32_t block_num) {
+      auto it = std::upper_bound(_chunks.begin(), _chunks.end(), block_num,
+                                 [](uint32_t n, const shard_chunk& c) { return n < c.first_block; });
+      EOS_ASSERT( it != _chunks.begin() && block_num <= _header.last_block, block_log_exception,
+                  "block ${n} is not in ${file}", ("n", block_num)("file", _file_name) );
+      --it;
+      const size_t chunk = it - _chunks.begin();
+      if (chunk != _cached_chunk) {
+         bytes compressed(it->size);
+         read(compressed.data(), compressed.size(), it->pos);
+         _cached_chunk = std::numeric_limits<size_t>::max();
+         _cached = decompress_block(static_cast<block_codec>(_header.codec), compressed, it->block_ends.back());
+         EOS_ASSERT( _cached.size() == it->block_ends.back(), block_log_exception,
+                     "chunk of block ${n} in ${file} is corrupt", ("n", it->first_block)("file", _file_name) );
+         _cached_chunk = chunk;
+      }
+
+      const size_t i = block_num - it->first_block;
+      const uint32_t begin = i == 0 ? 0 : it->block_ends[i - 1];
+      std::vector<char> data(_cached.data() + begin, _cached.data() + it->block_ends[i]);
+      EOS_ASSERT( data.size() > trim_data::blknum_offset + sizeof(uint32_t), block_log_exception,
+                  "Block ${n} in ${file} is truncated", ("n", block_num)("file", _file_name) );
+      uint32_t prev_block_num;
+      memcpy(&prev_block_num, data.data() + trim_data::blknum_offset, sizeof(prev_block_num));
+      EOS_ASSERT( fc::endian_reverse_u32(prev_block_num) + 1 == block_num, reversible_blocks_exception,
+                  "Wrong block was read from ${file}.", ("file", _file_name)("returned", fc::endian_reverse_u32(prev_block_num) + 1)("expected", block_num) );
+      return data;
+   }
+
+   void detail::block_log_impl::open_shards(const fc::path& data_dir) {
+      shards.clear();
+      for (fc::directory_iterator it(data_dir), end; it != end; ++it) {
+         const auto name = (*it).filename().generic_string();
+         unsigned int first = 0, last = 0;
+         char ext[8] = {};
+         if (sscanf(name.c_str(), "blocks-%u-%u.%7s", &first, &last, ext) != 3 || std::string(ext) != "clog")
+            continue;
+         auto shard = std::make_unique<block_log_shard>(data_dir / name);
+         EOS_ASSERT( shard->first_block() == first && shard->last_block() == last, block_log_exception,
+                     "${file} holds blocks ${f} through ${l}", ("file", name)("f", shard->first_block())("l", shard->last_block()) );
+         shards.emplace_back(std::move(shard));
+      }
+      if (shards.empty())
+         return;
+
+      std::sort(shards.begin(), shards.end(), [](const auto& a, const auto& b) { return a->first_block() < b->first_block(); });
+      for (size_t i = 1; i < shards.size(); ++i) {
+         EOS_ASSERT( shards[i - 1]->last_block() < shards[i]->first_block(), block_log_exception,
+                     "block log shards ${a} and ${b} in ${dir} overlap",
+                     ("a", shards[i - 1]->first_block())("b", shards[i]->first_block())("dir", data_dir.generic_string()) );
+         EOS_ASSERT( shards[i]->chain_id() == shards.front()->chain_id(), block_log_exception,
+                     "block log shard ${b} in ${dir} is of another chain", ("b", shards[i]->first_block())("dir", data_dir.generic_string()) );
+      }
+      if (head) {
+         EOS_ASSERT( shards.front()->chain_id() == block_log::extract_chain_id(data_dir), block_log_exception,
+                     "the block log shards in ${dir} are of another chain than its blocks.log", ("dir", data_dir.generic_string()) );
+      }
+      ilog("Block log shards hold blocks ${f} through ${l} in ${n} files",
+           ("f", shards.front()->first_block())("l", shards.back()->last_block())("n", shards.size()));
+   }
+
+   std::vector<char> detail::block_log_impl::read_shard_block(uint32_t block_num) {
+      auto it = std::upper_bound(shards.begin(), shards.end(), block_num,
+                                 [](uint32_t n, const auto& shard) { return n < shard->first_block(); });
+      if (it == shards.begin() || block_num > (*--it)->last_block())
+         return {};
+      return (*it)->read_block(block_num);
+   }
+
    block_log::block_log(const fc::path& data_dir)
    :my(new detail::block_log_impl()) {
       open(data_dir);
@@ -192,7 +380,11 @@ namespace eosio { namespace chain {
 
    block_log::~block_log() {
       if (my) {
-         flush();
+         if (my->sync)
+            my->sync->flush_now( [this]() { flush(); } );
+         else
+            flush();
+         my->sync.reset();
          my->close();
          my.reset();
       }
@@ -284,13 +476,19 @@ namespace eosio { namespace chain {
          fc::remove_all( my->index_file.get_file_path() );
          my->reopen();
       }
+
+      my->open_shards(data_dir);
    }
 
    uint64_t block_log::append(const signed_block_ptr& b) {
-      return my->append(b);
+      return my->append(b, fc::raw::pack(*b));
+   }
+
+   uint64_t block_log::append(const signed_block_ptr& b, const std::vector<char>& packed_block) {
+      return my->append(b, packed_block);
    }
 
-   uint64_t detail::block_log_impl::append(const signed_block_ptr& b) {
+   uint64_t detail::block_log_impl::append(const signed_block_ptr& b, const std::vector<char>& packed_block) {
       try {
          EOS_ASSERT( genesis_written_to_block_log, block_log_append_fail, "Cannot append to block log until the genesis is first written" );
 
@@ -304,14 +502,17 @@ namespace eosio { namespace chain {
                    "Append to index file occuring at wrong position.",
                    ("position", (uint64_t) index_file.tellp())
                    ("expected", (b->block_num() - first_block_num) * sizeof(uint64_t)));
-         auto data = fc::raw::pack(*b);
-         block_file.write(data.data(), data.size());
+         block_file.write(packed_block.data(), packed_block.size());
          block_file.write((char*)&pos, sizeof(pos));
          index_file.write((char*)&pos, sizeof(pos));
          head = b;
          head_id = b->id();
 
-         flush();
+         // reads go through the same files, so they see appends which are not flushed yet
+         if( sync )
+            sync->appended( [this]() { flush(); } );
+         else
+            flush();
 
          return pos;
       }
@@ -322,6 +523,15 @@ namespace eosio { namespace chain {
       my->flush();
    }
 
+   void block_log::set_durability( const log_durability& durability ) {
+      if( durability.flush_blocks == 1 && !durability.fsync ) {
+         my->sync.reset();
+         return;
+      }
+      my->sync.emplace( "blog", durability,
+                        std::vector<fc::path>{ my->block_file.get_file_path(), my->index_file.get_file_path() } );
+   }
+
    void detail::block_log_impl::flush() {
       block_file.flush();
       index_file.flush();
@@ -351,7 +561,7 @@ namespace eosio { namespace chain {
       block_file.write((char*)&totem, sizeof(totem));
 
       if (first_block) {
-         append(first_block);
+         append(first_block, fc::raw::pack(*first_block));
       } else {
          head.reset();
          head_id = {};
@@ -414,6 +624,12 @@ namespace eosio { namespace chain {
             b = read_block(pos);
             EOS_ASSERT(b->block_num() == block_num, reversible_blocks_exception,
                       "Wrong block was read from block log.", ("returned", b->block_num())("expected", block_num));
+         } else {
+            const auto data = my->read_shard_block(block_num);
+            if (!data.empty()) {
+               b = std::make_shared<signed_block>();
+               fc::raw::unpack(data, *b);
+            }
          }
          return b;
       } FC_LOG_AND_RETHROW()
@@ -429,10 +645,50 @@ namespace eosio { namespace chain {
                        "Wrong block header was read from block log.", ("returned", bh.block_num())("expected", block_num));
             return bh.id();
          }
+         const auto data = my->read_shard_block(block_num);
+         if (!data.empty()) {
+            block_header bh;
+            fc::datastream<const char*> ds(data.data(), data.size());
+            fc::raw::unpack(ds, bh);
+            return bh.id();
+         }
          return {};
       } FC_LOG_AND_RETHROW()
    }
 
+   std::vector<char> block_log::read_serialized_block_by_num(uint32_t block_num)const {
+      try {
+         std::vector<char> data;
+         uint64_t pos = get_block_pos(block_num);
+         if (pos == npos)
+            return my->read_shard_block(block_num);
+
+         // every block is followed by its own 8 byte position, so the end of a block is found from the
+         // position of the next block or, for the head block, from the end of the file
+         uint64_t end_pos = 0;
+         if (block_num < block_header::num_from_id(my->head_id)) {
+            end_pos = get_block_pos(block_num + 1);
+         } else {
+            my->block_file.seek_end(0);
+            end_pos = my->block_file.tellp();
+         }
+         EOS_ASSERT(end_pos > pos + sizeof(uint64_t), block_log_exception,
+                    "Invalid block position in block log", ("block_num", block_num)("pos", pos)("end", end_pos));
+
+         data.resize(end_pos - pos - sizeof(uint64_t));
+         my->block_file.seek(pos);
+         my->block_file.read(data.data(), data.size());
+
+         EOS_ASSERT(data.size() > trim_data::blknum_offset + sizeof(uint32_t), block_log_exception,
+                    "Block ${n} in block log is truncated", ("n", block_num));
+         uint32_t prev_block_num;
+         memcpy(&prev_block_num, data.data() + trim_data::blknum_offset, sizeof(prev_block_num));
+         EOS_ASSERT(fc::endian_reverse_u32(prev_block_num) + 1 == block_num, reversible_blocks_exception,
+                    "Wrong block was read from block log.", ("returned", fc::endian_reverse_u32(prev_block_num) + 1)("expected", block_num));
+         return data;
+      } FC_LOG_AND_RETHROW()
+   }
+
    uint64_t block_log::get_block_pos(uint32_t block_num) const {
       my->check_open_files();
       if (!(my->head && block_num <= block_header::num_from_id(my->head_id) && block_num >= my->first_block_num))
@@ -474,6 +730,13 @@ namespace eosio { namespace chain {
       return my->first_block_num;
    }
 
+   uint32_t block_log::first_available_block_num() const {
+      if (my->shards.empty())
+         return my->first_block_num;
+      const uint32_t first_shard_block = my->shards.front()->first_block();
+      return my->head ? std::min(my->first_block_num, first_shard_block) : first_shard_block;
+   }
+
    void block_log::construct_index() {
       ilog("Reconstructing Block Log Index...");
       my->close();
@@ -507,12 +770,19 @@ namespace eosio { namespace chain {
       ilog("first block= ${first}         last block= ${last}",
            ("first", block_log_iter.first_block_num())("last", (block_log_iter.first_block_num() + num_blocks)));
 
+      const auto start = fc::time_point::now();
       detail::index_writer index(index_file_name, num_blocks);
       uint64_t position;
       while ((position = block_log_iter.previous()) != npos) {
          index.write(position);
       }
       index.complete();
+
+      const auto elapsed_us = std::max<int64_t>((fc::time_point::now() - start).count(), 1);
+      const auto log_size = fc::file_size(block_file_name);
+      ilog("indexed ${n} blocks in ${s} sec, ${bps} blocks/sec, ${mbps} MiB/sec",
+           ("n", num_blocks)("s", elapsed_us / 1000000)("bps", uint64_t(num_blocks) * 1000000 / elapsed_us)
+           ("mbps", log_size * 1000000 / elapsed_us / (1024 * 1024)));
    }
 
    fc::path block_log::repair_log( const fc::path& data_dir, uint32_t truncate_at_block ) {
@@ -756,10 +1026,15 @@ namespace eosio { namespace chain {
 
    detail::reverse_iterator::reverse_iterator()
    : _file(nullptr, &fclose)
-   , _buffer_ptr(std::make_unique<char[]>(_buf_len)) {
+   , _buffer_ptr(std::make_unique<char[]>(_buf_len))
+   , _prefetch_buffer_ptr(std::make_unique<char[]>(_buf_len)) {
    }
 
    uint32_t detail::reverse_iterator::open(const fc::path& block_file_name) {
+      // a prefetch of a previously opened file must not read from _file while it is replaced
+      wait_for_prefetch();
+      _prefetch = std::future<void>();
+
       _block_file_name = block_file_name.generic_string();
       _file.reset( FC_FOPEN(_block_file_name.c_str(), "r"));
       EOS_ASSERT( _file, block_log_exception, "Could not open Block log file at '${blocks_log}'", ("blocks_log", _block_file_name) );
@@ -786,7 +1061,8 @@ namespace eosio { namespace chain {
       EOS_ASSERT( _eof_position_in_file > 0, block_log_exception, "Block log file at '${blocks_log}' could not be read.", ("blocks_log", _block_file_name) );
       _current_position_in_file = _eof_position_in_file - _position_size;
 
-      update_buffer();
+      // the reads of open use _file directly, the prefetch is only started once they are done
+      update_buffer(false);
 
       _blocks_found = 0;
       char* buf = _buffer_ptr.get();
@@ -811,6 +1087,7 @@ namespace eosio { namespace chain {
       }
       _last_block_num = fc::endian_reverse_u32(bnum) + 1;                     //convert from big endian to little endian and add 1
       _blocks_expected = _last_block_num - _first_block_num + 1;
+      start_prefetch();
       return _blocks_expected;
    }
 
@@ -852,9 +1129,20 @@ namespace eosio { namespace chain {
       return block_location_in_file;
    }
 
-   void detail::reverse_iterator::update_buffer() {
+   void detail::reverse_iterator::update_buffer(bool prefetch) {
       EOS_ASSERT( _current_position_in_file != block_log::npos, block_log_exception, "Block log file not setup properly" );
 
+      if (_prefetch.valid()) {
+         _prefetch.get();
+         if (_current_position_in_file >= _prefetch_start && _current_position_in_file + _position_size <= _prefetch_end) {
+            std::swap(_buffer_ptr, _prefetch_buffer_ptr);
+            _start_of_buffer_position = _prefetch_start;
+            _end_of_buffer_position = _prefetch_end;
+            if (prefetch) start_prefetch();
+            return;
+         }
+      }
+
       // since we need to read in a new section, just need to ensure the next position is at the very end of the buffer
       _end_of_buffer_position = _current_position_in_file + _position_size;
       if (_end_of_buffer_position < _buf_len) {
@@ -864,13 +1152,35 @@ namespace eosio { namespace chain {
          _start_of_buffer_position = _end_of_buffer_position - _buf_len;
       }
 
-      auto status = fseek(_file.get(), _start_of_buffer_position, SEEK_SET);
-      EOS_ASSERT( status == 0, block_log_exception, "Could not seek in '${blocks_log}' to position: ${pos}. Returned status: ${status}", ("blocks_log", _block_file_name)("pos", _start_of_buffer_position)("status", status) );
-      char* buf = _buffer_ptr.get();
-      auto size = fread((void*)buf, (_end_of_buffer_position - _start_of_buffer_position), 1, _file.get());//read tail of blocks.log file into buf
+      read_section(_buffer_ptr.get(), _start_of_buffer_position, _end_of_buffer_position);
+      if (prefetch) start_prefetch();
+   }
+
+   void detail::reverse_iterator::read_section(char* buf, uint64_t start, uint64_t end) {
+      auto status = fseek(_file.get(), start, SEEK_SET);
+      EOS_ASSERT( status == 0, block_log_exception, "Could not seek in '${blocks_log}' to position: ${pos}. Returned status: ${status}", ("blocks_log", _block_file_name)("pos", start)("status", status) );
+      auto size = fread((void*)buf, (end - start), 1, _file.get());//read section of blocks.log file into buf
       EOS_ASSERT( size == 1, block_log_exception, "blocks.log read fails" );
    }
 
+   void detail::reverse_iterator::wait_for_prefetch() {
+      if (_prefetch.valid())
+         _prefetch.wait();
+   }
+
+   void detail::reverse_iterator::start_prefetch() {
+      EOS_ASSERT( !_prefetch.valid(), block_log_exception, "Block log prefetch started while another is in flight" );
+      if (_start_of_buffer_position == 0)
+         return;
+
+      // overlap by one position so that a position straddling the start of the current buffer is still covered
+      _prefetch_end = _start_of_buffer_position + _position_size;
+      _prefetch_start = _prefetch_end > _buf_len ? _prefetch_end - _buf_len : 0;
+      _prefetch = std::async(std::launch::async, [this]() {
+         read_section(_prefetch_buffer_ptr.get(), _prefetch_start, _prefetch_end);
+      });
+   }
+
    detail::index_writer::index_writer(const fc::path& block_index_name, uint32_t blocks_expected)
    : _file(nullptr, &fclose)
    , _block_index_name(block_index_name.generic_string())
@@ -1065,13 +1375,378 @@ namespace eosio { namespace chain {
       return true;
    }
 
-   trim_data::trim_data(fc::path block_dir) {
+   namespace detail {
+      // blocks are copied in runs of whole blocks of about this size, so that their trailing positions can be
+      // adjusted in memory, and their index entries are read and written this many at a time
+      constexpr uint64_t block_copy_run_size = 64 * 1024 * 1024;
+      constexpr uint32_t block_copy_index_entries = 1024 * 1024;
+
+      // copy bytes of one file to the current position of another, in the kernel where it can
+      void copy_file_bytes(FILE* in, uint64_t offset, uint64_t size, FILE* out, const fc::path& out_name) {
+#if defined(__linux__)
+         EOS_ASSERT( fflush(out) == 0, block_log_exception, "failed writing to ${file}", ("file", out_name.string()) );
+         loff_t in_off = offset;
+         loff_t out_off = ftell(out);
+         while (size > 0) {
+            const auto copied = copy_file_range(fileno(in), &in_off, fileno(out), &out_off, size, 0);
+            if (copied <= 0)
+               break; // not supported for these files, the rest is copied below
+            size -= copied;
+         }
+         offset = in_off;
+         EOS_ASSERT( fseek(out, out_off, SEEK_SET) == 0, block_log_exception, "${file} seek failed", ("file", out_name.string()) );
+#endif
+         std::vector<char> buf(std::min<uint64_t>(size, block_copy_run_size));
+         EOS_ASSERT( size == 0 || fseek(in, offset, SEEK_SET) == 0, block_log_exception, "blocks.log seek failed" );
+         while (size > 0) {
+            const auto n = std::min<uint64_t>(size, buf.size());
+            EOS_ASSERT( fread(buf.data(), n, 1, in) == 1, block_log_exception, "blocks.log read failed" );
+            EOS_ASSERT( fwrite(buf.data(), n, 1, out) == 1, block_log_exception, "failed writing to ${file}", ("file", out_name.string()) );
+            size -= n;
+         }
+      }
+
+      // write the header of a new block log starting at first_block, the same as the log's own if it starts there too
+      void write_block_log_header(trim_data& log, uint32_t first_block, FILE* out, const fc::path& out_name) {
+         if (first_block == log.first_block) {
+            copy_file_bytes(log.blk_in, 0, log.first_block_pos, out, out_name);
+            return;
+         }
+         // a version 3 block log that does not start at block 1 only needs the chain id in its header
+         static_assert( block_log::max_supported_version == 3,
+                        "Code was written to support version 3 format, need to update this code for latest format." );
+         const uint32_t version = block_log::max_supported_version;
+         auto packed_chain_id = fc::raw::pack(log.chain_id);
+         const auto totem = block_log::npos;
+         bool ok = fwrite(&version, sizeof(version), 1, out) == 1 &&
+                   fwrite(&first_block, sizeof(first_block), 1, out) == 1 &&
+                   fwrite(packed_chain_id.data(), packed_chain_id.size(), 1, out) == 1 &&
+                   fwrite(&totem, sizeof(totem), 1, out) == 1;
+         EOS_ASSERT( ok, block_log_exception, "failed writing header of ${file}", ("file", out_name.string()) );
+      }
+
+      /**
+       * Append blocks first_block through last_block of a log to a new log and its index.  Every block moves by the
+       * same number of bytes, so its trailing position and its index entry are adjusted by that shift instead of being
+       * derived block by block, and the blocks are copied in large runs, in the kernel when they do not move at all.
+       */
+      void append_block_range(trim_data& log, uint32_t first_block, uint32_t last_block,
+                              FILE* out_blocks, FILE* out_index, const fc::path& out_name) {
+         const uint64_t log_end = fc::file_size(log.block_file_name);
+         std::vector<uint64_t> positions;
+         std::vector<char> run;
+         uint64_t shift = 0;
+         for (uint32_t n = first_block; n <= last_block;) {
+            const uint32_t count = std::min<uint64_t>(uint64_t(last_block) - n + 1, block_copy_index_entries);
+            // the positions of blocks n through n + count - 1, followed by where the last of them ends
+            const bool ends_at_log_end = n + count - 1 == log.last_block;
+            positions.resize(count + (ends_at_log_end ? 0 : 1));
+            auto status = fseek(log.ind_in, log.block_index(n), SEEK_SET);
+            EOS_ASSERT( status == 0, block_log_exception, "cannot seek to ${file} entry for block ${b}", ("file", log.index_file_name.string())("b", n) );
+            EOS_ASSERT( fread(positions.data(), sizeof(uint64_t), positions.size(), log.ind_in) == positions.size(), block_log_exception,
+                        "cannot read ${file} entries from block ${b}", ("file", log.index_file_name.string())("b", n) );
+            if (ends_at_log_end)
+               positions.push_back(log_end);
+            for (uint32_t i = 0; i < count; ++i) {
+               EOS_ASSERT( positions[i + 1] > positions[i] + sizeof(uint64_t), block_log_exception,
+                           "invalid position of block ${n} in ${file}", ("n", n + i)("file", log.block_file_name.string()) );
+            }
+            if (n == first_block)
+               shift = uint64_t(ftell(out_blocks)) - positions[0];
+
+            if (shift == 0) {
+               copy_file_bytes(log.blk_in, positions[0], positions[count] - positions[0], out_blocks, out_name);
+            } else {
+               for (uint32_t begin = 0; begin < count;) {
+                  uint32_t end = begin + 1;
+                  while (end < count && positions[end + 1] - positions[begin] <= block_copy_run_size)
+                     ++end;
+                  run.resize(positions[end] - positions[begin]);
+                  status = fseek(log.blk_in, positions[begin], SEEK_SET);
+                  EOS_ASSERT( status == 0, block_log_exception, "blocks.log seek failed" );
+                  EOS_ASSERT( fread(run.data(), run.size(), 1, log.blk_in) == 1, block_log_exception,
+                              "blocks.log read of block ${n} failed", ("n", n + begin) );
+                  // the trailing position of each block refers to its own start
+                  for (uint32_t i = begin; i < end; ++i) {
+                     char* trailing = run.data() + (positions[i + 1] - sizeof(uint64_t) - positions[begin]);
+                     uint64_t pos;
+                     memcpy(&pos, trailing, sizeof(pos));
+                     EOS_ASSERT( pos == positions[i], block_log_exception, "block ${n} of ${file} does not end with its position",
+                                 ("n", n + i)("file", log.block_file_name.string()) );
+                     pos += shift;
+                     memcpy(trailing, &pos, sizeof(pos));
+                  }
+                  EOS_ASSERT( fwrite(run.data(), run.size(), 1, out_blocks) == 1, block_log_exception,
+                              "failed writing block ${n} to ${file}", ("n", n + begin)("file", out_name.string()) );
+                  begin = end;
+               }
+            }
+            for (uint32_t i = 0; i < count; ++i)
+               positions[i] += shift;
+            EOS_ASSERT( fwrite(positions.data(), sizeof(uint64_t), count, out_index) == count, block_log_exception,
+                        "failed writing the index of ${file}", ("file", out_name.string()) );
+            n += count;
+         }
+      }
+
+      /// a block log and index being written, removed again unless close() succeeds
+      struct new_block_log {
+         new_block_log(const fc::path& block_file_name, const fc::path& index_file_name)
+         : block_file_name(block_file_name)
+         , index_file_name(index_file_name)
+         , blocks(FC_FOPEN(block_file_name.generic_string().c_str(), "wb"), &fclose)
+         , index(FC_FOPEN(index_file_name.generic_string().c_str(), "wb"), &fclose) {
+            if (!blocks || !index)
+               remove();
+            EOS_ASSERT( blocks, block_log_exception, "cannot create ${file}", ("file", block_file_name.string()) );
+            EOS_ASSERT( index, block_log_exception, "cannot create ${file}", ("file", index_file_name.string()) );
+         }
+
+         ~new_block_log() {
+            if (!closed)
+               remove();
+         }
+
+         void close() {
+            bool ok = fclose(blocks.release()) == 0;
+            ok = fclose(index.release()) == 0 && ok;
+            EOS_ASSERT( ok, block_log_exception, "failed writing ${file}", ("file", block_file_name.string()) );
+            closed = true;
+         }
+
+         void remove() {
+            blocks.reset();
+            index.reset();
+            boost::system::error_code ec;
+            boost::filesystem::remove(block_file_name.generic_string(), ec);
+            boost::filesystem::remove(index_file_name.generic_string(), ec);
+         }
+
+         fc::path    block_file_name;
+         fc::path    index_file_name;
+         unique_file blocks;
+         unique_file index;
+         bool        closed = false;
+      };
+
+      /**
+       * Checks, before any output is opened, that writing @ref outputs cannot touch the input block logs: output_dir
+       * must not be input_dir under another name, and none of the outputs may exist yet.
+       */
+      void check_block_log_outputs(const fc::path& input_dir, const fc::path& output_dir, const std::vector<fc::path>& outputs) {
+         boost::system::error_code ec;
+         const bool same_dir = input_dir == output_dir ||
+                               boost::filesystem::equivalent(input_dir.generic_string(), output_dir.generic_string(), ec);
+         EOS_ASSERT( !same_dir, block_log_exception, "block_dir and output_dir need to be different directories" );
+         for (const auto& p : outputs) {
+            EOS_ASSERT( !fc::exists(p), block_log_exception, "${file} already exists", ("file", p.string()) );
+         }
+      }
+
+      fc::path block_range_file_name(const fc::path& dir, uint32_t first_block, uint32_t last_block, const char* ext) {
+         return dir / ("blocks-" + std::to_string(first_block) + "-" + std::to_string(last_block) + ext);
+      }
+
+      /// write blocks first_block through last_block of a log to a new compressed shard, removed again unless complete
+      void write_block_log_shard(trim_data& log, uint32_t first_block, uint32_t last_block, block_codec codec,
+                                 uint32_t blocks_per_chunk, const fc::path& out_name) {
+         unique_file out(FC_FOPEN(out_name.generic_string().c_str(), "wb"), &fclose);
+         EOS_ASSERT( out, block_log_exception, "cannot create ${file}", ("file", out_name.string()) );
+         bool complete = false;
+         auto remove_partial = fc::make_scoped_exit([&]() {
+            if (!complete) {
+               out.reset();
+               boost::system::error_code ec;
+               boost::filesystem::remove(out_name.generic_string(), ec);
+            }
+         });
+         auto write = [&](const char* d, size_t size) {
+            EOS_ASSERT( size == 0 || fwrite(d, size, 1, out.get()) == 1, block_log_exception,
+                        "failed writing to ${file}", ("file", out_name.string()) );
+         };
+
+         const auto header = fc::raw::pack(shard_header{shard_magic, shard_version, static_cast<uint8_t>(codec),
+                                                        first_block, last_block, log.chain_id});
+         EOS_ASSERT( header.size() == shard_header_size, block_log_exception, "unexpected size of a block log shard header" );
+         write(header.data(), header.size());
+
+         const uint64_t log_end = fc::file_size(log.block_file_name);
+         std::vector<shard_chunk> chunks;
+         std::vector<uint64_t> positions;
+         std::vector<char> run;
+         std::vector<char> chunk;
+         uint64_t pos = header.size();
+         for (uint32_t n = first_block; n <= last_block;) {
+            const uint32_t count = std::min<uint64_t>(uint64_t(last_block) - n + 1, blocks_per_chunk);
+            // the positions of blocks n through n + count - 1, followed by where the last of them ends
+            const bool ends_at_log_end = n + count - 1 == log.last_block;
+            positions.resize(count + (ends_at_log_end ? 0 : 1));
+            auto status = fseek(log.ind_in, log.block_index(n), SEEK_SET);
+            EOS_ASSERT( status == 0, block_log_exception, "cannot seek to ${file} entry for block ${b}", ("file", log.index_file_name.string())("b", n) );
+            EOS_ASSERT( fread(positions.data(), sizeof(uint64_t), positions.size(), log.ind_in) == positions.size(), block_log_exception,
+                        "cannot read ${file} entries from block ${b}", ("file", log.index_file_name.string())("b", n) );
+            if (ends_at_log_end)
+               positions.push_back(log_end);
+            for (uint32_t i = 0; i < count; ++i) {
+               EOS_ASSERT( positions[i + 1] > positions[i] + sizeof(uint64_t), block_log_exception,
+                           "invalid position of block ${n} in ${file}", ("n", n + i)("file", log.block_file_name.string()) );
+            }
+
+            run.resize(positions[count] - positions[0]);
+            status = fseek(log.blk_in, positions[0], SEEK_SET);
+            EOS_ASSERT( status == 0, block_log_exception, "blocks.log seek failed" );
+            EOS_ASSERT( fread(run.data(), run.size(), 1, log.blk_in) == 1, block_log_exception,
+                        "blocks.log read of block ${n} failed", ("n", n) );
+
+            // a chunk is its blocks without their trailing positions, which only mean something in blocks.log
+            shard_chunk c{n, pos, 0, {}};
+            c.block_ends.reserve(count);
+            chunk.clear();
+            for (uint32_t i = 0; i < count; ++i) {
+               const char* b = run.data() + (positions[i] - positions[0]);
+               chunk.insert(chunk.end(), b, b + (positions[i + 1] - positions[i] - sizeof(uint64_t)));
+               EOS_ASSERT( chunk.size() <= std::numeric_limits<uint32_t>::max(), block_log_exception,
+                           "chunk of block ${n} is too big, use fewer blocks per chunk", ("n", n) );
+               c.block_ends.push_back(chunk.size());
+            }
+            const auto compressed = compress_block(codec, chunk.data(), chunk.size());
+            write(compressed.data(), compressed.size());
+            c.size = compressed.size();
+            pos += c.size;
+            chunks.emplace_back(std::move(c));
+            n += count;
+         }
+
+         const auto index = fc::raw::pack(chunks);
+         write(index.data(), index.size());
+         write((const char*)&pos, sizeof(pos));
+         EOS_ASSERT( fclose(out.release()) == 0, block_log_exception, "failed writing ${file}", ("file", out_name.string()) );
+         complete = true;
+      }
+   }
+
+   uint32_t block_log::extract_block_range(const fc::path& block_dir, const fc::path& output_dir,
+                                           uint32_t first_block, uint32_t last_block) {
+      const auto out_block_file = output_dir / "blocks.log";
+      const auto out_index_file = output_dir / "blocks.index";
+      detail::check_block_log_outputs(block_dir, output_dir, {out_block_file, out_index_file});
+      trim_data log(block_dir);
+      EOS_ASSERT( first_block <= last_block, block_log_exception,
+                  "first block ${f} is after last block ${l}", ("f", first_block)("l", last_block) );
+      first_block = std::max(first_block, log.first_block);
+      last_block = std::min(last_block, log.last_block);
+      EOS_ASSERT( first_block <= last_block, block_log_exception,
+                  "no blocks of ${file} are in the requested range", ("file", log.block_file_name.string()) );
+      // the index entries of both ends of the range point at those blocks
+      log.block_pos(first_block);
+      log.block_pos(last_block);
+      ilog("Extracting blocks ${first} through ${last} from ${dir} into ${out}",
+           ("first", first_block)("last", last_block)("dir", block_dir.generic_string())("out", output_dir.generic_string()));
+
+      fc::create_directories(output_dir);
+      detail::new_block_log out(out_block_file, out_index_file);
+      detail::write_block_log_header(log, first_block, out.blocks.get(), out.block_file_name);
+      detail::append_block_range(log, first_block, last_block, out.blocks.get(), out.index.get(), out.block_file_name);
+      out.close();
+      return last_block - first_block + 1;
+   }
+
+   uint32_t block_log::split_block_log(const fc::path& block_dir, const fc::path& output_dir, uint32_t blocks_per_file,
+                                       const optional<block_codec>& codec, uint32_t blocks_per_chunk) {
+      EOS_ASSERT( blocks_per_file > 0, block_log_exception, "cannot split into files of 0 blocks" );
+      EOS_ASSERT( !codec || blocks_per_chunk > 0, block_log_exception, "cannot compress chunks of 0 blocks" );
+      EOS_ASSERT( !codec || block_codec_supported(*codec), block_log_exception,
+                  "codec ${c} is not in this build", ("c", static_cast<uint32_t>(*codec)) );
+      trim_data log(block_dir);
+      // files end at multiples of blocks_per_file, so that the files of logs split alike line up
+      std::vector<std::pair<uint32_t, uint32_t>> ranges;
+      std::vector<fc::path> outputs;
+      for (uint64_t first = log.first_block; first <= log.last_block;) {
+         const uint32_t range_last = std::min<uint64_t>(log.last_block, ((first - 1) / blocks_per_file + 1) * blocks_per_file);
+         ranges.emplace_back(first, range_last);
+         if (codec) {
+            outputs.push_back(detail::block_range_file_name(output_dir, first, range_last, ".clog"));
+         } else {
+            outputs.push_back(detail::block_range_file_name(output_dir, first, range_last, ".log"));
+            outputs.push_back(detail::block_range_file_name(output_dir, first, range_last, ".index"));
+         }
+         first = uint64_t(range_last) + 1;
+      }
+      detail::check_block_log_outputs(block_dir, output_dir, outputs);
+      fc::create_directories(output_dir);
+      ilog("Splitting blocks ${first} through ${last} of ${dir} into files of ${n} blocks in ${out}",
+           ("first", log.first_block)("last", log.last_block)("dir", block_dir.generic_string())("n", blocks_per_file)
+           ("out", output_dir.generic_string()));
+
+      for (const auto& range : ranges) {
+         if (codec) {
+            detail::write_block_log_shard(log, range.first, range.second, *codec, blocks_per_chunk,
+                                          detail::block_range_file_name(output_dir, range.first, range.second, ".clog"));
+            continue;
+         }
+         detail::new_block_log out(detail::block_range_file_name(output_dir, range.first, range.second, ".log"),
+                                   detail::block_range_file_name(output_dir, range.first, range.second, ".index"));
+         detail::write_block_log_header(log, range.first, out.blocks.get(), out.block_file_name);
+         detail::append_block_range(log, range.first, range.second, out.blocks.get(), out.index.get(), out.block_file_name);
+         out.close();
+      }
+      return ranges.size();
+   }
+
+   uint32_t block_log::merge_block_logs(const fc::path& input_dir, const fc::path& output_dir) {
+      const auto out_block_file = output_dir / "blocks.log";
+      const auto out_index_file = output_dir / "blocks.index";
+      detail::check_block_log_outputs(input_dir, output_dir, {out_block_file, out_index_file});
+      // the last block of the blocks-<first>-<last>.log files of input_dir, by first block
+      std::map<uint32_t, uint32_t> ranges;
+      for (fc::directory_iterator it(input_dir), end; it != end; ++it) {
+         const auto name = (*it).filename().generic_string();
+         unsigned int first = 0, last = 0;
+         char ext[8] = {};
+         if (sscanf(name.c_str(), "blocks-%u-%u.%7s", &first, &last, ext) != 3 || std::string(ext) != "log")
+            continue;
+         EOS_ASSERT( first <= last && ranges.emplace(first, last).second, block_log_exception,
+                     "conflicting block log ${file} in ${dir}", ("file", name)("dir", input_dir.generic_string()) );
+      }
+      EOS_ASSERT( !ranges.empty(), block_log_exception, "no blocks-<first>-<last>.log files in ${dir}", ("dir", input_dir.generic_string()) );
+
+      fc::create_directories(output_dir);
+      detail::new_block_log out(out_block_file, out_index_file);
+      optional<chain_id_type> chain_id;
+      uint32_t next_block = ranges.begin()->first;
+      for (const auto& range : ranges) {
+         const auto block_file_name = detail::block_range_file_name(input_dir, range.first, range.second, ".log");
+         trim_data log(block_file_name, detail::block_range_file_name(input_dir, range.first, range.second, ".index"));
+         EOS_ASSERT( log.first_block == range.first && log.last_block == range.second, block_log_exception,
+                     "${file} holds blocks ${f} through ${l}", ("file", block_file_name.string())("f", log.first_block)("l", log.last_block) );
+         EOS_ASSERT( log.first_block == next_block, block_log_exception,
+                     "missing blocks ${f} through ${l} in ${dir}", ("f", next_block)("l", log.first_block - 1)("dir", input_dir.generic_string()) );
+         EOS_ASSERT( !chain_id || *chain_id == log.chain_id, block_log_exception,
+                     "${file} is of another chain", ("file", block_file_name.string()) );
+         if (!chain_id) {
+            chain_id = log.chain_id;
+            detail::write_block_log_header(log, log.first_block, out.blocks.get(), out.block_file_name);
+         }
+         detail::append_block_range(log, log.first_block, log.last_block, out.blocks.get(), out.index.get(), out.block_file_name);
+         next_block = log.last_block + 1;
+      }
+      out.close();
+      ilog("Merged blocks ${first} through ${last} of ${n} block logs into ${out}",
+           ("first", ranges.begin()->first)("last", next_block - 1)("n", ranges.size())("out", output_dir.generic_string()));
+      return next_block - ranges.begin()->first;
+   }
+
+   trim_data::trim_data(fc::path block_dir)
+   : trim_data(block_dir / "blocks.log", block_dir / "blocks.index") {
+   }
+
+   trim_data::trim_data(fc::path block_file, fc::path index_file)
+   : block_file_name(std::move(block_file))
+   , index_file_name(std::move(index_file)) {
 
       // code should follow logic in block_log::repair_log
 
       using namespace std;
-      block_file_name = block_dir / "blocks.log";
-      index_file_name = block_dir / "blocks.index";
       blk_in = FC_FOPEN(block_file_name.generic_string().c_str(), "rb");
       EOS_ASSERT( blk_in != nullptr, block_log_not_found, "cannot read file ${file}", ("file",block_file_name.string()) );
       ind_in = FC_FOPEN(index_file_name.generic_string().c_str(), "rb");
@@ -1,6 +1,8 @@
 #include <eosio/chain/block_state.hpp>
 #include <eosio/chain/exceptions.hpp>
 
+#include <atomic>
+
 namespace eosio { namespace chain {
 
    namespace {
@@ -101,4 +103,17 @@ namespace eosio { namespace chain {
    ,_cached_trxs( std::move(trx_metas) )
    {}
 
+   std::shared_ptr<const std::vector<char>> block_state::packed_block()const {
+      auto packed = std::atomic_load( &_packed_block );
+      if( !packed ) {
+         EOS_ASSERT( block, block_validate_exception, "block state ${id} has no block to pack", ("id", id) );
+         auto fresh = std::make_shared<const std::vector<char>>( fc::raw::pack( *block ) );
+         // a concurrent caller may have won the race, its bytes are identical so keep whichever was stored first
+         if( std::atomic_compare_exchange_strong( &_packed_block, &packed, fresh ) ) {
+            packed = std::move( fresh );
+         }
+      }
+      return packed;
+   }
+
 } } /// eosio::chain
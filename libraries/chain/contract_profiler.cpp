@@ -0,0 +1,41 @@
+#include <eosio/chain/contract_profiler.hpp>
+
+#include <algorithm>
+
+namespace eosio { namespace chain {
+
+void contract_profiler::record( account_name receiver, account_name account, action_name action, const counters& c ) {
+   auto& s = _shards[receiver.to_uint64_t() % shard_count];
+   std::lock_guard<std::mutex> g( s.mtx );
+   s.totals[std::make_tuple( receiver, account, action )] += c;
+}
+
+vector<contract_profiler::entry> contract_profiler::entries( size_t limit )const {
+   vector<entry> result;
+   for( const auto& s : _shards ) {
+      std::lock_guard<std::mutex> g( s.mtx );
+      for( const auto& t : s.totals ) {
+         entry e;
+         static_cast<counters&>( e ) = t.second;
+         std::tie( e.receiver, e.account, e.action ) = t.first;
+         result.emplace_back( std::move( e ) );
+      }
+   }
+   auto by_cpu = []( const entry& a, const entry& b ) { return a.billed_cpu_us > b.billed_cpu_us; };
+   if( limit < result.size() ) {
+      std::partial_sort( result.begin(), result.begin() + limit, result.end(), by_cpu );
+      result.resize( limit );
+   } else {
+      std::sort( result.begin(), result.end(), by_cpu );
+   }
+   return result;
+}
+
+void contract_profiler::clear() {
+   for( auto& s : _shards ) {
+      std::lock_guard<std::mutex> g( s.mtx );
+      s.totals.clear();
+   }
+}
+
+} } // eosio::chain
@@ -2,6 +2,7 @@
 #include <eosio/chain/transaction_context.hpp>
 
 #include <eosio/chain/block_log.hpp>
+#include <eosio/chain/state_checkpoint_log.hpp>
 #include <eosio/chain/fork_database.hpp>
 #include <eosio/chain/exceptions.hpp>
 
@@ -24,6 +25,8 @@
 #include <eosio/chain/resource_limits.hpp>
 #include <eosio/chain/chain_snapshot.hpp>
 #include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/state_prefetcher.hpp>
+#include <eosio/chain/transaction_dedup_filter.hpp>
 #include <eosio/chain/platform_timer.hpp>
 
 #include <chainbase/chainbase.hpp>
@@ -32,7 +35,12 @@
 #include <fc/scoped_exit.hpp>
 #include <fc/variant_object.hpp>
 
+#include <atomic>
 #include <new>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <optional>
 
 namespace eosio { namespace chain {
 
@@ -123,7 +131,10 @@ struct building_block {
    vector<transaction_metadata_ptr>      _pending_trx_metas;
    vector<transaction_receipt>           _pending_trx_receipts;
    vector<action_receipt>                _actions;
+   merkle_accumulator                    _action_merkle; ///< over the digests of _actions, unless _action_mroot is set
+   vector<table_access_set>              _access_sets; ///< only populated when tracking table access
    optional<checksum256_type>            _transaction_mroot;
+   optional<checksum256_type>            _action_mroot; ///< reused from a block this node validated before
 };
 
 struct assembled_block {
@@ -215,6 +226,75 @@ struct pending_state {
    }
 };
 
+/**
+ *  Writes one CSV row per block applied while replaying the block log: how long applying it took, how many
+ *  transactions and actions it held and which contract took the most time executing its actions.
+ */
+struct replay_profile {
+   explicit replay_profile( const fc::path& file )
+   :out( file.generic_string(), std::ios::out | std::ios::trunc )
+   {
+      EOS_ASSERT( out, misc_exception, "unable to open replay profile file ${f}", ("f", file.generic_string()) );
+      out << "block_num,timestamp,apply_us,transactions,actions,slowest_contract,slowest_contract_us\n";
+   }
+
+   void on_applied_transaction( const transaction_trace_ptr& trace ) {
+      if( !trace || !trace->receipt ) return;
+      for( const auto& at : trace->action_traces ) {
+         ++actions;
+         contract_us[at.receiver] += at.elapsed.count();
+      }
+   }
+
+   void write( const signed_block& b, const fc::microseconds& apply_time ) {
+      account_name slowest;
+      int64_t slowest_us = 0;
+      auto itr = std::max_element( contract_us.begin(), contract_us.end(),
+                                   []( const auto& l, const auto& r ) { return l.second < r.second; } );
+      if( itr != contract_us.end() ) {
+         slowest = itr->first;
+         slowest_us = itr->second;
+      }
+      out << b.block_num() << ',' << std::string( b.timestamp.to_time_point() ) << ',' << apply_time.count() << ','
+          << b.transactions.size() << ',' << actions << ',' << slowest.to_string() << ',' << slowest_us << '\n';
+      actions = 0;
+      contract_us.clear();
+   }
+
+   std::ofstream                    out;
+   uint64_t                         actions = 0;
+   flat_map<account_name, int64_t>  contract_us; ///< time spent in the actions of each receiver in the current block
+};
+
+/**
+ *  Logs how long each phase of opening the chain took, the time since the previous phase ended. The phases that run
+ *  on their own thread are timed with timed_startup_phase instead.
+ */
+class startup_timer {
+   public:
+      void phase_done( const char* phase ) {
+         const auto now = fc::time_point::now();
+         ilog( "startup: ${phase} in ${ms} ms", ("phase", phase)("ms", (now - last).count() / 1000) );
+         last = now;
+      }
+
+   private:
+      fc::time_point last = fc::time_point::now();
+};
+
+template<typename F>
+auto timed_startup_phase( const char* phase, F&& f ) {
+   startup_timer timer;
+   if constexpr( std::is_void_v<decltype(f())> ) {
+      f();
+      timer.phase_done( phase );
+   } else {
+      auto result = f();
+      timer.phase_done( phase );
+      return result;
+   }
+}
+
 struct controller_impl {
 
    // LLVM sets the new handler, we need to reset this to throw a bad_alloc exception so we can possibly exit cleanly
@@ -225,16 +305,21 @@ struct controller_impl {
 
    reset_new_handler              rnh; // placed here to allow for this to be set before constructing the other fields
    controller&                    self;
+   startup_timer                  startup_phases;
+   protocol_feature_manager       protocol_features; ///< ahead of fork_db, whose load checks the features of its blocks
+   fork_database                  fork_db;
+   // the fork database loads, and the block log opens and checks its index, while the state databases map
+   std::future<void>              fork_db_loaded;
+   std::future<block_log>         blog_opened;
    chainbase::database            db;
    chainbase::database            reversible_blocks; ///< a special database to persist blocks that have successfully been applied but are still reversible
    block_log                      blog;
+   optional<state_checkpoint_log> state_checkpoints; ///< only opened when recording checkpoints or when there are some to verify
    optional<pending_state>        pending;
    block_state_ptr                head;
-   fork_database                  fork_db;
    wasm_interface                 wasmif;
    resource_limits_manager        resource_limits;
    authorization_manager          authorization;
-   protocol_feature_manager       protocol_features;
    controller::config             conf;
    const chain_id_type            chain_id; // read by thread_pool threads, value will not be changed
    optional<fc::time_point>       replay_head_time;
@@ -243,7 +328,12 @@ struct controller_impl {
    optional<fc::microseconds>     subjective_cpu_leeway;
    bool                           trusted_producer_light_validation = false;
    uint32_t                       snapshot_head_block = 0;
+   table_lookup_cache::stats_by_contract table_lookup_stats; ///< only populated when caching table lookups
+   contract_profiler              profiler; ///< only populated when profiling contracts
+   std::unique_ptr<state_prefetcher> prefetcher; ///< only with state_prefetch_pages in mapped mode; after db, so it stops first
+   transaction_dedup_filter       dedup_filter; ///< every transaction_object in db, see record_in_dedup_filter
    named_thread_pool              thread_pool;
+   prioritized_task_queue         key_recovery_queue; ///< on thread_pool, block transactions ahead of relayed ones
    platform_timer                 timer;
 #if defined(EOSIO_EOS_VM_RUNTIME_ENABLED) || defined(EOSIO_EOS_VM_JIT_RUNTIME_ENABLED)
    vm::wasm_allocator                 wasm_alloc;
@@ -299,34 +389,56 @@ struct controller_impl {
    controller_impl( const controller::config& cfg, controller& s, protocol_feature_set&& pfs, const chain_id_type& chain_id )
    :rnh(),
     self(s),
+    protocol_features( std::move(pfs) ),
+    fork_db( cfg.state_dir ),
+    fork_db_loaded( std::async( std::launch::async, [this]() {
+       timed_startup_phase( "fork database loaded", [this]() {
+          fork_db.open( [this]( block_timestamp_type timestamp,
+                                const flat_set<digest_type>& cur_features,
+                                const vector<digest_type>& new_features )
+                               { check_protocol_features( timestamp, cur_features, new_features ); }
+          );
+       } );
+    } ) ),
+    blog_opened( std::async( std::launch::async, [blocks_dir = cfg.blocks_dir]() {
+       return timed_startup_phase( "block log opened", [&]() { return block_log( blocks_dir ); } );
+    } ) ),
     db( cfg.state_dir,
         cfg.read_only ? database::read_only : database::read_write,
         cfg.state_size, false, cfg.db_map_mode, cfg.db_hugepage_paths ),
     reversible_blocks( cfg.blocks_dir/config::reversible_blocks_dir_name,
         cfg.read_only ? database::read_only : database::read_write,
         cfg.reversible_cache_size, false, cfg.db_map_mode, cfg.db_hugepage_paths ),
-    blog( cfg.blocks_dir ),
-    fork_db( cfg.state_dir ),
-    wasmif( cfg.wasm_runtime, cfg.eosvmoc_tierup, db, cfg.state_dir, cfg.eosvmoc_config ),
+    blog( opened_block_log() ),
+    wasmif( cfg.wasm_runtime, cfg.eosvmoc_tierup, cfg.persistent_wasm_module_cache, cfg.wasm_module_cache_size, cfg.wasm_instantiation_cache_size,
+            db, cfg.state_dir, cfg.eosvmoc_config ),
     resource_limits( db ),
     authorization( s, db ),
-    protocol_features( std::move(pfs) ),
     conf( cfg ),
     chain_id( chain_id ),
     read_mode( cfg.read_mode ),
-    thread_pool( "chain", cfg.thread_pool_size )
+    thread_pool( "chain", cfg.thread_pool_size, cfg.thread_pool_cpus ),
+    key_recovery_queue( thread_pool.get_executor() )
    {
-      fork_db.open( [this]( block_timestamp_type timestamp,
-                            const flat_set<digest_type>& cur_features,
-                            const vector<digest_type>& new_features )
-                           { check_protocol_features( timestamp, cur_features, new_features ); }
-      );
+      if( cfg.state_prefetch_pages > 0 && cfg.db_map_mode == pinnable_mapped_file::map_mode::mapped )
+         prefetcher = std::make_unique<state_prefetcher>( cfg.state_prefetch_pages );
+      startup_phases.phase_done( "wasm runtime and checktime timer initialized" );
+      fork_db_loaded.get();
+      startup_phases.phase_done( "waited for the fork database" );
 
       set_activation_handler<builtin_protocol_feature_t::preactivate_feature>();
       set_activation_handler<builtin_protocol_feature_t::replace_deferred>();
       set_activation_handler<builtin_protocol_feature_t::get_sender>();
       set_activation_handler<builtin_protocol_feature_t::webauthn_key>();
       set_activation_handler<builtin_protocol_feature_t::wtmsig_block_signatures>();
+      set_activation_handler<builtin_protocol_feature_t::db_read_range>();
+
+      blog.set_durability( cfg.block_log_durability );
+
+      const auto checkpoints_path = cfg.blocks_dir / config::state_checkpoints_filename;
+      if( !cfg.read_only && (cfg.state_checkpoint_interval > 0 || fc::exists( checkpoints_path )) ) {
+         state_checkpoints.emplace( checkpoints_path );
+      }
 
       self.irreversible_block.connect([this](const block_state_ptr& bsp) {
          wasmif.current_lib(bsp->block_num);
@@ -414,6 +526,7 @@ struct controller_impl {
                apply_block( *bitr, controller::block_status::complete, trx_meta_cache_lookup{} );
                head = (*bitr);
                fork_db.mark_valid( head );
+               checkpoint_state( head );
             }
 
             emit( self.irreversible_block, *bitr );
@@ -421,7 +534,7 @@ struct controller_impl {
             db.commit( (*bitr)->block_num );
             root_id = (*bitr)->id;
 
-            blog.append( (*bitr)->block );
+            blog.append( (*bitr)->block, *(*bitr)->packed_block() );
 
             auto rbitr = rbi.begin();
             while( rbitr != rbi.end() && rbitr->blocknum <= (*bitr)->block_num ) {
@@ -474,18 +587,55 @@ struct controller_impl {
       auto blog_head_time = blog_head->timestamp.to_time_point();
       replay_head_time = blog_head_time;
       auto start_block_num = head->block_num + 1;
+      const uint32_t replay_end_num = conf.terminate_at_block > 0 ? std::min( conf.terminate_at_block, blog_head->block_num() )
+                                                                  : blog_head->block_num();
       auto start = fc::time_point::now();
 
       std::exception_ptr except_ptr;
 
-      if( start_block_num <= blog_head->block_num() ) {
+      if( start_block_num <= replay_end_num ) {
          ilog( "existing block log, attempting to replay from ${s} to ${n} blocks",
-               ("s", start_block_num)("n", blog_head->block_num()) );
+               ("s", start_block_num)("n", replay_end_num) );
          try {
-            while( auto next = blog.read_block_by_num( head->block_num + 1 ) ) {
+            // Reading and unpacking blocks is done on a dedicated thread, overlapping with block application on this
+            // thread. Only the prefetch thread touches the block log until the pool is stopped below.
+            named_thread_pool prefetch_pool( "replay", 1 );
+            std::deque<std::future<signed_block_ptr>> prefetched;
+            uint32_t next_to_read = start_block_num;
+            const uint32_t last_to_read = replay_end_num;
+            const size_t prefetch_depth = std::max<uint32_t>( conf.replay_prefetch_depth, 1 );
+            auto prefetch = [&]() {
+               while( prefetched.size() < prefetch_depth && next_to_read <= last_to_read ) {
+                  prefetched.emplace_back( async_thread_pool( prefetch_pool.get_executor(), [this, n = next_to_read]() {
+                     return blog.read_block_by_num( n );
+                  } ) );
+                  ++next_to_read;
+               }
+            };
+            auto stop_prefetch = fc::make_scoped_exit( [&prefetch_pool]() { prefetch_pool.stop(); } );
+
+            optional<replay_profile> profile;
+            optional<boost::signals2::scoped_connection> profile_connection;
+            if( !conf.replay_profile_file.empty() ) {
+               profile.emplace( conf.replay_profile_file );
+               profile_connection.emplace( self.applied_transaction.connect(
+                  [&profile]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> t ) {
+                     profile->on_applied_transaction( std::get<0>(t) );
+                  } ) );
+               ilog( "writing the replay profile of each block to ${f}", ("f", conf.replay_profile_file.generic_string()) );
+            }
+
+            prefetch();
+            while( !prefetched.empty() ) {
+               auto next = prefetched.front().get();
+               prefetched.pop_front();
+               if( !next ) break;
+               prefetch();
+               const auto apply_start = fc::time_point::now();
                replay_push_block( next, controller::block_status::irreversible );
+               if( profile ) profile->write( *next, fc::time_point::now() - apply_start );
                if( next->block_num() % 500 == 0 ) {
-                  ilog( "${n} of ${head}", ("n", next->block_num())("head", blog_head->block_num()) );
+                  ilog( "${n} of ${head}", ("n", next->block_num())("head", replay_end_num) );
                   if( shutdown() ) break;
                }
             }
@@ -516,7 +666,8 @@ struct controller_impl {
          ilog( "no irreversible blocks need to be replayed" );
       }
 
-      if( !except_ptr && !shutdown() ) {
+      const bool terminated = conf.terminate_at_block > 0 && head->block_num >= conf.terminate_at_block;
+      if( !except_ptr && !shutdown() && !terminated ) {
          int rev = 0;
          while( auto obj = reversible_blocks.find<reversible_block_object,by_num>(head->block_num+1) ) {
             ++rev;
@@ -536,15 +687,27 @@ struct controller_impl {
       }
    }
 
+   /// for the initializer of blog, waits for the block log opened on another thread
+   block_log opened_block_log() {
+      startup_phases.phase_done( "state databases mapped" );
+      block_log b = blog_opened.get();
+      startup_phases.phase_done( "waited for the block log" );
+      return b;
+   }
+
    void startup(std::function<bool()> shutdown, const snapshot_reader_ptr& snapshot) {
       EOS_ASSERT( snapshot, snapshot_exception, "No snapshot reader provided" );
       ilog( "Starting initialization from snapshot, this may take a significant amount of time" );
       try {
          snapshot->validate();
          if( blog.head() ) {
-            read_from_snapshot( snapshot, blog.first_block_num(), blog.head()->block_num() );
+            timed_startup_phase( "snapshot read", [&]() {
+               read_from_snapshot( snapshot, blog.first_block_num(), blog.head()->block_num() );
+            } );
          } else {
-            read_from_snapshot( snapshot, 0, std::numeric_limits<uint32_t>::max() );
+            timed_startup_phase( "snapshot read", [&]() {
+               read_from_snapshot( snapshot, 0, std::numeric_limits<uint32_t>::max() );
+            } );
             const uint32_t lib_num = head->block_num;
             EOS_ASSERT( lib_num > 0, snapshot_exception,
                         "Snapshot indicates controller head at block number 0, but that is not allowed. "
@@ -677,6 +840,13 @@ struct controller_impl {
 
       protocol_features.init( db );
 
+      dedup_filter.clear();
+      for( const auto& t : db.get_index<transaction_multi_index>().indices() )
+         dedup_filter.add( t.trx_id, t.expiration );
+
+      if( conf.key_account_index )
+         authorization.rebuild_key_account_index();
+
       const auto& rbi = reversible_blocks.get_index<reversible_block_index,by_num>();
       auto last_block_num = lib_num;
 
@@ -771,6 +941,12 @@ struct controller_impl {
       controller_index_set::add_indices(db);
       contract_database_index_set::add_indices(db);
 
+      // the layout of the authorization indices changed with version 3, existing state of an older version is refused
+      // before they are opened over it
+      const auto& header_idx = db.get_index<database_header_multi_index>().indices();
+      if( header_idx.begin() != header_idx.end() )
+         header_idx.begin()->validate();
+
       authorization.add_indices();
       resource_limits.add_indices();
    }
@@ -785,28 +961,32 @@ struct controller_impl {
                   */
    }
 
-   void add_contract_tables_to_snapshot( const snapshot_writer_ptr& snapshot ) const {
-      snapshot->write_section("contract_tables", [this]( auto& section ) {
-         index_utils<table_id_multi_index>::walk(db, [this, &section]( const table_id_object& table_row ){
-            // add a row for the table
-            section.add_row(table_row, db);
+   void add_contract_table_to_snapshot( snapshot_writer::section_writer& section, const table_id_object& table_row ) const {
+      // add a row for the table
+      section.add_row(table_row, db);
 
-            // followed by a size row and then N data rows for each type of table
-            contract_database_index_set::walk_indices([this, &section, &table_row]( auto utils ) {
-               using utils_t = decltype(utils);
-               using value_t = typename decltype(utils)::index_t::value_type;
-               using by_table_id = object_to_table_id_tag_t<value_t>;
+      // followed by a size row and then N data rows for each type of table
+      contract_database_index_set::walk_indices([this, &section, &table_row]( auto utils ) {
+         using utils_t = decltype(utils);
+         using value_t = typename decltype(utils)::index_t::value_type;
+         using by_table_id = object_to_table_id_tag_t<value_t>;
 
-               auto tid_key = boost::make_tuple(table_row.id);
-               auto next_tid_key = boost::make_tuple(table_id_object::id_type(table_row.id._id + 1));
+         auto tid_key = boost::make_tuple(table_row.id);
+         auto next_tid_key = boost::make_tuple(table_id_object::id_type(table_row.id._id + 1));
 
-               unsigned_int size = utils_t::template size_range<by_table_id>(db, tid_key, next_tid_key);
-               section.add_row(size, db);
+         unsigned_int size = utils_t::template size_range<by_table_id>(db, tid_key, next_tid_key);
+         section.add_row(size, db);
 
-               utils_t::template walk_range<by_table_id>(db, tid_key, next_tid_key, [this, &section]( const auto &row ) {
-                  section.add_row(row, db);
-               });
-            });
+         utils_t::template walk_range<by_table_id>(db, tid_key, next_tid_key, [this, &section]( const auto &row ) {
+            section.add_row(row, db);
+         });
+      });
+   }
+
+   void add_contract_tables_to_snapshot( const snapshot_writer_ptr& snapshot ) const {
+      snapshot->write_section("contract_tables", [this]( auto& section ) {
+         index_utils<table_id_multi_index>::walk(db, [this, &section]( const table_id_object& table_row ){
+            add_contract_table_to_snapshot( section, table_row );
          });
       });
    }
@@ -840,13 +1020,62 @@ struct controller_impl {
       });
    }
 
+   using snapshot_section_group = std::function<void( const snapshot_writer_ptr& )>;
+
+   /// groups of sections, in snapshot order, that only read the state database and can therefore be written independently
+   std::vector<snapshot_section_group> snapshot_section_groups() const {
+      return {
+         [this]( const snapshot_writer_ptr& s ) { add_controller_indices_to_snapshot( s ); },
+         [this]( const snapshot_writer_ptr& s ) { add_contract_tables_to_snapshot( s ); },
+         [this]( const snapshot_writer_ptr& s ) { authorization.add_to_snapshot( s ); },
+         [this]( const snapshot_writer_ptr& s ) { resource_limits.add_to_snapshot( s ); }
+      };
+   }
+
    void add_to_snapshot( const snapshot_writer_ptr& snapshot ) const {
+      const auto groups = snapshot_section_groups();
+
+      auto ostream_snapshot = std::dynamic_pointer_cast<ostream_snapshot_writer>( snapshot );
+      if( !ostream_snapshot || std::thread::hardware_concurrency() <= 1 ) {
+         for( const auto& g : groups ) {
+            g( snapshot );
+         }
+         return;
+      }
+
+      // the contract tables, the bulk of the state, are streamed straight to the snapshot while the other groups are
+      // serialized into their own buffers concurrently, then appended around them in the canonical order so the
+      // resulting file is identical to one written sequentially; each buffer is released chunk by chunk as it is appended
+      const size_t streamed_group = 1;
+      named_thread_pool snapshot_pool( "snapshot", std::min<size_t>( groups.size() - 1, std::thread::hardware_concurrency() ) );
+      auto stop_pool = fc::make_scoped_exit( [&snapshot_pool]() { snapshot_pool.stop(); } );
+
+      std::vector<std::future<std::shared_ptr<section_buffer_snapshot_writer>>> serialized( groups.size() );
+      for( size_t i = 0; i < groups.size(); ++i ) {
+         if( i == streamed_group ) continue;
+         serialized[i] = async_thread_pool( snapshot_pool.get_executor(), [&g = groups[i]]() {
+            auto buffer = std::make_shared<section_buffer_snapshot_writer>();
+            g( buffer );
+            return buffer;
+         } );
+      }
+
+      for( size_t i = 0; i < groups.size(); ++i ) {
+         if( i == streamed_group ) {
+            groups[i]( snapshot );
+         } else {
+            ostream_snapshot->append_sections( *serialized[i].get() );
+         }
+      }
+   }
+
+   void add_controller_indices_to_snapshot( const snapshot_writer_ptr& snapshot ) const {
       snapshot->write_section<chain_snapshot_header>([this]( auto &section ){
          section.add_row(chain_snapshot_header(), db);
       });
 
       snapshot->write_section<block_state>([this]( auto &section ){
-         section.template add_row<block_header_state>(*fork_db.head(), db);
+         section.template add_row<block_header_state>(*head, db);
       });
 
       controller_index_set::walk_indices([this, &snapshot]( auto utils ){
@@ -868,11 +1097,6 @@ struct controller_impl {
             });
          });
       });
-
-      add_contract_tables_to_snapshot(snapshot);
-
-      authorization.add_to_snapshot(snapshot);
-      resource_limits.add_to_snapshot(snapshot);
    }
 
    static fc::optional<genesis_state> extract_legacy_genesis_state( snapshot_reader& snapshot, uint32_t version ) {
@@ -996,6 +1220,91 @@ struct controller_impl {
       return enc.result();
    }
 
+   digest_type calculate_integrity_merkle_root() const {
+      using section_hashes_type = std::vector<section_hash_snapshot_writer::section_hash>;
+
+      // the contract tables, the bulk of the state, are hashed a table at a time rather than as one section
+      const size_t contract_tables_group = 1;
+      auto groups = snapshot_section_groups();
+      groups.erase( groups.begin() + contract_tables_group );
+
+      const auto num_threads = std::max<size_t>( 1, std::thread::hardware_concurrency() );
+      named_thread_pool hash_pool( "snaphash", num_threads );
+      auto stop_pool = fc::make_scoped_exit( [&hash_pool]() { hash_pool.stop(); } );
+
+      std::vector<std::future<section_hashes_type>> group_hashes;
+      group_hashes.reserve( groups.size() );
+      for( const auto& g : groups ) {
+         group_hashes.emplace_back( async_thread_pool( hash_pool.get_executor(), [&g]() {
+            auto hash_writer = std::make_shared<section_hash_snapshot_writer>();
+            g( hash_writer );
+            return hash_writer->section_hashes();
+         } ) );
+      }
+
+      // split into ranges of table ids, several per thread so a few large tables do not leave the other threads idle
+      const auto& tables = db.get_index<table_id_multi_index, by_id>();
+      std::vector<std::future<section_hashes_type>> table_hashes;
+      if( !tables.empty() ) {
+         const int64_t first = tables.begin()->id._id;
+         const int64_t end = tables.rbegin()->id._id + 1;
+         const int64_t num_ranges = std::min<int64_t>( end - first, num_threads * 4 );
+         table_hashes.reserve( num_ranges );
+         for( int64_t i = 0; i < num_ranges; ++i ) {
+            const int64_t lo = first + (end - first) * i / num_ranges;
+            const int64_t hi = first + (end - first) * (i + 1) / num_ranges;
+            table_hashes.emplace_back( async_thread_pool( hash_pool.get_executor(), [this, &tables, lo, hi]() {
+               auto hash_writer = std::make_shared<section_hash_snapshot_writer>();
+               for( auto itr = tables.lower_bound( table_id_object::id_type( lo ) ); itr != tables.end() && itr->id._id < hi; ++itr ) {
+                  hash_writer->write_section( "contract_tables", [this, &table_row = *itr]( auto& section ) {
+                     add_contract_table_to_snapshot( section, table_row );
+                  } );
+               }
+               return hash_writer->section_hashes();
+            } ) );
+         }
+      }
+
+      // one leaf per section, and per contract table, binding the section name to the digest of its rows, in
+      // snapshot order; the leaves do not depend on how the tables were split between the threads
+      vector<digest_type> leaves;
+      auto add_leaves = [&leaves]( std::future<section_hashes_type>& f ) {
+         for( const auto& h : f.get() ) {
+            leaves.emplace_back( digest_type::hash( h ) );
+         }
+      };
+      for( size_t i = 0; i < group_hashes.size(); ++i ) {
+         if( i == contract_tables_group ) {
+            for( auto& f : table_hashes )
+               add_leaves( f );
+         }
+         add_leaves( group_hashes[i] );
+      }
+
+      return merkle( std::move( leaves ) );
+   }
+
+   /**
+    *  With @ref bsp just applied as head, verify the state against the checkpoint recorded for the block, or record
+    *  one when the block is due for it. Throws state_checkpoint_exception on a mismatch, which ends a replay there.
+    */
+   void checkpoint_state( const block_state_ptr& bsp ) {
+      if( !state_checkpoints ) return;
+
+      const auto recorded = state_checkpoints->find( bsp->id );
+      const bool due = conf.state_checkpoint_interval > 0 && bsp->block_num % conf.state_checkpoint_interval == 0;
+      if( !recorded && !due ) return;
+
+      const auto root = calculate_integrity_merkle_root();
+      if( recorded ) {
+         EOS_ASSERT( root == *recorded, state_checkpoint_exception,
+                     "state root ${root} of block ${num} ${id} does not match recorded state checkpoint ${recorded}",
+                     ("root", root)("num", bsp->block_num)("id", bsp->id)("recorded", *recorded) );
+      } else {
+         state_checkpoints->append( {bsp->id, root} );
+      }
+   }
+
    void create_native_account( const fc::time_point& initial_timestamp, account_name name, const authority& owner, const authority& active, bool is_privileged = false ) {
       db.create<account_object>([&](auto& a) {
          a.name = name;
@@ -1090,22 +1399,28 @@ struct controller_impl {
       auto orig_block_transactions_size = bb._pending_trx_receipts.size();
       auto orig_state_transactions_size = bb._pending_trx_metas.size();
       auto orig_state_actions_size      = bb._actions.size();
+      auto orig_access_sets_size        = bb._access_sets.size();
 
       std::function<void()> callback = [this,
                                         orig_block_transactions_size,
                                         orig_state_transactions_size,
-                                        orig_state_actions_size]()
+                                        orig_state_actions_size,
+                                        orig_action_merkle = bb._action_merkle,
+                                        orig_access_sets_size]()
       {
          auto& bb = pending->_block_stage.get<building_block>();
          bb._pending_trx_receipts.resize(orig_block_transactions_size);
          bb._pending_trx_metas.resize(orig_state_transactions_size);
          bb._actions.resize(orig_state_actions_size);
+         bb._action_merkle = orig_action_merkle;
+         bb._access_sets.resize(orig_access_sets_size);
       };
 
       return fc::make_scoped_exit( std::move(callback) );
    }
 
    transaction_trace_ptr apply_onerror( const generated_transaction& gtrx,
+                                        const bytes& packed_trx, ///< of gtrx, which push_scheduled_transaction moved out
                                         fc::time_point deadline,
                                         fc::time_point start,
                                         uint32_t& cpu_time_to_bill_us, // only set on failure
@@ -1117,7 +1432,7 @@ struct controller_impl {
       signed_transaction etrx;
       // Deliver onerror action containing the failed deferred transaction directly back to the sender.
       etrx.actions.emplace_back( vector<permission_level>{{gtrx.sender, config::active_name}},
-                                 onerror( gtrx.sender_id, gtrx.packed_trx.data(), gtrx.packed_trx.size() ) );
+                                 onerror( gtrx.sender_id, packed_trx.data(), packed_trx.size() ) );
       if( self.is_builtin_activated( builtin_protocol_feature_t::no_duplicate_deferred_id ) ) {
          etrx.expiration = time_point_sec();
          etrx.ref_block_num = 0;
@@ -1143,7 +1458,7 @@ struct controller_impl {
          auto restore = make_block_restore_point();
          trace->receipt = push_receipt( gtrx.trx_id, transaction_receipt::soft_fail,
                                         trx_context.billed_cpu_time_us, trace->net_usage );
-         fc::move_append( pending->_block_stage.get<building_block>()._actions, move(trx_context.executed) );
+         append_actions( move(trx_context.executed) );
 
          trx_context.squash();
          restore.cancel();
@@ -1221,14 +1536,15 @@ struct controller_impl {
       // resulting in the GTO being restored and available for a future block to retire.
       int64_t trx_removal_ram_delta = remove_scheduled_transaction(gto);
 
-      fc::datastream<const char*> ds( gtrx.packed_trx.data(), gtrx.packed_trx.size() );
-
       EOS_ASSERT( gtrx.delay_until <= self.pending_block_time(), transaction_exception, "this transaction isn't ready",
                  ("gtrx.delay_until",gtrx.delay_until)("pbt",self.pending_block_time())          );
 
-      signed_transaction dtrx;
-      fc::raw::unpack(ds,static_cast<transaction&>(dtrx) );
-      transaction_metadata_ptr trx = transaction_metadata::create_no_recover_keys( packed_transaction( dtrx ), transaction_metadata::trx_type::scheduled );
+      // unpack once straight from the stored bytes; building the packed_transaction from an unpacked copy would
+      // serialize it all over again. The bytes move into it, onerror takes them back from ptrx
+      auto ptrx = std::make_shared<packed_transaction>( std::move( gtrx.packed_trx ), vector<signature_type>(), bytes(),
+                                                        packed_transaction::compression_type::none );
+      const signed_transaction& dtrx = ptrx->get_signed_transaction();
+      transaction_metadata_ptr trx = transaction_metadata::create_no_recover_keys( std::move( ptrx ), transaction_metadata::trx_type::scheduled );
       trx->accepted = true;
 
       transaction_trace_ptr trace;
@@ -1261,6 +1577,7 @@ struct controller_impl {
       trx_context.explicit_billed_cpu_time = explicit_billed_cpu_time;
       trx_context.billed_cpu_time_us = billed_cpu_time_us;
       trx_context.enforce_whiteblacklist = gtrx.sender.empty() ? true : !sender_avoids_whitelist_blacklist_enforcement( gtrx.sender );
+      if( conf.track_table_access ) trx_context.access_set.emplace();
       trace = trx_context.trace;
       try {
          trx_context.init_for_deferred_trx( gtrx.published );
@@ -1285,7 +1602,9 @@ struct controller_impl {
                                         trx_context.billed_cpu_time_us,
                                         trace->net_usage );
 
-         fc::move_append( pending->_block_stage.get<building_block>()._actions, move(trx_context.executed) );
+         append_actions( move(trx_context.executed) );
+         if( trx_context.access_set )
+            pending->_block_stage.get<building_block>()._access_sets.emplace_back( std::move(*trx_context.access_set) );
 
          trace->account_ram_delta = account_delta( gtrx.payer, trx_removal_ram_delta );
 
@@ -1316,7 +1635,7 @@ struct controller_impl {
       if( gtrx.sender != account_name() && !(validating ? failure_is_subjective(*trace->except) : scheduled_failure_is_subjective(*trace->except))) {
          // Attempt error handling for the generated transaction.
 
-         auto error_trace = apply_onerror( gtrx, deadline, trx_context.pseudo_start,
+         auto error_trace = apply_onerror( gtrx, trx->packed_trx()->get_packed_transaction(), deadline, trx_context.pseudo_start,
                                            cpu_time_to_bill_us, billed_cpu_time_us, explicit_billed_cpu_time,
                                            trx_context.enforce_whiteblacklist );
          error_trace->failed_dtrx_trace = trace;
@@ -1377,6 +1696,30 @@ struct controller_impl {
    } FC_CAPTURE_AND_RETHROW() } /// push_scheduled_transaction
 
 
+   /**
+    *  Drops the transaction metadata kept by the reversible block at block_num on the branch of bsp. Metadata is only
+    *  needed to requeue the block's transactions should a fork switch pop it, and to skip key recovery should it be
+    *  applied again; a fork reaching that deep loses the requeue and recovers the keys anew, but bounds the memory
+    *  held for a long run of reversible blocks by the window kept.
+    */
+   void release_trx_metas( const block_state_ptr& bsp, uint32_t block_num ) {
+      auto old = fork_db.search_on_branch( bsp->id, block_num );
+      if( old && !old->trxs_metas().empty() )
+         old->extract_trxs_metas();
+   }
+
+   /**
+    *  Adds the executed actions of a transaction to the pending block, folding them into its action merkle root.
+    */
+   void append_actions( vector<action_receipt>&& executed ) {
+      auto& bb = pending->_block_stage.get<building_block>();
+      if( !bb._action_mroot ) {
+         for( const auto& a : executed )
+            bb._action_merkle.append( a.digest() );
+      }
+      fc::move_append( bb._actions, std::move(executed) );
+   }
+
    /**
     *  Adds the transaction receipt to the pending block and returns it.
     */
@@ -1431,6 +1774,7 @@ struct controller_impl {
          trx_context.deadline = deadline;
          trx_context.explicit_billed_cpu_time = explicit_billed_cpu_time;
          trx_context.billed_cpu_time_us = billed_cpu_time_us;
+         if( conf.track_table_access && !trx->implicit ) trx_context.access_set.emplace();
          trace = trx_context.trace;
          try {
             if( trx->implicit ) {
@@ -1475,7 +1819,9 @@ struct controller_impl {
                trace->receipt = r;
             }
 
-            fc::move_append(pending->_block_stage.get<building_block>()._actions, move(trx_context.executed));
+            append_actions( move(trx_context.executed) );
+            if( trx_context.access_set )
+               pending->_block_stage.get<building_block>()._access_sets.emplace_back( std::move(*trx_context.access_set) );
 
             // call the accept signal but only once for this transaction
             if (!trx->accepted) {
@@ -1512,6 +1858,64 @@ struct controller_impl {
       } FC_CAPTURE_AND_RETHROW((trace))
    } /// push_transaction
 
+   /**
+    *  Executes a transaction that is not allowed to modify state. Nothing is recorded in the pending block:
+    *  no receipt is pushed, the transaction is not recorded for dedup, and the undo session is always rolled back.
+    */
+   transaction_trace_ptr push_read_only_transaction( const transaction_metadata_ptr& trx, fc::time_point deadline )
+   {
+      EOS_ASSERT(deadline != fc::time_point(), transaction_exception, "deadline cannot be uninitialized");
+      EOS_ASSERT( pending, block_validate_exception, "it is not valid to push a transaction when there is no pending block" );
+
+      transaction_trace_ptr trace;
+      try {
+         const signed_transaction& trn = trx->packed_trx()->get_signed_transaction();
+         transaction_checktime_timer trx_timer(timer);
+         transaction_context trx_context(self, trn, trx->id(), std::move(trx_timer));
+         if ((bool)subjective_cpu_leeway && pending->_block_status == controller::block_status::incomplete) {
+            trx_context.leeway = *subjective_cpu_leeway;
+         }
+         trx_context.deadline = deadline;
+         trx_context.is_read_only = true;
+         trace = trx_context.trace;
+         try {
+            trx_context.init_for_input_trx( trx->packed_trx()->get_unprunable_size(),
+                                            trx->packed_trx()->get_prunable_size(),
+                                            true );
+            trx_context.delay = fc::seconds(trn.delay_sec);
+            EOS_ASSERT( trx_context.delay == fc::seconds(0), transaction_exception,
+                        "read-only transaction cannot be delayed" );
+
+            if( !self.skip_auth_check() ) {
+               authorization.check_authorization(
+                       trn.actions,
+                       trx->recovered_keys(),
+                       {},
+                       trx_context.delay,
+                       [&trx_context](){ trx_context.checktime(); },
+                       false
+               );
+            }
+            trx_context.exec();
+            trx_context.finalize();
+
+            transaction_receipt_header r;
+            r.status = transaction_receipt::executed;
+            r.cpu_usage_us = trx_context.billed_cpu_time_us;
+            r.net_usage_words = trace->net_usage / 8;
+            trace->receipt = r;
+         } catch( const fc::exception& e ) {
+            trace->error_code = controller::convert_exception_to_error_code( e );
+            trace->except = e;
+            trace->except_ptr = std::current_exception();
+         }
+
+         trx_context.undo();
+
+         return trace;
+      } FC_CAPTURE_AND_RETHROW((trace))
+   } /// push_read_only_transaction
+
    void start_block( block_timestamp_type when,
                      uint16_t confirm_block_count,
                      const vector<digest_type>& new_protocol_feature_activations,
@@ -1637,7 +2041,8 @@ struct controller_impl {
 
          try {
             transaction_metadata_ptr onbtrx =
-                  transaction_metadata::create_no_recover_keys( packed_transaction( get_on_block_transaction() ), transaction_metadata::trx_type::implicit );
+                  transaction_metadata::create_no_recover_keys( std::make_shared<packed_transaction>( get_on_block_transaction() ),
+                                                               transaction_metadata::trx_type::implicit );
             auto reset_in_trx_requiring_checks = fc::make_scoped_exit([old_value=in_trx_requiring_checks,this](){
                   in_trx_requiring_checks = old_value;
                });
@@ -1671,6 +2076,15 @@ struct controller_impl {
       try {
 
       auto& pbhs = pending->get_pending_block_header_state();
+      auto& bb = pending->_block_stage.get<building_block>();
+
+      // the receipts of a produced block are hashed on the thread pool while the resource limits are updated
+      std::optional<overlapped_task<checksum256_type>> trx_mroot;
+      if( !bb._transaction_mroot ) {
+         trx_mroot.emplace( thread_pool.get_executor(), [this, &receipts = bb._pending_trx_receipts]() {
+            return calculate_trx_merkle( receipts, thread_pool.get_executor() );
+         } );
+      }
 
       // Update resource limits:
       resource_limits.process_account_limit_updates();
@@ -1682,11 +2096,9 @@ struct controller_impl {
       );
       resource_limits.process_block_usage(pbhs.block_num);
 
-      auto& bb = pending->_block_stage.get<building_block>();
-
       // Create (unsigned) block:
       auto block_ptr = std::make_shared<signed_block>( pbhs.make_block_header(
-         bb._transaction_mroot ? *bb._transaction_mroot : calculate_trx_merkle( bb._pending_trx_receipts ),
+         bb._transaction_mroot ? *bb._transaction_mroot : trx_mroot->get(),
          calculate_action_merkle(),
          bb._new_pending_producer_schedule,
          std::move( bb._new_protocol_feature_activations ),
@@ -1723,6 +2135,42 @@ struct controller_impl {
                               };
    } FC_CAPTURE_AND_RETHROW() } /// finalize_block
 
+   /// signs the block of finalize_block into the block_state of the completed block
+   block_state_ptr sign_block( const signer_callback_type& signer_callback ) {
+      auto& ab = pending->_block_stage.get<assembled_block>();
+
+      // the transactions, most of the bytes of a block, are packed while it is signed; signing only sets the
+      // producer signature in the header and additional signatures in the block extensions
+      overlapped_task<std::vector<char>> packed_trxs( thread_pool.get_executor(), [block = ab._unsigned_block]() {
+         return fc::raw::pack( block->transactions );
+      } );
+
+      auto bsp = std::make_shared<block_state>(
+                     std::move( ab._pending_block_header_state ),
+                     std::move( ab._unsigned_block ),
+                     std::move( ab._trx_metas ),
+                     protocol_features.get_protocol_feature_set(),
+                     []( block_timestamp_type timestamp,
+                         const flat_set<digest_type>& cur_features,
+                         const vector<digest_type>& new_features )
+                     {},
+                     signer_callback
+                 );
+
+      const auto trxs = packed_trxs.get();
+      const signed_block& b = *bsp->block;
+      const auto& header = static_cast<const signed_block_header&>( b );
+      auto packed = std::make_shared<std::vector<char>>( fc::raw::pack_size( header ) + trxs.size() + fc::raw::pack_size( b.block_extensions ) );
+      fc::datastream<char*> ds( packed->data(), packed->size() );
+      fc::raw::pack( ds, header );
+      ds.write( trxs.data(), trxs.size() );
+      fc::raw::pack( ds, b.block_extensions );
+      std::atomic_store( &bsp->_packed_block, std::shared_ptr<const std::vector<char>>( std::move( packed ) ) );
+
+      pending->_block_stage = completed_block{ bsp };
+      return bsp;
+   }
+
    /**
     * @post regardless of the success of commit block there is no active pending block
     */
@@ -1743,17 +2191,22 @@ struct controller_impl {
             emit( self.accepted_block_header, bsp );
             head = fork_db.head();
             EOS_ASSERT( bsp == head, fork_database_exception, "committed block did not become the new head in fork database");
+            checkpoint_state( bsp );
          }
 
          if( !replay_head_time && read_mode != db_read_mode::IRREVERSIBLE ) {
             reversible_blocks.create<reversible_block_object>( [&]( auto& ubo ) {
                ubo.blocknum = bsp->block_num;
-               ubo.set_block( bsp->block );
+               ubo.set_packed_block( *bsp->packed_block() );
             });
          }
 
          emit( self.accepted_block, bsp );
 
+         if( conf.fork_db_trx_metas_depth > 0 && bsp->block_num > conf.fork_db_trx_metas_depth ) {
+            release_trx_metas( bsp, bsp->block_num - conf.fork_db_trx_metas_depth );
+         }
+
          if( add_to_fork_db ) {
             log_irreversible();
          }
@@ -1856,9 +2309,15 @@ struct controller_impl {
          const signed_block_ptr& b = bsp->block;
          const auto& new_protocol_feature_activations = bsp->get_new_protocol_feature_activations();
 
-         auto producer_block_id = b->id();
+         const auto& producer_block_id = bsp->id;
          start_block( b->timestamp, b->confirmed, new_protocol_feature_activations, s, producer_block_id);
 
+         // a block this node executed and checked against its header before, on a branch a fork switch popped since,
+         // executes the same way again: its action receipts are not hashed again, its receipts and id are still checked
+         if( s == controller::block_status::validated && bsp->is_valid() ) {
+            pending->_block_stage.get<building_block>()._action_mroot = b->action_mroot;
+         }
+
          const bool existing_trxs_metas = !bsp->trxs_metas().empty();
          const bool pub_keys_recovered = bsp->is_pub_keys_recovered();
          const bool skip_auth_checks = self.skip_auth_check();
@@ -1868,20 +2327,23 @@ struct controller_impl {
             use_bsp_cached = true;
          } else {
             trx_metas.reserve( b->transactions.size() );
-            for( const auto& receipt : b->transactions ) {
+            for( auto& receipt : b->transactions ) {
                if( receipt.trx.contains<packed_transaction>()) {
-                  const auto& pt = receipt.trx.get<packed_transaction>();
+                  auto& pt = receipt.trx.get<packed_transaction>();
                   transaction_metadata_ptr trx_meta_ptr = trx_lookup ? trx_lookup( pt.id() ) : transaction_metadata_ptr{};
                   if( trx_meta_ptr && ( skip_auth_checks || !trx_meta_ptr->recovered_keys().empty() ) ) {
                      trx_metas.emplace_back( std::move( trx_meta_ptr ), recover_keys_future{} );
                   } else if( skip_auth_checks ) {
+                     // share ownership of the block rather than copying the transaction out of it
                      trx_metas.emplace_back(
-                           transaction_metadata::create_no_recover_keys( pt, transaction_metadata::trx_type::input ),
+                           transaction_metadata::create_no_recover_keys( packed_transaction_ptr( b, &pt ),
+                                                                         transaction_metadata::trx_type::input ),
                            recover_keys_future{} );
                   } else {
-                     auto ptrx = std::make_shared<packed_transaction>( pt );
+                     packed_transaction_ptr ptrx( b, &pt );
                      auto fut = transaction_metadata::start_recover_keys(
-                           std::move( ptrx ), thread_pool.get_executor(), chain_id, microseconds::maximum() );
+                           std::move( ptrx ), key_recovery_queue, prioritized_task_queue::priority::high,
+                           chain_id, microseconds::maximum() );
                      trx_metas.emplace_back( transaction_metadata_ptr{}, std::move( fut ) );
                   }
                }
@@ -1928,6 +2390,15 @@ struct controller_impl {
                         ("producer_receipt", receipt)("validator_receipt", trx_receipts.back()) );
          }
 
+         if( conf.track_table_access ) {
+            const auto& access_sets = pending->_block_stage.get<building_block>()._access_sets;
+            if( !access_sets.empty() ) {
+               auto waves = partition_into_waves( access_sets );
+               dlog( "block ${n}: ${t} tracked transactions are conflict free across ${w} waves",
+                     ("n", bsp->block_num)("t", access_sets.size())("w", *std::max_element( waves.begin(), waves.end() ) + 1) );
+            }
+         }
+
          // validated in create_block_state_future()
          pending->_block_stage.get<building_block>()._transaction_mroot = b->transaction_mroot;
 
@@ -1958,11 +2429,9 @@ struct controller_impl {
       }
    } FC_CAPTURE_AND_RETHROW() } /// apply_block
 
-   std::future<block_state_ptr> create_block_state_future( const signed_block_ptr& b ) {
+   std::future<block_state_ptr> create_block_state_future( const block_id_type& id, const signed_block_ptr& b ) {
       EOS_ASSERT( b, block_validate_exception, "null block" );
 
-      auto id = b->id();
-
       // no reason for a block_state if fork_db already knows about block
       auto existing = fork_db.get_block( id );
       EOS_ASSERT( !existing, fork_database_exception, "we already know about this block: ${id}", ("id", id) );
@@ -1971,23 +2440,54 @@ struct controller_impl {
       EOS_ASSERT( prev, unlinkable_block_exception,
                   "unlinkable block ${id}", ("id", id)("previous", b->previous) );
 
-      return async_thread_pool( thread_pool.get_executor(), [b, prev, control=this]() {
-         const bool skip_validate_signee = false;
+      return async_thread_pool( thread_pool.get_executor(), [b, prev, id, control=this]() {
+         if( control->prefetcher ) {
+            flat_set<account_name> contracts;
+            for( const auto& receipt : b->transactions ) {
+               if( receipt.trx.contains<packed_transaction>() ) {
+                  for( const auto& a : receipt.trx.get<packed_transaction>().get_transaction().actions )
+                     contracts.insert( a.account );
+               }
+            }
+            control->prefetcher->prefetch( contracts );
+         }
+
+         auto header_state = std::make_shared<std::packaged_task<block_state_ptr()>>( [b, prev, control]() {
+            const bool skip_validate_signee = false;
+            return std::make_shared<block_state>(
+                           *prev,
+                           b,
+                           control->protocol_features.get_protocol_feature_set(),
+                           [control]( block_timestamp_type timestamp,
+                                      const flat_set<digest_type>& cur_features,
+                                      const vector<digest_type>& new_features )
+                           { control->check_protocol_features( timestamp, cur_features, new_features ); },
+                           skip_validate_signee
+            );
+         } );
+         auto header_state_future = header_state->get_future();
+
+         // the header state, which recovers the producer's signatures, is built on another thread of the pool while
+         // this one hashes the transactions; whichever thread claims it first builds it, so this never waits on a task
+         // still queued behind others
+         auto claimed = std::make_shared<std::atomic<bool>>( false );
+         if( !b->transactions.empty() ) {
+            boost::asio::post( control->thread_pool.get_executor(), [header_state, claimed]() {
+               if( !claimed->exchange( true ) ) (*header_state)();
+            } );
+         }
 
-         auto trx_mroot = calculate_trx_merkle( b->transactions );
+         auto trx_mroot = calculate_trx_merkle( b->transactions, control->thread_pool.get_executor() );
+         const bool build_here = !claimed->exchange( true );
          EOS_ASSERT( b->transaction_mroot == trx_mroot, block_validate_exception,
                      "invalid block transaction merkle root ${b} != ${c}", ("b", b->transaction_mroot)("c", trx_mroot) );
 
-         return std::make_shared<block_state>(
-                        *prev,
-                        move( b ),
-                        control->protocol_features.get_protocol_feature_set(),
-                        [control]( block_timestamp_type timestamp,
-                                   const flat_set<digest_type>& cur_features,
-                                   const vector<digest_type>& new_features )
-                        { control->check_protocol_features( timestamp, cur_features, new_features ); },
-                        skip_validate_signee
-         );
+         if( build_here ) (*header_state)();
+         auto bsp = header_state_future.get();
+         // the block state computed the id from the header, the one checked against the fork database was given
+         EOS_ASSERT( bsp->id == id, block_validate_exception,
+                     "block id ${id} does not match the id ${computed} of the block", ("id", id)("computed", bsp->id) );
+         return bsp;
       } );
    }
 
@@ -2056,6 +2556,7 @@ struct controller_impl {
          if( s == controller::block_status::irreversible ) {
             apply_block( bsp, s, trx_meta_cache_lookup{} );
             head = bsp;
+            checkpoint_state( bsp );
 
             // On replay, log_irreversible is not called and so no irreversible_block signal is emittted.
             // So emit it explicitly here.
@@ -2089,6 +2590,8 @@ struct controller_impl {
          }
       } else if( new_head->id != head->id ) {
          auto old_head = head;
+         const auto switch_start = fc::time_point::now();
+         size_t revalidated = 0;
          ilog("switching forks from ${current_head_id} (block number ${current_head_num}) to ${new_head_id} (block number ${new_head_num})",
               ("current_head_id", head->id)("current_head_num", head->block_num)("new_head_id", new_head->id)("new_head_num", new_head->block_num) );
          auto branches = fork_db.fetch_branch_from( new_head->id, head->id );
@@ -2106,6 +2609,9 @@ struct controller_impl {
          for( auto ritr = branches.first.rbegin(); ritr != branches.first.rend(); ++ritr ) {
             optional<fc::exception> except;
             try {
+               // a block validated before, on a branch this switch or an earlier one popped, reuses its action merkle
+               // root, and its trxs_metas so the keys of its transactions are not recovered again
+               if( (*ritr)->is_valid() ) ++revalidated;
                apply_block( *ritr, (*ritr)->is_valid() ? controller::block_status::validated
                                                        : controller::block_status::complete, trx_lookup );
                fork_db.mark_valid( *ritr );
@@ -2138,7 +2644,10 @@ struct controller_impl {
             } // end if exception
          } /// end for each block in branch
 
-         ilog("successfully switched fork to new head ${new_head_id}", ("new_head_id", new_head->id));
+         ilog("successfully switched fork to new head ${new_head_id}, popped ${popped} and applied ${applied} blocks, "
+              "${revalidated} of them validated before and reused, in ${ms} ms",
+              ("new_head_id", new_head->id)("popped", branches.second.size())("applied", branches.first.size())
+              ("revalidated", revalidated)("ms", (fc::time_point::now() - switch_start).count() / 1000));
       } else {
          head_changed = false;
       }
@@ -2159,22 +2668,17 @@ struct controller_impl {
    }
 
    checksum256_type calculate_action_merkle() {
-      vector<digest_type> action_digests;
-      const auto& actions = pending->_block_stage.get<building_block>()._actions;
-      action_digests.reserve( actions.size() );
-      for( const auto& a : actions )
-         action_digests.emplace_back( a.digest() );
-
-      return merkle( move(action_digests) );
+      const auto& bb = pending->_block_stage.get<building_block>();
+      return bb._action_mroot ? *bb._action_mroot : bb._action_merkle.get_root();
    }
 
-   static checksum256_type calculate_trx_merkle( const vector<transaction_receipt>& trxs ) {
+   static checksum256_type calculate_trx_merkle( const vector<transaction_receipt>& trxs, boost::asio::io_context& thread_pool ) {
       vector<digest_type> trx_digests;
       trx_digests.reserve( trxs.size() );
       for( const auto& a : trxs )
          trx_digests.emplace_back( a.digest() );
 
-      return merkle( move(trx_digests) );
+      return merkle( move(trx_digests), &thread_pool );
    }
 
    void update_producers_authority() {
@@ -2230,6 +2734,8 @@ struct controller_impl {
       while( (!dedupe_index.empty()) && ( now > fc::time_point(dedupe_index.begin()->expiration) ) ) {
          transaction_idx.remove(*dedupe_index.begin());
       }
+      // only expired before the last irreversible block, removals by reversible blocks can be undone
+      dedup_filter.remove_expired( self.last_irreversible_block_time() );
    }
 
    bool sender_avoids_whitelist_blacklist_enforcement( account_name sender )const {
@@ -2427,6 +2933,26 @@ const protocol_feature_manager& controller::get_protocol_feature_manager()const
    return my->protocol_features;
 }
 
+const table_lookup_cache::stats_by_contract& controller::get_table_lookup_stats()const {
+   return my->table_lookup_stats;
+}
+
+table_lookup_cache::stats_by_contract* controller::get_mutable_table_lookup_stats() {
+   return my->conf.table_lookup_cache ? &my->table_lookup_stats : nullptr;
+}
+
+const contract_profiler& controller::get_contract_profiler()const {
+   return my->profiler;
+}
+
+contract_profiler* controller::get_mutable_contract_profiler() {
+   return my->conf.profile_contracts ? &my->profiler : nullptr;
+}
+
+state_prefetcher* controller::get_state_prefetcher()const {
+   return my->prefetcher.get();
+}
+
 controller::controller( const controller::config& cfg, const chain_id_type& chain_id )
 :my( new controller_impl( cfg, *this, protocol_feature_set{}, chain_id ) )
 {
@@ -2633,23 +3159,7 @@ block_state_ptr controller::finalize_block( const signer_callback_type& signer_c
 
    my->finalize_block();
 
-   auto& ab = my->pending->_block_stage.get<assembled_block>();
-
-   auto bsp = std::make_shared<block_state>(
-                  std::move( ab._pending_block_header_state ),
-                  std::move( ab._unsigned_block ),
-                  std::move( ab._trx_metas ),
-                  my->protocol_features.get_protocol_feature_set(),
-                  []( block_timestamp_type timestamp,
-                      const flat_set<digest_type>& cur_features,
-                      const vector<digest_type>& new_features )
-                  {},
-                  signer_callback
-              );
-
-   my->pending->_block_stage = completed_block{ bsp };
-
-   return bsp;
+   return my->sign_block( signer_callback );
 }
 
 void controller::commit_block() {
@@ -2666,8 +3176,17 @@ boost::asio::io_context& controller::get_thread_pool() {
    return my->thread_pool.get_executor();
 }
 
+prioritized_task_queue& controller::get_key_recovery_queue() {
+   return my->key_recovery_queue;
+}
+
 std::future<block_state_ptr> controller::create_block_state_future( const signed_block_ptr& b ) {
-   return my->create_block_state_future( b );
+   EOS_ASSERT( b, block_validate_exception, "null block" );
+   return my->create_block_state_future( b->id(), b );
+}
+
+std::future<block_state_ptr> controller::create_block_state_future( const block_id_type& id, const signed_block_ptr& b ) {
+   return my->create_block_state_future( id, b );
 }
 
 void controller::push_block( std::future<block_state_ptr>& block_state_future,
@@ -2686,6 +3205,12 @@ transaction_trace_ptr controller::push_transaction( const transaction_metadata_p
    return my->push_transaction(trx, deadline, billed_cpu_time_us, explicit_billed_cpu_time );
 }
 
+transaction_trace_ptr controller::push_read_only_transaction( const transaction_metadata_ptr& trx, fc::time_point deadline ) {
+   EOS_ASSERT( get_read_mode() != db_read_mode::IRREVERSIBLE, transaction_type_exception, "push read-only transaction not allowed in irreversible mode" );
+   EOS_ASSERT( trx && !trx->implicit && !trx->scheduled, transaction_type_exception, "Implicit/Scheduled transaction not allowed" );
+   return my->push_read_only_transaction( trx, deadline );
+}
+
 transaction_trace_ptr controller::push_scheduled_transaction( const transaction_id_type& trxid, fc::time_point deadline,
                                                               uint32_t billed_cpu_time_us, bool explicit_billed_cpu_time )
 {
@@ -2863,6 +3388,20 @@ signed_block_ptr controller::fetch_block_by_number( uint32_t block_num )const  {
    return my->blog.read_block_by_num(block_num);
 } FC_CAPTURE_AND_RETHROW( (block_num) ) }
 
+std::vector<char> controller::fetch_serialized_block_by_number( uint32_t block_num )const  { try {
+   const auto& blog_head = my->blog.head();
+   if( blog_head && block_num <= blog_head->block_num() ) {
+      return my->blog.read_serialized_block_by_num( block_num );
+   }
+
+   auto blk_state = fetch_block_state_by_number( block_num );
+   if( blk_state ) {
+      return fc::raw::pack( *blk_state->block );
+   }
+
+   return {};
+} FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
 block_state_ptr controller::fetch_block_state_by_id( block_id_type id )const {
    auto state = my->fork_db.get_block(id);
    return state;
@@ -2919,6 +3458,10 @@ sha256 controller::calculate_integrity_hash()const { try {
    return my->calculate_integrity_hash();
 } FC_LOG_AND_RETHROW() }
 
+digest_type controller::calculate_integrity_merkle_root()const { try {
+   return my->calculate_integrity_merkle_root();
+} FC_LOG_AND_RETHROW() }
+
 void controller::write_snapshot( const snapshot_writer_ptr& snapshot ) const {
    EOS_ASSERT( !my->pending, block_validate_exception, "cannot take a consistent snapshot with a pending block" );
    return my->add_to_snapshot(snapshot);
@@ -3076,6 +3619,10 @@ validation_mode controller::get_validation_mode()const {
    return my->conf.block_validation_mode;
 }
 
+trace_level controller::get_trace_level()const {
+   return my->conf.action_trace_level;
+}
+
 const apply_handler* controller::find_apply_handler( account_name receiver, account_name scope, action_name act ) const
 {
    auto native_handler_scope = my->apply_handlers.find( receiver );
@@ -3192,6 +3739,15 @@ bool controller::is_known_unexpired_transaction( const transaction_id_type& id)
    return db().find<transaction_object, by_trx_id>(id);
 }
 
+bool controller::is_known_unexpired_transaction( const transaction_id_type& id, fc::time_point_sec expiration ) const {
+   if( !my->dedup_filter.may_contain( id, expiration ) ) return false;
+   return is_known_unexpired_transaction( id );
+}
+
+void controller::record_in_dedup_filter( const transaction_id_type& id, fc::time_point_sec expiration ) {
+   my->dedup_filter.add( id, expiration );
+}
+
 void controller::set_subjective_cpu_leeway(fc::microseconds leeway) {
    my->subjective_cpu_leeway = leeway;
 }
@@ -3354,6 +3910,13 @@ void controller_impl::on_activation<builtin_protocol_feature_t::wtmsig_block_sig
    } );
 }
 
+template<>
+void controller_impl::on_activation<builtin_protocol_feature_t::db_read_range>() {
+   db.modify( db.get<protocol_state_object>(), [&]( auto& ps ) {
+      add_intrinsic_to_whitelist( ps.whitelisted_intrinsics, "db_read_range_i64" );
+   } );
+}
+
 
 
 /// End of protocol feature activation handlers
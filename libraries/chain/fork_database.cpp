@@ -1,5 +1,6 @@
 #include <eosio/chain/fork_database.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/ordered_index.hpp>
@@ -9,6 +10,7 @@
 #include <boost/multi_index/composite_key.hpp>
 #include <fc/io/fstream.hpp>
 #include <fstream>
+#include <thread>
 
 namespace eosio { namespace chain {
    using boost::multi_index_container;
@@ -17,7 +19,7 @@ namespace eosio { namespace chain {
    const uint32_t fork_database::magic_number = 0x30510FDB;
 
    const uint32_t fork_database::min_supported_version = 1;
-   const uint32_t fork_database::max_supported_version = 1;
+   const uint32_t fork_database::max_supported_version = 2;
 
    // work around block_state::is_valid being private
    inline bool block_state_is_valid( const block_state& bs ) {
@@ -27,6 +29,7 @@ namespace eosio { namespace chain {
    /**
     * History:
     * Version 1: initial version of the new refactored fork database portable format
+    * Version 2: each block_state is prefixed by its packed size so that they can be unpacked in parallel
     */
 
    struct by_block_id;
@@ -76,8 +79,50 @@ namespace eosio { namespace chain {
                 const std::function<void( block_timestamp_type,
                                           const flat_set<digest_type>&,
                                           const vector<digest_type>& )>& validator );
+
+      vector<block_state_ptr> unpack_block_states( fc::datastream<const char*>& ds, uint32_t num_blocks );
    };
 
+   /**
+    *  Unpacks the size prefixed block_states of a version 2 fork database file in parallel, most of the time of
+    *  which is spent unpacking the transactions of their blocks, and returns them in file order.
+    */
+   vector<block_state_ptr> fork_database_impl::unpack_block_states( fc::datastream<const char*>& ds, uint32_t num_blocks ) {
+      vector<std::pair<const char*, uint32_t>> packed;
+      packed.reserve( num_blocks );
+      for( uint32_t i = 0; i < num_blocks; ++i ) {
+         uint32_t packed_size = 0;
+         fc::raw::unpack( ds, packed_size );
+         EOS_ASSERT( ds.remaining() >= packed_size, fork_database_exception, "fork database file is truncated" );
+         packed.emplace_back( ds.pos(), packed_size );
+         ds.skip( packed_size );
+      }
+
+      vector<block_state_ptr> result( num_blocks );
+      if( num_blocks == 0 ) return result;
+
+      const size_t num_threads = std::min<size_t>( num_blocks, std::max( 1u, std::thread::hardware_concurrency() ) );
+      named_thread_pool pool( "forkdb", num_threads );
+      vector<std::future<void>> done;
+      done.reserve( num_threads );
+      for( size_t t = 0; t < num_threads; ++t ) {
+         done.emplace_back( async_thread_pool( pool.get_executor(), [&packed, &result, t, num_threads]() {
+            for( size_t i = t; i < packed.size(); i += num_threads ) {
+               fc::datastream<const char*> bds( packed[i].first, packed[i].second );
+               auto s = std::make_shared<block_state>();
+               fc::raw::unpack( bds, *s );
+               // do not populate transaction_metadatas, they will be created as needed in apply_block with appropriate key recovery
+               s->header_exts = s->block->validate_and_extract_header_extensions();
+               result[i] = std::move( s );
+            }
+         } ) );
+      }
+      for( auto& f : done ) f.get();
+      pool.stop();
+
+      return result;
+   }
+
 
    fork_database::fork_database( const fc::path& data_dir )
    :my( new fork_database_impl( *this, data_dir ) )
@@ -127,12 +172,18 @@ namespace eosio { namespace chain {
             reset( bhs );
 
             unsigned_int size; fc::raw::unpack( ds, size );
-            for( uint32_t i = 0, n = size.value; i < n; ++i ) {
-               block_state s;
-               fc::raw::unpack( ds, s );
-               // do not populate transaction_metadatas, they will be created as needed in apply_block with appropriate key recovery
-               s.header_exts = s.block->validate_and_extract_header_extensions();
-               my->add( std::make_shared<block_state>( move( s ) ), false, true, validator );
+            if( version < 2 ) {
+               for( uint32_t i = 0, n = size.value; i < n; ++i ) {
+                  block_state s;
+                  fc::raw::unpack( ds, s );
+                  // do not populate transaction_metadatas, they will be created as needed in apply_block with appropriate key recovery
+                  s.header_exts = s.block->validate_and_extract_header_extensions();
+                  my->add( std::make_shared<block_state>( move( s ) ), false, true, validator );
+               }
+            } else {
+               for( auto& s : my->unpack_block_states( ds, size.value ) ) {
+                  my->add( s, false, true, validator );
+               }
             }
             block_id_type head_id;
             fc::raw::unpack( ds, head_id );
@@ -174,6 +225,7 @@ namespace eosio { namespace chain {
       }
 
       std::ofstream out( fork_db_dat.generic_string().c_str(), std::ios::out | std::ios::binary | std::ofstream::trunc );
+      vector<char> buffer;
       fc::raw::pack( out, magic_number );
       fc::raw::pack( out, max_supported_version ); // write out current version which is always max_supported_version
       fc::raw::pack( out, *static_cast<block_header_state*>(&*my->root) );
@@ -212,7 +264,13 @@ namespace eosio { namespace chain {
             ++validated_itr;
          }
 
-         fc::raw::pack( out, *(*itr) );
+         // packed into memory first, streaming a block_state field by field through the ofstream is much slower
+         const uint32_t packed_size = fc::raw::pack_size( *(*itr) );
+         buffer.resize( packed_size );
+         fc::datastream<char*> ds( buffer.data(), buffer.size() );
+         fc::raw::pack( ds, *(*itr) );
+         fc::raw::pack( out, packed_size );
+         out.write( buffer.data(), buffer.size() );
       }
 
       if( my->head ) {
@@ -21,6 +21,8 @@ namespace impl {
    struct abi_traverse_context_with_path;
    struct binary_to_variant_context;
    struct variant_to_binary_context;
+
+   struct decode_plans;
 }
 
 /**
@@ -55,6 +57,28 @@ struct abi_serializer {
    fc::variant binary_to_variant( const std::string_view& type, const bytes& binary, const fc::microseconds& max_serialization_time, bool short_path = false )const;
    fc::variant binary_to_variant( const std::string_view& type, fc::datastream<const char*>& binary, const fc::microseconds& max_serialization_time, bool short_path = false )const;
 
+   /// appends the JSON of binary_to_variant to @ref out, written directly from @ref binary when the type has a decode plan
+   void        binary_to_json( const std::string_view& type, const bytes& binary, string& out, const fc::microseconds& max_serialization_time, bool short_path = false )const;
+
+   /// receives the value binary_to_variant would return piece by piece, variants as arrays of name and value
+   struct value_writer {
+      virtual ~value_writer() = default;
+      virtual void start_object() = 0;
+      virtual void key( const string& name ) = 0;
+      virtual void end_object() = 0;
+      virtual void start_array() = 0;
+      virtual void end_array() = 0;
+      /// a value of a built-in type
+      virtual void value( const fc::variant& v ) = 0;
+   };
+
+   /**
+    * Writes the value of @ref binary to @ref writer directly, without building its variant tree
+    * @return false, with whatever @ref writer received to be discarded, if the type has no decode plan or the binary
+    * does not decode; binary_to_variant then gives the detailed error
+    */
+   bool        binary_to_writer( const std::string_view& type, const bytes& binary, value_writer& writer, const fc::microseconds& max_serialization_time )const;
+
    bytes       variant_to_binary( const std::string_view& type, const fc::variant& var, const fc::microseconds& max_serialization_time, bool short_path = false )const;
    void        variant_to_binary( const std::string_view& type, const fc::variant& var, fc::datastream<char*>& ds, const fc::microseconds& max_serialization_time, bool short_path = false )const;
 
@@ -100,6 +124,15 @@ private:
    map<type_name, pair<unpack_function, pack_function>, std::less<>> built_in_types;
    void configure_built_in_types();
 
+   std::shared_ptr<const impl::decode_plans> decode_plans;
+   void build_decode_plans();
+   /// @return false, leaving @ref stream untouched, if @ref type has no decode plan or it fails
+   bool _binary_to_variant_with_plan( const std::string_view& type, fc::datastream<const char*>& stream,
+                                      impl::binary_to_variant_context& ctx, fc::variant& result )const;
+   /// @return false, leaving @ref ds untouched, if @ref type has no plan or it fails
+   bool _variant_to_binary_with_plan( const std::string_view& type, const fc::variant& var, fc::datastream<char*>& ds,
+                                      impl::variant_to_binary_context& ctx )const;
+
    fc::variant _binary_to_variant( const std::string_view& type, const bytes& binary, impl::binary_to_variant_context& ctx )const;
    fc::variant _binary_to_variant( const std::string_view& type, fc::datastream<const char*>& binary, impl::binary_to_variant_context& ctx )const;
    void        _binary_to_variant( const std::string_view& type, fc::datastream<const char*>& stream,
@@ -140,6 +173,7 @@ namespace impl {
 
       void check_deadline()const;
       const fc::time_point& get_deadline()const { return deadline; }
+      size_t get_recursion_depth()const { return recursion_depth; }
 
       fc::scoped_exit<std::function<void()>> enter_scope();
 
@@ -393,7 +427,7 @@ namespace impl {
 
          try {
             auto abi = resolver(act.account);
-            if (abi.valid()) {
+            if (abi) {
                auto type = abi->get_action_type(act.name);
                if (!type.empty()) {
                   try {
@@ -643,7 +677,7 @@ namespace impl {
                valid_empty_data = act.data.empty();
             } else if ( data.is_object() ) {
                auto abi = resolver(act.account);
-               if (abi.valid()) {
+               if (abi) {
                   auto type = abi->get_action_type(act.name);
                   if (!type.empty()) {
                      variant_to_binary_context _ctx(*abi, ctx, type);
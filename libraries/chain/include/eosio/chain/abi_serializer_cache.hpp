@@ -0,0 +1,61 @@
+#pragma once
+
+#include <eosio/chain/abi_serializer.hpp>
+
+#include <chainbase/chainbase.hpp>
+
+#include <memory>
+
+namespace eosio { namespace chain {
+
+/**
+ *  Process wide, bounded cache of the parsed ABIs of accounts and their serializers, keyed by (account, abi_sequence).
+ *  The API plugins, and controller::to_variant_with_abi, go through it instead of loading the ABI on every request.
+ *  A hit is also checked against the ABI currently set on the account, so an entry left by another fork, or another
+ *  chain in the same process, that has the same abi_sequence is loaded again rather than used.
+ *
+ *  Thread safe, ABIs are loaded outside of the lock and the cached entries are immutable.
+ */
+class abi_serializer_cache {
+   public:
+      static constexpr size_t default_capacity = 1000;
+
+      struct cached_abi {
+         /// no ABI, only built-in types
+         cached_abi() : abi(), serializer() {}
+         cached_abi( abi_def def, const fc::microseconds& max_serialization_time );
+
+         const abi_def        abi;
+         const abi_serializer serializer;
+      };
+      using cached_abi_ptr = std::shared_ptr<const cached_abi>;
+
+      struct stats {
+         uint64_t hits      = 0;
+         uint64_t misses    = 0;
+         uint64_t evictions = 0;
+         uint64_t size      = 0;
+         uint64_t capacity  = 0;
+      };
+
+      /**
+       *  @return the ABI set on account @ref n with its serializer, nullptr if the account does not exist or has no ABI
+       *  @throws if the ABI can not be loaded within @ref max_serialization_time, nothing is cached in that case
+       */
+      static cached_abi_ptr get( const chainbase::database& db, account_name n, const fc::microseconds& max_serialization_time );
+
+      /// @return the serializer of @ref get, for the resolvers of abi_serializer::to_variant and from_variant
+      static std::shared_ptr<const abi_serializer> get_serializer( const chainbase::database& db, account_name n,
+                                                                   const fc::microseconds& max_serialization_time );
+
+      /// drop the least recently used entries until no more than @ref capacity remain
+      static void set_capacity( size_t capacity );
+
+      static stats get_stats();
+
+      static void clear();
+};
+
+} } // eosio::chain
+
+FC_REFLECT( eosio::chain::abi_serializer_cache::stats, (hits)(misses)(evictions)(size)(capacity) )
@@ -2,6 +2,7 @@
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/transaction.hpp>
 #include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/table_lookup_cache.hpp>
 #include <fc/utility.hpp>
 #include <sstream>
 #include <algorithm>
@@ -20,8 +21,10 @@ class apply_context {
       class iterator_cache {
          public:
             iterator_cache(){
+               _table_cache.reserve(8);
                _end_iterator_to_table.reserve(8);
                _iterator_to_object.reserve(32);
+               _object_to_iterator.reserve(32);
             }
 
             /// Returns end iterator of the table.
@@ -76,21 +79,38 @@ class apply_context {
             }
 
             int add( const T& obj ) {
-               auto itr = _object_to_iterator.find( &obj );
-               if( itr != _object_to_iterator.end() )
+               auto [itr, inserted] = _object_to_iterator.emplace( &obj, _iterator_to_object.size() );
+               if( !inserted )
                     return itr->second;
 
                _iterator_to_object.push_back( &obj );
-               _object_to_iterator[&obj] = _iterator_to_object.size() - 1;
 
-               return _iterator_to_object.size() - 1;
+               return itr->second;
+            }
+
+            /// Appends the addresses of the tables and rows handed out, without dereferencing any of them
+            void append_objects( vector<const void*>& objects )const {
+               objects.insert( objects.end(), _end_iterator_to_table.begin(), _end_iterator_to_table.end() );
+               for( const T* o : _iterator_to_object )
+                  if( o ) objects.push_back( o );
+            }
+
+            /// Forgets every table and iterator, keeping the memory for the next action
+            void clear() {
+               _table_cache.clear();
+               _end_iterator_to_table.clear();
+               _iterator_to_object.clear();
+               _object_to_iterator.clear();
             }
 
          private:
-            map<table_id_object::id_type, pair<const table_id_object*, int>> _table_cache;
+            // an action touches few tables but may visit many rows; tables are kept in a sorted vector, which
+            // allocates no node per table, and rows in a hash table, which still allocates a node per row visited
+            // but neither rebalances nor compares keys along a tree path
+            flat_map<table_id_object::id_type, pair<const table_id_object*, int>> _table_cache;
             vector<const table_id_object*>                  _end_iterator_to_table;
             vector<const T*>                                _iterator_to_object;
-            map<const T*,int>                               _object_to_iterator;
+            unordered_map<const T*,int>                     _object_to_iterator;
 
             /// Precondition: std::numeric_limits<int>::min() < ei < -1
             /// Iterator of -1 is reserved for invalid iterators (i.e. when the appropriate table has not yet been created).
@@ -173,12 +193,16 @@ class apply_context {
 
             generic_index( apply_context& c ):context(c){}
 
+            void clear() { itr_cache.clear(); }
+            void append_objects( vector<const void*>& objects )const { itr_cache.append_objects( objects ); }
+
             int store( uint64_t scope, uint64_t table, const account_name& payer,
                        uint64_t id, secondary_key_proxy_const_type value )
             {
                EOS_ASSERT( payer != account_name(), invalid_table_payer, "must specify a valid account to pay for new record" );
 
 //               context.require_write_lock( scope );
+               context.check_writes_allowed();
 
                const auto& tab = context.find_or_create_table( context.receiver, name(scope), name(table), payer );
 
@@ -195,22 +219,29 @@ class apply_context {
 
                context.update_db_usage( payer, config::billable_size_v<ObjectType> );
 
+               if( auto* lookup_cache = context.lookup_cache() )
+                  lookup_cache->cache_row( tab.id, id, &obj );
+
                itr_cache.cache_table( tab );
                return itr_cache.add( obj );
             }
 
             void remove( int iterator ) {
+               context.check_writes_allowed();
                const auto& obj = itr_cache.get( iterator );
                context.update_db_usage( obj.payer, -( config::billable_size_v<ObjectType> ) );
 
                const auto& table_obj = itr_cache.get_table( obj.t_id );
                EOS_ASSERT( table_obj.code == context.receiver, table_access_violation, "db access violation" );
+               context.record_table_write( table_obj.code, table_obj.scope, table_obj.table );
 
 //               context.require_write_lock( table_obj.scope );
 
                context.db.modify( table_obj, [&]( auto& t ) {
                   --t.count;
                });
+               if( auto* lookup_cache = context.lookup_cache() )
+                  lookup_cache->cache_row<ObjectType>( obj.t_id, obj.primary_key, nullptr );
                context.db.remove( obj );
 
                if (table_obj.count == 0) {
@@ -221,10 +252,12 @@ class apply_context {
             }
 
             void update( int iterator, account_name payer, secondary_key_proxy_const_type secondary ) {
+               context.check_writes_allowed();
                const auto& obj = itr_cache.get( iterator );
 
                const auto& table_obj = itr_cache.get_table( obj.t_id );
                EOS_ASSERT( table_obj.code == context.receiver, table_access_violation, "db access violation" );
+               context.record_table_write( table_obj.code, table_obj.scope, table_obj.table );
 
 //               context.require_write_lock( table_obj.scope );
 
@@ -351,7 +384,13 @@ class apply_context {
 
                auto table_end_itr = itr_cache.cache_table( *tab );
 
-               const auto* obj = context.db.find<ObjectType, by_primary>( boost::make_tuple( tab->id, primary ) );
+               const ObjectType* obj = nullptr;
+               auto* lookup_cache = context.lookup_cache();
+               if( !lookup_cache || !lookup_cache->find_row( context.receiver, tab->id, primary, obj ) ) {
+                  obj = context.db.find<ObjectType, by_primary>( boost::make_tuple( tab->id, primary ) );
+                  if( lookup_cache )
+                     lookup_cache->cache_row( tab->id, primary, obj );
+               }
                if( !obj ) return table_end_itr;
                secondary_key_helper_t::get(secondary, obj->secondary_key);
 
@@ -450,6 +489,10 @@ class apply_context {
    public:
       apply_context(controller& con, transaction_context& trx_ctx, uint32_t action_ordinal, uint32_t depth=0);
 
+      /// Prepares a context that applied an earlier action of the transaction for another one, the containers it
+      /// allocated keep their capacity
+      void reset( uint32_t action_ordinal, uint32_t depth );
+
    /// Execution methods:
    public:
 
@@ -505,10 +548,19 @@ class apply_context {
          _pending_console_output += val;
       }
 
+      void console_append( const char* data, size_t size ) {
+         _pending_console_output.append( data, size );
+      }
+
    /// Database methods:
    public:
 
       void update_db_usage( const account_name& payer, int64_t delta );
+      void check_writes_allowed()const;
+      void record_table_read( name code, name scope, name table );
+      void record_table_write( name code, name scope, name table );
+      /// @return the transaction's table lookup cache, nullptr unless the controller has it enabled
+      table_lookup_cache* lookup_cache();
 
       int  db_store_i64( name scope, name table, const account_name& payer, uint64_t id, const char* buffer, size_t buffer_size );
       void db_update_i64( int iterator, account_name payer, const char* buffer, size_t buffer_size );
@@ -520,6 +572,7 @@ class apply_context {
       int  db_lowerbound_i64( name code, name scope, name table, uint64_t id );
       int  db_upperbound_i64( name code, name scope, name table, uint64_t id );
       int  db_end_i64( name code, name scope, name table );
+      int  db_read_range_i64( name code, name scope, name table, uint64_t lower_bound, uint32_t max_rows, char* buffer, size_t buffer_size );
 
    private:
 
@@ -545,6 +598,8 @@ class apply_context {
 
       void add_ram_usage( account_name account, int64_t ram_delta );
       void finalize_trace( action_trace& trace, const fc::time_point& start );
+      void record_profile( const action_trace& trace, const fc::time_point& start, const fc::microseconds& billable_start, bool failed );
+      void record_prefetch_history();
 
       bool is_context_free()const { return context_free; }
       bool is_privileged()const { return privileged; }
@@ -560,6 +615,10 @@ class apply_context {
       chainbase::database&          db;  ///< database where state is stored
       transaction_context&          trx_context; ///< transaction context in which the action is running
 
+      /// counted by the intrinsics for the contract_profiler, reset for each receiver
+      uint64_t                      intrinsic_calls = 0;
+      uint64_t                      db_ops = 0;
+
    private:
       const action*                 act = nullptr; ///< action being applied
       // act pointer may be invalidated on call to trx_context.schedule_action
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <eosio/chain/authority.hpp>
+#include <eosio/chain/permission_object.hpp>
+
+#include <memory>
+
+namespace eosio { namespace chain {
+
+/**
+ *  Bounded cache of the authorities of permissions expanded out of chainbase, keyed by permission and last_updated,
+ *  so authority_checker walks need neither a shared memory copy nor a webauthn key unpack per permission they visit.
+ *
+ *  Only permissions last updated before the head block are cached, and authorization_manager erases the entry of every
+ *  permission it creates, modifies or removes. A permission can then only change through authorization_manager, and
+ *  an undo cannot bring back an older authority with the one last_updated that is cached.
+ *
+ *  Thread safe, for the read only API threads; the cached authorities are immutable.
+ */
+class authority_cache {
+   public:
+      static constexpr size_t default_capacity = 100000;
+
+      using authority_ptr = std::shared_ptr<const authority>;
+
+      struct stats {
+         uint64_t hits      = 0;
+         uint64_t misses    = 0;
+         uint64_t evictions = 0;
+         uint64_t size      = 0;
+      };
+
+      authority_cache();
+      ~authority_cache();
+
+      /// @return the authority of @ref perm, cached when it was last updated before @ref head_block_time
+      authority_ptr get( const permission_object& perm, time_point head_block_time );
+
+      void erase( const permission_object& perm );
+
+      void clear();
+
+      stats get_stats()const;
+
+   private:
+      struct impl;
+      std::unique_ptr<impl> my;
+};
+
+} } // eosio::chain
+
+FC_REFLECT( eosio::chain::authority_cache::stats, (hits)(misses)(evictions)(size) )
@@ -2,6 +2,8 @@
 
 #include <eosio/chain/types.hpp>
 #include <eosio/chain/permission_object.hpp>
+#include <eosio/chain/authority_cache.hpp>
+#include <eosio/chain/key_account_index.hpp>
 #include <eosio/chain/snapshot.hpp>
 
 #include <utility>
@@ -112,11 +114,26 @@ namespace eosio { namespace chain {
                                                     )const;
 
 
+         authority_cache::stats get_authority_cache_stats()const { return _authority_cache.get_stats(); }
+
+         /// enables the key to account index with the permissions in the database
+         void rebuild_key_account_index();
+
+         bool key_account_index_enabled()const { return _key_account_index.enabled(); }
+
+         /// @return the permissions listing one of @ref keys; thread safe while the main thread is not writing the database
+         vector<key_account_index::match> find_key_accounts( const vector<public_key_type>& keys )const;
+
          static std::function<void()> _noop_checktime;
 
       private:
          const controller&    _control;
          chainbase::database& _db;
+         mutable authority_cache _authority_cache;
+         mutable key_account_index _key_account_index;
+
+         /// for an authority_checker, the authority of @ref level kept alive by @ref held
+         const authority& get_authority( const permission_level& level, vector<authority_cache::authority_ptr>& held )const;
 
          void             check_updateauth_authorization( const updateauth& update, const vector<permission_level>& auths )const;
          void             check_deleteauth_authorization( const deleteauth& del, const vector<permission_level>& auths )const;
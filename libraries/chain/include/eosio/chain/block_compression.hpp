@@ -0,0 +1,26 @@
+#pragma once
+#include <eosio/chain/types.hpp>
+
+namespace eosio { namespace chain {
+
+   /// codec of compressed blocks, sent to peers or stored in block log shards; zlib is always built, zstd and lz4
+   /// only when their library was found
+   enum class block_codec : uint8_t {
+      zlib = 0,
+      zstd = 1,
+      lz4  = 2,
+   };
+
+   /// @return whether this build can compress and decompress with @ref codec
+   bool block_codec_supported( block_codec codec );
+
+   /// @return the codec named @ref name, throws plugin_config_exception when it is unknown or not built
+   block_codec parse_block_codec( const std::string& name );
+
+   /// compresses the @ref size bytes at @ref data
+   bytes compress_block( block_codec codec, const char* data, size_t size );
+
+   /// decompresses @ref in, throws when it decompresses to more than @ref limit bytes or @ref codec is not built
+   bytes decompress_block( block_codec codec, const chain::bytes& in, size_t limit );
+
+} } // namespace eosio::chain
@@ -1,7 +1,9 @@
 #pragma once
 #include <fc/filesystem.hpp>
 #include <eosio/chain/block.hpp>
+#include <eosio/chain/block_compression.hpp>
 #include <eosio/chain/genesis_state.hpp>
+#include <eosio/chain/log_sync.hpp>
 
 namespace eosio { namespace chain {
 
@@ -30,6 +32,19 @@ namespace eosio { namespace chain {
     *
     * The main file is the only file that needs to persist. The index file can be reconstructed during a
     * linear scan of the main file.
+    *
+    * Blocks not in the main file can be kept next to it in compressed shards, blocks-<first>-<last>.clog as written
+    * by split_block_log. A shard holds its blocks in chunks of consecutive blocks, each compressed on its own,
+    * followed by an index of the chunks:
+    *
+    * +--------+-------+-------+-----+-------+-------------+------------------+
+    * | Header | Chunk | Chunk | ... | Chunk | Chunk Index | Pos of the Index |
+    * +--------+-------+-------+-----+-------+-------------+------------------+
+    *
+    * The header has the shard format, the codec, the first and last block and the chain id. A chunk decompresses to
+    * its blocks packed one after the other, and its index entry has its first block, position, compressed size and
+    * where each of its blocks ends once decompressed. Reading by block number falls back to the shards, so a shard
+    * can be archived or dropped without touching the main file or the other shards.
     */
 
    class block_log {
@@ -39,7 +54,11 @@ namespace eosio { namespace chain {
          ~block_log();
 
          uint64_t append(const signed_block_ptr& b);
+         /// @param packed_block  fc::raw packed @ref b, when the caller already has it
+         uint64_t append(const signed_block_ptr& b, const std::vector<char>& packed_block);
          void flush();
+         /// group commit of appends instead of flushing each of them, see @ref log_sync
+         void set_durability( const log_durability& durability );
          void reset( const genesis_state& gs, const signed_block_ptr& genesis_block );
          void reset( const chain_id_type& chain_id, uint32_t first_block_num );
 
@@ -47,6 +66,12 @@ namespace eosio { namespace chain {
          void             read_block_header(block_header& bh, uint64_t file_pos)const;
          signed_block_ptr read_block_by_num(uint32_t block_num)const;
          block_id_type    read_block_id_by_num(uint32_t block_num)const;
+
+         /**
+          * Return the packed bytes of a block exactly as stored in the log, without unpacking it,
+          * or an empty vector if the block is not in the log.
+          */
+         std::vector<char> read_serialized_block_by_num(uint32_t block_num)const;
          signed_block_ptr read_block_by_id(const block_id_type& id)const {
             return read_block_by_num(block_header::num_from_id(id));
          }
@@ -59,12 +84,16 @@ namespace eosio { namespace chain {
          const signed_block_ptr& head()const;
          const block_id_type&    head_id()const;
          uint32_t                first_block_num() const;
+         /// the first block readable by number, from the shards when they hold blocks before first_block_num()
+         uint32_t                first_available_block_num() const;
 
          static const uint64_t npos = std::numeric_limits<uint64_t>::max();
 
          static const uint32_t min_supported_version;
          static const uint32_t max_supported_version;
 
+         static constexpr uint32_t default_blocks_per_chunk = 256;
+
          static fc::path repair_log( const fc::path& data_dir, uint32_t truncate_at_block = 0 );
 
          static fc::optional<genesis_state> extract_genesis_state( const fc::path& data_dir );
@@ -81,6 +110,33 @@ namespace eosio { namespace chain {
 
          static bool trim_blocklog_front(const fc::path& block_dir, const fc::path& temp_dir, uint32_t truncate_at_block);
 
+         /**
+          * Copy blocks first_block through last_block (clamped to the blocks available) of the block log in block_dir
+          * into a new, self contained block log in output_dir. The result is a regular partial block log which can be
+          * opened by block_log and eosio-blocklog, so ranges of the log can be archived as independent shards.
+          * @return the number of blocks written
+          */
+         static uint32_t extract_block_range(const fc::path& block_dir, const fc::path& output_dir,
+                                             uint32_t first_block, uint32_t last_block);
+
+         /**
+          * Split the block log in block_dir into self contained block logs of blocks_per_file blocks in output_dir,
+          * named blocks-<first>-<last>.log and blocks-<first>-<last>.index. Files end at multiples of blocks_per_file,
+          * so the first and last files can be shorter. With a codec the files are compressed shards instead, named
+          * blocks-<first>-<last>.clog, of chunks of blocks_per_chunk blocks.
+          * @return the number of block logs written
+          */
+         static uint32_t split_block_log(const fc::path& block_dir, const fc::path& output_dir, uint32_t blocks_per_file,
+                                         const optional<block_codec>& codec = optional<block_codec>(),
+                                         uint32_t blocks_per_chunk = default_blocks_per_chunk);
+
+         /**
+          * Merge the consecutive blocks-<first>-<last>.log block logs in input_dir, as written by split_block_log, into
+          * a single blocks.log and blocks.index in output_dir.
+          * @return the number of blocks written
+          */
+         static uint32_t merge_block_logs(const fc::path& input_dir, const fc::path& output_dir);
+
    private:
          void open(const fc::path& data_dir);
          void construct_index();
@@ -96,6 +152,7 @@ namespace eosio { namespace chain {
 
    struct trim_data {            //used by trim_blocklog_front(), trim_blocklog_end(), and smoke_test()
       trim_data(fc::path block_dir);
+      trim_data(fc::path block_file, fc::path index_file);
       ~trim_data();
       uint64_t block_index(uint32_t n) const;
       uint64_t block_pos(uint32_t n);
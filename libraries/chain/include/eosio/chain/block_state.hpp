@@ -29,6 +29,11 @@ namespace eosio { namespace chain {
 
       block_state() = default;
 
+      /**
+       * @return block serialized with fc::raw, packed by the first caller and shared with every later one so the block
+       * log, the reversible blocks database and peers do not each pack it again; thread safe
+       */
+      std::shared_ptr<const std::vector<char>> packed_block()const;
 
       signed_block_ptr                                    block;
 
@@ -62,6 +67,9 @@ namespace eosio { namespace chain {
       /// this data is redundant with the data stored in block, but facilitates
       /// recapturing transactions when we pop a block
       vector<transaction_metadata_ptr>                    _cached_trxs;
+
+      /// only ever set once, from null, through std::atomic_ functions
+      mutable std::shared_ptr<const std::vector<char>>    _packed_block;
    };
 
    using block_state_ptr = std::shared_ptr<block_state>;
@@ -10,6 +10,7 @@ typedef __uint128_t uint128_t;
 
 const static auto default_blocks_dir_name    = "blocks";
 const static auto reversible_blocks_dir_name = "reversible";
+const static auto state_checkpoints_filename = "state-checkpoints.log";
 const static auto default_reversible_cache_size = 340*1024*1024ll;/// 1MB * 340 blocks based on 21 producer BFT delay
 const static auto default_reversible_guard_size = 2*1024*1024ll;/// 1MB * 340 blocks based on 21 producer BFT delay
 
@@ -81,6 +82,7 @@ const static uint16_t   default_max_auth_depth                 = 6;
 const static uint32_t   default_sig_cpu_bill_pct               = 50 * percent_1; // billable percentage of signature recovery
 const static uint32_t   default_block_cpu_effort_pct           = 80 * percent_1; // percentage of block time used for producing block
 const static uint16_t   default_controller_thread_pool_size    = 2;
+const static uint32_t   default_replay_prefetch_depth          = 16; ///< number of blocks read and unpacked ahead during replay
 const static uint32_t   default_max_variable_signature_length  = 16384u;
 
 const static uint32_t   min_net_usage_delta_between_base_and_max_for_trx  = 10*1024;
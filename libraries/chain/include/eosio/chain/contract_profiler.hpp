@@ -0,0 +1,67 @@
+#pragma once
+
+#include <eosio/chain/types.hpp>
+
+#include <array>
+#include <limits>
+#include <mutex>
+
+namespace eosio { namespace chain {
+
+/**
+ *  Execution counts and times of every (receiver, account, action) the controller applied since startup, or since
+ *  the last @ref clear, recorded by apply_context::exec_one for native handlers and contracts alike. A notification
+ *  is recorded under the notified receiver, with the account and name of the action it was notified of.
+ *
+ *  The table is split into shards by receiver, each with its own lock, so recording stays cheap and does not contend
+ *  with readers of other shards.
+ */
+class contract_profiler {
+   public:
+      struct counters {
+         uint64_t calls           = 0;
+         uint64_t failures        = 0; ///< calls that threw, their times are included
+         uint64_t billed_cpu_us   = 0; ///< the billing timer measured on this node, which excludes its pauses
+         uint64_t wall_us         = 0;
+         uint64_t intrinsic_calls = 0;
+         uint64_t db_ops          = 0; ///< calls of the contract table intrinsics
+
+         counters& operator+=( const counters& c ) {
+            calls           += c.calls;
+            failures        += c.failures;
+            billed_cpu_us   += c.billed_cpu_us;
+            wall_us         += c.wall_us;
+            intrinsic_calls += c.intrinsic_calls;
+            db_ops          += c.db_ops;
+            return *this;
+         }
+      };
+
+      struct entry : counters {
+         account_name receiver;
+         account_name account;
+         action_name  action;
+      };
+
+      void record( account_name receiver, account_name account, action_name action, const counters& c );
+
+      /// @return up to @ref limit entries, the most billed CPU time first
+      vector<entry> entries( size_t limit = std::numeric_limits<size_t>::max() )const;
+
+      void clear();
+
+   private:
+      static constexpr size_t shard_count = 16;
+
+      struct shard {
+         mutable std::mutex                                                      mtx;
+         flat_map<std::tuple<account_name, account_name, action_name>, counters> totals;
+      };
+
+      std::array<shard, shard_count> _shards;
+};
+
+} } // eosio::chain
+
+FC_REFLECT( eosio::chain::contract_profiler::counters, (calls)(failures)(billed_cpu_us)(wall_us)(intrinsic_calls)(db_ops) )
+FC_REFLECT_DERIVED( eosio::chain::contract_profiler::entry, (eosio::chain::contract_profiler::counters), (receiver)(account)(action) )
@@ -2,13 +2,17 @@
 #include <eosio/chain/block_state.hpp>
 #include <eosio/chain/trace.hpp>
 #include <eosio/chain/genesis_state.hpp>
+#include <eosio/chain/log_sync.hpp>
 #include <chainbase/pinnable_mapped_file.hpp>
 #include <boost/signals2/signal.hpp>
 
 #include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/abi_serializer_cache.hpp>
 #include <eosio/chain/account_object.hpp>
+#include <eosio/chain/contract_profiler.hpp>
 #include <eosio/chain/snapshot.hpp>
 #include <eosio/chain/protocol_feature_manager.hpp>
+#include <eosio/chain/table_lookup_cache.hpp>
 #include <eosio/chain/webassembly/eos-vm-oc/config.hpp>
 
 namespace chainbase {
@@ -21,6 +25,7 @@ namespace boost { namespace asio {
 namespace eosio { namespace chain {
 
    class authorization_manager;
+   class state_prefetcher;
 
    namespace resource_limits {
       class resource_limits_manager;
@@ -55,6 +60,13 @@ namespace eosio { namespace chain {
       LIGHT
    };
 
+   /// how much of the action traces the controller records beyond what applying the actions needs
+   enum class trace_level {
+      NONE,    ///< no action receipts, exceptions, console output or RAM deltas in the action traces
+      MINIMAL, ///< action receipts and exceptions, no console output or RAM deltas
+      FULL
+   };
+
    class controller {
       public:
          struct config {
@@ -73,6 +85,8 @@ namespace eosio { namespace chain {
             uint64_t                 reversible_guard_size  =  chain::config::default_reversible_guard_size;
             uint32_t                 sig_cpu_bill_pct       =  chain::config::default_sig_cpu_bill_pct;
             uint16_t                 thread_pool_size       =  chain::config::default_controller_thread_pool_size;
+            std::vector<uint32_t>    thread_pool_cpus;                //< cpus the thread pool threads are pinned to in turn; empty for none
+            uint32_t                 replay_prefetch_depth  =  chain::config::default_replay_prefetch_depth;
             bool                     read_only              =  false;
             bool                     force_all_checks       =  false;
             bool                     disable_replay_opts    =  false;
@@ -80,13 +94,27 @@ namespace eosio { namespace chain {
             bool                     allow_ram_billing_in_notify = false;
             uint32_t                 maximum_variable_signature_length = chain::config::default_max_variable_signature_length;
             bool                     disable_all_subjective_mitigations = false; //< for testing purposes only
+            bool                     track_table_access     =  false; //< record per-transaction contract table read/write sets
+            bool                     table_lookup_cache     =  false; //< cache contract table point lookups within each transaction
+            bool                     key_account_index      =  false; //< index the permissions by the public keys they list, for get_accounts_by_keys
+            bool                     profile_contracts      =  true;  //< count the calls and execution time of every action by receiver
+            uint32_t                 state_prefetch_pages   =  0;     //< pages of its recent rows to read in per contract ahead of execution in mapped mode; 0 for none
+            uint32_t                 fork_db_trx_metas_depth = 0;     //< reversible blocks this far below the newest drop their transaction metadata; 0 to keep it
+            uint32_t                 state_checkpoint_interval = 0;   //< record the state root of every block with a multiple of this number; 0 to record none
+            uint32_t                 terminate_at_block     =  0;     //< replay stops once this block is head; 0 to replay the whole block log
+            path                     replay_profile_file;             //< CSV file receiving the apply time of each replayed block; empty for none
+            log_durability           block_log_durability;            //< group commit of block log appends; flushes every block by default
 
             wasm_interface::vm_type  wasm_runtime = chain::config::default_wasm_runtime;
             eosvmoc::config          eosvmoc_config;
             bool                     eosvmoc_tierup         = false;
+            bool                     persistent_wasm_module_cache = false; //< keep injected wasm modules on disk across restarts
+            uint64_t                 wasm_module_cache_size = 1024ull*1024*1024; //< bytes the kept modules may take on disk, 0 for no limit
+            uint64_t                 wasm_instantiation_cache_size = 0;    //< bytes of instantiated modules to keep, 0 for no limit
 
             db_read_mode             read_mode              = db_read_mode::SPECULATIVE;
             validation_mode          block_validation_mode  = validation_mode::FULL;
+            trace_level              action_trace_level     = trace_level::FULL;
 
             pinnable_mapped_file::map_mode db_map_mode      = pinnable_mapped_file::map_mode::mapped;
             vector<string>           db_hugepage_paths;
@@ -145,6 +173,16 @@ namespace eosio { namespace chain {
          transaction_trace_ptr push_transaction( const transaction_metadata_ptr& trx, fc::time_point deadline,
                                                  uint32_t billed_cpu_time_us, bool explicit_billed_cpu_time );
 
+         /**
+          * Execute a transaction against the current pending state without producing a receipt.
+          * Any attempt by the transaction to modify contract tables, schedule deferred transactions, run a
+          * native action or call a privileged setter fails with read_only_trx_write_exception; all state
+          * changes are always rolled back. Its authorization is checked against trx's recovered keys and it
+          * runs within the authorizers' resource limits, but it is neither billed nor recorded for dedup,
+          * and no transaction signals are emitted. It runs on the calling thread like push_transaction.
+          */
+         transaction_trace_ptr push_read_only_transaction( const transaction_metadata_ptr& trx, fc::time_point deadline );
+
          /**
           * Attempt to execute a specific transaction in our deferred trx database
           *
@@ -157,6 +195,8 @@ namespace eosio { namespace chain {
          void commit_block();
 
          std::future<block_state_ptr> create_block_state_future( const signed_block_ptr& b );
+         /// @param id the id of @ref b the caller already computed, the future throws if it is not
+         std::future<block_state_ptr> create_block_state_future( const block_id_type& id, const signed_block_ptr& b );
 
          /**
           * @param block_state_future provide from call to create_block_state_future
@@ -168,6 +208,9 @@ namespace eosio { namespace chain {
                           const trx_meta_cache_lookup& trx_lookup );
 
          boost::asio::io_context& get_thread_pool();
+         /// signature recovery stage on the thread pool; transactions of blocks being validated are recovered with
+         /// high priority, relayed transactions with low priority
+         prioritized_task_queue& get_key_recovery_queue();
 
          const chainbase::database& db()const;
 
@@ -182,6 +225,19 @@ namespace eosio { namespace chain {
          authorization_manager&                get_mutable_authorization_manager();
          const protocol_feature_manager&       get_protocol_feature_manager()const;
 
+         /// row lookup hit counts by contract since startup, empty unless table lookup caching is enabled
+         const table_lookup_cache::stats_by_contract& get_table_lookup_stats()const;
+         /// nullptr unless table lookup caching is enabled
+         table_lookup_cache::stats_by_contract*       get_mutable_table_lookup_stats();
+
+         /// calls and execution time of every action by receiver since startup, empty unless profiling contracts
+         const contract_profiler&                     get_contract_profiler()const;
+         /// nullptr unless profiling contracts
+         contract_profiler*                           get_mutable_contract_profiler();
+
+         /// nullptr unless prefetching the state database, thread safe
+         state_prefetcher*                            get_state_prefetcher()const;
+
          const flat_set<account_name>&   get_actor_whitelist() const;
          const flat_set<account_name>&   get_actor_blacklist() const;
          const flat_set<account_name>&   get_contract_whitelist() const;
@@ -230,6 +286,8 @@ namespace eosio { namespace chain {
 
          signed_block_ptr fetch_block_by_number( uint32_t block_num )const;
          signed_block_ptr fetch_block_by_id( block_id_type id )const;
+         /// packed signed_block bytes; irreversible blocks are returned straight from the block log without unpacking
+         std::vector<char> fetch_serialized_block_by_number( uint32_t block_num )const;
 
          block_state_ptr fetch_block_state_by_number( uint32_t block_num )const;
          block_state_ptr fetch_block_state_by_id( block_id_type id )const;
@@ -237,6 +295,12 @@ namespace eosio { namespace chain {
          block_id_type get_block_id_for_num( uint32_t block_num )const;
 
          sha256 calculate_integrity_hash()const;
+         /**
+          * merkle root over per-section digests of the state, with a leaf per contract table rather than one for the
+          * contract_tables section; the leaves are hashed concurrently so this stalls the main thread for less time
+          * than calculate_integrity_hash, but the two values are not comparable
+          */
+         digest_type calculate_integrity_merkle_root()const;
          void write_snapshot( const snapshot_writer_ptr& snapshot )const;
 
          bool sender_avoids_whitelist_blacklist_enforcement( account_name sender )const;
@@ -268,6 +332,9 @@ namespace eosio { namespace chain {
          bool is_builtin_activated( builtin_protocol_feature_t f )const;
 
          bool is_known_unexpired_transaction( const transaction_id_type& id) const;
+         /// probes a bloom filter first, the transaction index only when the filter does not rule @ref id out;
+         /// @ref expiration is the one of the transaction of @ref id
+         bool is_known_unexpired_transaction( const transaction_id_type& id, fc::time_point_sec expiration ) const;
 
          int64_t set_proposed_producers( vector<producer_authority> producers );
 
@@ -284,6 +351,7 @@ namespace eosio { namespace chain {
 
          db_read_mode get_read_mode()const;
          validation_mode get_validation_mode()const;
+         trace_level get_trace_level()const;
 
          void set_subjective_cpu_leeway(fc::microseconds leeway);
          fc::optional<fc::microseconds> get_subjective_cpu_leeway() const;
@@ -337,7 +405,14 @@ namespace eosio { namespace chain {
          fc::variant to_variant_with_abi( const T& obj, const fc::microseconds& max_serialization_time ) {
             fc::variant pretty_output;
             abi_serializer::to_variant( obj, pretty_output,
-                                        [&]( account_name n ){ return get_abi_serializer( n, max_serialization_time ); },
+                                        [&]( account_name n ) -> std::shared_ptr<const abi_serializer> {
+                                           if( n.good() ) {
+                                              try {
+                                                 return abi_serializer_cache::get_serializer( db(), n, max_serialization_time );
+                                              } FC_CAPTURE_AND_LOG((n))
+                                           }
+                                           return {};
+                                        },
                                         max_serialization_time);
             return pretty_output;
          }
@@ -351,6 +426,8 @@ namespace eosio { namespace chain {
          friend class transaction_context;
 
          chainbase::database& mutable_db()const;
+         /// called for each transaction_object created, so the dedup filter covers all of them
+         void record_in_dedup_filter( const transaction_id_type& id, fc::time_point_sec expiration );
 
          std::unique_ptr<controller_impl> my;
 
@@ -24,10 +24,13 @@ namespace eosio { namespace chain {
           *         no changes to its format were made so it can be safely added to existing databases
           *   - 2 : shared_authority now holds shared_key_weights & shared_public_keys
           *         change from producer_key to producer_authority for many in-memory structures
+          *   - 3 : permission_index gains the by_owner_hash index and permission_link_index the by_action_name_hash
+          *         index; chainbase finds an index by the name of its value type, so state of version 2 has the old
+          *         layout under the same names and cannot be opened
           */
 
-         static constexpr uint32_t current_version            = 2;
-         static constexpr uint32_t minimum_version            = 2;
+         static constexpr uint32_t current_version            = 3;
+         static constexpr uint32_t minimum_version            = 3;
 
          id_type        id;
          uint32_t       version = current_version;
@@ -277,6 +277,8 @@ namespace eosio { namespace chain {
                                     3040017, "Transaction includes disallowed extensions (invalid block)" )
       FC_DECLARE_DERIVED_EXCEPTION( tx_resource_exhaustion, transaction_exception,
                                     3040018, "Transaction exceeded transient resource limit" )
+      FC_DECLARE_DERIVED_EXCEPTION( read_only_trx_write_exception, transaction_exception,
+                                    3040019, "Read-only transaction attempted to modify state" )
 
 
    FC_DECLARE_DERIVED_EXCEPTION( action_validate_exception, chain_exception,
@@ -584,6 +586,8 @@ namespace eosio { namespace chain {
                                     3190004, "block log backup dir already exists" )
       FC_DECLARE_DERIVED_EXCEPTION( block_index_not_found, block_log_exception,
                                     3190005, "block index can not be found"  )
+      FC_DECLARE_DERIVED_EXCEPTION( state_checkpoint_exception, block_log_exception,
+                                    3190006, "state does not match the recorded state checkpoint" )
 
    FC_DECLARE_DERIVED_EXCEPTION( http_exception, chain_exception,
                                  3200000, "http exception" )
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <softfloat.hpp>
+#include <cstdint>
+
+#if defined(__x86_64__) && defined(__SSE2_MATH__)
+#include <emmintrin.h>
+#define EOSIO_HARDWARE_FLOAT_SUPPORTED 1
+#else
+#define EOSIO_HARDWARE_FLOAT_SUPPORTED 0
+#endif
+
+namespace eosio { namespace chain { namespace hardware_float {
+
+   /**
+    * Drop in replacements for the softfloat operations behind the WASM float intrinsics, which use the IEEE 754
+    * arithmetic of the host wherever it gives the same bits as softfloat, and softfloat everywhere else.
+    *
+    * On x86-64 with SSE math, add, sub, mul, div and sqrt and the conversions below are correctly rounded by the hardware,
+    * and the 8086-SSE specialization softfloat is built with returns the same default NaN (0xFFC00000) for invalid
+    * operations. Which NaN operand an operation propagates depends on the operand order, which the compiler may swap for
+    * commutative operations, so NaN operands are always left to softfloat. So is everything while MXCSR is not in its
+    * default state of round to nearest, all exceptions masked, and neither flush to zero nor denormals are zero.
+    */
+   constexpr bool supported = EOSIO_HARDWARE_FLOAT_SUPPORTED;
+
+#if EOSIO_HARDWARE_FLOAT_SUPPORTED
+   /// ignores the sticky exception flags, which softfloat keeps separately
+   inline bool default_environment() { return (_mm_getcsr() & 0xFFC0) == 0x1F80; }
+
+   inline float32_t to_float32( float f ) { return to_softfloat32( f ); }
+   inline float64_t to_float64( double d ) { return to_softfloat64( d ); }
+   inline float     host( float32_t f ) { return from_softfloat32( f ); }
+   inline double    host( float64_t d ) { return from_softfloat64( d ); }
+
+   inline bool use_hardware( float32_t a ) { return !f32_is_nan( a ) && default_environment(); }
+   inline bool use_hardware( float64_t a ) { return !f64_is_nan( a ) && default_environment(); }
+   inline bool use_hardware( float32_t a, float32_t b ) { return !f32_is_nan( a ) && !f32_is_nan( b ) && default_environment(); }
+   inline bool use_hardware( float64_t a, float64_t b ) { return !f64_is_nan( a ) && !f64_is_nan( b ) && default_environment(); }
+
+   inline float32_t f32_add( float32_t a, float32_t b ) { return use_hardware( a, b ) ? to_float32( host( a ) + host( b ) ) : ::f32_add( a, b ); }
+   inline float32_t f32_sub( float32_t a, float32_t b ) { return use_hardware( a, b ) ? to_float32( host( a ) - host( b ) ) : ::f32_sub( a, b ); }
+   inline float32_t f32_mul( float32_t a, float32_t b ) { return use_hardware( a, b ) ? to_float32( host( a ) * host( b ) ) : ::f32_mul( a, b ); }
+   inline float32_t f32_div( float32_t a, float32_t b ) { return use_hardware( a, b ) ? to_float32( host( a ) / host( b ) ) : ::f32_div( a, b ); }
+   inline float32_t f32_sqrt( float32_t a ) {
+      // the instruction itself, std::sqrt may call into libm for negative inputs
+      return use_hardware( a ) ? to_float32( _mm_cvtss_f32( _mm_sqrt_ss( _mm_set_ss( host( a ) ) ) ) ) : ::f32_sqrt( a );
+   }
+
+   inline float64_t f64_add( float64_t a, float64_t b ) { return use_hardware( a, b ) ? to_float64( host( a ) + host( b ) ) : ::f64_add( a, b ); }
+   inline float64_t f64_sub( float64_t a, float64_t b ) { return use_hardware( a, b ) ? to_float64( host( a ) - host( b ) ) : ::f64_sub( a, b ); }
+   inline float64_t f64_mul( float64_t a, float64_t b ) { return use_hardware( a, b ) ? to_float64( host( a ) * host( b ) ) : ::f64_mul( a, b ); }
+   inline float64_t f64_div( float64_t a, float64_t b ) { return use_hardware( a, b ) ? to_float64( host( a ) / host( b ) ) : ::f64_div( a, b ); }
+   inline float64_t f64_sqrt( float64_t a ) {
+      return use_hardware( a ) ? to_float64( _mm_cvtsd_f64( _mm_sqrt_sd( _mm_setzero_pd(), _mm_set_sd( host( a ) ) ) ) ) : ::f64_sqrt( a );
+   }
+
+   inline float64_t f32_to_f64( float32_t a ) { return use_hardware( a ) ? to_float64( static_cast<double>( host( a ) ) ) : ::f32_to_f64( a ); }
+   inline float32_t f64_to_f32( float64_t a ) { return use_hardware( a ) ? to_float32( static_cast<float>( host( a ) ) ) : ::f64_to_f32( a ); }
+
+   // every integer is converted with a single rounding, conversions from uint64_t are left out as x86-64 has no
+   // instruction for them and the compiler emitted sequence is not one
+   inline float32_t i32_to_f32( int32_t a )  { return default_environment() ? to_float32( static_cast<float>( a ) ) : ::i32_to_f32( a ); }
+   inline float32_t i64_to_f32( int64_t a )  { return default_environment() ? to_float32( static_cast<float>( a ) ) : ::i64_to_f32( a ); }
+   inline float32_t ui32_to_f32( uint32_t a ) { return default_environment() ? to_float32( static_cast<float>( static_cast<int64_t>( a ) ) ) : ::ui32_to_f32( a ); }
+   inline float64_t i32_to_f64( int32_t a )  { return to_float64( static_cast<double>( a ) ); } // exact
+   inline float64_t i64_to_f64( int64_t a )  { return default_environment() ? to_float64( static_cast<double>( a ) ) : ::i64_to_f64( a ); }
+   inline float64_t ui32_to_f64( uint32_t a ) { return to_float64( static_cast<double>( a ) ); } // exact
+#else
+   using ::f32_add; using ::f32_sub; using ::f32_mul; using ::f32_div; using ::f32_sqrt;
+   using ::f64_add; using ::f64_sub; using ::f64_mul; using ::f64_div; using ::f64_sqrt;
+   using ::f32_to_f64; using ::f64_to_f32;
+   using ::i32_to_f32; using ::i64_to_f32; using ::ui32_to_f32;
+   using ::i32_to_f64; using ::i64_to_f64; using ::ui32_to_f64;
+#endif
+
+} } } // namespace eosio::chain::hardware_float
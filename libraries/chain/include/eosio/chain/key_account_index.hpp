@@ -0,0 +1,53 @@
+#pragma once
+
+#include <eosio/chain/authority.hpp>
+#include <eosio/chain/permission_object.hpp>
+
+#include <memory>
+
+namespace eosio { namespace chain {
+
+/**
+ *  Index of the permissions whose authority lists a public key, for key to account lookups without history_plugin.
+ *
+ *  authorization_manager adds the keys of every permission it creates or modifies; entries are never removed on an
+ *  undo, so the index holds a superset and @ref find checks each candidate against the permission in chainbase.
+ *  A candidate whose permission no longer lists the key is dropped once that permission was last updated at or before
+ *  the last irreversible block, when no undo can bring the key back; one whose permission is gone is kept.
+ *
+ *  Thread safe; @ref find reads chainbase, so it runs on the main thread or while the main thread is not writing.
+ */
+class key_account_index {
+   public:
+      struct match {
+         public_key_type    key;
+         permission_level   permission;
+         weight_type        weight    = 0;
+         uint32_t           threshold = 0;
+      };
+
+      key_account_index();
+      ~key_account_index();
+
+      /// no-op until @ref rebuild enables the index
+      void add( const permission_object& perm );
+
+      /// enables the index with the keys of every permission in @ref db
+      void rebuild( const chainbase::database& db );
+
+      /// disables the index
+      void clear();
+
+      bool enabled()const;
+
+      /// @return the permissions of @ref db that list one of @ref keys, ordered by key then permission
+      vector<match> find( const chainbase::database& db, const vector<public_key_type>& keys, time_point irreversible_time )const;
+
+      size_t size()const;
+
+   private:
+      struct impl;
+      std::unique_ptr<impl> my;
+};
+
+} } // eosio::chain
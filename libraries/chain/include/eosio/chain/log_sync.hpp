@@ -0,0 +1,58 @@
+#pragma once
+
+#include <fc/filesystem.hpp>
+#include <fc/time.hpp>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace eosio { namespace chain {
+
+   /// when the buffered appends of a log are flushed to the operating system and synced to storage
+   struct log_durability {
+      uint32_t          flush_blocks   = 1;   ///< flush after this many appends; 0 to flush on the interval only
+      fc::microseconds  flush_interval;       ///< or at the first append this long after the last flush; 0 for none
+      bool              fsync          = false; ///< fsync the log's files after each flush
+   };
+
+   /**
+    * Group commit for an append only log. The log's writer reports every append and its buffered files are only
+    * flushed once enough appends or time have accumulated. With fsync configured, the flushed files are then synced
+    * on a dedicated thread, so the writer never waits on the storage. Appends that were not flushed or synced yet are
+    * lost in a crash and the log's tail is recovered as for any other interrupted write.
+    */
+   class log_sync {
+   public:
+      /// @param files  the log's files, synced by path so the writer's handles are never shared with the thread
+      log_sync( std::string thread_name, const log_durability& durability, std::vector<fc::path> files );
+
+      /// joins the sync thread; call flush_now first to make everything durable
+      ~log_sync();
+
+      /// after each append, calls flush when the group commit is due
+      void appended( const std::function<void()>& flush );
+
+      /// flush and, with fsync configured, sync before returning
+      void flush_now( const std::function<void()>& flush );
+
+   private:
+      void run();
+      void sync_files();
+
+      log_durability            _durability;
+      std::vector<fc::path>     _files;
+      uint32_t                  _unflushed = 0;
+      fc::time_point            _last_flush;
+
+      std::mutex                _mtx;
+      std::condition_variable   _cond;
+      bool                      _sync_requested = false; // guarded by _mtx
+      bool                      _stopping = false;       // guarded by _mtx
+      std::thread               _thread;
+   };
+
+} } // eosio::chain
@@ -1,6 +1,10 @@
 #pragma once
 #include <eosio/chain/types.hpp>
 
+namespace boost { namespace asio {
+   class io_context;
+}}
+
 namespace eosio { namespace chain {
 
    digest_type make_canonical_left(const digest_type& val);
@@ -16,7 +20,47 @@ namespace eosio { namespace chain {
 
    /**
     *  Calculates the merkle root of a set of digests, if ids is odd it will duplicate the last id.
+    *  Given a thread_pool, levels wide enough to be worth it are hashed on it and the calling thread together;
+    *  the result is the same either way.
+    */
+   digest_type merkle( vector<digest_type> ids, boost::asio::io_context* thread_pool = nullptr );
+
+   /**
+    *  Accumulates the same root as merkle() one digest at a time. Only complete subtrees are hashed as digests are
+    *  appended, one hash per digest amortized; the partial right edge, where merkle() duplicates the last node of odd
+    *  levels, is only folded in by get_root().
     */
-   digest_type merkle( vector<digest_type> ids );
+   class merkle_accumulator {
+      public:
+         void append( const digest_type& digest ) {
+            digest_type top = digest;
+            uint32_t level = 0;
+            while( !_subtrees.empty() && _subtrees.back().first == level ) {
+               top = digest_type::hash( make_canonical_pair( _subtrees.back().second, top ) );
+               _subtrees.pop_back();
+               ++level;
+            }
+            _subtrees.emplace_back( level, top );
+         }
+
+         digest_type get_root()const {
+            if( _subtrees.empty() ) return digest_type();
+
+            auto itr = _subtrees.rbegin();
+            digest_type top = itr->second;
+            uint32_t level = itr->first;
+            for( ++itr; itr != _subtrees.rend(); ++itr ) {
+               for( ; level < itr->first; ++level )
+                  top = digest_type::hash( make_canonical_pair( top, top ) );
+               top = digest_type::hash( make_canonical_pair( itr->second, top ) );
+               level = itr->first + 1;
+            }
+            return top;
+         }
+
+      private:
+         /// roots of the complete subtrees by level, strictly descending, as in the binary representation of the count
+         vector<std::pair<uint32_t, digest_type>> _subtrees;
+   };
 
 } } /// eosio::chain
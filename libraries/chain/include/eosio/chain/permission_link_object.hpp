@@ -40,6 +40,7 @@ namespace eosio { namespace chain {
    };
 
    struct by_action_name;
+   struct by_action_name_hash;
    struct by_permission_name;
    using permission_link_index = chainbase::shared_multi_index_container<
       permission_link_object,
@@ -60,6 +61,15 @@ namespace eosio { namespace chain {
                BOOST_MULTI_INDEX_MEMBER(permission_link_object, permission_name, required_permission),
                BOOST_MULTI_INDEX_MEMBER(permission_link_object, permission_link_object::id_type, id)
             >
+         >,
+         // the lookups of authorization checks, by_action_name is kept for the ordered walks over the links of an account
+         hashed_unique<tag<by_action_name_hash>,
+            composite_key<permission_link_object,
+               BOOST_MULTI_INDEX_MEMBER(permission_link_object, account_name, account),
+               BOOST_MULTI_INDEX_MEMBER(permission_link_object, account_name, code),
+               BOOST_MULTI_INDEX_MEMBER(permission_link_object, action_name, message_type)
+            >,
+            composite_key_hash<std::hash<account_name>, std::hash<account_name>, std::hash<action_name>>
          >
       >
    >;
@@ -67,7 +77,8 @@ namespace eosio { namespace chain {
    namespace config {
       template<>
       struct billable_size<permission_link_object> {
-         static const uint64_t overhead = overhead_per_row_per_index_ram_bytes * 3; ///< 3x indices id, action, permission
+         /// 3x indices id, action, permission; by_action_name_hash is not billed, the billable size is consensus
+         static const uint64_t overhead = overhead_per_row_per_index_ram_bytes * 3;
          static const uint64_t value = 40 + overhead; ///< fixed field + overhead
       };
    }
@@ -82,6 +82,7 @@ namespace eosio { namespace chain {
 
    struct by_parent;
    struct by_owner;
+   struct by_owner_hash;
    struct by_name;
    using permission_index = chainbase::shared_multi_index_container<
       permission_object,
@@ -104,6 +105,14 @@ namespace eosio { namespace chain {
                member<permission_object, permission_name, &permission_object::name>,
                member<permission_object, permission_object::id_type, &permission_object::id>
             >
+         >,
+         // the lookups of authorization checks, by_owner is kept for the ordered walks over the permissions of an account
+         hashed_unique<tag<by_owner_hash>,
+            composite_key<permission_object,
+               member<permission_object, account_name, &permission_object::owner>,
+               member<permission_object, permission_name, &permission_object::name>
+            >,
+            composite_key_hash<std::hash<account_name>, std::hash<permission_name>>
          >
       >
    >;
@@ -111,7 +120,8 @@ namespace eosio { namespace chain {
    namespace config {
       template<>
       struct billable_size<permission_object> { // Also counts memory usage of the associated permission_usage_object
-         static const uint64_t  overhead = 5 * overhead_per_row_per_index_ram_bytes; ///< 5 indices 2x internal ID, parent, owner, name
+         /// 5 indices 2x internal ID, parent, owner, name; by_owner_hash is not billed, the billable size is consensus
+         static const uint64_t  overhead = 5 * overhead_per_row_per_index_ram_bytes;
          static const uint64_t  value = (config::billable_size_v<shared_authority> + 64) + overhead;  ///< fixed field size + overhead
       };
    }
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <eosio/chain/types.hpp>
+
+namespace eosio { namespace chain {
+
+/**
+ *  Process wide, bounded cache of the public keys recovered from (digest, signature) pairs. Transaction signature
+ *  verification and the recover_key/assert_recover_key intrinsics both go through it, so a signature a contract
+ *  checks again, or one already checked while the transaction was received, is only recovered once.
+ *
+ *  Thread safe, transaction signatures are recovered on the chain thread pool.
+ */
+class recovered_key_cache {
+   public:
+      static constexpr size_t default_capacity = 10000;
+
+      /**
+       *  @param check_canonical enforce a canonical signature, an entry cached by a caller that did not enforce it
+       *         is recovered again for one that does
+       *  @return the key recovered from @ref sig over @ref digest
+       */
+      static public_key_type recover( const signature_type& sig, const digest_type& digest, bool check_canonical );
+
+      /// drop the least recently used entries until no more than @ref capacity remain
+      static void set_capacity( size_t capacity );
+
+      static void clear();
+};
+
+} } // eosio::chain
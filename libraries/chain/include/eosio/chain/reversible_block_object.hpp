@@ -21,6 +21,10 @@ namespace eosio { namespace chain {
          fc::raw::pack( ds, *b );
       }
 
+      void set_packed_block( const std::vector<char>& packed ) {
+         packedblock.assign( packed.data(), packed.size() );
+      }
+
       signed_block_ptr get_block()const {
          fc::datastream<const char*> ds( packedblock.data(), packedblock.size() );
          auto result = std::make_shared<signed_block>();
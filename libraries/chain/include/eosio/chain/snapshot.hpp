@@ -2,9 +2,22 @@
 
 #include <eosio/chain/database_utils.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/io/datastream.hpp>
 #include <fc/variant_object.hpp>
 #include <boost/core/demangle.hpp>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
 #include <ostream>
+#include <sstream>
+#include <streambuf>
+
+namespace boost { namespace interprocess {
+   class file_mapping;
+   class mapped_region;
+} }
 
 namespace eosio { namespace chain {
    /**
@@ -157,6 +170,7 @@ namespace eosio { namespace chain {
    namespace detail {
       struct abstract_snapshot_row_reader {
          virtual void provide(std::istream& in) const = 0;
+         virtual void provide(fc::datastream<const char*>& in) const = 0;
          virtual void provide(const fc::variant&) const = 0;
          virtual std::string row_type_name() const = 0;
       };
@@ -202,6 +216,12 @@ namespace eosio { namespace chain {
             });
          }
 
+         void provide(fc::datastream<const char*>& in) const override {
+            row_validation_helper::apply(data, [&in,this](){
+               fc::raw::unpack(in, data);
+            });
+         }
+
          void provide(const fc::variant& var) const override {
             row_validation_helper::apply(data, [&var,this]() {
                fc::from_variant(var, data);
@@ -326,6 +346,8 @@ namespace eosio { namespace chain {
          uint64_t cur_row;
    };
 
+   class section_buffer_snapshot_writer;
+
    class ostream_snapshot_writer : public snapshot_writer {
       public:
          explicit ostream_snapshot_writer(std::ostream& snapshot);
@@ -337,6 +359,17 @@ namespace eosio { namespace chain {
 
          static const uint32_t magic_number = 0x30510550;
 
+         /**
+          * Append sections that were serialized separately by a section_buffer_snapshot_writer, releasing its
+          * buffer as it is written out.  This allows independent groups of sections to be serialized concurrently
+          * and then written out in a fixed order.
+          */
+         void append_sections( section_buffer_snapshot_writer& sections );
+
+      protected:
+         struct no_header_t {};
+         ostream_snapshot_writer(std::ostream& snapshot, no_header_t);
+
       private:
          detail::ostream_wrapper snapshot;
          std::streampos          header_pos;
@@ -345,6 +378,52 @@ namespace eosio { namespace chain {
 
    };
 
+   namespace detail {
+      /**
+       * An output buffer held in fixed size chunks, so growing it never reallocates and copies what was written, and
+       * writing it out releases each chunk as soon as it has been written instead of copying the whole buffer first.
+       * Seeking back within what was written is supported for the section headers.
+       */
+      class chunked_streambuf : public std::streambuf {
+         public:
+            static constexpr size_t chunk_size = 1024 * 1024;
+
+            /// writes everything buffered to @ref out and empties the buffer
+            void write_to( std::ostream& out );
+
+         protected:
+            int_type overflow( int_type ch ) override;
+            std::streamsize xsputn( const char* s, std::streamsize n ) override;
+            pos_type seekoff( off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which ) override;
+            pos_type seekpos( pos_type pos, std::ios_base::openmode which ) override;
+
+         private:
+            size_t position() const;
+            void   put_chunk( size_t index );
+
+            std::deque<std::unique_ptr<char[]>> chunks;
+            size_t                              cur_chunk = 0;
+            size_t                              size      = 0; ///< bytes written, past any seek back
+      };
+
+      struct section_buffer_holder {
+         chunked_streambuf buf;
+         std::ostream      buffer{&buf};
+      };
+   }
+
+   /**
+    * Writes sections in the binary snapshot format, without the leading header or trailing end marker, to an
+    * in-memory buffer.  The result is meant to be passed to ostream_snapshot_writer::append_sections
+    */
+   class section_buffer_snapshot_writer : private detail::section_buffer_holder, public ostream_snapshot_writer {
+      public:
+         section_buffer_snapshot_writer();
+
+         /// writes the buffered sections to @ref out and releases the buffer
+         void write_sections_to( std::ostream& out );
+   };
+
    class istream_snapshot_reader : public snapshot_reader {
       public:
          explicit istream_snapshot_reader(std::istream& snapshot);
@@ -358,12 +437,131 @@ namespace eosio { namespace chain {
          void return_to_header() override;
 
       private:
+         struct section_info {
+            std::streampos row_pos;
+            uint64_t       row_count = 0;
+         };
+
          bool validate_section() const;
+         const std::map<std::string, section_info>& section_index();
 
          std::istream&  snapshot;
          std::streampos header_pos;
          uint64_t       num_rows;
          uint64_t       cur_row;
+         fc::optional<std::map<std::string, section_info>> sections;
+   };
+
+   /**
+    * Reads a binary snapshot in place, from a read only mapping of the snapshot file or from a buffer. Rows are
+    * unpacked with an fc::datastream bounded by their section instead of through a std::istream, and the kernel is
+    * asked to read each section ahead as it is set, so a restore reads the file in large sequential requests.
+    */
+   class mapped_snapshot_reader : public snapshot_reader {
+      public:
+         explicit mapped_snapshot_reader(const fc::path& snapshot_file);
+
+         /// reads the @ref size bytes at @ref data, which must outlive the reader
+         mapped_snapshot_reader(const char* data, size_t size);
+
+         ~mapped_snapshot_reader();
+
+         void validate() const override;
+         bool has_section( const string& section_name ) override;
+         void set_section( const string& section_name ) override;
+         bool read_row( detail::abstract_snapshot_row_reader& row_reader ) override;
+         bool empty ( ) override;
+         void clear_section() override;
+         void return_to_header() override;
+
+      private:
+         struct section_info {
+            uint64_t row_offset = 0; ///< from the start of the snapshot
+            uint64_t end_offset = 0;
+            uint64_t row_count  = 0;
+         };
+
+         const std::map<std::string, section_info>& section_index();
+
+         std::unique_ptr<boost::interprocess::file_mapping>  file;
+         std::unique_ptr<boost::interprocess::mapped_region> region;
+         const char*                                         data;
+         size_t                                              size;
+         fc::datastream<const char*>                         rows;
+         uint64_t                                            num_rows;
+         uint64_t                                            cur_row;
+         fc::optional<std::map<std::string, section_info>>   sections;
+   };
+
+   namespace detail {
+      struct compressed_snapshot_section {
+         std::string name;
+         uint64_t    offset    = 0; ///< relative to the start of the snapshot header
+         uint64_t    size      = 0; ///< compressed size in bytes
+         uint64_t    row_count = 0;
+      };
+   }
+
+   /**
+    * Binary snapshot variant where every section is an independent zlib stream.  A table of sections with their
+    * offsets and compressed sizes is written after the last section, followed by the offset of that table, so a
+    * reader can seek directly to any section and decompress it on the fly.
+    */
+   class compressed_ostream_snapshot_writer : public snapshot_writer {
+      public:
+         explicit compressed_ostream_snapshot_writer(std::ostream& snapshot);
+         ~compressed_ostream_snapshot_writer();
+
+         void write_start_section( const std::string& section_name ) override;
+         void write_row( const detail::abstract_snapshot_row_writer& row_writer ) override;
+         void write_end_section( ) override;
+         void finalize();
+
+         static const uint32_t magic_number = 0x30510551;
+
+         /// compress a section whose @ref size bytes of rows, in the binary row format, are read from @ref rows
+         void append_section( const std::string& section_name, std::istream& rows, uint64_t size, uint64_t row_count );
+
+      private:
+         std::ostream&                                    snapshot;
+         std::streampos                                   header_pos;
+         std::unique_ptr<std::ostream>                    compressor;
+         fc::optional<detail::compressed_snapshot_section> current_section;
+         std::vector<detail::compressed_snapshot_section> sections;
+   };
+
+   /**
+    * Rewrite a binary snapshot in the compressed format section by section, without unpacking its rows.  @ref progress,
+    * if set, is called after every section with the number of bytes of @ref uncompressed consumed so far
+    */
+   void compress_snapshot( std::istream& uncompressed, std::ostream& compressed,
+                           const std::function<void(uint64_t)>& progress = std::function<void(uint64_t)>() );
+
+   class compressed_istream_snapshot_reader : public snapshot_reader {
+      public:
+         explicit compressed_istream_snapshot_reader(std::istream& snapshot);
+         ~compressed_istream_snapshot_reader();
+
+         void validate() const override;
+         bool has_section( const string& section_name ) override;
+         void set_section( const string& section_name ) override;
+         bool read_row( detail::abstract_snapshot_row_reader& row_reader ) override;
+         bool empty ( ) override;
+         void clear_section() override;
+         void return_to_header() override;
+
+         /// true if the stream, at its current position, starts with a compressed snapshot header
+         static bool is_compressed( std::istream& snapshot );
+
+      private:
+         const std::map<std::string, detail::compressed_snapshot_section>& section_index();
+
+         std::istream&                 snapshot;
+         std::streampos                header_pos;
+         std::unique_ptr<std::istream> decompressor;
+         uint64_t                      num_rows;
+         uint64_t                      cur_row;
+         fc::optional<std::map<std::string, detail::compressed_snapshot_section>> sections;
    };
 
    class integrity_hash_snapshot_writer : public snapshot_writer {
@@ -380,4 +578,26 @@ namespace eosio { namespace chain {
 
    };
 
+   /**
+    * Hashes the rows of each section independently, recording one digest per section in the order the sections
+    * were written
+    */
+   class section_hash_snapshot_writer : public snapshot_writer {
+      public:
+         using section_hash = std::pair<std::string, fc::sha256>;
+
+         void write_start_section( const std::string& section_name ) override;
+         void write_row( const detail::abstract_snapshot_row_writer& row_writer ) override;
+         void write_end_section( ) override;
+
+         const std::vector<section_hash>& section_hashes() const { return hashes; }
+
+      private:
+         fc::optional<fc::sha256::encoder> enc;
+         std::string                       current_section_name;
+         std::vector<section_hash>         hashes;
+   };
+
 }}
+
+FC_REFLECT( eosio::chain::detail::compressed_snapshot_section, (name)(offset)(size)(row_count) )
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <eosio/chain/types.hpp>
+
+#include <istream>
+#include <ostream>
+
+namespace eosio { namespace chain {
+
+/**
+ *  A snapshot delta encodes a target snapshot file as a sequence of ranges copied from a base snapshot file and
+ *  literal bytes that do not appear in the base.  Both files are split into content defined chunks, so rows
+ *  added or removed in one part of the state only affect the chunks around them and the rest of the target
+ *  is expressed as references into the base.
+ *
+ *  The delta records the sha256 of the base it was made against and of the target it reproduces.  Applying a
+ *  delta to any other base is rejected, which allows a chain of deltas to be applied one after the other onto
+ *  a full snapshot.
+ */
+namespace snapshot_delta {
+   static const uint32_t magic_number = 0x30510552;
+   static const uint32_t current_version = 1;
+
+   struct summary {
+      fc::sha256 base_hash;
+      fc::sha256 target_hash;
+      uint64_t   copied_bytes  = 0;
+      uint64_t   literal_bytes = 0;
+   };
+
+   /// write a delta that reproduces @ref target from @ref base; both streams are read from their current position
+   summary write( std::istream& base, std::istream& target, std::ostream& delta );
+
+   /// reconstruct the target of @ref delta onto @ref out; @ref base must be the exact snapshot the delta was made against
+   summary apply( std::istream& base, std::istream& delta, std::ostream& out );
+}
+
+} } // eosio::chain
@@ -0,0 +1,42 @@
+#pragma once
+#include <fc/filesystem.hpp>
+#include <fc/io/cfile.hpp>
+#include <eosio/chain/types.hpp>
+
+#include <map>
+
+namespace eosio { namespace chain {
+
+   struct state_checkpoint {
+      block_id_type block_id;
+      digest_type   state_root; ///< controller::calculate_integrity_merkle_root() with the block as head
+   };
+
+   /**
+    *  Append only file of fixed size state_checkpoint entries, recorded every so many blocks while the node runs
+    *  so that a later replay of the same blocks can compare the state it reaches against them and stop at the first
+    *  block that diverges rather than only noticing at the end.
+    *
+    *  Entries are recorded at the head, so the file may also hold entries for blocks that were later forked out.
+    *  Lookups are by block id and those never match. A torn entry at the end of the file, left by a crash while
+    *  appending, is dropped when the file is opened.
+    */
+   class state_checkpoint_log {
+      public:
+         explicit state_checkpoint_log( const fc::path& file_path );
+
+         void append( const state_checkpoint& c );
+
+         /// @return the state root recorded for @ref id, if any
+         optional<digest_type> find( const block_id_type& id )const;
+
+         size_t size()const { return _checkpoints.size(); }
+
+      private:
+         fc::cfile                              _file;
+         std::map<block_id_type, digest_type>   _checkpoints;
+   };
+
+} }
+
+FC_REFLECT( eosio::chain::state_checkpoint, (block_id)(state_root) )
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <eosio/chain/types.hpp>
+#include <eosio/chain/thread_utils.hpp>
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace eosio { namespace chain {
+
+struct transaction;
+
+/**
+ *  Asks the kernel to read in the pages of the state database that the contracts of a transaction or block are
+ *  likely to touch, before the main thread executes it. With database-map-mode = mapped and a state larger than RAM,
+ *  the first touches of cold rows otherwise fault the pages in one at a time during apply.
+ *
+ *  The prediction is the history of each contract: the pages of the rows its last actions were handed, up to a bound
+ *  per contract. Pages are only passed to madvise(MADV_WILLNEED) on a thread of the prefetcher, nothing there reads
+ *  the database, so a page whose rows were freed in the meantime costs nothing but a wasted read.
+ */
+class state_prefetcher {
+   public:
+      explicit state_prefetcher( size_t pages_per_contract );
+
+      /// called on the main thread at the end of an action of @ref contract with the rows it was handed
+      void record( account_name contract, const vector<const void*>& objects );
+
+      /// thread safe, queues the prefetch of the pages recorded for the contracts of @ref trx
+      void prefetch( const transaction& trx );
+      void prefetch( const flat_set<account_name>& contracts );
+
+      /// number of pages remembered for @ref contract
+      size_t pages( account_name contract )const;
+
+   private:
+      struct contract_pages {
+         std::deque<uintptr_t>         order; ///< oldest first, the first to go above the bound
+         std::unordered_set<uintptr_t> pages;
+         bool                          queued = false; ///< a prefetch of these pages has not run yet
+      };
+
+      void advise( account_name contract );
+
+      const size_t                                     _pages_per_contract;
+      const uintptr_t                                  _page_mask;
+      mutable std::mutex                               _mtx;
+      std::unordered_map<account_name, contract_pages> _contracts; ///< protected by _mtx
+      named_thread_pool                                _thread_pool; ///< last, stopped before the members it uses go
+};
+
+} } // eosio::chain
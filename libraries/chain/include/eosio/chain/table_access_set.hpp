@@ -0,0 +1,39 @@
+#pragma once
+
+#include <eosio/chain/types.hpp>
+
+namespace eosio { namespace chain {
+
+/**
+ *  Records which contract tables, identified by (code, scope, table), a transaction read from and wrote to.
+ *  Two transactions whose sets do not conflict could be executed in either order with the same result for
+ *  contract table state.
+ */
+struct table_access_set {
+   using key_type = std::tuple<account_name, scope_name, table_name>;
+
+   flat_set<key_type> reads;
+   flat_set<key_type> writes;
+
+   void add_read( account_name code, scope_name scope, table_name table ) {
+      reads.emplace( code, scope, table );
+   }
+
+   void add_write( account_name code, scope_name scope, table_name table ) {
+      writes.emplace( code, scope, table );
+   }
+
+   /// @return true if either set writes a table the other one reads or writes
+   bool conflicts_with( const table_access_set& other )const;
+};
+
+/**
+ *  Greedily assigns each access set, in order, to the first wave after the last wave containing a conflicting set.
+ *  Sets in the same wave do not conflict with each other and executing waves in sequence preserves the original
+ *  ordering between all conflicting pairs.
+ *
+ *  @return the wave index of each set
+ */
+vector<uint32_t> partition_into_waves( const vector<table_access_set>& sets );
+
+} } // eosio::chain
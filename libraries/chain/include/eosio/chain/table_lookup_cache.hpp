@@ -0,0 +1,100 @@
+#pragma once
+
+#include <eosio/chain/contract_table_objects.hpp>
+
+#include <map>
+#include <tuple>
+
+namespace eosio { namespace chain {
+
+/**
+ *  Transaction scoped cache of contract table point lookups: tables by (code, scope, table) and rows by primary key,
+ *  including the absence of either. It is kept exact rather than invalidated, apply_context updates it for every
+ *  table or row it creates or removes, so a hit always agrees with chainbase. Updates modify rows in place and the
+ *  cache only holds pointers to them, so those need no maintenance.
+ *
+ *  The cache has to be dropped whenever the state it mirrors is undone.
+ */
+class table_lookup_cache {
+   public:
+      struct stats {
+         uint64_t hits   = 0;
+         uint64_t misses = 0;
+      };
+      /// row lookup counts by the contract doing the lookup
+      using stats_by_contract = flat_map<account_name, stats>;
+
+      explicit table_lookup_cache( stats_by_contract& s ) : _stats( s ) {}
+
+      /// @return true, with @ref result set and nullptr for a table that does not exist, if the table is cached
+      bool find_table( name code, name scope, name table, const table_id_object*& result )const {
+         auto itr = _tables.find( std::make_tuple( code, scope, table ) );
+         if( itr == _tables.end() ) return false;
+         result = itr->second;
+         return true;
+      }
+
+      void cache_table( name code, name scope, name table, const table_id_object* tab ) {
+         _tables[std::make_tuple( code, scope, table )] = tab;
+      }
+
+      /// must be called before @ref tab is removed from the database
+      void remove_table( const table_id_object& tab ) {
+         _tables[std::make_tuple( tab.code, tab.scope, tab.table )] = nullptr;
+         remove_rows<key_value_object>( tab.id );
+         remove_rows<index64_object>( tab.id );
+         remove_rows<index128_object>( tab.id );
+         remove_rows<index256_object>( tab.id );
+         remove_rows<index_double_object>( tab.id );
+         remove_rows<index_long_double_object>( tab.id );
+      }
+
+      /// @return true, with @ref result set and nullptr for a row that does not exist, if the row is cached
+      template<typename ObjectType>
+      bool find_row( account_name receiver, table_id_object::id_type t_id, uint64_t primary, const ObjectType*& result ) {
+         auto& s = _stats[receiver];
+         const auto& rows = std::get<row_map<ObjectType>>( _rows );
+         auto titr = rows.find( t_id._id );
+         if( titr != rows.end() ) {
+            auto ritr = titr->second.find( primary );
+            if( ritr != titr->second.end() ) {
+               ++s.hits;
+               result = ritr->second;
+               return true;
+            }
+         }
+         ++s.misses;
+         return false;
+      }
+
+      /// record the row now found, created (@ref obj) or removed (nullptr) at @ref primary
+      template<typename ObjectType>
+      void cache_row( table_id_object::id_type t_id, uint64_t primary, const ObjectType* obj ) {
+         std::get<row_map<ObjectType>>( _rows )[t_id._id][primary] = obj;
+      }
+
+      void clear() {
+         _tables.clear();
+         _rows = decltype(_rows)();
+      }
+
+   private:
+      template<typename ObjectType>
+      using row_map = unordered_map<int64_t, unordered_map<uint64_t, const ObjectType*>>;
+
+      template<typename ObjectType>
+      void remove_rows( table_id_object::id_type t_id ) {
+         std::get<row_map<ObjectType>>( _rows ).erase( t_id._id );
+      }
+
+      std::map<std::tuple<name, name, name>, const table_id_object*> _tables;
+      std::tuple<row_map<key_value_object>,
+                 row_map<index64_object>,
+                 row_map<index128_object>,
+                 row_map<index256_object>,
+                 row_map<index_double_object>,
+                 row_map<index_long_double_object>>      _rows;
+      stats_by_contract&                                  _stats;
+};
+
+} } // eosio::chain
@@ -4,8 +4,13 @@
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/thread_pool.hpp>
 #include <boost/asio/post.hpp>
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <future>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 namespace eosio { namespace chain {
 
@@ -17,7 +22,9 @@ namespace eosio { namespace chain {
    public:
       // name_prefix is name appended with -## of thread.
       // short name_prefix (6 chars or under) is recommended as console_appender uses 9 chars for thread name
-      named_thread_pool( std::string name_prefix, size_t num_threads );
+      // thread ## is pinned to cpus[## % cpus.size()], so threads stay on the cores (and NUMA node) of the given cpus;
+      // empty cpus leaves the threads to the scheduler
+      named_thread_pool( std::string name_prefix, size_t num_threads, std::vector<uint32_t> cpus = {} );
 
       // calls stop()
       ~named_thread_pool();
@@ -37,13 +44,112 @@ namespace eosio { namespace chain {
 
 
    // async on thread_pool and return future
+   // the task is moved into the handler, which asio allocates from the memory it recycles per thread
    template<typename F>
    auto async_thread_pool( boost::asio::io_context& thread_pool, F&& f ) {
-      auto task = std::make_shared<std::packaged_task<decltype( f() )()>>( std::forward<F>( f ) );
-      boost::asio::post( thread_pool, [task]() { (*task)(); } );
-      return task->get_future();
+      std::packaged_task<decltype( f() )()> task( std::forward<F>( f ) );
+      auto fut = task.get_future();
+      boost::asio::post( thread_pool, [task{std::move( task )}]() mutable { task(); } );
+      return fut;
    }
 
+   /**
+    * A task posted to thread_pool to overlap with the work of the calling thread, which runs the task itself when it
+    * needs the result before a pool thread has started it, so it never waits behind the tasks already queued there.
+    * The destructor waits for a started task, which may reference data of the caller.
+    */
+   template<typename R>
+   class overlapped_task {
+   public:
+      template<typename F>
+      overlapped_task( boost::asio::io_context& thread_pool, F&& f )
+      : _state( std::make_shared<state>( std::forward<F>( f ) ) )
+      , _result( _state->task.get_future() ) {
+         boost::asio::post( thread_pool, [s = _state]() { s->run(); } );
+      }
+
+      overlapped_task( overlapped_task&& ) = default;
+
+      ~overlapped_task() {
+         if( _result.valid() ) {
+            _state->run();
+            _result.wait();
+         }
+      }
+
+      /// @return the result of the task, run on this thread if no pool thread has started it
+      R get() {
+         _state->run();
+         return _result.get();
+      }
+
+   private:
+      struct state {
+         template<typename F>
+         explicit state( F&& f ) : task( std::forward<F>( f ) ) {}
+
+         void run() {
+            if( !claimed.exchange( true ) ) task();
+         }
+
+         std::packaged_task<R()> task;
+         std::atomic<bool>       claimed{false};
+      };
+
+      std::shared_ptr<state> _state;
+      std::future<R>         _result;
+   };
+
+   /**
+    * Queues tasks for an io_context in two priorities so that high priority tasks are started ahead of any low priority
+    * ones still waiting, instead of behind them in the io_context's FIFO. Each post also posts a runner which executes
+    * up to max_batch queued tasks, so a burst of small tasks costs fewer io_context handlers.
+    * The io_context must be stopped before this is destroyed.
+    */
+   class prioritized_task_queue {
+   public:
+      enum class priority { high, low };
+
+      static constexpr size_t max_batch = 16;
+
+      explicit prioritized_task_queue( boost::asio::io_context& ioc ) : _ioc( ioc ) {}
+
+      boost::asio::io_context& get_executor() { return _ioc; }
+
+      // post on queue with priority p and return future
+      template<typename F>
+      auto post( priority p, F&& f ) {
+         auto task = std::make_shared<std::packaged_task<decltype( f() )()>>( std::forward<F>( f ) );
+         {
+            std::lock_guard<std::mutex> g( _mtx );
+            ( p == priority::high ? _high : _low ).emplace_back( [task]() { (*task)(); } );
+         }
+         boost::asio::post( _ioc, [this]() { run_batch(); } );
+         return task->get_future();
+      }
+
+   private:
+      void run_batch() {
+         // there is a runner for every task posted, so runners that find the queues drained by others simply return
+         for( size_t i = 0; i < max_batch; ++i ) {
+            std::function<void()> task;
+            {
+               std::lock_guard<std::mutex> g( _mtx );
+               auto& q = _high.empty() ? _low : _high;
+               if( q.empty() ) return;
+               task = std::move( q.front() );
+               q.pop_front();
+            }
+            task();
+         }
+      }
+
+      boost::asio::io_context&          _ioc;
+      std::mutex                        _mtx;
+      std::deque<std::function<void()>> _high;
+      std::deque<std::function<void()>> _low;
+   };
+
 } } // eosio::chain
 
 
@@ -166,6 +166,8 @@ namespace eosio { namespace chain {
 
       uint32_t get_unprunable_size()const;
       uint32_t get_prunable_size()const;
+      /// heap and object memory retained, including the unpacked transaction, as opposed to the serialized sizes above
+      size_t get_estimated_size()const;
 
       digest_type packed_digest()const;
 
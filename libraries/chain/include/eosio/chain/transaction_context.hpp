@@ -2,6 +2,8 @@
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/trace.hpp>
 #include <eosio/chain/platform_timer.hpp>
+#include <eosio/chain/table_access_set.hpp>
+#include <eosio/chain/table_lookup_cache.hpp>
 #include <signal.h>
 
 namespace eosio { namespace chain {
@@ -29,6 +31,8 @@ namespace eosio { namespace chain {
          friend controller_impl;
    };
 
+   class apply_context;
+
    class transaction_context {
       private:
          void init( uint64_t initial_net_usage);
@@ -40,6 +44,7 @@ namespace eosio { namespace chain {
                               const transaction_id_type& trx_id,
                               transaction_checktime_timer&& timer,
                               fc::time_point start = fc::time_point::now() );
+         ~transaction_context();
 
          void init_for_implicit_trx( uint64_t initial_net_usage = 0 );
 
@@ -65,6 +70,11 @@ namespace eosio { namespace chain {
 
          uint32_t update_billed_cpu_time( fc::time_point now );
 
+         /// @return the time on the billing timer at @ref now, which does not advance while it is paused
+         fc::microseconds billable_time( fc::time_point now )const {
+            return pseudo_start == fc::time_point() ? billed_time : now - pseudo_start;
+         }
+
          std::tuple<int64_t, int64_t, bool, bool> max_bandwidth_billed_accounts_can_pay( bool force_elastic_limits = false )const;
 
          void validate_referenced_accounts( const transaction& trx, bool enforce_actor_whitelist_blacklist )const;
@@ -125,6 +135,13 @@ namespace eosio { namespace chain {
          bool                          is_input           = false;
          bool                          apply_context_free = true;
          bool                          enforce_whiteblacklist = true;
+         bool                          is_read_only = false;
+
+         /// populated by apply_context with the contract tables touched when engaged before exec()
+         optional<table_access_set>    access_set;
+
+         /// engaged when the controller has table lookup caching enabled, shared by every action of the transaction
+         optional<table_lookup_cache>  lookup_cache;
 
          fc::time_point                deadline = fc::time_point::maximum();
          fc::microseconds              leeway = fc::microseconds( config::default_subjective_cpu_leeway_us );
@@ -153,6 +170,10 @@ namespace eosio { namespace chain {
          fc::time_point                pseudo_start;
          fc::microseconds              billed_time;
          fc::microseconds              billing_timer_duration_limit;
+
+         /// contexts of the actions applied so far, one per inline action depth, reused by the later actions
+         vector<std::unique_ptr<apply_context>> apply_contexts;
+         uint32_t                      apply_contexts_in_use = 0;
    };
 
 } }
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <eosio/chain/types.hpp>
+
+#include <map>
+
+namespace eosio { namespace chain {
+
+/**
+ *  Bloom filters in front of the transaction_object dedup index, so that checking a new transaction, the common case,
+ *  is a few probes of a bit array instead of a lookup in the index. The filters are bucketed by expiration: a
+ *  transaction id determines its expiration, so a check probes the one bucket it would have been added to, and whole
+ *  buckets are dropped once their transactions can no longer be found in the index.
+ *
+ *  Only answers "not a duplicate" for certain. Transactions are never removed from a bucket, undone ones stay as false
+ *  positives, which fall back to the index.
+ */
+class transaction_dedup_filter {
+   public:
+      static constexpr uint32_t bucket_seconds  = 60;
+      static constexpr uint32_t bits_per_bucket = 1u << 20; ///< 128 KiB, under 0.2% false positives at 60k transactions
+      static constexpr uint32_t hashes          = 4;
+
+      void add( const transaction_id_type& id, fc::time_point_sec expiration );
+
+      /// @return false if @ref id was not added with @ref expiration since its bucket was dropped
+      bool may_contain( const transaction_id_type& id, fc::time_point_sec expiration )const;
+
+      /// drops the buckets of expirations entirely before @ref t
+      void remove_expired( fc::time_point t );
+
+      void clear() { _buckets.clear(); }
+
+      size_t buckets()const { return _buckets.size(); }
+
+   private:
+      std::map<uint32_t, vector<uint64_t>> _buckets; ///< by expiration / bucket_seconds
+};
+
+} } // eosio::chain
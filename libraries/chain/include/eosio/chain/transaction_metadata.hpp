@@ -1,6 +1,7 @@
 #pragma once
 #include <eosio/chain/transaction.hpp>
 #include <eosio/chain/types.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <boost/asio/io_context.hpp>
 #include <future>
 
@@ -40,6 +41,9 @@ class transaction_metadata {
    private:
       struct private_type{};
 
+      static transaction_metadata_ptr recover_keys( packed_transaction_ptr trx, const chain_id_type& chain_id,
+                                                    fc::microseconds time_limit, uint32_t max_variable_sig_size );
+
       static void check_variable_sig_size(const packed_transaction_ptr& trx, uint32_t max) {
          for(const signature_type& sig : trx->get_signed_transaction().signatures)
             EOS_ASSERT(sig.variable_size() <= max, sig_variable_size_limit_exception,
@@ -70,6 +74,11 @@ class transaction_metadata {
       fc::microseconds signature_cpu_usage()const { return _sig_cpu_usage; }
       const flat_set<public_key_type>& recovered_keys()const { return _recovered_pub_keys; }
 
+      /// memory retained by this and its packed transaction, counting a packed transaction shared by others in full
+      size_t get_estimated_size()const {
+         return sizeof(*this) + _packed_trx->get_estimated_size() + _recovered_pub_keys.capacity() * sizeof(public_key_type);
+      }
+
       /// Thread safe.
       /// @returns transaction_metadata_ptr or exception via future
       static recover_keys_future
@@ -77,11 +86,24 @@ class transaction_metadata {
                           const chain_id_type& chain_id, fc::microseconds time_limit,
                           uint32_t max_variable_sig_size = UINT32_MAX );
 
+      /// Thread safe. As above, but recovers through queue with priority p.
+      /// @returns transaction_metadata_ptr or exception via future
+      static recover_keys_future
+      start_recover_keys( packed_transaction_ptr trx, prioritized_task_queue& queue, prioritized_task_queue::priority p,
+                          const chain_id_type& chain_id, fc::microseconds time_limit,
+                          uint32_t max_variable_sig_size = UINT32_MAX );
+
       /// @returns constructed transaction_metadata with no key recovery (sig_cpu_usage=0, recovered_pub_keys=empty)
       static transaction_metadata_ptr
       create_no_recover_keys( const packed_transaction& trx, trx_type t ) {
+         return create_no_recover_keys( std::make_shared<packed_transaction>( trx ), t );
+      }
+
+      /// as above, but shares trx instead of copying it
+      static transaction_metadata_ptr
+      create_no_recover_keys( packed_transaction_ptr trx, trx_type t ) {
          return std::make_shared<transaction_metadata>( private_type(),
-               std::make_shared<packed_transaction>( trx ), fc::microseconds(), flat_set<public_key_type>(),
+               std::move( trx ), fc::microseconds(), flat_set<public_key_type>(),
                      t == trx_type::implicit, t == trx_type::scheduled );
       }
 
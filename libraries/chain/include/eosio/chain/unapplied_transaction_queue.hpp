@@ -125,10 +125,10 @@ public:
       for( const auto& receipt : bs->block->transactions ) {
          if( receipt.trx.contains<packed_transaction>() ) {
             const auto& pt = receipt.trx.get<packed_transaction>();
-            auto itr = queue.get<by_trx_id>().find( pt.id() );
-            if( itr != queue.get<by_trx_id>().end() ) {
+            auto itr = idx.find( pt.id() );
+            if( itr != idx.end() ) {
                if( itr->trx_type != trx_enum_type::persisted ) {
-                  idx.erase( pt.id() );
+                  idx.erase( itr );
                }
             }
          }
@@ -137,6 +137,9 @@ public:
 
    void add_forked( const branch_type& forked_branch ) {
       if( mode == process_mode::non_speculative || mode == process_mode::speculative_non_producer ) return;
+      size_t num_trxs = 0;
+      for( const auto& bsptr : forked_branch ) num_trxs += bsptr->trxs_metas().size();
+      reserve_for( num_trxs );
       // forked_branch is in reverse order
       for( auto ritr = forked_branch.rbegin(), rend = forked_branch.rend(); ritr != rend; ++ritr ) {
          const block_state_ptr& bsptr = *ritr;
@@ -150,6 +153,7 @@ public:
 
    void add_aborted( std::vector<transaction_metadata_ptr> aborted_trxs ) {
       if( mode == process_mode::non_speculative || mode == process_mode::speculative_non_producer ) return;
+      reserve_for( aborted_trxs.size() );
       for( auto& trx : aborted_trxs ) {
          fc::time_point expiry = trx->packed_trx()->expiration();
          queue.insert( { std::move( trx ), expiry, trx_enum_type::aborted } );
@@ -179,6 +183,12 @@ public:
 
    iterator erase( iterator itr ) { return queue.get<by_type>().erase( itr ); }
 
+private:
+   // grow the id index once up front, rather than rehashing repeatedly while a large fork switch or abort is re-queued
+   void reserve_for( size_t num_new_trxs ) {
+      queue.get<by_trx_id>().reserve( queue.size() + num_new_trxs );
+   }
+
 };
 
 } } //eosio::chain
@@ -25,28 +25,25 @@ namespace eosio { namespace chain { namespace wasm_ops {
 
 class instruction_stream {
    public:
-      instruction_stream(size_t size) : idx(0) {
-         data.resize(size);
+      instruction_stream(size_t size) {
+         data.reserve(size);
       }
-      void operator<< (const char c) { 
-         if (idx >= data.size())
-            data.resize(data.size()*2);
-         data[idx++] = static_cast<U8>(c);
+      void operator<< (const char c) {
+         data.push_back(static_cast<U8>(c));
       }
       void set(size_t i, const char* arr) {
-         if (i+idx >= data.size())
-            data.resize(data.size()*2+i);
-         memcpy((char*)&data[idx], arr, i);
-         idx += i;
+         data.insert(data.end(), reinterpret_cast<const U8*>(arr), reinterpret_cast<const U8*>(arr)+i);
       }
-      size_t get_index() { return idx; }
+      size_t get_index() { return data.size(); }
       std::vector<U8> get() {
-         std::vector<U8> ret = data;
-         ret.resize(idx);
-         return ret;
+         return data;
+      }
+      // empty the stream but keep its buffer, so one stream can be reused for every function of a module
+      void reset(size_t size) {
+         data.clear();
+         data.reserve(size);
       }
 //   private:
-      size_t idx;
       std::vector<U8> data;
 };
 
@@ -601,34 +598,32 @@ struct op_types {
  */
 template <class Op_Types>
 class cached_ops {
+   // decoding unpacks each operator into its cached instance, so every thread gets its own set
+   struct thread_cache {
 #define GEN_FIELD( r, P, OP ) \
-   static std::unique_ptr<typename Op_Types::BOOST_PP_CAT(OP,_t)> BOOST_PP_CAT(P, OP);
-   BOOST_PP_SEQ_FOR_EACH( GEN_FIELD, cached_, WASM_OP_SEQ )
+      std::unique_ptr<typename Op_Types::BOOST_PP_CAT(OP,_t)> BOOST_PP_CAT(P, OP) = std::make_unique<typename Op_Types::BOOST_PP_CAT(OP,_t)>();
+      BOOST_PP_SEQ_FOR_EACH( GEN_FIELD, cached_, WASM_OP_SEQ )
 #undef GEN_FIELD
 
-   static std::vector<instr*> _cached_ops;
-   public:
-   static std::vector<instr*>* get_cached_ops() {
+      std::vector<instr*> _cached_ops;
+
+      thread_cache() {
 #define PUSH_BACK_OP( r, T, OP ) \
          _cached_ops[BOOST_PP_CAT(OP,_code)] = BOOST_PP_CAT(T, OP).get();
-      if ( _cached_ops.empty() ) {
          // prefill with error
          _cached_ops.resize( 256, cached_error.get() );
          BOOST_PP_SEQ_FOR_EACH( PUSH_BACK_OP, cached_ , WASM_OP_SEQ )
-      }
 #undef PUSH_BACK_OP
-      return &_cached_ops;
+      }
+   };
+
+   public:
+   static std::vector<instr*>* get_cached_ops() {
+      thread_local thread_cache cache;
+      return &cache._cached_ops;
    }
 };
 
-template <class Op_Types>
-std::vector<instr*> cached_ops<Op_Types>::_cached_ops; 
-
-#define INIT_FIELD( r, P, OP ) \
-   template <class Op_Types>   \
-   std::unique_ptr<typename Op_Types::BOOST_PP_CAT(OP,_t)> cached_ops<Op_Types>::BOOST_PP_CAT(P, OP) = std::make_unique<typename Op_Types::BOOST_PP_CAT(OP,_t)>();
-   BOOST_PP_SEQ_FOR_EACH( INIT_FIELD, cached_, WASM_OP_SEQ )
-
 template <class Op_Types>
 std::vector<instr*>* get_cached_ops_vec() {
  #define GEN_FIELD( r, P, OP ) \
@@ -656,9 +651,8 @@ template <class Op_Types>
 struct EOSIO_OperatorDecoderStream
 {
    EOSIO_OperatorDecoderStream(const std::vector<U8>& codeBytes)
-   : start(codeBytes.data()), nextByte(codeBytes.data()), end(codeBytes.data()+codeBytes.size()) {
-     if(!_cached_ops)
-        _cached_ops = cached_ops<Op_Types>::get_cached_ops();
+   : start(codeBytes.data()), nextByte(codeBytes.data()), end(codeBytes.data()+codeBytes.size()),
+     _cached_ops(cached_ops<Op_Types>::get_cached_ops()) {
    }
 
    operator bool() const { return nextByte < end; }
@@ -694,16 +688,13 @@ struct EOSIO_OperatorDecoderStream
    }
    inline uint32_t index() { return nextByte - start; }
 private:
-   // cached ops to take the address of 
-   static const std::vector<instr*>* _cached_ops;
    const U8* start;
    const U8* nextByte;
    const U8* end;
+   // cached ops, of the decoding thread, to take the address of
+   const std::vector<instr*>* _cached_ops;
 };
 
-template <class Op_Types>
-const std::vector<instr*>* EOSIO_OperatorDecoderStream<Op_Types>::_cached_ops;
-
 }}} // namespace eosio, chain, wasm_ops
 
 FC_REFLECT_TEMPLATE( (typename T), eosio::chain::wasm_ops::block< T >, (code)(rt) )
@@ -799,47 +799,51 @@ namespace eosio { namespace chain { namespace wasm_injections {
             if constexpr (full_injection)
                injector_utils::add_import<ResultType::none>( *_module, u8"checktime", checktime_injection::chktm_idx );
 
+            // the pre pass registers every injected import before the post pass renumbers calls around them, so the
+            // passes cannot be fused; both share one output buffer that only ever grows to fit the largest function
+            wasm_ops::instruction_stream new_code(0);
+
             for ( auto& fd : _module->functions.defs ) {
                wasm_ops::EOSIO_OperatorDecoderStream<std::conditional_t<full_injection, pre_op_full_injectors, pre_op_injectors>> pre_decoder(fd.code);
-               wasm_ops::instruction_stream pre_code(fd.code.size()*2);
+               new_code.reset(fd.code.size()*2);
 
                while ( pre_decoder ) {
                   auto op = pre_decoder.decodeOp();
                   if (op->is_post()) {
-                     op->pack(&pre_code);
-                     op->visit( { _module, &pre_code, &fd, pre_decoder.index() } );
+                     op->pack(&new_code);
+                     op->visit( { _module, &new_code, &fd, pre_decoder.index() } );
                   }
                   else {
-                     op->visit( { _module, &pre_code, &fd, pre_decoder.index() } );
+                     op->visit( { _module, &new_code, &fd, pre_decoder.index() } );
                      if (!(op->is_kill()))
-                        op->pack(&pre_code);
+                        op->pack(&new_code);
                   }
                }
-               fd.code = pre_code.get();
+               fd.code = new_code.get();
             }
             for ( auto& fd : _module->functions.defs ) {
                wasm_ops::EOSIO_OperatorDecoderStream<std::conditional_t<full_injection, post_op_full_injectors, post_op_injectors>> post_decoder(fd.code);
-               wasm_ops::instruction_stream post_code(fd.code.size()*2);
+               new_code.reset(fd.code.size()*2);
 
                if constexpr (full_injection) {
                   wasm_ops::op_types<>::call_t chktm;
                   chktm.field = injector_utils::injected_index_mapping.find(checktime_injection::chktm_idx)->second;
-                  chktm.pack(&post_code);
+                  chktm.pack(&new_code);
                }
 
                while ( post_decoder ) {
                   auto op = post_decoder.decodeOp();
                   if (op->is_post()) {
-                     op->pack(&post_code);
-                     op->visit( { _module, &post_code, &fd, post_decoder.index() } );
+                     op->pack(&new_code);
+                     op->visit( { _module, &new_code, &fd, post_decoder.index() } );
                   }
                   else {
-                     op->visit( { _module, &post_code, &fd, post_decoder.index() } );
+                     op->visit( { _module, &new_code, &fd, post_decoder.index() } );
                      if (!(op->is_kill()))
-                        op->pack(&post_code);
+                        op->pack(&new_code);
                   }
                }
-               fd.code = post_code.get();
+               fd.code = new_code.get();
             }
          }
       private:
@@ -4,6 +4,7 @@
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/wasm_eosio_binary_ops.hpp>
+#include <boost/asio/io_context.hpp>
 #include <functional>
 #include <vector>
 #include <iostream>
@@ -105,17 +106,27 @@ namespace eosio { namespace chain { namespace wasm_validations {
       static constexpr bool post = false;
       static bool disabled;
       static uint16_t depth;
+      // when set, the nesting instructions of the function being validated on this thread are recorded
+      // (true for an end) to be replayed through step() in function order, as depth carries across functions
+      static thread_local std::vector<bool>* recorded;
       static void init(bool disable) { disabled = disable; depth = 0; }
       static void accept( wasm_ops::instr* inst, wasm_ops::visitor_arg& arg ) {
          if (!disabled) {
-            if ( inst->get_code() == wasm_ops::end_code && depth > 0 ) {
-               depth--;
+            if ( recorded ) {
+               recorded->push_back( inst->get_code() == wasm_ops::end_code );
                return;
             }
-            depth++;
-            EOS_ASSERT(depth < 1024, wasm_execution_error, "Nested depth exceeded");
+            step( inst->get_code() == wasm_ops::end_code );
          }
       }
+      static void step( bool is_end ) {
+         if ( is_end && depth > 0 ) {
+            depth--;
+            return;
+         }
+         depth++;
+         EOS_ASSERT(depth < 1024, wasm_execution_error, "Nested depth exceeded");
+      }
    };
 
    // add opcode specific constraints here
@@ -330,24 +341,46 @@ namespace eosio { namespace chain { namespace wasm_validations {
                                                                              maximum_function_stack_visitor,
                                                                              ensure_apply_exported_visitor>;
       public:
-         wasm_binary_validation( const eosio::chain::controller& control, IR::Module& mod ) : _module( &mod ) {
+         /**
+          * @param thread_pool if given, function bodies of a large module are validated on it concurrently with
+          *        the calling thread; the first error in function order is reported, the same as validating serially
+          */
+         wasm_binary_validation( const eosio::chain::controller& control, IR::Module& mod,
+                                 boost::asio::io_context* thread_pool = nullptr ) : _module( &mod ), _thread_pool( thread_pool ) {
             // initialize validators here
             nested_validator::init(!control.is_producing_block());
          }
 
          void validate() {
             _module_validators.validate( *_module );
-            for ( auto& fd : _module->functions.defs ) {
-               wasm_ops::EOSIO_OperatorDecoderStream<op_constrainers> decoder(fd.code);
-               while ( decoder ) {
-                  wasm_ops::instruction_stream new_code(0);
-                  auto op = decoder.decodeOp();
-                  op->visit( { _module, &new_code, &fd, decoder.index() } );
-               }
+            if ( _thread_pool && should_validate_in_parallel() ) {
+               validate_functions_in_parallel();
+               return;
             }
+            for ( auto& fd : _module->functions.defs )
+               validate_function( fd );
          }
+
+         // below this much function body code the cost of dispatching to the thread pool outweighs the gain
+         static constexpr size_t parallel_validation_threshold = 256*1024;
+         // consecutive functions are grouped into chunks of at least this many bytes of code
+         static constexpr size_t parallel_validation_chunk_size = 64*1024;
+
       private:
+         void validate_function( IR::FunctionDef& fd ) {
+            wasm_ops::EOSIO_OperatorDecoderStream<op_constrainers> decoder(fd.code);
+            wasm_ops::instruction_stream new_code(0);
+            while ( decoder ) {
+               auto op = decoder.decodeOp();
+               op->visit( { _module, &new_code, &fd, decoder.index() } );
+            }
+         }
+
+         bool should_validate_in_parallel() const;
+         void validate_functions_in_parallel();
+
          IR::Module* _module;
+         boost::asio::io_context* _thread_pool;
          static standard_module_constraints_validators _module_validators;
    };
 
@@ -82,14 +82,22 @@ namespace eosio { namespace chain {
             eos_vm_oc
          };
 
-         wasm_interface(vm_type vm, bool eosvmoc_tierup, const chainbase::database& d, const boost::filesystem::path data_dir, const eosvmoc::config& eosvmoc_config);
+         struct cache_stats {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t evictions = 0;
+            uint64_t instantiated_bytes = 0;
+         };
+
+         wasm_interface(vm_type vm, bool eosvmoc_tierup, bool persistent_module_cache, uint64_t module_cache_size, uint64_t instantiation_cache_budget,
+                        const chainbase::database& d, const boost::filesystem::path data_dir, const eosvmoc::config& eosvmoc_config);
          ~wasm_interface();
 
          //call before dtor to skip what can be minutes of dtor overhead with some runtimes; can cause leaks
          void indicate_shutting_down();
 
          //validates code -- does a WASM validation pass and checks the wasm against EOSIO specific constraints
-         static void validate(const controller& control, const bytes& code);
+         static void validate(controller& control, const bytes& code);
 
          //indicate that a particular code probably won't be used after given block_num
          void code_block_num_last_used(const digest_type& code_hash, const uint8_t& vm_type, const uint8_t& vm_version, const uint32_t& block_num);
@@ -97,6 +105,12 @@ namespace eosio { namespace chain {
          //indicate the current LIB. evicts old cache entries
          void current_lib(const uint32_t lib);
 
+         //counters for the instantiated module cache
+         cache_stats get_cache_stats()const;
+
+         //with EOS VM OC tier-up enabled, compile every deployed contract and wait for the compiles to finish
+         void eosvmoc_precompile_all(const std::function<bool()>& shutdown);
+
          //Calls apply or error on a given code
          void apply(const digest_type& code_hash, const uint8_t& vm_type, const uint8_t& vm_version, apply_context& context);
 
@@ -115,3 +129,4 @@ namespace eosio{ namespace chain {
 }}
 
 FC_REFLECT_ENUM( eosio::chain::wasm_interface::vm_type, (wabt)(eos_vm)(eos_vm_jit)(eos_vm_oc) )
+FC_REFLECT( eosio::chain::wasm_interface::cache_stats, (hits)(misses)(evictions)(instantiated_bytes) )
@@ -9,10 +9,13 @@
 #define _REGISTER_EOSVMOC_INTRINSIC(CLS, MOD, METHOD, WASM_SIG, NAME, SIG)
 #endif
 #include <eosio/chain/webassembly/runtime_interface.hpp>
+#include <eosio/chain/webassembly/eos-vm-oc/config.hpp>
 #include <eosio/chain/wasm_eosio_injection.hpp>
+#include <eosio/chain/wasm_module_cache.hpp>
 #include <eosio/chain/transaction_context.hpp>
 #include <eosio/chain/code_object.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/version/version.hpp>
 #include <fc/scoped_exit.hpp>
 
 #include "IR/Module.h"
@@ -47,21 +50,53 @@ namespace eosio { namespace chain {
          std::unique_ptr<wasm_instantiated_module_interface>  module;
          uint8_t                                              vm_type = 0;
          uint8_t                                              vm_version = 0;
+         uint64_t                                             execution_count = 0;
+         fc::microseconds                                     execution_time;
+         bool                                                 tierup_eligible = false;
+         bool                                                 resident = false;  //< module is instantiated
+         size_t                                               footprint = 0;     //< bytes of code and initial memory accounted to the module
+         uint64_t                                             last_used = 0;     //< ordinal of the most recent lookup
       };
       struct by_hash;
       struct by_first_block_num;
       struct by_last_block_num;
+      struct by_lru;
+
+      typedef boost::multi_index_container<
+         wasm_cache_entry,
+         indexed_by<
+            ordered_unique<tag<by_hash>,
+               composite_key< wasm_cache_entry,
+                  member<wasm_cache_entry, digest_type, &wasm_cache_entry::code_hash>,
+                  member<wasm_cache_entry, uint8_t,     &wasm_cache_entry::vm_type>,
+                  member<wasm_cache_entry, uint8_t,     &wasm_cache_entry::vm_version>
+               >
+            >,
+            ordered_non_unique<tag<by_first_block_num>, member<wasm_cache_entry, uint32_t, &wasm_cache_entry::first_block_num_used>>,
+            ordered_non_unique<tag<by_last_block_num>, member<wasm_cache_entry, uint32_t, &wasm_cache_entry::last_block_num_used>>,
+            ordered_non_unique<tag<by_lru>,
+               composite_key< wasm_cache_entry,
+                  member<wasm_cache_entry, bool,     &wasm_cache_entry::resident>,
+                  member<wasm_cache_entry, uint64_t, &wasm_cache_entry::last_used>
+               >
+            >
+         >
+      > wasm_cache_index;
 
 #ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
       struct eosvmoc_tier {
-         eosvmoc_tier(const boost::filesystem::path& d, const eosvmoc::config& c, const chainbase::database& db) : cc(d, c, db), exec(cc) {}
+         eosvmoc_tier(const boost::filesystem::path& d, const eosvmoc::config& c, const chainbase::database& db) : cc(d, c, db), exec(cc), mem(c.execution_threads + 1, c.transparent_huge_pages) {}
          eosvmoc::code_cache_async cc;
-         eosvmoc::executor exec;
-         eosvmoc::memory mem;
+         eosvmoc::executor_pool exec;
+         eosvmoc::memory_pool mem;
       };
 #endif
 
-      wasm_interface_impl(wasm_interface::vm_type vm, bool eosvmoc_tierup, const chainbase::database& d, const boost::filesystem::path data_dir, const eosvmoc::config& eosvmoc_config) : db(d), wasm_runtime_time(vm) {
+      wasm_interface_impl(wasm_interface::vm_type vm, bool eosvmoc_tierup, bool persistent_module_cache, uint64_t module_cache_size, uint64_t instantiation_cache_budget,
+                          const chainbase::database& d, const boost::filesystem::path data_dir, const eosvmoc::config& eosvmoc_config)
+      : instantiation_cache_budget(instantiation_cache_budget), db(d), wasm_runtime_time(vm),
+        tierup_execution_threshold(eosvmoc_config.tierup_execution_threshold),
+        tierup_cpu_time_threshold(fc::microseconds(eosvmoc_config.tierup_cpu_time_threshold_us)) {
          if(vm == wasm_interface::vm_type::wabt)
             runtime_interface = std::make_unique<webassembly::wabt_runtime::wabt_runtime>();
 #ifdef EOSIO_EOS_VM_RUNTIME_ENABLED
@@ -85,6 +120,8 @@ namespace eosio { namespace chain {
             eosvmoc.emplace(data_dir, eosvmoc_config, d);
          }
 #endif
+         if(persistent_module_cache)
+            module_cache.emplace(data_dir / "wasm_module_cache", static_cast<uint8_t>(vm), eosio::version::version_full(), module_cache_size);
       }
 
       ~wasm_interface_impl() {
@@ -121,6 +158,30 @@ namespace eosio { namespace chain {
             });
       }
 
+      //true once the contract has run on the baseline runtime often enough or long enough to be worth tiering up
+      bool is_tierup_eligible(const digest_type& code_hash, const uint8_t& vm_type, const uint8_t& vm_version) const {
+         if(eosvmoc_precompiled || (tierup_execution_threshold == 0 && tierup_cpu_time_threshold == fc::microseconds()))
+            return true;
+         wasm_cache_index::iterator it = wasm_instantiation_cache.find(boost::make_tuple(code_hash, vm_type, vm_version));
+         return it != wasm_instantiation_cache.end() && it->tierup_eligible;
+      }
+
+      void record_baseline_execution(const digest_type& code_hash, const uint8_t& vm_type, const uint8_t& vm_version, const fc::microseconds& elapsed) {
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+         if(eosvmoc && vm_type == 0)
+            eosvmoc->cc.record_demand(code_hash, vm_version, elapsed);
+#endif
+         wasm_cache_index::iterator it = wasm_instantiation_cache.find(boost::make_tuple(code_hash, vm_type, vm_version));
+         if(it == wasm_instantiation_cache.end())
+            return;
+         wasm_instantiation_cache.modify(it, [&](wasm_cache_entry& e) {
+            ++e.execution_count;
+            e.execution_time += elapsed;
+            e.tierup_eligible = (tierup_execution_threshold && e.execution_count >= tierup_execution_threshold) ||
+                                (tierup_cpu_time_threshold.count() && e.execution_time >= tierup_cpu_time_threshold);
+         });
+      }
+
       void current_lib(uint32_t lib) {
          //anything last used before or on the LIB can be evicted
          const auto first_it = wasm_instantiation_cache.get<by_last_block_num>().begin();
@@ -129,7 +190,48 @@ namespace eosio { namespace chain {
          if(eosvmoc) for(auto it = first_it; it != last_it; it++)
             eosvmoc->cc.free_code(it->code_hash, it->vm_version);
 #endif
+         for(auto it = first_it; it != last_it; it++)
+            instantiated_bytes -= it->footprint;
          wasm_instantiation_cache.get<by_last_block_num>().erase(first_it, last_it);
+
+         //the first LIB after startup sees the state the node runs on, later ones only need to catch the odd replaced code
+         if(module_cache && lib >= next_module_cache_prune) {
+            module_cache->prune([this](const digest_type& code_hash, uint8_t vm_type, uint8_t vm_version) {
+               return db.find<code_object,by_code_hash>(boost::make_tuple(code_hash, vm_type, vm_version)) != nullptr;
+            });
+            next_module_cache_prune = lib + module_cache_prune_interval;
+         }
+      }
+
+      //drop the least recently used instantiated modules, other than keep, until the cache is within its budget
+      void evict_over_budget(wasm_cache_index::iterator keep) {
+         if(instantiation_cache_budget == 0)
+            return;
+         auto& lru_index = wasm_instantiation_cache.get<by_lru>();
+         auto lru_it = lru_index.lower_bound(boost::make_tuple(true));
+         while(instantiated_bytes > instantiation_cache_budget && lru_it != lru_index.end()) {
+            auto next = std::next(lru_it);
+            if(wasm_instantiation_cache.project<0>(lru_it) != keep) {
+               instantiated_bytes -= lru_it->footprint;
+               lru_index.modify(lru_it, [](wasm_cache_entry& e) {
+                  e.module.reset();
+                  e.resident = false;
+                  e.footprint = 0;
+               });
+               ++stats.evictions;
+            }
+            lru_it = next;
+         }
+      }
+
+      void set_instantiated(wasm_cache_index::iterator it, std::unique_ptr<wasm_instantiated_module_interface> module, size_t footprint) {
+         wasm_instantiation_cache.modify(it, [&](auto& c) {
+            c.module = std::move(module);
+            c.resident = true;
+            c.footprint = footprint;
+         });
+         instantiated_bytes += footprint;
+         evict_over_budget(it);
       }
 
       const std::unique_ptr<wasm_instantiated_module_interface>& get_instantiated_module( const digest_type& code_hash, const uint8_t& vm_type,
@@ -151,7 +253,14 @@ namespace eosio { namespace chain {
                                                    } ).first;
          }
 
-         if(!it->module) {
+         wasm_instantiation_cache.modify(it, [this](wasm_cache_entry& e) {
+            e.last_used = ++use_ordinal;
+         });
+
+         if(it->module) {
+            ++stats.hits;
+         } else {
+            ++stats.misses;
             if(!codeobject)
                codeobject = &db.get<code_object,by_code_hash>(boost::make_tuple(code_hash, vm_type, vm_version));
 
@@ -159,6 +268,16 @@ namespace eosio { namespace chain {
                trx_context.resume_billing_timer();
             });
             trx_context.pause_billing_timer();
+
+            if(module_cache) {
+               if(auto cached = module_cache->get(code_hash, vm_type, vm_version)) {
+                  const size_t footprint = cached->code.size() + cached->initial_memory.size();
+                  set_instantiated(it, runtime_interface->instantiate_module((const char*)cached->code.data(), cached->code.size(), std::move(cached->initial_memory), code_hash, vm_type, vm_version),
+                                   footprint);
+                  return it->module;
+               }
+            }
+
             IR::Module module;
             std::vector<U8> bytes = {
                 (const U8*)codeobject->code.data(),
@@ -187,34 +306,35 @@ namespace eosio { namespace chain {
                }
             }
 
-            wasm_instantiation_cache.modify(it, [&](auto& c) {
-               c.module = runtime_interface->instantiate_module((const char*)bytes.data(), bytes.size(), parse_initial_memory(module), code_hash, vm_type, vm_version);
-            });
+            auto initial_memory = parse_initial_memory(module);
+            if(module_cache)
+               module_cache->put(code_hash, vm_type, vm_version, wasm_module_cache::entry{bytes, initial_memory});
+
+            const size_t footprint = bytes.size() + initial_memory.size();
+            set_instantiated(it, runtime_interface->instantiate_module((const char*)bytes.data(), bytes.size(), std::move(initial_memory), code_hash, vm_type, vm_version),
+                             footprint);
          }
          return it->module;
       }
 
       bool is_shutting_down = false;
       std::unique_ptr<wasm_runtime_interface> runtime_interface;
+      fc::optional<wasm_module_cache> module_cache;
+      static constexpr uint32_t       module_cache_prune_interval = 60*60*2; //< blocks, an hour
+      uint32_t                        next_module_cache_prune = 0;
 
-      typedef boost::multi_index_container<
-         wasm_cache_entry,
-         indexed_by<
-            ordered_unique<tag<by_hash>,
-               composite_key< wasm_cache_entry,
-                  member<wasm_cache_entry, digest_type, &wasm_cache_entry::code_hash>,
-                  member<wasm_cache_entry, uint8_t,     &wasm_cache_entry::vm_type>,
-                  member<wasm_cache_entry, uint8_t,     &wasm_cache_entry::vm_version>
-               >
-            >,
-            ordered_non_unique<tag<by_first_block_num>, member<wasm_cache_entry, uint32_t, &wasm_cache_entry::first_block_num_used>>,
-            ordered_non_unique<tag<by_last_block_num>, member<wasm_cache_entry, uint32_t, &wasm_cache_entry::last_block_num_used>>
-         >
-      > wasm_cache_index;
       wasm_cache_index wasm_instantiation_cache;
 
+      const uint64_t               instantiation_cache_budget; //< bytes, 0 for no limit
+      uint64_t                     instantiated_bytes = 0;
+      uint64_t                     use_ordinal = 0;
+      wasm_interface::cache_stats  stats;
+
       const chainbase::database& db;
       const wasm_interface::vm_type wasm_runtime_time;
+      const uint64_t                tierup_execution_threshold;
+      const fc::microseconds        tierup_cpu_time_threshold;
+      bool                          eosvmoc_precompiled = false;
 
 #ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
       fc::optional<eosvmoc_tier> eosvmoc;
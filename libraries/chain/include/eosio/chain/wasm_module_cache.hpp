@@ -0,0 +1,63 @@
+#pragma once
+
+#include <eosio/chain/types.hpp>
+
+#include <boost/filesystem/path.hpp>
+
+#include <functional>
+
+namespace eosio { namespace chain {
+
+   /**
+    * On disk store of wasm modules after they have been parsed and run through the runtime's injection pass,
+    * keyed by code hash, vm type and vm version.  After a restart a contract can be instantiated straight from
+    * its entry without repeating those passes.
+    *
+    * Each entry is a separate file under the cache directory which records the cache format, the runtime and the
+    * build it was prepared by and a digest of its contents; entries that do not match are discarded and rebuilt.
+    * The entries are kept within a size on disk by removing the least recently used ones, and entries of codes no
+    * longer referenced are removed by prune().
+    */
+   class wasm_module_cache {
+      public:
+         struct entry {
+            std::vector<uint8_t> code;
+            std::vector<uint8_t> initial_memory;
+         };
+
+         /// bump when the entry layout changes; entries prepared by another build are never reused either
+         static constexpr uint32_t current_format = 2;
+
+         using referenced_callback = std::function<bool(const digest_type& code_hash, uint8_t vm_type, uint8_t vm_version)>;
+
+         /**
+          * @param build    identifies the build preparing the entries, and with it its injection passes and codegen
+          * @param max_size bytes the entries may take on disk, least recently used ones are removed beyond it, 0 for no limit
+          */
+         wasm_module_cache( const boost::filesystem::path& dir, uint8_t runtime, const std::string& build, uint64_t max_size );
+
+         fc::optional<entry> get( const digest_type& code_hash, uint8_t vm_type, uint8_t vm_version );
+         void put( const digest_type& code_hash, uint8_t vm_type, uint8_t vm_version, const entry& e );
+
+         /// removes the entries for which @ref referenced is false, and any file not named the way put() names entries
+         void prune( const referenced_callback& referenced );
+
+         /// bytes taken on disk by the entries
+         uint64_t size()const { return total_size; }
+
+      private:
+         boost::filesystem::path entry_path( const digest_type& code_hash, uint8_t vm_type, uint8_t vm_version ) const;
+         void remove_entry( const boost::filesystem::path& p );
+         /// removes least recently used entries, other than keep, until the entries are within max_size
+         void evict_over_size( const boost::filesystem::path& keep );
+
+         boost::filesystem::path dir;
+         uint8_t                 runtime;
+         std::string             build;
+         uint64_t                max_size;
+         uint64_t                total_size = 0;
+   };
+
+} } // eosio::chain
+
+FC_REFLECT( eosio::chain::wasm_module_cache::entry, (code)(initial_memory) )
@@ -39,8 +39,8 @@ class eosvmoc_runtime : public eosio::chain::wasm_runtime_interface {
 
       friend eosvmoc_instantiated_module;
       eosvmoc::code_cache_sync cc;
-      eosvmoc::executor exec;
-      eosvmoc::memory mem;
+      eosvmoc::executor_pool exec;
+      eosvmoc::memory_pool mem;
 };
 
 /**
@@ -36,6 +36,15 @@ using allocator_t = bip::rbtree_best_fit<bip::null_mutex_family, bip::offset_ptr
 
 struct config;
 
+//how much a contract was wanted while it had no compiled code: executions and cpu time on the baseline runtime
+struct code_demand {
+   uint64_t executions = 0;
+   uint64_t baseline_us = 0;
+
+   //an execution counts as a microsecond, so that cheap but frequently called contracts rank too
+   uint64_t score() const { return executions + baseline_us; }
+};
+
 class code_cache_base {
    public:
       code_cache_base(const bfs::path data_dir, const eosvmoc::config& eosvmoc_config, const chainbase::database& db);
@@ -64,6 +73,9 @@ class code_cache_base {
 
       const chainbase::database& _db;
 
+      //held for the lifetime of the cache; as a member it is released only after the destructor has marked the cache clean
+      wrapped_fd _cache_lock_fd;
+
       bfs::path _cache_file_path;
       int _cache_fd;
 
@@ -96,13 +108,33 @@ class code_cache_async : public code_cache_base {
       //otherwise: return nullptr
       const code_descriptor* const get_descriptor_for_code(const digest_type& code_id, const uint8_t& vm_version);
 
+      //Queue every deployed contract that is not already cached, compiling or blacklisted; returns the number queued
+      size_t queue_all_for_compile();
+
+      //Collect finished compiles, start queued ones, and return how many are still compiling or queued
+      size_t pending_compiles();
+
+      //Count an execution of code on the baseline runtime; queued compiles start with the most demanded code first
+      void record_demand(const digest_type& code_id, const uint8_t& vm_version, const fc::microseconds& baseline_time);
+
    private:
+      void process_compile_results();
+      void start_compile(const code_tuple& ct, const code_object& codeobject);
+      void start_queued_compiles(size_t slots);
+      uint64_t demand_score(const code_tuple& ct) const;
+      void load_demand();
+      void save_demand() const;
+
       std::thread _monitor_reply_thread;
       boost::lockfree::spsc_queue<wasm_compilation_result_message> _result_queue;
       void wait_on_compile_monitor_message();
       std::tuple<size_t, size_t> consume_compile_thread_queue();
       std::unordered_set<code_tuple> _blacklist;
       size_t _threads;
+
+      //kept across restarts, so that the busiest contracts are compiled first again after one
+      std::unordered_map<code_tuple, code_demand> _demand;
+      bfs::path _demand_file_path;
 };
 
 class code_cache_sync : public code_cache_base {
@@ -114,4 +146,6 @@ class code_cache_sync : public code_cache_base {
       const code_descriptor* const get_descriptor_for_code_sync(const digest_type& code_id, const uint8_t& vm_version);
 };
 
-}}}
\ No newline at end of file
+}}}
+
+FC_REFLECT(eosio::chain::eosvmoc::code_demand, (executions)(baseline_us))
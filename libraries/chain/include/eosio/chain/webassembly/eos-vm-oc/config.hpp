@@ -13,6 +13,15 @@ namespace eosio { namespace chain { namespace eosvmoc {
 struct config {
    uint64_t cache_size = 1024u*1024u*1024u;
    uint64_t threads    = 1u;
+   // threads that may execute compiled code at the same time, each needs a memory slab reserving some 2 TiB of address space
+   uint64_t execution_threads = 1u;
+   // ask for 2 MiB pages to back linear memory, which the kernel grants when its shmem_enabled policy allows it
+   bool transparent_huge_pages = false;
+
+   // a contract runs on the baseline runtime until it has been executed this many times or has used this much
+   // cpu time, and only then is it queued for tier-up; zero for both tiers up every contract on first use
+   uint64_t tierup_execution_threshold = 0;
+   uint64_t tierup_cpu_time_threshold_us = 0;
 };
 
 }}}
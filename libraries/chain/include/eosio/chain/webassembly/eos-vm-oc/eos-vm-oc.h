@@ -35,4 +35,6 @@ struct eos_vm_oc_control_block {
    uintptr_t running_code_base;
    int64_t  first_invalid_memory_address;
    unsigned is_running;
+   int64_t max_linear_memory_pages; //highest page count reached since the memory was last zeroed
+   void* profile_samples; //the executor's eosvmoc::profile_samples while the sampling profiler runs, otherwise null
 };
\ No newline at end of file
@@ -26,6 +26,12 @@ struct intrinsic_ordinal{ size_t ordinal; };
 
 using eosvmoc_optional_offset_or_import_t = fc::static_variant<no_offset, code_offset, intrinsic_ordinal>;
 
+//an entry of the table following a compiled module's code, sorted by code_offset
+struct function_offset {
+   uint32_t code_offset;  //relative to code_begin
+   uint32_t def_index;    //of the function among the module's function definitions, which follow its imports
+};
+
 struct code_descriptor {
    digest_type code_hash;
    uint8_t vm_version;
@@ -37,6 +43,8 @@ struct code_descriptor {
    size_t initdata_begin;
    unsigned initdata_size;
    unsigned initdata_prologue_size;
+   size_t function_offsets_begin;
+   unsigned function_offsets_count;
 };
 
 enum eosvmoc_exitcode : int {
@@ -51,6 +59,6 @@ enum eosvmoc_exitcode : int {
 FC_REFLECT(eosio::chain::eosvmoc::no_offset, );
 FC_REFLECT(eosio::chain::eosvmoc::code_offset, (offset));
 FC_REFLECT(eosio::chain::eosvmoc::intrinsic_ordinal, (ordinal));
-FC_REFLECT(eosio::chain::eosvmoc::code_descriptor, (code_hash)(vm_version)(codegen_version)(code_begin)(start)(apply_offset)(starting_memory_pages)(initdata_begin)(initdata_size)(initdata_prologue_size));
+FC_REFLECT(eosio::chain::eosvmoc::code_descriptor, (code_hash)(vm_version)(codegen_version)(code_begin)(start)(apply_offset)(starting_memory_pages)(initdata_begin)(initdata_size)(initdata_prologue_size)(function_offsets_begin)(function_offsets_count));
 
 #define EOSVMOC_INTRINSIC_INIT_PRIORITY __attribute__((init_priority(198)))
\ No newline at end of file
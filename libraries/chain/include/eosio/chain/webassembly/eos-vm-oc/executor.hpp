@@ -6,6 +6,10 @@
 #include <setjmp.h>
 
 #include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <cstddef>
 
@@ -16,17 +20,23 @@ class apply_context;
 namespace eosvmoc {
 
 class code_cache_base;
-class memory;
+class memory_pool;
 struct code_descriptor;
+struct profile_samples;
+
+//the magic of the control block of an executing slab, which is how signal handlers recognize one
+static constexpr auto signal_sentinel = 0x4D56534F45534559ul;
 
 class executor {
    public:
       executor(const code_cache_base& cc);
       ~executor();
 
-      void execute(const code_descriptor& code, const memory& mem, apply_context& context);
+      void execute(const code_descriptor& code, memory_pool& pool, apply_context& context);
 
    private:
+      profile_samples* sampling_buffer();
+
       uint8_t* code_mapping;
       size_t code_mapping_size;
       bool mapping_is_executable;
@@ -34,6 +44,32 @@ class executor {
       std::exception_ptr executors_exception_ptr;
       sigjmp_buf executors_sigjmp_buf;
       std::list<std::vector<std::byte>> executors_bounce_buffers;
+      std::unique_ptr<profile_samples> executors_profile_samples; //allocated once the sampling profiler runs
+};
+
+/**
+ * Executors for several threads running code from one code cache at the same time. Each thread gets its own executor,
+ * with its own mapping of the code cache so that a transaction deadline on one thread only stops the code of that
+ * thread, and takes a memory slab from the shared memory_pool for each execution. The pool should hold a slab for every
+ * thread that executes at once, any further execution waits for a slab to be released. Looking up the code descriptor
+ * in the code cache is still up to the caller.
+ */
+class executor_pool {
+   public:
+      explicit executor_pool(const code_cache_base& cc);
+      ~executor_pool();
+
+      //runs on the executor of the calling thread, which is created by the first execution on that thread
+      void execute(const code_descriptor& code, memory_pool& pool, apply_context& context);
+
+      size_t size() const;
+
+   private:
+      executor& executor_for_this_thread();
+
+      const code_cache_base&                             _cc;
+      mutable std::mutex                                 _mtx;
+      std::map<std::thread::id, std::unique_ptr<executor>> _executors;
 };
 
 }}}
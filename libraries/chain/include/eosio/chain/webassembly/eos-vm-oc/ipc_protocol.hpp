@@ -34,6 +34,8 @@ struct code_compilation_result_message {
    unsigned apply_offset;
    int starting_memory_pages;
    unsigned initdata_prologue_size;
+   unsigned function_offsets_begin; //the function_offset table is appended to the wasm code, this far from its start
+   unsigned function_offsets_count;
    //Two sent fds: 1) wasm code, 2) initial memory snapshot
 };
 
@@ -65,7 +67,7 @@ FC_REFLECT(eosio::chain::eosvmoc::initalize_response_message, (error_message))
 FC_REFLECT(eosio::chain::eosvmoc::code_tuple, (code_id)(vm_version))
 FC_REFLECT(eosio::chain::eosvmoc::compile_wasm_message, (code))
 FC_REFLECT(eosio::chain::eosvmoc::evict_wasms_message, (codes))
-FC_REFLECT(eosio::chain::eosvmoc::code_compilation_result_message, (start)(apply_offset)(starting_memory_pages)(initdata_prologue_size))
+FC_REFLECT(eosio::chain::eosvmoc::code_compilation_result_message, (start)(apply_offset)(starting_memory_pages)(initdata_prologue_size)(function_offsets_begin)(function_offsets_count))
 FC_REFLECT(eosio::chain::eosvmoc::compilation_result_unknownfailure, )
 FC_REFLECT(eosio::chain::eosvmoc::compilation_result_toofull, )
 FC_REFLECT(eosio::chain::eosvmoc::wasm_compilation_result_message, (code)(result)(cache_free_bytes))
\ No newline at end of file
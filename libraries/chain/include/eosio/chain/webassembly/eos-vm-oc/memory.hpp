@@ -8,6 +8,13 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 namespace eosio { namespace chain { namespace eosvmoc {
 
 class memory {
@@ -26,8 +33,11 @@ class memory {
 
       static constexpr uint64_t number_slices = wasm_memory_size/(64u*1024u)+1u;
 
+      static constexpr uint64_t huge_page_size = 2u*1024u*1024u;
+
    public:
-      memory();
+      //with transparent_huge_pages, asks the kernel to back the memory with 2 MiB pages, see eosvmoc::config
+      explicit memory(bool transparent_huge_pages = false);
       ~memory();
 
       uint8_t* const zero_page_memory_base() const { return zeropage_base; }
@@ -52,6 +62,8 @@ class memory {
       static_assert(stride == EOS_VM_OC_MEMORY_STRIDE, "EOS VM OC memory stride has slid out of place somehow");
 
    private:
+      uint8_t* reservation;
+      uint64_t reservation_size;
       uint8_t* mapbase;
       uint64_t mapsize;
 
@@ -59,6 +71,36 @@ class memory {
       uint8_t* fullpage_base;
 };
 
+/**
+ * A set of memory slabs whose linear memory is kept zeroed so execution can begin without clearing it. A slab
+ * handed back after execution is zeroed on a helper thread, only up to the pages that execution grew to, while
+ * another slab is in use. Since the memfd pages stay resident a recycled slab is also already faulted in.
+ */
+class memory_pool {
+   public:
+      explicit memory_pool(size_t slab_count = default_slab_count, bool transparent_huge_pages = false);
+      ~memory_pool();
+
+      //returns a slab whose entire linear memory is zero; it must be given back via release()
+      memory& acquire();
+      //hands a slab back once execution on it has finished
+      void release(memory& mem);
+
+      static constexpr size_t default_slab_count = 2u;
+
+   private:
+      void scrubber_loop();
+      static void scrub(memory& mem);
+
+      std::vector<std::unique_ptr<memory>> _slabs;
+      std::deque<memory*>                  _clean;
+      std::deque<memory*>                  _dirty;
+      std::mutex                           _mtx;
+      std::condition_variable              _cv;
+      bool                                 _done = false;
+      std::thread                          _scrubber_thread;
+};
+
 }}}
 
 #define OFFSET_OF_CONTROL_BLOCK_MEMBER(M) (-(int)eosio::chain::eosvmoc::memory::cb_offset + (int)offsetof(eosio::chain::eosvmoc::control_block, M))
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <eosio/chain/types.hpp>
+
+#include <chainbase/chainbase.hpp>
+
+#include <iosfwd>
+
+#include <pthread.h>
+
+namespace eosio { namespace chain {
+
+class apply_context;
+
+namespace eosvmoc {
+
+struct code_descriptor;
+
+//instruction pointers the SIGPROF handler sampled during one execution, kept by the executor of the sampled thread
+struct profile_samples {
+   static constexpr unsigned capacity = 4096;
+
+   pthread_t owner;
+   volatile unsigned count = 0;
+   volatile unsigned dropped = 0;
+   uintptr_t ips[capacity];
+};
+
+/**
+ * Opt-in sampling profiler of the code EOS VM OC executes. A process wide ITIMER_PROF timer raises SIGPROF every
+ * 1/hz seconds of CPU time, and a thread that is running wasm at the time records the interrupted instruction
+ * pointer. When the execution ends its samples are mapped to wasm functions with the offsets table the compiler
+ * appends to the code of each module, and counted by receiver, action and function. Samples taken in intrinsics, or
+ * anywhere else outside of the wasm code, are counted as [host].
+ *
+ * The counts are written as folded stacks, "receiver;account::action;function count", which flame graph tools take
+ * as is. Function names come from the name section of the contract when it has one.
+ */
+class sampling_profiler {
+   public:
+      /// installs the SIGPROF handler and starts the timer, @ref hz samples per second of CPU time on any thread
+      static void start( uint32_t hz );
+      static void stop();
+      static bool running();
+
+      /// called by the executor, on the executing thread, once execution of @ref code ended
+      static void record( const code_descriptor& code, const uint8_t* code_mapping, size_t code_mapping_size,
+                          const profile_samples& samples, const apply_context& context );
+
+      /// names the functions with the wasm in @ref db, samples of code no longer in @ref db are written unnamed
+      static void write_folded( std::ostream& out, const chainbase::database& db );
+
+      static void clear();
+};
+
+}}}
@@ -657,8 +657,10 @@ struct intrinsic_function_invoker {
 
    template<MethodSig Method>
    static Ret wrapper(wabt_apply_instance_vars& vars, Params... params, const TypedValues&, int) {
-      class_from_wasm<Cls>::value(vars.ctx).checktime();
-      return (class_from_wasm<Cls>::value(vars.ctx).*Method)(params...);
+      // constructed once, the constructor of an api class checks that it may be called in the current context
+      auto&& api = class_from_wasm<Cls>::value(vars.ctx);
+      api.checktime();
+      return (api.*Method)(params...);
    }
 
    template<MethodSig Method>
@@ -673,8 +675,9 @@ struct intrinsic_function_invoker<void, MethodSig, Cls, Params...> {
 
    template<MethodSig Method>
    static void_type wrapper(wabt_apply_instance_vars& vars, Params... params, const TypedValues& args, int offset) {
-      class_from_wasm<Cls>::value(vars.ctx).checktime();
-      (class_from_wasm<Cls>::value(vars.ctx).*Method)(params...);
+      auto&& api = class_from_wasm<Cls>::value(vars.ctx);
+      api.checktime();
+      (api.*Method)(params...);
       return void_type();
    }
 
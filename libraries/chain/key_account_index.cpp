@@ -0,0 +1,87 @@
+#include <eosio/chain/key_account_index.hpp>
+
+#include <algorithm>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+
+namespace eosio { namespace chain {
+
+struct key_account_index::impl {
+   using entry = std::pair<public_key_type, permission_level>;
+
+   mutable std::shared_mutex mtx;
+   bool                      enabled = false;
+   std::set<entry>           entries; ///< superset of the key, permission pairs in chainbase
+
+   void insert( const permission_object& perm ) {
+      const permission_level level{ perm.owner, perm.name };
+      for( const auto& k : perm.auth.keys )
+         entries.emplace( public_key_type( k.key ), level );
+   }
+};
+
+key_account_index::key_account_index() : my( new impl() ) {}
+
+key_account_index::~key_account_index() = default;
+
+void key_account_index::add( const permission_object& perm ) {
+   std::unique_lock<std::shared_mutex> g( my->mtx );
+   if( !my->enabled ) return;
+   my->insert( perm );
+}
+
+void key_account_index::rebuild( const chainbase::database& db ) {
+   std::unique_lock<std::shared_mutex> g( my->mtx );
+   my->entries.clear();
+   for( const auto& perm : db.get_index<permission_index>().indices() )
+      my->insert( perm );
+   my->enabled = true;
+}
+
+void key_account_index::clear() {
+   std::unique_lock<std::shared_mutex> g( my->mtx );
+   my->entries.clear();
+   my->enabled = false;
+}
+
+bool key_account_index::enabled()const {
+   std::shared_lock<std::shared_mutex> g( my->mtx );
+   return my->enabled;
+}
+
+size_t key_account_index::size()const {
+   std::shared_lock<std::shared_mutex> g( my->mtx );
+   return my->entries.size();
+}
+
+auto key_account_index::find( const chainbase::database& db, const vector<public_key_type>& keys,
+                              time_point irreversible_time )const -> vector<match> {
+   vector<match> result;
+   vector<impl::entry> stale;
+   {
+      std::shared_lock<std::shared_mutex> g( my->mtx );
+      for( const auto& key : keys ) {
+         for( auto itr = my->entries.lower_bound( impl::entry{ key, permission_level{} } );
+              itr != my->entries.end() && itr->first == key; ++itr ) {
+            const auto* perm = db.find<permission_object, by_owner_hash>( boost::make_tuple( itr->second.actor, itr->second.permission ) );
+            if( !perm ) continue;
+            auto kw = std::find_if( perm->auth.keys.begin(), perm->auth.keys.end(),
+                                    [&]( const shared_key_weight& k ) { return k.key == key; } );
+            if( kw != perm->auth.keys.end() ) {
+               result.push_back( match{ key, itr->second, kw->weight, perm->auth.threshold } );
+            } else if( perm->last_updated <= irreversible_time ) {
+               stale.push_back( *itr );
+            }
+         }
+      }
+   }
+   if( !stale.empty() ) {
+      std::unique_lock<std::shared_mutex> g( my->mtx );
+      for( const auto& e : stale )
+         my->entries.erase( e );
+   }
+   return result;
+}
+
+} } // eosio::chain
@@ -0,0 +1,92 @@
+#include <eosio/chain/log_sync.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/log/logger_config.hpp>
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace eosio { namespace chain {
+
+log_sync::log_sync( std::string thread_name, const log_durability& durability, std::vector<fc::path> files )
+: _durability( durability )
+, _files( std::move( files ) )
+, _last_flush( fc::time_point::now() )
+{
+   if( _durability.fsync ) {
+      _thread = std::thread( [this, thread_name]() {
+         fc::set_os_thread_name( thread_name );
+         run();
+      } );
+   }
+}
+
+log_sync::~log_sync() {
+   if( _thread.joinable() ) {
+      {
+         std::lock_guard<std::mutex> g( _mtx );
+         _stopping = true;
+      }
+      _cond.notify_one();
+      _thread.join();
+   }
+}
+
+void log_sync::appended( const std::function<void()>& flush ) {
+   ++_unflushed;
+   const auto now = fc::time_point::now();
+   const bool by_count = _durability.flush_blocks && _unflushed >= _durability.flush_blocks;
+   const bool by_time = _durability.flush_interval > fc::microseconds( 0 ) && now - _last_flush >= _durability.flush_interval;
+   const bool always = !_durability.flush_blocks && _durability.flush_interval <= fc::microseconds( 0 );
+   if( !by_count && !by_time && !always )
+      return;
+
+   flush();
+   _unflushed = 0;
+   _last_flush = now;
+   if( _durability.fsync ) {
+      {
+         std::lock_guard<std::mutex> g( _mtx );
+         _sync_requested = true;
+      }
+      _cond.notify_one();
+   }
+}
+
+void log_sync::flush_now( const std::function<void()>& flush ) {
+   flush();
+   _unflushed = 0;
+   _last_flush = fc::time_point::now();
+   if( _durability.fsync )
+      sync_files();
+}
+
+void log_sync::run() {
+   std::unique_lock<std::mutex> g( _mtx );
+   while( true ) {
+      _cond.wait( g, [this]() { return _sync_requested || _stopping; } );
+      if( !_sync_requested )
+         break;
+      // every flush requested while this sync runs is covered by the next one
+      _sync_requested = false;
+      g.unlock();
+      sync_files();
+      g.lock();
+   }
+}
+
+void log_sync::sync_files() {
+   for( const auto& f : _files ) {
+      int fd = ::open( f.generic_string().c_str(), O_RDONLY );
+      if( fd < 0 ) {
+         elog( "unable to open ${f} to sync it: ${e}", ("f", f.generic_string())("e", strerror( errno )) );
+         continue;
+      }
+      if( ::fsync( fd ) != 0 )
+         elog( "unable to sync ${f}: ${e}", ("f", f.generic_string())("e", strerror( errno )) );
+      ::close( fd );
+   }
+}
+
+} } // eosio::chain
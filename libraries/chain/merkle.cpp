@@ -1,6 +1,12 @@
 #include <eosio/chain/merkle.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <fc/io/raw.hpp>
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 namespace eosio { namespace chain {
 
 /**
@@ -32,13 +38,65 @@ bool is_canonical_right(const digest_type& val) {
 }
 
 
-digest_type merkle(vector<digest_type> ids) {
+namespace {
+
+// below this many pairs in a level handing out the hashing costs more than it saves
+constexpr size_t parallel_merkle_min_pairs = 2048;
+constexpr size_t parallel_merkle_chunk_pairs = 512;
+
+/// hashes the pairs of even sized ids into next, which must hold half as many digests
+void hash_level_in_parallel( const vector<digest_type>& ids, vector<digest_type>& next, boost::asio::io_context& thread_pool ) {
+   struct shared_state {
+      size_t              num_chunks = 0;
+      std::atomic<size_t> next_chunk{0};
+      std::mutex          mtx;
+      std::condition_variable cv;
+      size_t              chunks_done = 0;
+   };
+
+   // shared so that a task the pool only gets to after every chunk is done can still find out there is nothing left
+   auto state = std::make_shared<shared_state>();
+   state->num_chunks = ( next.size() + parallel_merkle_chunk_pairs - 1 ) / parallel_merkle_chunk_pairs;
+
+   auto run = [state, &ids, &next]() {
+      for( size_t c = state->next_chunk++; c < state->num_chunks; c = state->next_chunk++ ) {
+         const size_t end = std::min( next.size(), ( c + 1 ) * parallel_merkle_chunk_pairs );
+         for( size_t i = c * parallel_merkle_chunk_pairs; i < end; ++i ) {
+            next[i] = digest_type::hash( make_canonical_pair( ids[2 * i], ids[(2 * i) + 1] ) );
+         }
+         std::lock_guard<std::mutex> g( state->mtx );
+         if( ++state->chunks_done == state->num_chunks )
+            state->cv.notify_all();
+      }
+   };
+
+   const size_t helpers = std::min<size_t>( state->num_chunks - 1, std::max( 1u, std::thread::hardware_concurrency() ) );
+   for( size_t i = 0; i < helpers; ++i )
+      boost::asio::post( thread_pool, run );
+   run();
+
+   std::unique_lock<std::mutex> g( state->mtx );
+   state->cv.wait( g, [&state]() { return state->chunks_done == state->num_chunks; } );
+}
+
+} /// anonymous namespace
+
+digest_type merkle(vector<digest_type> ids, boost::asio::io_context* thread_pool) {
    if( 0 == ids.size() ) { return digest_type(); }
 
+   vector<digest_type> next;
    while( ids.size() > 1 ) {
       if( ids.size() % 2 )
          ids.push_back(ids.back());
 
+      if( thread_pool && ids.size() / 2 >= parallel_merkle_min_pairs ) {
+         // out of place, as chunks hashed concurrently would overwrite each other's inputs
+         next.resize(ids.size() / 2);
+         hash_level_in_parallel(ids, next, *thread_pool);
+         std::swap(ids, next);
+         continue;
+      }
+
       for (size_t i = 0; i < ids.size() / 2; i++) {
          ids[i] = digest_type::hash(make_canonical_pair(ids[2 * i], ids[(2 * i) + 1]));
       }
@@ -8,17 +8,80 @@
 #include <mutex>
 
 #include <signal.h>
+#include <sys/syscall.h>
 #include <time.h>
+#include <unistd.h>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
 
 namespace eosio { namespace chain {
 
 static_assert(std::atomic_bool::is_always_lock_free, "Only lock-free atomics AS-safe.");
-
+static_assert(std::atomic<int64_t>::is_always_lock_free, "Only lock-free atomics AS-safe.");
+
+/*
+ * The timer is not disarmed by stop(), and start() only arms it when it is not already armed to expire before the new
+ * deadline; a timer left armed for an earlier deadline fires early and the handler re-arms it for the current one.
+ * Back to back transactions, each ending well before its deadline, thus mostly start and stop without a syscall.
+ *
+ * The timer signals the thread that last started it rather than the process, so the handler never runs concurrently
+ * with start() and stop(). Deadlines are absolute CLOCK_MONOTONIC times in microseconds, 0 meaning none.
+ */
 struct platform_timer::impl {
    timer_t timerid;
+   pid_t   tid = 0;
+
+   std::atomic<int64_t> deadline = 0;
+   std::atomic<int64_t> armed = 0;    ///< expiration the timer is armed for, 0 when it is not
+
+   static int64_t now() {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return ts.tv_sec*1000000ll + ts.tv_nsec/1000;
+   }
+
+   static pid_t this_thread() {
+      static thread_local const pid_t tid = syscall(SYS_gettid);
+      return tid;
+   }
+
+   void create(platform_timer* self) {
+      struct sigevent se;
+      se.sigev_notify = SIGEV_THREAD_ID;
+      se.sigev_signo = SIGRTMIN;
+      se.sigev_value.sival_ptr = (void*)self;
+      se.sigev_notify_thread_id = this_thread();
+
+      FC_ASSERT(timer_create(CLOCK_MONOTONIC, &se, &timerid) == 0, "failed to create timer");
+      tid = se.sigev_notify_thread_id;
+      armed = 0;
+   }
+
+   //async-signal-safe, the handler re-arms with it
+   bool arm(int64_t at) {
+      struct itimerspec enable = {{0, 0}, {at/1000000, (at%1000000)*1000}};
+      armed = at;
+      if(timer_settime(timerid, TIMER_ABSTIME, &enable, NULL) == 0)
+         return true;
+      armed = 0;
+      return false;
+   }
 
    static void sig_handler(int, siginfo_t* si, void*) {
       platform_timer* self = (platform_timer*)si->si_value.sival_ptr;
+      impl& my = *self->my;
+
+      my.armed = 0;
+      const int64_t d = my.deadline;
+      if(d == 0)
+         return;
+      if(now() < d) {
+         if(my.arm(d))
+            return;
+      }
+      my.deadline = 0;
       self->expired = 1;
       self->call_expiration_callback();
    }
@@ -34,46 +97,62 @@ platform_timer::platform_timer() {
       struct sigaction act;
       sigemptyset(&act.sa_mask);
       act.sa_sigaction = impl::sig_handler;
-      act.sa_flags = SA_SIGINFO;
+      //a timer left armed by stop() may fire while the thread is blocked elsewhere
+      act.sa_flags = SA_SIGINFO | SA_RESTART;
       FC_ASSERT(sigaction(SIGRTMIN, &act, NULL) == 0, "failed to aquire SIGRTMIN signal");
       initialized = true;
    }
 
-   struct sigevent se;
-   se.sigev_notify = SIGEV_SIGNAL;
-   se.sigev_signo = SIGRTMIN;
-   se.sigev_value.sival_ptr = (void*)this;
-
-   FC_ASSERT(timer_create(CLOCK_REALTIME, &se, &my->timerid) == 0, "failed to create timer");
+   my->create(this);
 
    compute_and_print_timer_accuracy(*this);
 }
 
 platform_timer::~platform_timer() {
+   //disarmed first so that a signal already on its way is handled before the timer goes
+   my->deadline = 0;
+   if(my->armed) {
+      struct itimerspec disable = {{0, 0}, {0, 0}};
+      timer_settime(my->timerid, 0, &disable, NULL);
+   }
    timer_delete(my->timerid);
 }
 
 void platform_timer::start(fc::time_point tp) {
    if(tp == fc::time_point::maximum()) {
+      my->deadline = 0;
       expired = 0;
       return;
    }
    fc::microseconds x = tp.time_since_epoch() - fc::time_point::now().time_since_epoch();
-   if(x.count() <= 0)
+   if(x.count() <= 0) {
+      my->deadline = 0;
       expired = 1;
-   else {
-      struct itimerspec enable = {{0, 0}, {0, (int)x.count()*1000}};
-      expired = 0;
-      if(timer_settime(my->timerid, 0, &enable, NULL) != 0)
+      return;
+   }
+
+   //a timer signaling another thread could fire while this one moves the deadline
+   if(my->tid != impl::this_thread()) {
+      timer_delete(my->timerid);
+      my->create(this);
+   }
+
+   const int64_t d = impl::now() + x.count();
+   my->deadline = d;
+   expired = 0;
+   const int64_t armed = my->armed;
+   if(armed == 0 || armed > d) {
+      if(!my->arm(d)) {
+         my->deadline = 0;
          expired = 1;
+      }
    }
 }
 
 void platform_timer::stop() {
    if(expired)
       return;
-   struct itimerspec disable = {{0, 0}, {0, 0}};
-   timer_settime(my->timerid, 0, &disable, NULL);
+   my->deadline = 0;
    expired = 1;
 }
 
@@ -183,6 +183,20 @@ and may have additional signatures in a block extension with ID `2`.
 Privileged Contracts:
 may continue to use `set_proposed_producers` as they have;
 may use a new `set_proposed_producers_ex` intrinsic to access extended features.
+*/
+            {}
+         } )
+         (  builtin_protocol_feature_t::db_read_range, builtin_protocol_feature_spec{
+            "DB_READ_RANGE",
+            fc::variant("69be6cd53b56e79312aa394b40125f1a348a533d6f30873b0f48a35d470f58eb").as<digest_type>(),
+            // SHA256 hash of the raw message below within the comment delimiters (do not modify message below).
+/*
+Builtin protocol feature: DB_READ_RANGE
+
+Allows contracts to copy consecutive rows of a primary table, starting at a lower bound, into a buffer with a single call to the new `db_read_range_i64` intrinsic.
+
+Each row is written as its 64-bit primary key, the 32-bit size of its value and the value itself.
+The intrinsic returns the number of rows copied, or, if not even the first row fits within the buffer, the negated number of bytes that row needs.
 */
             {}
          } )
@@ -0,0 +1,98 @@
+#include <eosio/chain/recovered_key_cache.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/member.hpp>
+
+#include <mutex>
+
+namespace eosio { namespace chain {
+
+namespace {
+   using namespace boost::multi_index;
+
+   struct cached_key {
+      digest_type     digest;
+      signature_type  sig;
+      public_key_type key;
+      bool            canonical_checked;
+   };
+
+   struct by_sig;
+
+   typedef multi_index_container<
+      cached_key,
+      indexed_by<
+         sequenced<>,
+         ordered_unique<tag<by_sig>,
+            composite_key< cached_key,
+               member<cached_key, digest_type,    &cached_key::digest>,
+               member<cached_key, signature_type, &cached_key::sig>
+            >
+         >
+      >
+   > recovery_cache_type;
+
+   struct recovery_cache {
+      std::mutex          mtx;
+      recovery_cache_type entries;
+      size_t              capacity = recovered_key_cache::default_capacity;
+
+      // callers hold mtx
+      void trim() {
+         while( entries.size() > capacity )
+            entries.pop_back();
+      }
+   };
+
+   recovery_cache& cache() {
+      static recovery_cache c;
+      return c;
+   }
+}
+
+public_key_type recovered_key_cache::recover( const signature_type& sig, const digest_type& digest, bool check_canonical ) {
+   auto& c = cache();
+   {
+      std::lock_guard<std::mutex> g( c.mtx );
+      auto& idx = c.entries.get<by_sig>();
+      auto itr = idx.find( boost::make_tuple( digest, sig ) );
+      if( itr != idx.end() && (itr->canonical_checked || !check_canonical) ) {
+         // move to the front of the recently used list
+         c.entries.relocate( c.entries.begin(), c.entries.project<0>( itr ) );
+         return itr->key;
+      }
+   }
+
+   // recover outside of the lock, throws on an invalid (or required but non-canonical) signature so nothing is cached
+   public_key_type key( sig, digest, check_canonical );
+
+   std::lock_guard<std::mutex> g( c.mtx );
+   auto& idx = c.entries.get<by_sig>();
+   auto itr = idx.find( boost::make_tuple( digest, sig ) );
+   if( itr != idx.end() ) {
+      idx.modify( itr, [&]( cached_key& k ) { k.canonical_checked |= check_canonical; } );
+      c.entries.relocate( c.entries.begin(), c.entries.project<0>( itr ) );
+   } else {
+      c.entries.push_front( cached_key{ digest, sig, key, check_canonical } );
+      c.trim();
+   }
+   return key;
+}
+
+void recovered_key_cache::set_capacity( size_t capacity ) {
+   auto& c = cache();
+   std::lock_guard<std::mutex> g( c.mtx );
+   c.capacity = capacity;
+   c.trim();
+}
+
+void recovered_key_cache::clear() {
+   auto& c = cache();
+   std::lock_guard<std::mutex> g( c.mtx );
+   c.entries.clear();
+}
+
+} } // eosio::chain
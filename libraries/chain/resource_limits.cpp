@@ -114,6 +114,10 @@ void resource_limits_manager::update_account_usage(const flat_set<account_name>&
    const auto& config = _db.get<resource_limits_config_object>();
    for( const auto& a : accounts ) {
       const auto& usage = _db.get<resource_usage_object,by_owner>( a );
+      // adding nothing within the ordinal already accumulated into is a no-op, which is the case for every
+      // transaction after an account's first one in a block; skip the modify and its undo bookkeeping
+      if( usage.net_usage.last_ordinal == time_slot && usage.cpu_usage.last_ordinal == time_slot )
+         continue;
       _db.modify( usage, [&]( auto& bu ){
           bu.net_usage.add( 0, time_slot, config.account_net_usage_average_window );
           bu.cpu_usage.add( 0, time_slot, config.account_cpu_usage_average_window );
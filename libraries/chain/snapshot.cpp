@@ -2,6 +2,17 @@
 #include <eosio/chain/exceptions.hpp>
 #include <fc/scoped_exit.hpp>
 
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
 namespace eosio { namespace chain {
 
 variant_snapshot_writer::variant_snapshot_writer(fc::mutable_variant_object& snapshot)
@@ -134,6 +145,14 @@ ostream_snapshot_writer::ostream_snapshot_writer(std::ostream& snapshot)
    snapshot.write((char*)&version, sizeof(version));
 }
 
+ostream_snapshot_writer::ostream_snapshot_writer(std::ostream& snapshot, no_header_t)
+:snapshot(snapshot)
+,header_pos(snapshot.tellp())
+,section_pos(-1)
+,row_count(0)
+{
+}
+
 void ostream_snapshot_writer::write_start_section( const std::string& section_name )
 {
    EOS_ASSERT(section_pos == std::streampos(-1), snapshot_exception, "Attempting to write a new section without closing the previous section");
@@ -183,6 +202,11 @@ void ostream_snapshot_writer::write_end_section( ) {
    row_count = 0;
 }
 
+void ostream_snapshot_writer::append_sections( section_buffer_snapshot_writer& sections ) {
+   EOS_ASSERT(section_pos == std::streampos(-1), snapshot_exception, "Attempting to append sections without closing the previous section");
+   sections.write_sections_to(snapshot.inner);
+}
+
 void ostream_snapshot_writer::finalize() {
    uint64_t end_marker = std::numeric_limits<uint64_t>::max();
 
@@ -190,6 +214,81 @@ void ostream_snapshot_writer::finalize() {
    snapshot.write((char*)&end_marker, sizeof(end_marker));
 }
 
+size_t detail::chunked_streambuf::position() const {
+   return cur_chunk * chunk_size + (pptr() - pbase());
+}
+
+void detail::chunked_streambuf::put_chunk( size_t index ) {
+   size = std::max( size, position() );
+   while( chunks.size() <= index )
+      chunks.emplace_back( new char[chunk_size] );
+   cur_chunk = index;
+   setp( chunks[index].get(), chunks[index].get() + chunk_size );
+}
+
+detail::chunked_streambuf::int_type detail::chunked_streambuf::overflow( int_type ch ) {
+   put_chunk( pbase() ? cur_chunk + 1 : 0 );
+   if( !traits_type::eq_int_type( ch, traits_type::eof() ) ) {
+      *pptr() = traits_type::to_char_type( ch );
+      pbump( 1 );
+   }
+   return traits_type::not_eof( ch );
+}
+
+std::streamsize detail::chunked_streambuf::xsputn( const char* s, std::streamsize n ) {
+   std::streamsize written = 0;
+   while( written < n ) {
+      if( pptr() == epptr() ) overflow( traits_type::eof() );
+      const auto count = std::min<std::streamsize>( n - written, epptr() - pptr() );
+      memcpy( pptr(), s + written, count );
+      pbump( static_cast<int>( count ) );
+      written += count;
+   }
+   return written;
+}
+
+detail::chunked_streambuf::pos_type detail::chunked_streambuf::seekoff( off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which ) {
+   if( dir == std::ios_base::cur ) {
+      if( off == 0 ) return pos_type( position() );
+      return seekpos( pos_type( position() + off ), which );
+   }
+   if( dir == std::ios_base::end )
+      return seekpos( pos_type( std::max( size, position() ) + off ), which );
+   return seekpos( pos_type( off ), which );
+}
+
+detail::chunked_streambuf::pos_type detail::chunked_streambuf::seekpos( pos_type pos, std::ios_base::openmode which ) {
+   const auto end = std::max( size, position() );
+   if( !(which & std::ios_base::out) || pos < 0 || static_cast<size_t>( pos ) > end )
+      return pos_type( off_type( -1 ) );
+
+   put_chunk( static_cast<size_t>( pos ) / chunk_size );
+   pbump( static_cast<int>( static_cast<size_t>( pos ) % chunk_size ) );
+   return pos;
+}
+
+void detail::chunked_streambuf::write_to( std::ostream& out ) {
+   size = std::max( size, position() );
+   for( size_t i = 0; i < chunks.size() && i * chunk_size < size; ++i ) {
+      out.write( chunks[i].get(), std::min( chunk_size, size - i * chunk_size ) );
+      chunks[i].reset();
+   }
+   chunks.clear();
+   cur_chunk = 0;
+   size = 0;
+   setp( nullptr, nullptr );
+}
+
+section_buffer_snapshot_writer::section_buffer_snapshot_writer()
+:ostream_snapshot_writer(buffer, no_header_t{})
+{
+}
+
+void section_buffer_snapshot_writer::write_sections_to( std::ostream& out ) {
+   buffer.flush();
+   buf.write_to(out);
+}
+
 istream_snapshot_reader::istream_snapshot_reader(std::istream& snapshot)
 :snapshot(snapshot)
 ,header_pos(snapshot.tellg())
@@ -246,15 +345,21 @@ bool istream_snapshot_reader::validate_section() const {
    return true;
 }
 
-bool istream_snapshot_reader::has_section( const string& section_name ) {
+const std::map<std::string, istream_snapshot_reader::section_info>& istream_snapshot_reader::section_index() {
+   if (sections) {
+      return *sections;
+   }
+
    auto restore_pos = fc::make_scoped_exit([this,pos=snapshot.tellg()](){
       snapshot.seekg(pos);
    });
 
    const std::streamoff header_size = sizeof(ostream_snapshot_writer::magic_number) + sizeof(current_snapshot_version);
 
+   std::map<std::string, section_info> index;
    auto next_section_pos = header_pos + header_size;
 
+   // one pass over the section headers, recording where the rows of each section start
    while (true) {
       snapshot.seekg(next_section_pos);
       uint64_t section_size = 0;
@@ -265,83 +370,422 @@ bool istream_snapshot_reader::has_section( const string& section_name ) {
 
       next_section_pos = snapshot.tellg() + std::streamoff(section_size);
 
-      uint64_t ignore = 0;
-      snapshot.read((char*)&ignore,sizeof(ignore));
+      section_info info;
+      snapshot.read((char*)&info.row_count,sizeof(info.row_count));
 
-      bool match = true;
-      for(auto c : section_name) {
-         if(snapshot.get() != c) {
-            match = false;
-            break;
-         }
-      }
+      std::string section_name;
+      std::getline(snapshot, section_name, '\0');
+      info.row_pos = snapshot.tellg();
 
-      if (match && snapshot.get() == 0) {
-         return true;
-      }
+      index.emplace(std::move(section_name), info);
    }
 
-   return false;
+   sections.emplace(std::move(index));
+   return *sections;
+}
+
+bool istream_snapshot_reader::has_section( const string& section_name ) {
+   const auto& index = section_index();
+   return index.find(section_name) != index.end();
 }
 
 void istream_snapshot_reader::set_section( const string& section_name ) {
-   auto restore_pos = fc::make_scoped_exit([this,pos=snapshot.tellg()](){
-      snapshot.seekg(pos);
-   });
+   const auto& index = section_index();
+   auto itr = index.find(section_name);
+   EOS_ASSERT(itr != index.end(), snapshot_exception, "Binary snapshot has no section named ${n}", ("n", section_name));
 
-   const std::streamoff header_size = sizeof(ostream_snapshot_writer::magic_number) + sizeof(current_snapshot_version);
+   cur_row = 0;
+   num_rows = itr->second.row_count;
 
-   auto next_section_pos = header_pos + header_size;
+   // leave the stream at the first row of the section
+   snapshot.seekg(itr->second.row_pos);
+}
+
+bool istream_snapshot_reader::read_row( detail::abstract_snapshot_row_reader& row_reader ) {
+   row_reader.provide(snapshot);
+   return ++cur_row < num_rows;
+}
+
+bool istream_snapshot_reader::empty ( ) {
+   return num_rows == 0;
+}
+
+void istream_snapshot_reader::clear_section() {
+   num_rows = 0;
+   cur_row = 0;
+}
+
+void istream_snapshot_reader::return_to_header() {
+   snapshot.seekg( header_pos );
+   clear_section();
+}
+
+mapped_snapshot_reader::mapped_snapshot_reader(const fc::path& snapshot_file)
+:file(std::make_unique<boost::interprocess::file_mapping>(snapshot_file.generic_string().c_str(), boost::interprocess::read_only))
+,region(std::make_unique<boost::interprocess::mapped_region>(*file, boost::interprocess::read_only))
+,data(static_cast<const char*>(region->get_address()))
+,size(region->get_size())
+,rows(data, 0)
+,num_rows(0)
+,cur_row(0)
+{
+   region->advise(boost::interprocess::mapped_region::advice_sequential);
+}
+
+mapped_snapshot_reader::mapped_snapshot_reader(const char* data, size_t size)
+:data(data)
+,size(size)
+,rows(data, 0)
+,num_rows(0)
+,cur_row(0)
+{
+}
+
+mapped_snapshot_reader::~mapped_snapshot_reader() = default;
+
+void mapped_snapshot_reader::validate() const {
+   fc::datastream<const char*> ds(data, size);
+   auto read = [&](auto& v) {
+      EOS_ASSERT(ds.remaining() >= sizeof(v), snapshot_exception, "Binary snapshot is truncated");
+      ds.read((char*)&v, sizeof(v));
+   };
+
+   auto actual_totem = ostream_snapshot_writer::magic_number;
+   read(actual_totem);
+   EOS_ASSERT(actual_totem == ostream_snapshot_writer::magic_number, snapshot_exception,
+              "Binary snapshot has unexpected magic number!");
+
+   auto actual_version = current_snapshot_version;
+   read(actual_version);
+   EOS_ASSERT(actual_version == current_snapshot_version, snapshot_exception,
+              "Binary snapshot is an unsuppored version.  Expected : ${expected}, Got: ${actual}",
+              ("expected", current_snapshot_version)("actual", actual_version));
 
    while (true) {
-      snapshot.seekg(next_section_pos);
       uint64_t section_size = 0;
-      snapshot.read((char*)&section_size,sizeof(section_size));
+      read(section_size);
       if (section_size == std::numeric_limits<uint64_t>::max()) {
          break;
       }
+      EOS_ASSERT(section_size <= ds.remaining(), snapshot_exception, "Binary snapshot is truncated");
+      ds.skip(section_size);
+   }
+}
 
-      next_section_pos = snapshot.tellg() + std::streamoff(section_size);
+const std::map<std::string, mapped_snapshot_reader::section_info>& mapped_snapshot_reader::section_index() {
+   if (sections) {
+      return *sections;
+   }
 
-      uint64_t row_count = 0;
-      snapshot.read((char*)&row_count,sizeof(row_count));
-
-      bool match = true;
-      for(auto c : section_name) {
-         if(snapshot.get() != c) {
-            match = false;
-            break;
-         }
+   const uint64_t header_size = sizeof(ostream_snapshot_writer::magic_number) + sizeof(current_snapshot_version);
+
+   std::map<std::string, section_info> index;
+   uint64_t pos = header_size;
+
+   // one pass over the section headers, the rows are only touched when their section is read
+   while (true) {
+      uint64_t section_size = 0;
+      EOS_ASSERT(pos + sizeof(section_size) <= size, snapshot_exception, "Binary snapshot is truncated");
+      memcpy(&section_size, data + pos, sizeof(section_size));
+      pos += sizeof(section_size);
+      if (section_size == std::numeric_limits<uint64_t>::max()) {
+         break;
       }
+      EOS_ASSERT(section_size >= sizeof(uint64_t) && section_size <= size - pos, snapshot_exception, "Binary snapshot is truncated");
 
-      if (match && snapshot.get() == 0) {
-         cur_row = 0;
-         num_rows = row_count;
+      section_info info;
+      info.end_offset = pos + section_size;
+      memcpy(&info.row_count, data + pos, sizeof(info.row_count));
 
-         // leave the stream at the right point
-         restore_pos.cancel();
-         return;
+      const char* name_begin = data + pos + sizeof(info.row_count);
+      const char* name_end = static_cast<const char*>(memchr(name_begin, 0, data + info.end_offset - name_begin));
+      EOS_ASSERT(name_end, snapshot_exception, "Binary snapshot has a section without a name");
+      info.row_offset = name_end + 1 - data;
+
+      index.emplace(std::string(name_begin, name_end), info);
+      pos = info.end_offset;
+   }
+
+   sections.emplace(std::move(index));
+   return *sections;
+}
+
+bool mapped_snapshot_reader::has_section( const string& section_name ) {
+   const auto& index = section_index();
+   return index.find(section_name) != index.end();
+}
+
+void mapped_snapshot_reader::set_section( const string& section_name ) {
+   const auto& index = section_index();
+   auto itr = index.find(section_name);
+   EOS_ASSERT(itr != index.end(), snapshot_exception, "Binary snapshot has no section named ${n}", ("n", section_name));
+
+   cur_row = 0;
+   num_rows = itr->second.row_count;
+   rows = fc::datastream<const char*>(data + itr->second.row_offset, itr->second.end_offset - itr->second.row_offset);
+
+   if (region) {
+      // have the whole section read in ahead of the rows unpacked from it
+      const uintptr_t page_mask = ~static_cast<uintptr_t>(sysconf(_SC_PAGESIZE) - 1);
+      const uintptr_t begin = reinterpret_cast<uintptr_t>(data + itr->second.row_offset) & page_mask;
+      const uintptr_t end = reinterpret_cast<uintptr_t>(data + itr->second.end_offset);
+      madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED);
+   }
+}
+
+bool mapped_snapshot_reader::read_row( detail::abstract_snapshot_row_reader& row_reader ) {
+   row_reader.provide(rows);
+   return ++cur_row < num_rows;
+}
+
+bool mapped_snapshot_reader::empty ( ) {
+   return num_rows == 0;
+}
+
+void mapped_snapshot_reader::clear_section() {
+   rows = fc::datastream<const char*>(data, 0);
+   num_rows = 0;
+   cur_row = 0;
+}
+
+void mapped_snapshot_reader::return_to_header() {
+   clear_section();
+}
+
+namespace bio = boost::iostreams;
+
+compressed_ostream_snapshot_writer::compressed_ostream_snapshot_writer(std::ostream& snapshot)
+:snapshot(snapshot)
+,header_pos(snapshot.tellp())
+{
+   // write magic number
+   auto totem = magic_number;
+   snapshot.write((char*)&totem, sizeof(totem));
+
+   // write version
+   auto version = current_snapshot_version;
+   snapshot.write((char*)&version, sizeof(version));
+}
+
+compressed_ostream_snapshot_writer::~compressed_ostream_snapshot_writer() = default;
+
+void compressed_ostream_snapshot_writer::write_start_section( const std::string& section_name )
+{
+   EOS_ASSERT(!current_section, snapshot_exception, "Attempting to write a new section without closing the previous section");
+   current_section.emplace();
+   current_section->name = section_name;
+   current_section->offset = snapshot.tellp() - header_pos;
+
+   auto out = std::make_unique<bio::filtering_ostream>();
+   out->push(bio::zlib_compressor(bio::zlib::default_compression));
+   out->push(snapshot);
+   compressor = std::move(out);
+}
+
+void compressed_ostream_snapshot_writer::write_row( const detail::abstract_snapshot_row_writer& row_writer ) {
+   // rows go through the compressor, so unlike the uncompressed writer a failed row cannot be rewound
+   detail::ostream_wrapper out(*compressor);
+   row_writer.write(out);
+   current_section->row_count++;
+}
+
+void compressed_ostream_snapshot_writer::write_end_section( ) {
+   // destroying the filtering stream flushes and terminates the zlib stream
+   compressor.reset();
+   current_section->size = snapshot.tellp() - header_pos - current_section->offset;
+   sections.emplace_back(std::move(*current_section));
+   current_section.reset();
+}
+
+void compressed_ostream_snapshot_writer::append_section( const std::string& section_name, std::istream& rows, uint64_t size, uint64_t row_count ) {
+   write_start_section( section_name );
+   std::vector<char> buffer( std::min<uint64_t>( size, 1024*1024 ) );
+   while( size > 0 ) {
+      const auto chunk = std::min<uint64_t>( size, buffer.size() );
+      rows.read( buffer.data(), chunk );
+      EOS_ASSERT( static_cast<uint64_t>(rows.gcount()) == chunk, snapshot_exception, "Binary snapshot has a truncated ${name} section", ("name", section_name) );
+      compressor->write( buffer.data(), chunk );
+      size -= chunk;
+   }
+   current_section->row_count = row_count;
+   write_end_section();
+}
+
+void compress_snapshot( std::istream& uncompressed, std::ostream& compressed, const std::function<void(uint64_t)>& progress ) {
+   const auto start_pos = uncompressed.tellg();
+   decltype(ostream_snapshot_writer::magic_number) actual_totem;
+   uncompressed.read((char*)&actual_totem, sizeof(actual_totem));
+   EOS_ASSERT(uncompressed && actual_totem == ostream_snapshot_writer::magic_number, snapshot_validation_exception,
+              "Binary snapshot has unexpected magic number!");
+
+   decltype(current_snapshot_version) actual_version;
+   uncompressed.read((char*)&actual_version, sizeof(actual_version));
+   EOS_ASSERT(uncompressed && actual_version == current_snapshot_version, snapshot_exception,
+              "Binary snapshot version ${v} cannot be compressed as version ${c}", ("v", actual_version)("c", current_snapshot_version));
+
+   compressed_ostream_snapshot_writer writer( compressed );
+   while( true ) {
+      uint64_t section_size = 0;
+      uncompressed.read((char*)&section_size, sizeof(section_size));
+      EOS_ASSERT(uncompressed, snapshot_exception, "Binary snapshot is missing its end marker");
+      if( section_size == std::numeric_limits<uint64_t>::max() ) break;
+
+      uint64_t row_count = 0;
+      uncompressed.read((char*)&row_count, sizeof(row_count));
+      std::string section_name;
+      std::getline( uncompressed, section_name, '\0' );
+      EOS_ASSERT(uncompressed && section_size >= sizeof(row_count) + section_name.size() + 1, snapshot_exception,
+                 "Binary snapshot has a malformed section header");
+
+      writer.append_section( section_name, uncompressed, section_size - sizeof(row_count) - section_name.size() - 1, row_count );
+      if( progress ) progress( uncompressed.tellg() - start_pos );
+   }
+   writer.finalize();
+}
+
+void compressed_ostream_snapshot_writer::finalize() {
+   EOS_ASSERT(!current_section, snapshot_exception, "Attempting to finalize a snapshot without closing the last section");
+   uint64_t table_offset = snapshot.tellp() - header_pos;
+
+   detail::ostream_wrapper out(snapshot);
+   fc::raw::pack(out, sections);
+
+   // the offset of the section table is always the last 8 bytes of the snapshot
+   snapshot.write((char*)&table_offset, sizeof(table_offset));
+}
+
+compressed_istream_snapshot_reader::compressed_istream_snapshot_reader(std::istream& snapshot)
+:snapshot(snapshot)
+,header_pos(snapshot.tellg())
+,num_rows(0)
+,cur_row(0)
+{
+}
+
+compressed_istream_snapshot_reader::~compressed_istream_snapshot_reader() = default;
+
+bool compressed_istream_snapshot_reader::is_compressed( std::istream& snapshot ) {
+   auto restore_pos = fc::make_scoped_exit([&snapshot,pos=snapshot.tellg()](){
+      snapshot.clear();
+      snapshot.seekg(pos);
+   });
+
+   auto totem = ostream_snapshot_writer::magic_number;
+   snapshot.read((char*)&totem, sizeof(totem));
+   return snapshot && totem == compressed_ostream_snapshot_writer::magic_number;
+}
+
+void compressed_istream_snapshot_reader::validate() const {
+   // make sure to restore the read pos
+   auto restore_pos = fc::make_scoped_exit([this,pos=snapshot.tellg(),ex=snapshot.exceptions()](){
+      snapshot.seekg(pos);
+      snapshot.exceptions(ex);
+   });
+
+   snapshot.exceptions(std::istream::failbit|std::istream::eofbit);
+
+   try {
+      snapshot.seekg(header_pos);
+
+      // validate totem
+      auto expected_totem = compressed_ostream_snapshot_writer::magic_number;
+      decltype(expected_totem) actual_totem;
+      snapshot.read((char*)&actual_totem, sizeof(actual_totem));
+      EOS_ASSERT(actual_totem == expected_totem, snapshot_exception,
+                 "Compressed snapshot has unexpected magic number!");
+
+      // validate version
+      auto expected_version = current_snapshot_version;
+      decltype(expected_version) actual_version;
+      snapshot.read((char*)&actual_version, sizeof(actual_version));
+      EOS_ASSERT(actual_version == expected_version, snapshot_exception,
+                 "Compressed snapshot is an unsuppored version.  Expected : ${expected}, Got: ${actual}",
+                 ("expected", expected_version)("actual", actual_version));
+
+      // validate that the section table is readable and every section lies before it
+      snapshot.seekg(-std::streamoff(sizeof(uint64_t)), std::ios::end);
+      uint64_t table_offset = 0;
+      snapshot.read((char*)&table_offset, sizeof(table_offset));
+
+      snapshot.seekg(header_pos + std::streamoff(table_offset));
+      std::vector<detail::compressed_snapshot_section> table;
+      fc::raw::unpack(snapshot, table);
+
+      const uint64_t header_size = sizeof(compressed_ostream_snapshot_writer::magic_number) + sizeof(current_snapshot_version);
+      for (const auto& section : table) {
+         EOS_ASSERT(section.offset >= header_size && section.offset + section.size <= table_offset, snapshot_exception,
+                    "Compressed snapshot section ${n} lies outside of the snapshot data", ("n", section.name));
       }
+   } catch( const std::exception& e ) {
+      snapshot_exception fce(FC_LOG_MESSAGE( warn, "Compressed snapshot validation threw IO exception (${what})",("what",e.what())));
+      throw fce;
+   }
+}
+
+const std::map<std::string, detail::compressed_snapshot_section>& compressed_istream_snapshot_reader::section_index() {
+   if (sections) {
+      return *sections;
    }
 
-   EOS_THROW(snapshot_exception, "Binary snapshot has no section named ${n}", ("n", section_name));
+   auto restore_pos = fc::make_scoped_exit([this,pos=snapshot.tellg()](){
+      snapshot.seekg(pos);
+   });
+
+   snapshot.seekg(-std::streamoff(sizeof(uint64_t)), std::ios::end);
+   uint64_t table_offset = 0;
+   snapshot.read((char*)&table_offset, sizeof(table_offset));
+
+   snapshot.seekg(header_pos + std::streamoff(table_offset));
+   std::vector<detail::compressed_snapshot_section> table;
+   fc::raw::unpack(snapshot, table);
+
+   std::map<std::string, detail::compressed_snapshot_section> index;
+   for (auto& section : table) {
+      auto name = section.name;
+      index.emplace(std::move(name), std::move(section));
+   }
+
+   sections.emplace(std::move(index));
+   return *sections;
 }
 
-bool istream_snapshot_reader::read_row( detail::abstract_snapshot_row_reader& row_reader ) {
-   row_reader.provide(snapshot);
+bool compressed_istream_snapshot_reader::has_section( const string& section_name ) {
+   const auto& index = section_index();
+   return index.find(section_name) != index.end();
+}
+
+void compressed_istream_snapshot_reader::set_section( const string& section_name ) {
+   const auto& index = section_index();
+   auto itr = index.find(section_name);
+   EOS_ASSERT(itr != index.end(), snapshot_exception, "Compressed snapshot has no section named ${n}", ("n", section_name));
+
+   cur_row = 0;
+   num_rows = itr->second.row_count;
+
+   snapshot.seekg(header_pos + std::streamoff(itr->second.offset));
+
+   auto in = std::make_unique<bio::filtering_istream>();
+   in->push(bio::zlib_decompressor());
+   in->push(snapshot);
+   decompressor = std::move(in);
+}
+
+bool compressed_istream_snapshot_reader::read_row( detail::abstract_snapshot_row_reader& row_reader ) {
+   row_reader.provide(*decompressor);
    return ++cur_row < num_rows;
 }
 
-bool istream_snapshot_reader::empty ( ) {
+bool compressed_istream_snapshot_reader::empty ( ) {
    return num_rows == 0;
 }
 
-void istream_snapshot_reader::clear_section() {
+void compressed_istream_snapshot_reader::clear_section() {
+   decompressor.reset();
    num_rows = 0;
    cur_row = 0;
 }
 
-void istream_snapshot_reader::return_to_header() {
+void compressed_istream_snapshot_reader::return_to_header() {
    snapshot.seekg( header_pos );
    clear_section();
 }
@@ -368,4 +812,19 @@ void integrity_hash_snapshot_writer::finalize() {
    // no-op for structural details
 }
 
+void section_hash_snapshot_writer::write_start_section( const std::string& section_name ) {
+   EOS_ASSERT(!enc, snapshot_exception, "Attempting to write a new section without closing the previous section");
+   enc.emplace();
+   current_section_name = section_name;
+}
+
+void section_hash_snapshot_writer::write_row( const detail::abstract_snapshot_row_writer& row_writer ) {
+   row_writer.write(*enc);
+}
+
+void section_hash_snapshot_writer::write_end_section( ) {
+   hashes.emplace_back(std::move(current_section_name), enc->result());
+   enc.reset();
+}
+
 }}
@@ -0,0 +1,243 @@
+#include <eosio/chain/snapshot_delta.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <array>
+#include <map>
+
+namespace eosio { namespace chain { namespace snapshot_delta {
+
+namespace {
+   // chunk sizes bound the cost of a single changed row; the boundary mask gives an average of ~64KiB
+   constexpr size_t   min_chunk_size = 16 * 1024;
+   constexpr size_t   max_chunk_size = 256 * 1024;
+   constexpr uint64_t boundary_mask  = (uint64_t(1) << 16) - 1;
+   constexpr size_t   io_buffer_size = 1024 * 1024;
+
+   enum class op_type : uint8_t {
+      copy    = 0,
+      literal = 1,
+      end     = 2
+   };
+
+   const std::array<uint64_t, 256>& gear_table() {
+      static const auto table = [](){
+         std::array<uint64_t, 256> t;
+         uint64_t state = 0x9e3779b97f4a7c15ULL;
+         for( auto& v : t ) {
+            // splitmix64, so the table (and therefore every chunk boundary) is fixed across builds
+            state += 0x9e3779b97f4a7c15ULL;
+            uint64_t z = state;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+            v = z ^ (z >> 31);
+         }
+         return t;
+      }();
+      return table;
+   }
+
+   /**
+    * Splits a stream into content defined chunks using a gear rolling hash, the boundaries depend only on the
+    * bytes close to them so an insertion or removal does not shift the chunks that follow it
+    */
+   class chunker {
+      public:
+         explicit chunker( std::istream& in )
+         :in(in)
+         ,buffer(io_buffer_size)
+         {}
+
+         bool next( std::string& chunk ) {
+            const auto& table = gear_table();
+            chunk.clear();
+            uint64_t hash = 0;
+            while( true ) {
+               if( pos == end && !fill() ) {
+                  return !chunk.empty();
+               }
+               const char c = buffer[pos++];
+               chunk.push_back( c );
+               hash = (hash << 1) + table[static_cast<uint8_t>(c)];
+               if( chunk.size() >= max_chunk_size || (chunk.size() >= min_chunk_size && (hash & boundary_mask) == 0) ) {
+                  return true;
+               }
+            }
+         }
+
+      private:
+         bool fill() {
+            in.read( buffer.data(), buffer.size() );
+            end = in.gcount();
+            pos = 0;
+            return end > 0;
+         }
+
+         std::istream&     in;
+         std::vector<char> buffer;
+         size_t            pos = 0;
+         size_t            end = 0;
+   };
+
+   template<typename T>
+   void write_value( std::ostream& out, const T& v ) {
+      out.write( (const char*)&v, sizeof(v) );
+   }
+
+   template<typename T>
+   T read_value( std::istream& in ) {
+      T v;
+      in.read( (char*)&v, sizeof(v) );
+      EOS_ASSERT( in.gcount() == sizeof(v), snapshot_exception, "Snapshot delta is truncated" );
+      return v;
+   }
+
+   /// copy @ref size bytes from @ref in to @ref out, feeding them to @ref enc
+   void copy_bytes( std::istream& in, std::ostream& out, uint64_t size, fc::sha256::encoder& enc ) {
+      std::vector<char> buffer( std::min<uint64_t>( size, io_buffer_size ) );
+      while( size > 0 ) {
+         const auto n = std::min<uint64_t>( size, buffer.size() );
+         in.read( buffer.data(), n );
+         EOS_ASSERT( static_cast<uint64_t>(in.gcount()) == n, snapshot_exception, "Snapshot delta refers past the end of its input" );
+         out.write( buffer.data(), n );
+         enc.write( buffer.data(), n );
+         size -= n;
+      }
+   }
+
+   fc::sha256 hash_stream( std::istream& in ) {
+      fc::sha256::encoder enc;
+      std::vector<char> buffer( io_buffer_size );
+      while( in.read( buffer.data(), buffer.size() ) || in.gcount() > 0 ) {
+         enc.write( buffer.data(), in.gcount() );
+      }
+      return enc.result();
+   }
+}
+
+summary write( std::istream& base, std::istream& target, std::ostream& delta ) {
+   summary result;
+
+   // index every chunk of the base by content
+   std::map<fc::sha256, std::pair<uint64_t, uint64_t>> base_chunks;
+   {
+      fc::sha256::encoder base_enc;
+      chunker chunks( base );
+      std::string chunk;
+      uint64_t offset = 0;
+      while( chunks.next( chunk ) ) {
+         base_chunks.emplace( fc::sha256::hash( chunk.data(), chunk.size() ), std::make_pair( offset, chunk.size() ) );
+         base_enc.write( chunk.data(), chunk.size() );
+         offset += chunk.size();
+      }
+      result.base_hash = base_enc.result();
+   }
+
+   write_value( delta, magic_number );
+   write_value( delta, current_version );
+   delta.write( result.base_hash.data(), result.base_hash.data_size() );
+
+   // adjacent copies and literals are coalesced before being written
+   fc::optional<std::pair<uint64_t, uint64_t>> pending_copy;
+   std::string pending_literal;
+
+   auto flush = [&]() {
+      if( pending_copy ) {
+         write_value( delta, op_type::copy );
+         write_value( delta, pending_copy->first );
+         write_value( delta, pending_copy->second );
+         result.copied_bytes += pending_copy->second;
+         pending_copy.reset();
+      }
+      if( !pending_literal.empty() ) {
+         write_value( delta, op_type::literal );
+         write_value( delta, static_cast<uint64_t>(pending_literal.size()) );
+         delta.write( pending_literal.data(), pending_literal.size() );
+         result.literal_bytes += pending_literal.size();
+         pending_literal.clear();
+      }
+   };
+
+   fc::sha256::encoder target_enc;
+   chunker chunks( target );
+   std::string chunk;
+   while( chunks.next( chunk ) ) {
+      target_enc.write( chunk.data(), chunk.size() );
+
+      auto itr = base_chunks.find( fc::sha256::hash( chunk.data(), chunk.size() ) );
+      if( itr != base_chunks.end() ) {
+         const auto& range = itr->second;
+         if( pending_copy && pending_copy->first + pending_copy->second == range.first ) {
+            pending_copy->second += range.second;
+         } else {
+            flush();
+            pending_copy = range;
+         }
+      } else {
+         if( pending_copy ) {
+            flush();
+         }
+         pending_literal += chunk;
+         if( pending_literal.size() >= io_buffer_size ) {
+            flush();
+         }
+      }
+   }
+   flush();
+
+   result.target_hash = target_enc.result();
+   write_value( delta, op_type::end );
+   delta.write( result.target_hash.data(), result.target_hash.data_size() );
+
+   return result;
+}
+
+summary apply( std::istream& base, std::istream& delta, std::ostream& out ) {
+   summary result;
+
+   EOS_ASSERT( read_value<uint32_t>( delta ) == magic_number, snapshot_exception,
+               "Snapshot delta has unexpected magic number!" );
+   const auto version = read_value<uint32_t>( delta );
+   EOS_ASSERT( version == current_version, snapshot_exception,
+               "Snapshot delta is an unsupported version.  Expected : ${expected}, Got: ${actual}",
+               ("expected", current_version)("actual", version) );
+
+   fc::sha256 expected_base;
+   delta.read( expected_base.data(), expected_base.data_size() );
+
+   const auto base_start = base.tellg();
+   result.base_hash = hash_stream( base );
+   EOS_ASSERT( result.base_hash == expected_base, snapshot_exception,
+               "Snapshot delta was made against base ${expected} but was given base ${actual}",
+               ("expected", expected_base)("actual", result.base_hash) );
+   base.clear();
+
+   fc::sha256::encoder target_enc;
+   while( true ) {
+      const auto op = read_value<op_type>( delta );
+      if( op == op_type::copy ) {
+         const auto offset = read_value<uint64_t>( delta );
+         const auto size = read_value<uint64_t>( delta );
+         base.seekg( base_start + std::streamoff(offset) );
+         copy_bytes( base, out, size, target_enc );
+         result.copied_bytes += size;
+      } else if( op == op_type::literal ) {
+         const auto size = read_value<uint64_t>( delta );
+         copy_bytes( delta, out, size, target_enc );
+         result.literal_bytes += size;
+      } else {
+         EOS_ASSERT( op == op_type::end, snapshot_exception, "Snapshot delta has an unknown operation ${op}", ("op", static_cast<uint32_t>(op)) );
+         break;
+      }
+   }
+
+   fc::sha256 expected_target;
+   delta.read( expected_target.data(), expected_target.data_size() );
+   result.target_hash = target_enc.result();
+   EOS_ASSERT( result.target_hash == expected_target, snapshot_exception,
+               "Snapshot delta produced ${actual} but expected ${expected}",
+               ("expected", expected_target)("actual", result.target_hash) );
+
+   return result;
+}
+
+} } } // eosio::chain::snapshot_delta
@@ -0,0 +1,50 @@
+#include <eosio/chain/state_checkpoint_log.hpp>
+#include <fc/io/fstream.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/log/logger.hpp>
+
+#include <boost/filesystem.hpp>
+
+namespace eosio { namespace chain {
+
+   namespace {
+      constexpr size_t entry_size = sizeof(block_id_type) + sizeof(digest_type);
+   }
+
+   state_checkpoint_log::state_checkpoint_log( const fc::path& file_path ) {
+      if( fc::exists( file_path ) ) {
+         std::string contents;
+         fc::read_file_contents( file_path, contents );
+
+         const size_t whole = contents.size() - contents.size() % entry_size;
+         if( whole != contents.size() ) {
+            wlog( "dropping torn entry at the end of state checkpoint log ${f}", ("f", file_path.generic_string()) );
+            boost::filesystem::resize_file( file_path, whole );
+         }
+
+         fc::datastream<const char*> ds( contents.data(), whole );
+         while( ds.remaining() > 0 ) {
+            state_checkpoint c;
+            fc::raw::unpack( ds, c );
+            _checkpoints[c.block_id] = c.state_root;
+         }
+      }
+
+      _file.set_file_path( file_path );
+      _file.open( "ab+" );
+   }
+
+   void state_checkpoint_log::append( const state_checkpoint& c ) {
+      const auto data = fc::raw::pack( c );
+      _file.write( data.data(), data.size() );
+      _file.flush();
+      _checkpoints[c.block_id] = c.state_root;
+   }
+
+   optional<digest_type> state_checkpoint_log::find( const block_id_type& id )const {
+      auto itr = _checkpoints.find( id );
+      if( itr == _checkpoints.end() ) return {};
+      return itr->second;
+   }
+
+} }
@@ -0,0 +1,70 @@
+#include <eosio/chain/state_prefetcher.hpp>
+#include <eosio/chain/transaction.hpp>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace eosio { namespace chain {
+
+state_prefetcher::state_prefetcher( size_t pages_per_contract )
+:_pages_per_contract( pages_per_contract )
+,_page_mask( ~static_cast<uintptr_t>( sysconf( _SC_PAGESIZE ) - 1 ) )
+,_thread_pool( "prefch", 1 )
+{
+}
+
+void state_prefetcher::record( account_name contract, const vector<const void*>& objects ) {
+   if( objects.empty() ) return;
+   std::lock_guard<std::mutex> g( _mtx );
+   auto& c = _contracts[contract];
+   for( const void* o : objects ) {
+      const uintptr_t page = reinterpret_cast<uintptr_t>( o ) & _page_mask;
+      if( !c.pages.insert( page ).second ) continue;
+      c.order.push_back( page );
+      if( c.order.size() > _pages_per_contract ) {
+         c.pages.erase( c.order.front() );
+         c.order.pop_front();
+      }
+   }
+}
+
+void state_prefetcher::prefetch( const transaction& trx ) {
+   flat_set<account_name> contracts;
+   for( const auto& a : trx.actions )
+      contracts.insert( a.account );
+   prefetch( contracts );
+}
+
+void state_prefetcher::prefetch( const flat_set<account_name>& contracts ) {
+   for( const auto& contract : contracts ) {
+      {
+         std::lock_guard<std::mutex> g( _mtx );
+         auto itr = _contracts.find( contract );
+         // a contract seen for the first time has no history yet, and a burst of its transactions needs one prefetch
+         if( itr == _contracts.end() || itr->second.queued ) continue;
+         itr->second.queued = true;
+      }
+      boost::asio::post( _thread_pool.get_executor(), [this, contract]() { advise( contract ); } );
+   }
+}
+
+size_t state_prefetcher::pages( account_name contract )const {
+   std::lock_guard<std::mutex> g( _mtx );
+   auto itr = _contracts.find( contract );
+   return itr == _contracts.end() ? 0 : itr->second.order.size();
+}
+
+void state_prefetcher::advise( account_name contract ) {
+   vector<uintptr_t> pages;
+   {
+      std::lock_guard<std::mutex> g( _mtx );
+      auto& c = _contracts[contract];
+      c.queued = false;
+      pages.assign( c.order.begin(), c.order.end() );
+   }
+   const size_t page_size = ~_page_mask + 1;
+   for( uintptr_t p : pages )
+      madvise( reinterpret_cast<void*>( p ), page_size, MADV_WILLNEED );
+}
+
+} } // eosio::chain
@@ -0,0 +1,37 @@
+#include <eosio/chain/table_access_set.hpp>
+
+namespace eosio { namespace chain {
+
+namespace {
+   template<typename Set>
+   bool intersects( const Set& a, const Set& b ) {
+      auto i = a.begin();
+      auto j = b.begin();
+      while( i != a.end() && j != b.end() ) {
+         if( *i < *j )      ++i;
+         else if( *j < *i ) ++j;
+         else return true;
+      }
+      return false;
+   }
+}
+
+bool table_access_set::conflicts_with( const table_access_set& other )const {
+   return intersects( writes, other.writes ) || intersects( writes, other.reads ) || intersects( reads, other.writes );
+}
+
+vector<uint32_t> partition_into_waves( const vector<table_access_set>& sets ) {
+   vector<uint32_t> waves;
+   waves.reserve( sets.size() );
+   for( size_t i = 0; i < sets.size(); ++i ) {
+      uint32_t wave = 0;
+      for( size_t j = 0; j < i; ++j ) {
+         if( waves[j] >= wave && sets[i].conflicts_with( sets[j] ) )
+            wave = waves[j] + 1;
+      }
+      waves.push_back( wave );
+   }
+   return waves;
+}
+
+} } // eosio::chain
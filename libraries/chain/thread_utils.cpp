@@ -1,5 +1,8 @@
 #include <eosio/chain/thread_utils.hpp>
 #include <fc/log/logger_config.hpp>
+#include <fc/log/logger.hpp>
+
+#include <pthread.h>
 
 namespace eosio { namespace chain {
 
@@ -7,15 +10,28 @@ namespace eosio { namespace chain {
 //
 // named_thread_pool
 //
-named_thread_pool::named_thread_pool( std::string name_prefix, size_t num_threads )
+named_thread_pool::named_thread_pool( std::string name_prefix, size_t num_threads, std::vector<uint32_t> cpus )
 : _thread_pool( num_threads )
 , _ioc( num_threads )
 {
    _ioc_work.emplace( boost::asio::make_work_guard( _ioc ) );
    for( size_t i = 0; i < num_threads; ++i ) {
-      boost::asio::post( _thread_pool, [&ioc = _ioc, name_prefix, i]() {
+      fc::optional<uint32_t> cpu;
+      if( !cpus.empty() )
+         cpu = cpus[i % cpus.size()];
+      boost::asio::post( _thread_pool, [&ioc = _ioc, name_prefix, i, cpu]() {
          std::string tn = name_prefix + "-" + std::to_string( i );
          fc::set_os_thread_name( tn );
+#ifdef __linux__
+         if( cpu ) {
+            cpu_set_t set;
+            CPU_ZERO( &set );
+            if( *cpu < CPU_SETSIZE )
+               CPU_SET( *cpu, &set );
+            if( *cpu >= CPU_SETSIZE || pthread_setaffinity_np( pthread_self(), sizeof( set ), &set ) != 0 )
+               wlog( "unable to pin thread ${t} to cpu ${c}", ("t", tn)("c", *cpu) );
+         }
+#endif
          ioc.run();
       } );
    }
@@ -10,6 +10,7 @@
 #include <eosio/chain/config.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/transaction.hpp>
+#include <eosio/chain/recovered_key_cache.hpp>
 
 namespace eosio { namespace chain {
 
@@ -68,7 +69,7 @@ fc::microseconds transaction::get_signature_keys( const vector<signature_type>&
       auto now = fc::time_point::now();
       EOS_ASSERT( now < deadline, tx_cpu_usage_exceeded, "transaction signature verification executed for too long ${time}us",
                   ("time", now - start)("now", now)("deadline", deadline)("start", start) );
-      auto[ itr, successful_insertion ] = recovered_pub_keys.emplace( sig, digest );
+      auto[ itr, successful_insertion ] = recovered_pub_keys.emplace( recovered_key_cache::recover( sig, digest, true ) );
       EOS_ASSERT( allow_duplicate_keys || successful_insertion, tx_duplicate_sig,
                   "transaction includes more than one signature signed using the same key associated with public key: ${key}",
                   ("key", *itr ) );
@@ -147,6 +148,49 @@ uint32_t packed_transaction::get_prunable_size()const {
    return static_cast<uint32_t>(size);
 }
 
+namespace {
+   size_t estimated_size( const vector<action>& actions ) {
+      size_t size = actions.capacity() * sizeof(action);
+      for( const auto& a : actions ) {
+         size += a.authorization.capacity() * sizeof(permission_level) + a.data.capacity();
+      }
+      return size;
+   }
+
+   size_t estimated_size( const vector<bytes>& v ) {
+      size_t size = v.capacity() * sizeof(bytes);
+      for( const auto& b : v ) {
+         size += b.capacity();
+      }
+      return size;
+   }
+
+   size_t estimated_size( const vector<signature_type>& sigs ) {
+      size_t size = sigs.capacity() * sizeof(signature_type);
+      for( const auto& s : sigs ) {
+         size += s.variable_size();
+      }
+      return size;
+   }
+}
+
+size_t packed_transaction::get_estimated_size()const {
+   size_t size = sizeof(*this);
+   size += estimated_size( signatures );
+   size += packed_context_free_data.capacity();
+   size += packed_trx.capacity();
+
+   size += estimated_size( unpacked_trx.context_free_actions );
+   size += estimated_size( unpacked_trx.actions );
+   size += unpacked_trx.transaction_extensions.capacity() * sizeof(decltype(unpacked_trx.transaction_extensions)::value_type);
+   for( const auto& e : unpacked_trx.transaction_extensions ) {
+      size += e.second.capacity();
+   }
+   size += estimated_size( unpacked_trx.signatures );
+   size += estimated_size( unpacked_trx.context_free_data );
+   return size;
+}
+
 digest_type packed_transaction::packed_digest()const {
    digest_type::encoder prunable;
    fc::raw::pack( prunable, signatures );
@@ -6,6 +6,7 @@
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/transaction_object.hpp>
 #include <eosio/chain/global_property_object.hpp>
+#include <fc/scoped_exit.hpp>
 
 #pragma push_macro("N")
 #undef N
@@ -61,6 +62,9 @@ namespace eosio { namespace chain {
       if (!c.skip_db_sessions()) {
          undo_session = c.mutable_db().start_undo_session(true);
       }
+      if( auto* stats = c.get_mutable_table_lookup_stats() ) {
+         lookup_cache.emplace( *stats );
+      }
       trace->id = id;
       trace->block_num = c.head_block_num() + 1;
       trace->block_time = c.pending_block_time();
@@ -68,6 +72,8 @@ namespace eosio { namespace chain {
       executed.reserve( trx.total_actions() );
    }
 
+   transaction_context::~transaction_context() = default;
+
    void transaction_context::disallow_transaction_extensions( const char* error_msg )const {
       if( control.is_producing_block() ) {
          EOS_THROW( subjective_block_production_exception, error_msg );
@@ -347,6 +353,7 @@ namespace eosio { namespace chain {
 
    void transaction_context::undo() {
       if (undo_session) undo_session->undo();
+      if (lookup_cache) lookup_cache->clear();
    }
 
    void transaction_context::check_net_usage()const {
@@ -589,7 +596,14 @@ namespace eosio { namespace chain {
    }
 
    void transaction_context::execute_action( uint32_t action_ordinal, uint32_t recurse_depth ) {
-      apply_context acontext( control, *this, action_ordinal, recurse_depth );
+      // an inline action runs while the context of its creator is still in use, so each depth has its own
+      if( apply_contexts_in_use == apply_contexts.size() ) {
+         apply_contexts.emplace_back( std::make_unique<apply_context>( control, *this, action_ordinal, recurse_depth ) );
+      } else {
+         apply_contexts[apply_contexts_in_use]->reset( action_ordinal, recurse_depth );
+      }
+      apply_context& acontext = *apply_contexts[apply_contexts_in_use++];
+      auto release = fc::make_scoped_exit( [this]() { --apply_contexts_in_use; } );
       acontext.exec();
    }
 
@@ -634,6 +648,7 @@ namespace eosio { namespace chain {
           EOS_ASSERT( false, tx_duplicate,
                      "duplicate transaction ${id}", ("id", id ) );
       }
+      control.record_in_dedup_filter( id, expire );
    } /// record_transaction
 
    void transaction_context::validate_referenced_accounts( const transaction& trx, bool enforce_actor_whitelist_blacklist )const {
@@ -0,0 +1,40 @@
+#include <eosio/chain/transaction_dedup_filter.hpp>
+
+namespace eosio { namespace chain {
+
+namespace {
+   // ids are sha256 digests, their words are already uniformly distributed
+   template<typename F>
+   void for_each_bit( const transaction_id_type& id, F&& f ) {
+      const uint64_t h1 = id._hash[0];
+      const uint64_t h2 = id._hash[1] | 1;
+      for( uint32_t i = 0; i < transaction_dedup_filter::hashes; ++i ) {
+         const uint64_t bit = ( h1 + i * h2 ) & ( transaction_dedup_filter::bits_per_bucket - 1 );
+         f( bit / 64, uint64_t(1) << ( bit % 64 ) );
+      }
+   }
+}
+
+void transaction_dedup_filter::add( const transaction_id_type& id, fc::time_point_sec expiration ) {
+   auto& bits = _buckets[expiration.sec_since_epoch() / bucket_seconds];
+   if( bits.empty() )
+      bits.resize( bits_per_bucket / 64 );
+   for_each_bit( id, [&bits]( uint64_t word, uint64_t mask ) { bits[word] |= mask; } );
+}
+
+bool transaction_dedup_filter::may_contain( const transaction_id_type& id, fc::time_point_sec expiration )const {
+   auto itr = _buckets.find( expiration.sec_since_epoch() / bucket_seconds );
+   if( itr == _buckets.end() ) return false;
+   const auto& bits = itr->second;
+   bool found = true;
+   for_each_bit( id, [&]( uint64_t word, uint64_t mask ) { found = found && ( bits[word] & mask ); } );
+   return found;
+}
+
+void transaction_dedup_filter::remove_expired( fc::time_point t ) {
+   const uint32_t now = fc::time_point_sec( t ).sec_since_epoch();
+   while( !_buckets.empty() && uint64_t( _buckets.begin()->first + 1 ) * bucket_seconds <= now )
+      _buckets.erase( _buckets.begin() );
+}
+
+} } // eosio::chain
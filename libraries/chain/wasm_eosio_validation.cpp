@@ -3,10 +3,16 @@
 #include <eosio/chain/wasm_eosio_binary_ops.hpp>
 #include <fc/exception/exception.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include "IR/Module.h"
 #include "IR/Operators.h"
 #include "WASM/WASM.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 namespace eosio { namespace chain { namespace wasm_validations {
 using namespace IR;
 
@@ -93,4 +99,78 @@ void ensure_apply_exported_visitor::validate( const IR::Module& m ) {
 
 uint16_t nested_validator::depth = 0;
 bool     nested_validator::disabled = false;
+thread_local std::vector<bool>* nested_validator::recorded = nullptr;
+
+bool wasm_binary_validation::should_validate_in_parallel() const {
+   size_t code_size = 0;
+   for( const FunctionDef& fd : _module->functions.defs )
+      code_size += fd.code.size();
+   return _module->functions.defs.size() > 1 && code_size >= parallel_validation_threshold;
+}
+
+void wasm_binary_validation::validate_functions_in_parallel() {
+   struct function_result {
+      std::vector<bool>  nesting;
+      std::exception_ptr error;
+   };
+   struct shared_state {
+      std::vector<std::pair<size_t, size_t>> chunks; // [begin, end) function indices
+      std::vector<function_result>           results;
+      std::atomic<size_t>                    next_chunk{0};
+      std::mutex                             mtx;
+      std::condition_variable                cv;
+      size_t                                 chunks_done = 0;
+   };
+
+   auto& defs = _module->functions.defs;
+   // shared so that a task the pool only gets to after every chunk is done can still find out there is nothing left
+   auto state = std::make_shared<shared_state>();
+   state->results.resize( defs.size() );
+   for( size_t begin = 0, i = 0, bytes = 0; i < defs.size(); ) {
+      bytes += defs[i++].code.size();
+      if( bytes >= parallel_validation_chunk_size || i == defs.size() ) {
+         state->chunks.emplace_back( begin, i );
+         begin = i;
+         bytes = 0;
+      }
+   }
+
+   auto run = [this, state, &defs]() {
+      for( size_t c = state->next_chunk++; c < state->chunks.size(); c = state->next_chunk++ ) {
+         for( size_t i = state->chunks[c].first; i < state->chunks[c].second; ++i ) {
+            function_result& result = state->results[i];
+            nested_validator::recorded = &result.nesting;
+            try {
+               validate_function( defs[i] );
+            } catch( ... ) {
+               result.error = std::current_exception();
+            }
+            nested_validator::recorded = nullptr;
+            // nothing after the first failure of a chunk can be reported
+            if( result.error )
+               break;
+         }
+         std::lock_guard<std::mutex> g( state->mtx );
+         if( ++state->chunks_done == state->chunks.size() )
+            state->cv.notify_all();
+      }
+   };
+
+   const size_t helpers = std::min<size_t>( state->chunks.size() - 1, std::max( 1u, std::thread::hardware_concurrency() ) );
+   for( size_t i = 0; i < helpers; ++i )
+      boost::asio::post( *_thread_pool, run );
+   run();
+   {
+      std::unique_lock<std::mutex> g( state->mtx );
+      state->cv.wait( g, [&state]() { return state->chunks_done == state->chunks.size(); } );
+   }
+
+   // replay in function order so the nesting depth and the first error are exactly those of a serial validation
+   for( const function_result& result : state->results ) {
+      for( bool is_end : result.nesting )
+         nested_validator::step( is_end );
+      if( result.error )
+         std::rethrow_exception( result.error );
+   }
+}
 }}} // namespace eosio chain validation
@@ -13,6 +13,8 @@
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/protocol_state_object.hpp>
 #include <eosio/chain/account_object.hpp>
+#include <eosio/chain/recovered_key_cache.hpp>
+#include <eosio/chain/hardware_float.hpp>
 #include <fc/exception/exception.hpp>
 #include <fc/crypto/sha256.hpp>
 #include <fc/crypto/sha1.hpp>
@@ -23,6 +25,7 @@
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include <fstream>
+#include <thread>
 #include <string.h>
 
 #if defined(EOSIO_EOS_VM_RUNTIME_ENABLED) || defined(EOSIO_EOS_VM_JIT_RUNTIME_ENABLED)
@@ -32,12 +35,13 @@
 namespace eosio { namespace chain {
    using namespace webassembly::common;
 
-   wasm_interface::wasm_interface(vm_type vm, bool eosvmoc_tierup, const chainbase::database& d, const boost::filesystem::path data_dir, const eosvmoc::config& eosvmoc_config)
-     : my( new wasm_interface_impl(vm, eosvmoc_tierup, d, data_dir, eosvmoc_config) ) {}
+   wasm_interface::wasm_interface(vm_type vm, bool eosvmoc_tierup, bool persistent_module_cache, uint64_t module_cache_size, uint64_t instantiation_cache_budget,
+                                  const chainbase::database& d, const boost::filesystem::path data_dir, const eosvmoc::config& eosvmoc_config)
+     : my( new wasm_interface_impl(vm, eosvmoc_tierup, persistent_module_cache, module_cache_size, instantiation_cache_budget, d, data_dir, eosvmoc_config) ) {}
 
    wasm_interface::~wasm_interface() {}
 
-   void wasm_interface::validate(const controller& control, const bytes& code) {
+   void wasm_interface::validate(controller& control, const bytes& code) {
       Module module;
       try {
          Serialization::MemoryInputStream stream((U8*)code.data(), code.size());
@@ -48,7 +52,7 @@ namespace eosio { namespace chain {
          EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
       }
 
-      wasm_validations::wasm_binary_validation validator(control, module);
+      wasm_validations::wasm_binary_validation validator(control, module, &control.get_thread_pool());
       validator.validate();
 
       const auto& pso = control.db().get<protocol_state_object>();
@@ -73,9 +77,44 @@ namespace eosio { namespace chain {
       my->current_lib(lib);
    }
 
+   void wasm_interface::eosvmoc_precompile_all(const std::function<bool()>& shutdown) {
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+      if(!my->eosvmoc) {
+         wlog("EOS VM OC precompilation requested but EOS VM OC tier-up is not enabled");
+         return;
+      }
+
+      const auto queued = my->eosvmoc->cc.queue_all_for_compile();
+      ilog("EOS VM OC precompiling ${n} contracts", ("n", queued));
+
+      const auto start = fc::time_point::now();
+      auto next_report = start + fc::seconds(5);
+      for(size_t pending = my->eosvmoc->cc.pending_compiles(); pending; pending = my->eosvmoc->cc.pending_compiles()) {
+         if(shutdown())
+            return;
+         if(fc::time_point::now() >= next_report) {
+            ilog("EOS VM OC precompiled ${d} of ${n} contracts", ("d", queued - std::min(queued, pending))("n", queued));
+            next_report += fc::seconds(5);
+         }
+         std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      }
+      //everything deployed is now compiled, so tier-up thresholds would only keep contracts off code that is already there
+      my->eosvmoc_precompiled = true;
+      ilog("EOS VM OC precompilation finished in ${t} ms", ("t", (fc::time_point::now() - start).count() / 1000));
+#else
+      wlog("EOS VM OC precompilation requested but EOS VM OC is not available in this build");
+#endif
+   }
+
+   wasm_interface::cache_stats wasm_interface::get_cache_stats()const {
+      auto stats = my->stats;
+      stats.instantiated_bytes = my->instantiated_bytes;
+      return stats;
+   }
+
    void wasm_interface::apply( const digest_type& code_hash, const uint8_t& vm_type, const uint8_t& vm_version, apply_context& context ) {
 #ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
-      if(my->eosvmoc) {
+      if(my->eosvmoc && my->is_tierup_eligible(code_hash, vm_type, vm_version)) {
          const chain::eosvmoc::code_descriptor* cd = nullptr;
          try {
             cd = my->eosvmoc->cc.get_descriptor_for_code(code_hash, vm_version);
@@ -93,6 +132,17 @@ namespace eosio { namespace chain {
             return;
          }
       }
+#endif
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+      if(my->eosvmoc) {
+         const auto& module = my->get_instantiated_module(code_hash, vm_type, vm_version, context.trx_context);
+         const auto start = fc::time_point::now();
+         auto record = fc::make_scoped_exit([&](){
+            my->record_baseline_execution(code_hash, vm_type, vm_version, fc::time_point::now() - start);
+         });
+         module->apply(context);
+         return;
+      }
 #endif
       my->get_instantiated_module(code_hash, vm_type, vm_version, context.trx_context)->apply(context);
    }
@@ -113,6 +163,7 @@ class context_aware_api {
       context_aware_api(apply_context& ctx, bool context_free = false )
       :context(ctx)
       {
+         ++context.intrinsic_calls;
          if( context.is_context_free() )
             EOS_ASSERT( context_free, unaccessible_api, "only context free api's can be used in this context" );
       }
@@ -174,6 +225,7 @@ class privileged_api : public context_aware_api {
        *  Also fails if the feature was already activated or pre-activated.
        */
       void preactivate_feature( const digest_type& feature_digest ) {
+         context.check_writes_allowed();
          context.control.preactivate_feature( feature_digest );
       }
 
@@ -187,6 +239,7 @@ class privileged_api : public context_aware_api {
        * @param cpu_weight - the weight for determining share of compute capacity
        */
       void set_resource_limits( account_name account, int64_t ram_bytes, int64_t net_weight, int64_t cpu_weight) {
+         context.check_writes_allowed();
          EOS_ASSERT(ram_bytes >= -1, wasm_execution_error, "invalid value for ram resource limit expected [-1,INT64_MAX]");
          EOS_ASSERT(net_weight >= -1, wasm_execution_error, "invalid value for net resource weight expected [-1,INT64_MAX]");
          EOS_ASSERT(cpu_weight >= -1, wasm_execution_error, "invalid value for cpu resource weight expected [-1,INT64_MAX]");
@@ -200,6 +253,7 @@ class privileged_api : public context_aware_api {
       }
 
       int64_t set_proposed_producers_common( vector<producer_authority> && producers, bool validate_keys ) {
+         context.check_writes_allowed();
          EOS_ASSERT(producers.size() <= config::max_producers, wasm_execution_error, "Producer schedule exceeds the maximum producer count for this chain");
          EOS_ASSERT( producers.size() > 0
                      || !context.control.is_builtin_activated( builtin_protocol_feature_t::disallow_empty_producer_schedule ),
@@ -293,6 +347,7 @@ class privileged_api : public context_aware_api {
       }
 
       void set_blockchain_parameters_packed( array_ptr<char> packed_blockchain_parameters, uint32_t datalen) {
+         context.check_writes_allowed();
          datastream<const char*> ds( packed_blockchain_parameters, datalen );
          chain::chain_config cfg;
          fc::raw::unpack(ds, cfg);
@@ -308,6 +363,7 @@ class privileged_api : public context_aware_api {
       }
 
       void set_privileged( account_name n, bool is_priv ) {
+         context.check_writes_allowed();
          const auto& a = context.db.get<account_metadata_object, by_name>( n );
          context.db.modify( a, [&]( auto& ma ){
             ma.set_privileged( is_priv );
@@ -326,19 +382,19 @@ class softfloat_api : public context_aware_api {
 #pragma GCC diagnostic ignored "-Wstrict-aliasing"
       // float binops
       float _eosio_f32_add( float a, float b ) {
-         float32_t ret = ::f32_add( to_softfloat32(a), to_softfloat32(b) );
+         float32_t ret = hardware_float::f32_add( to_softfloat32(a), to_softfloat32(b) );
          return *reinterpret_cast<float*>(&ret);
       }
       float _eosio_f32_sub( float a, float b ) {
-         float32_t ret = ::f32_sub( to_softfloat32(a), to_softfloat32(b) );
+         float32_t ret = hardware_float::f32_sub( to_softfloat32(a), to_softfloat32(b) );
          return *reinterpret_cast<float*>(&ret);
       }
       float _eosio_f32_div( float a, float b ) {
-         float32_t ret = ::f32_div( to_softfloat32(a), to_softfloat32(b) );
+         float32_t ret = hardware_float::f32_div( to_softfloat32(a), to_softfloat32(b) );
          return *reinterpret_cast<float*>(&ret);
       }
       float _eosio_f32_mul( float a, float b ) {
-         float32_t ret = ::f32_mul( to_softfloat32(a), to_softfloat32(b) );
+         float32_t ret = hardware_float::f32_mul( to_softfloat32(a), to_softfloat32(b) );
          return *reinterpret_cast<float*>(&ret);
       }
 #pragma GCC diagnostic pop
@@ -392,7 +448,7 @@ class softfloat_api : public context_aware_api {
          return from_softfloat32(a);
       }
       float _eosio_f32_sqrt( float a ) {
-         float32_t ret = ::f32_sqrt( to_softfloat32(a) );
+         float32_t ret = hardware_float::f32_sqrt( to_softfloat32(a) );
          return from_softfloat32(ret);
       }
       // ceil, floor, trunc and nearest are lifted from libc
@@ -495,19 +551,19 @@ class softfloat_api : public context_aware_api {
 
       // double binops
       double _eosio_f64_add( double a, double b ) {
-         float64_t ret = ::f64_add( to_softfloat64(a), to_softfloat64(b) );
+         float64_t ret = hardware_float::f64_add( to_softfloat64(a), to_softfloat64(b) );
          return from_softfloat64(ret);
       }
       double _eosio_f64_sub( double a, double b ) {
-         float64_t ret = ::f64_sub( to_softfloat64(a), to_softfloat64(b) );
+         float64_t ret = hardware_float::f64_sub( to_softfloat64(a), to_softfloat64(b) );
          return from_softfloat64(ret);
       }
       double _eosio_f64_div( double a, double b ) {
-         float64_t ret = ::f64_div( to_softfloat64(a), to_softfloat64(b) );
+         float64_t ret = hardware_float::f64_div( to_softfloat64(a), to_softfloat64(b) );
          return from_softfloat64(ret);
       }
       double _eosio_f64_mul( double a, double b ) {
-         float64_t ret = ::f64_mul( to_softfloat64(a), to_softfloat64(b) );
+         float64_t ret = hardware_float::f64_mul( to_softfloat64(a), to_softfloat64(b) );
          return from_softfloat64(ret);
       }
       double _eosio_f64_min( double af, double bf ) {
@@ -555,7 +611,7 @@ class softfloat_api : public context_aware_api {
          return from_softfloat64(a);
       }
       double _eosio_f64_sqrt( double a ) {
-         float64_t ret = ::f64_sqrt( to_softfloat64(a) );
+         float64_t ret = hardware_float::f64_sqrt( to_softfloat64(a) );
          return from_softfloat64(ret);
       }
       // ceil, floor, trunc and nearest are lifted from libc
@@ -665,10 +721,10 @@ class softfloat_api : public context_aware_api {
 
       // float and double conversions
       double _eosio_f32_promote( float a ) {
-         return from_softfloat64(f32_to_f64( to_softfloat32(a)) );
+         return from_softfloat64(hardware_float::f32_to_f64( to_softfloat32(a)) );
       }
       float _eosio_f64_demote( double a ) {
-         return from_softfloat32(f64_to_f32( to_softfloat64(a)) );
+         return from_softfloat32(hardware_float::f64_to_f32( to_softfloat64(a)) );
       }
       int32_t _eosio_f32_trunc_i32s( float af ) {
          float32_t a = to_softfloat32(af);
@@ -737,25 +793,25 @@ class softfloat_api : public context_aware_api {
          return f64_to_ui64( to_softfloat64(_eosio_f64_trunc( af )), 0, false );
       }
       float _eosio_i32_to_f32( int32_t a )  {
-         return from_softfloat32(i32_to_f32( a ));
+         return from_softfloat32(hardware_float::i32_to_f32( a ));
       }
       float _eosio_i64_to_f32( int64_t a ) {
-         return from_softfloat32(i64_to_f32( a ));
+         return from_softfloat32(hardware_float::i64_to_f32( a ));
       }
       float _eosio_ui32_to_f32( uint32_t a ) {
-         return from_softfloat32(ui32_to_f32( a ));
+         return from_softfloat32(hardware_float::ui32_to_f32( a ));
       }
       float _eosio_ui64_to_f32( uint64_t a ) {
          return from_softfloat32(ui64_to_f32( a ));
       }
       double _eosio_i32_to_f64( int32_t a ) {
-         return from_softfloat64(i32_to_f64( a ));
+         return from_softfloat64(hardware_float::i32_to_f64( a ));
       }
       double _eosio_i64_to_f64( int64_t a ) {
-         return from_softfloat64(i64_to_f64( a ));
+         return from_softfloat64(hardware_float::i64_to_f64( a ));
       }
       double _eosio_ui32_to_f64( uint32_t a ) {
-         return from_softfloat64(ui32_to_f64( a ));
+         return from_softfloat64(hardware_float::ui32_to_f64( a ));
       }
       double _eosio_ui64_to_f64( uint64_t a ) {
          return from_softfloat64(ui64_to_f64( a ));
@@ -821,7 +877,7 @@ class crypto_api : public context_aware_api {
             EOS_ASSERT(s.variable_size() <= context.control.configured_subjective_signature_length_limit(),
                        sig_variable_size_limit_exception, "signature variable length component size greater than subjective maximum");
 
-         auto check = fc::crypto::public_key( s, digest, false );
+         auto check = recovered_key_cache::recover( s, digest, false );
          EOS_ASSERT( check == p, crypto_api_exception, "Error expected key different than recovered key" );
       }
 
@@ -840,7 +896,7 @@ class crypto_api : public context_aware_api {
                        sig_variable_size_limit_exception, "signature variable length component size greater than subjective maximum");
 
 
-         auto recovered = fc::crypto::public_key(s, digest, false);
+         auto recovered = recovered_key_cache::recover(s, digest, false);
 
          // the key types newer than the first 2 may be varible in length
          if (s.which() >= config::genesis_num_supported_key_types ) {
@@ -1151,23 +1207,19 @@ class console_api : public context_aware_api {
 
       void prints_l(array_ptr<const char> str, uint32_t str_len ) {
          if ( !ignore ) {
-            context.console_append(string(str, str_len));
+            context.console_append( str, str_len );
          }
       }
 
       void printi(int64_t val) {
          if ( !ignore ) {
-            std::ostringstream oss;
-            oss << val;
-            context.console_append( oss.str() );
+            context.console_append( std::to_string( val ) );
          }
       }
 
       void printui(uint64_t val) {
          if ( !ignore ) {
-            std::ostringstream oss;
-            oss << val;
-            context.console_append( oss.str() );
+            context.console_append( std::to_string( val ) );
          }
       }
 
@@ -1399,7 +1451,11 @@ class console_api : public context_aware_api {
 
 class database_api : public context_aware_api {
    public:
-      using context_aware_api::context_aware_api;
+      database_api( apply_context& ctx )
+      :context_aware_api(ctx)
+      {
+         ++context.db_ops;
+      }
 
       int db_store_i64( uint64_t scope, uint64_t table, uint64_t payer, uint64_t id, array_ptr<const char> buffer, uint32_t buffer_size ) {
          return context.db_store_i64( name(scope), name(table), account_name(payer), id, buffer, buffer_size );
@@ -1431,6 +1487,9 @@ class database_api : public context_aware_api {
       int db_end_i64( uint64_t code, uint64_t scope, uint64_t table ) {
          return context.db_end_i64( name(code), name(scope), name(table) );
       }
+      int db_read_range_i64( uint64_t code, uint64_t scope, uint64_t table, uint64_t lower_bound, uint32_t max_rows, array_ptr<char> buffer, uint32_t buffer_size ) {
+         return context.db_read_range_i64( name(code), name(scope), name(table), lower_bound, max_rows, buffer, buffer_size );
+      }
 
       DB_API_METHOD_WRAPPERS_SIMPLE_SECONDARY(idx64,  uint64_t)
       DB_API_METHOD_WRAPPERS_SIMPLE_SECONDARY(idx128, uint128_t)
@@ -1548,9 +1607,7 @@ class compiler_builtins : public context_aware_api {
       :context_aware_api(ctx,true){}
 
       void __ashlti3(__int128& ret, uint64_t low, uint64_t high, uint32_t shift) {
-         fc::uint128_t i(high, low);
-         i <<= shift;
-         ret = (unsigned __int128)i;
+         ret = builtins::shl( builtins::make_uint128(low, high), shift );
       }
 
       void __ashrti3(__int128& ret, uint64_t low, uint64_t high, uint32_t shift) {
@@ -1562,94 +1619,54 @@ class compiler_builtins : public context_aware_api {
       }
 
       void __lshlti3(__int128& ret, uint64_t low, uint64_t high, uint32_t shift) {
-         fc::uint128_t i(high, low);
-         i <<= shift;
-         ret = (unsigned __int128)i;
+         ret = builtins::shl( builtins::make_uint128(low, high), shift );
       }
 
       void __lshrti3(__int128& ret, uint64_t low, uint64_t high, uint32_t shift) {
-         fc::uint128_t i(high, low);
-         i >>= shift;
-         ret = (unsigned __int128)i;
+         ret = builtins::lshr( builtins::make_uint128(low, high), shift );
       }
 
       void __divti3(__int128& ret, uint64_t la, uint64_t ha, uint64_t lb, uint64_t hb) {
-         __int128 lhs = ha;
-         __int128 rhs = hb;
-
-         lhs <<= 64;
-         lhs |=  la;
-
-         rhs <<= 64;
-         rhs |=  lb;
+         __int128 lhs = builtins::make_int128(la, ha);
+         __int128 rhs = builtins::make_int128(lb, hb);
 
          EOS_ASSERT(rhs != 0, arithmetic_exception, "divide by zero");
 
-         lhs /= rhs;
-
-         ret = lhs;
+         ret = lhs / rhs;
       }
 
       void __udivti3(unsigned __int128& ret, uint64_t la, uint64_t ha, uint64_t lb, uint64_t hb) {
-         unsigned __int128 lhs = ha;
-         unsigned __int128 rhs = hb;
-
-         lhs <<= 64;
-         lhs |=  la;
-
-         rhs <<= 64;
-         rhs |=  lb;
+         unsigned __int128 lhs = builtins::make_uint128(la, ha);
+         unsigned __int128 rhs = builtins::make_uint128(lb, hb);
 
          EOS_ASSERT(rhs != 0, arithmetic_exception, "divide by zero");
 
-         lhs /= rhs;
-         ret = lhs;
+         ret = lhs / rhs;
       }
 
       void __multi3(__int128& ret, uint64_t la, uint64_t ha, uint64_t lb, uint64_t hb) {
-         __int128 lhs = ha;
-         __int128 rhs = hb;
-
-         lhs <<= 64;
-         lhs |=  la;
+         __int128 lhs = builtins::make_int128(la, ha);
+         __int128 rhs = builtins::make_int128(lb, hb);
 
-         rhs <<= 64;
-         rhs |=  lb;
-
-         lhs *= rhs;
-         ret = lhs;
+         ret = lhs * rhs;
       }
 
       void __modti3(__int128& ret, uint64_t la, uint64_t ha, uint64_t lb, uint64_t hb) {
-         __int128 lhs = ha;
-         __int128 rhs = hb;
-
-         lhs <<= 64;
-         lhs |=  la;
-
-         rhs <<= 64;
-         rhs |=  lb;
+         __int128 lhs = builtins::make_int128(la, ha);
+         __int128 rhs = builtins::make_int128(lb, hb);
 
          EOS_ASSERT(rhs != 0, arithmetic_exception, "divide by zero");
 
-         lhs %= rhs;
-         ret = lhs;
+         ret = lhs % rhs;
       }
 
       void __umodti3(unsigned __int128& ret, uint64_t la, uint64_t ha, uint64_t lb, uint64_t hb) {
-         unsigned __int128 lhs = ha;
-         unsigned __int128 rhs = hb;
-
-         lhs <<= 64;
-         lhs |=  la;
-
-         rhs <<= 64;
-         rhs |=  lb;
+         unsigned __int128 lhs = builtins::make_uint128(la, ha);
+         unsigned __int128 rhs = builtins::make_uint128(lb, hb);
 
          EOS_ASSERT(rhs != 0, arithmetic_exception, "divide by zero");
 
-         lhs %= rhs;
-         ret = lhs;
+         ret = lhs % rhs;
       }
 
       // arithmetic long double
@@ -1717,16 +1734,16 @@ class compiler_builtins : public context_aware_api {
          ret = ___fixunstfti( f );
       }
       void __fixsfti( __int128& ret, float a ) {
-         ret = ___fixsfti( to_softfloat32(a).v );
+         ret = builtins::fixsfti( to_softfloat32(a).v );
       }
       void __fixdfti( __int128& ret, double a ) {
-         ret = ___fixdfti( to_softfloat64(a).v );
+         ret = builtins::fixdfti( to_softfloat64(a).v );
       }
       void __fixunssfti( unsigned __int128& ret, float a ) {
-         ret = ___fixunssfti( to_softfloat32(a).v );
+         ret = builtins::fixunssfti( to_softfloat32(a).v );
       }
       void __fixunsdfti( unsigned __int128& ret, double a ) {
-         ret = ___fixunsdfti( to_softfloat64(a).v );
+         ret = builtins::fixunsdfti( to_softfloat64(a).v );
       }
       double __floatsidf( int32_t i ) {
          return from_softfloat64(i32_to_f64(i));
@@ -1744,13 +1761,10 @@ class compiler_builtins : public context_aware_api {
          ret = ui64_to_f128( a );
       }
       double __floattidf( uint64_t l, uint64_t h ) {
-         fc::uint128_t v(h, l);
-         unsigned __int128 val = (unsigned __int128)v;
-         return ___floattidf( *(__int128*)&val );
+         return builtins::floattidf( builtins::make_int128(l, h) );
       }
       double __floatuntidf( uint64_t l, uint64_t h ) {
-         fc::uint128_t v(h, l);
-         return ___floatuntidf( (unsigned __int128)v );
+         return builtins::floatuntidf( builtins::make_uint128(l, h) );
       }
       int ___cmptf2( uint64_t la, uint64_t ha, uint64_t lb, uint64_t hb, int return_value_if_nan ) {
          float128_t a = {{ la, ha }};
@@ -1915,6 +1929,7 @@ REGISTER_INTRINSICS( database_api,
    (db_lowerbound_i64,   int(int64_t,int64_t,int64_t,int64_t)         )
    (db_upperbound_i64,   int(int64_t,int64_t,int64_t,int64_t)         )
    (db_end_i64,          int(int64_t,int64_t,int64_t)                 )
+   (db_read_range_i64,   int(int64_t,int64_t,int64_t,int64_t,int,int,int) )
 
    DB_SECONDARY_INDEX_METHODS_SIMPLE(idx64)
    DB_SECONDARY_INDEX_METHODS_SIMPLE(idx128)
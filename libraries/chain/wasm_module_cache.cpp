@@ -0,0 +1,185 @@
+#include <eosio/chain/wasm_module_cache.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+
+namespace eosio { namespace chain {
+
+namespace detail {
+   struct wasm_module_cache_entry_header {
+      uint32_t    format     = 0;
+      uint8_t     runtime    = 0;
+      std::string build;
+      digest_type code_hash;
+      uint8_t     vm_type    = 0;
+      uint8_t     vm_version = 0;
+      digest_type digest; ///< sha256 of the packed entry that follows
+   };
+}
+
+} } // eosio::chain
+
+FC_REFLECT( eosio::chain::detail::wasm_module_cache_entry_header, (format)(runtime)(build)(code_hash)(vm_type)(vm_version)(digest) )
+
+namespace eosio { namespace chain {
+
+namespace bfs = boost::filesystem;
+
+wasm_module_cache::wasm_module_cache( const bfs::path& dir, uint8_t runtime, const std::string& build, uint64_t max_size )
+:dir(dir)
+,runtime(runtime)
+,build(build)
+,max_size(max_size)
+{
+   if( !bfs::exists( dir ) )
+      bfs::create_directories( dir );
+
+   for( auto& f : bfs::directory_iterator( dir ) ) {
+      boost::system::error_code ec;
+      if( f.path().extension() == ".bin" )
+         total_size += bfs::file_size( f.path(), ec );
+      else if( f.path().extension() == ".tmp" ) // left by a crash in put()
+         bfs::remove( f.path(), ec );
+   }
+   evict_over_size( bfs::path() );
+}
+
+bfs::path wasm_module_cache::entry_path( const digest_type& code_hash, uint8_t vm_type, uint8_t vm_version ) const {
+   return dir / (code_hash.str() + "-" + std::to_string(vm_type) + "-" + std::to_string(vm_version) + "-" + std::to_string(runtime) + ".bin");
+}
+
+fc::optional<wasm_module_cache::entry> wasm_module_cache::get( const digest_type& code_hash, uint8_t vm_type, uint8_t vm_version ) const {
+   const auto p = entry_path( code_hash, vm_type, vm_version );
+   if( !bfs::exists( p ) )
+      return {};
+
+   try {
+      std::ifstream in( p.generic_string(), std::ios::in | std::ios::binary );
+      std::vector<char> contents( (std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>() );
+
+      fc::datastream<const char*> ds( contents.data(), contents.size() );
+      detail::wasm_module_cache_entry_header header;
+      fc::raw::unpack( ds, header );
+
+      if( header.format == current_format && header.runtime == runtime && header.build == build && header.code_hash == code_hash &&
+          header.vm_type == vm_type && header.vm_version == vm_version ) {
+         const auto offset = ds.tellp();
+         if( digest_type::hash( contents.data() + offset, contents.size() - offset ) == header.digest ) {
+            entry e;
+            fc::raw::unpack( ds, e );
+            // the modification time orders the entries for evict_over_size
+            boost::system::error_code ec;
+            bfs::last_write_time( p, std::time( nullptr ), ec );
+            return e;
+         }
+      }
+   } catch( const fc::exception& e ) {
+      wlog( "discarding unreadable wasm module cache entry ${p}: ${e}", ("p", p.generic_string())("e", e.to_detail_string()) );
+   }
+
+   remove_entry( p );
+   return {};
+}
+
+void wasm_module_cache::put( const digest_type& code_hash, uint8_t vm_type, uint8_t vm_version, const entry& e ) {
+   const auto packed = fc::raw::pack( e );
+
+   detail::wasm_module_cache_entry_header header;
+   header.format     = current_format;
+   header.runtime    = runtime;
+   header.build      = build;
+   header.code_hash  = code_hash;
+   header.vm_type    = vm_type;
+   header.vm_version = vm_version;
+   header.digest     = digest_type::hash( packed.data(), packed.size() );
+   const auto packed_header = fc::raw::pack( header );
+
+   // write to a temporary and rename so a crash never leaves a partial entry behind
+   const auto p = entry_path( code_hash, vm_type, vm_version );
+   auto tmp = p;
+   tmp += ".tmp";
+   {
+      std::ofstream out( tmp.generic_string(), std::ios::out | std::ios::binary | std::ios::trunc );
+      out.write( packed_header.data(), packed_header.size() );
+      out.write( packed.data(), packed.size() );
+      if( !out ) {
+         wlog( "unable to write wasm module cache entry ${p}", ("p", tmp.generic_string()) );
+         return;
+      }
+   }
+
+   boost::system::error_code ec;
+   const uint64_t replaced = bfs::exists( p ) ? bfs::file_size( p, ec ) : 0;
+   bfs::rename( tmp, p, ec );
+   if( ec ) {
+      wlog( "unable to write wasm module cache entry ${p}: ${m}", ("p", p.generic_string())("m", ec.message()) );
+      bfs::remove( tmp, ec );
+      return;
+   }
+   total_size += packed_header.size() + packed.size();
+   total_size -= std::min( total_size, replaced );
+   evict_over_size( p );
+}
+
+void wasm_module_cache::prune( const referenced_callback& referenced ) {
+   std::vector<bfs::path> unreferenced;
+   for( auto& f : bfs::directory_iterator( dir ) ) {
+      if( f.path().extension() != ".bin" )
+         continue;
+      // named by entry_path as <code hash>-<vm type>-<vm version>-<runtime>
+      const auto name = f.path().stem().string();
+      std::vector<std::string> parts;
+      for( size_t pos = 0, next = 0; next != std::string::npos; pos = next + 1 ) {
+         next = name.find( '-', pos );
+         parts.emplace_back( name.substr( pos, next == std::string::npos ? std::string::npos : next - pos ) );
+      }
+      bool keep = false;
+      try {
+         if( parts.size() == 4 && parts[0].size() == 2 * sizeof(digest_type) ) {
+            const digest_type code_hash( parts[0] );
+            const auto vm_type = std::stoul( parts[1] ), vm_version = std::stoul( parts[2] );
+            keep = vm_type <= UINT8_MAX && vm_version <= UINT8_MAX && referenced( code_hash, vm_type, vm_version );
+         }
+      } catch( ... ) {
+      }
+      if( !keep )
+         unreferenced.emplace_back( f.path() );
+   }
+
+   for( const auto& p : unreferenced )
+      remove_entry( p );
+   if( !unreferenced.empty() )
+      ilog( "removed ${n} wasm module cache entries of codes no longer in use, ${s} bytes remain",
+            ("n", unreferenced.size())("s", total_size) );
+}
+
+void wasm_module_cache::remove_entry( const bfs::path& p ) {
+   boost::system::error_code ec;
+   const uint64_t size = bfs::file_size( p, ec );
+   if( !ec && bfs::remove( p, ec ) )
+      total_size -= std::min( total_size, size );
+}
+
+void wasm_module_cache::evict_over_size( const bfs::path& keep ) {
+   if( max_size == 0 || total_size <= max_size )
+      return;
+
+   std::vector<std::pair<std::time_t, bfs::path>> entries;
+   for( auto& f : bfs::directory_iterator( dir ) ) {
+      boost::system::error_code ec;
+      if( f.path().extension() == ".bin" && f.path() != keep )
+         entries.emplace_back( bfs::last_write_time( f.path(), ec ), f.path() );
+   }
+   std::sort( entries.begin(), entries.end() );
+
+   size_t evicted = 0;
+   for( auto it = entries.begin(); it != entries.end() && total_size > max_size; ++it, ++evicted )
+      remove_entry( it->second );
+   dlog( "evicted ${n} wasm module cache entries over ${m} bytes", ("n", evicted)("m", max_size) );
+}
+
+} } // eosio::chain
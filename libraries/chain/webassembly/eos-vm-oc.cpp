@@ -36,7 +36,7 @@ class eosvmoc_instantiated_module : public wasm_instantiated_module_interface {
 };
 
 eosvmoc_runtime::eosvmoc_runtime(const boost::filesystem::path data_dir, const eosvmoc::config& eosvmoc_config, const chainbase::database& db)
-   : cc(data_dir, eosvmoc_config, db), exec(cc) {
+   : cc(data_dir, eosvmoc_config, db), exec(cc), mem(eosvmoc_config.execution_threads + 1, eosvmoc_config.transparent_huge_pages) {
 }
 
 eosvmoc_runtime::~eosvmoc_runtime() {
@@ -12,8 +12,12 @@
 #include <unistd.h>
 #include <sys/syscall.h>
 #include <sys/mman.h>
+#include <sys/file.h>
 #include <linux/memfd.h>
 
+#include <algorithm>
+#include <fstream>
+
 #include "IR/Module.h"
 #include "IR/Validate.h"
 #include "WASM/WASM.h"
@@ -27,7 +31,7 @@ namespace eosio { namespace chain { namespace eosvmoc {
 static constexpr size_t header_offset = 512u;
 static constexpr size_t header_size = 512u;
 static constexpr size_t total_header_size = header_offset + header_size;
-static constexpr uint64_t header_id = 0x32434f4d56534f45ULL; //"EOSVMOC2" little endian
+static constexpr uint64_t header_id = 0x33434f4d56534f45ULL; //"EOSVMOC3" little endian
 
 struct code_cache_header {
    uint64_t id = header_id;
@@ -42,10 +46,13 @@ static_assert(sizeof(code_cache_header) <= header_size, "code_cache_header too b
 code_cache_async::code_cache_async(const bfs::path data_dir, const eosvmoc::config& eosvmoc_config, const chainbase::database& db) :
    code_cache_base(data_dir, eosvmoc_config, db),
    _result_queue(eosvmoc_config.threads * 2),
-   _threads(eosvmoc_config.threads)
+   _threads(eosvmoc_config.threads),
+   _demand_file_path(data_dir/"code_demand.bin")
 {
    FC_ASSERT(_threads, "EOS VM OC requires at least 1 compile thread");
 
+   load_demand();
+
    wait_on_compile_monitor_message();
 
    _monitor_reply_thread = std::thread([this]() {
@@ -58,6 +65,71 @@ code_cache_async::~code_cache_async() {
    _compile_monitor_write_socket.shutdown(local::datagram_protocol::socket::shutdown_send);
    _monitor_reply_thread.join();
    consume_compile_thread_queue();
+   save_demand();
+}
+
+void code_cache_async::load_demand() {
+   if(!bfs::exists(_demand_file_path))
+      return;
+   try {
+      std::ifstream in(_demand_file_path.generic_string(), std::ios::in | std::ios::binary);
+      std::vector<char> contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+      fc::datastream<const char*> ds(contents.data(), contents.size());
+      std::vector<std::pair<code_tuple, code_demand>> demand;
+      fc::raw::unpack(ds, demand);
+      _demand.insert(demand.begin(), demand.end());
+   } catch(const fc::exception& e) {
+      wlog("discarding unreadable EOS VM OC demand file ${p}: ${e}", ("p", _demand_file_path.generic_string())("e", e.to_detail_string()));
+      _demand.clear();
+   }
+}
+
+void code_cache_async::save_demand() const {
+   const auto packed = fc::raw::pack(std::vector<std::pair<code_tuple, code_demand>>(_demand.begin(), _demand.end()));
+   //write to a temporary and rename so a crash never leaves a partial file behind
+   auto tmp = _demand_file_path;
+   tmp += ".tmp";
+   {
+      std::ofstream out(tmp.generic_string(), std::ios::out | std::ios::binary | std::ios::trunc);
+      out.write(packed.data(), packed.size());
+      if(!out) {
+         wlog("unable to write EOS VM OC demand file ${p}", ("p", tmp.generic_string()));
+         return;
+      }
+   }
+   boost::system::error_code ec;
+   bfs::rename(tmp, _demand_file_path, ec);
+   if(ec)
+      wlog("unable to write EOS VM OC demand file ${p}: ${e}", ("p", _demand_file_path.generic_string())("e", ec.message()));
+}
+
+void code_cache_async::record_demand(const digest_type& code_id, const uint8_t& vm_version, const fc::microseconds& baseline_time) {
+   code_demand& d = _demand[code_tuple{code_id, vm_version}];
+   ++d.executions;
+   d.baseline_us += std::max<int64_t>(baseline_time.count(), 0);
+}
+
+uint64_t code_cache_async::demand_score(const code_tuple& ct) const {
+   const auto it = _demand.find(ct);
+   return it == _demand.end() ? 0 : it->second.score();
+}
+
+void code_cache_async::start_queued_compiles(size_t slots) {
+   while(slots && _queued_compiles.size()) {
+      //the queue is at most the deployed contracts and a compile takes far longer than this scan
+      auto nextup = std::max_element(_queued_compiles.begin(), _queued_compiles.end(), [this](const code_tuple& a, const code_tuple& b) {
+         return demand_score(a) < demand_score(b);
+      });
+
+      //it's not clear this check is required: if apply() was called for code then it existed in the code_index; and then
+      // if we got notification of it no longer existing we would have removed it from queued_compiles
+      const code_object* const codeobject = _db.find<code_object,by_code_hash>(boost::make_tuple(nextup->code_id, 0, nextup->vm_version));
+      if(codeobject) {
+         start_compile(*nextup, *codeobject);
+         --slots;
+      }
+      _queued_compiles.erase(nextup);
+   }
 }
 
 //remember again: wait_on_compile_monitor_message's callback is non-main thread!
@@ -106,30 +178,52 @@ std::tuple<size_t, size_t> code_cache_async::consume_compile_thread_queue() {
    return {gotsome, bytes_remaining};
 }
 
+void code_cache_async::start_compile(const code_tuple& ct, const code_object& codeobject) {
+   _outstanding_compiles_and_poison.emplace(ct, false);
+   std::vector<wrapped_fd> fds_to_pass;
+   fds_to_pass.emplace_back(memfd_for_bytearray(codeobject.code));
+   FC_ASSERT(write_message_with_fds(_compile_monitor_write_socket, compile_wasm_message{ ct }, fds_to_pass), "EOS VM failed to communicate to OOP manager");
+}
+
+void code_cache_async::process_compile_results() {
+   if(!_outstanding_compiles_and_poison.size())
+      return;
+
+   auto [count_processed, bytes_remaining] = consume_compile_thread_queue();
+
+   if(count_processed)
+      check_eviction_threshold(bytes_remaining);
+
+   start_queued_compiles(count_processed);
+}
+
+size_t code_cache_async::queue_all_for_compile() {
+   size_t queued = 0;
+   const auto& idx = _db.get_index<code_index, by_code_hash>();
+   for(const code_object& codeobject : idx) {
+      if(codeobject.vm_type != 0)
+         continue;
+      const code_tuple ct = code_tuple{codeobject.code_hash, codeobject.vm_version};
+      if(_cache_index.get<by_hash>().find(boost::make_tuple(ct.code_id, ct.vm_version)) != _cache_index.get<by_hash>().end() ||
+         _blacklist.count(ct) || _outstanding_compiles_and_poison.count(ct) || _queued_compiles.count(ct))
+         continue;
+
+      _queued_compiles.emplace(ct);
+      ++queued;
+   }
+   //queue everything before starting any, so that the most demanded code is compiled first
+   start_queued_compiles(_threads - std::min(_threads, _outstanding_compiles_and_poison.size()));
+   return queued;
+}
+
+size_t code_cache_async::pending_compiles() {
+   process_compile_results();
+   return _outstanding_compiles_and_poison.size() + _queued_compiles.size();
+}
+
 const code_descriptor* const code_cache_async::get_descriptor_for_code(const digest_type& code_id, const uint8_t& vm_version) {
    //if there are any outstanding compiles, process the result queue now
-   if(_outstanding_compiles_and_poison.size()) {
-      auto [count_processed, bytes_remaining] = consume_compile_thread_queue();
-
-      if(count_processed)
-         check_eviction_threshold(bytes_remaining);
-
-      while(count_processed && _queued_compiles.size()) {
-         auto nextup = _queued_compiles.begin();
-
-         //it's not clear this check is required: if apply() was called for code then it existed in the code_index; and then
-         // if we got notification of it no longer existing we would have removed it from queued_compiles
-         const code_object* const codeobject = _db.find<code_object,by_code_hash>(boost::make_tuple(nextup->code_id, 0, nextup->vm_version));
-         if(codeobject) {
-            _outstanding_compiles_and_poison.emplace(*nextup, false);
-            std::vector<wrapped_fd> fds_to_pass;
-            fds_to_pass.emplace_back(memfd_for_bytearray(codeobject->code));
-            FC_ASSERT(write_message_with_fds(_compile_monitor_write_socket, compile_wasm_message{ *nextup }, fds_to_pass), "EOS VM failed to communicate to OOP manager");
-            --count_processed;
-         }
-         _queued_compiles.erase(nextup);
-      }
-   }
+   process_compile_results();
 
    //check for entry in cache
    code_cache_index::index<by_hash>::type::iterator it = _cache_index.get<by_hash>().find(boost::make_tuple(code_id, vm_version));
@@ -158,10 +252,7 @@ const code_descriptor* const code_cache_async::get_descriptor_for_code(const dig
    if(!codeobject) //should be impossible right?
       return nullptr;
 
-   _outstanding_compiles_and_poison.emplace(ct, false);
-   std::vector<wrapped_fd> fds_to_pass;
-   fds_to_pass.emplace_back(memfd_for_bytearray(codeobject->code));
-   write_message_with_fds(_compile_monitor_write_socket, compile_wasm_message{ ct }, fds_to_pass);
+   start_compile(ct, *codeobject);
    return nullptr;
 }
 
@@ -210,6 +301,13 @@ code_cache_base::code_cache_base(const boost::filesystem::path data_dir, const e
 
    bfs::create_directories(data_dir);
 
+   //the cache index lives in this process and the allocator is not process shared, so only one nodeos may use a cache file
+   const bfs::path lock_file_path = data_dir/"code_cache.lock";
+   _cache_lock_fd = wrapped_fd(::open(lock_file_path.generic_string().c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644));
+   EOS_ASSERT(_cache_lock_fd >= 0, database_exception, "failure to open code cache lock file ${f}", ("f", lock_file_path.generic_string()));
+   EOS_ASSERT(flock(_cache_lock_fd, LOCK_EX | LOCK_NB) == 0, database_exception,
+              "EOS VM OC code cache ${f} is in use by another process", ("f", _cache_file_path.generic_string()));
+
    if(!bfs::exists(_cache_file_path)) {
       EOS_ASSERT(eosvmoc_config.cache_size >= allocator_t::get_min_size(total_header_size), database_exception, "configured code cache size is too small");
       std::ofstream ofs(_cache_file_path.generic_string(), std::ofstream::trunc);
@@ -148,7 +148,9 @@ struct compile_monitor_session {
                      result.starting_memory_pages,
                      (uintptr_t)mem_ptr - (uintptr_t)_code_mapping,
                      (unsigned)get_size_of_fd(fds[1]),
-                     result.initdata_prologue_size
+                     result.initdata_prologue_size,
+                     (uintptr_t)code_ptr - (uintptr_t)_code_mapping + result.function_offsets_begin,
+                     result.function_offsets_count
                   };
                }
             }
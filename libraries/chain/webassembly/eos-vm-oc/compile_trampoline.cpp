@@ -8,6 +8,8 @@
 #include <signal.h>
 #include <sys/resource.h>
 
+#include <algorithm>
+
 #include "IR/Module.h"
 #include "IR/Validate.h"
 #include "WASM/WASM.h"
@@ -124,6 +126,18 @@ void run_compile(wrapped_fd&& response_sock, wrapped_fd&& wasm_code) noexcept {
       memcpy(initial_mem.data() + base_offset, data_segment.data.data(), data_segment.data.size());
    }
 
+   //the sampling profiler maps instruction pointers to functions with this table, appended aligned to the code
+   std::vector<function_offset> offsets;
+   for(const auto& [def_index, offset] : function_to_offsets)
+      offsets.push_back(function_offset{(uint32_t)offset, def_index});
+   std::sort(offsets.begin(), offsets.end(), [](const function_offset& a, const function_offset& b) {
+      return a.code_offset < b.code_offset;
+   });
+   code.code.resize((code.code.size() + alignof(function_offset) - 1) / alignof(function_offset) * alignof(function_offset));
+   result_message.function_offsets_begin = code.code.size();
+   result_message.function_offsets_count = offsets.size();
+   code.code.insert(code.code.end(), (const uint8_t*)offsets.data(), (const uint8_t*)(offsets.data() + offsets.size()));
+
    result_message.initdata_prologue_size = prologue.end() - prologue_it;
    std::vector<uint8_t> initdata_prep;
    std::move(prologue_it, prologue.end(), std::back_inserter(initdata_prep));
@@ -4,6 +4,7 @@
 #include <eosio/chain/webassembly/eos-vm-oc/intrinsic_mapping.hpp>
 #include <eosio/chain/webassembly/eos-vm-oc/intrinsic.hpp>
 #include <eosio/chain/webassembly/eos-vm-oc/eos-vm-oc.h>
+#include <eosio/chain/webassembly/eos-vm-oc/sampling_profiler.hpp>
 #include <eosio/chain/wasm_eosio_constraints.hpp>
 #include <eosio/chain/apply_context.hpp>
 #include <eosio/chain/transaction_context.hpp>
@@ -28,8 +29,6 @@ extern "C" int arch_prctl(int code, unsigned long* addr);
 
 namespace eosio { namespace chain { namespace eosvmoc {
 
-static constexpr auto signal_sentinel = 0x4D56534F45534559ul;
-
 static void(*chained_handler)(int,siginfo_t*,void*);
 static void segv_handler(int sig, siginfo_t* info, void* ctx)  {
    control_block* cb_in_main_segment;
@@ -147,17 +146,19 @@ executor::executor(const code_cache_base& cc) {
    mapping_is_executable = true;
 }
 
-void executor::execute(const code_descriptor& code, const memory& mem, apply_context& context) {
+void executor::execute(const code_descriptor& code, memory_pool& pool, apply_context& context) {
    if(mapping_is_executable == false) {
       mprotect(code_mapping, code_mapping_size, PROT_EXEC|PROT_READ);
       mapping_is_executable = true;
    }
 
+   //the pool only hands out slabs with zeroed linear memory, so the starting pages need no clearing here
+   memory& mem = pool.acquire();
+   auto release_mem = fc::make_scoped_exit([&pool, &mem](){ pool.release(mem); });
+
    //prepare initial memory, mutable globals, and table data
-   if(code.starting_memory_pages > 0 ) {
+   if(code.starting_memory_pages > 0 )
       arch_prctl(ARCH_SET_GS, (unsigned long*)(mem.zero_page_memory_base()+code.starting_memory_pages*memory::stride));
-      memset(mem.full_page_memory_base(), 0, 64u*1024u*code.starting_memory_pages);
-   }
    else
       arch_prctl(ARCH_SET_GS, (unsigned long*)mem.zero_page_memory_base());
    memcpy(mem.full_page_memory_base() - code.initdata_prologue_size, code_mapping + code.initdata_begin, code.initdata_size);
@@ -173,11 +174,20 @@ void executor::execute(const code_descriptor& code, const memory& mem, apply_con
    cb->eptr = &executors_exception_ptr;
    cb->current_call_depth_remaining = eosio::chain::wasm_constraints::maximum_call_depth+2;
    cb->current_linear_memory_pages = code.starting_memory_pages;
+   cb->max_linear_memory_pages = std::max(code.starting_memory_pages, 0);
    cb->first_invalid_memory_address = code.starting_memory_pages*64*1024;
    cb->full_linear_memory_start = (char*)mem.full_page_memory_base();
    cb->jmp = &executors_sigjmp_buf;
    cb->bounce_buffers = &executors_bounce_buffers;
    cb->running_code_base = (uintptr_t)(code_mapping + code.code_begin);
+   cb->profile_samples = nullptr;
+   profile_samples* const samples = sampling_profiler::running() ? sampling_buffer() : nullptr;
+   if(samples) {
+      samples->owner = pthread_self();
+      samples->count = 0;
+      samples->dropped = 0;
+      cb->profile_samples = samples;
+   }
    cb->is_running = true;
 
    context.trx_context.transaction_timer.set_expiration_callback([](void* user) {
@@ -187,10 +197,16 @@ void executor::execute(const code_descriptor& code, const memory& mem, apply_con
    }, this);
    context.trx_context.checktime(); //catch any expiration that might have occurred before setting up callback
 
-   auto cleanup = fc::make_scoped_exit([cb, &tt=context.trx_context.transaction_timer](){
+   auto cleanup = fc::make_scoped_exit([this, cb, samples, &code, &context, &tt=context.trx_context.transaction_timer](){
       cb->is_running = false;
+      cb->profile_samples = nullptr;
       cb->bounce_buffers->clear();
       tt.set_expiration_callback(nullptr, nullptr);
+      if(samples && samples->count) {
+         try {
+            sampling_profiler::record(code, code_mapping, code_mapping_size, *samples, context);
+         } catch(...) {} //samples are not worth failing the execution over
+      }
    });
 
    void(*apply_func)(uint64_t, uint64_t, uint64_t) = (void(*)(uint64_t, uint64_t, uint64_t))(cb->running_code_base + code.apply_offset);
@@ -223,8 +239,39 @@ void executor::execute(const code_descriptor& code, const memory& mem, apply_con
    }
 }
 
+profile_samples* executor::sampling_buffer() {
+   if(!executors_profile_samples)
+      executors_profile_samples = std::make_unique<profile_samples>();
+   return executors_profile_samples.get();
+}
+
 executor::~executor() {
    arch_prctl(ARCH_SET_GS, nullptr);
 }
 
+executor_pool::executor_pool(const code_cache_base& cc) : _cc(cc) {}
+
+executor_pool::~executor_pool() {}
+
+executor& executor_pool::executor_for_this_thread() {
+   std::lock_guard<std::mutex> g(_mtx);
+   auto& exec = _executors[std::this_thread::get_id()];
+   if(!exec)
+      exec = std::make_unique<executor>(_cc);
+   return *exec;
+}
+
+void executor_pool::execute(const code_descriptor& code, memory_pool& pool, apply_context& context) {
+   executor& exec = executor_for_this_thread();
+   //the slab moves on to other threads once released, so this thread must not be left pointing in to it; a fault on
+   //this thread would otherwise be taken for one of the thread now executing on the slab
+   auto reset_gs = fc::make_scoped_exit([](){ arch_prctl(ARCH_SET_GS, nullptr); });
+   exec.execute(code, pool, context);
+}
+
+size_t executor_pool::size() const {
+   std::lock_guard<std::mutex> g(_mtx);
+   return _executors.size();
+}
+
 }}}
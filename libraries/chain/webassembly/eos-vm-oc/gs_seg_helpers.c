@@ -24,8 +24,15 @@ int32_t eos_vm_oc_grow_memory(int32_t grow, int32_t max) {
    cb_ptr->current_linear_memory_pages += grow_amount;
    cb_ptr->first_invalid_memory_address += grow_amount*64*1024;
 
-   if(grow_amount > 0)
-      memset(cb_ptr->full_linear_memory_start + previous_page_count*64u*1024u, 0, grow_amount*64u*1024u);
+   //pages at or past the high water mark are still zero from the memory pool, only those below it need clearing
+   if(grow_amount > 0) {
+      uint64_t new_page_count = previous_page_count + grow_amount;
+      uint64_t dirty_end = new_page_count < (uint64_t)cb_ptr->max_linear_memory_pages ? new_page_count : (uint64_t)cb_ptr->max_linear_memory_pages;
+      if(dirty_end > previous_page_count)
+         memset(cb_ptr->full_linear_memory_start + previous_page_count*64u*1024u, 0, (dirty_end - previous_page_count)*64u*1024u);
+      if(new_page_count > (uint64_t)cb_ptr->max_linear_memory_pages)
+         cb_ptr->max_linear_memory_pages = new_page_count;
+   }
 
    return (int32_t)previous_page_count;
 }
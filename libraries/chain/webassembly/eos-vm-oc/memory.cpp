@@ -2,7 +2,10 @@
 #include <eosio/chain/webassembly/eos-vm-oc/intrinsic.hpp>
 
 #include <fc/scoped_exit.hpp>
+#include <fc/log/logger_config.hpp> //set_os_thread_name()
 
+#include <errno.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/syscall.h>
 #include <sys/mman.h>
@@ -10,7 +13,7 @@
 
 namespace eosio { namespace chain { namespace eosvmoc {
 
-memory::memory() {
+memory::memory(bool transparent_huge_pages) {
    int fd = syscall(SYS_memfd_create, "eosvmoc_mem", MFD_CLOEXEC);
    FC_ASSERT(fd >= 0, "Failed to create memory memfd");
    auto cleanup_fd = fc::make_scoped_exit([&fd](){close(fd);});
@@ -18,8 +21,13 @@ memory::memory() {
    FC_ASSERT(!ret, "Failed to grow memory memfd");
 
    mapsize = total_memory_per_slice*number_slices;
-   mapbase = (uint8_t*)mmap(nullptr, mapsize, PROT_NONE, MAP_PRIVATE|MAP_ANON, 0, 0);
-   FC_ASSERT(mapbase != MAP_FAILED, "Failed to mmap memory");
+   reservation_size = mapsize + huge_page_size;
+   reservation = (uint8_t*)mmap(nullptr, reservation_size, PROT_NONE, MAP_PRIVATE|MAP_ANON, 0, 0);
+   FC_ASSERT(reservation != MAP_FAILED, "Failed to mmap memory");
+   //huge pages can only map the memfd where its offsets line up with 2 MiB in the address space, so line up the last
+   //slice: intrinsics reach the linear memory through it, and initial data and scrubbing are written through it
+   const uintptr_t last_slice = (uintptr_t)reservation + (number_slices-1u)*total_memory_per_slice;
+   mapbase = reservation + (huge_page_size - last_slice % huge_page_size) % huge_page_size;
 
    uint8_t* next_slice = mapbase;
    uint8_t* last;
@@ -33,6 +41,14 @@ memory::memory() {
    zeropage_base = mapbase + memory_prologue_size;
    fullpage_base = last + memory_prologue_size;
 
+   //the kernel only uses huge pages for a memfd when its shmem_enabled policy allows it; otherwise this is a no-op
+   if(transparent_huge_pages && madvise(mapbase, mapsize, MADV_HUGEPAGE)) {
+      static bool once_is_enough;
+      if(!once_is_enough)
+         wlog("EOS VM OC linear memory falls back to regular pages, transparent huge pages are not available: ${e}", ("e", strerror(errno)));
+      once_is_enough = true;
+   }
+
    //layout the intrinsic jump table
    uintptr_t* const intrinsic_jump_table = reinterpret_cast<uintptr_t* const>(zeropage_base - first_intrinsic_offset);
    const intrinsic_map_t& intrinsics = get_intrinsic_map();
@@ -41,7 +57,78 @@ memory::memory() {
 }
 
 memory::~memory() {
-   munmap(mapbase, mapsize);
+   munmap(reservation, reservation_size);
+}
+
+memory_pool::memory_pool(size_t slab_count, bool transparent_huge_pages) {
+   FC_ASSERT(slab_count > 0, "EOS VM OC memory pool requires at least one slab");
+   for(size_t i = 0; i < slab_count; ++i) {
+      _slabs.emplace_back(std::make_unique<memory>(transparent_huge_pages));
+      //a new memfd reads back as zero so a fresh slab is already clean
+      _clean.push_back(_slabs.back().get());
+   }
+
+   _scrubber_thread = std::thread([this]() {
+      fc::set_os_thread_name("oc-scrub");
+      scrubber_loop();
+   });
+}
+
+memory_pool::~memory_pool() {
+   {
+      std::lock_guard<std::mutex> g(_mtx);
+      _done = true;
+   }
+   _cv.notify_all();
+   _scrubber_thread.join();
+}
+
+memory& memory_pool::acquire() {
+   std::unique_lock<std::mutex> g(_mtx);
+   if(_clean.empty() && !_dirty.empty()) {
+      //the helper thread is behind, zero a slab here rather than wait for it
+      memory* mem = _dirty.front();
+      _dirty.pop_front();
+      g.unlock();
+      scrub(*mem);
+      return *mem;
+   }
+   _cv.wait(g, [this]() { return !_clean.empty(); });
+   memory* mem = _clean.front();
+   _clean.pop_front();
+   return *mem;
+}
+
+void memory_pool::release(memory& mem) {
+   {
+      std::lock_guard<std::mutex> g(_mtx);
+      _dirty.push_back(&mem);
+   }
+   _cv.notify_all();
+}
+
+void memory_pool::scrubber_loop() {
+   std::unique_lock<std::mutex> g(_mtx);
+   while(true) {
+      _cv.wait(g, [this]() { return _done || !_dirty.empty(); });
+      if(_done)
+         return;
+      memory* mem = _dirty.front();
+      _dirty.pop_front();
+      g.unlock();
+      scrub(*mem);
+      g.lock();
+      _clean.push_back(mem);
+      _cv.notify_all();
+   }
+}
+
+void memory_pool::scrub(memory& mem) {
+   //pages past the high water mark of the last execution were never reachable by it and are still zero
+   control_block* const cb = mem.get_control_block();
+   if(cb->max_linear_memory_pages > 0)
+      memset(mem.full_page_memory_base(), 0, 64u*1024u*cb->max_linear_memory_pages);
+   cb->max_linear_memory_pages = 0;
 }
 
 }}}
\ No newline at end of file
@@ -0,0 +1,228 @@
+#include <eosio/chain/webassembly/eos-vm-oc/sampling_profiler.hpp>
+#include <eosio/chain/webassembly/eos-vm-oc/executor.hpp>
+#include <eosio/chain/webassembly/eos-vm-oc/memory.hpp>
+#include <eosio/chain/webassembly/eos-vm-oc/eos-vm-oc.hpp>
+#include <eosio/chain/apply_context.hpp>
+#include <eosio/chain/code_object.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include "IR/Module.h"
+#include "WASM/WASM.h"
+#include "Inline/Serialization.h"
+
+#include <asm/prctl.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <cxxabi.h>
+#include <errno.h>
+#include <signal.h>
+#include <ucontext.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <ostream>
+
+namespace eosio { namespace chain { namespace eosvmoc {
+
+namespace {
+   constexpr uint32_t host_function = UINT32_MAX;
+
+   using sample_key = std::tuple<account_name, account_name, action_name, digest_type, uint8_t, uint32_t>;
+
+   struct profile_state {
+      std::atomic<bool>             running{false};
+      std::mutex                    mtx;
+      std::map<sample_key, uint64_t> counts;
+      uint64_t                      dropped = 0;
+   };
+
+   profile_state& state() {
+      static profile_state s;
+      return s;
+   }
+
+   void sigprof_handler(int, siginfo_t*, void* ctx) {
+      const int saved_errno = errno;
+      auto restore_errno = [&]() { errno = saved_errno; };
+
+      //as in the SEGV handler, GS leads to the control block of the slab this thread executes on, if any
+      uint64_t current_gs = 0;
+      if(syscall(SYS_arch_prctl, ARCH_GET_GS, &current_gs) || current_gs == 0)
+         return restore_errno();
+      const control_block* const cb = reinterpret_cast<const control_block*>(current_gs - memory::cb_offset);
+      if(cb->magic != signal_sentinel || !cb->is_running || !cb->profile_samples)
+         return restore_errno();
+
+      //a slab released by this thread may already run on another one, whose samples these are not
+      profile_samples* const samples = reinterpret_cast<profile_samples*>(cb->profile_samples);
+      if(!pthread_equal(samples->owner, pthread_self()))
+         return restore_errno();
+
+      if(samples->count == profile_samples::capacity)
+         samples->dropped = samples->dropped + 1;
+      else {
+         samples->ips[samples->count] = reinterpret_cast<const ucontext_t*>(ctx)->uc_mcontext.gregs[REG_RIP];
+         samples->count = samples->count + 1;
+      }
+      restore_errno();
+   }
+
+   struct function_names {
+      bool                            parsed = false;
+      size_t                          imported = 0;
+      std::map<uint32_t, std::string> names; //by function index, imports included
+   };
+
+   //the function names subsection of a standard name section
+   void parse_name_section(const IR::UserSection& section, std::map<uint32_t, std::string>& names) {
+      Serialization::MemoryInputStream stream(section.data.data(), section.data.size());
+      while(stream.capacity()) {
+         U8 id = 0;
+         serializeVarUInt7(stream, id);
+         U32 size = 0;
+         serializeVarUInt32(stream, size);
+         Serialization::MemoryInputStream subsection(stream.advance(size), size);
+         if(id != 1)
+            continue;
+         U32 count = 0;
+         serializeVarUInt32(subsection, count);
+         for(U32 i = 0; i < count; ++i) {
+            U32 index = 0;
+            serializeVarUInt32(subsection, index);
+            std::string name;
+            serialize(subsection, name);
+            names[index] = std::move(name);
+         }
+      }
+   }
+
+   function_names load_function_names(const chainbase::database& db, const digest_type& code_hash, uint8_t vm_version) {
+      function_names result;
+      const code_object* const code = db.find<code_object, by_code_hash>(boost::make_tuple(code_hash, 0, vm_version));
+      if(!code)
+         return result;
+      try {
+         IR::Module module;
+         Serialization::MemoryInputStream stream((const U8*)code->code.data(), code->code.size());
+         WASM::serialize(stream, module);
+         result.parsed = true;
+         result.imported = module.functions.imports.size();
+         for(const IR::UserSection& section : module.userSections) {
+            if(section.name == "name")
+               parse_name_section(section, result.names);
+         }
+      } catch(...) {
+         //a malformed name section leaves the functions it did not get to unnamed
+      }
+      return result;
+   }
+
+   std::string frame_name(const function_names& names, uint32_t def_index) {
+      if(def_index == host_function)
+         return "[host]";
+      if(!names.parsed)
+         return "wasm-function-def[" + std::to_string(def_index) + "]";
+
+      const uint32_t index = names.imported + def_index;
+      std::string name = "wasm-function[" + std::to_string(index) + "]";
+      auto it = names.names.find(index);
+      if(it != names.names.end() && !it->second.empty()) {
+         int status = 0;
+         char* const demangled = abi::__cxa_demangle(it->second.c_str(), nullptr, nullptr, &status);
+         name = status == 0 && demangled ? demangled : it->second;
+         free(demangled);
+      }
+      //the frame separator of folded stacks
+      std::replace(name.begin(), name.end(), ';', ':');
+      std::replace(name.begin(), name.end(), '\n', ' ');
+      return name;
+   }
+}
+
+void sampling_profiler::start(uint32_t hz) {
+   EOS_ASSERT(hz > 0 && hz <= 1'000'000, misc_exception, "sampling rate must be between 1 and 1000000 per second");
+
+   struct sigaction sig_action;
+   sig_action.sa_sigaction = sigprof_handler;
+   sigemptyset(&sig_action.sa_mask);
+   sig_action.sa_flags = SA_SIGINFO | SA_RESTART;
+   EOS_ASSERT(sigaction(SIGPROF, &sig_action, nullptr) == 0, misc_exception, "failed to install SIGPROF handler");
+
+   const suseconds_t interval_us = 1'000'000 / hz;
+   struct itimerval timer = {{interval_us / 1'000'000, interval_us % 1'000'000}, {interval_us / 1'000'000, interval_us % 1'000'000}};
+   EOS_ASSERT(setitimer(ITIMER_PROF, &timer, nullptr) == 0, misc_exception, "failed to start the profiling timer");
+   state().running = true;
+}
+
+void sampling_profiler::stop() {
+   if(!state().running)
+      return;
+   struct itimerval timer = {};
+   setitimer(ITIMER_PROF, &timer, nullptr);
+   //a SIGPROF still pending would otherwise terminate the process
+   signal(SIGPROF, SIG_IGN);
+   state().running = false;
+}
+
+bool sampling_profiler::running() {
+   return state().running.load(std::memory_order_relaxed);
+}
+
+void sampling_profiler::record(const code_descriptor& code, const uint8_t* code_mapping, size_t code_mapping_size,
+                               const profile_samples& samples, const apply_context& context) {
+   const uintptr_t code_base = (uintptr_t)(code_mapping + code.code_begin);
+   const uintptr_t code_end = (uintptr_t)(code_mapping + code_mapping_size);
+   const function_offset* const offsets_begin = reinterpret_cast<const function_offset*>(code_mapping + code.function_offsets_begin);
+   const function_offset* const offsets_end = offsets_begin + code.function_offsets_count;
+
+   auto& s = state();
+   std::lock_guard<std::mutex> g(s.mtx);
+   for(unsigned i = 0; i < samples.count; ++i) {
+      uint32_t def_index = host_function;
+      const uintptr_t ip = samples.ips[i];
+      if(ip >= code_base && ip < code_end) {
+         const auto it = std::upper_bound(offsets_begin, offsets_end, ip - code_base, [](uintptr_t offset, const function_offset& f) {
+            return offset < f.code_offset;
+         });
+         if(it != offsets_begin)
+            def_index = std::prev(it)->def_index;
+      }
+      ++s.counts[sample_key{context.get_receiver(), context.get_action().account, context.get_action().name,
+                            code.code_hash, code.vm_version, def_index}];
+   }
+   s.dropped += samples.dropped;
+}
+
+void sampling_profiler::write_folded(std::ostream& out, const chainbase::database& db) {
+   auto& s = state();
+   std::map<sample_key, uint64_t> counts;
+   uint64_t dropped;
+   {
+      std::lock_guard<std::mutex> g(s.mtx);
+      counts = s.counts;
+      dropped = s.dropped;
+   }
+
+   std::map<std::pair<digest_type, uint8_t>, function_names> names;
+   for(const auto& [key, count] : counts) {
+      const auto& [receiver, account, action, code_hash, vm_version, def_index] = key;
+      auto it = names.find({code_hash, vm_version});
+      if(it == names.end())
+         it = names.emplace(std::make_pair(code_hash, vm_version), load_function_names(db, code_hash, vm_version)).first;
+      out << receiver.to_string() << ';' << account.to_string() << "::" << action.to_string() << ';'
+          << frame_name(it->second, def_index) << ' ' << count << '\n';
+   }
+   if(dropped)
+      wlog("EOS VM OC sampling profiler dropped ${d} samples of executions that took too many", ("d", dropped));
+}
+
+void sampling_profiler::clear() {
+   auto& s = state();
+   std::lock_guard<std::mutex> g(s.mtx);
+   s.counts.clear();
+   s.dropped = 0;
+}
+
+}}}
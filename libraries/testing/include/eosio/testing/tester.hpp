@@ -422,6 +422,12 @@ namespace eosio { namespace testing {
          void             _start_block(fc::time_point block_time);
          signed_block_ptr _finish_block();
 
+         /**
+          * With --cache-setup, the first tester of the process set up with @ref policy keeps a copy of its blocks and
+          * state directories, and the next ones start from a copy of them instead of producing the setup again
+          */
+         void             init_from_cached_setup(const setup_policy policy, const genesis_state& genesis);
+
       // Fields:
       protected:
          // tempdir field must come before control so that during destruction the tempdir is deleted only after controller finishes
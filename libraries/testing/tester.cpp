@@ -8,6 +8,7 @@
 #include <boost/iostreams/filtering_stream.hpp>
 #include <boost/iostreams/copy.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
+#include <boost/filesystem.hpp>
 
 #include <fstream>
 
@@ -150,15 +151,92 @@ namespace eosio { namespace testing {
      return control->head_block_id() == other.control->head_block_id();
    }
 
+   namespace {
+      /// chain of a tester right after execute_setup_policy, what init copies for the next testers set up the same way
+      struct cached_setup {
+         fc::temp_directory                            dir;
+         fc::optional<fc::time_point>                  pending_block_time;
+         vector<packed_transaction_ptr>                pending_trxs;
+         map<transaction_id_type, transaction_receipt> chain_transactions;
+         map<account_name, block_id_type>              last_produced_block;
+      };
+
+      std::map<std::pair<setup_policy, db_read_mode>, std::unique_ptr<cached_setup>> cached_setups;
+
+      bool cache_setup_enabled() {
+         static const bool enabled = []() {
+            for( int i = 0; i < boost::unit_test::framework::master_test_suite().argc; ++i ) {
+               if( boost::unit_test::framework::master_test_suite().argv[i] == std::string("--cache-setup") )
+                  return true;
+            }
+            return false;
+         }();
+         return enabled;
+      }
+
+      void copy_directory( const fc::path& from, const fc::path& to ) {
+         namespace bfs = boost::filesystem;
+         bfs::create_directories( to );
+         for( bfs::recursive_directory_iterator itr( from ), end; itr != end; ++itr ) {
+            const auto target = to / bfs::relative( itr->path(), from );
+            if( bfs::is_directory( itr->status() ) )
+               bfs::create_directories( target );
+            else
+               bfs::copy_file( itr->path(), target, bfs::copy_option::overwrite_if_exists );
+         }
+      }
+   }
+
    void base_tester::init(const setup_policy policy, db_read_mode read_mode) {
       auto def_conf = default_config(tempdir);
       def_conf.first.read_mode = read_mode;
       cfg = def_conf.first;
 
+      if( policy != setup_policy::none && cache_setup_enabled() ) {
+         init_from_cached_setup(policy, def_conf.second);
+         return;
+      }
       open(def_conf.second);
       execute_setup_policy(policy);
    }
 
+   void base_tester::init_from_cached_setup(const setup_policy policy, const genesis_state& genesis) {
+      auto& cached = cached_setups[{policy, cfg.read_mode}];
+      if( !cached ) {
+         open(genesis);
+         execute_setup_policy(policy);
+         auto c = std::make_unique<cached_setup>();
+         // the pending block does not survive close, its transactions are pushed again once reopened
+         if( control->is_building_block() ) {
+            c->pending_block_time = control->pending_block_time();
+            for( const auto& trx : control->abort_block() )
+               c->pending_trxs.emplace_back( trx->packed_trx() );
+         }
+         c->chain_transactions = chain_transactions;
+         c->last_produced_block = last_produced_block;
+         close();
+         copy_directory( cfg.blocks_dir, c->dir.path() / config::default_blocks_dir_name );
+         copy_directory( cfg.state_dir, c->dir.path() / config::default_state_dir_name );
+         cached = std::move( c );
+      } else {
+         copy_directory( cached->dir.path() / config::default_blocks_dir_name, cfg.blocks_dir );
+         copy_directory( cached->dir.path() / config::default_state_dir_name, cfg.state_dir );
+      }
+
+      open(genesis.compute_chain_id());
+      chain_transactions = cached->chain_transactions;
+      last_produced_block = cached->last_produced_block;
+      if( cached->pending_block_time ) {
+         _start_block( *cached->pending_block_time );
+         for( const auto& ptrx : cached->pending_trxs ) {
+            auto fut = transaction_metadata::start_recover_keys( ptrx, control->get_thread_pool(), control->get_chain_id(), fc::microseconds::maximum() );
+            auto r = control->push_transaction( fut.get(), fc::time_point::maximum(), DEFAULT_BILLED_CPU_TIME_US, true );
+            if( r->except_ptr ) std::rethrow_exception( r->except_ptr );
+            if( r->except ) throw *r->except;
+         }
+      }
+   }
+
    void base_tester::init(controller::config config, const snapshot_reader_ptr& snapshot) {
       cfg = config;
       open(snapshot);
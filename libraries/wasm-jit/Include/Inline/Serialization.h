@@ -61,6 +61,12 @@ namespace Serialization
 			end = nullptr;
 			return std::move(bytes);
 		}
+
+		// Ensures that numBytes can be written without growing the buffer again.
+		void reserve(Uptr numBytes)
+		{
+			if(next + numBytes > end) { extendBuffer(numBytes); }
+		}
 		
 	private:
 
@@ -105,6 +111,9 @@ namespace Serialization
 			return next;
 		}
 
+		// Returns the number of bytes that can be read without calling getMoreData.
+		inline Uptr buffered() const { return end - next; }
+
 	protected:
 
 		const U8* next;
@@ -181,14 +190,43 @@ namespace Serialization
 		U8 bytes[maxBytes] = {0};
 		Uptr numBytes = 0;
 		I8 signExtendShift = (I8)sizeof(Value) * 8;
-		while(numBytes < maxBytes)
+		if(stream.buffered() >= maxBytes)
 		{
-			U8 byte = *stream.advance(1);
-			bytes[numBytes] = byte;
-			++numBytes;
-			signExtendShift -= 7;
-			if(!(byte & 0x80)) { break; }
-		};
+			// The longest encoding is already buffered: scan it in place and advance the stream once.
+			const U8* data = stream.peek(maxBytes);
+			if(maxBytes > 1 && !(data[0] & 0x80))
+			{
+				// A single byte encoding, the most common by far, can't have unused bits to check.
+				stream.advance(1);
+				value = Value(data[0]);
+				signExtendShift -= 7;
+				if(std::is_signed<Value>::value && signExtendShift > 0)
+				{ value = Value(value << signExtendShift) >> signExtendShift; }
+				if(value < minValue || value > maxValue)
+				{ throw FatalSerializationException(std::string("out-of-range value: ") + std::to_string(minValue) + "<=" + std::to_string(value) + "<=" + std::to_string(maxValue)); }
+				return;
+			}
+			while(numBytes < maxBytes)
+			{
+				U8 byte = data[numBytes];
+				bytes[numBytes] = byte;
+				++numBytes;
+				signExtendShift -= 7;
+				if(!(byte & 0x80)) { break; }
+			};
+			stream.advance(numBytes);
+		}
+		else
+		{
+			while(numBytes < maxBytes)
+			{
+				U8 byte = *stream.advance(1);
+				bytes[numBytes] = byte;
+				++numBytes;
+				signExtendShift -= 7;
+				if(!(byte & 0x80)) { break; }
+			};
+		}
 
 		// Ensure that the input does not encode more than maxBits of data.
 		enum { numUsedBitsInLastByte = maxBits - (maxBytes-1) * 7 };
@@ -284,11 +322,12 @@ namespace Serialization
 		serializeVarUInt32(stream,size);
 		if(Stream::isInput)
 		{
-			// Grow the vector one element at a time:
-			// try to get a serialization exception before making a huge allocation for malformed input.
+			// Every element takes at least one byte of input, so reserving no more elements than there are bytes
+			// left avoids the reallocations without making a huge allocation for malformed input.
 			vector.clear();
          if (size >= max_size)
             throw FatalSerializationException(std::string("Trying to deserialize array of size : " + std::to_string((uint64_t)size) + ", which is over by "+std::to_string(size - max_size )+" bytes"));
+			vector.reserve(std::min(size,stream.buffered()));
 			for(Uptr index = 0;index < size;++index)
 			{
 				vector.push_back(Element());
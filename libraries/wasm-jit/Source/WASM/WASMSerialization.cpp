@@ -504,11 +504,13 @@ namespace WASM
 			if( locals_accum > eosio::chain::wasm_constraints::maximum_func_local_bytes )
 				throw FatalSerializationException( "too many locals" );
 
-			for(Uptr index = 0;index < localSet.num;++index) { functionDef.nonParameterLocalTypes.push_back(localSet.type); }
+			functionDef.nonParameterLocalTypes.insert(functionDef.nonParameterLocalTypes.end(),localSet.num,localSet.type);
 		}
 
 		// Deserialize the function code, validate it, and re-encode it in the IR format.
+		// The IR encoding of a function is about as long as its binary encoding or longer, so the stream starts that large.
 		ArrayOutputStream irCodeByteStream;
+		irCodeByteStream.reserve(bodyStream.capacity());
 		OperatorEncoderStream irEncoderStream(irCodeByteStream);
 		CodeValidationStream codeValidationStream(module,functionDef);
 		while(bodyStream.capacity())
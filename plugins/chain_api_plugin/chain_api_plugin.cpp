@@ -1,28 +1,179 @@
 #include <eosio/chain_api_plugin/chain_api_plugin.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/thread_utils.hpp>
 
 #include <fc/io/json.hpp>
 
+#include <deque>
+#include <map>
+#include <mutex>
+
 namespace eosio {
 
 static appbase::abstract_plugin& _chain_api_plugin = app().register_plugin<chain_api_plugin>();
 
 using namespace eosio;
+namespace bpo = boost::program_options;
 
 class chain_api_plugin_impl {
 public:
    chain_api_plugin_impl(controller& db)
       : db(db) {}
 
+   /**
+    * Read only calls are queued here instead of running as they come off the application queue, and are then run as a
+    * batch on the read thread pool from within one main thread task. The main thread waits for the batch, so nothing
+    * modifies chainbase while the calls read it, and they see the same state as calls run on the main thread would.
+    */
+   void queue_read( std::function<void()> call ) {
+      reads.emplace_back( std::move( call ) );
+      if( !read_window_scheduled ) {
+         read_window_scheduled = true;
+         app().post( priority::medium_low, [this]() { run_read_window(); } );
+      }
+   }
+
+   void run_read_window() {
+      read_window_scheduled = false;
+      const auto deadline = fc::time_point::now() + read_window;
+
+      // calls not started by the deadline wait for the next read window, so other main thread work gets in between
+      std::mutex mtx;
+      std::vector<std::future<void>> workers;
+      workers.reserve( read_threads );
+      for( uint16_t i = 0; i < read_threads; ++i ) {
+         workers.emplace_back( async_thread_pool( read_thread_pool->get_executor(), [this, &mtx, deadline]() {
+            while( true ) {
+               std::function<void()> call;
+               {
+                  std::lock_guard<std::mutex> g( mtx );
+                  if( reads.empty() || fc::time_point::now() >= deadline ) return;
+                  call = std::move( reads.front() );
+                  reads.pop_front();
+               }
+               call(); // handles its own exceptions
+            }
+         } ) );
+      }
+      for( auto& w : workers ) w.wait();
+
+      if( !reads.empty() && !read_window_scheduled ) {
+         read_window_scheduled = true;
+         app().post( priority::medium_low, [this]() { run_read_window(); } );
+      }
+   }
+
+   /**
+    * Single flight for queued reads: a request identical to one already queued, same url and body, waits for that
+    * read's response instead of being queued too. Requests only arrive on the main thread between read windows, so
+    * the read runs no earlier than any request joining it saw the chain.
+    *
+    * @return false with @ref cb and @ref json_cb joined to an identical queued read, otherwise true with them replaced
+    * by callbacks that answer every request joining before the read responds
+    */
+   bool single_flight( const string& url, const string& body, url_response_callback& cb, url_response_json_callback& json_cb ) {
+      auto key = url + '\n' + body;
+      std::lock_guard<std::mutex> g( pending_reads_mtx );
+      auto itr = pending_reads.find( key );
+      if( itr != pending_reads.end() ) {
+         itr->second.push_back( { std::move( cb ), std::move( json_cb ) } );
+         return false;
+      }
+      pending_reads[key].push_back( { std::move( cb ), std::move( json_cb ) } );
+      cb = [this, key]( int code, fc::variant response ) {
+         for( auto& w : take_waiters( key ) ) w.cb( code, response );
+      };
+      json_cb = [this, key]( int code, std::string json, bool immutable ) {
+         for( auto& w : take_waiters( key ) ) w.json_cb( code, json, immutable );
+      };
+      return true;
+   }
+
+   /**
+    * Runs every call of a batch request of {"call": name, "params": {...}} objects, in one go so they all see the same
+    * state, and returns their {"code": http code, "body": result or error} in order.
+    */
+   fc::variant run_batch( const fc::variant& requests ) {
+      EOS_ASSERT( requests.is_array(), fc::invalid_arg_exception, "batch request must be an array of calls" );
+      const auto& calls = requests.get_array();
+      EOS_ASSERT( calls.size() <= batch_max_calls, fc::invalid_arg_exception,
+                  "batch of ${n} calls exceeds chain-api-batch-max-calls ${m}", ("n", calls.size())("m", batch_max_calls) );
+
+      fc::variants responses;
+      responses.reserve( calls.size() );
+      for( const auto& c : calls ) {
+         string call_name;
+         fc::variant response;
+         auto respond = [&response]( int code, fc::variant body ) {
+            response = fc::mutable_variant_object( "code", code )( "body", std::move(body) );
+         };
+         try {
+            EOS_ASSERT( c.is_object() && c.get_object().contains( "call" ), fc::invalid_arg_exception, "batch entry must name a call" );
+            call_name = c["call"].as_string();
+            auto itr = batch_calls.find( call_name );
+            EOS_ASSERT( itr != batch_calls.end(), fc::invalid_arg_exception, "${c} can not be called in a batch", ("c", call_name) );
+            const auto& obj = c.get_object();
+            respond( 200, itr->second( obj.contains( "params" ) ? obj["params"] : fc::variant( fc::variant_object() ) ) );
+         } catch (...) {
+            http_plugin::handle_exception( "chain", call_name.c_str(), fc::json::to_string( c, fc::time_point::maximum() ), respond );
+         }
+         responses.emplace_back( std::move(response) );
+      }
+      return fc::variant( std::move(responses) );
+   }
+
    controller& db;
+
+   struct read_waiter {
+      url_response_callback      cb;
+      url_response_json_callback json_cb;
+   };
+
+   std::vector<read_waiter> take_waiters( const string& key ) {
+      std::lock_guard<std::mutex> g( pending_reads_mtx );
+      auto itr = pending_reads.find( key );
+      if( itr == pending_reads.end() ) return {};
+      auto waiters = std::move( itr->second );
+      pending_reads.erase( itr );
+      return waiters;
+   }
+
+   std::mutex                                      pending_reads_mtx;
+   std::map<string, std::vector<read_waiter>>      pending_reads;
+
+   uint32_t                                batch_max_calls = 0;
+   std::map<string, std::function<fc::variant(const fc::variant&)>> batch_calls;
+
+   uint16_t                                read_threads = 0;
+   fc::microseconds                        read_window;
+   fc::optional<eosio::chain::named_thread_pool> read_thread_pool;
+   std::deque<std::function<void()>>       reads; ///< main thread, or read threads while the main thread waits in a read window
+   bool                                    read_window_scheduled = false;
 };
 
 
 chain_api_plugin::chain_api_plugin(){}
 chain_api_plugin::~chain_api_plugin(){}
 
-void chain_api_plugin::set_program_options(options_description&, options_description&) {}
-void chain_api_plugin::plugin_initialize(const variables_map&) {}
+void chain_api_plugin::set_program_options(options_description&, options_description& cfg) {
+   cfg.add_options()
+         ("chain-api-read-threads", bpo::value<uint16_t>()->default_value(0),
+          "Number of threads running read only chain API calls, in batches while the main thread waits, instead of one at a time on the main thread. 0 runs them on the main thread")
+         ("chain-api-read-window-us", bpo::value<uint32_t>()->default_value(10000),
+          "Time in microseconds after which a batch of read only chain API calls starts no more calls, leaving the rest to the next batch")
+         ("chain-api-batch-max-calls", bpo::value<uint32_t>()->default_value(100),
+          "Maximum number of calls in one /v1/chain/batch request, 0 disables the endpoint")
+         ;
+}
+
+void chain_api_plugin::plugin_initialize(const variables_map& options) {
+   my.reset(new chain_api_plugin_impl(app().get_plugin<chain_plugin>().chain()));
+   my->read_threads = options.at( "chain-api-read-threads" ).as<uint16_t>();
+   my->read_window = fc::microseconds( options.at( "chain-api-read-window-us" ).as<uint32_t>() );
+   my->batch_max_calls = options.at( "chain-api-batch-max-calls" ).as<uint32_t>();
+   EOS_ASSERT( my->read_threads == 0 || my->read_window.count() > 0, chain::plugin_config_exception,
+               "chain-api-read-window-us must be greater than 0 when chain-api-read-threads is set" );
+}
 
 struct async_result_visitor : public fc::visitor<fc::variant> {
    template<typename T>
@@ -64,14 +215,90 @@ struct async_result_visitor : public fc::visitor<fc::variant> {
    }\
 }
 
+// as CALL_ASYNC, but a body in the usual packed form is decoded straight to a packed_transaction
+#define TRX_CALL_ASYNC(api_name, api_handle, api_namespace, call_name, call_result, http_response_code) \
+{std::string("/v1/" #api_name "/" #call_name), \
+   [api_handle](string, string body, url_response_callback cb) mutable { \
+      if (body.empty()) body = "{}"; \
+      api_handle.validate(); \
+      auto next = [cb, body](const fc::static_variant<fc::exception_ptr, call_result>& result){\
+         if (result.contains<fc::exception_ptr>()) {\
+            try {\
+               result.get<fc::exception_ptr>()->dynamic_rethrow_exception();\
+            } catch (...) {\
+               http_plugin::handle_exception(#api_name, #call_name, body, cb);\
+            }\
+         } else {\
+            cb(http_response_code, result.visit(async_result_visitor()));\
+         }\
+      };\
+      if( auto trx = api_namespace::parse_packed_transaction(body) ) {\
+         api_handle.call_name(std::move(trx), std::move(next));\
+      } else {\
+         api_handle.call_name(fc::json::from_string(body).as<api_namespace::call_name ## _params>(), std::move(next));\
+      }\
+   }\
+}
+
+// as CALL, but run from the read thread pool when there is one
+#define READ_CALL(api_name, api_handle, api_namespace, call_name, http_response_code) \
+{std::string("/v1/" #api_name "/" #call_name), \
+   [impl = my.get(), api_handle](string url, string body, url_response_callback cb) mutable { \
+          url_response_json_callback no_json_cb; \
+          if( impl->read_threads > 0 && !impl->single_flight( url, body, cb, no_json_cb ) ) return; \
+          auto call = [api_handle, body{std::move(body)}, cb{std::move(cb)}]() mutable { \
+             api_handle.validate(); \
+             try { \
+                if (body.empty()) body = "{}"; \
+                fc::variant result( api_handle.call_name(fc::json::from_string(body).as<api_namespace::call_name ## _params>()) ); \
+                cb(http_response_code, std::move(result)); \
+             } catch (...) { \
+                http_plugin::handle_exception(#api_name, #call_name, body, cb); \
+             } \
+          }; \
+          if( impl->read_threads > 0 ) impl->queue_read( std::move(call) ); \
+          else call(); \
+       }}
+
+// handler of the requests to call_name that accept application/octet-stream, answered by call_name ## _packed
+#define BINARY_CALL(api_name, api_handle, api_namespace, call_name, on_read_threads) \
+_http_plugin.add_binary_handler( "/v1/" #api_name "/" #call_name, \
+   [impl = my.get(), api_handle](string, string body, url_response_callback cb, url_response_binary_callback binary_cb) mutable { \
+          auto call = [api_handle, body{std::move(body)}, cb{std::move(cb)}, binary_cb{std::move(binary_cb)}]() mutable { \
+             api_handle.validate(); \
+             try { \
+                if (body.empty()) body = "{}"; \
+                binary_cb(200, api_handle.call_name ## _packed(fc::json::from_string(body).as<api_namespace::call_name ## _params>()), false); \
+             } catch (...) { \
+                http_plugin::handle_exception(#api_name, #call_name, body, cb); \
+             } \
+          }; \
+          if( on_read_threads && impl->read_threads > 0 ) impl->queue_read( std::move(call) ); \
+          else call(); \
+       } )
+
+// entry of chain_api_plugin_impl::batch_calls
+#define BATCH_CALL(api_handle, api_namespace, call_name) \
+{std::string(#call_name), \
+   [api_handle](const fc::variant& params) mutable { \
+      api_handle.validate(); \
+      return fc::variant( api_handle.call_name(params.as<api_namespace::call_name ## _params>()) ); \
+   }}
+
 #define CHAIN_RO_CALL(call_name, http_response_code) CALL(chain, ro_api, chain_apis::read_only, call_name, http_response_code)
+#define CHAIN_BATCH_CALL(call_name) BATCH_CALL(ro_api, chain_apis::read_only, call_name)
+#define CHAIN_READ_CALL(call_name, http_response_code) READ_CALL(chain, ro_api, chain_apis::read_only, call_name, http_response_code)
+#define CHAIN_BINARY_CALL(call_name, on_read_threads) BINARY_CALL(chain, ro_api, chain_apis::read_only, call_name, on_read_threads)
 #define CHAIN_RW_CALL(call_name, http_response_code) CALL(chain, rw_api, chain_apis::read_write, call_name, http_response_code)
 #define CHAIN_RO_CALL_ASYNC(call_name, call_result, http_response_code) CALL_ASYNC(chain, ro_api, chain_apis::read_only, call_name, call_result, http_response_code)
 #define CHAIN_RW_CALL_ASYNC(call_name, call_result, http_response_code) CALL_ASYNC(chain, rw_api, chain_apis::read_write, call_name, call_result, http_response_code)
+#define CHAIN_RW_TRX_CALL_ASYNC(call_name, call_result, http_response_code) TRX_CALL_ASYNC(chain, rw_api, chain_apis::read_write, call_name, call_result, http_response_code)
 
 void chain_api_plugin::plugin_startup() {
    ilog( "starting chain_api_plugin" );
-   my.reset(new chain_api_plugin_impl(app().get_plugin<chain_plugin>().chain()));
+   if( my->read_threads > 0 ) {
+      my->read_thread_pool.emplace( "chapi", my->read_threads );
+   }
    auto ro_api = app().get_plugin<chain_plugin>().get_read_only_api();
    auto rw_api = app().get_plugin<chain_plugin>().get_read_write_api();
 
@@ -81,33 +308,116 @@ void chain_api_plugin::plugin_startup() {
    _http_plugin.add_api({
       CHAIN_RO_CALL(get_info, 200)}, appbase::priority::medium);
    _http_plugin.add_api({
-      CHAIN_RO_CALL(get_activated_protocol_features, 200),
+      // reading the block log is not thread safe, so blocks are served on the main thread
       CHAIN_RO_CALL(get_block, 200),
       CHAIN_RO_CALL(get_block_header_state, 200),
-      CHAIN_RO_CALL(get_account, 200),
-      CHAIN_RO_CALL(get_code, 200),
-      CHAIN_RO_CALL(get_code_hash, 200),
-      CHAIN_RO_CALL(get_abi, 200),
-      CHAIN_RO_CALL(get_raw_code_and_abi, 200),
-      CHAIN_RO_CALL(get_raw_abi, 200),
-      CHAIN_RO_CALL(get_table_rows, 200),
-      CHAIN_RO_CALL(get_table_by_scope, 200),
-      CHAIN_RO_CALL(get_currency_balance, 200),
-      CHAIN_RO_CALL(get_currency_stats, 200),
-      CHAIN_RO_CALL(get_producers, 200),
-      CHAIN_RO_CALL(get_producer_schedule, 200),
-      CHAIN_RO_CALL(get_scheduled_transactions, 200),
-      CHAIN_RO_CALL(abi_json_to_bin, 200),
-      CHAIN_RO_CALL(abi_bin_to_json, 200),
-      CHAIN_RO_CALL(get_required_keys, 200),
-      CHAIN_RO_CALL(get_transaction_id, 200),
+      CHAIN_READ_CALL(get_activated_protocol_features, 200),
+      CHAIN_READ_CALL(get_account, 200),
+      CHAIN_READ_CALL(get_code, 200),
+      CHAIN_READ_CALL(get_code_hash, 200),
+      CHAIN_READ_CALL(get_abi, 200),
+      CHAIN_READ_CALL(get_raw_code_and_abi, 200),
+      CHAIN_READ_CALL(get_raw_abi, 200),
+      CHAIN_READ_CALL(get_table_by_scope, 200),
+      CHAIN_READ_CALL(get_currency_balance, 200),
+      CHAIN_READ_CALL(get_currency_stats, 200),
+      CHAIN_READ_CALL(get_producers, 200),
+      CHAIN_READ_CALL(get_producer_schedule, 200),
+      CHAIN_READ_CALL(get_scheduled_transactions, 200),
+      CHAIN_READ_CALL(abi_json_to_bin, 200),
+      CHAIN_READ_CALL(abi_bin_to_json, 200),
+      CHAIN_READ_CALL(get_required_keys, 200),
+      CHAIN_READ_CALL(get_transaction_id, 200),
+      CHAIN_READ_CALL(get_abi_cache_stats, 200),
+      CHAIN_READ_CALL(get_contract_profile, 200),
+      CHAIN_READ_CALL(get_accounts_by_keys, 200),
       CHAIN_RW_CALL_ASYNC(push_block, chain_apis::read_write::push_block_results, 202),
-      CHAIN_RW_CALL_ASYNC(push_transaction, chain_apis::read_write::push_transaction_results, 202),
+      CHAIN_RW_TRX_CALL_ASYNC(push_transaction, chain_apis::read_write::push_transaction_results, 202),
       CHAIN_RW_CALL_ASYNC(push_transactions, chain_apis::read_write::push_transactions_results, 202),
-      CHAIN_RW_CALL_ASYNC(send_transaction, chain_apis::read_write::send_transaction_results, 202)
+      CHAIN_RW_TRX_CALL_ASYNC(send_transaction, chain_apis::read_write::send_transaction_results, 202),
+      CHAIN_RW_CALL(push_ro_transaction, 200)
    });
+
+   // table rows are written to JSON directly instead of through an fc::variant of every row
+   _http_plugin.add_json_handler( "/v1/chain/get_table_rows",
+      [impl = my.get(), ro_api]( string url, string body, url_response_callback cb, url_response_json_callback json_cb ) mutable {
+         if( impl->read_threads > 0 && !impl->single_flight( url, body, cb, json_cb ) ) return;
+         auto call = [ro_api, body{std::move(body)}, cb{std::move(cb)}, json_cb{std::move(json_cb)}]() mutable {
+            ro_api.validate();
+            try {
+               if (body.empty()) body = "{}";
+               json_cb( 200, ro_api.get_table_rows_json( fc::json::from_string(body).as<chain_apis::read_only::get_table_rows_params>() ), false );
+            } catch (...) {
+               http_plugin::handle_exception("chain", "get_table_rows", body, cb);
+            }
+         };
+         if( impl->read_threads > 0 ) impl->queue_read( std::move(call) );
+         else call();
+      } );
+
+   // packed results for clients decoding with their own ABI tooling
+   // an irreversible packed block never changes, so http_plugin can cache it and let clients do the same; the JSON
+   // form is not cached, its actions are decoded with the current ABI of their contracts
+   _http_plugin.add_binary_handler( "/v1/chain/get_block",
+      [impl = my.get(), ro_api]( string, string body, url_response_callback cb, url_response_binary_callback binary_cb ) mutable {
+         ro_api.validate();
+         try {
+            if (body.empty()) body = "{}";
+            auto packed = ro_api.get_block_packed( fc::json::from_string(body).as<chain_apis::read_only::get_block_params>() );
+            const auto block_num = fc::raw::unpack<chain::block_header>( packed ).block_num();
+            binary_cb( 200, std::move(packed), block_num <= impl->db.last_irreversible_block_num() );
+         } catch (...) {
+            http_plugin::handle_exception("chain", "get_block", body, cb);
+         }
+      } );
+   CHAIN_BINARY_CALL(get_raw_code_and_abi, true);
+   CHAIN_BINARY_CALL(get_table_rows, true);
+
+   if( my->batch_max_calls > 0 ) {
+      // the state reads that can run on the read threads
+      my->batch_calls = {
+         CHAIN_BATCH_CALL(get_activated_protocol_features),
+         CHAIN_BATCH_CALL(get_account),
+         CHAIN_BATCH_CALL(get_code),
+         CHAIN_BATCH_CALL(get_code_hash),
+         CHAIN_BATCH_CALL(get_abi),
+         CHAIN_BATCH_CALL(get_raw_code_and_abi),
+         CHAIN_BATCH_CALL(get_raw_abi),
+         CHAIN_BATCH_CALL(get_table_rows),
+         CHAIN_BATCH_CALL(get_table_by_scope),
+         CHAIN_BATCH_CALL(get_currency_balance),
+         CHAIN_BATCH_CALL(get_currency_stats),
+         CHAIN_BATCH_CALL(get_producers),
+         CHAIN_BATCH_CALL(get_producer_schedule),
+         CHAIN_BATCH_CALL(get_scheduled_transactions),
+         CHAIN_BATCH_CALL(abi_json_to_bin),
+         CHAIN_BATCH_CALL(abi_bin_to_json),
+         CHAIN_BATCH_CALL(get_required_keys),
+         CHAIN_BATCH_CALL(get_transaction_id),
+         CHAIN_BATCH_CALL(get_accounts_by_keys)
+      };
+      _http_plugin.add_handler( "/v1/chain/batch",
+         [impl = my.get()]( string url, string body, url_response_callback cb ) mutable {
+            url_response_json_callback no_json_cb;
+            if( impl->read_threads > 0 && !impl->single_flight( url, body, cb, no_json_cb ) ) return;
+            auto call = [impl, body{std::move(body)}, cb{std::move(cb)}]() mutable {
+               try {
+                  if (body.empty()) body = "[]";
+                  cb( 200, impl->run_batch( fc::json::from_string(body) ) );
+               } catch (...) {
+                  http_plugin::handle_exception("chain", "batch", body, cb);
+               }
+            };
+            if( impl->read_threads > 0 ) impl->queue_read( std::move(call) );
+            else call();
+         } );
+   }
 }
 
-void chain_api_plugin::plugin_shutdown() {}
+void chain_api_plugin::plugin_shutdown() {
+   if( my && my->read_thread_pool ) {
+      my->read_thread_pool->stop();
+   }
+}
 
 }
@@ -12,6 +12,12 @@
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/snapshot.hpp>
+#include <eosio/chain/snapshot_delta.hpp>
+#include <eosio/chain/recovered_key_cache.hpp>
+#include <eosio/chain/abi_serializer_cache.hpp>
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+#include <eosio/chain/webassembly/eos-vm-oc/sampling_profiler.hpp>
+#endif
 
 #include <eosio/chain/eosio_contract.hpp>
 
@@ -25,6 +31,10 @@
 #include <fc/variant.hpp>
 #include <signal.h>
 #include <cstdlib>
+#include <future>
+#include <list>
+#include <map>
+#include <mutex>
 
 // reflect chainbase::environment for --print-build-info option
 FC_REFLECT_ENUM( chainbase::environment::os_t,
@@ -112,6 +122,43 @@ void validate(boost::any& v,
   }
 }
 
+std::ostream& operator<<(std::ostream& osm, eosio::chain::trace_level l) {
+   if ( l == eosio::chain::trace_level::NONE ) {
+      osm << "none";
+   } else if ( l == eosio::chain::trace_level::MINIMAL ) {
+      osm << "minimal";
+   } else if ( l == eosio::chain::trace_level::FULL ) {
+      osm << "full";
+   }
+
+   return osm;
+}
+
+void validate(boost::any& v,
+              const std::vector<std::string>& values,
+              eosio::chain::trace_level* /* target_type */,
+              int)
+{
+  using namespace boost::program_options;
+
+  // Make sure no previous assignment to 'v' was made.
+  validators::check_first_occurrence(v);
+
+  // Extract the first string from 'values'. If there is more than
+  // one string, it's an error, and exception will be thrown.
+  std::string const& s = validators::get_single_string(values);
+
+  if ( s == "none" ) {
+     v = boost::any(eosio::chain::trace_level::NONE);
+  } else if ( s == "minimal" ) {
+     v = boost::any(eosio::chain::trace_level::MINIMAL);
+  } else if ( s == "full" ) {
+     v = boost::any(eosio::chain::trace_level::FULL);
+  } else {
+     throw validation_error(validation_error::invalid_option_value);
+  }
+}
+
 }
 
 using namespace eosio;
@@ -152,7 +199,14 @@ public:
    //txn_msg_rate_limits              rate_limits;
    fc::optional<vm_type>            wasm_runtime;
    fc::microseconds                 abi_serializer_max_time_us;
+   fc::microseconds                 read_only_max_trx_time{ fc::milliseconds( 30 ) };
    fc::optional<bfs::path>          snapshot_path;
+   bool                             compacted_state = false; ///< snapshot_path is the compact-state snapshot
+   bool                             snapshot_from_delta = false; ///< snapshot_path was rebuilt from --snapshot-delta
+   bool                             eosvmoc_precompile = false;
+   uint32_t                         contract_profile_log_interval = 0;
+   uint32_t                         eosvmoc_sampling_rate = 0;
+   bfs::path                        eosvmoc_profile_file;
 
 
    // retained references to channels for easy publication
@@ -188,6 +242,7 @@ chain_plugin::chain_plugin()
 :my(new chain_plugin_impl()) {
    app().register_config_type<eosio::chain::db_read_mode>();
    app().register_config_type<eosio::chain::validation_mode>();
+   app().register_config_type<eosio::chain::trace_level>();
    app().register_config_type<chainbase::pinnable_mapped_file::map_mode>();
 }
 
@@ -212,14 +267,25 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
          }), "Override default WASM runtime")
          ("abi-serializer-max-time-ms", bpo::value<uint32_t>()->default_value(config::default_abi_serializer_max_time_us / 1000),
           "Override default maximum ABI serialization time allowed in ms")
+         ("read-only-max-transaction-time", bpo::value<uint32_t>()->default_value(30),
+          "Limit (between 1 and 1000) on the time in ms a transaction pushed to push_ro_transaction may run on the main thread, key recovery included")
          ("chain-state-db-size-mb", bpo::value<uint64_t>()->default_value(config::default_state_size / (1024  * 1024)), "Maximum size (in MiB) of the chain state database")
          ("chain-state-db-guard-size-mb", bpo::value<uint64_t>()->default_value(config::default_state_guard_size / (1024  * 1024)), "Safely shut down node when free space remaining in the chain state database drops below this size (in MiB).")
          ("reversible-blocks-db-size-mb", bpo::value<uint64_t>()->default_value(config::default_reversible_cache_size / (1024  * 1024)), "Maximum size (in MiB) of the reversible blocks database")
          ("reversible-blocks-db-guard-size-mb", bpo::value<uint64_t>()->default_value(config::default_reversible_guard_size / (1024  * 1024)), "Safely shut down node when free space remaining in the reverseible blocks database drops below this size (in MiB).")
          ("signature-cpu-billable-pct", bpo::value<uint32_t>()->default_value(config::default_sig_cpu_bill_pct / config::percent_1),
           "Percentage of actual signature recovery cpu to bill. Whole number percentages, e.g. 50 for 50%")
+         ("recovered-key-cache-size", bpo::value<uint32_t>()->default_value(recovered_key_cache::default_capacity),
+          "Number of recovered signature keys to cache so transactions and contracts verifying the same signature do not recover it again, 0 to disable")
+         ("abi-serializer-cache-size", bpo::value<uint32_t>()->default_value(abi_serializer_cache::default_capacity),
+          "Number of account ABIs to keep loaded for the APIs, instead of loading the ABI of an account again for every request, 0 to disable")
          ("chain-threads", bpo::value<uint16_t>()->default_value(config::default_controller_thread_pool_size),
           "Number of worker threads in controller thread pool")
+         ("chain-threads-cpu", bpo::value<vector<uint32_t>>()->composing(),
+          "CPU to pin a controller thread pool thread to, may be specified multiple times; threads are pinned to them in turn. "
+          "Giving the CPUs of one NUMA node keeps signature recovery on that node.")
+         ("replay-prefetch-depth", bpo::value<uint32_t>()->default_value(config::default_replay_prefetch_depth),
+          "Number of blocks read and unpacked ahead of application while replaying the block log")
          ("contracts-console", bpo::bool_switch()->default_value(false),
           "print contract's output to console")
          ("actor-whitelist", boost::program_options::value<vector<string>>()->composing()->multitoken(),
@@ -248,11 +314,48 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
           "Chain validation mode (\"full\" or \"light\").\n"
           "In \"full\" mode all incoming blocks will be fully validated.\n"
           "In \"light\" mode all incoming blocks headers will be fully validated; transactions in those validated blocks will be trusted \n")
+         ("trace-level", boost::program_options::value<eosio::chain::trace_level>()->default_value(eosio::chain::trace_level::FULL),
+          "How much of the action traces to record (\"none\", \"minimal\" or \"full\").\n"
+          "In \"full\" mode action traces have their receipts, exceptions, console output and RAM deltas.\n"
+          "In \"minimal\" mode action traces have no RAM deltas.\n"
+          "In \"none\" mode action traces have no receipts and no exceptions either, transaction traces are unchanged.\n"
+          "Plugins that store or serve traces require \"full\".")
          ("disable-ram-billing-notify-checks", bpo::bool_switch()->default_value(false),
           "Disable the check which subjectively fails a transaction if a contract bills more RAM to another account within the context of a notification handler (i.e. when the receiver is not the code of the action).")
+         ("wasm-module-cache", bpo::bool_switch()->default_value(false),
+          "Keep parsed and injected wasm modules in the state directory so that contracts do not have to be prepared again after a restart.")
+         ("wasm-module-cache-size-mb", bpo::value<uint64_t>()->default_value(1024),
+          "Maximum size (in MiB) the modules kept by wasm-module-cache may take on disk; least recently used modules are removed beyond it (0 for no limit)")
+         ("wasm-instantiation-cache-size-mb", bpo::value<uint64_t>()->default_value(0),
+          "Maximum size (in MiB) of wasm code and initial memory kept by instantiated modules; least recently used modules are evicted beyond it (0 for no limit)")
+         ("track-table-access", bpo::bool_switch()->default_value(false),
+          "Record the contract tables each transaction reads and writes while applying blocks and log how many conflict free waves each block could be applied in.")
+         ("fork-db-trx-metadata-depth", bpo::value<uint32_t>()->default_value(0),
+          "Number of blocks below the newest reversible block for which the fork database keeps the transaction metadata of blocks; older reversible blocks release it. 0 keeps it for all reversible blocks.")
+         ("table-lookup-cache", bpo::bool_switch()->default_value(false),
+          "Cache contract table and row point lookups within each transaction and count hits and misses per contract.")
+         ("key-account-index", bpo::bool_switch()->default_value(false),
+          "Index the permissions by the public keys they list, for get_accounts_by_keys. Built at startup from the state database.")
+         ("contract-profiling", bpo::value<bool>()->default_value(true),
+          "Count the calls, billed CPU and wall time, intrinsic calls and table operations of every action by receiver, for get_contract_profile.")
+         ("contract-profile-log-interval", bpo::value<uint32_t>()->default_value(0),
+          "Log the most expensive actions counted by contract-profiling every time this many blocks have been accepted (0 to not log them).")
+         ("state-checkpoint-interval", bpo::value<uint32_t>()->default_value(0),
+          "Record the state root of every block whose number is a multiple of this to state-checkpoints.log in the blocks directory. "
+          "A replay stops at the first such block whose state root differs. Each checkpoint hashes the whole state. 0 records none.")
+         ("block-log-flush-blocks", bpo::value<uint32_t>()->default_value(1),
+          "Flush the block log once this many blocks were appended (0 to flush on block-log-flush-interval-ms only). "
+          "Blocks not yet flushed are lost if the process dies, which requires a replay in any case.")
+         ("block-log-flush-interval-ms", bpo::value<uint32_t>()->default_value(0),
+          "Also flush the block log at the first block appended this long after the last flush (0 for no time limit).")
+         ("block-log-fsync", bpo::bool_switch()->default_value(false),
+          "fsync the block log after each flush, on a thread of its own so that block processing does not wait for it.")
          ("maximum-variable-signature-length", bpo::value<uint32_t>()->default_value(16384u),
           "Subjectively limit the maximum length of variable components in a variable legnth signature to this size in bytes")
          ("trusted-producer", bpo::value<vector<string>>()->composing(), "Indicate a producer whose blocks headers signed by it will be fully validated, but transactions in those validated blocks will be trusted.")
+         ("state-prefetch-pages", bpo::value<uint32_t>()->default_value(0),
+          "With database-map-mode = mapped, number of pages of the rows its recent actions touched to remember per contract and read in "
+          "on a background thread ahead of executing the transactions and blocks calling it, 0 to disable")
          ("database-map-mode", bpo::value<chainbase::pinnable_mapped_file::map_mode>()->default_value(chainbase::pinnable_mapped_file::map_mode::mapped),
           "Database map mode (\"mapped\", \"heap\", or \"locked\").\n"
           "In \"mapped\" mode database is memory mapped as a file.\n"
@@ -275,7 +378,24 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
                   EOS_ASSERT(false, plugin_exception, "");
                }
          }), "Number of threads to use for EOS VM OC tier-up")
+         ("eos-vm-oc-execution-threads", bpo::value<uint64_t>()->default_value(eosvmoc::config().execution_threads)->notifier([](const auto t) {
+               if(t == 0) {
+                  elog("eos-vm-oc-execution-threads must be set to a non-zero value");
+                  EOS_ASSERT(false, plugin_exception, "");
+               }
+         }), "Number of threads that may execute EOS VM OC compiled code at the same time, each with its own memory")
+         ("eos-vm-oc-transparent-huge-pages", bpo::bool_switch(),
+          "Back EOS VM OC linear memory with transparent huge pages; needs /sys/kernel/mm/transparent_hugepage/shmem_enabled set to advise, within_size or always")
+         ("eos-vm-oc-sampling-rate", bpo::value<uint32_t>()->default_value(0),
+          "Sample the wasm function EOS VM OC runs this many times per second of CPU time and write the counts as folded stacks to eos-vm-oc-profile-file at shutdown (0 to not sample)")
+         ("eos-vm-oc-profile-file", bpo::value<bfs::path>()->default_value("eos-vm-oc-profile.folded"),
+          "Folded stacks file of eos-vm-oc-sampling-rate. If a relative path is specified, it is relative to the data directory")
          ("eos-vm-oc-enable", bpo::bool_switch(), "Enable EOS VM OC tier-up runtime")
+         ("eos-vm-oc-precompile", bpo::bool_switch(), "Compile every deployed contract with EOS VM OC during startup, before the node starts processing blocks and transactions")
+         ("eos-vm-oc-tierup-executions", bpo::value<uint64_t>()->default_value(0),
+          "Number of executions on the baseline runtime before a contract is queued for EOS VM OC tier-up (0 to tier up on first use)")
+         ("eos-vm-oc-tierup-cpu-time-us", bpo::value<uint64_t>()->default_value(0),
+          "Cumulative cpu time, in microseconds, on the baseline runtime before a contract is queued for EOS VM OC tier-up (0 to disable this criterion)")
 #endif
          ;
 
@@ -312,6 +432,9 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
           "clear chain state database, recover as many blocks as possible from the block log, and then replay those blocks")
          ("delete-all-blocks", bpo::bool_switch()->default_value(false),
           "clear chain state database and block log")
+         ("compact-state", bpo::bool_switch()->default_value(false),
+          "rebuild the chain state database from a snapshot of its last irreversible block before starting, which leaves it without fragmentation "
+          "and the rows of each contract table next to each other")
          ("truncate-at-block", bpo::value<uint32_t>()->default_value(0),
           "stop hard replay / block log recovery at this block number (if set to non-zero number)")
          ("import-reversible-blocks", bpo::value<bfs::path>(),
@@ -319,6 +442,14 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
          ("export-reversible-blocks", bpo::value<bfs::path>(),
            "export reversible block database in portable format into specified file and then exit")
          ("snapshot", bpo::value<bfs::path>(), "File to read Snapshot State from")
+         ("snapshot-delta", bpo::value<vector<bfs::path>>()->composing()->multitoken(),
+          "Snapshot delta to apply onto --snapshot before reading it, may be specified multiple times to apply a chain of deltas in order")
+         ("terminate-at-block", bpo::value<uint32_t>()->default_value(0),
+          "replay the block log only up to this block number, log the integrity hash of the state there and exit (if set to non-zero number). "
+          "Started from a snapshot, the hash can be compared with the one logged when loading a later snapshot at that block.")
+         ("replay-profile", bpo::value<bfs::path>(),
+          "While replaying the block log, write the apply time, transaction and action counts and slowest contract of each block "
+          "as CSV to this file. If a relative path is specified, it is relative to the data directory.")
          ;
 
 }
@@ -569,6 +700,89 @@ protocol_feature_set initialize_protocol_features( const fc::path& p, bool popul
    return pfs;
 }
 
+/**
+ * Applies @ref deltas in order, the first onto @ref base and each following one onto the snapshot the one before
+ * rebuilt, alternating between two files in the data directory.
+ * @return the snapshot rebuilt by the last delta, for the caller to remove once it has been read
+ */
+bfs::path apply_snapshot_deltas( const bfs::path& base, const vector<bfs::path>& deltas ) {
+   const bfs::path outputs[] = { app().data_dir() / "snapshot-from-delta.bin", app().data_dir() / "snapshot-from-delta.bin.tmp" };
+   const auto start = fc::time_point::now();
+   bfs::path current = base;
+   for( size_t i = 0; i < deltas.size(); ++i ) {
+      // the last delta lands on outputs[0], so the one before it must write the other file
+      const auto& out_path = outputs[(deltas.size() - 1 - i) % 2];
+      EOS_ASSERT( fc::exists( deltas[i] ), plugin_config_exception,
+                  "Cannot apply snapshot delta, ${name} does not exist", ("name", deltas[i].generic_string()) );
+      auto base_in = std::ifstream( current.generic_string(), (std::ios::in | std::ios::binary) );
+      auto delta_in = std::ifstream( deltas[i].generic_string(), (std::ios::in | std::ios::binary) );
+      auto out = std::ofstream( out_path.generic_string(), (std::ios::out | std::ios::binary | std::ios::trunc) );
+      snapshot_delta::apply( base_in, delta_in, out );
+      out.flush();
+      out.close();
+      EOS_ASSERT( !out.fail(), plugin_config_exception, "Unable to write ${p}", ("p", out_path.generic_string()) );
+      current = out_path;
+   }
+   if( deltas.size() > 1 ) fc::remove( outputs[1] );
+
+   ilog( "startup: ${n} snapshot delta(s) applied onto ${base} in ${ms} ms",
+         ("n", deltas.size())("base", base.generic_string())("ms", (fc::time_point::now() - start).count() / 1000) );
+   return current;
+}
+
+/**
+ * Rewrites the state in @ref cfg into a snapshot of its last irreversible block and removes the state database, so
+ * the controller restores it from that snapshot into a fresh file, without the holes years of allocations and frees
+ * left in the old one. The snapshot holds the rows of a contract table together, so they are also allocated next to
+ * each other, which keeps scans of a table on few pages. The reversible blocks are kept and replayed on top of the
+ * restored state.
+ * @return the snapshot to start the controller from
+ */
+bfs::path compact_state( const controller::config& cfg, const fc::path& protocol_features_dir, const chain_id_type& chain_id ) {
+   const auto reversible_dir = cfg.blocks_dir / config::reversible_blocks_dir_name;
+   const auto reversible_blocks_file = cfg.state_dir / "compact-state-reversible.bin";
+   const auto snapshot_file = cfg.state_dir / "compact-state-snapshot.bin";
+   const auto start = fc::time_point::now();
+
+   const bool has_reversible_blocks = fc::is_regular_file( reversible_dir / "shared_memory.bin" );
+   if( has_reversible_blocks )
+      chain_plugin::export_reversible_blocks( reversible_dir, reversible_blocks_file );
+
+   {
+      // in irreversible mode the controller rolls the state back to the last irreversible block, which is the head
+      // of the block log a snapshot has to be read back in with
+      controller::config irreversible_cfg = cfg;
+      irreversible_cfg.read_mode = db_read_mode::IRREVERSIBLE;
+      controller chain( irreversible_cfg, initialize_protocol_features( protocol_features_dir, false ), chain_id );
+      chain.add_indices();
+      chain.startup( [](){ return app().is_quiting(); } );
+      EOS_ASSERT( !app().is_quiting(), plugin_config_exception, "shut down while compacting the state database" );
+
+      const auto* sm = chain.db().get_segment_manager();
+      ilog( "Compacting state database at block ${num}, ${used} bytes in use",
+            ("num", chain.head_block_num())("used", sm->get_size() - sm->get_free_memory()) );
+
+      auto snap_out = std::ofstream( snapshot_file.generic_string(), (std::ios::out | std::ios::binary) );
+      auto writer = std::make_shared<ostream_snapshot_writer>( snap_out );
+      chain.write_snapshot( writer );
+      writer->finalize();
+      snap_out.flush();
+      snap_out.close();
+   }
+
+   clear_chainbase_files( cfg.state_dir );
+   if( has_reversible_blocks ) {
+      fc::remove_all( reversible_dir );
+      if( fc::file_size( reversible_blocks_file ) > 0 )
+         chain_plugin::import_reversible_blocks( reversible_dir, cfg.reversible_cache_size, reversible_blocks_file );
+      fc::remove( reversible_blocks_file );
+   }
+
+   ilog( "startup: state written to ${file} in ${ms} ms",
+         ("file", snapshot_file.generic_string())("ms", (fc::time_point::now() - start).count() / 1000) );
+   return snapshot_file;
+}
+
 void
 chain_plugin::do_hard_replay(const variables_map& options) {
          ilog( "Hard replay requested: deleting state database" );
@@ -662,16 +876,22 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
             my->blocks_dir = bld;
       }
 
-      protocol_feature_set pfs;
+      // parsed while the block log and snapshot are checked for the chain id, the controller takes them
+      std::future<protocol_feature_set> pfs;
+      fc::path protocol_features_dir;
       {
-         fc::path protocol_features_dir;
          auto pfd = options.at( "protocol-features-dir" ).as<bfs::path>();
          if( pfd.is_relative())
             protocol_features_dir = app().config_dir() / pfd;
          else
             protocol_features_dir = pfd;
 
-         pfs = initialize_protocol_features( protocol_features_dir );
+         pfs = std::async( std::launch::async, [protocol_features_dir]() {
+            const auto start = fc::time_point::now();
+            auto result = initialize_protocol_features( protocol_features_dir );
+            ilog( "startup: protocol features loaded in ${ms} ms", ("ms", (fc::time_point::now() - start).count() / 1000) );
+            return result;
+         } );
       }
 
       if( options.count("checkpoint") ) {
@@ -698,6 +918,11 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
       if(options.count("abi-serializer-max-time-ms"))
          my->abi_serializer_max_time_us = fc::microseconds(options.at("abi-serializer-max-time-ms").as<uint32_t>() * 1000);
 
+      const uint32_t read_only_max_trx_time_ms = options.at( "read-only-max-transaction-time" ).as<uint32_t>();
+      EOS_ASSERT( read_only_max_trx_time_ms > 0 && read_only_max_trx_time_ms <= 1000, plugin_config_exception,
+                  "read-only-max-transaction-time ${t} must be between 1 and 1000", ("t", read_only_max_trx_time_ms) );
+      my->read_only_max_trx_time = fc::milliseconds( read_only_max_trx_time_ms );
+
       my->chain_config->blocks_dir = my->blocks_dir;
       my->chain_config->state_dir = app().data_dir() / config::default_state_dir_name;
       my->chain_config->read_only = my->readonly;
@@ -720,12 +945,22 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
          EOS_ASSERT( my->chain_config->thread_pool_size > 0, plugin_config_exception,
                      "chain-threads ${num} must be greater than 0", ("num", my->chain_config->thread_pool_size) );
       }
+      if( options.count( "chain-threads-cpu" )) {
+         my->chain_config->thread_pool_cpus = options.at( "chain-threads-cpu" ).as<vector<uint32_t>>();
+      }
+
+      my->chain_config->replay_prefetch_depth = options.at( "replay-prefetch-depth" ).as<uint32_t>();
+      EOS_ASSERT( my->chain_config->replay_prefetch_depth > 0, plugin_config_exception,
+                  "replay-prefetch-depth ${num} must be greater than 0", ("num", my->chain_config->replay_prefetch_depth) );
 
       my->chain_config->sig_cpu_bill_pct = options.at("signature-cpu-billable-pct").as<uint32_t>();
       EOS_ASSERT( my->chain_config->sig_cpu_bill_pct >= 0 && my->chain_config->sig_cpu_bill_pct <= 100, plugin_config_exception,
                   "signature-cpu-billable-pct must be 0 - 100, ${pct}", ("pct", my->chain_config->sig_cpu_bill_pct) );
       my->chain_config->sig_cpu_bill_pct *= config::percent_1;
 
+      recovered_key_cache::set_capacity( options.at( "recovered-key-cache-size" ).as<uint32_t>() );
+      abi_serializer_cache::set_capacity( options.at( "abi-serializer-cache-size" ).as<uint32_t>() );
+
       if( my->wasm_runtime )
          my->chain_config->wasm_runtime = *my->wasm_runtime;
 
@@ -734,6 +969,30 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
       my->chain_config->contracts_console = options.at( "contracts-console" ).as<bool>();
       my->chain_config->allow_ram_billing_in_notify = options.at( "disable-ram-billing-notify-checks" ).as<bool>();
       my->chain_config->maximum_variable_signature_length = options.at( "maximum-variable-signature-length" ).as<uint32_t>();
+      my->chain_config->track_table_access = options.at( "track-table-access" ).as<bool>();
+      my->chain_config->table_lookup_cache = options.at( "table-lookup-cache" ).as<bool>();
+      my->chain_config->key_account_index = options.at( "key-account-index" ).as<bool>();
+      my->chain_config->profile_contracts = options.at( "contract-profiling" ).as<bool>();
+      my->contract_profile_log_interval = options.at( "contract-profile-log-interval" ).as<uint32_t>();
+      EOS_ASSERT( my->contract_profile_log_interval == 0 || my->chain_config->profile_contracts, plugin_config_exception,
+                  "contract-profile-log-interval requires contract-profiling" );
+      my->chain_config->fork_db_trx_metas_depth = options.at( "fork-db-trx-metadata-depth" ).as<uint32_t>();
+      my->chain_config->state_checkpoint_interval = options.at( "state-checkpoint-interval" ).as<uint32_t>();
+      my->chain_config->terminate_at_block = options.at( "terminate-at-block" ).as<uint32_t>();
+      if( options.count( "replay-profile" )) {
+         auto rpf = options.at( "replay-profile" ).as<bfs::path>();
+         if( rpf.is_relative())
+            my->chain_config->replay_profile_file = app().data_dir() / rpf;
+         else
+            my->chain_config->replay_profile_file = rpf;
+      }
+      my->chain_config->block_log_durability.flush_blocks = options.at( "block-log-flush-blocks" ).as<uint32_t>();
+      my->chain_config->block_log_durability.flush_interval =
+            fc::milliseconds( options.at( "block-log-flush-interval-ms" ).as<uint32_t>() );
+      my->chain_config->block_log_durability.fsync = options.at( "block-log-fsync" ).as<bool>();
+      my->chain_config->persistent_wasm_module_cache = options.at( "wasm-module-cache" ).as<bool>();
+      my->chain_config->wasm_module_cache_size = options.at( "wasm-module-cache-size-mb" ).as<uint64_t>() * 1024u * 1024u;
+      my->chain_config->wasm_instantiation_cache_size = options.at( "wasm-instantiation-cache-size-mb" ).as<uint64_t>() * 1024u * 1024u;
 
       if( options.count( "extract-genesis-json" ) || options.at( "print-genesis-json" ).as<bool>()) {
          fc::optional<genesis_state> gs;
@@ -836,17 +1095,30 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
       }
 
       fc::optional<chain_id_type> chain_id;
+      EOS_ASSERT( options.count( "snapshot-delta" ) == 0 || options.count( "snapshot" ), plugin_config_exception,
+                  "--snapshot-delta requires --snapshot set to the base the delta was made against" );
       if (options.count( "snapshot" )) {
          my->snapshot_path = options.at( "snapshot" ).as<bfs::path>();
          EOS_ASSERT( fc::exists(*my->snapshot_path), plugin_config_exception,
                      "Cannot load snapshot, ${name} does not exist", ("name", my->snapshot_path->generic_string()) );
 
+         if( options.count( "snapshot-delta" ) ) {
+            my->snapshot_path = apply_snapshot_deltas( *my->snapshot_path, options.at( "snapshot-delta" ).as<vector<bfs::path>>() );
+            my->snapshot_from_delta = true;
+         }
+
          // recover genesis information from the snapshot
          // used for validation code below
          auto infile = std::ifstream(my->snapshot_path->generic_string(), (std::ios::in | std::ios::binary));
-         istream_snapshot_reader reader(infile);
-         reader.validate();
-         chain_id = controller::extract_chain_id(reader);
+         if( compressed_istream_snapshot_reader::is_compressed(infile) ) {
+            compressed_istream_snapshot_reader reader(infile);
+            reader.validate();
+            chain_id = controller::extract_chain_id(reader);
+         } else {
+            mapped_snapshot_reader reader(*my->snapshot_path);
+            reader.validate();
+            chain_id = controller::extract_chain_id(reader);
+         }
          infile.close();
 
          EOS_ASSERT( options.count( "genesis-timestamp" ) == 0,
@@ -1015,7 +1287,10 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
          my->chain_config->block_validation_mode = options.at("validation-mode").as<validation_mode>();
       }
 
+      my->chain_config->action_trace_level = options.at("trace-level").as<trace_level>();
+
       my->chain_config->db_map_mode = options.at("database-map-mode").as<pinnable_mapped_file::map_mode>();
+      my->chain_config->state_prefetch_pages = options.at("state-prefetch-pages").as<uint32_t>();
 #ifdef __linux__
       if( options.count("database-hugepage-path") )
          my->chain_config->db_hugepage_paths = options.at("database-hugepage-path").as<std::vector<std::string>>();
@@ -1026,11 +1301,33 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
          my->chain_config->eosvmoc_config.cache_size = options.at( "eos-vm-oc-cache-size-mb" ).as<uint64_t>() * 1024u * 1024u;
       if( options.count("eos-vm-oc-compile-threads") )
          my->chain_config->eosvmoc_config.threads = options.at("eos-vm-oc-compile-threads").as<uint64_t>();
+      if( options.count("eos-vm-oc-execution-threads") )
+         my->chain_config->eosvmoc_config.execution_threads = options.at("eos-vm-oc-execution-threads").as<uint64_t>();
+      my->chain_config->eosvmoc_config.transparent_huge_pages = options.at("eos-vm-oc-transparent-huge-pages").as<bool>();
       if( options["eos-vm-oc-enable"].as<bool>() )
          my->chain_config->eosvmoc_tierup = true;
+      my->eosvmoc_precompile = options.at("eos-vm-oc-precompile").as<bool>();
+      my->chain_config->eosvmoc_config.tierup_execution_threshold = options.at("eos-vm-oc-tierup-executions").as<uint64_t>();
+      my->chain_config->eosvmoc_config.tierup_cpu_time_threshold_us = options.at("eos-vm-oc-tierup-cpu-time-us").as<uint64_t>();
+      my->eosvmoc_sampling_rate = options.at("eos-vm-oc-sampling-rate").as<uint32_t>();
+      my->eosvmoc_profile_file = options.at("eos-vm-oc-profile-file").as<bfs::path>();
+      if( my->eosvmoc_profile_file.is_relative() )
+         my->eosvmoc_profile_file = app().data_dir() / my->eosvmoc_profile_file;
 #endif
 
-      my->chain.emplace( *my->chain_config, std::move(pfs), *chain_id );
+      if( options.at( "compact-state" ).as<bool>() ) {
+         EOS_ASSERT( !my->snapshot_path, plugin_config_exception, "--compact-state is incompatible with --snapshot" );
+         EOS_ASSERT( fc::is_regular_file( my->chain_config->state_dir / "shared_memory.bin" ), plugin_config_exception,
+                     "--compact-state requires an existing chain state database" );
+         // the protocol features directory may still be populated with the missing builtins
+         pfs.wait();
+         my->snapshot_path = compact_state( *my->chain_config, protocol_features_dir, *chain_id );
+         my->compacted_state = true;
+      }
+
+      const auto construction_start = fc::time_point::now();
+      my->chain.emplace( *my->chain_config, pfs.get(), *chain_id );
+      ilog( "startup: controller constructed in ${ms} ms", ("ms", (fc::time_point::now() - construction_start).count() / 1000) );
 
       // set up method providers
       my->get_block_by_number_provider = app().get_method<methods::get_block_by_number>().register_provider(
@@ -1072,6 +1369,15 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
             } );
 
       my->accepted_block_connection = my->chain->accepted_block.connect( [this]( const block_state_ptr& blk ) {
+         if( my->contract_profile_log_interval > 0 && blk->block_num % my->contract_profile_log_interval == 0 ) {
+            const auto top = my->chain->get_contract_profiler().entries( 10 );
+            ilog( "most billed CPU of actions since startup, at block ${n}:", ("n", blk->block_num) );
+            for( const auto& e : top ) {
+               ilog( "${r} ${a}::${act} calls ${c} failed ${f} billed ${cpu}us wall ${w}us intrinsics ${i} db ops ${d}",
+                     ("r", e.receiver)("a", e.account)("act", e.action)("c", e.calls)("f", e.failures)
+                     ("cpu", e.billed_cpu_us)("w", e.wall_us)("i", e.intrinsic_calls)("d", e.db_ops) );
+            }
+         }
          my->accepted_block_channel.publish( priority::high, blk );
       } );
 
@@ -1098,18 +1404,39 @@ void chain_plugin::plugin_startup()
 { try {
    EOS_ASSERT( my->chain_config->read_mode != db_read_mode::IRREVERSIBLE || !accept_transactions(), plugin_config_exception,
                "read-mode = irreversible. transactions should not be enabled by enable_accept_transactions" );
+   // every plugin has been initialized by now, so the enabled ones are known
+   if( my->chain_config->action_trace_level != trace_level::FULL ) {
+      for( const char* name : { "eosio::history_plugin", "eosio::state_history_plugin", "eosio::trace_api_plugin", "eosio::mongo_db_plugin" } ) {
+         const abstract_plugin* plugin = app().find_plugin( name );
+         EOS_ASSERT( !plugin || plugin->get_state() == abstract_plugin::registered, plugin_config_exception,
+                     "${p} requires trace-level = full", ("p", name) );
+      }
+   }
    try {
       auto shutdown = [](){ return app().is_quiting(); };
+      const auto startup_start = fc::time_point::now();
       if (my->snapshot_path) {
          auto infile = std::ifstream(my->snapshot_path->generic_string(), (std::ios::in | std::ios::binary));
-         auto reader = std::make_shared<istream_snapshot_reader>(infile);
+         snapshot_reader_ptr reader;
+         if( compressed_istream_snapshot_reader::is_compressed(infile) ) {
+            reader = std::make_shared<compressed_istream_snapshot_reader>(infile);
+         } else {
+            reader = std::make_shared<mapped_snapshot_reader>(*my->snapshot_path);
+         }
          my->chain->startup(shutdown, reader);
          infile.close();
+         if( my->snapshot_from_delta ) fc::remove( *my->snapshot_path );
+         if( my->compacted_state && !app().is_quiting() ) {
+            fc::remove( *my->snapshot_path );
+            const auto* sm = my->chain->db().get_segment_manager();
+            ilog( "Compacted state database, ${used} bytes in use", ("used", sm->get_size() - sm->get_free_memory()) );
+         }
       } else if( my->genesis ) {
          my->chain->startup(shutdown, *my->genesis);
       } else {
          my->chain->startup(shutdown);
       }
+      ilog( "startup: controller started in ${ms} ms", ("ms", (fc::time_point::now() - startup_start).count() / 1000) );
    } catch (const database_guard_exception& e) {
       log_guard_exception(e);
       // make sure to properly close the db
@@ -1117,6 +1444,16 @@ void chain_plugin::plugin_startup()
       throw;
    }
 
+   if( my->eosvmoc_precompile ) {
+      my->chain->get_wasm_interface().eosvmoc_precompile_all( [](){ return app().is_quiting(); } );
+   }
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+   if( my->eosvmoc_sampling_rate ) {
+      eosvmoc::sampling_profiler::start( my->eosvmoc_sampling_rate );
+      ilog( "sampling EOS VM OC code ${r} times per second of CPU time", ("r", my->eosvmoc_sampling_rate) );
+   }
+#endif
+
    if(!my->readonly) {
       ilog("starting chain in read/write mode");
    }
@@ -1129,6 +1466,18 @@ void chain_plugin::plugin_startup()
       ilog("Blockchain started; head block is #${num}", ("num", my->chain->head_block_num()));
    }
 
+   if( my->chain_config->terminate_at_block > 0 ) {
+      const auto head_num = my->chain->head_block_num();
+      if( head_num == my->chain_config->terminate_at_block ) {
+         ilog( "reached terminate-at-block ${num} ${id} with integrity hash ${hash}",
+               ("num", head_num)("id", my->chain->head_block_id())("hash", my->chain->calculate_integrity_hash()) );
+      } else {
+         elog( "head block #${head} is not terminate-at-block ${num}, the block log does not cover it",
+               ("head", head_num)("num", my->chain_config->terminate_at_block) );
+      }
+      app().quit();
+   }
+
    my->chain_config.reset();
 } FC_CAPTURE_AND_RETHROW() }
 
@@ -1141,13 +1490,26 @@ void chain_plugin::plugin_shutdown() {
    my->applied_transaction_connection.reset();
    if(app().is_quiting())
       my->chain->get_wasm_interface().indicate_shutting_down();
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+   if( my->eosvmoc_sampling_rate && my->chain ) {
+      eosvmoc::sampling_profiler::stop();
+      std::ofstream out( my->eosvmoc_profile_file.generic_string() );
+      eosvmoc::sampling_profiler::write_folded( out, my->chain->db() );
+      if( out.good() )
+         ilog( "wrote EOS VM OC profile to ${f}", ("f", my->eosvmoc_profile_file.generic_string()) );
+      else
+         wlog( "failed to write EOS VM OC profile to ${f}", ("f", my->eosvmoc_profile_file.generic_string()) );
+   }
+#endif
    my->chain.reset();
 }
 
-chain_apis::read_write::read_write(controller& db, const fc::microseconds& abi_serializer_max_time, bool api_accept_transactions)
+chain_apis::read_write::read_write(controller& db, const fc::microseconds& abi_serializer_max_time, bool api_accept_transactions,
+                                   const fc::microseconds& read_only_max_trx_time)
 : db(db)
 , abi_serializer_max_time(abi_serializer_max_time)
 , api_accept_transactions(api_accept_transactions)
+, read_only_max_trx_time(read_only_max_trx_time)
 {
 }
 
@@ -1393,6 +1755,10 @@ bool chain_plugin::api_accept_transactions() const{
    return my->api_accept_transactions;
 }
 
+fc::microseconds chain_plugin::get_read_only_max_transaction_time() const {
+   return my->read_only_max_trx_time;
+}
+
 bool chain_plugin::accept_transactions() const {
    return my->accept_transactions;
 }
@@ -1664,13 +2030,17 @@ string convert_to_string(const float128_t& source, const string& key_type, const
    } FC_RETHROW_EXCEPTIONS(warn, "Could not convert ${desc} from '${source}' to string.", ("desc", desc)("source",source) )
 }
 
-abi_def get_abi( const controller& db, const name& account ) {
+const abi_serializer_cache::cached_abi_ptr& no_cached_abi() {
+   static const abi_serializer_cache::cached_abi_ptr no_abi = std::make_shared<const abi_serializer_cache::cached_abi>();
+   return no_abi;
+}
+
+/// @return the cached ABI of @ref account, an empty ABI if it has none
+abi_serializer_cache::cached_abi_ptr get_cached_abi( const controller& db, const name& account, const fc::microseconds& max_serialization_time ) {
    const auto &d = db.db();
-   const account_object *code_accnt = d.find<account_object, by_name>(account);
-   EOS_ASSERT(code_accnt != nullptr, chain::account_query_exception, "Fail to retrieve account for ${account}", ("account", account) );
-   abi_def abi;
-   abi_serializer::to_abi(code_accnt->abi, abi);
-   return abi;
+   EOS_ASSERT(d.find<account_object, by_name>(account) != nullptr, chain::account_query_exception, "Fail to retrieve account for ${account}", ("account", account) );
+   auto result = abi_serializer_cache::get( d, account, max_serialization_time );
+   return result ? result : no_cached_abi();
 }
 
 string get_table_type( const abi_def& abi, const name& table_name ) {
@@ -1683,52 +2053,152 @@ string get_table_type( const abi_def& abi, const name& table_name ) {
 }
 
 read_only::get_table_rows_result read_only::get_table_rows( const read_only::get_table_rows_params& p )const {
-   const abi_def abi = eosio::chain_apis::get_abi( db, p.code );
+   return get_table_rows( p, nullptr );
+}
+
+string read_only::get_table_rows_json( const read_only::get_table_rows_params& p )const {
+   const auto deadline = fc::time_point::now() + abi_serializer_max_time;
+   string rows;
+   auto result = get_table_rows( p, &rows );
+   string json = R"({"rows":[)";
+   json += rows;
+   json += R"(],"more":)";
+   json += result.more ? "true" : "false";
+   json += R"(,"next_key":)";
+   json += fc::json::to_string( fc::variant( result.next_key ), deadline );
+   json += R"(,"next_cursor":)";
+   json += fc::json::to_string( fc::variant( result.next_cursor ), deadline );
+   json += '}';
+   return json;
+}
+
+bytes read_only::get_table_rows_packed( const read_only::get_table_rows_params& p )const {
+   auto params = p;
+   params.json = false;
+   auto result = get_table_rows( params, nullptr );
+
+   get_table_rows_packed_result packed;
+   packed.rows.reserve( result.rows.size() );
+   for( const auto& row : result.rows ) {
+      if( row.is_object() ) {
+         packed.rows.push_back( { row["data"].as<bytes>(), row["payer"].as<name>() } );
+      } else {
+         packed.rows.push_back( { row.as<bytes>(), name() } );
+      }
+   }
+   packed.more = result.more;
+   packed.next_key = std::move( result.next_key );
+   packed.next_cursor = std::move( result.next_cursor );
+   return fc::raw::pack( packed );
+}
+
+void read_only::add_table_row( const read_only::get_table_rows_params& p, const abi_serializer& abis, const vector<char>& data, name payer,
+                               read_only::get_table_rows_result& result, string* json_rows )const {
+   const bool show_payer = p.show_payer && *p.show_payer;
+   if( json_rows ) {
+      if( !json_rows->empty() ) *json_rows += ',';
+      if( show_payer ) *json_rows += R"({"data":)";
+      if( p.json ) {
+         abis.binary_to_json( abis.get_table_type(p.table), data, *json_rows, abi_serializer_max_time, shorten_abi_errors );
+      } else {
+         *json_rows += '"';
+         *json_rows += fc::to_hex( data.data(), data.size() );
+         *json_rows += '"';
+      }
+      if( show_payer ) {
+         *json_rows += R"(,"payer":")";
+         *json_rows += payer.to_string();
+         *json_rows += R"("})";
+      }
+      return;
+   }
+
+   fc::variant data_var;
+   if( p.json ) {
+      data_var = abis.binary_to_variant( abis.get_table_type(p.table), data, abi_serializer_max_time, shorten_abi_errors );
+   } else {
+      data_var = fc::variant( data );
+   }
+
+   if( show_payer ) {
+      result.rows.emplace_back( fc::mutable_variant_object("data", std::move(data_var))("payer", payer) );
+   } else {
+      result.rows.emplace_back( std::move(data_var) );
+   }
+}
+
+string read_only::write_table_rows_cursor( const read_only::get_table_rows_params& p, name scope, uint64_t index,
+                                           bytes secondary, uint64_t primary ) {
+   table_rows_cursor c{ p.code, scope, p.table, index, p.reverse && *p.reverse, std::move(secondary), primary };
+   const auto packed = fc::raw::pack( c );
+   return fc::to_hex( packed.data(), packed.size() );
+}
+
+read_only::table_rows_cursor read_only::read_table_rows_cursor( const read_only::get_table_rows_params& p, name scope, uint64_t index ) {
+   table_rows_cursor c;
+   try {
+      vector<char> packed( p.cursor->size() / 2 );
+      EOS_ASSERT( fc::from_hex( *p.cursor, packed.data(), packed.size() ) == packed.size(), chain::contract_table_query_exception, "Invalid cursor" );
+      c = fc::raw::unpack<table_rows_cursor>( packed );
+   } EOS_RETHROW_EXCEPTIONS( chain::contract_table_query_exception, "Invalid cursor ${c}", ("c", *p.cursor) )
+   EOS_ASSERT( c.code == p.code && c.scope == scope && c.table == p.table && c.index == index && c.reverse == (p.reverse && *p.reverse),
+               chain::contract_table_query_exception, "Cursor ${c} is not for this table, index and direction", ("c", *p.cursor) );
+   return c;
+}
+
+read_only::get_table_rows_result read_only::get_table_rows( const read_only::get_table_rows_params& p, string* json_rows )const {
+   // rows returned as binary need no ABI
+   const auto cached_abi = p.json ? get_cached_abi( db, p.code, abi_serializer_max_time ) : no_cached_abi();
+   const abi_def& abi = cached_abi->abi;
+   const abi_serializer& abis = cached_abi->serializer;
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wstrict-aliasing"
    bool primary = false;
    auto table_with_index = get_table_index_name( p, primary );
    if( primary ) {
       EOS_ASSERT( p.table == table_with_index, chain::contract_table_query_exception, "Invalid table name ${t}", ( "t", p.table ));
+      if( !p.json ) {
+         return get_table_rows_ex<key_value_index>(p, abis, json_rows);
+      }
       auto table_type = get_table_type( abi, p.table );
       if( table_type == KEYi64 || p.key_type == "i64" || p.key_type == "name" ) {
-         return get_table_rows_ex<key_value_index>(p,abi);
+         return get_table_rows_ex<key_value_index>(p, abis, json_rows);
       }
       EOS_ASSERT( false, chain::contract_table_query_exception,  "Invalid table type ${type}", ("type",table_type)("abi",abi));
    } else {
       EOS_ASSERT( !p.key_type.empty(), chain::contract_table_query_exception, "key type required for non-primary index" );
 
       if (p.key_type == chain_apis::i64 || p.key_type == "name") {
-         return get_table_rows_by_seckey<index64_index, uint64_t>(p, abi, [](uint64_t v)->uint64_t {
+         return get_table_rows_by_seckey<index64_index, uint64_t>(p, abis, json_rows, [](uint64_t v)->uint64_t {
             return v;
          });
       }
       else if (p.key_type == chain_apis::i128) {
-         return get_table_rows_by_seckey<index128_index, uint128_t>(p, abi, [](uint128_t v)->uint128_t {
+         return get_table_rows_by_seckey<index128_index, uint128_t>(p, abis, json_rows, [](uint128_t v)->uint128_t {
             return v;
          });
       }
       else if (p.key_type == chain_apis::i256) {
          if ( p.encode_type == chain_apis::hex) {
             using  conv = keytype_converter<chain_apis::sha256,chain_apis::hex>;
-            return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abi, conv::function());
+            return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abis, json_rows, conv::function());
          }
          using  conv = keytype_converter<chain_apis::i256>;
-         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abi, conv::function());
+         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abis, json_rows, conv::function());
       }
       else if (p.key_type == chain_apis::float64) {
-         return get_table_rows_by_seckey<index_double_index, double>(p, abi, [](double v)->float64_t {
+         return get_table_rows_by_seckey<index_double_index, double>(p, abis, json_rows, [](double v)->float64_t {
             float64_t f = *(float64_t *)&v;
             return f;
          });
       }
       else if (p.key_type == chain_apis::float128) {
          if ( p.encode_type == chain_apis::hex) {
-            return get_table_rows_by_seckey<index_long_double_index, uint128_t>(p, abi, [](uint128_t v)->float128_t{
+            return get_table_rows_by_seckey<index_long_double_index, uint128_t>(p, abis, json_rows, [](uint128_t v)->float128_t{
                return *reinterpret_cast<float128_t *>(&v);
             });
          }
-         return get_table_rows_by_seckey<index_long_double_index, double>(p, abi, [](double v)->float128_t{
+         return get_table_rows_by_seckey<index_long_double_index, double>(p, abis, json_rows, [](double v)->float128_t{
             float64_t f = *(float64_t *)&v;
             float128_t f128;
             f64_to_f128M(f, &f128);
@@ -1737,11 +2207,11 @@ read_only::get_table_rows_result read_only::get_table_rows( const read_only::get
       }
       else if (p.key_type == chain_apis::sha256) {
          using  conv = keytype_converter<chain_apis::sha256,chain_apis::hex>;
-         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abi, conv::function());
+         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abis, json_rows, conv::function());
       }
       else if(p.key_type == chain_apis::ripemd160) {
          using  conv = keytype_converter<chain_apis::ripemd160,chain_apis::hex>;
-         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abi, conv::function());
+         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abis, json_rows, conv::function());
       }
       EOS_ASSERT(false, chain::contract_table_query_exception,  "Unsupported secondary index type: ${t}", ("t", p.key_type));
    }
@@ -1798,8 +2268,7 @@ read_only::get_table_by_scope_result read_only::get_table_by_scope( const read_o
 
 vector<asset> read_only::get_currency_balance( const read_only::get_currency_balance_params& p )const {
 
-   const abi_def abi = eosio::chain_apis::get_abi( db, p.code );
-   (void)get_table_type( abi, name("accounts") );
+   (void)get_table_type( get_cached_abi( db, p.code, abi_serializer_max_time )->abi, name("accounts") );
 
    vector<asset> results;
    walk_key_value_table(p.code, p.account, N(accounts), [&](const key_value_object& obj){
@@ -1825,8 +2294,7 @@ vector<asset> read_only::get_currency_balance( const read_only::get_currency_bal
 fc::variant read_only::get_currency_stats( const read_only::get_currency_stats_params& p )const {
    fc::mutable_variant_object results;
 
-   const abi_def abi = eosio::chain_apis::get_abi( db, p.code );
-   (void)get_table_type( abi, name("stat") );
+   (void)get_table_type( get_cached_abi( db, p.code, abi_serializer_max_time )->abi, name("stat") );
 
    uint64_t scope = ( eosio::chain::string_to_symbol( 0, boost::algorithm::to_upper_copy(p.symbol).c_str() ) >> 8 );
 
@@ -1864,9 +2332,10 @@ fc::variant get_global_row( const database& db, const abi_def& abi, const abi_se
 }
 
 read_only::get_producers_result read_only::get_producers( const read_only::get_producers_params& p ) const try {
-   const abi_def abi = eosio::chain_apis::get_abi(db, config::system_account_name);
+   const auto cached_abi = get_cached_abi(db, config::system_account_name, abi_serializer_max_time);
+   const abi_def& abi = cached_abi->abi;
    const auto table_type = get_table_type(abi, N(producers));
-   const abi_serializer abis{ abi, abi_serializer_max_time };
+   const abi_serializer& abis = cached_abi->serializer;
    EOS_ASSERT(table_type == KEYi64, chain::contract_table_query_exception, "Invalid table type ${type} for table producers", ("type",table_type));
 
    const auto& d = db.db();
@@ -1950,16 +2419,8 @@ read_only::get_producer_schedule_result read_only::get_producer_schedule( const
 template<typename Api>
 struct resolver_factory {
    static auto make(const Api* api, const fc::microseconds& max_serialization_time) {
-      return [api, max_serialization_time](const account_name &name) -> optional<abi_serializer> {
-         const auto* accnt = api->db.db().template find<account_object, by_name>(name);
-         if (accnt != nullptr) {
-            abi_def abi;
-            if (abi_serializer::to_abi(accnt->abi, abi)) {
-               return abi_serializer(abi, max_serialization_time);
-            }
-         }
-
-         return optional<abi_serializer>();
+      return [api, max_serialization_time](const account_name &name) -> std::shared_ptr<const abi_serializer> {
+         return abi_serializer_cache::get_serializer(api->db.db(), name, max_serialization_time);
       };
    }
 };
@@ -2043,7 +2504,7 @@ read_only::get_scheduled_transactions( const read_only::get_scheduled_transactio
    return result;
 }
 
-fc::variant read_only::get_block(const read_only::get_block_params& params) const {
+signed_block_ptr fetch_block( const controller& db, const read_only::get_block_params& params ) {
    signed_block_ptr block;
    optional<uint64_t> block_num;
 
@@ -2065,6 +2526,11 @@ fc::variant read_only::get_block(const read_only::get_block_params& params) cons
    }
 
    EOS_ASSERT( block, unknown_block_exception, "Could not find block: ${block}", ("block", params.block_num_or_id));
+   return block;
+}
+
+fc::variant read_only::get_block(const read_only::get_block_params& params) const {
+   signed_block_ptr block = fetch_block( db, params );
 
    fc::variant pretty_output;
    abi_serializer::to_variant(*block, pretty_output, make_resolver(this, abi_serializer_max_time), abi_serializer_max_time);
@@ -2077,6 +2543,10 @@ fc::variant read_only::get_block(const read_only::get_block_params& params) cons
            ("ref_block_prefix", ref_block_prefix);
 }
 
+bytes read_only::get_block_packed(const read_only::get_block_params& params) const {
+   return fc::raw::pack( *fetch_block( db, params ) );
+}
+
 fc::variant read_only::get_block_header_state(const get_block_header_state_params& params) const {
    block_state_ptr b;
    optional<uint64_t> block_num;
@@ -2111,6 +2581,97 @@ void read_write::push_block(read_write::push_block_params&& params, next_functio
    } CATCH_AND_CALL(next);
 }
 
+namespace {
+   /// scanner of the flat JSON object parse_packed_transaction handles, every step is false on anything else
+   struct packed_transaction_scanner {
+      const char* pos;
+      const char* end;
+
+      void skip_ws() {
+         while( pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r') ) ++pos;
+      }
+      bool next_is( char c ) {
+         skip_ws();
+         if( pos < end && *pos == c ) {
+            ++pos;
+            return true;
+         }
+         return false;
+      }
+      /// a string without escapes
+      bool read_string( std::string_view& out ) {
+         if( !next_is( '"' ) ) return false;
+         const char* begin = pos;
+         while( pos < end && *pos != '"' ) {
+            if( *pos == '\\' || static_cast<unsigned char>(*pos) < 0x20 ) return false;
+            ++pos;
+         }
+         if( pos == end ) return false;
+         out = std::string_view( begin, pos - begin );
+         ++pos;
+         return true;
+      }
+      bool read_hex( bytes& out ) {
+         std::string_view hex;
+         if( !read_string( hex ) || hex.size() % 2 ) return false;
+         out.resize( hex.size() / 2 );
+         return fc::from_hex( string( hex ), out.data(), out.size() ) == out.size();
+      }
+   };
+}
+
+std::shared_ptr<packed_transaction> read_write::parse_packed_transaction( const string& json ) {
+   try {
+      packed_transaction_scanner in{ json.data(), json.data() + json.size() };
+      vector<signature_type> signatures;
+      optional<packed_transaction::compression_type> compression;
+      bytes packed_cfd;
+      bytes packed_trx;
+      bool has_signatures = false;
+
+      if( !in.next_is( '{' ) ) return {};
+      if( !in.next_is( '}' ) ) {
+         do {
+            std::string_view key;
+            if( !in.read_string( key ) || !in.next_is( ':' ) ) return {};
+            if( key == "signatures" && !has_signatures ) {
+               has_signatures = true;
+               if( !in.next_is( '[' ) ) return {};
+               if( !in.next_is( ']' ) ) {
+                  do {
+                     std::string_view sig;
+                     if( !in.read_string( sig ) ) return {};
+                     signatures.emplace_back( string( sig ) );
+                  } while( in.next_is( ',' ) );
+                  if( !in.next_is( ']' ) ) return {};
+               }
+            } else if( key == "compression" && !compression ) {
+               std::string_view c;
+               if( !in.read_string( c ) ) return {};
+               compression = fc::reflector<packed_transaction::compression_type>::from_string( string( c ).c_str() );
+            } else if( key == "packed_context_free_data" && packed_cfd.empty() ) {
+               if( !in.read_hex( packed_cfd ) ) return {};
+            } else if( key == "packed_trx" && packed_trx.empty() ) {
+               if( !in.read_hex( packed_trx ) ) return {};
+            } else {
+               return {};
+            }
+         } while( in.next_is( ',' ) );
+         if( !in.next_is( '}' ) ) return {};
+      }
+      in.skip_ws();
+      if( in.pos != in.end || !has_signatures || !compression || packed_trx.empty() ) return {};
+
+      // as abi_serializer::from_variant, an empty packed_context_free_data is no context free data
+      if( packed_cfd.empty() ) {
+         return std::make_shared<packed_transaction>( std::move( packed_trx ), std::move( signatures ), vector<bytes>(), *compression );
+      }
+      return std::make_shared<packed_transaction>( std::move( packed_trx ), std::move( signatures ), std::move( packed_cfd ), *compression );
+   } catch( ... ) {
+      return {};
+   }
+}
+
 void read_write::push_transaction(const read_write::push_transaction_params& params, next_function<read_write::push_transaction_results> next) {
    try {
       auto pretty_input = std::make_shared<packed_transaction>();
@@ -2119,6 +2680,16 @@ void read_write::push_transaction(const read_write::push_transaction_params& par
          abi_serializer::from_variant(params, *pretty_input, resolver, abi_serializer_max_time);
       } EOS_RETHROW_EXCEPTIONS(chain::packed_transaction_type_exception, "Invalid packed transaction")
 
+      push_transaction( std::move( pretty_input ), std::move( next ) );
+   } catch ( boost::interprocess::bad_alloc& ) {
+      chain_plugin::handle_db_exhaustion();
+   } catch ( const std::bad_alloc& ) {
+      chain_plugin::handle_bad_alloc();
+   } CATCH_AND_CALL(next);
+}
+
+void read_write::push_transaction(std::shared_ptr<packed_transaction> pretty_input, next_function<read_write::push_transaction_results> next) {
+   try {
       app().get_method<incoming::methods::transaction_async>()(pretty_input, true,
             [this, next](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& result) -> void {
          if (result.contains<fc::exception_ptr>()) {
@@ -2193,6 +2764,36 @@ void read_write::push_transaction(const read_write::push_transaction_params& par
    } CATCH_AND_CALL(next);
 }
 
+read_write::push_ro_transaction_results read_write::push_ro_transaction(const read_write::push_ro_transaction_params& params) {
+   try {
+      auto pretty_input = std::make_shared<packed_transaction>();
+      auto resolver = make_resolver(this, abi_serializer_max_time);
+      try {
+         abi_serializer::from_variant(params, *pretty_input, resolver, abi_serializer_max_time);
+      } EOS_RETHROW_EXCEPTIONS(chain::packed_transaction_type_exception, "Invalid packed transaction")
+
+      // runs on the main thread, so the keys are recovered within the same limit as the transaction itself
+      const auto deadline = fc::time_point::now() + read_only_max_trx_time;
+      auto fut = transaction_metadata::start_recover_keys( pretty_input, db.get_thread_pool(), db.get_chain_id(),
+                                                           read_only_max_trx_time, db.configured_subjective_signature_length_limit() );
+      auto trx_trace_ptr = db.push_read_only_transaction( fut.get(), deadline );
+
+      fc::variant output;
+      try {
+         output = db.to_variant_with_abi( *trx_trace_ptr, abi_serializer_max_time );
+      } catch( chain::abi_exception& ) {
+         output = *trx_trace_ptr;
+      }
+
+      return read_write::push_ro_transaction_results{ trx_trace_ptr->id, output };
+   } catch ( boost::interprocess::bad_alloc& ) {
+      chain_plugin::handle_db_exhaustion();
+   } catch ( const std::bad_alloc& ) {
+      chain_plugin::handle_bad_alloc();
+   }
+   return {};
+}
+
 static void push_recurse(read_write* rw, int index, const std::shared_ptr<read_write::push_transactions_params>& params, const std::shared_ptr<read_write::push_transactions_results>& results, const next_function<read_write::push_transactions_results>& next) {
    auto wrapped_next = [=](const fc::static_variant<fc::exception_ptr, read_write::push_transaction_results>& result) {
       if (result.contains<fc::exception_ptr>()) {
@@ -2238,6 +2839,17 @@ void read_write::send_transaction(const read_write::send_transaction_params& par
          abi_serializer::from_variant(params, *pretty_input, resolver, abi_serializer_max_time);
       } EOS_RETHROW_EXCEPTIONS(chain::packed_transaction_type_exception, "Invalid packed transaction")
 
+      send_transaction( std::move( pretty_input ), std::move( next ) );
+   } catch ( boost::interprocess::bad_alloc& ) {
+      chain_plugin::handle_db_exhaustion();
+   } catch ( const std::bad_alloc& ) {
+      chain_plugin::handle_bad_alloc();
+   } CATCH_AND_CALL(next);
+}
+
+void read_write::send_transaction(std::shared_ptr<packed_transaction> pretty_input, next_function<read_write::send_transaction_results> next) {
+
+   try {
       app().get_method<incoming::methods::transaction_async>()(pretty_input, true,
             [this, next](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& result) -> void {
          if (result.contains<fc::exception_ptr>()) {
@@ -2330,6 +2942,16 @@ read_only::get_raw_code_and_abi_results read_only::get_raw_code_and_abi( const g
    return result;
 }
 
+bytes read_only::get_raw_code_and_abi_packed( const get_raw_code_and_abi_params& params)const {
+   const auto result = get_raw_code_and_abi( params );
+   bytes packed( fc::raw::pack_size( result.account_name ) + fc::raw::pack_size( result.wasm.data ) + fc::raw::pack_size( result.abi.data ) );
+   fc::datastream<char*> ds( packed.data(), packed.size() );
+   fc::raw::pack( ds, result.account_name );
+   fc::raw::pack( ds, result.wasm.data );
+   fc::raw::pack( ds, result.abi.data );
+   return packed;
+}
+
 read_only::get_raw_abi_results read_only::get_raw_abi( const get_raw_abi_params& params )const {
    get_raw_abi_results result;
    result.account_name = params.account_name;
@@ -2346,6 +2968,72 @@ read_only::get_raw_abi_results read_only::get_raw_abi( const get_raw_abi_params&
    return result;
 }
 
+namespace {
+   /**
+    * The system contract rows get_account decodes, with their variants. Wallets query the same accounts over and over,
+    * and a row whose bytes and ABI are unchanged decodes to the same variant, so it is compared instead of decoded.
+    * Nothing is invalidated: a row written, rolled back or forked out since has other bytes, a new eosio ABI another
+    * cached_abi.
+    */
+   class system_row_cache {
+      public:
+         static constexpr size_t capacity = 10000;
+
+         static system_row_cache& instance() {
+            static system_row_cache cache;
+            return cache;
+         }
+
+         /// @return the variant of @ref data, from @ref decode( data ) unless it was decoded before with @ref abi
+         template<typename F>
+         fc::variant get( account_name account, name table, const abi_serializer_cache::cached_abi_ptr& abi,
+                          vector<char> data, F&& decode ) {
+            const key_type key{ account, table };
+            {
+               std::lock_guard<std::mutex> g( mtx );
+               auto itr = entries.find( key );
+               if( itr != entries.end() && itr->second.data == data && itr->second.abi.lock() == abi ) {
+                  order.splice( order.begin(), order, itr->second.position );
+                  return itr->second.value;
+               }
+            }
+            // decoded outside of the lock, an exception leaves nothing cached
+            fc::variant value = decode( data );
+
+            std::lock_guard<std::mutex> g( mtx );
+            auto itr = entries.find( key );
+            if( itr == entries.end() ) {
+               order.push_front( key );
+               itr = entries.emplace( key, entry{ {}, {}, {}, order.begin() } ).first;
+               if( entries.size() > capacity ) {
+                  entries.erase( order.back() );
+                  order.pop_back();
+               }
+            } else {
+               order.splice( order.begin(), order, itr->second.position );
+            }
+            itr->second.abi   = abi;
+            itr->second.data  = std::move( data );
+            itr->second.value = value;
+            return value;
+         }
+
+      private:
+         using key_type = std::pair<account_name, name>;
+
+         struct entry {
+            std::weak_ptr<const abi_serializer_cache::cached_abi> abi;
+            vector<char>                                          data;
+            fc::variant                                           value;
+            std::list<key_type>::iterator                         position;
+         };
+
+         std::mutex                    mtx;
+         std::list<key_type>           order; ///< most recently used first
+         std::map<key_type, entry>     entries;
+   };
+}
+
 read_only::get_account_results read_only::get_account( const get_account_params& params )const {
    get_account_results result;
    result.account_name = params.account_name;
@@ -2389,11 +3077,9 @@ read_only::get_account_results read_only::get_account( const get_account_params&
       ++perm;
    }
 
-   const auto& code_account = db.db().get<account_object,by_name>( config::system_account_name );
-
-   abi_def abi;
-   if( abi_serializer::to_abi(code_account.abi, abi) ) {
-      abi_serializer abis( abi, abi_serializer_max_time );
+   const auto cached_abi = abi_serializer_cache::get( db.db(), config::system_account_name, abi_serializer_max_time );
+   if( cached_abi ) {
+      const abi_serializer& abis = cached_abi->serializer;
 
       const auto token_code = N(eosio.token);
 
@@ -2417,60 +3103,25 @@ read_only::get_account_results read_only::get_account( const get_account_params&
          }
       }
 
-      t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple( config::system_account_name, params.account_name, N(userres) ));
-      if (t_id != nullptr) {
-         const auto &idx = d.get_index<key_value_index, by_scope_primary>();
-         auto it = idx.find(boost::make_tuple( t_id->id, params.account_name.to_uint64_t() ));
-         if ( it != idx.end() ) {
-            vector<char> data;
-            copy_inline_row(*it, data);
-            result.total_resources = abis.binary_to_variant( "user_resources", data, abi_serializer_max_time, shorten_abi_errors );
-         }
-      }
-
-      t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple( config::system_account_name, params.account_name, N(delband) ));
-      if (t_id != nullptr) {
-         const auto &idx = d.get_index<key_value_index, by_scope_primary>();
-         auto it = idx.find(boost::make_tuple( t_id->id, params.account_name.to_uint64_t() ));
-         if ( it != idx.end() ) {
-            vector<char> data;
-            copy_inline_row(*it, data);
-            result.self_delegated_bandwidth = abis.binary_to_variant( "delegated_bandwidth", data, abi_serializer_max_time, shorten_abi_errors );
-         }
-      }
-
-      t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple( config::system_account_name, params.account_name, N(refunds) ));
-      if (t_id != nullptr) {
+      // the rows of the system contract are decoded again only once their bytes or the eosio ABI change
+      auto decode_row = [&]( name scope, name table, const char* type, fc::variant& field ) {
+         const auto* t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple( config::system_account_name, scope, table ));
+         if( t_id == nullptr ) return;
          const auto &idx = d.get_index<key_value_index, by_scope_primary>();
          auto it = idx.find(boost::make_tuple( t_id->id, params.account_name.to_uint64_t() ));
-         if ( it != idx.end() ) {
-            vector<char> data;
-            copy_inline_row(*it, data);
-            result.refund_request = abis.binary_to_variant( "refund_request", data, abi_serializer_max_time, shorten_abi_errors );
-         }
-      }
-
-      t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple( config::system_account_name, config::system_account_name, N(voters) ));
-      if (t_id != nullptr) {
-         const auto &idx = d.get_index<key_value_index, by_scope_primary>();
-         auto it = idx.find(boost::make_tuple( t_id->id, params.account_name.to_uint64_t() ));
-         if ( it != idx.end() ) {
-            vector<char> data;
-            copy_inline_row(*it, data);
-            result.voter_info = abis.binary_to_variant( "voter_info", data, abi_serializer_max_time, shorten_abi_errors );
-         }
-      }
+         if( it == idx.end() ) return;
+         vector<char> data;
+         copy_inline_row(*it, data);
+         field = system_row_cache::instance().get( params.account_name, table, cached_abi, std::move(data), [&]( const vector<char>& row ) {
+            return abis.binary_to_variant( type, row, abi_serializer_max_time, shorten_abi_errors );
+         } );
+      };
 
-      t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple( config::system_account_name, config::system_account_name, N(rexbal) ));
-      if (t_id != nullptr) {
-         const auto &idx = d.get_index<key_value_index, by_scope_primary>();
-         auto it = idx.find(boost::make_tuple( t_id->id, params.account_name.to_uint64_t() ));
-         if( it != idx.end() ) {
-            vector<char> data;
-            copy_inline_row(*it, data);
-            result.rex_info = abis.binary_to_variant( "rex_balance", data, abi_serializer_max_time, shorten_abi_errors );
-         }
-      }
+      decode_row( params.account_name, N(userres), "user_resources", result.total_resources );
+      decode_row( params.account_name, N(delband), "delegated_bandwidth", result.self_delegated_bandwidth );
+      decode_row( params.account_name, N(refunds), "refund_request", result.refund_request );
+      decode_row( config::system_account_name, N(voters), "voter_info", result.voter_info );
+      decode_row( config::system_account_name, N(rexbal), "rex_balance", result.rex_info );
    }
    return result;
 }
@@ -2488,16 +3139,16 @@ read_only::abi_json_to_bin_result read_only::abi_json_to_bin( const read_only::a
    const auto code_account = db.db().find<account_object,by_name>( params.code );
    EOS_ASSERT(code_account != nullptr, contract_query_exception, "Contract can't be found ${contract}", ("contract", params.code));
 
-   abi_def abi;
-   if( abi_serializer::to_abi(code_account->abi, abi) ) {
-      abi_serializer abis( abi, abi_serializer_max_time );
+   const auto cached_abi = abi_serializer_cache::get( db.db(), params.code, abi_serializer_max_time );
+   if( cached_abi ) {
+      const abi_serializer& abis = cached_abi->serializer;
       auto action_type = abis.get_action_type(params.action);
       EOS_ASSERT(!action_type.empty(), action_validate_exception, "Unknown action ${action} in contract ${contract}", ("action", params.action)("contract", params.code));
       try {
          result.binargs = abis.variant_to_binary( action_type, params.args, abi_serializer_max_time, shorten_abi_errors );
       } EOS_RETHROW_EXCEPTIONS(chain::invalid_action_args_exception,
                                 "'${args}' is invalid args for action '${action}' code '${code}'. expected '${proto}'",
-                                ("args", params.args)("action", params.action)("code", params.code)("proto", action_abi_to_variant(abi, action_type)))
+                                ("args", params.args)("action", params.action)("code", params.code)("proto", action_abi_to_variant(cached_abi->abi, action_type)))
    } else {
       EOS_ASSERT(false, abi_not_found_exception, "No ABI found for ${contract}", ("contract", params.code));
    }
@@ -2507,10 +3158,10 @@ read_only::abi_json_to_bin_result read_only::abi_json_to_bin( const read_only::a
 
 read_only::abi_bin_to_json_result read_only::abi_bin_to_json( const read_only::abi_bin_to_json_params& params )const {
    abi_bin_to_json_result result;
-   const auto& code_account = db.db().get<account_object,by_name>( params.code );
-   abi_def abi;
-   if( abi_serializer::to_abi(code_account.abi, abi) ) {
-      abi_serializer abis( abi, abi_serializer_max_time );
+   db.db().get<account_object,by_name>( params.code ); // throws for an unknown account
+   const auto cached_abi = abi_serializer_cache::get( db.db(), params.code, abi_serializer_max_time );
+   if( cached_abi ) {
+      const abi_serializer& abis = cached_abi->serializer;
       result.args = abis.binary_to_variant( abis.get_action_type( params.action ), params.binargs, abi_serializer_max_time, shorten_abi_errors );
    } else {
       EOS_ASSERT(false, abi_not_found_exception, "No ABI found for ${contract}", ("contract", params.code));
@@ -2535,6 +3186,28 @@ read_only::get_transaction_id_result read_only::get_transaction_id( const read_o
    return params.id();
 }
 
+read_only::get_abi_cache_stats_results read_only::get_abi_cache_stats( const get_abi_cache_stats_params& )const {
+   return abi_serializer_cache::get_stats();
+}
+
+read_only::get_contract_profile_results read_only::get_contract_profile( const get_contract_profile_params& params )const {
+   return { db.get_contract_profiler().entries( params.limit ) };
+}
+
+read_only::get_accounts_by_keys_result read_only::get_accounts_by_keys( const get_accounts_by_keys_params& params )const {
+   const auto& authorization = db.get_authorization_manager();
+   EOS_ASSERT( authorization.key_account_index_enabled(), chain::account_query_exception,
+               "get_accounts_by_keys needs nodeos started with --key-account-index" );
+   EOS_ASSERT( params.keys.size() <= max_keys_per_lookup, chain::account_query_exception,
+               "At most ${max} keys can be looked up at once", ("max", max_keys_per_lookup) );
+
+   const flat_set<public_key_type> unique_keys( params.keys.begin(), params.keys.end() );
+   get_accounts_by_keys_result result;
+   for( const auto& m : authorization.find_key_accounts( vector<public_key_type>( unique_keys.begin(), unique_keys.end() ) ) )
+      result.accounts.push_back( key_account{ m.key, m.permission.actor, m.permission.permission, m.weight, m.threshold } );
+   return result;
+}
+
 namespace detail {
    struct ram_market_exchange_state_t {
       asset  ignore1;
@@ -9,6 +9,7 @@
 #include <eosio/chain/resource_limits.hpp>
 #include <eosio/chain/transaction.hpp>
 #include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/abi_serializer_cache.hpp>
 #include <eosio/chain/plugin_interface.hpp>
 #include <eosio/chain/types.hpp>
 #include <eosio/chain/fixed_bytes.hpp>
@@ -231,6 +232,8 @@ public:
    get_code_hash_results get_code_hash( const get_code_hash_params& params )const;
    get_abi_results get_abi( const get_abi_params& params )const;
    get_raw_code_and_abi_results get_raw_code_and_abi( const get_raw_code_and_abi_params& params)const;
+   /// @return get_raw_code_and_abi packed as {name account_name; bytes wasm; bytes abi}
+   chain::bytes get_raw_code_and_abi_packed( const get_raw_code_and_abi_params& params)const;
    get_raw_abi_results get_raw_abi( const get_raw_abi_params& params)const;
 
 
@@ -274,11 +277,50 @@ public:
 
    get_transaction_id_result get_transaction_id( const get_transaction_id_params& params)const;
 
+   using get_abi_cache_stats_params = empty;
+   using get_abi_cache_stats_results = chain::abi_serializer_cache::stats;
+
+   get_abi_cache_stats_results get_abi_cache_stats( const get_abi_cache_stats_params& )const;
+
+   struct get_contract_profile_params {
+      uint32_t limit = 100;
+   };
+
+   /// the actions with the most billed CPU time since startup, empty when contract-profiling is disabled
+   struct get_contract_profile_results {
+      vector<chain::contract_profiler::entry> entries;
+   };
+
+   get_contract_profile_results get_contract_profile( const get_contract_profile_params& params )const;
+
+   struct get_accounts_by_keys_params {
+      vector<public_key_type> keys;
+   };
+
+   struct key_account {
+      public_key_type   key;
+      name              account;
+      name              permission;
+      uint16_t          weight    = 0;
+      uint32_t          threshold = 0;
+   };
+
+   /// the permissions that list one of the keys directly, ordered by key; needs key-account-index
+   struct get_accounts_by_keys_result {
+      vector<key_account> accounts;
+   };
+
+   static constexpr size_t max_keys_per_lookup = 1000;
+
+   get_accounts_by_keys_result get_accounts_by_keys( const get_accounts_by_keys_params& params )const;
+
    struct get_block_params {
       string block_num_or_id;
    };
 
    fc::variant get_block(const get_block_params& params) const;
+   /// @return the signed_block packed as it is in the block log
+   chain::bytes get_block_packed(const get_block_params& params) const;
 
    struct get_block_header_state_params {
       string block_num_or_id;
@@ -300,15 +342,46 @@ public:
       string      encode_type{"dec"}; //dec, hex , default=dec
       optional<bool>  reverse;
       optional<bool>  show_payer; // show RAM pyer
+      optional<string> cursor; // next_cursor of the previous request, continues right where it stopped
     };
 
    struct get_table_rows_result {
       vector<fc::variant> rows; ///< one row per item, either encoded as hex String or JSON object
       bool                more = false; ///< true if last element in data is not the end and sizeof data() < limit
       string              next_key; ///< fill lower_bound with this value to fetch more rows
+      string              next_cursor; ///< pass as cursor to fetch more rows, unlike next_key exact for non unique secondary keys
+   };
+
+   /// index position of get_table_rows_result::next_cursor, only meaningful to this node
+   struct table_rows_cursor {
+      name      code;
+      name      scope;
+      name      table;
+      uint64_t  index = 0;   ///< name of the table of the index
+      bool      reverse = false;
+      chain::bytes secondary;  ///< secondary key as stored, empty for the primary index
+      uint64_t  primary = 0;
    };
 
    get_table_rows_result get_table_rows( const get_table_rows_params& params )const;
+   /// @return get_table_rows as JSON, with rows requested as JSON written directly from their binary
+   string get_table_rows_json( const get_table_rows_params& params )const;
+
+   struct get_table_rows_packed_row {
+      chain::bytes data;
+      name         payer; ///< empty unless show_payer is set
+   };
+
+   /// get_table_rows_result with the rows as stored, whatever json asks for
+   struct get_table_rows_packed_result {
+      vector<get_table_rows_packed_row> rows;
+      bool                              more = false;
+      string                            next_key;
+      string                            next_cursor;
+   };
+
+   /// @return get_table_rows as a packed get_table_rows_packed_result
+   chain::bytes get_table_rows_packed( const get_table_rows_params& params )const;
 
    struct get_table_by_scope_params {
       name        code; // mandatory
@@ -418,15 +491,29 @@ public:
 
    static uint64_t get_table_index_name(const read_only::get_table_rows_params& p, bool& primary);
 
+   /// @param json_rows when set, rows requested as JSON are appended to it, comma separated, instead of to @ref result
+   get_table_rows_result get_table_rows( const get_table_rows_params& p, string* json_rows )const;
+   void add_table_row( const get_table_rows_params& p, const abi_serializer& abis, const vector<char>& data, name payer,
+                       get_table_rows_result& result, string* json_rows )const;
+
+   static string write_table_rows_cursor( const get_table_rows_params& p, name scope, uint64_t index, chain::bytes secondary, uint64_t primary );
+   static table_rows_cursor read_table_rows_cursor( const get_table_rows_params& p, name scope, uint64_t index );
+
+   template<typename Key>
+   static chain::bytes cursor_key( const Key& k ) {
+      static_assert( std::is_trivially_copyable<Key>::value, "secondary keys are copied into cursors as they are" );
+      chain::bytes b( sizeof(k) );
+      memcpy( b.data(), &k, sizeof(k) );
+      return b;
+   }
+
    template <typename IndexType, typename SecKeyType, typename ConvFn>
-   read_only::get_table_rows_result get_table_rows_by_seckey( const read_only::get_table_rows_params& p, const abi_def& abi, ConvFn conv )const {
+   read_only::get_table_rows_result get_table_rows_by_seckey( const read_only::get_table_rows_params& p, const abi_serializer& abis, string* json_rows, ConvFn conv )const {
       read_only::get_table_rows_result result;
       const auto& d = db.db();
 
       name scope{ convert_to_type<uint64_t>(p.scope, "scope") };
 
-      abi_serializer abis;
-      abis.set_abi(abi, abi_serializer_max_time);
       bool primary = false;
       const uint64_t table_with_index = get_table_index_name(p, primary);
       const auto* t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple(p.code, scope, p.table));
@@ -465,6 +552,16 @@ public:
             }
          }
 
+         if( p.cursor ) {
+            const auto c = read_table_rows_cursor( p, scope, table_with_index );
+            secondary_key_type k;
+            EOS_ASSERT( c.secondary.size() == sizeof(k), chain::contract_table_query_exception, "Cursor ${c} is not for this index", ("c", *p.cursor) );
+            memcpy( &k, c.secondary.data(), sizeof(k) );
+            auto& bound = (p.reverse && *p.reverse) ? upper_bound_lookup_tuple : lower_bound_lookup_tuple;
+            std::get<1>(bound) = k;
+            std::get<2>(bound) = c.primary;
+         }
+
          if( upper_bound_lookup_tuple < lower_bound_lookup_tuple )
             return result;
 
@@ -477,24 +574,14 @@ public:
                if( itr2 == nullptr ) continue;
                copy_inline_row(*itr2, data);
 
-               fc::variant data_var;
-               if( p.json ) {
-                  data_var = abis.binary_to_variant( abis.get_table_type(p.table), data, abi_serializer_max_time, shorten_abi_errors );
-               } else {
-                  data_var = fc::variant( data );
-               }
-
-               if( p.show_payer && *p.show_payer ) {
-                  result.rows.emplace_back( fc::mutable_variant_object("data", std::move(data_var))("payer", itr->payer) );
-               } else {
-                  result.rows.emplace_back( std::move(data_var) );
-               }
+               add_table_row( p, abis, data, itr->payer, result, json_rows );
 
                ++count;
             }
             if( itr != end_itr ) {
                result.more = true;
                result.next_key = convert_to_string(itr->secondary_key, p.key_type, p.encode_type, "next_key - next lower bound");
+               result.next_cursor = write_table_rows_cursor( p, scope, table_with_index, cursor_key( itr->secondary_key ), itr->primary_key );
             }
          };
 
@@ -510,14 +597,12 @@ public:
    }
 
    template <typename IndexType>
-   read_only::get_table_rows_result get_table_rows_ex( const read_only::get_table_rows_params& p, const abi_def& abi )const {
+   read_only::get_table_rows_result get_table_rows_ex( const read_only::get_table_rows_params& p, const abi_serializer& abis, string* json_rows )const {
       read_only::get_table_rows_result result;
       const auto& d = db.db();
 
       uint64_t scope = convert_to_type<uint64_t>(p.scope, "scope");
 
-      abi_serializer abis;
-      abis.set_abi(abi, abi_serializer_max_time);
       const auto* t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple(p.code, name(scope), p.table));
       if( t_id != nullptr ) {
          const auto& idx = d.get_index<IndexType, chain::by_scope_primary>();
@@ -544,6 +629,12 @@ public:
             }
          }
 
+         if( p.cursor ) {
+            const auto c = read_table_rows_cursor( p, name(scope), p.table.to_uint64_t() );
+            EOS_ASSERT( c.secondary.empty(), chain::contract_table_query_exception, "Cursor ${c} is not for this index", ("c", *p.cursor) );
+            std::get<1>((p.reverse && *p.reverse) ? upper_bound_lookup_tuple : lower_bound_lookup_tuple) = c.primary;
+         }
+
          if( upper_bound_lookup_tuple < lower_bound_lookup_tuple  )
             return result;
 
@@ -554,22 +645,12 @@ public:
             for( unsigned int count = 0; cur_time <= end_time && count < p.limit && itr != end_itr; ++count, ++itr, cur_time = fc::time_point::now() ) {
                copy_inline_row(*itr, data);
 
-               fc::variant data_var;
-               if( p.json ) {
-                  data_var = abis.binary_to_variant( abis.get_table_type(p.table), data, abi_serializer_max_time, shorten_abi_errors );
-               } else {
-                  data_var = fc::variant( data );
-               }
-
-               if( p.show_payer && *p.show_payer ) {
-                  result.rows.emplace_back( fc::mutable_variant_object("data", std::move(data_var))("payer", itr->payer) );
-               } else {
-                  result.rows.emplace_back( std::move(data_var) );
-               }
+               add_table_row( p, abis, data, itr->payer, result, json_rows );
             }
             if( itr != end_itr ) {
                result.more = true;
                result.next_key = convert_to_string(itr->primary_key, p.key_type, p.encode_type, "next_key - next lower bound");
+               result.next_cursor = write_table_rows_cursor( p, name(scope), p.table.to_uint64_t(), chain::bytes(), itr->primary_key );
             }
          };
 
@@ -593,8 +674,10 @@ class read_write {
    controller& db;
    const fc::microseconds abi_serializer_max_time;
    const bool api_accept_transactions;
+   const fc::microseconds read_only_max_trx_time;
 public:
-   read_write(controller& db, const fc::microseconds& abi_serializer_max_time, bool api_accept_transactions);
+   read_write(controller& db, const fc::microseconds& abi_serializer_max_time, bool api_accept_transactions,
+              const fc::microseconds& read_only_max_trx_time);
    void validate() const;
 
    using push_block_params = chain::signed_block;
@@ -607,15 +690,32 @@ public:
       fc::variant                 processed;
    };
    void push_transaction(const push_transaction_params& params, chain::plugin_interface::next_function<push_transaction_results> next);
+   void push_transaction(std::shared_ptr<packed_transaction> trx, chain::plugin_interface::next_function<push_transaction_results> next);
+
+   /**
+    * Decodes the JSON of the usual packed form of a transaction, {"signatures", "compression", "packed_context_free_data",
+    * "packed_trx"} with a string compression, straight into a packed_transaction without building an fc::variant.
+    * @return nullptr for any other JSON, including invalid values, which must go through the push_transaction_params path
+    */
+   static std::shared_ptr<packed_transaction> parse_packed_transaction( const string& json );
 
 
    using push_transactions_params  = vector<push_transaction_params>;
    using push_transactions_results = vector<push_transaction_results>;
    void push_transactions(const push_transactions_params& params, chain::plugin_interface::next_function<push_transactions_results> next);
 
+   using push_ro_transaction_params = push_transaction_params;
+   using push_ro_transaction_results = push_transaction_results;
+   /**
+    * executes the transaction against pending state without accepting it; state modifications, native actions included,
+    * are rejected. It is authorized but not billed, and runs on the main thread within read-only-max-transaction-time.
+    */
+   push_ro_transaction_results push_ro_transaction(const push_ro_transaction_params& params);
+
    using send_transaction_params = push_transaction_params;
    using send_transaction_results = push_transaction_results;
    void send_transaction(const send_transaction_params& params, chain::plugin_interface::next_function<send_transaction_results> next);
+   void send_transaction(std::shared_ptr<packed_transaction> trx, chain::plugin_interface::next_function<send_transaction_results> next);
 
    friend resolver_factory<read_write>;
 };
@@ -705,7 +805,9 @@ public:
    void plugin_shutdown();
 
    chain_apis::read_only get_read_only_api() const { return chain_apis::read_only(chain(), get_abi_serializer_max_time()); }
-   chain_apis::read_write get_read_write_api() { return chain_apis::read_write(chain(), get_abi_serializer_max_time(), api_accept_transactions()); }
+   chain_apis::read_write get_read_write_api() {
+      return chain_apis::read_write(chain(), get_abi_serializer_max_time(), api_accept_transactions(), get_read_only_max_transaction_time());
+   }
 
    bool accept_block( const chain::signed_block_ptr& block, const chain::block_id_type& id );
    void accept_transaction(const chain::packed_transaction_ptr& trx, chain::plugin_interface::next_function<chain::transaction_trace_ptr> next);
@@ -735,6 +837,7 @@ public:
    chain::chain_id_type get_chain_id() const;
    fc::microseconds get_abi_serializer_max_time() const;
    bool api_accept_transactions() const;
+   fc::microseconds get_read_only_max_transaction_time() const;
    // set true by other plugins if any plugin allows transactions
    bool accept_transactions() const;
    void enable_accept_transactions();
@@ -759,6 +862,11 @@ FC_REFLECT(eosio::chain_apis::read_only::get_info_results,
            (head_block_id)(head_block_time)(head_block_producer)
            (virtual_block_cpu_limit)(virtual_block_net_limit)(block_cpu_limit)(block_net_limit)
            (server_version_string)(fork_db_head_block_num)(fork_db_head_block_id)(server_full_version_string) )
+FC_REFLECT(eosio::chain_apis::read_only::get_contract_profile_params, (limit) )
+FC_REFLECT(eosio::chain_apis::read_only::get_contract_profile_results, (entries) )
+FC_REFLECT(eosio::chain_apis::read_only::get_accounts_by_keys_params, (keys) )
+FC_REFLECT(eosio::chain_apis::read_only::key_account, (key)(account)(permission)(weight)(threshold) )
+FC_REFLECT(eosio::chain_apis::read_only::get_accounts_by_keys_result, (accounts) )
 FC_REFLECT(eosio::chain_apis::read_only::get_activated_protocol_features_params, (lower_bound)(upper_bound)(limit)(search_by_block_num)(reverse) )
 FC_REFLECT(eosio::chain_apis::read_only::get_activated_protocol_features_results, (activated_protocol_features)(more) )
 FC_REFLECT(eosio::chain_apis::read_only::get_block_params, (block_num_or_id))
@@ -766,8 +874,11 @@ FC_REFLECT(eosio::chain_apis::read_only::get_block_header_state_params, (block_n
 
 FC_REFLECT( eosio::chain_apis::read_write::push_transaction_results, (transaction_id)(processed) )
 
-FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_params, (json)(code)(scope)(table)(table_key)(lower_bound)(upper_bound)(limit)(key_type)(index_position)(encode_type)(reverse)(show_payer) )
-FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_result, (rows)(more)(next_key) );
+FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_params, (json)(code)(scope)(table)(table_key)(lower_bound)(upper_bound)(limit)(key_type)(index_position)(encode_type)(reverse)(show_payer)(cursor) )
+FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_result, (rows)(more)(next_key)(next_cursor) );
+FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_packed_row, (data)(payer) )
+FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_packed_result, (rows)(more)(next_key)(next_cursor) )
+FC_REFLECT( eosio::chain_apis::read_only::table_rows_cursor, (code)(scope)(table)(index)(reverse)(secondary)(primary) )
 
 FC_REFLECT( eosio::chain_apis::read_only::get_table_by_scope_params, (code)(table)(lower_bound)(upper_bound)(limit)(reverse) )
 FC_REFLECT( eosio::chain_apis::read_only::get_table_by_scope_result_row, (code)(scope)(table)(payer)(count));
@@ -2,11 +2,222 @@
 #include <fc/io/json.hpp>
 #include <eosio/db_size_api_plugin/db_size_api_plugin.hpp>
 
+#include <eosio/chain/account_object.hpp>
+#include <eosio/chain/block_summary_object.hpp>
+#include <eosio/chain/code_object.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/generated_transaction_object.hpp>
+#include <eosio/chain/permission_link_object.hpp>
+#include <eosio/chain/permission_object.hpp>
+#include <eosio/chain/resource_limits_private.hpp>
+#include <eosio/chain/transaction_object.hpp>
+
+#include <boost/asio/steady_timer.hpp>
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+
 namespace eosio {
 
 static appbase::abstract_plugin& _db_size_api_plugin = app().register_plugin<db_size_api_plugin>();
 
 using namespace eosio;
+using namespace eosio::chain;
+
+/**
+ * Walks the contract tables in slices of rows, each posted to the main thread at the lowest priority so that the
+ * walk never holds up blocks and transactions for long. A slice resumes at the id after the last row of the previous
+ * one, rows created or removed between slices are counted or not depending on where the walk was.
+ */
+struct db_size_api_plugin::profiler {
+   static constexpr uint32_t slice_rows = 10000;
+   static constexpr uint64_t undo_node_overhead = 32; ///< per kept row or id, the node of the undo state map or set
+
+   struct table_bytes {
+      uint64_t rows = 0;
+      uint64_t bytes = 0;
+      uint64_t secondary_rows = 0;
+      uint64_t secondary_bytes = 0;
+   };
+
+   uint32_t                           interval_sec = 0;
+   std::unique_ptr<boost::asio::steady_timer> timer;
+   bool                               shutting_down = false;
+   db_size_profile                    last;
+
+   // the pass in progress
+   fc::time_point                           started;
+   uint32_t                                 stage = 0;
+   int64_t                                  next_id = 0;
+   std::unordered_map<int64_t, table_bytes> by_table_id;
+
+   const chainbase::database& db()const { return app().get_plugin<chain_plugin>().chain().db(); }
+
+   void start_pass() {
+      started = fc::time_point::now();
+      stage = 0;
+      next_id = 0;
+      by_table_id.clear();
+      post_slice();
+   }
+
+   void post_slice() {
+      app().post( priority::lowest, [this]() {
+         if( !shutting_down )
+            run_slice();
+      } );
+   }
+
+   /// @return true when the walk got to the end of the index with @ref Index
+   template<typename Index, typename F>
+   bool scan( F&& add_row ) {
+      using object_type = typename Index::value_type;
+      const auto& idx = db().get_index<Index, by_id>();
+      auto itr = idx.lower_bound( typename object_type::id_type( next_id ) );
+      for( uint32_t n = 0; itr != idx.end(); ++itr, ++n ) {
+         if( n == slice_rows ) {
+            next_id = itr->id._id;
+            return false;
+         }
+         add_row( *itr );
+      }
+      next_id = 0;
+      return true;
+   }
+
+   template<typename Index>
+   bool scan_secondary() {
+      return scan<Index>( [this]( const typename Index::value_type& row ) {
+         auto& t = by_table_id[row.t_id._id];
+         ++t.secondary_rows;
+         t.secondary_bytes += config::billable_size_v<typename Index::value_type>;
+      } );
+   }
+
+   void run_slice() {
+      bool done = false;
+      switch( stage ) {
+         case 0:
+            done = scan<key_value_index>( [this]( const key_value_object& row ) {
+               auto& t = by_table_id[row.t_id._id];
+               ++t.rows;
+               t.bytes += config::billable_size_v<key_value_object> + row.value.size();
+            } );
+            break;
+         case 1: done = scan_secondary<index64_index>(); break;
+         case 2: done = scan_secondary<index128_index>(); break;
+         case 3: done = scan_secondary<index256_index>(); break;
+         case 4: done = scan_secondary<index_double_index>(); break;
+         case 5: done = scan_secondary<index_long_double_index>(); break;
+         default:
+            complete_pass();
+            return;
+      }
+      if( done )
+         ++stage;
+      post_slice();
+   }
+
+   /// @ref extra_bytes of a row, for what it holds outside of the row itself
+   template<typename Index, typename F>
+   void add_undo( db_size_profile& p, const char* name, F&& extra_bytes ) {
+      using object_type = typename Index::value_type;
+      const auto& index = db().get_index<Index>();
+      db_size_index_undo u;
+      u.index = name;
+      for( const auto& state : index.stack() ) {
+         u.modified += state.old_values.size();
+         u.removed += state.removed_values.size();
+         u.created += state.new_ids.size();
+         for( const auto& old : state.old_values )
+            u.bytes += extra_bytes( old.second );
+         for( const auto& old : state.removed_values )
+            u.bytes += extra_bytes( old.second );
+      }
+      u.bytes += (u.modified + u.removed) * (sizeof(object_type) + undo_node_overhead)
+               + u.created * (sizeof(typename object_type::id_type) + undo_node_overhead);
+      p.undo_revisions = std::max<uint64_t>( p.undo_revisions, index.stack().size() );
+      p.undo_bytes += u.bytes;
+      if( u.modified || u.removed || u.created )
+         p.undo.emplace_back( std::move(u) );
+   }
+
+   template<typename Index>
+   void add_undo( db_size_profile& p, const char* name ) {
+      add_undo<Index>( p, name, []( const typename Index::value_type& ) { return 0; } );
+   }
+
+   void complete_pass() {
+      const auto& d = db();
+      db_size_profile p;
+      p.started = started;
+
+      std::map<std::pair<name, name>, db_size_table_usage> tables;
+      for( const auto& [t_id, t] : by_table_id ) {
+         const auto* tid = d.find<table_id_object>( table_id_object::id_type( t_id ) );
+         if( !tid )
+            continue; // removed after the walk got to its rows
+         auto& u = tables[std::make_pair( tid->code, tid->table )];
+         u.code = tid->code;
+         u.table = tid->table;
+         ++u.scopes;
+         u.rows += t.rows;
+         u.bytes += t.bytes;
+         u.secondary_rows += t.secondary_rows;
+         u.secondary_bytes += t.secondary_bytes;
+         p.contract_bytes += t.bytes + t.secondary_bytes;
+      }
+      by_table_id.clear();
+      p.tables.reserve( tables.size() );
+      for( auto& t : tables )
+         p.tables.emplace_back( std::move( t.second ) );
+      std::sort( p.tables.begin(), p.tables.end(), []( const auto& a, const auto& b ) {
+         return a.bytes + a.secondary_bytes > b.bytes + b.secondary_bytes;
+      } );
+
+      add_undo<key_value_index>( p, "contract_row", []( const key_value_object& row ) { return row.value.size(); } );
+      add_undo<index64_index>( p, "contract_index64" );
+      add_undo<index128_index>( p, "contract_index128" );
+      add_undo<index256_index>( p, "contract_index256" );
+      add_undo<index_double_index>( p, "contract_index_double" );
+      add_undo<index_long_double_index>( p, "contract_index_long_double" );
+      add_undo<table_id_multi_index>( p, "contract_table" );
+      add_undo<account_index>( p, "account" );
+      add_undo<account_metadata_index>( p, "account_metadata" );
+      add_undo<code_index>( p, "code", []( const code_object& c ) { return c.code.size(); } );
+      add_undo<permission_index>( p, "permission" );
+      add_undo<permission_usage_index>( p, "permission_usage" );
+      add_undo<permission_link_index>( p, "permission_link" );
+      add_undo<generated_transaction_multi_index>( p, "generated_transaction",
+                                                   []( const generated_transaction_object& g ) { return g.packed_trx.size(); } );
+      add_undo<transaction_multi_index>( p, "transaction" );
+      add_undo<block_summary_multi_index>( p, "block_summary" );
+      add_undo<resource_limits::resource_limits_index>( p, "resource_limits" );
+      add_undo<resource_limits::resource_usage_index>( p, "resource_usage" );
+      std::sort( p.undo.begin(), p.undo.end(), []( const auto& a, const auto& b ) { return a.bytes > b.bytes; } );
+
+      p.completed = fc::time_point::now();
+      p.head_block_num = app().get_plugin<chain_plugin>().chain().head_block_num();
+      p.used_bytes = d.get_segment_manager()->get_size() - d.get_segment_manager()->get_free_memory();
+      const uint64_t accounted = p.contract_bytes + p.undo_bytes;
+      p.other_bytes = p.used_bytes > accounted ? p.used_bytes - accounted : 0;
+      last = std::move( p );
+
+      ilog( "state memory profile took ${s}s: ${c} bytes in contract tables, ${u} in the undo stack, ${o} other",
+            ("s", (last.completed - last.started).count() / 1000000)
+            ("c", last.contract_bytes)("u", last.undo_bytes)("o", last.other_bytes) );
+      schedule_pass();
+   }
+
+   void schedule_pass() {
+      timer->expires_from_now( std::chrono::seconds( interval_sec ) );
+      timer->async_wait( [this]( const boost::system::error_code& ec ) {
+         if( !ec && !shutting_down )
+            start_pass();
+      } );
+   }
+};
 
 #define CALL(api_name, api_handle, call_name, INVOKE, http_response_code) \
 {std::string("/v1/" #api_name "/" #call_name), \
@@ -23,12 +234,44 @@ using namespace eosio;
 #define INVOKE_R_V(api_handle, call_name) \
      auto result = api_handle->call_name();
 
+#define INVOKE_R_R(api_handle, call_name, in_param) \
+     auto result = api_handle->call_name(fc::json::from_string(body).as<in_param>());
+
+db_size_api_plugin::db_size_api_plugin()
+:my(new profiler()) {}
+
+db_size_api_plugin::~db_size_api_plugin() = default;
+
+void db_size_api_plugin::set_program_options(options_description& cli, options_description& cfg) {
+   cfg.add_options()
+      ("db-size-profile-interval-sec", boost::program_options::value<uint32_t>()->default_value(0),
+       "Seconds between the end of a pass over the contract tables and undo stack for /v1/db_size/get_profile and the "
+       "start of the next, 0 to not profile. A pass walks every contract row in small slices on the main thread.")
+      ;
+}
+
+void db_size_api_plugin::plugin_initialize(const variables_map& options) {
+   my->interval_sec = options.at("db-size-profile-interval-sec").as<uint32_t>();
+}
 
 void db_size_api_plugin::plugin_startup() {
    app().get_plugin<http_plugin>().add_api({
        CALL(db_size, this, get,
             INVOKE_R_V(this, get), 200),
+       CALL(db_size, this, get_profile,
+            INVOKE_R_R(this, get_profile, db_size_profile_params), 200),
    });
+
+   if( my->interval_sec ) {
+      my->timer = std::make_unique<boost::asio::steady_timer>( app().get_io_service() );
+      my->start_pass();
+   }
+}
+
+void db_size_api_plugin::plugin_shutdown() {
+   my->shutting_down = true;
+   if( my->timer )
+      my->timer->cancel();
 }
 
 db_size_stats db_size_api_plugin::get() {
@@ -46,6 +289,15 @@ db_size_stats db_size_api_plugin::get() {
    return ret;
 }
 
+db_size_profile db_size_api_plugin::get_profile(const db_size_profile_params& params) {
+   EOS_ASSERT( my->interval_sec, plugin_config_exception, "db-size-profile-interval-sec is not set" );
+   db_size_profile ret = my->last;
+   if( ret.tables.size() > params.limit )
+      ret.tables.resize( params.limit );
+   return ret;
+}
+
+#undef INVOKE_R_R
 #undef INVOKE_R_V
 #undef CALL
 
@@ -21,28 +21,82 @@ struct db_size_stats {
    vector<db_size_index_count> indices;
 };
 
+/// the rows of the tables named @ref table of contract @ref code, over all of their scopes
+struct db_size_table_usage {
+   chain::name code;
+   chain::name table;
+   uint64_t    scopes = 0;
+   uint64_t    rows = 0;
+   uint64_t    bytes = 0;            ///< rows and their values, with the chainbase overhead RAM billing assumes
+   uint64_t    secondary_rows = 0;
+   uint64_t    secondary_bytes = 0;
+};
+
+/// the undo stack of one index, over all of its revisions
+struct db_size_index_undo {
+   string   index;
+   uint64_t modified = 0; ///< copies of rows as they were before they were modified
+   uint64_t removed = 0;  ///< copies of removed rows
+   uint64_t created = 0;  ///< ids of created rows
+   uint64_t bytes = 0;    ///< estimated
+};
+
+/**
+ * Where the state memory goes, from the last complete pass over the contract tables and the undo stack. The pass
+ * runs in slices between the other work of the main thread, so rows changed while it ran are counted as of when it
+ * got to them.
+ */
+struct db_size_profile {
+   fc::time_point              started;
+   fc::time_point              completed;
+   uint32_t                    head_block_num = 0; ///< when completed
+   uint64_t                    used_bytes = 0;     ///< of the segment, when completed
+   uint64_t                    contract_bytes = 0; ///< all of tables, primary and secondary rows
+   uint64_t                    undo_revisions = 0;
+   uint64_t                    undo_bytes = 0;
+   /// used_bytes that neither contract tables nor the undo stack account for: the system tables, and the allocator
+   /// overhead and fragmentation, which grows with it when this grows faster than the system tables can explain
+   uint64_t                    other_bytes = 0;
+   vector<db_size_table_usage> tables;             ///< the most bytes first
+   vector<db_size_index_undo>  undo;
+};
+
+struct db_size_profile_params {
+   uint32_t limit = 100; ///< of tables
+};
+
 class db_size_api_plugin : public plugin<db_size_api_plugin> {
 public:
    APPBASE_PLUGIN_REQUIRES((http_plugin) (chain_plugin))
 
-   db_size_api_plugin() = default;
+   db_size_api_plugin();
    db_size_api_plugin(const db_size_api_plugin&) = delete;
    db_size_api_plugin(db_size_api_plugin&&) = delete;
    db_size_api_plugin& operator=(const db_size_api_plugin&) = delete;
    db_size_api_plugin& operator=(db_size_api_plugin&&) = delete;
-   virtual ~db_size_api_plugin() override = default;
+   virtual ~db_size_api_plugin() override;
 
-   virtual void set_program_options(options_description& cli, options_description& cfg) override {}
-   void plugin_initialize(const variables_map& vm) {}
+   virtual void set_program_options(options_description& cli, options_description& cfg) override;
+   void plugin_initialize(const variables_map& vm);
    void plugin_startup();
-   void plugin_shutdown() {}
+   void plugin_shutdown();
 
    db_size_stats get();
 
+   /// the last complete profile, empty until the first pass completed
+   db_size_profile get_profile(const db_size_profile_params& params);
+
 private:
+   struct profiler;
+   std::unique_ptr<profiler> my;
 };
 
 }
 
 FC_REFLECT( eosio::db_size_index_count, (index)(row_count) )
-FC_REFLECT( eosio::db_size_stats, (free_bytes)(used_bytes)(size)(indices) )
\ No newline at end of file
+FC_REFLECT( eosio::db_size_stats, (free_bytes)(used_bytes)(size)(indices) )
+FC_REFLECT( eosio::db_size_table_usage, (code)(table)(scopes)(rows)(bytes)(secondary_rows)(secondary_bytes) )
+FC_REFLECT( eosio::db_size_index_undo, (index)(modified)(removed)(created)(bytes) )
+FC_REFLECT( eosio::db_size_profile, (started)(completed)(head_block_num)(used_bytes)(contract_bytes)(undo_revisions)
+                                    (undo_bytes)(other_bytes)(tables)(undo) )
+FC_REFLECT( eosio::db_size_profile_params, (limit) )
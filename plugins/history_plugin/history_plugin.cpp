@@ -3,6 +3,7 @@
 #include <eosio/history_plugin/public_key_history_object.hpp>
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/trace.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <eosio/chain_plugin/chain_plugin.hpp>
 
 #include <fc/io/json.hpp>
@@ -10,6 +11,10 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/signals2/connection.hpp>
 
+#include <deque>
+#include <limits>
+#include <shared_mutex>
+
 namespace eosio {
    using namespace chain;
    using boost::signals2::scoped_connection;
@@ -24,6 +29,8 @@ namespace eosio {
       account_name account; ///< the name of the account which has this action in its history
       uint64_t     action_sequence_num = 0; ///< the sequence number of the relevant action (global)
       int32_t      account_sequence_num = 0; ///< the sequence number for this account (per-account)
+      action_name          act_name; ///< the name of the relevant action
+      block_timestamp_type block_time;
    };
 
    struct action_history_object : public chainbase::object<action_history_object_type, action_history_object> {
@@ -37,6 +44,7 @@ namespace eosio {
       uint32_t             block_num;
       block_timestamp_type block_time;
       transaction_id_type  trx_id;
+      account_name         receiver;
    };
    using account_history_id_type = account_history_object::id_type;
    using action_history_id_type  = action_history_object::id_type;
@@ -44,6 +52,9 @@ namespace eosio {
 
    struct by_action_sequence_num;
    struct by_account_action_seq;
+   struct by_account_action_name;
+   struct by_account_block_time;
+   struct by_receiver_block;
    struct by_trx_id;
 
    using action_history_index = chainbase::shared_multi_index_container<
@@ -56,6 +67,13 @@ namespace eosio {
                member<action_history_object, transaction_id_type, &action_history_object::trx_id>,
                member<action_history_object, uint64_t, &action_history_object::action_sequence_num >
             >
+         >,
+         ordered_unique<tag<by_receiver_block>,
+            composite_key< action_history_object,
+               member<action_history_object, account_name, &action_history_object::receiver>,
+               member<action_history_object, uint32_t, &action_history_object::block_num>,
+               member<action_history_object, uint64_t, &action_history_object::action_sequence_num >
+            >
          >
       >
    >;
@@ -69,6 +87,21 @@ namespace eosio {
                member<account_history_object, account_name, &account_history_object::account >,
                member<account_history_object, int32_t, &account_history_object::account_sequence_num >
             >
+         >,
+         ordered_unique<tag<by_account_action_name>,
+            composite_key< account_history_object,
+               member<account_history_object, account_name, &account_history_object::account >,
+               member<account_history_object, action_name, &account_history_object::act_name >,
+               member<account_history_object, block_timestamp_type, &account_history_object::block_time >,
+               member<account_history_object, int32_t, &account_history_object::account_sequence_num >
+            >
+         >,
+         ordered_unique<tag<by_account_block_time>,
+            composite_key< account_history_object,
+               member<account_history_object, account_name, &account_history_object::account >,
+               member<account_history_object, block_timestamp_type, &account_history_object::block_time >,
+               member<account_history_object, int32_t, &account_history_object::account_sequence_num >
+            >
          >
       >
    >;
@@ -142,6 +175,28 @@ namespace eosio {
          std::set<filter_entry> filter_out;
          chain_plugin*          chain_plug = nullptr;
          fc::optional<scoped_connection> applied_transaction_connection;
+         fc::optional<scoped_connection> accepted_block_connection;
+         fc::optional<scoped_connection> irreversible_block_connection;
+
+         /// history is kept in its own database, only ever written by the indexing thread; readers share @ref history_mtx
+         fc::optional<chainbase::database>  history_db;
+         mutable std::shared_mutex          history_mtx;
+
+         // traces of the block being built or applied, collected on the main thread
+         std::map<transaction_id_type, transaction_trace_ptr> cached_traces;
+         transaction_trace_ptr                                onblock_trace;
+
+         struct block_traces {
+            uint32_t                           block_num = 0;
+            std::vector<transaction_trace_ptr> traces;
+         };
+
+         // blocks waiting for the indexing thread, which takes all of them at once
+         std::mutex                               queue_mtx;
+         std::deque<block_traces>                 queued_blocks;
+         uint32_t                                 queued_irreversible_num = 0;
+         bool                                     drain_scheduled = false;
+         fc::optional<eosio::chain::named_thread_pool> index_thread_pool;
 
           bool filter(const action_trace& act) {
             bool pass_on = false;
@@ -205,8 +260,7 @@ namespace eosio {
          }
 
          void record_account_action( account_name n, const action_trace& act ) {
-            auto& chain = chain_plug->chain();
-            chainbase::database& db = const_cast<chainbase::database&>( chain.db() ); // Override read-only access to state DB (highly unrecommended practice!)
+            chainbase::database& db = *history_db;
 
             const auto& idx = db.get_index<account_history_index, by_account_action_seq>();
             auto itr = idx.lower_bound( boost::make_tuple( name(n.to_uint64_t()+1), 0 ) );
@@ -220,12 +274,13 @@ namespace eosio {
               aho.account = n;
               aho.action_sequence_num = act.receipt->global_sequence;
               aho.account_sequence_num = asn;
+              aho.act_name = act.act.name;
+              aho.block_time = act.block_time;
             });
          }
 
          void on_system_action( const action_trace& at ) {
-            auto& chain = chain_plug->chain();
-            chainbase::database& db = const_cast<chainbase::database&>( chain.db() ); // Override read-only access to state DB (highly unrecommended practice!)
+            chainbase::database& db = *history_db;
             if( at.act.name == N(newaccount) )
             {
                const auto create = at.act.data_as<chain::newaccount>();
@@ -253,8 +308,7 @@ namespace eosio {
          void on_action_trace( const action_trace& at ) {
             if( filter( at ) ) {
                //idump((fc::json::to_pretty_string(at)));
-               auto& chain = chain_plug->chain();
-               chainbase::database& db = const_cast<chainbase::database&>( chain.db() ); // Override read-only access to state DB (highly unrecommended practice!)
+               chainbase::database& db = *history_db;
 
                db.create<action_history_object>( [&]( auto& aho ) {
                   auto ps = fc::raw::pack_size( at );
@@ -262,9 +316,10 @@ namespace eosio {
                   datastream<char*> ds( aho.packed_action_trace.data(), ps );
                   fc::raw::pack( ds, at );
                   aho.action_sequence_num = at.receipt->global_sequence;
-                  aho.block_num = chain.head_block_num() + 1;
-                  aho.block_time = chain.pending_block_time();
+                  aho.block_num = at.block_num;
+                  aho.block_time = at.block_time;
                   aho.trx_id     = at.trx_id;
+                  aho.receiver   = at.receiver;
                });
 
                auto aset = account_set( at );
@@ -276,7 +331,7 @@ namespace eosio {
                on_system_action( at );
          }
 
-         void on_applied_transaction( const transaction_trace_ptr& trace ) {
+         void index_transaction( const transaction_trace_ptr& trace ) {
             if( !trace->receipt || (trace->receipt->status != transaction_receipt_header::executed &&
                   trace->receipt->status != transaction_receipt_header::soft_fail) )
                return;
@@ -285,6 +340,106 @@ namespace eosio {
                on_action_trace( atrace );
             }
          }
+
+         /**
+          * Indexes a block under its own undo session, so the history database revision follows the block number and
+          * blocks forked out are undone just as the chain undoes them. Blocks at or below a revision that can no longer
+          * be undone were indexed before, e.g. by a previous run before a replay, and are skipped.
+          */
+         void index_block( const block_traces& b ) {
+            chainbase::database& db = *history_db;
+            while( db.revision() >= b.block_num ) {
+               auto revision = db.revision();
+               db.undo();
+               if( db.revision() == revision ) return;
+            }
+            if( db.revision() < b.block_num - 1 )
+               db.set_revision( b.block_num - 1 );
+
+            auto session = db.start_undo_session( true );
+            for( const auto& trace : b.traces )
+               index_transaction( trace );
+            session.push();
+         }
+
+         /// run by the indexing thread, and at shutdown by the main thread once that has stopped
+         void drain_queue() {
+            try {
+               std::deque<block_traces> blocks;
+               uint32_t irreversible_num = 0;
+               {
+                  std::lock_guard<std::mutex> g( queue_mtx );
+                  blocks.swap( queued_blocks );
+                  irreversible_num = queued_irreversible_num;
+                  drain_scheduled = false;
+               }
+               std::unique_lock<std::shared_mutex> g( history_mtx );
+               for( const auto& b : blocks )
+                  index_block( b );
+               history_db->commit( irreversible_num );
+            } catch( const fc::exception& e ) {
+               elog( "history indexing failed, shutting down: ${e}", ("e", e.to_detail_string()) );
+               app().post( priority::high, []() { app().quit(); } );
+            } catch( const std::exception& e ) {
+               elog( "history indexing failed, shutting down: ${e}", ("e", e.what()) );
+               app().post( priority::high, []() { app().quit(); } );
+            }
+         }
+
+         /// call with @ref queue_mtx held
+         void schedule_drain() {
+            if( drain_scheduled ) return;
+            drain_scheduled = true;
+            boost::asio::post( index_thread_pool->get_executor(), [this]() { drain_queue(); } );
+         }
+
+         static bool is_onblock( const transaction_trace_ptr& p ) {
+            if( p->action_traces.size() != 1 )
+               return false;
+            const auto& act = p->action_traces[0].act;
+            if( act.account != chain::config::system_account_name || act.name != N(onblock) ||
+                act.authorization.size() != 1 )
+               return false;
+            const auto& auth = act.authorization[0];
+            return auth.actor == chain::config::system_account_name &&
+                   auth.permission == chain::config::active_name;
+         }
+
+         void on_applied_transaction( const transaction_trace_ptr& trace ) {
+            if( !trace->receipt ) return;
+            if( is_onblock( trace ) )
+               onblock_trace = trace;
+            else if( trace->failed_dtrx_trace )
+               cached_traces[trace->failed_dtrx_trace->id] = trace;
+            else
+               cached_traces[trace->id] = trace;
+         }
+
+         /// hands the traces of the block, in block order, to the indexing thread
+         void on_accepted_block( const block_state_ptr& bsp ) {
+            block_traces b{ bsp->block_num };
+            if( onblock_trace )
+               b.traces.push_back( std::move( onblock_trace ) );
+            for( const auto& r : bsp->block->transactions ) {
+               const auto& id = r.trx.contains<transaction_id_type>() ? r.trx.get<transaction_id_type>()
+                                                                      : r.trx.get<packed_transaction>().id();
+               auto itr = cached_traces.find( id );
+               if( itr != cached_traces.end() )
+                  b.traces.push_back( std::move( itr->second ) );
+            }
+            cached_traces.clear();
+            onblock_trace.reset();
+
+            std::lock_guard<std::mutex> g( queue_mtx );
+            queued_blocks.push_back( std::move( b ) );
+            schedule_drain();
+         }
+
+         void on_irreversible_block( const block_state_ptr& bsp ) {
+            std::lock_guard<std::mutex> g( queue_mtx );
+            queued_irreversible_num = bsp->block_num;
+            schedule_drain();
+         }
    };
 
    history_plugin::history_plugin()
@@ -305,6 +460,10 @@ namespace eosio {
             ("filter-out,F", bpo::value<vector<string>>()->composing(),
              "Do not track actions which match receiver:action:actor. Action and Actor both blank excludes all from Reciever. Actor blank excludes all from reciever:action. Receiver may not be blank.")
             ;
+      cfg.add_options()
+            ("history-state-db-size-mb", bpo::value<uint64_t>()->default_value(1024),
+             "Maximum size (in MiB) of the history database, kept in the history directory of the data directory")
+            ;
    }
 
    void history_plugin::plugin_initialize(const variables_map& options) {
@@ -343,17 +502,28 @@ namespace eosio {
          EOS_ASSERT( my->chain_plug, chain::missing_chain_plugin_exception, ""  );
          auto& chain = my->chain_plug->chain();
 
-         chainbase::database& db = const_cast<chainbase::database&>( chain.db() ); // Override read-only access to state DB (highly unrecommended practice!)
-         // TODO: Use separate chainbase database for managing the state of the history_plugin (or remove deprecated history_plugin entirely)
+         my->history_db.emplace( app().data_dir() / "history", chainbase::database::read_write,
+                                 options.at( "history-state-db-size-mb" ).as<uint64_t>() * 1024 * 1024 );
+         chainbase::database& db = *my->history_db;
          db.add_index<account_history_index>();
          db.add_index<action_history_index>();
          db.add_index<account_control_history_multi_index>();
          db.add_index<public_key_history_multi_index>();
 
+         // traces are only collected here, filtering and indexing happen on the indexing thread once a block is accepted
+         my->index_thread_pool.emplace( "hist", 1 );
          my->applied_transaction_connection.emplace(
                chain.applied_transaction.connect( [&]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> t ) {
                   my->on_applied_transaction( std::get<0>(t) );
                } ));
+         my->accepted_block_connection.emplace(
+               chain.accepted_block.connect( [&]( const block_state_ptr& bsp ) {
+                  my->on_accepted_block( bsp );
+               } ));
+         my->irreversible_block_connection.emplace(
+               chain.irreversible_block.connect( [&]( const block_state_ptr& bsp ) {
+                  my->on_irreversible_block( bsp );
+               } ));
       } FC_LOG_AND_RETHROW()
    }
 
@@ -362,6 +532,12 @@ namespace eosio {
 
    void history_plugin::plugin_shutdown() {
       my->applied_transaction_connection.reset();
+      my->accepted_block_connection.reset();
+      my->irreversible_block_connection.reset();
+      if( my->index_thread_pool ) {
+         my->index_thread_pool->stop();
+         my->drain_queue();
+      }
    }
 
 
@@ -371,7 +547,8 @@ namespace eosio {
       read_only::get_actions_result read_only::get_actions( const read_only::get_actions_params& params )const {
          edump((params));
         auto& chain = history->chain_plug->chain();
-        const auto& db = chain.db();
+        std::shared_lock<std::shared_mutex> g( history->history_mtx );
+        const auto& db = *history->history_db;
         const auto abi_serializer_max_time = history->chain_plug->get_abi_serializer_max_time();
 
         const auto& idx = db.get_index<account_history_index, by_account_action_seq>();
@@ -438,6 +615,81 @@ namespace eosio {
       }
 
 
+      read_only::find_actions_result read_only::find_actions( const read_only::find_actions_params& params )const {
+         EOS_ASSERT( params.account_name.valid() != params.receiver.valid(), chain::plugin_exception,
+                     "exactly one of account_name or receiver is required" );
+         EOS_ASSERT( params.receiver || (!params.start_block && !params.end_block), chain::plugin_exception,
+                     "block range is only supported with receiver" );
+         EOS_ASSERT( params.account_name || (!params.action_name && !params.start_time && !params.end_time), chain::plugin_exception,
+                     "action_name and time range are only supported with account_name" );
+         EOS_ASSERT( params.limit > 0 && params.limit <= 1000, chain::plugin_exception, "limit must be between 1 and 1000" );
+
+         auto& chain = history->chain_plug->chain();
+         std::shared_lock<std::shared_mutex> g( history->history_mtx );
+         const auto& db = *history->history_db;
+         const auto abi_serializer_max_time = history->chain_plug->get_abi_serializer_max_time();
+
+         find_actions_result result;
+         result.last_irreversible_block = chain.last_irreversible_block_num();
+         const auto start_time = fc::time_point::now();
+
+         // walks [itr, end) skipping the actions at the start key already returned, @ref add returns false past the limit
+         auto walk = [&]( auto itr, auto end, auto at_start, auto add ) {
+            while( itr != end && params.after_global_seq && at_start( *itr ) && itr->action_sequence_num <= *params.after_global_seq )
+               ++itr;
+            for( ; itr != end; ++itr ) {
+               if( result.actions.size() == params.limit ) {
+                  result.more = true;
+                  break;
+               }
+               if( fc::time_point::now() - start_time > fc::microseconds(100000) ) {
+                  result.time_limit_exceeded_error = true;
+                  result.more = true;
+                  break;
+               }
+               add( *itr );
+            }
+         };
+         auto to_result = [&]( const action_history_object& a, int32_t account_sequence_num ) {
+            fc::datastream<const char*> ds( a.packed_action_trace.data(), a.packed_action_trace.size() );
+            action_trace t;
+            fc::raw::unpack( ds, t );
+            result.actions.emplace_back( ordered_action_result{
+                                  a.action_sequence_num, account_sequence_num,
+                                  a.block_num, a.block_time,
+                                  chain.to_variant_with_abi(t, abi_serializer_max_time)
+                                  });
+         };
+         auto add_account_action = [&]( const account_history_object& h ) {
+            to_result( db.get<action_history_object, by_action_sequence_num>( h.action_sequence_num ), h.account_sequence_num );
+         };
+
+         const block_timestamp_type first_time = params.start_time ? *params.start_time : block_timestamp_type( 0 );
+         const block_timestamp_type last_time  = params.end_time ? *params.end_time : block_timestamp_type( std::numeric_limits<uint32_t>::max() );
+         if( params.receiver ) {
+            const auto first_block = params.start_block ? *params.start_block : 0;
+            const auto last_block  = params.end_block ? *params.end_block : std::numeric_limits<uint32_t>::max();
+            const auto& idx = db.get_index<action_history_index, by_receiver_block>();
+            walk( idx.lower_bound( boost::make_tuple( *params.receiver, first_block ) ),
+                  idx.upper_bound( boost::make_tuple( *params.receiver, last_block ) ),
+                  [&]( const action_history_object& a ) { return a.block_num == first_block; },
+                  [&]( const action_history_object& a ) { to_result( a, 0 ); } );
+         } else if( params.action_name ) {
+            const auto& idx = db.get_index<account_history_index, by_account_action_name>();
+            walk( idx.lower_bound( boost::make_tuple( *params.account_name, *params.action_name, first_time ) ),
+                  idx.upper_bound( boost::make_tuple( *params.account_name, *params.action_name, last_time ) ),
+                  [&]( const account_history_object& h ) { return h.block_time == first_time; },
+                  add_account_action );
+         } else {
+            const auto& idx = db.get_index<account_history_index, by_account_block_time>();
+            walk( idx.lower_bound( boost::make_tuple( *params.account_name, first_time ) ),
+                  idx.upper_bound( boost::make_tuple( *params.account_name, last_time ) ),
+                  [&]( const account_history_object& h ) { return h.block_time == first_time; },
+                  add_account_action );
+         }
+         return result;
+      }
+
       read_only::get_transaction_result read_only::get_transaction( const read_only::get_transaction_params& p )const {
          auto& chain = history->chain_plug->chain();
          const auto abi_serializer_max_time = history->chain_plug->get_abi_serializer_max_time();
@@ -461,7 +713,8 @@ namespace eosio {
             return (*(input_id.data() + input_id_size) & 0xF0) == (*(id.data() + input_id_size) & 0xF0);
          };
 
-         const auto& db = chain.db();
+         std::shared_lock<std::shared_mutex> g( history->history_mtx );
+         const auto& db = *history->history_db;
          const auto& idx = db.get_index<action_history_index, by_trx_id>();
          auto itr = idx.lower_bound( boost::make_tuple( input_id ) );
 
@@ -556,7 +809,8 @@ namespace eosio {
 
       read_only::get_key_accounts_results read_only::get_key_accounts(const get_key_accounts_params& params) const {
          std::set<account_name> accounts;
-         const auto& db = history->chain_plug->chain().db();
+         std::shared_lock<std::shared_mutex> g( history->history_mtx );
+         const auto& db = *history->history_db;
          const auto& pub_key_idx = db.get_index<public_key_history_multi_index, by_pub_key>();
          auto range = pub_key_idx.equal_range( params.public_key );
          for (auto obj = range.first; obj != range.second; ++obj)
@@ -566,7 +820,8 @@ namespace eosio {
 
       read_only::get_controlled_accounts_results read_only::get_controlled_accounts(const get_controlled_accounts_params& params) const {
          std::set<account_name> accounts;
-         const auto& db = history->chain_plug->chain().db();
+         std::shared_lock<std::shared_mutex> g( history->history_mtx );
+         const auto& db = *history->history_db;
          const auto& account_control_idx = db.get_index<account_control_history_multi_index, by_controlling>();
          auto range = account_control_idx.equal_range( params.controlling_account );
          for (auto obj = range.first; obj != range.second; ++obj)
@@ -67,6 +67,34 @@ class read_only {
       get_transaction_result get_transaction( const get_transaction_params& )const;
 
 
+      /**
+       * Either the actions in the history of account_name, optionally only those named action_name, or the actions
+       * received by receiver, in order. Times and block numbers are inclusive bounds. To continue after a result
+       * with more, pass the block_time (or block_num) of the last action returned as the start and its
+       * global_action_seq as after_global_seq.
+       */
+      struct find_actions_params {
+         optional<chain::account_name>         account_name;
+         optional<chain::action_name>          action_name;
+         optional<chain::block_timestamp_type> start_time;
+         optional<chain::block_timestamp_type> end_time;
+         optional<chain::account_name>         receiver;
+         optional<uint32_t>                    start_block;
+         optional<uint32_t>                    end_block;
+         optional<uint64_t>                    after_global_seq;
+         uint32_t                              limit = 100;
+      };
+
+      struct find_actions_result {
+         vector<ordered_action_result> actions; ///< account_action_seq is 0 for receiver queries
+         bool                          more = false;
+         uint32_t                      last_irreversible_block = 0;
+         optional<bool>                time_limit_exceeded_error;
+      };
+
+      find_actions_result find_actions( const find_actions_params& )const;
+
+
 
 
       /*
@@ -139,6 +167,8 @@ FC_REFLECT( eosio::history_apis::read_only::ordered_action_result, (global_actio
 
 FC_REFLECT( eosio::history_apis::read_only::get_transaction_params, (id)(block_num_hint) )
 FC_REFLECT( eosio::history_apis::read_only::get_transaction_result, (id)(trx)(block_time)(block_num)(last_irreversible_block)(traces) )
+FC_REFLECT( eosio::history_apis::read_only::find_actions_params, (account_name)(action_name)(start_time)(end_time)(receiver)(start_block)(end_block)(after_global_seq)(limit) )
+FC_REFLECT( eosio::history_apis::read_only::find_actions_result, (actions)(more)(last_irreversible_block)(time_limit_exceeded_error) )
 /*
 FC_REFLECT(eosio::history_apis::read_only::get_transaction_params, (transaction_id) )
 FC_REFLECT(eosio::history_apis::read_only::get_transaction_results, (transaction_id)(transaction) )
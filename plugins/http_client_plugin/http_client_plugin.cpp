@@ -1,11 +1,72 @@
 #include <eosio/http_client_plugin/http_client_plugin.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <fstream>
+#include <map>
+#include <mutex>
 
 namespace eosio {
 
-http_client_plugin::http_client_plugin():my(new http_client()){}
+/**
+ * The idle clients of a host, the ones not running a request. fc::http_client keeps the connections it opened, so a
+ * client taken from here reuses the open connection to the host instead of connecting and handshaking again.
+ */
+struct http_client_host {
+   std::mutex                                mtx;
+   std::vector<std::unique_ptr<http_client>> idle_clients; ///< protected by mtx
+};
+
+class http_client_plugin_impl {
+public:
+   std::unique_ptr<http_client> make_client() const {
+      auto client = std::make_unique<http_client>();
+      for( const auto& pem : root_pems )
+         client->add_cert( pem );
+      client->set_verify_peers( verify_peers );
+      return client;
+   }
+
+   // unix socket urls have no host, their clients share one entry, each client keeps a connection per socket
+   http_client_host& host_of( const fc::url& dest ) {
+      std::string key = dest.proto() + "://" + (dest.host() ? *dest.host() : std::string()) + ":" +
+                        (dest.port() ? std::to_string( *dest.port() ) : std::string());
+      std::lock_guard<std::mutex> g( hosts_mtx );
+      auto& h = hosts[key];
+      if( !h )
+         h = std::make_unique<http_client_host>();
+      return *h;
+   }
+
+   std::unique_ptr<http_client> take_client( http_client_host& h ) const {
+      {
+         std::lock_guard<std::mutex> g( h.mtx );
+         if( !h.idle_clients.empty() ) {
+            auto client = std::move( h.idle_clients.back() );
+            h.idle_clients.pop_back();
+            return client;
+         }
+      }
+      return make_client();
+   }
+
+   void return_client( http_client_host& h, std::unique_ptr<http_client> client ) const {
+      std::lock_guard<std::mutex> g( h.mtx );
+      // above the bound, a burst of concurrent requests closes the connections it opened instead of keeping them
+      if( h.idle_clients.size() < max_idle_clients_per_host )
+         h.idle_clients.push_back( std::move( client ) );
+   }
+
+   std::vector<std::string>                                 root_pems;
+   bool                                                     verify_peers = true;
+   uint32_t                                                 max_idle_clients_per_host = 0;
+   uint16_t                                                 thread_pool_size = 0;
+   fc::optional<eosio::chain::named_thread_pool>            thread_pool;
+   std::mutex                                               hosts_mtx;
+   std::map<std::string, std::unique_ptr<http_client_host>> hosts; ///< protected by hosts_mtx, never erased
+};
+
+http_client_plugin::http_client_plugin():my(new http_client_plugin_impl()){}
 http_client_plugin::~http_client_plugin(){}
 
 void http_client_plugin::set_program_options(options_description&, options_description& cfg) {
@@ -14,13 +75,25 @@ void http_client_plugin::set_program_options(options_description&, options_descr
        "PEM encoded trusted root certificate (or path to file containing one) used to validate any TLS connections made.  (may specify multiple times)\n")
       ("https-client-validate-peers", boost::program_options::value<bool>()->default_value(true),
        "true: validate that the peer certificates are valid and trusted, false: ignore cert errors")
+      ("http-client-threads", boost::program_options::value<uint16_t>()->default_value(2),
+       "Number of worker threads running asynchronous requests, the most asynchronous requests in flight")
+      ("http-client-max-idle-connections", boost::program_options::value<uint32_t>()->default_value(4),
+       "Maximum number of clients per host kept with their connections open between requests")
       ;
 
 }
 
 void http_client_plugin::plugin_initialize(const variables_map& options) {
    try {
+      my->verify_peers = options.at( "https-client-validate-peers" ).as<bool>();
+      my->max_idle_clients_per_host = options.at( "http-client-max-idle-connections" ).as<uint32_t>();
+      my->thread_pool_size = options.at( "http-client-threads" ).as<uint16_t>();
+      EOS_ASSERT( my->thread_pool_size > 0, chain::plugin_config_exception,
+                  "http-client-threads ${num} must be greater than 0", ("num", my->thread_pool_size) );
+
       if( options.count( "https-client-root-cert" )) {
+         // every client of the pool is given the certs, the ones a client fails to read are reported once here
+         http_client probe;
          const std::vector<std::string> root_pems = options["https-client-root-cert"].as<std::vector<std::string>>();
          for( const auto& root_pem : root_pems ) {
             std::string pem_str = root_pem;
@@ -39,23 +112,43 @@ void http_client_plugin::plugin_initialize(const variables_map& options) {
             }
 
             try {
-               my->add_cert( pem_str );
+               probe.add_cert( pem_str );
+               my->root_pems.emplace_back( std::move( pem_str ) );
             } catch ( const fc::exception& e ) {
                elog( "Failed to read PEM : ${e} \n${pem}\n", ("pem", pem_str)( "e", e.to_detail_string()));
             }
          }
       }
-
-      my->set_verify_peers( options.at( "https-client-validate-peers" ).as<bool>());
    } FC_LOG_AND_RETHROW()
 }
 
 void http_client_plugin::plugin_startup() {
-
+   my->thread_pool.emplace( "httpc", my->thread_pool_size );
 }
 
 void http_client_plugin::plugin_shutdown() {
+   if( my->thread_pool )
+      my->thread_pool->stop();
+}
+
+fc::variant http_client_plugin::post_sync( const fc::url& dest, const fc::variant& payload, const fc::time_point& deadline ) {
+   auto& host = my->host_of( dest );
+   auto client = my->take_client( host );
+   // a client whose request failed is dropped, its connection may be left mid response
+   auto result = client->post_sync( dest, payload, deadline );
+   my->return_client( host, std::move( client ) );
+   return result;
+}
 
+void http_client_plugin::post_async( const fc::url& dest, fc::variant payload, const fc::time_point& deadline,
+                                     next_function<fc::variant> next ) {
+   EOS_ASSERT( my->thread_pool, chain::plugin_exception, "http_client_plugin is not started" );
+   boost::asio::post( my->thread_pool->get_executor(),
+                      [this, dest, payload{std::move( payload )}, deadline, next{std::move( next )}]() {
+      try {
+         next( post_sync( dest, payload, deadline ) );
+      } CATCH_AND_CALL( next );
+   });
 }
 
 }
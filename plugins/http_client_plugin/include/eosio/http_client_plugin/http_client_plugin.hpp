@@ -1,14 +1,20 @@
 #pragma once
 #include <appbase/application.hpp>
 #include <fc/network/http/http_client.hpp>
+#include <fc/static_variant.hpp>
 
 namespace eosio {
    using namespace appbase;
    using fc::http_client;
 
+   class http_client_plugin_impl;
+
    class http_client_plugin : public appbase::plugin<http_client_plugin>
    {
       public:
+        template<typename T>
+        using next_function = std::function<void(const fc::static_variant<fc::exception_ptr, T>&)>;
+
         http_client_plugin();
         virtual ~http_client_plugin();
 
@@ -19,12 +25,20 @@ namespace eosio {
         void plugin_startup();
         void plugin_shutdown();
 
-        http_client& get_client() {
-           return *my;
-        }
+        /**
+         * Thread safe. Posts on an idle client kept for the host of @ref dest, which keeps its connections alive
+         * between requests, so only the first request to a host pays for the connection and the TLS handshake.
+         * Requests from several threads run concurrently, each on its own client.
+         */
+        fc::variant post_sync( const fc::url& dest, const fc::variant& payload,
+                               const fc::time_point& deadline = fc::time_point::maximum() );
+
+        /// thread safe, posts on a thread of the plugin and calls @ref next on that thread with the response or the failure
+        void post_async( const fc::url& dest, fc::variant payload, const fc::time_point& deadline,
+                         next_function<fc::variant> next );
 
       private:
-        std::unique_ptr<http_client> my;
+        std::unique_ptr<http_client_plugin_impl> my;
    };
 
 }
@@ -11,9 +11,11 @@
 #include <fc/io/json.hpp>
 #include <fc/io/raw.hpp>
 #include <fc/crypto/openssl.hpp>
+#include <fc/crypto/sha256.hpp>
 
 #include <boost/asio.hpp>
 #include <boost/optional.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include <websocketpp/config/asio_client.hpp>
 #include <websocketpp/config/asio.hpp>
@@ -24,6 +26,10 @@
 
 #include <thread>
 #include <memory>
+#include <array>
+#include <mutex>
+#include <list>
+#include <unordered_map>
 #include <regex>
 
 const fc::string logger_name("http_plugin");
@@ -138,10 +144,110 @@ namespace eosio {
 
    static bool verbose_http_errors = false;
 
+   /**
+    * LRU of the responses that handlers marked immutable, by url and request body, within a byte budget. Shared by
+    * the http threads.
+    */
+   class response_cache {
+      public:
+         struct response {
+            string      body;
+            string      etag;
+            const char* content_type = nullptr; ///< replaces application/json when set
+         };
+         using response_ptr = std::shared_ptr<const response>;
+
+         explicit response_cache( size_t max_bytes ) : _max_bytes( max_bytes ) {}
+
+         static string key( const string& resource, const string& body ) {
+            return resource + '\n' + body;
+         }
+
+         response_ptr find( const string& key ) {
+            std::lock_guard<std::mutex> g( _mtx );
+            auto itr = _index.find( key );
+            if( itr == _index.end() ) return {};
+            _lru.splice( _lru.begin(), _lru, itr->second );
+            return itr->second->second;
+         }
+
+         void insert( string key, response_ptr r ) {
+            // the key is held twice, in the list and the index
+            const size_t size = 2 * key.size() + r->body.size() + r->etag.size();
+            if( size > _max_bytes ) return;
+            std::lock_guard<std::mutex> g( _mtx );
+            if( _index.count( key ) ) return;
+            _lru.emplace_front( std::move( key ), std::move( r ) );
+            _index.emplace( _lru.front().first, _lru.begin() );
+            _bytes += size;
+            while( _bytes > _max_bytes ) {
+               const auto& last = _lru.back();
+               _bytes -= 2 * last.first.size() + last.second->body.size() + last.second->etag.size();
+               _index.erase( last.first );
+               _lru.pop_back();
+            }
+         }
+
+      private:
+         using entry = std::pair<string, response_ptr>;
+
+         std::mutex                                              _mtx;
+         std::list<entry>                                        _lru;
+         std::unordered_map<string, std::list<entry>::iterator>  _index;
+         size_t                                                  _bytes = 0;
+         const size_t                                            _max_bytes;
+   };
+
+   /// lock free histogram of latencies in power of two buckets, see http_plugin::latency_histogram
+   struct latency_counters {
+      static constexpr size_t num_buckets = 32;
+
+      std::array<std::atomic<uint64_t>, num_buckets> buckets{};
+      std::atomic<uint64_t>                          count{0};
+      std::atomic<uint64_t>                          sum_us{0};
+
+      void record( const fc::microseconds& latency ) {
+         const uint64_t us = std::max<int64_t>( latency.count(), 0 );
+         const size_t bucket = us == 0 ? 0 : std::min<size_t>( 64 - __builtin_clzll( us ), num_buckets - 1 );
+         buckets[bucket].fetch_add( 1, std::memory_order_relaxed );
+         count.fetch_add( 1, std::memory_order_relaxed );
+         sum_us.fetch_add( us, std::memory_order_relaxed );
+      }
+
+      http_plugin::latency_histogram snapshot()const {
+         http_plugin::latency_histogram result;
+         result.count = count.load( std::memory_order_relaxed );
+         result.sum_us = sum_us.load( std::memory_order_relaxed );
+         result.buckets.reserve( num_buckets );
+         for( const auto& b : buckets ) result.buckets.push_back( b.load( std::memory_order_relaxed ) );
+         return result;
+      }
+   };
+
+   /// scheduling and load limits of the requests to one url, fixed once its handler is added except for the counters
+   struct endpoint_state {
+      int                    priority = appbase::priority::medium_low;
+      uint32_t               max_in_flight = 0; ///< 0 for no limit
+      std::atomic<uint32_t>  in_flight{0};
+      std::atomic<int64_t>   queue_time_us{0};    ///< main thread queue time of the request that last started
+      std::atomic<int64_t>   queue_time_at_us{0}; ///< when it started
+
+      std::atomic<uint64_t>  requests{0};
+      std::atomic<uint64_t>  rejected{0};
+      latency_counters       queue_latency;
+      latency_counters       handler_latency;
+      latency_counters       serialization_latency;
+   };
+   using endpoint_state_ptr = std::shared_ptr<endpoint_state>;
+
    class http_plugin_impl {
       public:
-         // key -> priority, url_handler
-         map<string,std::pair<int,url_handler>>  url_handlers;
+         // key -> endpoint_state, url_handler
+         map<string,std::pair<endpoint_state_ptr,url_json_handler>>  url_handlers;
+         map<string,int>                              endpoint_priorities;
+         map<string,uint32_t>                         endpoint_max_in_flight;
+         fc::microseconds                             max_queue_time;
+         map<string,url_binary_handler>               url_binary_handlers;
          optional<tcp::endpoint>  listen_endpoint;
          string                   access_control_allow_origin;
          string                   access_control_allow_headers;
@@ -156,6 +262,7 @@ namespace eosio {
          std::atomic<size_t>                         bytes_in_flight{0};
          size_t                                      max_bytes_in_flight = 0;
          fc::microseconds                            max_response_time{30*1000};
+         optional<response_cache>                    immutable_responses;
 
          optional<tcp::endpoint>  https_listen_endpoint;
          string                   https_cert_chain;
@@ -292,6 +399,56 @@ namespace eosio {
             return true;
          }
 
+         template<class T>
+         void reject_busy( const T& con, const char* reason ) {
+            fc_dlog( logger, "503 - ${reason}: ${ep}", ("reason", reason)("ep", con->get_uri()->get_resource()) );
+            error_results results{websocketpp::http::status_code::service_unavailable, "Busy", error_results::error_info()};
+            con->set_body( fc::json::to_string( results, fc::time_point::maximum() ));
+            con->set_status( websocketpp::http::status_code::service_unavailable );
+         }
+
+         /// counts the request as in flight to @ref ep and @return true, unless the endpoint is over its limits
+         template<class T>
+         bool admit_request( endpoint_state& ep, const T& con ) {
+            if( max_queue_time.count() > 0 ) {
+               // a measurement goes stale after a second, so a url refusing every request is soon tried again
+               const int64_t now = fc::time_point::now().time_since_epoch().count();
+               if( ep.queue_time_us.load() > max_queue_time.count() && now - ep.queue_time_at_us.load() < 1000000 ) {
+                  ++ep.rejected;
+                  reject_busy( con, "queue time exceeded" );
+                  return false;
+               }
+            }
+            if( ep.in_flight.fetch_add( 1 ) >= ep.max_in_flight && ep.max_in_flight > 0 ) {
+               --ep.in_flight;
+               ++ep.rejected;
+               reject_busy( con, "too many requests in flight" );
+               return false;
+            }
+            return true;
+         }
+
+         endpoint_state_ptr make_endpoint_state( const string& url, int priority ) {
+            auto ep = std::make_shared<endpoint_state>();
+            auto pitr = endpoint_priorities.find( url );
+            ep->priority = pitr != endpoint_priorities.end() ? pitr->second : priority;
+            auto litr = endpoint_max_in_flight.find( url );
+            if( litr != endpoint_max_in_flight.end() ) ep->max_in_flight = litr->second;
+            return ep;
+         }
+
+         /// sets the caching headers of an immutable response, @return false when the client already has it
+         template<class T>
+         bool set_immutable_headers(typename websocketpp::server<T>::connection_ptr con, const string& etag) {
+            con->append_header( "ETag", etag );
+            con->append_header( "Cache-Control", "public, max-age=31536000, immutable" );
+            if( con->get_request().get_header( "If-None-Match" ) == etag ) {
+               con->set_status( websocketpp::http::status_code::not_modified );
+               return false;
+            }
+            return true;
+         }
+
          template<class T>
          void handle_http_request(typename websocketpp::server<T>::connection_ptr con) {
             try {
@@ -326,20 +483,84 @@ namespace eosio {
                std::string resource = con->get_uri()->get_resource();
                auto handler_itr = url_handlers.find( resource );
                if( handler_itr != url_handlers.end()) {
+                  url_binary_handler binary_handler;
+                  if( req.get_header( "Accept" ).find( "application/octet-stream" ) != std::string::npos ) {
+                     auto binary_itr = url_binary_handlers.find( resource );
+                     if( binary_itr != url_binary_handlers.end() ) binary_handler = binary_itr->second;
+                  }
+                  string cache_key;
+                  if( immutable_responses ) {
+                     // the packed response of a url is kept apart from its JSON one
+                     cache_key = response_cache::key( binary_handler ? resource + " octet-stream" : resource, body );
+                     if( auto cached = immutable_responses->find( cache_key ) ) {
+                        if( cached->content_type ) con->replace_header( "Content-type", cached->content_type );
+                        if( set_immutable_headers<T>( con, cached->etag ) ) {
+                           con->set_body( cached->body );
+                           con->set_status( websocketpp::http::status_code::ok );
+                        }
+                        return;
+                     }
+                  }
+                  const endpoint_state_ptr& endpoint = handler_itr->second.first;
+                  if( !admit_request( *endpoint, con ) ) return;
+                  // in flight until the response callbacks, held by the handler, are done with
+                  std::shared_ptr<endpoint_state> in_flight( endpoint.get(), [endpoint]( endpoint_state* ep ) { --ep->in_flight; } );
                   con->defer_http_response();
                   bytes_in_flight += body.size();
-                  app().post( handler_itr->second.first,
+                  app().post( endpoint->priority,
                               [&ioc = thread_pool->get_executor(), &bytes_in_flight = this->bytes_in_flight,
-                               handler_itr, this, resource{std::move( resource )}, body{std::move( body )}, con]() mutable {
+                               handler_itr, binary_handler{std::move( binary_handler )}, cache_key{std::move( cache_key )},
+                               in_flight{std::move( in_flight )}, queued = fc::time_point::now(),
+                               this, resource{std::move( resource )}, body{std::move( body )}, con]() mutable {
                      const size_t body_size = body.size();
+                     const auto now = fc::time_point::now();
+                     in_flight->queue_time_us = (now - queued).count();
+                     in_flight->queue_time_at_us = now.time_since_epoch().count();
+                     in_flight->queue_latency.record( now - queued );
+                     if( max_queue_time.count() > 0 && now - queued > max_queue_time ) {
+                        ++in_flight->rejected;
+                        reject_busy( con, "queue time exceeded" );
+                        con->send_http_response();
+                        bytes_in_flight -= body_size;
+                        return;
+                     }
                      if( !verify_max_bytes_in_flight( con ) ) {
                         con->send_http_response();
                         bytes_in_flight -= body_size;
                         return;
                      }
+                     ++in_flight->requests;
                      try {
-                        handler_itr->second.second( std::move( resource ), std::move( body ),
-                                 [&ioc, &bytes_in_flight, con, this]( int code, fc::variant response_body ) {
+                        // content_type, when set, replaces application/json
+                        auto raw_cb = [&ioc, &bytes_in_flight, con, in_flight, this]( int code, std::string raw_body, const char* content_type, string cache_key ) {
+                           const size_t raw_size = raw_body.size();
+                           bytes_in_flight += raw_size;
+                           if( !verify_max_bytes_in_flight( con ) ) {
+                              con->send_http_response();
+                              bytes_in_flight -= raw_size;
+                           } else {
+                              boost::asio::post( ioc, [raw_body{std::move( raw_body )}, raw_size, &bytes_in_flight, con, code, content_type,
+                                                       cache_key{std::move( cache_key )}, this]() mutable {
+                                 if( content_type ) con->replace_header( "Content-type", content_type );
+                                 bool send_body = true;
+                                 if( !cache_key.empty() && code == websocketpp::http::status_code::ok ) {
+                                    auto cached = std::make_shared<response_cache::response>();
+                                    cached->content_type = content_type;
+                                    cached->etag = '"' + fc::sha256::hash( raw_body ).str() + '"';
+                                    send_body = set_immutable_headers<T>( con, cached->etag );
+                                    if( send_body ) con->set_body( raw_body );
+                                    cached->body = std::move( raw_body );
+                                    immutable_responses->insert( std::move( cache_key ), std::move( cached ) );
+                                 } else {
+                                    con->set_body( std::move( raw_body ) );
+                                 }
+                                 if( send_body ) con->set_status( websocketpp::http::status_code::value( code ) );
+                                 con->send_http_response();
+                                 bytes_in_flight -= raw_size;
+                              } );
+                           }
+                        };
+                        url_response_callback cb = [&ioc, &bytes_in_flight, con, in_flight, this]( int code, fc::variant response_body ) {
                            size_t response_size = 0;
                            try {
                               response_size = fc::raw::pack_size( response_body );
@@ -351,10 +572,12 @@ namespace eosio {
                            } else {
                               boost::asio::post( ioc,
                                  [response_body{std::move( response_body )}, response_size, &bytes_in_flight,
-                                  con, code, max_response_time=max_response_time]() mutable {
+                                  con, code, in_flight, max_response_time=max_response_time]() mutable {
                                  std::string json;
                                  try {
-                                    json = fc::json::to_string( response_body, fc::time_point::now() + max_response_time );
+                                    const auto start = fc::time_point::now();
+                                    json = fc::json::to_string( response_body, start + max_response_time );
+                                    in_flight->serialization_latency.record( fc::time_point::now() - start );
                                     con->set_body( std::move( json ) );
                                     con->set_status( websocketpp::http::status_code::value( code ) );
                                  } catch( ... ) {
@@ -367,7 +590,21 @@ namespace eosio {
                                  bytes_in_flight -= (json_size + response_size);
                               } );
                            }
-                        });
+                        };
+                        const auto handler_start = fc::time_point::now();
+                        if( binary_handler ) {
+                           binary_handler( std::move( resource ), std::move( body ), std::move( cb ),
+                                           [raw_cb, cache_key{std::move( cache_key )}]( int code, std::vector<char> packed, bool immutable ) mutable {
+                              raw_cb( code, std::string( packed.begin(), packed.end() ), "application/octet-stream",
+                                      immutable ? std::move( cache_key ) : string() );
+                           } );
+                        } else {
+                           handler_itr->second.second( std::move( resource ), std::move( body ), std::move( cb ),
+                                                       [raw_cb, cache_key{std::move( cache_key )}]( int code, std::string json, bool immutable ) mutable {
+                              raw_cb( code, std::move( json ), nullptr, immutable ? std::move( cache_key ) : string() );
+                           } );
+                        }
+                        in_flight->handler_latency.record( fc::time_point::now() - handler_start );
                      } catch( ... ) {
                         handle_exception<T>( con );
                         con->send_http_response();
@@ -394,6 +631,11 @@ namespace eosio {
                ws.init_asio( &thread_pool->get_executor() );
                ws.set_reuse_addr(true);
                ws.set_max_http_body_size(max_body_size);
+               // responses are written whole, so do not hold small ones back for Nagle's algorithm
+               ws.set_socket_init_handler([](connection_hdl, auto& socket) {
+                  boost::system::error_code ec;
+                  socket.lowest_layer().set_option( tcp::no_delay( true ), ec );
+               });
                // capture server_ioc shared_ptr in http handler to keep it alive while in use
                ws.set_http_handler([&](connection_hdl hdl) {
                   handle_http_request<detail::asio_with_stub_log<T>>(ws.get_con_from_hdl(hdl));
@@ -503,6 +745,14 @@ namespace eosio {
              "Additionaly acceptable values for the \"Host\" header of incoming HTTP requests, can be specified multiple times.  Includes http/s_server_address by default.")
             ("http-threads", bpo::value<uint16_t>()->default_value( my->thread_pool_size ),
              "Number of worker threads in http thread pool")
+            ("http-endpoint-priority", bpo::value<std::vector<string>>()->composing(),
+             "url=priority, the main thread priority of the requests to url: low, medium_low, medium or high, e.g. /v1/chain/get_table_rows=low to put reads below transactions. Can be specified multiple times.")
+            ("http-endpoint-max-in-flight", bpo::value<std::vector<string>>()->composing(),
+             "url=count, the most requests to url handled at once, more are refused with 503. Can be specified multiple times.")
+            ("http-max-queue-time-ms", bpo::value<uint32_t>()->default_value(0),
+             "Requests that waited longer than this for the main thread are refused with 503, as are new requests to a url whose last request did. 0 disables.")
+            ("http-response-cache-mb", bpo::value<uint32_t>()->default_value(64),
+             "Maximum size in megabytes of the cache of immutable responses, such as packed irreversible blocks, served with ETag and Cache-Control headers. 0 disables the cache.")
             ;
    }
 
@@ -585,6 +835,36 @@ namespace eosio {
 
          my->max_bytes_in_flight = options.at( "http-max-bytes-in-flight-mb" ).as<uint32_t>() * 1024 * 1024;
          my->max_response_time = fc::microseconds( options.at("http-max-response-time-ms").as<uint32_t>() * 1000 );
+         // url=value options, split at the last '='
+         auto endpoint_options = [&options]( const char* option, auto&& set ) {
+            if( !options.count( option ) ) return;
+            for( const auto& s : options.at( option ).as<vector<string>>() ) {
+               const auto pos = s.rfind( '=' );
+               EOS_ASSERT( pos != string::npos && pos > 0 && pos + 1 < s.size(), chain::plugin_config_exception,
+                           "${o} must be url=value: ${s}", ("o", option)("s", s) );
+               set( s.substr( 0, pos ), s.substr( pos + 1 ) );
+            }
+         };
+         endpoint_options( "http-endpoint-priority", [this]( const string& url, const string& value ) {
+            static const map<string,int> priorities{ {"low", appbase::priority::low}, {"medium_low", appbase::priority::medium_low},
+                                                     {"medium", appbase::priority::medium}, {"high", appbase::priority::high} };
+            auto itr = priorities.find( value );
+            EOS_ASSERT( itr != priorities.end(), chain::plugin_config_exception,
+                        "http-endpoint-priority must be low, medium_low, medium or high: ${v}", ("v", value) );
+            my->endpoint_priorities[url] = itr->second;
+         } );
+         endpoint_options( "http-endpoint-max-in-flight", [this]( const string& url, const string& value ) {
+            try {
+               my->endpoint_max_in_flight[url] = boost::lexical_cast<uint32_t>( value );
+            } catch( const boost::bad_lexical_cast& ) {
+               EOS_THROW( chain::plugin_config_exception, "http-endpoint-max-in-flight must be a count: ${v}", ("v", value) );
+            }
+         } );
+         my->max_queue_time = fc::milliseconds( options.at( "http-max-queue-time-ms" ).as<uint32_t>() );
+
+         if( const auto cache_mb = options.at( "http-response-cache-mb" ).as<uint32_t>() ) {
+            my->immutable_responses.emplace( size_t(cache_mb) * 1024 * 1024 );
+         }
 
          //watch out for the returns above when adding new code here
       } FC_LOG_AND_RETHROW()
@@ -672,6 +952,15 @@ namespace eosio {
                handle_exception("node", "get_supported_apis", body, cb);
             }
          }
+      }, {
+         std::string("/v1/node/get_metrics"),
+         [&](string, string body, url_response_callback cb) mutable {
+            try {
+               cb(200, fc::variant(get_metrics()));
+            } catch (...) {
+               handle_exception("node", "get_metrics", body, cb);
+            }
+         }
       }});
    }
 
@@ -698,7 +987,20 @@ namespace eosio {
 
    void http_plugin::add_handler(const string& url, const url_handler& handler, int priority) {
       fc_ilog( logger, "add api url: ${c}", ("c", url) );
-      my->url_handlers.insert(std::make_pair(url,std::make_pair(priority, handler)));
+      my->url_handlers.insert(std::make_pair(url,std::make_pair(my->make_endpoint_state(url, priority),
+            [handler](string url, string body, url_response_callback cb, url_response_json_callback) {
+               handler( std::move( url ), std::move( body ), std::move( cb ) );
+            })));
+   }
+
+   void http_plugin::add_json_handler(const string& url, const url_json_handler& handler, int priority) {
+      fc_ilog( logger, "add api url: ${c}", ("c", url) );
+      my->url_handlers.insert(std::make_pair(url,std::make_pair(my->make_endpoint_state(url, priority), handler)));
+   }
+
+   void http_plugin::add_binary_handler(const string& url, const url_binary_handler& handler) {
+      fc_ilog( logger, "add binary api url: ${c}", ("c", url) );
+      my->url_binary_handlers[url] = handler;
    }
 
    void http_plugin::handle_exception( const char *api_name, const char *call_name, const string& body, url_response_callback cb ) {
@@ -768,6 +1070,17 @@ namespace eosio {
       return result;
    }
 
+   http_plugin::get_metrics_result http_plugin::get_metrics()const {
+      get_metrics_result result;
+      result.endpoints.reserve( my->url_handlers.size() );
+      for( const auto& handler : my->url_handlers ) {
+         const auto& ep = *handler.second.first;
+         result.endpoints.push_back( { handler.first, ep.requests.load(), ep.rejected.load(), ep.queue_latency.snapshot(),
+                                       ep.handler_latency.snapshot(), ep.serialization_latency.snapshot() } );
+      }
+      return result;
+   }
+
    std::istream& operator>>(std::istream& in, https_ecdh_curve_t& curve) {
       std::string s;
       in >> s;
@@ -15,6 +15,29 @@ namespace eosio {
     */
    using url_response_callback = std::function<void(int,fc::variant)>;
 
+   /**
+    * @brief A callback function provided to a URL handler to
+    * respond with a body it serialized to JSON itself
+    *
+    * An immutable response, one that will never change for this url
+    * and request body, is cached and sent with ETag and Cache-Control
+    * headers.
+    *
+    * Arguments: response_code, response_json, immutable
+    */
+   using url_response_json_callback = std::function<void(int,std::string,bool)>;
+
+   /**
+    * @brief A callback function provided to a URL handler to
+    * respond with an application/octet-stream body
+    *
+    * Immutable responses are cached as with url_response_json_callback,
+    * apart from the JSON responses of the same url.
+    *
+    * Arguments: response_code, response_bytes, immutable
+    */
+   using url_response_binary_callback = std::function<void(int,std::vector<char>,bool)>;
+
    /**
     * @brief Callback type for a URL handler
     *
@@ -27,6 +50,28 @@ namespace eosio {
     **/
    using url_handler = std::function<void(string,string,url_response_callback)>;
 
+   /**
+    * @brief Callback type for a URL handler that can respond with JSON it
+    * wrote directly, instead of an fc::variant the http thread serializes
+    *
+    * One of the callbacks must be called; url_response_callback remains
+    * available for errors.
+    *
+    * Arguments: url, request_body, response_callback, response_json_callback
+    **/
+   using url_json_handler = std::function<void(string,string,url_response_callback,url_response_json_callback)>;
+
+   /**
+    * @brief Callback type for a URL handler serving requests that
+    * accept application/octet-stream
+    *
+    * One of the callbacks must be called; url_response_callback remains
+    * available for errors, which are still sent as JSON.
+    *
+    * Arguments: url, request_body, response_callback, response_binary_callback
+    **/
+   using url_binary_handler = std::function<void(string,string,url_response_callback,url_response_binary_callback)>;
+
    /**
     * @brief An API, containing URLs and handlers
     *
@@ -78,6 +123,9 @@ namespace eosio {
         void handle_sighup() override;
 
         void add_handler(const string& url, const url_handler&, int priority = appbase::priority::medium_low);
+        void add_json_handler(const string& url, const url_json_handler&, int priority = appbase::priority::medium_low);
+        /// serves the requests to an already added url whose Accept header asks for application/octet-stream
+        void add_binary_handler(const string& url, const url_binary_handler&);
         void add_api(const api_description& api, int priority = appbase::priority::medium_low) {
            for (const auto& call : api)
               add_handler(call.first, call.second, priority);
@@ -97,6 +145,28 @@ namespace eosio {
 
         get_supported_apis_result get_supported_apis()const;
 
+        /// buckets[i] counts the latencies of at least 2^(i-1) and under 2^i microseconds, the last bucket also those above
+        struct latency_histogram {
+           uint64_t         count = 0;
+           uint64_t         sum_us = 0;
+           vector<uint64_t> buckets;
+        };
+
+        struct endpoint_metrics {
+           string            url;
+           uint64_t          requests = 0; ///< handled
+           uint64_t          rejected = 0; ///< refused with 503 by the endpoint's limits
+           latency_histogram queue;         ///< wait for the main thread
+           latency_histogram handler;       ///< handler call on the main thread
+           latency_histogram serialization; ///< fc::variant responses serialized to JSON on the http threads
+        };
+
+        struct get_metrics_result {
+           vector<endpoint_metrics> endpoints;
+        };
+
+        get_metrics_result get_metrics()const;
+
       private:
         std::shared_ptr<class http_plugin_impl> my;
    };
@@ -154,3 +224,6 @@ FC_REFLECT(eosio::error_results::error_info::error_detail, (message)(file)(line_
 FC_REFLECT(eosio::error_results::error_info, (code)(name)(what)(details))
 FC_REFLECT(eosio::error_results, (code)(message)(error))
 FC_REFLECT(eosio::http_plugin::get_supported_apis_result, (apis))
+FC_REFLECT(eosio::http_plugin::latency_histogram, (count)(sum_us)(buckets))
+FC_REFLECT(eosio::http_plugin::endpoint_metrics, (url)(requests)(rejected)(queue)(handler)(serialization))
+FC_REFLECT(eosio::http_plugin::get_metrics_result, (endpoints))
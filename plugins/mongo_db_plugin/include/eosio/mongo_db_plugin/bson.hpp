@@ -8,6 +8,9 @@
 #include <bsoncxx/string/to_string.hpp>
 #include <bsoncxx/types.hpp>
 
+#include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/trace.hpp>
+
 #include <fc/variant.hpp>
 
 #include <bson/bson.h>
@@ -22,6 +25,10 @@ void from_bson(const bsoncxx::document::view& view, fc::mutable_variant_object&
 void from_bson(const bsoncxx::array::view& bson_array, fc::variants& a);
 template <typename T> void from_bson(const T& ele, fc::variant& v);
 fc::variant from_bson(const bsoncxx::document::view& view);
+
+/// writes what to_bson of abi_serializer::to_variant would, with action data written straight from its binary
+template<typename T, typename Resolver>
+void to_bson_with_abi(const T& obj, bsoncxx::builder::core& c, Resolver& resolver, const fc::microseconds& max_time);
 } // namespace eosio
 
 namespace eosio {
@@ -242,5 +249,119 @@ fc::variant from_bson(const bsoncxx::document::view& view)
    return o;
 }
 
+/// builds the document of a decoded struct, built-in values go through to_bson of their variant
+class bson_value_writer : public chain::abi_serializer::value_writer {
+public:
+   explicit bson_value_writer(bsoncxx::builder::core& c) : c(c) {}
+
+   // the root object is the document of the builder itself
+   void start_object() override { if (depth++) c.open_document(); }
+   void key(const std::string& name) override { c.key_owned(name); }
+   void end_object() override { if (--depth) c.close_document(); }
+   void start_array() override {
+      FC_ASSERT(depth++, "only objects can be the root of a document");
+      c.open_array();
+   }
+   void end_array() override { --depth; c.close_array(); }
+   void value(const fc::variant& v) override {
+      FC_ASSERT(depth, "only objects can be the root of a document");
+      to_bson(v, c);
+   }
+
+private:
+   bsoncxx::builder::core& c;
+   size_t                  depth = 0;
+};
+
+template<typename T, typename Resolver>
+struct to_bson_with_abi_visitor {
+   const T&                  obj;
+   bsoncxx::builder::core&   c;
+   Resolver&                 resolver;
+   const fc::microseconds&   max_time;
+
+   template<typename Member, class Class, Member (Class::*member)>
+   void operator()(const char* name) const {
+      add(name, obj.*member);
+   }
+
+   template<typename M>
+   void add(const char* name, const M& m) const {
+      c.key_owned(name);
+      to_bson(fc::variant(m), c);
+   }
+
+   void add(const char* name, const chain::action& act) const {
+      static_assert(fc::reflector<chain::action>::total_member_count == 4);
+      c.key_owned(name);
+      c.open_document();
+      c.key_owned("account");
+      to_bson(fc::variant(act.account), c);
+      c.key_owned("name");
+      to_bson(fc::variant(act.name), c);
+      c.key_owned("authorization");
+      to_bson(fc::variant(act.authorization), c);
+
+      fc::variant data(act.data);
+      bool decoded = false;
+      try {
+         auto abi = resolver(act.account);
+         if (abi) {
+            auto type = abi->get_action_type(act.name);
+            if (!type.empty()) {
+               bsoncxx::builder::core sub(false);
+               bson_value_writer w(sub);
+               if (abi->binary_to_writer(type, act.data, w, max_time)) {
+                  c.key_owned("data");
+                  c.append(sub.extract_document());
+                  decoded = true;
+               } else {
+                  // step by step, as abi_serializer::to_variant would
+                  fc::datastream<const char*> ds(act.data.data(), act.data.size());
+                  auto v = abi->binary_to_variant(type, ds, max_time, true);
+                  c.key_owned("data");
+                  to_bson(v, c);
+                  decoded = true;
+               }
+            }
+         }
+      } catch (...) {
+         // any failure to serialize data, then leave as not serialized
+      }
+      if (decoded) {
+         c.key_owned("hex_data");
+      } else {
+         c.key_owned("data");
+      }
+      to_bson(data, c);
+      c.close_document();
+   }
+
+   void add(const char* name, const std::vector<chain::action_trace>& traces) const {
+      c.key_owned(name);
+      c.open_array();
+      for (const auto& at : traces) {
+         c.open_document();
+         to_bson_with_abi(at, c, resolver, max_time);
+         c.close_document();
+      }
+      c.close_array();
+   }
+
+   void add(const char* name, const std::shared_ptr<chain::transaction_trace>& t) const {
+      if (!t) return;
+      c.key_owned(name);
+      c.open_document();
+      to_bson_with_abi(*t, c, resolver, max_time);
+      c.close_document();
+   }
+};
+
+template<typename T, typename Resolver>
+void to_bson_with_abi(const T& obj, bsoncxx::builder::core& c, Resolver& resolver, const fc::microseconds& max_time)
+{
+   fc::reflector<T>::visit(to_bson_with_abi_visitor<T, Resolver>{obj, c, resolver, max_time});
+}
+
 }   // namespace eosio
 
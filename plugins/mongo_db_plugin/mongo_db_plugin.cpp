@@ -3,9 +3,11 @@
 #include <eosio/chain/eosio_contract.hpp>
 #include <eosio/chain/config.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <eosio/chain/transaction.hpp>
 #include <eosio/chain/types.hpp>
 
+#include <fc/io/cfile.hpp>
 #include <fc/io/json.hpp>
 #include <fc/log/logger_config.hpp>
 #include <fc/utf8.hpp>
@@ -60,6 +62,119 @@ struct filter_entry {
    }
 };
 
+enum class spill_kind : uint8_t {
+   transaction_metadata, transaction_trace, block_state, irreversible_block_state
+};
+
+/// what a spilled transaction_metadata is rebuilt from; its keys are then recovered again from the signatures
+struct spilled_transaction_metadata {
+   chain::packed_transaction trx;
+   bool                      accepted  = false;
+   bool                      implicit  = false;
+   bool                      scheduled = false;
+};
+
+} // namespace eosio
+
+FC_REFLECT( eosio::spilled_transaction_metadata, (trx)(accepted)(implicit)(scheduled) )
+
+namespace eosio {
+
+/**
+ * Append only file of the queue entries that did not fit in memory, read back in order. It is emptied once all of it
+ * has been read, and what is left in it when nodeos stops is read back on the next start.
+ */
+class spill_journal {
+public:
+   explicit spill_journal( const bfs::path& path ) {
+      file.set_file_path( path );
+      file.open( "ab+" );
+      file.seek_end( 0 );
+      write_pos = file.tellp();
+   }
+
+   bool empty()const { return read_pos == write_pos; }
+
+   void append( spill_kind kind, const std::vector<char>& payload ) {
+      EOS_ASSERT( payload.size() == (uint32_t)payload.size(), chain::plugin_exception, "spilled entry is too big" );
+      uint32_t size = payload.size();
+      file.write( (const char*)&kind, sizeof(kind) );
+      file.write( (const char*)&size, sizeof(size) );
+      file.write( payload.data(), payload.size() );
+      file.flush();
+      write_pos += sizeof(kind) + sizeof(size) + size;
+   }
+
+   /// @return false once everything written has been read
+   bool read( spill_kind& kind, std::vector<char>& payload ) {
+      if( empty() ) return false;
+      try {
+         uint32_t size = 0;
+         file.seek( read_pos );
+         file.read( (char*)&kind, sizeof(kind) );
+         file.read( (char*)&size, sizeof(size) );
+         payload.resize( size );
+         file.read( payload.data(), size );
+         read_pos += sizeof(kind) + sizeof(size) + size;
+         return true;
+      } catch( ... ) {
+         // a record cut short, by a crash while it was written
+         elog( "dropping the unreadable end of mongo_db_plugin spill journal ${p}", ("p", file.get_file_path().generic_string()) );
+         read_pos = write_pos;
+         return false;
+      }
+   }
+
+   void clear() {
+      file.close();
+      file.open( "wb+" );
+      file.close();
+      file.open( "ab+" );
+      read_pos = write_pos = 0;
+   }
+
+private:
+   fc::cfile file;
+   uint64_t  read_pos  = 0;
+   uint64_t  write_pos = 0;
+};
+
+namespace {
+
+size_t estimated_size( const chain::transaction_metadata_ptr& t ) {
+   return t->get_estimated_size();
+}
+
+size_t estimated_size( const chain::transaction_trace_ptr& t ) {
+   size_t size = sizeof(*t);
+   for( const auto& at : t->action_traces ) {
+      size += sizeof(at) + at.act.data.size() + at.console.size();
+   }
+   return size;
+}
+
+size_t estimated_size( const chain::block_state_ptr& bs ) {
+   size_t size = sizeof(*bs) + sizeof(*bs->block);
+   for( const auto& r : bs->block->transactions ) {
+      size += r.trx.contains<packed_transaction>() ? r.trx.get<packed_transaction>().get_estimated_size() : sizeof(r);
+   }
+   return size;
+}
+
+std::vector<char> pack_spilled( const chain::transaction_metadata_ptr& t ) {
+   return fc::raw::pack( spilled_transaction_metadata{ *t->packed_trx(), t->accepted, t->implicit, t->scheduled } );
+}
+
+std::vector<char> pack_spilled( const chain::transaction_trace_ptr& t ) {
+   return fc::raw::pack( *t );
+}
+
+std::vector<char> pack_spilled( const chain::block_state_ptr& bs ) {
+   return fc::raw::pack( *bs );
+}
+
+} // anonymous namespace
+
 class mongo_db_plugin_impl {
 public:
    mongo_db_plugin_impl();
@@ -78,8 +193,7 @@ public:
    void applied_transaction(const chain::transaction_trace_ptr&);
    void process_accepted_transaction(const chain::transaction_metadata_ptr&);
    void _process_accepted_transaction(const chain::transaction_metadata_ptr&);
-   void process_applied_transaction(const chain::transaction_trace_ptr&);
-   void _process_applied_transaction(const chain::transaction_trace_ptr&);
+   void process_applied_transactions(const std::deque<chain::transaction_trace_ptr>&);
    void process_accepted_block( const chain::block_state_ptr& );
    void _process_accepted_block( const chain::block_state_ptr& );
    void process_irreversible_block(const chain::block_state_ptr&);
@@ -90,10 +204,17 @@ public:
 
    void purge_abi_cache();
 
-   bool add_action_trace( mongocxx::bulk_write& bulk_action_traces, const chain::action_trace& atrace,
-                          const chain::transaction_trace_ptr& t,
-                          bool executed, const std::chrono::milliseconds& now,
-                          bool& write_ttrace );
+   /// documents of one transaction trace, built on the worker threads
+   struct trace_documents {
+      std::vector<bsoncxx::document::value>  action_traces;
+      fc::optional<bsoncxx::document::value> trans_trace;
+   };
+
+   /// @param update_accounts also apply the account changes of each action, in order, before converting it
+   trace_documents convert_trace( const chain::transaction_trace_ptr& t, bool update_accounts );
+   void update_accounts( const chain::transaction_trace_ptr& t );
+   void write_trace_documents( const std::string& collection, std::vector<bsoncxx::document::value> docs );
+   void wait_trace_writes();
 
    void update_account(const chain::action& act);
 
@@ -114,7 +235,10 @@ public:
    void wipe_database();
    void create_expiration_index(mongocxx::collection& collection, uint32_t expire_after_seconds);
 
-   template<typename Queue, typename Entry> void queue(Queue& queue, const Entry& e);
+   template<typename Queue, typename Entry> void queue(Queue& queue, const Entry& e, spill_kind kind);
+   bool queue_full()const { return queued_entries > max_queue_size || queued_bytes > max_queue_bytes; }
+   /// @return number of spilled entries moved to the process queues, call with mtx held
+   size_t read_spilled();
 
    bool configured{false};
    bool wipe_database_on_startup{false};
@@ -147,8 +271,24 @@ public:
    mongocxx::collection _pub_keys;
    mongocxx::collection _account_controls;
 
+   // abi lookups come from the worker threads too, they use their own client under abi_cache_mtx
+   std::mutex abi_cache_mtx;
+   fc::optional<mongocxx::pool::entry> abi_client;
+   mongocxx::collection _abi_accounts;
+
+   // trace conversion and trace writes, one bulk write per collection per batch; the writes of a batch are only
+   // waited on once the next batch is ready to be written
+   uint16_t trace_threads = 0;
+   fc::optional<eosio::chain::named_thread_pool> trace_thread_pool;
+   std::vector<std::future<void>> pending_trace_writes;
+
    size_t max_queue_size = 0;
-   int queue_sleep_time = 0;
+   size_t max_queue_bytes = 0;
+   size_t queued_entries = 0;
+   size_t queued_bytes = 0;
+   // entries that do not fit in the queues are spilled, and later ones too until the journal is read back
+   fc::optional<spill_journal> journal;
+   bool spilling = false;
    size_t abi_cache_size = 0;
    std::deque<chain::transaction_metadata_ptr> transaction_metadata_queue;
    std::deque<chain::transaction_metadata_ptr> transaction_metadata_process_queue;
@@ -160,6 +300,7 @@ public:
    std::deque<chain::block_state_ptr> irreversible_block_state_process_queue;
    std::mutex mtx;
    std::condition_variable condition;
+   std::condition_variable space_condition;
    std::thread consume_thread;
    std::atomic_bool done{false};
    std::atomic_bool startup{true};
@@ -285,30 +426,83 @@ bool mongo_db_plugin_impl::filter_include( const transaction& trx ) const
 
 
 template<typename Queue, typename Entry>
-void mongo_db_plugin_impl::queue( Queue& queue, const Entry& e ) {
+void mongo_db_plugin_impl::queue( Queue& queue, const Entry& e, spill_kind kind ) {
+   const auto size = estimated_size( e );
    std::unique_lock<std::mutex> lock( mtx );
-   auto queue_size = queue.size();
-   if( queue_size > max_queue_size ) {
-      lock.unlock();
-      condition.notify_one();
-      queue_sleep_time += 10;
-      if( queue_sleep_time > 1000 )
-         wlog("queue size: ${q}", ("q", queue_size));
-      std::this_thread::sleep_for( std::chrono::milliseconds( queue_sleep_time ));
-      lock.lock();
+   if( !spilling && queue_full() ) {
+      if( journal ) {
+         wlog( "mongo_db_plugin queue full, spilling to disk until MongoDB catches up, queue size: ${q}", ("q", queued_entries) );
+         spilling = true;
+      } else {
+         // wait for the consume thread to make room, no longer than it takes
+         const auto start = fc::time_point::now();
+         condition.notify_one();
+         space_condition.wait( lock, [this]() { return !queue_full() || done; } );
+         const auto waited = fc::time_point::now() - start;
+         if( waited > fc::seconds(1) )
+            wlog( "waited ${t}ms for mongo_db_plugin queue, size: ${q}", ("t", waited.count() / 1000)("q", queued_entries) );
+      }
+   }
+   if( spilling ) {
+      journal->append( kind, pack_spilled( e ) );
    } else {
-      queue_sleep_time -= 10;
-      if( queue_sleep_time < 0 ) queue_sleep_time = 0;
+      queue.emplace_back( e );
+      ++queued_entries;
+      queued_bytes += size;
    }
-   queue.emplace_back( e );
    lock.unlock();
    condition.notify_one();
 }
 
+size_t mongo_db_plugin_impl::read_spilled() {
+   size_t count = 0;
+   spill_kind kind;
+   std::vector<char> payload;
+   while( count < max_queue_size && journal->read( kind, payload ) ) {
+      try {
+         fc::datastream<const char*> ds( payload.data(), payload.size() );
+         switch( kind ) {
+            case spill_kind::transaction_metadata: {
+               spilled_transaction_metadata m;
+               fc::raw::unpack( ds, m );
+               auto t = chain::transaction_metadata::create_no_recover_keys( std::make_shared<packed_transaction>( std::move( m.trx ) ),
+                     m.implicit ? chain::transaction_metadata::trx_type::implicit :
+                     m.scheduled ? chain::transaction_metadata::trx_type::scheduled : chain::transaction_metadata::trx_type::input );
+               t->accepted = m.accepted;
+               transaction_metadata_process_queue.emplace_back( std::move( t ) );
+               break;
+            }
+            case spill_kind::transaction_trace: {
+               auto t = std::make_shared<chain::transaction_trace>();
+               fc::raw::unpack( ds, *t );
+               transaction_trace_process_queue.emplace_back( std::move( t ) );
+               break;
+            }
+            case spill_kind::block_state:
+            case spill_kind::irreversible_block_state: {
+               auto bs = std::make_shared<chain::block_state>();
+               fc::raw::unpack( ds, *bs );
+               auto& q = kind == spill_kind::block_state ? block_state_process_queue : irreversible_block_state_process_queue;
+               q.emplace_back( std::move( bs ) );
+               break;
+            }
+         }
+         ++count;
+      } catch( fc::exception& e ) {
+         elog( "Unable to read spilled mongo_db_plugin entry: ${e}", ("e", e.to_detail_string()) );
+      }
+   }
+   if( journal->empty() ) {
+      journal->clear();
+      spilling = false;
+   }
+   return count;
+}
+
 void mongo_db_plugin_impl::accepted_transaction( const chain::transaction_metadata_ptr& t ) {
    try {
       if( store_transactions ) {
-         queue( transaction_metadata_queue, t );
+         queue( transaction_metadata_queue, t, spill_kind::transaction_metadata );
       }
    } catch (fc::exception& e) {
       elog("FC Exception while accepted_transaction ${e}", ("e", e.to_string()));
@@ -344,7 +538,7 @@ void mongo_db_plugin_impl::applied_transaction( const chain::transaction_trace_p
       if( !is_producer && !t->producer_block_id.valid() )
          return;
       // always queue since account information always gathered
-      queue( transaction_trace_queue, t );
+      queue( transaction_trace_queue, t, spill_kind::transaction_trace );
    } catch (fc::exception& e) {
       elog("FC Exception while applied_transaction ${e}", ("e", e.to_string()));
    } catch (std::exception& e) {
@@ -357,7 +551,7 @@ void mongo_db_plugin_impl::applied_transaction( const chain::transaction_trace_p
 void mongo_db_plugin_impl::applied_irreversible_block( const chain::block_state_ptr& bs ) {
    try {
       if( store_blocks || store_block_states || store_transactions ) {
-         queue( irreversible_block_state_queue, bs );
+         queue( irreversible_block_state_queue, bs, spill_kind::irreversible_block_state );
       }
    } catch (fc::exception& e) {
       elog("FC Exception while applied_irreversible_block ${e}", ("e", e.to_string()));
@@ -376,7 +570,7 @@ void mongo_db_plugin_impl::accepted_block( const chain::block_state_ptr& bs ) {
          }
       }
       if( store_blocks || store_block_states ) {
-         queue( block_state_queue, bs );
+         queue( block_state_queue, bs, spill_kind::block_state );
       }
    } catch (fc::exception& e) {
       elog("FC Exception while accepted_block ${e}", ("e", e.to_string()));
@@ -401,12 +595,19 @@ void mongo_db_plugin_impl::consume_blocks() {
       _pub_keys = mongo_conn[db_name][pub_keys_col];
       _account_controls = mongo_conn[db_name][account_controls_col];
 
+      {
+         std::lock_guard<std::mutex> g( abi_cache_mtx );
+         abi_client.emplace( mongo_pool->acquire() );
+         _abi_accounts = (**abi_client)[db_name][accounts_col];
+      }
+
       while (true) {
          std::unique_lock<std::mutex> lock(mtx);
          while ( transaction_metadata_queue.empty() &&
                  transaction_trace_queue.empty() &&
                  block_state_queue.empty() &&
                  irreversible_block_state_queue.empty() &&
+                 (!journal || journal->empty()) &&
                  !done ) {
             condition.wait(lock);
          }
@@ -432,8 +633,21 @@ void mongo_db_plugin_impl::consume_blocks() {
             irreversible_block_state_process_queue = move(irreversible_block_state_queue);
             irreversible_block_state_queue.clear();
          }
+         queued_entries = 0;
+         queued_bytes = 0;
+
+         // spilled entries come after everything queued in memory
+         if( transaction_metadata_size == 0 && transaction_trace_size == 0 && block_state_size == 0 &&
+             irreversible_block_size == 0 && journal && !journal->empty() ) {
+            read_spilled();
+            transaction_metadata_size = transaction_metadata_process_queue.size();
+            transaction_trace_size = transaction_trace_process_queue.size();
+            block_state_size = block_state_process_queue.size();
+            irreversible_block_size = irreversible_block_state_process_queue.size();
+         }
 
          lock.unlock();
+         space_condition.notify_all();
 
          if (done) {
             ilog("draining queue, size: ${q}", ("q", transaction_metadata_size + transaction_trace_size + block_state_size + irreversible_block_size));
@@ -442,11 +656,8 @@ void mongo_db_plugin_impl::consume_blocks() {
          // process transactions
          auto start_time = fc::time_point::now();
          auto size = transaction_trace_process_queue.size();
-         while (!transaction_trace_process_queue.empty()) {
-            const auto& t = transaction_trace_process_queue.front();
-            process_applied_transaction(t);
-            transaction_trace_process_queue.pop_front();
-         }
+         process_applied_transactions( transaction_trace_process_queue );
+         transaction_trace_process_queue.clear();
          auto time = fc::time_point::now() - start_time;
          auto per = size > 0 ? time.count()/size : 0;
          if( time > fc::microseconds(500000) ) // reduce logging, .5 secs
@@ -494,7 +705,9 @@ void mongo_db_plugin_impl::consume_blocks() {
              transaction_trace_size == 0 &&
              block_state_size == 0 &&
              irreversible_block_size == 0 &&
+             (!journal || journal->empty()) &&
              done ) {
+            wait_trace_writes();
             break;
          }
       }
@@ -593,6 +806,7 @@ optional<abi_serializer> mongo_db_plugin_impl::get_abi_serializer( account_name
    using bsoncxx::builder::basic::make_document;
    if( n.good()) {
       try {
+         std::lock_guard<std::mutex> g( abi_cache_mtx );
 
          auto itr = abi_cache_index.find( n );
          if( itr != abi_cache_index.end() ) {
@@ -603,7 +817,7 @@ optional<abi_serializer> mongo_db_plugin_impl::get_abi_serializer( account_name
             return itr->serializer;
          }
 
-         auto account = _accounts.find_one( make_document( kvp("name", n.to_string())) );
+         auto account = _abi_accounts.find_one( make_document( kvp("name", n.to_string())) );
          if(account) {
             auto view = account->view();
             abi_def abi;
@@ -694,19 +908,6 @@ void mongo_db_plugin_impl::process_accepted_transaction( const chain::transactio
    }
 }
 
-void mongo_db_plugin_impl::process_applied_transaction( const chain::transaction_trace_ptr& t ) {
-   try {
-      // always call since we need to capture setabi on accounts even if not storing transaction traces
-      _process_applied_transaction( t );
-   } catch (fc::exception& e) {
-      elog("FC Exception while processing applied transaction trace: ${e}", ("e", e.to_detail_string()));
-   } catch (std::exception& e) {
-      elog("STD Exception while processing applied transaction trace: ${e}", ("e", e.what()));
-   } catch (...) {
-      elog("Unknown exception while processing applied transaction trace");
-   }
-}
-
 void mongo_db_plugin_impl::process_irreversible_block(const chain::block_state_ptr& bs) {
   try {
      if( start_block_reached ) {
@@ -812,116 +1013,181 @@ void mongo_db_plugin_impl::_process_accepted_transaction( const chain::transacti
 
 }
 
-bool
-mongo_db_plugin_impl::add_action_trace( mongocxx::bulk_write& bulk_action_traces, const chain::action_trace& atrace,
-                                        const chain::transaction_trace_ptr& t,
-                                        bool executed, const std::chrono::milliseconds& now,
-                                        bool& write_ttrace )
-{
-   using namespace bsoncxx::types;
-   using bsoncxx::builder::basic::kvp;
-
-   if( executed && atrace.receiver == chain::config::system_account_name ) {
-      update_account( atrace.act );
-   }
-
-   bool added = false;
-   const bool in_filter = (store_action_traces || store_transaction_traces) && start_block_reached &&
-                    filter_include( atrace.receiver, atrace.act.name, atrace.act.authorization );
-   write_ttrace |= in_filter;
-   if( start_block_reached && store_action_traces && in_filter ) {
-      auto action_traces_doc = bsoncxx::builder::basic::document{};
-      // improve data distributivity when using mongodb sharding
-      action_traces_doc.append( kvp( "_id", make_custom_oid() ) );
-
-      auto v = to_variant_with_abi( atrace );
+void mongo_db_plugin_impl::update_accounts( const chain::transaction_trace_ptr& t ) {
+   bool executed = t->receipt.valid() && t->receipt->status == chain::transaction_receipt_header::executed;
+   if( !executed ) return;
+   for( const auto& atrace : t->action_traces ) {
       try {
-         action_traces_doc.append( bsoncxx::builder::concatenate_doc{to_bson( v )} );
-      } catch( bsoncxx::exception& e ) {
-         elog( "Unable to convert action trace to BSON: ${e}", ("e", e.what()) );
-         try {
-            elog( "  JSON: ${j}", ("j", fc::json::to_string( v, fc::time_point::now() + fc::exception::format_time_limit )) );
-         } catch(...) {}
-      }
-      if( t->receipt.valid() ) {
-         action_traces_doc.append( kvp( "trx_status", std::string( t->receipt->status ) ) );
+         if( atrace.receiver == chain::config::system_account_name ) {
+            update_account( atrace.act );
+         }
+      } catch(...) {
+         handle_mongo_exception("update account", __LINE__);
       }
-      action_traces_doc.append( kvp( "createdAt", b_date{now} ) );
-
-      mongocxx::model::insert_one insert_op{action_traces_doc.view()};
-      bulk_action_traces.append( insert_op );
-      added = true;
    }
-
-   return added;
 }
 
-
-void mongo_db_plugin_impl::_process_applied_transaction( const chain::transaction_trace_ptr& t ) {
+mongo_db_plugin_impl::trace_documents
+mongo_db_plugin_impl::convert_trace( const chain::transaction_trace_ptr& t, bool update_accounts ) {
    using namespace bsoncxx::types;
    using bsoncxx::builder::basic::kvp;
 
-   auto trans_traces_doc = bsoncxx::builder::basic::document{};
+   trace_documents result;
 
    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
          std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
 
-   mongocxx::options::bulk_write bulk_opts;
-   bulk_opts.ordered(false);
-   mongocxx::bulk_write bulk_action_traces = _action_traces.create_bulk_write(bulk_opts);
-   bool write_atraces = false;
    bool write_ttrace = false; // filters apply to transaction_traces as well
    bool executed = t->receipt.valid() && t->receipt->status == chain::transaction_receipt_header::executed;
+   auto resolver = [this]( account_name n ) { return get_abi_serializer( n ); };
 
    for( const auto& atrace : t->action_traces ) {
       try {
-         write_atraces |= add_action_trace( bulk_action_traces, atrace, t, executed, now, write_ttrace );
+         if( update_accounts && executed && atrace.receiver == chain::config::system_account_name ) {
+            update_account( atrace.act );
+         }
+
+         const bool in_filter = (store_action_traces || store_transaction_traces) && start_block_reached &&
+                          filter_include( atrace.receiver, atrace.act.name, atrace.act.authorization );
+         write_ttrace |= in_filter;
+         if( start_block_reached && store_action_traces && in_filter ) {
+            auto action_traces_doc = bsoncxx::builder::basic::document{};
+            // improve data distributivity when using mongodb sharding
+            action_traces_doc.append( kvp( "_id", make_custom_oid() ) );
+
+            try {
+               bsoncxx::builder::core trace_doc( false );
+               to_bson_with_abi( atrace, trace_doc, resolver, abi_serializer_max_time );
+               action_traces_doc.append( bsoncxx::builder::concatenate_doc{trace_doc.extract_document()} );
+            } catch( bsoncxx::exception& e ) {
+               elog( "Unable to convert action trace to BSON: ${e}", ("e", e.what()) );
+               try {
+                  elog( "  JSON: ${j}", ("j", fc::json::to_string( to_variant_with_abi( atrace ), fc::time_point::now() + fc::exception::format_time_limit )) );
+               } catch(...) {}
+            }
+            if( t->receipt.valid() ) {
+               action_traces_doc.append( kvp( "trx_status", std::string( t->receipt->status ) ) );
+            }
+            action_traces_doc.append( kvp( "createdAt", b_date{now} ) );
+
+            result.action_traces.emplace_back( action_traces_doc.extract() );
+         }
       } catch(...) {
          handle_mongo_exception("add action traces", __LINE__);
       }
    }
 
-   if( !start_block_reached ) return; //< add_action_trace calls update_account which must be called always
-
-   // transaction trace insert
+   if( !start_block_reached ) return result;
 
    if( store_transaction_traces && write_ttrace ) {
       try {
-         auto v = to_variant_with_abi( *t );
+         auto trans_traces_doc = bsoncxx::builder::basic::document{};
          try {
-            trans_traces_doc.append( bsoncxx::builder::concatenate_doc{to_bson( v )} );
+            bsoncxx::builder::core trace_doc( false );
+            to_bson_with_abi( *t, trace_doc, resolver, abi_serializer_max_time );
+            trans_traces_doc.append( bsoncxx::builder::concatenate_doc{trace_doc.extract_document()} );
          } catch( bsoncxx::exception& e ) {
             elog( "Unable to convert transaction to BSON: ${e}", ("e", e.what()) );
             try {
-               elog( "  JSON: ${j}", ("j", fc::json::to_string( v, fc::time_point::now() + fc::exception::format_time_limit )) );
+               elog( "  JSON: ${j}", ("j", fc::json::to_string( to_variant_with_abi( *t ), fc::time_point::now() + fc::exception::format_time_limit )) );
             } catch(...) {}
          }
          trans_traces_doc.append( kvp( "createdAt", b_date{now} ) );
-
-         try {
-            if( !_trans_traces.insert_one( trans_traces_doc.view() ) ) {
-               EOS_ASSERT( false, chain::mongo_db_insert_fail, "Failed to insert trans ${id}", ("id", t->id) );
-            }
-         } catch( ... ) {
-            handle_mongo_exception( "trans_traces insert: " + t->id.str(), __LINE__ );
-         }
+         result.trans_trace.emplace( trans_traces_doc.extract() );
       } catch( ... ) {
          handle_mongo_exception( "trans_traces serialization: " + t->id.str(), __LINE__ );
       }
    }
 
-   // insert action_traces
-   if( write_atraces ) {
+   return result;
+}
+
+void mongo_db_plugin_impl::write_trace_documents( const std::string& collection, std::vector<bsoncxx::document::value> docs ) {
+   if( docs.empty() ) return;
+   pending_trace_writes.emplace_back( async_thread_pool( trace_thread_pool->get_executor(),
+         [this, collection, docs{std::move( docs )}]() {
       try {
-         if( !bulk_action_traces.execute() ) {
-            EOS_ASSERT( false, chain::mongo_db_insert_fail,
-                        "Bulk action traces insert failed for transaction trace: ${id}", ("id", t->id) );
+         auto client = mongo_pool->acquire();
+         auto col = (*client)[db_name][collection];
+         mongocxx::options::bulk_write bulk_opts;
+         bulk_opts.ordered( false );
+         auto bulk = col.create_bulk_write( bulk_opts );
+         for( const auto& d : docs ) {
+            bulk.append( mongocxx::model::insert_one{d.view()} );
+         }
+         if( !bulk.execute() ) {
+            EOS_ASSERT( false, chain::mongo_db_insert_fail, "Bulk ${c} insert failed", ("c", collection) );
          }
       } catch( ... ) {
-         handle_mongo_exception( "action traces insert", __LINE__ );
+         handle_mongo_exception( collection + " insert", __LINE__ );
       }
+   } ) );
+}
+
+void mongo_db_plugin_impl::wait_trace_writes() {
+   for( auto& f : pending_trace_writes ) {
+      f.get();
    }
+   pending_trace_writes.clear();
+}
 
+void mongo_db_plugin_impl::process_applied_transactions( const std::deque<chain::transaction_trace_ptr>& traces ) {
+   // a setabi changes how every later trace is converted, so the traces in between are converted in parallel and
+   // a trace with a setabi on its own once they are done, updating accounts as it goes as before
+   auto changes_abi = []( const chain::transaction_trace_ptr& t ) {
+      if( !t->receipt.valid() || t->receipt->status != chain::transaction_receipt_header::executed ) return false;
+      for( const auto& atrace : t->action_traces ) {
+         if( atrace.receiver == chain::config::system_account_name &&
+             atrace.act.account == chain::config::system_account_name && atrace.act.name == setabi )
+            return true;
+      }
+      return false;
+   };
+
+   try {
+      std::vector<trace_documents> docs( traces.size() );
+      size_t begin = 0;
+      while( begin < traces.size() ) {
+         size_t end = begin;
+         while( end < traces.size() && !changes_abi( traces[end] ) ) ++end;
+
+         if( end > begin ) {
+            const size_t chunk = (end - begin + trace_threads - 1) / trace_threads;
+            std::vector<std::future<void>> conversions;
+            for( size_t b = begin; b < end; b += chunk ) {
+               const size_t e = std::min( b + chunk, end );
+               conversions.emplace_back( async_thread_pool( trace_thread_pool->get_executor(), [this, &traces, &docs, b, e]() {
+                  for( size_t i = b; i < e; ++i ) docs[i] = convert_trace( traces[i], false );
+               } ) );
+            }
+            // always update accounts since we need to capture account changes even if not storing transaction traces
+            for( size_t i = begin; i < end; ++i ) update_accounts( traces[i] );
+            for( auto& f : conversions ) f.get();
+         }
+         if( end < traces.size() ) {
+            docs[end] = convert_trace( traces[end], true );
+            ++end;
+         }
+         begin = end;
+      }
+
+      std::vector<bsoncxx::document::value> action_traces_docs;
+      std::vector<bsoncxx::document::value> trans_traces_docs;
+      for( auto& d : docs ) {
+         std::move( d.action_traces.begin(), d.action_traces.end(), std::back_inserter( action_traces_docs ) );
+         if( d.trans_trace ) trans_traces_docs.emplace_back( std::move( *d.trans_trace ) );
+      }
+
+      wait_trace_writes();
+      write_trace_documents( action_traces_col, std::move( action_traces_docs ) );
+      write_trace_documents( trans_traces_col, std::move( trans_traces_docs ) );
+   } catch (fc::exception& e) {
+      elog("FC Exception while processing applied transaction traces: ${e}", ("e", e.to_detail_string()));
+   } catch (std::exception& e) {
+      elog("STD Exception while processing applied transaction traces: ${e}", ("e", e.what()));
+   } catch (...) {
+      elog("Unknown exception while processing applied transaction traces");
+   }
 }
 
 void mongo_db_plugin_impl::_process_accepted_block( const chain::block_state_ptr& bs ) {
@@ -1273,7 +1539,10 @@ void mongo_db_plugin_impl::update_account(const chain::action& act)
                std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()} );
          auto setabi = act.data_as<chain::setabi>();
 
-         abi_cache_index.erase( setabi.account );
+         {
+            std::lock_guard<std::mutex> g( abi_cache_mtx );
+            abi_cache_index.erase( setabi.account );
+         }
 
          auto account = find_account( _accounts, setabi.account );
          if( !account ) {
@@ -1320,9 +1589,12 @@ mongo_db_plugin_impl::~mongo_db_plugin_impl() {
          ilog( "mongo_db_plugin shutdown in process please be patient this can take a few minutes" );
          done = true;
          condition.notify_one();
+         space_condition.notify_all();
 
          consume_thread.join();
+         if( trace_thread_pool ) trace_thread_pool->stop();
 
+         abi_client.reset();
          mongo_pool.reset();
       } catch( std::exception& e ) {
          elog( "Exception on mongo_db_plugin shutdown of consume thread: ${e}", ("e", e.what()));
@@ -1485,6 +1757,7 @@ void mongo_db_plugin_impl::init() {
 
    ilog("starting db plugin thread");
 
+   trace_thread_pool.emplace( "mongo", trace_threads );
    consume_thread = std::thread( [this] {
       fc::set_os_thread_name( "mongodb" );
       consume_blocks();
@@ -1511,8 +1784,15 @@ void mongo_db_plugin::set_program_options(options_description& cli, options_desc
    cfg.add_options()
          ("mongodb-queue-size,q", bpo::value<uint32_t>()->default_value(1024),
          "The target queue size between nodeos and MongoDB plugin thread.")
+         ("mongodb-queue-memory-mb", bpo::value<uint32_t>()->default_value(1024),
+         "Maximum estimated memory (in MiB) of the entries queued for the MongoDB plugin thread.")
+         ("mongodb-spill-dir", bpo::value<bfs::path>(),
+         "Directory of a journal the entries that do not fit in the queue are written to, instead of making nodeos wait for MongoDB."
+               " If a relative path is specified then it is relative to the data directory. Not used if not specified.")
          ("mongodb-abi-cache-size", bpo::value<uint32_t>()->default_value(2048),
           "The maximum size of the abi cache for serializing data.")
+         ("mongodb-threads", bpo::value<uint16_t>()->default_value(2),
+          "Number of worker threads converting transaction traces to BSON and writing them to mongodb.")
          ("mongodb-wipe", bpo::bool_switch()->default_value(false),
          "Required with --replay-blockchain, --hard-replay-blockchain, or --delete-all-blocks to wipe mongo db."
          "This option required to prevent accidental wipe of mongo db.")
@@ -1568,10 +1848,24 @@ void mongo_db_plugin::plugin_initialize(const variables_map& options)
          if( options.count( "mongodb-queue-size" )) {
             my->max_queue_size = options.at( "mongodb-queue-size" ).as<uint32_t>();
          }
+         my->max_queue_bytes = uint64_t( options.at( "mongodb-queue-memory-mb" ).as<uint32_t>() ) * 1024 * 1024;
+         if( options.count( "mongodb-spill-dir" )) {
+            auto dir = options.at( "mongodb-spill-dir" ).as<bfs::path>();
+            if( dir.is_relative() )
+               dir = app().data_dir() / dir;
+            if( !fc::is_directory( dir ) )
+               fc::create_directories( dir );
+            my->journal.emplace( dir / "mongodb-spill.log" );
+            my->spilling = !my->journal->empty();
+            if( my->spilling )
+               ilog( "mongo_db_plugin reading back entries spilled before the last shutdown" );
+         }
          if( options.count( "mongodb-abi-cache-size" )) {
             my->abi_cache_size = options.at( "mongodb-abi-cache-size" ).as<uint32_t>();
             EOS_ASSERT( my->abi_cache_size > 0, chain::plugin_config_exception, "mongodb-abi-cache-size > 0 required" );
          }
+         my->trace_threads = options.at( "mongodb-threads" ).as<uint16_t>();
+         EOS_ASSERT( my->trace_threads > 0, chain::plugin_config_exception, "mongodb-threads > 0 required" );
          if( options.count( "mongodb-block-start" )) {
             my->start_block_num = options.at( "mongodb-block-start" ).as<uint32_t>();
          }
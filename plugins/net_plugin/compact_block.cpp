@@ -0,0 +1,68 @@
+#include <eosio/net_plugin/compact_block.hpp>
+#include <eosio/chain/merkle.hpp>
+
+namespace eosio {
+
+   compact_block_message make_compact_block( const signed_block& b,
+                                             const std::function<bool(const transaction_id_type&)>& known ) {
+      compact_block_message msg;
+      msg.header = b;
+      msg.block_extensions = b.block_extensions;
+      msg.transactions.reserve( b.transactions.size() );
+      for( const auto& receipt : b.transactions ) {
+         if( receipt.trx.contains<packed_transaction>() ) {
+            const auto& tid = receipt.trx.get<packed_transaction>().id();
+            if( known( tid ) ) {
+               msg.compacted.push_back( msg.transactions.size() );
+               transaction_receipt compacted( tid );
+               static_cast<transaction_receipt_header&>( compacted ) = receipt;
+               msg.transactions.emplace_back( std::move( compacted ) );
+               continue;
+            }
+         }
+         msg.transactions.emplace_back( receipt );
+      }
+      return msg;
+   }
+
+   optional<compact_block_restore> restore_compact_block( const compact_block_message& msg,
+                                                          const std::function<packed_transaction_ptr(const transaction_id_type&)>& find ) {
+      compact_block_restore r;
+      r.id = msg.header.id();
+      r.block = std::make_shared<signed_block>( msg.header );
+      r.block->transactions = msg.transactions;
+      r.block->block_extensions = msg.block_extensions;
+
+      for( auto i : msg.compacted ) {
+         if( i >= r.block->transactions.size() || !r.block->transactions[i].trx.contains<transaction_id_type>() ) {
+            return {};
+         }
+         auto& receipt = r.block->transactions[i];
+         if( auto trx = find( receipt.trx.get<transaction_id_type>() ) ) {
+            receipt.trx = *trx;
+         } else {
+            r.missing.push_back( i );
+         }
+      }
+      return r;
+   }
+
+   bool fill_compact_block( compact_block_restore& r, const vector<packed_transaction>& trxs ) {
+      if( trxs.size() != r.missing.size() ) return false;
+      for( size_t i = 0; i < r.missing.size(); ++i ) {
+         r.block->transactions[r.missing[i]].trx = trxs[i];
+      }
+      r.missing.clear();
+      return true;
+   }
+
+   bool matches_transaction_mroot( const signed_block& b ) {
+      vector<digest_type> trx_digests;
+      trx_digests.reserve( b.transactions.size() );
+      for( const auto& receipt : b.transactions ) {
+         trx_digests.emplace_back( receipt.digest() );
+      }
+      return merkle( std::move( trx_digests ) ) == b.transaction_mroot;
+   }
+
+} // namespace eosio
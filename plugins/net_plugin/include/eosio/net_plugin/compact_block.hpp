@@ -0,0 +1,35 @@
+#pragma once
+#include <eosio/net_plugin/protocol.hpp>
+
+#include <functional>
+
+namespace eosio {
+
+   /**
+    * The compact form of @ref b: every packed transaction @ref known reports is replaced by its id.
+    * compacted is empty when no transaction is known, and the block is then better sent in full.
+    */
+   compact_block_message make_compact_block( const signed_block& b,
+                                             const std::function<bool(const transaction_id_type&)>& known );
+
+   /// a block being restored from a compact_block_message
+   struct compact_block_restore {
+      block_id_type      id;
+      signed_block_ptr   block;
+      vector<uint32_t>   missing; ///< indexes of the receipts @ref find did not have, still holding only an id
+   };
+
+   /**
+    * Restores the compacted receipts of @ref msg with the transactions @ref find has.
+    * @return empty when a compacted index does not refer to a receipt holding an id
+    */
+   optional<compact_block_restore> restore_compact_block( const compact_block_message& msg,
+                                                          const std::function<packed_transaction_ptr(const transaction_id_type&)>& find );
+
+   /// fills in the missing receipts of @ref r, @return false when @ref trxs is not one transaction per missing receipt
+   bool fill_compact_block( compact_block_restore& r, const vector<packed_transaction>& trxs );
+
+   /// a restored transaction can share the id of the one in the block but differ in signatures or compression
+   bool matches_transaction_mroot( const signed_block& b );
+
+} // namespace eosio
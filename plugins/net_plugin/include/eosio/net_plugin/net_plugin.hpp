@@ -10,9 +10,39 @@ namespace eosio {
       string            peer;
       bool              connecting = false;
       bool              syncing    = false;
+      uint64_t          writes = 0;           ///< socket writes started
+      uint64_t          bytes_written = 0;
+      uint32_t          write_queue_size = 0; ///< bytes waiting to be written
+      int64_t           rtt_us = -1;          ///< smoothed round trip time, -1 until measured
+      uint32_t          request_timeouts = 0;
+      uint32_t          rejected_blocks = 0;
       handshake_message last_handshake;
    };
 
+   /// counters since the connection object was created, it is reused on reconnect
+   struct connection_metrics {
+      string            peer;
+      uint64_t          bytes_received = 0;
+      uint64_t          bytes_written = 0;
+      uint64_t          writes = 0;
+      uint32_t          write_queue_size = 0;
+      vector<uint64_t>  messages_received;         ///< indexed by which of net_message
+      uint64_t          message_processing_us = 0; ///< time spent handling received messages on the net threads
+      uint64_t          blocks_received = 0;
+      int64_t           rtt_us = -1;
+   };
+
+   struct net_metrics {
+      uint64_t                    bytes_received = 0;
+      uint64_t                    bytes_written = 0;
+      uint64_t                    writes = 0;
+      uint64_t                    blocks_received = 0;
+      uint64_t                    message_processing_us = 0;
+      uint64_t                    send_buffer_pool_hits = 0;
+      uint64_t                    send_buffer_pool_misses = 0;
+      vector<connection_metrics>  connections;
+   };
+
    class net_plugin : public appbase::plugin<net_plugin>
    {
       public:
@@ -31,6 +61,7 @@ namespace eosio {
         string                       disconnect( const string& endpoint );
         optional<connection_status>  status( const string& endpoint )const;
         vector<connection_status>    connections()const;
+        net_metrics                  metrics()const;
 
       private:
         std::shared_ptr<class net_plugin_impl> my;
@@ -38,4 +69,9 @@ namespace eosio {
 
 }
 
-FC_REFLECT( eosio::connection_status, (peer)(connecting)(syncing)(last_handshake) )
+FC_REFLECT( eosio::connection_metrics, (peer)(bytes_received)(bytes_written)(writes)(write_queue_size)
+                                        (messages_received)(message_processing_us)(blocks_received)(rtt_us) )
+FC_REFLECT( eosio::net_metrics, (bytes_received)(bytes_written)(writes)(blocks_received)(message_processing_us)
+                                 (send_buffer_pool_hits)(send_buffer_pool_misses)(connections) )
+FC_REFLECT( eosio::connection_status, (peer)(connecting)(syncing)(writes)(bytes_written)(write_queue_size)
+                                       (rtt_us)(request_timeouts)(rejected_blocks)(last_handshake) )
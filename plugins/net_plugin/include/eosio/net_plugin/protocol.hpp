@@ -135,6 +135,34 @@ namespace eosio {
       uint32_t end_block{0};
    };
 
+   /**
+    * A signed_block in which the packed_transaction of each receipt listed in compacted is replaced by its transaction
+    * id, relayed in place of the block to peers that most likely already received those transactions.
+    */
+   struct compact_block_message {
+      signed_block_header              header;
+      vector<transaction_receipt>      transactions;
+      extensions_type                  block_extensions;
+      vector<uint32_t>                 compacted; ///< indexes into transactions, ascending
+   };
+
+   /// asks the sender of a compact_block_message for the packed transactions the receiver could not restore
+   struct compact_block_request_message {
+      block_id_type                    id;
+      vector<uint32_t>                 missing; ///< indexes into compact_block_message::transactions
+   };
+
+   struct compact_block_transactions_message {
+      block_id_type                    id;
+      vector<packed_transaction>       transactions; ///< in the order of compact_block_request_message::missing
+   };
+
+   /// a signed_block sent while syncing, compressed for peers that negotiated it
+   struct compressed_block_message {
+      uint8_t                          codec = 0;    ///< block_codec the block was compressed with
+      bytes                            packed_block; ///< compressed packed signed_block
+   };
+
    using net_message = static_variant<handshake_message,
                                       chain_size_message,
                                       go_away_message,
@@ -143,7 +171,11 @@ namespace eosio {
                                       request_message,
                                       sync_request_message,
                                       signed_block,         // which = 7
-                                      packed_transaction>;  // which = 8
+                                      packed_transaction,   // which = 8
+                                      compact_block_message,
+                                      compact_block_request_message,
+                                      compact_block_transactions_message,
+                                      compressed_block_message>;
 
 } // namespace eosio
 
@@ -162,6 +194,10 @@ FC_REFLECT( eosio::time_message, (org)(rec)(xmt)(dst) )
 FC_REFLECT( eosio::notice_message, (known_trx)(known_blocks) )
 FC_REFLECT( eosio::request_message, (req_trx)(req_blocks) )
 FC_REFLECT( eosio::sync_request_message, (start_block)(end_block) )
+FC_REFLECT( eosio::compact_block_message, (header)(transactions)(block_extensions)(compacted) )
+FC_REFLECT( eosio::compact_block_request_message, (id)(missing) )
+FC_REFLECT( eosio::compact_block_transactions_message, (id)(transactions) )
+FC_REFLECT( eosio::compressed_block_message, (codec)(packed_block) )
 
 /**
  *
@@ -2,9 +2,11 @@
 
 #include <eosio/net_plugin/net_plugin.hpp>
 #include <eosio/net_plugin/protocol.hpp>
+#include <eosio/net_plugin/compact_block.hpp>
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/block.hpp>
+#include <eosio/chain/block_compression.hpp>
 #include <eosio/chain/plugin_interface.hpp>
 #include <eosio/chain/thread_utils.hpp>
 #include <eosio/producer_plugin/producer_plugin.hpp>
@@ -23,8 +25,11 @@
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ip/host_name.hpp>
 #include <boost/asio/steady_timer.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
 
 #include <atomic>
+#include <deque>
+#include <map>
 #include <shared_mutex>
 
 using namespace eosio::chain::plugin_interface;
@@ -64,6 +69,7 @@ namespace eosio {
       time_point_sec  expires;        /// time after which this may be purged.
       uint32_t        block_num = 0;  /// block transaction was included in
       uint32_t        connection_id = 0;
+      packed_transaction_ptr trx;     /// kept to restore compact blocks, may be null
    };
 
    struct by_expiry;
@@ -120,6 +126,29 @@ namespace eosio {
       >
       > peer_block_state_index;
 
+   /// a framed signed_block message shared by every connection the block is sent to
+   struct block_send_buffer {
+      block_id_type                      id;
+      uint32_t                           block_num = 0;
+      bool                               irreversible = false; // only then does block_num identify the block
+      std::shared_ptr<std::vector<char>> send_buffer;
+      std::shared_ptr<std::vector<char>> compressed_send_buffer; // send_buffer as a compressed_block_message, once made
+   };
+
+   typedef multi_index_container<
+      block_send_buffer,
+      indexed_by<
+         sequenced<>, // insertion order, oldest evicted first
+         ordered_unique< tag<by_block_id>, member<block_send_buffer, block_id_type, &block_send_buffer::id>, sha256_less >,
+         ordered_non_unique< tag<by_block_num>,
+               composite_key< block_send_buffer,
+                     member<block_send_buffer, uint32_t, &block_send_buffer::block_num>,
+                     member<block_send_buffer, bool, &block_send_buffer::irreversible>
+               >
+         >
+      >
+      > block_send_buffer_index;
+
 
    struct update_block_num {
       uint32_t new_bnum;
@@ -141,8 +170,13 @@ namespace eosio {
       uint32_t       sync_known_lib_num{0};
       uint32_t       sync_last_requested_num{0};
       uint32_t       sync_next_expected_num{0};
+      uint32_t       sync_fetch_span{0};   // configured span, sync_req_span adapts around it
       uint32_t       sync_req_span{0};
+      uint32_t       sync_prefetch_num{0}; // on receipt, request the chunk after sync_last_requested_num
+      uint32_t       sync_source_end_num{0}; // last block of the range requested from sync_source
       connection_ptr sync_source;
+      connection_ptr sync_follow_source; // serves sync_source_end_num+1 to sync_last_requested_num
+      std::map<uint32_t, std::pair<block_id_type, signed_block_ptr>> sync_held_blocks; // from sync_follow_source, not yet linkable
       std::atomic<stages> sync_state{in_sync};
 
    private:
@@ -150,6 +184,10 @@ namespace eosio {
       void set_state( stages s );
       bool is_sync_required( uint32_t fork_head_block_num );
       void request_next_chunk( std::unique_lock<std::mutex> g_sync, const connection_ptr& conn = connection_ptr() );
+      void request_following_chunk( std::unique_lock<std::mutex> g_sync );
+      void promote_follow_source();
+      void drop_follow_source( bool cancel );
+      void adapt_req_span( bool grow );
       void start_sync( const connection_ptr& c, uint32_t target );
       bool verify_catchup( const connection_ptr& c, uint32_t num, const block_id_type& id );
 
@@ -162,6 +200,7 @@ namespace eosio {
       void rejected_block( const connection_ptr& c, uint32_t blk_num );
       void sync_recv_block( const connection_ptr& c, const block_id_type& blk_id, uint32_t blk_num, bool blk_applied );
       void sync_update_expected( const connection_ptr& c, const block_id_type& blk_id, uint32_t blk_num, bool blk_applied );
+      bool hold_sync_block( const connection_ptr& c, const block_id_type& blk_id, const signed_block_ptr& blk );
       void recv_handshake( const connection_ptr& c, const handshake_message& msg );
       void sync_recv_notice( const connection_ptr& c, const notice_message& msg );
    };
@@ -169,8 +208,25 @@ namespace eosio {
    class dispatch_manager {
       mutable std::mutex      blk_state_mtx;
       peer_block_state_index  blk_state;
-      mutable std::mutex      local_txns_mtx;
-      node_transaction_index  local_txns;
+      /// local_txns split by transaction id, so threads working on different transactions do not contend
+      struct local_txns_shard {
+         mutable std::mutex      mtx;
+         node_transaction_index  txns;
+      };
+      static constexpr size_t local_txns_shard_count = 16;
+      std::array<local_txns_shard, local_txns_shard_count> local_txns;
+
+      local_txns_shard& txns_shard( const transaction_id_type& tid ) {
+         return local_txns[tid._hash[0] % local_txns_shard_count];
+      }
+      const local_txns_shard& txns_shard( const transaction_id_type& tid ) const {
+         return local_txns[tid._hash[0] % local_txns_shard_count];
+      }
+      mutable std::mutex      block_buffers_mtx;
+      block_send_buffer_index block_buffers;
+      size_t                  block_buffers_size = 0; // bytes held by block_buffers
+
+      void evict_block_buffers();
 
    public:
       boost::asio::io_context::strand  strand;
@@ -178,10 +234,25 @@ namespace eosio {
       explicit dispatch_manager(boost::asio::io_context& io_context)
       : strand( io_context ) {}
 
-      void bcast_transaction(const packed_transaction& trx);
+      void bcast_transaction(const packed_transaction_ptr& trx);
       void rejected_transaction(const packed_transaction_ptr& trx, uint32_t head_blk_num);
-      void bcast_block( const signed_block_ptr& b, const block_id_type& id );
+      /// peers reached through an endpoint of @ref upcoming_peers are sent b first, ahead of their queued messages
+      void bcast_block( const signed_block_ptr& b, const block_id_type& id,
+                        const std::shared_ptr<const std::vector<char>>& packed_block = {},
+                        const vector<string>& upcoming_peers = {} );
+      /// @return b with the transactions known locally replaced by their ids, null if there are none
+      std::shared_ptr<std::vector<char>> create_compact_send_buffer( const signed_block& b ) const;
       void bcast_notice( const block_id_type& id );
+
+      /// @return the cached send buffer of block id, null if there is none
+      std::shared_ptr<std::vector<char>> find_block_buffer( const block_id_type& id ) const;
+      /// @return the cached send buffer of irreversible block bnum, null if there is none
+      std::shared_ptr<std::vector<char>> find_irreversible_block_buffer( uint32_t bnum ) const;
+      void add_block_buffer( const block_id_type& id, uint32_t bnum, bool irreversible,
+                             const std::shared_ptr<std::vector<char>>& send_buffer );
+      /// @return send_buffer of block bnum as a compressed_block_message, compressed once and then shared while cached
+      std::shared_ptr<std::vector<char>> compressed_block_buffer( uint32_t bnum, const std::shared_ptr<std::vector<char>>& send_buffer );
+
       void rejected_block(const block_id_type& id);
 
       void recv_block(const connection_ptr& conn, const block_id_type& msg, uint32_t bnum);
@@ -199,6 +270,7 @@ namespace eosio {
       void update_txns_block_num( const transaction_id_type& id, uint32_t blk_num );
       bool peer_has_txn( const transaction_id_type& tid, uint32_t connection_id ) const;
       bool have_txn( const transaction_id_type& tid ) const;
+      packed_transaction_ptr find_txn( const transaction_id_type& tid ) const;
       void expire_txns( uint32_t lib_num );
    };
 
@@ -238,6 +310,12 @@ namespace eosio {
       uint32_t                              max_client_count = 0;
       uint32_t                              max_nodes_per_host = 1;
       bool                                  p2p_accept_transactions = true;
+      uint32_t                              max_trx_in_progress_size = def_max_trx_in_progress_size; ///< per connection, reads pause above it
+      uint32_t                              p2p_compress_blocks_threshold = 0; ///< sync blocks at least this large are compressed, 0 for none
+      block_codec                           p2p_compress_blocks_codec = block_codec::zlib;
+      std::chrono::microseconds             p2p_write_coalesce_period{0}; ///< longest a small message waits for others to join its write
+      uint32_t                              p2p_write_coalesce_bytes = 0; ///< queued bytes at which a write is no longer delayed
+      std::multimap<chain::account_name, string> producer_peers; ///< p2p-producer-peer, endpoints of producers and their proxies
 
       /// Peer clock may be no more than 1 second skewed from our clock, including network latency.
       const std::chrono::system_clock::duration peer_authentication_interval{std::chrono::seconds{1}};
@@ -270,6 +348,19 @@ namespace eosio {
 
       uint16_t                                  thread_pool_size = 2;
       optional<eosio::chain::named_thread_pool> thread_pool;
+      uint16_t                                  trx_thread_pool_size = 0;
+      optional<eosio::chain::named_thread_pool> trx_thread_pool; ///< transactions only peers, if net-transaction-threads
+
+      /// a transaction received from a peer, waiting to be accepted on the application thread
+      struct incoming_transaction {
+         packed_transaction_ptr    trx;
+         std::weak_ptr<connection> conn;
+         fc::time_point            queued;
+      };
+      /// accepted by one application thread task; the rest waits behind tasks of higher priority posted meanwhile
+      static constexpr size_t               max_incoming_transaction_batch = 32;
+      std::mutex                            incoming_transactions_mtx;
+      std::deque<incoming_transaction>      incoming_transactions; ///< protected by incoming_transactions_mtx
 
    private:
       mutable std::mutex            chain_info_mtx; // protects chain_*
@@ -289,9 +380,14 @@ namespace eosio {
 
       void on_accepted_block( const block_state_ptr& bs );
       void on_pre_accepted_block( const signed_block_ptr& bs );
+      /// @return the producer_peers of the producers scheduled in bhs to follow the block at t
+      vector<string> upcoming_producer_peers( const block_header_state& bhs, block_timestamp_type t ) const;
       void transaction_ack(const std::pair<fc::exception_ptr, transaction_metadata_ptr>&);
       void on_irreversible_block( const block_state_ptr& blk );
 
+      void queue_incoming_transaction( packed_transaction_ptr trx, std::weak_ptr<connection> c );
+      void accept_incoming_transactions();
+
       void start_conn_timer(boost::asio::steady_timer::duration du, std::weak_ptr<connection> from_connection);
       void start_expire_timer();
       void start_monitors();
@@ -380,6 +476,7 @@ namespace eosio {
    constexpr auto     def_send_buffer_size = 1024*1024*def_send_buffer_size_mb;
    constexpr auto     def_max_write_queue_size = def_send_buffer_size*10;
    constexpr auto     def_max_trx_in_progress_size = 100*1024*1024; // 100 MB
+   constexpr auto     def_block_buffer_cache_size = 64*1024*1024; // 64 MB of block send buffers shared by connections
    constexpr auto     def_max_consecutive_rejected_blocks = 13; // num of rejected blocks before disconnect
    constexpr auto     def_max_consecutive_immediate_connection_close = 9; // back off if client keeps closing
    constexpr auto     def_max_clients = 25; // 0 for unlimited clients
@@ -388,10 +485,16 @@ namespace eosio {
    constexpr auto     def_txn_expire_wait = std::chrono::seconds(3);
    constexpr auto     def_resp_expected_wait = std::chrono::seconds(5);
    constexpr auto     def_sync_fetch_span = 100;
+   constexpr uint32_t def_sync_span_factor = 4; // sync chunks shrink and grow within sync-fetch-span divided and multiplied by this
+   constexpr size_t   def_upcoming_producers = 2; // producers scheduled after a block whose peers are sent it first
+   constexpr int64_t  def_unmeasured_rtt_us = 500*1000; // assumed round trip of a peer not yet measured
+   constexpr int64_t  def_peer_penalty_us = 1000*1000; // added to a peer score for each timeout or rejected block
 
    constexpr auto     message_header_size = 4;
    constexpr uint32_t signed_block_which = 7;        // see protocol net_message
    constexpr uint32_t packed_transaction_which = 8;  // see protocol net_message
+   constexpr uint32_t compact_block_which = 9;       // see protocol net_message
+   constexpr uint32_t compressed_block_which = 12;   // see protocol net_message
 
    /**
     *  For a while, network version was a 16 bit value equal to the second set of 16 bits
@@ -414,8 +517,13 @@ namespace eosio {
    constexpr uint16_t proto_base = 0;
    constexpr uint16_t proto_explicit_sync = 1;
    constexpr uint16_t block_id_notify = 2; // reserved. feature was removed. next net_version should be 3
+   constexpr uint16_t proto_compact_block = 3; // compact_block_message and its request/transactions messages
 
-   constexpr uint16_t net_version = proto_explicit_sync;
+   constexpr size_t max_pending_compact_blocks = 4; // per connection, beyond it the oldest is requested in full
+   constexpr uint16_t proto_pipelined_sync = 4; // a sync_request continuing the range being served extends it
+   constexpr uint16_t proto_compressed_block = 5; // compressed_block_message
+
+   constexpr uint16_t net_version = proto_compressed_block;
 
    /**
     * Index by start_block_num
@@ -537,14 +645,21 @@ namespace eosio {
 
       bool socket_is_open() const { return socket_open.load(); } // thread safe, atomic
       const string& peer_address() const { return peer_addr; } // thread safe, const
+      /// @return true if this peer was configured as or identified itself by one of endpoints, locks conn_mtx
+      bool reached_through( const vector<string>& endpoints );
 
       void set_connection_type( const string& peer_addr );
+      /// @return the executor serving a connection to peer_add, the transaction pool for a transactions only peer
+      static boost::asio::io_context& executor_for( const string& peer_add );
       bool is_transactions_only_connection()const { return connection_type == transactions_only; }
       bool is_blocks_only_connection()const { return connection_type == blocks_only; }
 
    private:
       static const string unknown;
 
+      /// @return the type in host:port:[<trx>|<blk>], empty if there is none
+      static string connection_type_of( const string& peer_add );
+
       void update_endpoints();
 
       optional<peer_sync_state>    peer_requested;  // this peer is requesting info from us
@@ -561,6 +676,7 @@ namespace eosio {
       std::atomic<connection_types>             connection_type{both};
 
    public:
+      boost::asio::io_context&                  io_context; ///< of the thread pool serving this connection
       boost::asio::io_context::strand           strand;
       std::shared_ptr<tcp::socket>              socket; // only accessed through strand after construction
 
@@ -570,17 +686,40 @@ namespace eosio {
       queued_buffer           buffer_queue;
 
       std::atomic<uint32_t>   trx_in_progress_size{0};
+      std::atomic<bool>       read_paused{false}; ///< reads wait for trx_in_progress_size to drop under the limit
       const uint32_t          connection_id;
       int16_t                 sent_handshake_count = 0;
       std::atomic<bool>       connecting{true};
       std::atomic<bool>       syncing{false};
       uint16_t                protocol_version = 0;
       uint16_t                consecutive_rejected_blocks = 0;
+
+      /// compact blocks waiting for the transactions requested from this peer, by block id, only accessed from strand
+      std::map<block_id_type, compact_block_restore> pending_compacts;
       std::atomic<uint16_t>   consecutive_immediate_connection_close = 0;
 
       std::mutex                            response_expected_timer_mtx;
       boost::asio::steady_timer             response_expected_timer;
 
+      boost::asio::steady_timer             write_coalesce_timer; ///< only accessed from strand
+      bool                                  write_coalesce_pending = false; ///< only accessed from strand
+      std::atomic<uint64_t>                 writes{0};
+      std::atomic<uint64_t>                 bytes_written{0};
+      std::atomic<uint64_t>                 bytes_received{0};
+      std::array<std::atomic<uint64_t>, net_message::count()> messages_received{}; ///< by which of net_message
+      std::atomic<uint64_t>                 message_processing_us{0};
+      std::atomic<uint64_t>                 blocks_received{0};
+
+      std::atomic<int64_t>                  rtt_us{-1};        ///< smoothed round trip time from time_message, -1 until measured
+      std::atomic<uint32_t>                 request_timeouts{0}; ///< sync and fetch requests to this peer that timed out
+      std::atomic<uint32_t>                 rejected_blocks{0};
+
+      /// lower is better, used to pick the peers blocks are requested from
+      int64_t peer_score() const {
+         const int64_t rtt = rtt_us.load();
+         return ( rtt >= 0 ? rtt : def_unmeasured_rtt_us ) + int64_t( request_timeouts + rejected_blocks ) * def_peer_penalty_us;
+      }
+
       std::atomic<go_away_reason>           no_retry{no_reason};
 
       mutable std::mutex          conn_mtx; //< mtx for last_req .. local_endpoint_port
@@ -597,6 +736,7 @@ namespace eosio {
       string                      local_endpoint_port;
 
       connection_status get_status()const;
+      connection_metrics get_metrics()const;
 
       /** \name Peer Timestamps
        *  Time message handling
@@ -634,6 +774,10 @@ namespace eosio {
        * encountered unpacking or processing the message.
        */
       bool process_next_message(uint32_t message_length);
+      /// @return false if the block is not to be processed, a known or stale block is dealt with here
+      bool check_received_block( const block_id_type& blk_id, const block_header& bh );
+      /// @return false if the connection was closed
+      bool process_compressed_block( const compressed_block_message& msg );
 
       void send_handshake( bool force = false );
 
@@ -666,7 +810,11 @@ namespace eosio {
       void stop_send();
 
       void enqueue( const net_message &msg );
-      void enqueue_block( const signed_block_ptr& sb, bool to_sync_queue = false);
+      void enqueue_block( const block_id_type& id, const signed_block_ptr& sb, bool to_sync_queue = false);
+      /// sync queue only, packed_block is a serialized signed_block
+      void enqueue_packed_block( uint32_t block_num, const std::vector<char>& packed_block, bool irreversible );
+      /// sync queue only, send_buffer is a framed signed_block, compressed first when negotiated with the peer
+      void enqueue_sync_buffer( uint32_t block_num, const std::shared_ptr<std::vector<char>>& send_buffer );
       void enqueue_buffer( const std::shared_ptr<std::vector<char>>& send_buffer,
                            go_away_reason close_after_send,
                            bool to_sync_queue = false);
@@ -713,6 +861,14 @@ namespace eosio {
       void handle_message( const block_id_type& id, signed_block_ptr msg );
       void handle_message( const packed_transaction& msg ) = delete; // packed_transaction_ptr overload used instead
       void handle_message( packed_transaction_ptr msg );
+      void handle_message( const compact_block_message& msg );
+      void handle_message( const compact_block_request_message& msg );
+      void handle_message( const compact_block_transactions_message& msg );
+
+      /// hands a complete block from this peer on to process_signed_block, false if the connection was closed over it
+      bool recv_complete_block( const block_id_type& id, signed_block_ptr ptr );
+      /// hands a block restored from a compact block on, or asks for the full block if it does not match its header
+      void recv_restored_block( const block_id_type& id, signed_block_ptr ptr );
 
       void process_signed_block( const block_id_type& id, signed_block_ptr msg );
 
@@ -783,6 +939,24 @@ namespace eosio {
          fc_dlog( logger, "handle sync_request_message" );
          c->handle_message( msg );
       }
+
+      void operator()( const compact_block_message& msg ) const {
+         // continue call to handle_message on connection strand
+         fc_dlog( logger, "handle compact_block_message" );
+         c->handle_message( msg );
+      }
+
+      void operator()( const compact_block_request_message& msg ) const {
+         // continue call to handle_message on connection strand
+         fc_dlog( logger, "handle compact_block_request_message" );
+         c->handle_message( msg );
+      }
+
+      void operator()( const compact_block_transactions_message& msg ) const {
+         // continue call to handle_message on connection strand
+         fc_dlog( logger, "handle compact_block_transactions_message" );
+         c->handle_message( msg );
+      }
    };
 
    template<typename Function>
@@ -806,10 +980,12 @@ namespace eosio {
 
    connection::connection( string endpoint )
       : peer_addr( endpoint ),
-        strand( my_impl->thread_pool->get_executor() ),
-        socket( new tcp::socket( my_impl->thread_pool->get_executor() ) ),
+        io_context( executor_for( endpoint ) ),
+        strand( io_context ),
+        socket( new tcp::socket( io_context ) ),
         connection_id( ++my_impl->current_connection_id ),
-        response_expected_timer( my_impl->thread_pool->get_executor() ),
+        response_expected_timer( io_context ),
+        write_coalesce_timer( io_context ),
         last_handshake_recv(),
         last_handshake_sent()
    {
@@ -818,10 +994,12 @@ namespace eosio {
 
    connection::connection()
       : peer_addr(),
-        strand( my_impl->thread_pool->get_executor() ),
-        socket( new tcp::socket( my_impl->thread_pool->get_executor() ) ),
+        io_context( my_impl->thread_pool->get_executor() ),
+        strand( io_context ),
+        socket( new tcp::socket( io_context ) ),
         connection_id( ++my_impl->current_connection_id ),
-        response_expected_timer( my_impl->thread_pool->get_executor() ),
+        response_expected_timer( io_context ),
+        write_coalesce_timer( io_context ),
         last_handshake_recv(),
         last_handshake_sent()
    {
@@ -840,16 +1018,25 @@ namespace eosio {
       local_endpoint_port = ec2 ? unknown : std::to_string(lep.port());
    }
 
-   void connection::set_connection_type( const string& peer_add ) {
+   string connection::connection_type_of( const string& peer_add ) {
       // host:port:[<trx>|<blk>]
       string::size_type colon = peer_add.find(':');
       string::size_type colon2 = peer_add.find(':', colon + 1);
       string::size_type end = colon2 == string::npos
             ? string::npos : peer_add.find_first_of( " :+=.,<>!$%^&(*)|-#@\t", colon2 + 1 ); // future proof by including most symbols without using regex
-      string host = peer_add.substr( 0, colon );
-      string port = peer_add.substr( colon + 1, colon2 == string::npos ? string::npos : colon2 - (colon + 1));
-      string type = colon2 == string::npos ? "" : end == string::npos ?
+      return colon2 == string::npos ? "" : end == string::npos ?
             peer_add.substr( colon2 + 1 ) : peer_add.substr( colon2 + 1, end - (colon2 + 1) );
+   }
+
+   boost::asio::io_context& connection::executor_for( const string& peer_add ) {
+      // the type of an incoming peer is only known from its handshake, it stays on the pool it was accepted on
+      if( my_impl->trx_thread_pool && connection_type_of( peer_add ) == "trx" )
+         return my_impl->trx_thread_pool->get_executor();
+      return my_impl->thread_pool->get_executor();
+   }
+
+   void connection::set_connection_type( const string& peer_add ) {
+      const string type = connection_type_of( peer_add );
 
       if( type.empty() ) {
          fc_dlog( logger, "Setting connection type for: ${peer} to both transactions and blocks", ("peer", peer_add) );
@@ -870,11 +1057,34 @@ namespace eosio {
       stat.peer = peer_addr;
       stat.connecting = connecting;
       stat.syncing = syncing;
+      stat.writes = writes;
+      stat.bytes_written = bytes_written;
+      stat.write_queue_size = buffer_queue.write_queue_size();
+      stat.rtt_us = rtt_us;
+      stat.request_timeouts = request_timeouts;
+      stat.rejected_blocks = rejected_blocks;
       std::lock_guard<std::mutex> g( conn_mtx );
       stat.last_handshake = last_handshake_recv;
       return stat;
    }
 
+   connection_metrics connection::get_metrics()const {
+      connection_metrics m;
+      m.peer = peer_addr;
+      m.bytes_received = bytes_received;
+      m.bytes_written = bytes_written;
+      m.writes = writes;
+      m.write_queue_size = buffer_queue.write_queue_size();
+      m.messages_received.reserve( messages_received.size() );
+      for( const auto& n : messages_received ) {
+         m.messages_received.push_back( n );
+      }
+      m.message_processing_us = message_processing_us;
+      m.blocks_received = blocks_received;
+      m.rtt_us = rtt_us;
+      return m;
+   }
+
    bool connection::start_session() {
       verify_strand_in_this_thread( strand, __func__, __LINE__ );
 
@@ -919,11 +1129,13 @@ namespace eosio {
          self->socket->shutdown( tcp::socket::shutdown_both, ec );
          self->socket->close( ec );
       }
-      self->socket.reset( new tcp::socket( my_impl->thread_pool->get_executor() ) );
+      self->socket.reset( new tcp::socket( self->io_context ) );
       self->flush_queues();
       self->connecting = false;
       self->syncing = false;
       self->consecutive_rejected_blocks = 0;
+      self->read_paused = false;
+      self->pending_compacts.clear();
       ++self->consecutive_immediate_connection_close;
       bool has_last_req = false;
       {
@@ -1015,13 +1227,21 @@ namespace eosio {
          connection_ptr c = weak.lock();
          if( !c ) return;
          try {
+            auto send_buffer = my_impl->dispatcher->find_block_buffer( blkid );
+            if( send_buffer ) {
+               my_impl->dispatcher->add_peer_block( blkid, c->connection_id );
+               c->strand.post( [c, send_buffer{std::move(send_buffer)}]() {
+                  c->enqueue_buffer( send_buffer, no_reason );
+               } );
+               return;
+            }
             controller& cc = my_impl->chain_plug->chain();
             signed_block_ptr b = cc.fetch_block_by_id( blkid );
             if( b ) {
                fc_dlog( logger, "found block for id at num ${n}", ("n", b->block_num()) );
                my_impl->dispatcher->add_peer_block( blkid, c->connection_id );
-               c->strand.post( [c, b{std::move(b)}]() {
-                  c->enqueue_block( b );
+               c->strand.post( [c, blkid, b{std::move(b)}]() {
+                  c->enqueue_block( blkid, b );
                } );
             } else {
                fc_ilog( logger, "fetch block by id returned null, id ${id} for ${p}",
@@ -1085,6 +1305,22 @@ namespace eosio {
          close();
          return;
       }
+      // let small real time messages, e.g. transactions, gather into one write instead of a write each
+      const auto coalesce_period = my_impl->p2p_write_coalesce_period;
+      if( !to_sync_queue && coalesce_period.count() > 0 && buffer_queue.write_queue_size() < my_impl->p2p_write_coalesce_bytes ) {
+         if( !write_coalesce_pending ) {
+            write_coalesce_pending = true;
+            write_coalesce_timer.expires_from_now( coalesce_period );
+            write_coalesce_timer.async_wait( boost::asio::bind_executor( strand,
+                  [c = shared_from_this()]( boost::system::error_code ec ) {
+               c->write_coalesce_pending = false;
+               if( ec != boost::asio::error::operation_aborted ) {
+                  c->do_queue_write();
+               }
+            } ) );
+         }
+         return;
+      }
       do_queue_write();
    }
 
@@ -1095,6 +1331,7 @@ namespace eosio {
 
       std::vector<boost::asio::const_buffer> bufs;
       buffer_queue.fill_out_buffer( bufs );
+      ++writes;
 
       strand.post( [c{std::move(c)}, bufs{std::move(bufs)}]() {
          boost::asio::async_write( *c->socket, bufs,
@@ -1119,6 +1356,7 @@ namespace eosio {
                   return;
                }
 
+               c->bytes_written += w;
                c->buffer_queue.out_callback( ec, w );
 
                c->enqueue_sync_block();
@@ -1168,10 +1406,20 @@ namespace eosio {
          connection_ptr c = weak.lock();
          if( !c ) return;
          controller& cc = my_impl->chain_plug->chain();
-         signed_block_ptr sb = cc.fetch_block_by_number( num );
-         if( sb ) {
-            c->strand.post( [c, sb{std::move(sb)}]() {
-               c->enqueue_block( sb, true );
+         const bool irreversible = num <= cc.last_irreversible_block_num();
+         if( irreversible ) {
+            auto send_buffer = my_impl->dispatcher->find_irreversible_block_buffer( num );
+            if( send_buffer ) {
+               c->strand.post( [c, num, send_buffer{std::move(send_buffer)}]() {
+                  c->enqueue_sync_buffer( num, send_buffer );
+               });
+               return;
+            }
+         }
+         auto packed_block = std::make_shared<std::vector<char>>( cc.fetch_serialized_block_by_number( num ) );
+         if( !packed_block->empty() ) {
+            c->strand.post( [c, num, irreversible, packed_block{std::move(packed_block)}]() {
+               c->enqueue_packed_block( num, *packed_block, irreversible );
             });
          } else {
             c->strand.post( [c, num]() {
@@ -1184,6 +1432,84 @@ namespace eosio {
       return true;
    }
 
+   /**
+    * Reuses the memory of send buffers, which would otherwise each be a fresh allocation from whichever net thread
+    * creates them. Buffers are kept in power of two size classes, larger ones are not pooled.
+    */
+   class send_buffer_pool : public std::enable_shared_from_this<send_buffer_pool> {
+   public:
+      static constexpr size_t min_class_size = 256;
+      static constexpr size_t class_count = 13;  // 256 bytes to 1 MiB
+      static constexpr size_t max_pooled = 64;   // free buffers kept per size class
+
+      // thread safe
+      std::shared_ptr<std::vector<char>> acquire( size_t size ) {
+         const size_t c = size_class( size );
+         if( c == class_count ) {
+            return std::make_shared<vector<char>>( size );
+         }
+         std::unique_ptr<vector<char>> buff;
+         {
+            std::lock_guard<std::mutex> g( _classes[c].mtx );
+            auto& free = _classes[c].free;
+            if( !free.empty() ) {
+               buff = std::move( free.back() );
+               free.pop_back();
+            }
+         }
+         if( buff ) {
+            ++_hits;
+         } else {
+            ++_misses;
+            buff.reset( new vector<char>() );
+            buff->reserve( min_class_size << c );
+         }
+         buff->resize( size );
+         std::weak_ptr<send_buffer_pool> pool = shared_from_this();
+         return std::shared_ptr<vector<char>>( buff.release(), [pool{std::move(pool)}, c]( vector<char>* b ) {
+            auto p = pool.lock();
+            if( p ) {
+               p->release( c, b );
+            } else {
+               delete b;
+            }
+         } );
+      }
+
+      uint64_t hits() const { return _hits; }
+      uint64_t misses() const { return _misses; }
+
+   private:
+      // class_count if too large to pool
+      static size_t size_class( size_t size ) {
+         size_t c = 0;
+         for( size_t s = min_class_size; s < size && c < class_count; s <<= 1 ) {
+            ++c;
+         }
+         return c;
+      }
+
+      void release( size_t c, vector<char>* b ) {
+         std::unique_ptr<vector<char>> buff( b );
+         buff->clear();
+         std::lock_guard<std::mutex> g( _classes[c].mtx );
+         if( _classes[c].free.size() < max_pooled ) {
+            _classes[c].free.emplace_back( std::move( buff ) );
+         }
+      }
+
+      struct size_class_pool {
+         std::mutex                                   mtx;
+         std::vector<std::unique_ptr<vector<char>>>   free;
+      };
+      std::array<size_class_pool, class_count> _classes;
+      std::atomic<uint64_t>                     _hits{0};
+      std::atomic<uint64_t>                     _misses{0};
+   };
+
+   // buffers may outlive it, they are freed instead of returned once it is gone
+   static const std::shared_ptr<send_buffer_pool> send_buffers = std::make_shared<send_buffer_pool>();
+
    void connection::enqueue( const net_message& m ) {
       verify_strand_in_this_thread( strand, __func__, __LINE__ );
       go_away_reason close_after_send = no_reason;
@@ -1198,7 +1524,7 @@ namespace eosio {
       static_assert( header_size == message_header_size, "invalid message_header_size" );
       const size_t buffer_size = header_size + payload_size;
 
-      auto send_buffer = std::make_shared<vector<char>>(buffer_size);
+      auto send_buffer = send_buffers->acquire( buffer_size );
       fc::datastream<char*> ds( send_buffer->data(), buffer_size);
       ds.write( header, header_size );
       fc::raw::pack( ds, m );
@@ -1217,7 +1543,7 @@ namespace eosio {
       static_assert( header_size == message_header_size, "invalid message_header_size" );
       const size_t buffer_size = header_size + payload_size;
 
-      auto send_buffer = std::make_shared<vector<char>>( buffer_size );
+      auto send_buffer = send_buffers->acquire( buffer_size );
       fc::datastream<char*> ds( send_buffer->data(), buffer_size );
       ds.write( header, header_size );
       fc::raw::pack( ds, unsigned_int( which ) );
@@ -1233,16 +1559,69 @@ namespace eosio {
       return create_send_buffer( signed_block_which, *sb );
    }
 
+   // wraps an already packed signed_block, e.g. as read from the block log, without unpacking and repacking it
+   static std::shared_ptr<std::vector<char>> create_send_buffer_from_packed_block( const std::vector<char>& packed_block ) {
+      // matches which of net_message for signed_block
+      const uint32_t which_size = fc::raw::pack_size( unsigned_int( signed_block_which ) );
+      const uint32_t payload_size = which_size + packed_block.size();
+
+      const char* const header = reinterpret_cast<const char* const>(&payload_size); // avoid variable size encoding of uint32_t
+      constexpr size_t header_size = sizeof( payload_size );
+      static_assert( header_size == message_header_size, "invalid message_header_size" );
+      const size_t buffer_size = header_size + payload_size;
+
+      auto send_buffer = send_buffers->acquire( buffer_size );
+      fc::datastream<char*> ds( send_buffer->data(), buffer_size );
+      ds.write( header, header_size );
+      fc::raw::pack( ds, unsigned_int( signed_block_which ) );
+      ds.write( packed_block.data(), packed_block.size() );
+
+      return send_buffer;
+   }
+
    static std::shared_ptr<std::vector<char>> create_send_buffer( const packed_transaction& trx ) {
       // this implementation is to avoid copy of packed_transaction to net_message
       // matches which of net_message for packed_transaction
       return create_send_buffer( packed_transaction_which, trx );
    }
 
-   void connection::enqueue_block( const signed_block_ptr& sb, bool to_sync_queue) {
+   void connection::enqueue_block( const block_id_type& id, const signed_block_ptr& sb, bool to_sync_queue) {
       fc_dlog( logger, "enqueue block ${num}", ("num", sb->block_num()) );
       verify_strand_in_this_thread( strand, __func__, __LINE__ );
-      enqueue_buffer( create_send_buffer( sb ), no_reason, to_sync_queue);
+      auto send_buffer = create_send_buffer( sb );
+      my_impl->dispatcher->add_block_buffer( id, sb->block_num(), false, send_buffer );
+      enqueue_buffer( send_buffer, no_reason, to_sync_queue);
+   }
+
+   void connection::enqueue_packed_block( uint32_t block_num, const std::vector<char>& packed_block, bool irreversible ) {
+      fc_dlog( logger, "enqueue packed block ${num}", ("num", block_num) );
+      verify_strand_in_this_thread( strand, __func__, __LINE__ );
+      auto send_buffer = create_send_buffer_from_packed_block( packed_block );
+      // a packed signed_block starts with its signed_block_header, enough to identify it for the cache
+      fc::datastream<const char*> ds( packed_block.data(), packed_block.size() );
+      signed_block_header header;
+      fc::raw::unpack( ds, header );
+      my_impl->dispatcher->add_block_buffer( header.id(), block_num, irreversible, send_buffer );
+      enqueue_sync_buffer( block_num, send_buffer );
+   }
+
+   // send_buffer is a framed signed_block, as created by create_send_buffer
+   static std::shared_ptr<std::vector<char>> create_compressed_send_buffer( const std::vector<char>& send_buffer ) {
+      const size_t offset = message_header_size + fc::raw::pack_size( unsigned_int( signed_block_which ) );
+      compressed_block_message msg;
+      msg.codec = static_cast<uint8_t>( my_impl->p2p_compress_blocks_codec );
+      msg.packed_block = compress_block( my_impl->p2p_compress_blocks_codec, send_buffer.data() + offset, send_buffer.size() - offset );
+      return create_send_buffer( compressed_block_which, msg );
+   }
+
+   void connection::enqueue_sync_buffer( uint32_t block_num, const std::shared_ptr<std::vector<char>>& send_buffer ) {
+      verify_strand_in_this_thread( strand, __func__, __LINE__ );
+      const uint32_t threshold = my_impl->p2p_compress_blocks_threshold;
+      if( threshold > 0 && send_buffer->size() >= threshold && protocol_version >= proto_compressed_block ) {
+         enqueue_buffer( my_impl->dispatcher->compressed_block_buffer( block_num, send_buffer ), no_reason, true );
+      } else {
+         enqueue_buffer( send_buffer, no_reason, true );
+      }
    }
 
    void connection::enqueue_buffer( const std::shared_ptr<std::vector<char>>& send_buffer,
@@ -1294,6 +1673,7 @@ namespace eosio {
    // called from connection strand
    void connection::sync_timeout( boost::system::error_code ec ) {
       if( !ec ) {
+         ++request_timeouts;
          my_impl->sync_master->sync_reassign_fetch( shared_from_this(), benign_other );
       } else if( ec == boost::asio::error::operation_aborted ) {
       } else {
@@ -1316,8 +1696,23 @@ namespace eosio {
       return "connecting client";
    }
 
+   // locks conn_mtx, do not call while holding conn_mtx
+   bool connection::reached_through( const vector<string>& endpoints ) {
+      // an endpoint is followed in an address by nothing, a connection type ":blk" or a node id " - 1a2b3c4"
+      auto matches = []( const string& address, const string& endpoint ) {
+         return address.compare( 0, endpoint.size(), endpoint ) == 0 &&
+                ( address.size() == endpoint.size() || address[endpoint.size()] == ':' || address[endpoint.size()] == ' ' );
+      };
+      std::lock_guard<std::mutex> g_conn( conn_mtx );
+      for( const auto& endpoint : endpoints ) {
+         if( matches( peer_address(), endpoint ) || matches( last_handshake_recv.p2p_address, endpoint ) ) return true;
+      }
+      return false;
+   }
+
    void connection::fetch_timeout( boost::system::error_code ec ) {
       if( !ec ) {
+         ++request_timeouts;
          my_impl->dispatcher->retry_fetch( shared_from_this() );
       } else if( ec == boost::asio::error::operation_aborted ) {
          if( !connected() ) {
@@ -1340,6 +1735,7 @@ namespace eosio {
       :sync_known_lib_num( 0 )
       ,sync_last_requested_num( 0 )
       ,sync_next_expected_num( 1 )
+      ,sync_fetch_span( req_span )
       ,sync_req_span( req_span )
       ,sync_source()
       ,sync_state(in_sync)
@@ -1367,6 +1763,7 @@ namespace eosio {
       std::unique_lock<std::mutex> g( sync_mtx );
       if( sync_state == in_sync ) {
          sync_source.reset();
+         drop_follow_source( true );
       }
       if( !c ) return;
       if( c->current() ) {
@@ -1377,6 +1774,9 @@ namespace eosio {
       } else if( c == sync_source ) {
          sync_last_requested_num = 0;
          request_next_chunk( std::move(g) );
+      } else if( c == sync_follow_source ) {
+         drop_follow_source( false );
+         sync_last_requested_num = sync_source_end_num;
       }
    }
 
@@ -1396,6 +1796,9 @@ namespace eosio {
          return;
       }
 
+      // the range is requested again from sync_next_expected_num, a following range still in flight is not needed
+      drop_follow_source( true );
+
       /* ----------
        * next chunk provider selection criteria
        * a provider is supplied and able to be used, use it.
@@ -1433,14 +1836,17 @@ namespace eosio {
                }
             }
 
-            //scan the list of peers looking for another able to provide sync blocks.
+            //scan the list of peers looking for the best scored one able to provide sync blocks, the first on a tie.
             if( cptr != my_impl->connections.end() ) {
                auto cstart_it = cptr;
+               int64_t best_score = std::numeric_limits<int64_t>::max();
                do {
-                  //select the first one which is current and break out.
                   if( !(*cptr)->is_transactions_only_connection() && (*cptr)->current() ) {
-                     sync_source = *cptr;
-                     break;
+                     const int64_t score = (*cptr)->peer_score();
+                     if( score < best_score ) {
+                        best_score = score;
+                        sync_source = *cptr;
+                     }
                   }
                   if( ++cptr == my_impl->connections.end() )
                      cptr = my_impl->connections.begin();
@@ -1467,6 +1873,8 @@ namespace eosio {
             end = sync_known_lib_num;
          if( end > 0 && end >= start ) {
             sync_last_requested_num = end;
+            sync_source_end_num = end;
+            sync_prefetch_num = start + (end - start) / 2;
             connection_ptr c = sync_source;
             g_sync.unlock();
             request_sent = true;
@@ -1483,6 +1891,102 @@ namespace eosio {
       }
    }
 
+   // call with g_sync locked
+   // the following range goes to the best scored other peer, its blocks are held until sync_source has delivered its range.
+   // without another peer a sync_source able to extend the range it is serving is asked for it instead.
+   void sync_manager::request_following_chunk( std::unique_lock<std::mutex> g_sync ) {
+      uint32_t start = sync_last_requested_num + 1;
+      uint32_t end = std::min( start + sync_req_span - 1, sync_known_lib_num );
+      if( end < start ) {
+         sync_prefetch_num = 0;
+         return;
+      }
+
+      connection_ptr c;
+      {
+         std::shared_lock<std::shared_mutex> g( my_impl->connections_mtx );
+         int64_t best_score = std::numeric_limits<int64_t>::max();
+         for( const auto& ci : my_impl->connections ) {
+            if( ci == sync_source || ci->is_transactions_only_connection() || !ci->current() ) continue;
+            {
+               std::lock_guard<std::mutex> g_conn( ci->conn_mtx );
+               if( ci->last_handshake_recv.last_irreversible_block_num < end ) continue;
+            }
+            const int64_t score = ci->peer_score();
+            if( score < best_score ) {
+               best_score = score;
+               c = ci;
+            }
+         }
+      }
+
+      sync_prefetch_num = 0;
+      if( c ) {
+         sync_follow_source = c;
+      } else if( sync_source->protocol_version >= proto_pipelined_sync ) {
+         c = sync_source;
+         sync_source_end_num = end;
+         sync_prefetch_num = start + (end - start) / 2;
+      } else {
+         return;
+      }
+      sync_last_requested_num = end;
+      g_sync.unlock();
+      c->strand.post( [c, start, end]() {
+         fc_ilog( logger, "requesting following range ${s} to ${e}, from ${n}", ("n", c->peer_name())( "s", start )( "e", end ) );
+         c->request_sync_blocks( start, end );
+      } );
+   }
+
+   // call with g_sync locked, sync_source has delivered through sync_source_end_num
+   void sync_manager::promote_follow_source() {
+      adapt_req_span( true );
+      sync_source->cancel_wait();
+      const uint32_t start = sync_source_end_num + 1;
+      sync_source = std::move( sync_follow_source );
+      sync_follow_source.reset();
+      sync_source_end_num = sync_last_requested_num;
+      sync_prefetch_num = start + (sync_source_end_num - start) / 2;
+      fc_dlog( logger, "sync source now ${p} through ${e}, releasing ${n} held blocks",
+               ("p", sync_source->peer_name())( "e", sync_source_end_num )( "n", sync_held_blocks.size() ) );
+      // posted under sync_mtx, blocks read from the new source after this are posted behind the held ones
+      for( auto& held : sync_held_blocks ) {
+         app().post( priority::medium, [c = sync_source, blk_id = held.second.first, ptr{std::move( held.second.second )}]() mutable {
+            c->process_signed_block( blk_id, std::move( ptr ) );
+         } );
+      }
+      sync_held_blocks.clear();
+   }
+
+   // call with g_sync locked, the caller decides what is left requested
+   void sync_manager::drop_follow_source( bool cancel ) {
+      if( !sync_follow_source ) return;
+      fc_dlog( logger, "dropping following range from ${p}, discarding ${n} held blocks",
+               ("p", sync_follow_source->peer_name())( "n", sync_held_blocks.size() ) );
+      if( cancel ) {
+         connection_ptr c = sync_follow_source;
+         c->strand.post( [c]() {
+            c->cancel_wait();
+            c->enqueue( ( sync_request_message ) {0,0} );
+         } );
+      }
+      sync_follow_source.reset();
+      sync_held_blocks.clear();
+   }
+
+   // call with g_sync locked
+   void sync_manager::adapt_req_span( bool grow ) {
+      const uint32_t max_span = uint32_t( std::min<uint64_t>( uint64_t( sync_fetch_span ) * def_sync_span_factor,
+                                                              std::numeric_limits<uint32_t>::max() ) );
+      const uint32_t min_span = std::max<uint32_t>( sync_fetch_span / def_sync_span_factor, 1 );
+      const uint32_t span = grow ? uint32_t( std::min<uint64_t>( uint64_t( sync_req_span ) * 2, max_span ) )
+                                 : std::max( sync_req_span / 2, min_span );
+      if( span != sync_req_span ) {
+         fc_dlog( logger, "sync_req_span ${o} becoming ${n}", ("o", sync_req_span)( "n", span ) );
+         sync_req_span = span;
+      }
+   }
+
    // static, thread safe
    void sync_manager::send_handshakes() {
       for_each_connection( []( auto& ci ) {
@@ -1537,9 +2041,15 @@ namespace eosio {
                ("cc", sync_last_requested_num)( "ne", sync_next_expected_num )( "p", c->peer_name() ) );
 
       if( c == sync_source ) {
+         adapt_req_span( false );
          c->cancel_sync(reason);
          sync_last_requested_num = 0;
          request_next_chunk( std::move(g) );
+      } else if( c == sync_follow_source ) {
+         adapt_req_span( false );
+         c->cancel_sync(reason);
+         drop_follow_source( false );
+         sync_last_requested_num = sync_source_end_num;
       }
    }
 
@@ -1726,10 +2236,13 @@ namespace eosio {
    // called from connection strand
    void sync_manager::rejected_block( const connection_ptr& c, uint32_t blk_num ) {
       std::unique_lock<std::mutex> g( sync_mtx );
+      ++c->rejected_blocks;
+      adapt_req_span( false );
       if( ++c->consecutive_rejected_blocks > def_max_consecutive_rejected_blocks ) {
          fc_wlog( logger, "block ${bn} not accepted from ${p}, closing connection", ("bn", blk_num)("p", c->peer_name()) );
          sync_last_requested_num = 0;
          sync_source.reset();
+         drop_follow_source( true );
          g.unlock();
          c->close();
       } else {
@@ -1754,6 +2267,20 @@ namespace eosio {
       }
    }
 
+   // called from connection strand
+   bool sync_manager::hold_sync_block( const connection_ptr& c, const block_id_type& blk_id, const signed_block_ptr& blk ) {
+      if( !syncing_with_peer() ) return false;
+      std::lock_guard<std::mutex> g_sync( sync_mtx );
+      const uint32_t blk_num = blk->block_num();
+      if( c != sync_follow_source || blk_num <= sync_source_end_num || blk_num > sync_last_requested_num ) {
+         return false;
+      }
+      fc_dlog( logger, "holding block ${bn} from ${p} until ${e} is received", ("bn", blk_num)( "p", c->peer_name() )( "e", sync_source_end_num ) );
+      sync_held_blocks.emplace( blk_num, std::make_pair( blk_id, blk ) );
+      c->sync_wait();
+      return true;
+   }
+
    // called from connection strand
    void sync_manager::sync_recv_block(const connection_ptr& c, const block_id_type& blk_id, uint32_t blk_num, bool blk_applied) {
       fc_dlog( logger, "got block ${bn} from ${p}", ("bn", blk_num)( "p", c->peer_name() ) );
@@ -1769,6 +2296,7 @@ namespace eosio {
       if( state == head_catchup ) {
          fc_dlog( logger, "sync_manager in head_catchup state" );
          sync_source.reset();
+         drop_follow_source( true );
          g_sync.unlock();
 
          block_id_type null_id;
@@ -1803,7 +2331,13 @@ namespace eosio {
             g_sync.unlock();
             send_handshakes();
          } else if( blk_num == sync_last_requested_num ) {
+            adapt_req_span( true );
             request_next_chunk( std::move( g_sync) );
+         } else if( blk_num == sync_source_end_num && sync_follow_source ) {
+            promote_follow_source();
+         } else if( blk_num == sync_prefetch_num && c == sync_source && !sync_follow_source ) {
+            // keep a peer busy with the next range while the rest of this chunk is in flight instead of waiting out a round trip
+            request_following_chunk( std::move( g_sync ) );
          } else {
             g_sync.unlock();
             fc_dlog( logger, "calling sync_wait on connection ${p}", ("p", c->peer_name()) );
@@ -1847,67 +2381,76 @@ namespace eosio {
    }
 
    bool dispatch_manager::add_peer_txn( const node_transaction_state& nts ) {
-      std::lock_guard<std::mutex> g( local_txns_mtx );
-      auto tptr = local_txns.get<by_id>().find( std::make_tuple( std::ref( nts.id ), nts.connection_id ) );
-      bool added = (tptr == local_txns.end());
+      auto& shard = txns_shard( nts.id );
+      std::lock_guard<std::mutex> g( shard.mtx );
+      auto tptr = shard.txns.get<by_id>().find( std::make_tuple( std::ref( nts.id ), nts.connection_id ) );
+      bool added = (tptr == shard.txns.end());
       if( added ) {
-         local_txns.insert( nts );
+         shard.txns.insert( nts );
       }
       return added;
    }
 
    // thread safe
    void dispatch_manager::update_txns_block_num( const signed_block_ptr& sb ) {
-      update_block_num ubn( sb->block_num() );
-      std::lock_guard<std::mutex> g( local_txns_mtx );
       for( const auto& recpt : sb->transactions ) {
          const transaction_id_type& id = (recpt.trx.which() == 0) ? recpt.trx.get<transaction_id_type>()
                                                                   : recpt.trx.get<packed_transaction>().id();
-         auto range = local_txns.get<by_id>().equal_range( id );
-         for( auto itr = range.first; itr != range.second; ++itr ) {
-            local_txns.modify( itr, ubn );
-         }
+         update_txns_block_num( id, sb->block_num() );
       }
    }
 
    // thread safe
    void dispatch_manager::update_txns_block_num( const transaction_id_type& id, uint32_t blk_num ) {
       update_block_num ubn( blk_num );
-      std::lock_guard<std::mutex> g( local_txns_mtx );
-      auto range = local_txns.get<by_id>().equal_range( id );
+      auto& shard = txns_shard( id );
+      std::lock_guard<std::mutex> g( shard.mtx );
+      auto range = shard.txns.get<by_id>().equal_range( id );
       for( auto itr = range.first; itr != range.second; ++itr ) {
-         local_txns.modify( itr, ubn );
+         shard.txns.modify( itr, ubn );
       }
    }
 
    bool dispatch_manager::peer_has_txn( const transaction_id_type& tid, uint32_t connection_id ) const {
-      std::lock_guard<std::mutex> g( local_txns_mtx );
-      const auto tptr = local_txns.get<by_id>().find( std::make_tuple( std::ref( tid ), connection_id ) );
-      return tptr != local_txns.end();
+      const auto& shard = txns_shard( tid );
+      std::lock_guard<std::mutex> g( shard.mtx );
+      const auto tptr = shard.txns.get<by_id>().find( std::make_tuple( std::ref( tid ), connection_id ) );
+      return tptr != shard.txns.end();
    }
 
    bool dispatch_manager::have_txn( const transaction_id_type& tid ) const {
-      std::lock_guard<std::mutex> g( local_txns_mtx );
-      const auto tptr = local_txns.get<by_id>().find( tid );
-      return tptr != local_txns.end();
+      const auto& shard = txns_shard( tid );
+      std::lock_guard<std::mutex> g( shard.mtx );
+      const auto tptr = shard.txns.get<by_id>().find( tid );
+      return tptr != shard.txns.end();
+   }
+
+   packed_transaction_ptr dispatch_manager::find_txn( const transaction_id_type& tid ) const {
+      const auto& shard = txns_shard( tid );
+      std::lock_guard<std::mutex> g( shard.mtx );
+      auto range = shard.txns.get<by_id>().equal_range( tid );
+      for( auto itr = range.first; itr != range.second; ++itr ) {
+         if( itr->trx ) return itr->trx;
+      }
+      return {};
    }
 
    void dispatch_manager::expire_txns( uint32_t lib_num ) {
       size_t start_size = 0, end_size = 0;
 
-      std::unique_lock<std::mutex> g( local_txns_mtx );
-      start_size = local_txns.size();
-      auto& old = local_txns.get<by_expiry>();
-      auto ex_lo = old.lower_bound( fc::time_point_sec( 0 ) );
-      auto ex_up = old.upper_bound( time_point::now() );
-      old.erase( ex_lo, ex_up );
-      g.unlock(); // allow other threads opportunity to use local_txns
-
-      g.lock();
-      auto& stale = local_txns.get<by_block_num>();
-      stale.erase( stale.lower_bound( 1 ), stale.upper_bound( lib_num ) );
-      end_size = local_txns.size();
-      g.unlock();
+      const auto now = time_point::now();
+      for( auto& shard : local_txns ) { // one shard at a time, other threads keep using the rest
+         std::lock_guard<std::mutex> g( shard.mtx );
+         start_size += shard.txns.size();
+         auto& old = shard.txns.get<by_expiry>();
+         auto ex_lo = old.lower_bound( fc::time_point_sec( 0 ) );
+         auto ex_up = old.upper_bound( now );
+         old.erase( ex_lo, ex_up );
+
+         auto& stale = shard.txns.get<by_block_num>();
+         stale.erase( stale.lower_bound( 1 ), stale.upper_bound( lib_num ) );
+         end_size += shard.txns.size();
+      }
 
       fc_dlog( logger, "expire_local_txns size ${s} removed ${r}", ("s", start_size)( "r", start_size - end_size ) );
    }
@@ -1919,7 +2462,80 @@ namespace eosio {
    }
 
    // thread safe
-   void dispatch_manager::bcast_block(const signed_block_ptr& b, const block_id_type& id) {
+   std::shared_ptr<std::vector<char>> dispatch_manager::find_block_buffer( const block_id_type& id ) const {
+      std::lock_guard<std::mutex> g( block_buffers_mtx );
+      const auto& index = block_buffers.get<by_block_id>();
+      auto itr = index.find( id );
+      return itr != index.end() ? itr->send_buffer : std::shared_ptr<std::vector<char>>();
+   }
+
+   // thread safe
+   std::shared_ptr<std::vector<char>> dispatch_manager::find_irreversible_block_buffer( uint32_t bnum ) const {
+      std::lock_guard<std::mutex> g( block_buffers_mtx );
+      const auto& index = block_buffers.get<by_block_num>();
+      auto itr = index.find( std::make_tuple( bnum, true ) );
+      return itr != index.end() ? itr->send_buffer : std::shared_ptr<std::vector<char>>();
+   }
+
+   // thread safe, send_buffer must not be modified once added
+   void dispatch_manager::add_block_buffer( const block_id_type& id, uint32_t bnum, bool irreversible,
+                                            const std::shared_ptr<std::vector<char>>& send_buffer ) {
+      std::lock_guard<std::mutex> g( block_buffers_mtx );
+      auto& index = block_buffers.get<by_block_id>();
+      auto itr = index.find( id );
+      if( itr != index.end() ) {
+         if( irreversible && !itr->irreversible ) {
+            index.modify( itr, []( block_send_buffer& b ) { b.irreversible = true; } );
+         }
+         return;
+      }
+      block_buffers.emplace_back( block_send_buffer{ id, bnum, irreversible, send_buffer } );
+      block_buffers_size += send_buffer->size();
+      evict_block_buffers();
+   }
+
+   // block_buffers_mtx must be held
+   void dispatch_manager::evict_block_buffers() {
+      while( block_buffers_size > def_block_buffer_cache_size && block_buffers.size() > 1 ) {
+         const auto& b = block_buffers.front();
+         block_buffers_size -= b.send_buffer->size() + (b.compressed_send_buffer ? b.compressed_send_buffer->size() : 0);
+         block_buffers.pop_front();
+      }
+   }
+
+   // thread safe
+   std::shared_ptr<std::vector<char>> dispatch_manager::compressed_block_buffer( uint32_t bnum, const std::shared_ptr<std::vector<char>>& send_buffer ) {
+      auto find = [&]() {
+         auto& index = block_buffers.get<by_block_num>();
+         auto range = index.equal_range( std::make_tuple( bnum ) );
+         for( auto itr = range.first; itr != range.second; ++itr ) {
+            if( itr->send_buffer == send_buffer ) return itr;
+         }
+         return index.end();
+      };
+      {
+         std::lock_guard<std::mutex> g( block_buffers_mtx );
+         auto itr = find();
+         if( itr != block_buffers.get<by_block_num>().end() && itr->compressed_send_buffer ) return itr->compressed_send_buffer;
+      }
+
+      // compressed outside the lock, a connection racing to compress the same block keeps whichever was stored first
+      auto compressed = create_compressed_send_buffer( *send_buffer );
+      std::lock_guard<std::mutex> g( block_buffers_mtx );
+      auto& index = block_buffers.get<by_block_num>();
+      auto itr = find();
+      if( itr == index.end() ) return compressed;
+      if( itr->compressed_send_buffer ) return itr->compressed_send_buffer;
+      index.modify( itr, [&compressed]( block_send_buffer& b ) { b.compressed_send_buffer = compressed; } );
+      block_buffers_size += compressed->size();
+      evict_block_buffers();
+      return compressed;
+   }
+
+   // thread safe
+   void dispatch_manager::bcast_block(const signed_block_ptr& b, const block_id_type& id,
+                                      const std::shared_ptr<const std::vector<char>>& packed_block,
+                                      const vector<string>& upcoming_peers) {
       fc_dlog( logger, "bcast block ${b}", ("b", b->block_num()) );
 
       if( my_impl->sync_master->syncing_with_peer() ) return;
@@ -1937,13 +2553,15 @@ namespace eosio {
       } );
 
       if( !have_connection ) return;
-      std::shared_ptr<std::vector<char>> send_buffer = create_send_buffer( b );
-
-      for_each_block_connection( [this, &id, bnum = b->block_num(), &send_buffer]( auto& cp ) {
-         if( !cp->current() ) {
-            return true;
-         }
-         cp->strand.post( [this, cp, id, bnum, send_buffer]() {
+      std::shared_ptr<std::vector<char>> send_buffer = packed_block ? create_send_buffer_from_packed_block( *packed_block )
+                                                                    : create_send_buffer( b );
+      add_block_buffer( id, b->block_num(), false, send_buffer );
+      std::shared_ptr<std::vector<char>> compact_send_buffer = create_compact_send_buffer( *b );
+
+      auto send = [this, &id, bnum = b->block_num(), &send_buffer, &compact_send_buffer]( const connection_ptr& cp, bool upcoming ) {
+         // blocks only peers are not sent transactions, so they would have to request all of them back
+         const auto& full_or_compact = ( compact_send_buffer && !cp->is_blocks_only_connection() ) ? compact_send_buffer : send_buffer;
+         cp->strand.post( [this, cp, id, bnum, send_buffer, full_or_compact, upcoming]() {
             std::unique_lock<std::mutex> g_conn( cp->conn_mtx );
             bool has_block = cp->last_handshake_recv.last_irreversible_block_num >= bnum;
             g_conn.unlock();
@@ -1952,12 +2570,35 @@ namespace eosio {
                   fc_dlog( logger, "not bcast block ${b} to ${p}", ("b", bnum)("p", cp->peer_name()) );
                   return;
                }
-               fc_dlog( logger, "bcast block ${b} to ${p}", ("b", bnum)("p", cp->peer_name()) );
-               cp->enqueue_buffer( send_buffer, no_reason );
+               fc_dlog( logger, "bcast block ${b} to ${p}${u}", ("b", bnum)("p", cp->peer_name())("u", upcoming ? ", an upcoming producer" : "") );
+               // the sync queue is written before queued transactions and notices
+               cp->enqueue_buffer( cp->protocol_version >= proto_compact_block ? full_or_compact : send_buffer, no_reason, upcoming );
             }
          });
+      };
+
+      // the peers of the next producers are posted first, the handoff to them is what a late block costs
+      std::vector<connection_ptr> others;
+      for_each_block_connection( [&upcoming_peers, &send, &others]( auto& cp ) {
+         if( !cp->current() ) {
+            return true;
+         }
+         if( !upcoming_peers.empty() && cp->reached_through( upcoming_peers ) ) {
+            send( cp, true );
+         } else {
+            others.push_back( cp );
+         }
          return true;
       } );
+      for( const auto& cp : others ) {
+         send( cp, false );
+      }
+   }
+
+   std::shared_ptr<std::vector<char>> dispatch_manager::create_compact_send_buffer( const signed_block& b ) const {
+      auto msg = make_compact_block( b, [this]( const transaction_id_type& tid ) { return have_txn( tid ); } );
+      if( msg.compacted.empty() ) return {};
+      return create_send_buffer( compact_block_which, msg );
    }
 
    // called from connection strand
@@ -1981,10 +2622,10 @@ namespace eosio {
       fc_dlog( logger, "rejected block ${id}", ("id", id) );
    }
 
-   void dispatch_manager::bcast_transaction(const packed_transaction& trx) {
-      const auto& id = trx.id();
-      time_point_sec trx_expiration = trx.expiration();
-      node_transaction_state nts = {id, trx_expiration, 0, 0};
+   void dispatch_manager::bcast_transaction(const packed_transaction_ptr& trx) {
+      const auto& id = trx->id();
+      time_point_sec trx_expiration = trx->expiration();
+      node_transaction_state nts = {id, trx_expiration, 0, 0, trx};
 
       std::shared_ptr<std::vector<char>> send_buffer;
       for_each_connection( [this, &trx, &nts, &send_buffer]( auto& cp ) {
@@ -1996,7 +2637,7 @@ namespace eosio {
             return true;
          }
          if( !send_buffer ) {
-            send_buffer = create_send_buffer( trx );
+            send_buffer = create_send_buffer( *trx );
          }
 
          cp->strand.post( [cp, send_buffer]() {
@@ -2055,7 +2696,9 @@ namespace eosio {
          }
          last_req = *c->last_req;
       }
-      for_each_block_connection( [this, &c, &last_req, &bid]( auto& conn ) {
+      connection_ptr best;
+      int64_t best_score = std::numeric_limits<int64_t>::max();
+      for_each_block_connection( [this, &c, &bid, &best, &best_score]( auto& conn ) {
          if( conn == c )
             return true;
          {
@@ -2065,18 +2708,24 @@ namespace eosio {
             }
          }
 
-         bool sendit = peer_has_block( bid, conn->connection_id );
-         if( sendit ) {
-            conn->strand.post( [conn, last_req{std::move(last_req)}]() {
-               conn->enqueue( last_req );
-               conn->fetch_wait();
-               std::lock_guard<std::mutex> g_conn_conn( conn->conn_mtx );
-               conn->last_req = last_req;
-            } );
-            return false;
+         if( peer_has_block( bid, conn->connection_id ) ) {
+            const int64_t score = conn->peer_score();
+            if( score < best_score ) {
+               best_score = score;
+               best = conn;
+            }
          }
          return true;
       } );
+      if( best ) {
+         best->strand.post( [conn = best, last_req{std::move(last_req)}]() {
+            conn->enqueue( last_req );
+            conn->fetch_wait();
+            std::lock_guard<std::mutex> g_conn_conn( conn->conn_mtx );
+            conn->last_req = last_req;
+         } );
+         return;
+      }
 
       // at this point no other peer has it, re-request or do nothing?
       fc_wlog( logger, "no peer has last_req" );
@@ -2126,7 +2775,7 @@ namespace eosio {
          tcp::resolver::query query( tcp::v4(), host, port );
          // Note: need to add support for IPv6 too
 
-         auto resolver = std::make_shared<tcp::resolver>( my_impl->thread_pool->get_executor() );
+         auto resolver = std::make_shared<tcp::resolver>( c->io_context );
          connection_wptr weak_conn = c;
          resolver->async_resolve( query, boost::asio::bind_executor( c->strand,
             [resolver, weak_conn]( const boost::system::error_code& err, tcp::resolver::results_type endpoints ) {
@@ -2273,6 +2922,19 @@ namespace eosio {
             return;
          }
 
+         const uint32_t trx_limit = my_impl->max_trx_in_progress_size;
+         if( trx_in_progress_size > trx_limit ) {
+            // leave the rest in the socket so TCP flow control slows the peer down, the transaction that brings
+            // trx_in_progress_size back under the limit resumes reading
+            fc_dlog( logger, "pausing reads from ${p}, ${s} bytes of transactions in progress",
+                     ("p", peer_name())("s", trx_in_progress_size.load()) );
+            read_paused = true;
+            // resume here if it dropped meanwhile and no transaction did
+            if( trx_in_progress_size > trx_limit || !read_paused.exchange( false ) ) {
+               return;
+            }
+         }
+
          boost::asio::async_read( *socket,
             pending_message_buffer.get_buffer_sequence_for_boost_async_read(), completion_handler,
             boost::asio::bind_executor( strand,
@@ -2289,6 +2951,7 @@ namespace eosio {
                      }
                      EOS_ASSERT(bytes_transferred <= conn->pending_message_buffer.bytes_to_write(), plugin_exception, "");
                      conn->pending_message_buffer.advance_write_ptr(bytes_transferred);
+                     conn->bytes_received += bytes_transferred;
                      while (conn->pending_message_buffer.bytes_to_read() > 0) {
                         uint32_t bytes_in_buffer = conn->pending_message_buffer.bytes_to_read();
 
@@ -2310,7 +2973,10 @@ namespace eosio {
                            if (bytes_in_buffer >= total_message_bytes) {
                               conn->pending_message_buffer.advance_read_ptr(message_header_size);
                               conn->consecutive_immediate_connection_close = 0;
-                              if (!conn->process_next_message(message_length)) {
+                              const auto start = fc::time_point::now();
+                              const bool keep_reading = conn->process_next_message(message_length);
+                              conn->message_processing_us += (fc::time_point::now() - start).count();
+                              if (!keep_reading) {
                                  return;
                               }
                            } else {
@@ -2366,71 +3032,28 @@ namespace eosio {
          auto peek_ds = pending_message_buffer.create_peek_datastream();
          unsigned_int which{};
          fc::raw::unpack( peek_ds, which );
+         if( which < messages_received.size() ) {
+            ++messages_received[which];
+         }
          if( which == signed_block_which ) {
             block_header bh;
             fc::raw::unpack( peek_ds, bh );
 
             const block_id_type blk_id = bh.id();
-            const uint32_t blk_num = bh.block_num();
-            if( my_impl->dispatcher->have_block( blk_id ) ) {
-               fc_dlog( logger, "canceling wait on ${p}, already received block ${num}, id ${id}...",
-                        ("p", peer_name())("num", blk_num)("id", blk_id.str().substr(8,16)) );
-               my_impl->sync_master->sync_recv_block( shared_from_this(), blk_id, blk_num, false );
-               cancel_wait();
-
+            if( !check_received_block( blk_id, bh ) ) {
                pending_message_buffer.advance_read_ptr( message_length );
                return true;
             }
-            fc_dlog( logger, "${p} received block ${num}, id ${id}..., latency: ${latency}",
-                     ("p", peer_name())("num", bh.block_num())("id", blk_id.str().substr(8,16))
-                     ("latency", (fc::time_point::now() - bh.timestamp).count()/1000) );
-            if( !my_impl->sync_master->syncing_with_peer() ) { // guard against peer thinking it needs to send us old blocks
-               uint32_t lib = 0;
-               std::tie( lib, std::ignore, std::ignore, std::ignore, std::ignore, std::ignore ) = my_impl->get_chain_info();
-               if( blk_num < lib ) {
-                  std::unique_lock<std::mutex> g( conn_mtx );
-                  const auto last_sent_lib = last_handshake_sent.last_irreversible_block_num;
-                  g.unlock();
-                  if( blk_num < last_sent_lib ) {
-                     fc_ilog( logger, "received block ${n} less than sent lib ${lib}", ("n", blk_num)("lib", last_sent_lib) );
-                     close();
-                  } else {
-                     fc_ilog( logger, "received block ${n} less than lib ${lib}", ("n", blk_num)("lib", lib) );
-                     enqueue( (sync_request_message) {0, 0} );
-                     send_handshake();
-                     cancel_wait();
-                  }
-
-                  pending_message_buffer.advance_read_ptr( message_length );
-                  return true;
-               }
-            }
 
             auto ds = pending_message_buffer.create_datastream();
             fc::raw::unpack( ds, which ); // throw away
             shared_ptr<signed_block> ptr = std::make_shared<signed_block>();
             fc::raw::unpack( ds, *ptr );
 
-            auto is_webauthn_sig = []( const fc::crypto::signature& s ) {
-               return s.which() == fc::crypto::signature::storage_type::position<fc::crypto::webauthn::signature>();
-            };
-            bool has_webauthn_sig = is_webauthn_sig( ptr->producer_signature );
-
-            constexpr auto additional_sigs_eid = additional_block_signatures_extension::extension_id();
-            auto exts = ptr->validate_and_extract_extensions();
-            if( exts.count( additional_sigs_eid ) ) {
-               const auto &additional_sigs = exts.lower_bound( additional_sigs_eid )->second.get<additional_block_signatures_extension>().signatures;
-               has_webauthn_sig |= std::any_of( additional_sigs.begin(), additional_sigs.end(), is_webauthn_sig );
-            }
-
-            if( has_webauthn_sig ) {
-               fc_dlog( logger, "WebAuthn signed block received from ${p}, closing connection", ("p", peer_name()));
-               close();
+            if( !recv_complete_block( blk_id, std::move( ptr ) ) ) {
                return false;
             }
 
-            handle_message( blk_id, std::move( ptr ) );
-
          } else if( which == packed_transaction_which ) {
             if( !my_impl->p2p_accept_transactions ) {
                fc_dlog( logger, "p2p-accept-transaction=false - dropping txn" );
@@ -2444,6 +3067,15 @@ namespace eosio {
             fc::raw::unpack( ds, *ptr );
             handle_message( std::move( ptr ) );
 
+         } else if( which == compressed_block_which ) {
+            auto ds = pending_message_buffer.create_datastream();
+            fc::raw::unpack( ds, which ); // throw away
+            compressed_block_message msg;
+            fc::raw::unpack( ds, msg );
+            if( !process_compressed_block( msg ) ) {
+               return false;
+            }
+
          } else {
             auto ds = pending_message_buffer.create_datastream();
             net_message msg;
@@ -2461,6 +3093,55 @@ namespace eosio {
       return true;
    }
 
+   bool connection::check_received_block( const block_id_type& blk_id, const block_header& bh ) {
+      const uint32_t blk_num = bh.block_num();
+      if( my_impl->dispatcher->have_block( blk_id ) ) {
+         fc_dlog( logger, "canceling wait on ${p}, already received block ${num}, id ${id}...",
+                  ("p", peer_name())("num", blk_num)("id", blk_id.str().substr(8,16)) );
+         my_impl->sync_master->sync_recv_block( shared_from_this(), blk_id, blk_num, false );
+         cancel_wait();
+         return false;
+      }
+      fc_dlog( logger, "${p} received block ${num}, id ${id}..., latency: ${latency}",
+               ("p", peer_name())("num", bh.block_num())("id", blk_id.str().substr(8,16))
+               ("latency", (fc::time_point::now() - bh.timestamp).count()/1000) );
+      if( !my_impl->sync_master->syncing_with_peer() ) { // guard against peer thinking it needs to send us old blocks
+         uint32_t lib = 0;
+         std::tie( lib, std::ignore, std::ignore, std::ignore, std::ignore, std::ignore ) = my_impl->get_chain_info();
+         if( blk_num < lib ) {
+            std::unique_lock<std::mutex> g( conn_mtx );
+            const auto last_sent_lib = last_handshake_sent.last_irreversible_block_num;
+            g.unlock();
+            if( blk_num < last_sent_lib ) {
+               fc_ilog( logger, "received block ${n} less than sent lib ${lib}", ("n", blk_num)("lib", last_sent_lib) );
+               close();
+            } else {
+               fc_ilog( logger, "received block ${n} less than lib ${lib}", ("n", blk_num)("lib", lib) );
+               enqueue( (sync_request_message) {0, 0} );
+               send_handshake();
+               cancel_wait();
+            }
+            return false;
+         }
+      }
+      return true;
+   }
+
+   bool connection::process_compressed_block( const compressed_block_message& msg ) {
+      const auto codec = static_cast<block_codec>( msg.codec );
+      EOS_ASSERT( block_codec_supported( codec ), plugin_exception,
+                  "peer sent a block compressed with codec ${c} this nodeos was built without", ("c", msg.codec) );
+      // same limit as an uncompressed message
+      const bytes packed_block = decompress_block( codec, msg.packed_block, def_send_buffer_size*2 );
+
+      shared_ptr<signed_block> ptr = std::make_shared<signed_block>( fc::raw::unpack<signed_block>( packed_block ) );
+      const block_id_type blk_id = ptr->id();
+      if( !check_received_block( blk_id, *ptr ) ) {
+         return true;
+      }
+      return recv_complete_block( blk_id, std::move( ptr ) );
+   }
+
    // call only from main application thread
    void net_plugin_impl::update_chain_info() {
       controller& cc = chain_plug->chain();
@@ -2702,6 +3383,12 @@ namespace eosio {
       double offset = (double(rec - org) + double(msg.xmt - dst)) / 2;
       double NsecPerUsec{1000};
 
+      const int64_t rtt = int64_t( ( (dst - org) - (msg.xmt - rec) ) / NsecPerUsec );
+      if( rtt >= 0 ) {
+         const int64_t prev = rtt_us.load();
+         rtt_us = prev < 0 ? rtt : ( prev * 7 + rtt ) / 8;
+      }
+
       if( logger.is_enabled( fc::log_level::all ) )
          logger.log( FC_LOG_MESSAGE( all, "Clock offset is ${o}ns (${us}us)",
                                      ("o", offset)( "us", offset / NsecPerUsec ) ) );
@@ -2823,6 +3510,9 @@ namespace eosio {
       if( msg.end_block == 0 ) {
          peer_requested.reset();
          flush_queues();
+      } else if( peer_requested && msg.start_block == peer_requested->end_block + 1 && msg.end_block > peer_requested->end_block ) {
+         // pipelined request for the range following the one still being sent, the blocks already queued keep going
+         peer_requested->end_block = msg.end_block;
       } else {
          peer_requested = peer_sync_state( msg.start_block, msg.end_block, msg.start_block-1);
          enqueue_sync_block();
@@ -2840,15 +3530,10 @@ namespace eosio {
       const auto& tid = trx->id();
       peer_dlog( this, "received packed_transaction ${id}", ("id", tid) );
 
-      uint32_t trx_in_progress_sz = this->trx_in_progress_size.load();
-      if( trx_in_progress_sz > def_max_trx_in_progress_size ) {
-         fc_wlog( logger, "Dropping trx ${id}, too many trx in progress ${s} bytes",
-                  ("id", tid)("s", trx_in_progress_sz) );
-         return;
-      }
-
+      // no transaction is dropped for the limit, start_read_message stops reading more of them instead; only the
+      // messages of the read that crossed the limit are over it
       bool have_trx = my_impl->dispatcher->have_txn( tid );
-      node_transaction_state nts = {tid, trx->expiration(), 0, connection_id};
+      node_transaction_state nts = {tid, trx->expiration(), 0, connection_id, trx};
       my_impl->dispatcher->add_peer_txn( nts );
 
       if( have_trx ) {
@@ -2857,9 +3542,42 @@ namespace eosio {
       }
 
       trx_in_progress_size += calc_trx_size( trx );
-      app().post( priority::low, [trx{std::move(trx)}, weak = weak_from_this()]() {
-         my_impl->chain_plug->accept_transaction( trx,
-            [weak, trx](const static_variant<fc::exception_ptr, transaction_trace_ptr>& result) mutable {
+      my_impl->queue_incoming_transaction( std::move( trx ), weak_from_this() );
+   }
+
+   // called from connection strand
+   void net_plugin_impl::queue_incoming_transaction( packed_transaction_ptr trx, std::weak_ptr<connection> c ) {
+      bool post = false;
+      {
+         std::lock_guard<std::mutex> g( incoming_transactions_mtx );
+         post = incoming_transactions.empty();
+         incoming_transactions.push_back( incoming_transaction{ std::move( trx ), std::move( c ), fc::time_point::now() } );
+      }
+      // one application thread task accepts everything queued by the time it runs, rather than one task per
+      // transaction contending for the application queue with blocks and API calls
+      if( post )
+         app().post( priority::low, []() { my_impl->accept_incoming_transactions(); } );
+   }
+
+   // called from application thread
+   void net_plugin_impl::accept_incoming_transactions() {
+      std::vector<incoming_transaction> batch;
+      {
+         std::lock_guard<std::mutex> g( incoming_transactions_mtx );
+         const auto end = incoming_transactions.begin() + std::min( incoming_transactions.size(), max_incoming_transaction_batch );
+         batch.assign( std::make_move_iterator( incoming_transactions.begin() ), std::make_move_iterator( end ) );
+         incoming_transactions.erase( incoming_transactions.begin(), end );
+         if( !incoming_transactions.empty() )
+            app().post( priority::low, []() { my_impl->accept_incoming_transactions(); } );
+      }
+      if( batch.empty() )
+         return;
+      fc_dlog( logger, "accepting ${n} transactions, queued for up to ${w} us",
+               ("n", batch.size())("w", (fc::time_point::now() - batch.front().queued).count()) );
+
+      for( auto& t : batch ) {
+         chain_plug->accept_transaction( t.trx,
+            [weak{std::move(t.conn)}, trx = t.trx](const static_variant<fc::exception_ptr, transaction_trace_ptr>& result) mutable {
          // next (this lambda) called from application thread
          if (result.contains<fc::exception_ptr>()) {
             fc_dlog( logger, "bad packed_transaction : ${m}", ("m", result.get<fc::exception_ptr>()->what()) );
@@ -2874,14 +3592,165 @@ namespace eosio {
          connection_ptr conn = weak.lock();
          if( conn ) {
             conn->trx_in_progress_size -= calc_trx_size( trx );
+            if( conn->trx_in_progress_size <= my_impl->max_trx_in_progress_size && conn->read_paused.exchange( false ) ) {
+               conn->strand.post( [conn]() {
+                  if( conn->socket_is_open() ) {
+                     fc_dlog( logger, "resuming reads from ${p}", ("p", conn->peer_name()) );
+                     conn->start_read_message();
+                  }
+               } );
+            }
          }
         });
-      });
+      }
+   }
+
+   // called from connection strand
+   bool connection::recv_complete_block( const block_id_type& id, signed_block_ptr ptr ) {
+      auto is_webauthn_sig = []( const fc::crypto::signature& s ) {
+         return s.which() == fc::crypto::signature::storage_type::position<fc::crypto::webauthn::signature>();
+      };
+      bool has_webauthn_sig = is_webauthn_sig( ptr->producer_signature );
+
+      constexpr auto additional_sigs_eid = additional_block_signatures_extension::extension_id();
+      auto exts = ptr->validate_and_extract_extensions();
+      if( exts.count( additional_sigs_eid ) ) {
+         const auto &additional_sigs = exts.lower_bound( additional_sigs_eid )->second.get<additional_block_signatures_extension>().signatures;
+         has_webauthn_sig |= std::any_of( additional_sigs.begin(), additional_sigs.end(), is_webauthn_sig );
+      }
+
+      if( has_webauthn_sig ) {
+         fc_dlog( logger, "WebAuthn signed block received from ${p}, closing connection", ("p", peer_name()));
+         close();
+         return false;
+      }
+
+      ++blocks_received;
+      handle_message( id, std::move( ptr ) );
+      return true;
+   }
+
+   // called from connection strand
+   void connection::handle_message( const compact_block_message& msg ) {
+      const block_id_type blk_id = msg.header.id();
+      const uint32_t blk_num = msg.header.block_num();
+      if( my_impl->dispatcher->have_block( blk_id ) ) {
+         peer_dlog( this, "already received block ${num}, id ${id}...", ("num", blk_num)("id", blk_id.str().substr(8,16)) );
+         my_impl->sync_master->sync_recv_block( shared_from_this(), blk_id, blk_num, false );
+         cancel_wait();
+         return;
+      }
+      peer_dlog( this, "received compact block ${num}, id ${id}..., ${c} of ${t} transactions compacted",
+                 ("num", blk_num)("id", blk_id.str().substr(8,16))("c", msg.compacted.size())("t", msg.transactions.size()) );
+
+      auto restore = restore_compact_block( msg, []( const transaction_id_type& tid ) { return my_impl->dispatcher->find_txn( tid ); } );
+      if( !restore ) {
+         peer_elog( this, "invalid compact_block_message, compacted index out of range or not an id, closing" );
+         close();
+         return;
+      }
+
+      if( restore->missing.empty() ) {
+         recv_restored_block( blk_id, std::move( restore->block ) );
+         return;
+      }
+
+      if( pending_compacts.size() >= max_pending_compact_blocks && !pending_compacts.count( blk_id ) ) {
+         // the oldest block waits no longer for its transactions, the full block is requested instead
+         auto oldest = std::min_element( pending_compacts.begin(), pending_compacts.end(), []( const auto& a, const auto& b ) {
+            return block_header::num_from_id( a.first ) < block_header::num_from_id( b.first );
+         } );
+         const block_id_type oldest_id = oldest->first;
+         pending_compacts.erase( oldest );
+         if( !my_impl->dispatcher->have_block( oldest_id ) ) {
+            peer_dlog( this, "too many pending compact blocks, requesting full block ${num}", ("num", block_header::num_from_id( oldest_id )) );
+            request_message req;
+            req.req_blocks.mode = normal;
+            req.req_blocks.ids.push_back( oldest_id );
+            enqueue( req );
+         }
+      }
+
+      peer_dlog( this, "requesting ${n} transactions of compact block ${num}", ("n", restore->missing.size())("num", blk_num) );
+      enqueue( compact_block_request_message{ blk_id, restore->missing } );
+      pending_compacts[blk_id] = std::move( *restore );
+   }
+
+   // called from connection strand
+   void connection::handle_message( const compact_block_transactions_message& msg ) {
+      auto itr = pending_compacts.find( msg.id );
+      if( itr == pending_compacts.end() ) {
+         peer_dlog( this, "ignoring transactions of compact block ${id} no longer pending", ("id", msg.id) );
+         return;
+      }
+      auto pending = std::move( itr->second );
+      pending_compacts.erase( itr );
+
+      const size_t requested = pending.missing.size();
+      if( !fill_compact_block( pending, msg.transactions ) ) {
+         peer_elog( this, "invalid compact_block_transactions_message, ${n} transactions for ${m} requested, closing",
+                    ("n", msg.transactions.size())("m", requested) );
+         close();
+         return;
+      }
+      recv_restored_block( pending.id, std::move( pending.block ) );
+   }
+
+   // called from connection strand
+   void connection::recv_restored_block( const block_id_type& id, signed_block_ptr ptr ) {
+      if( !matches_transaction_mroot( *ptr ) ) {
+         peer_dlog( this, "compact block ${num} does not match its transaction_mroot, requesting full block",
+                    ("num", ptr->block_num()) );
+         request_message req;
+         req.req_blocks.mode = normal;
+         req.req_blocks.ids.push_back( id );
+         enqueue( req );
+         return;
+      }
+      recv_complete_block( id, std::move( ptr ) );
+   }
+
+   // called from connection strand
+   void connection::handle_message( const compact_block_request_message& msg ) {
+      peer_dlog( this, "received compact_block_request_message for ${n} transactions", ("n", msg.missing.size()) );
+      connection_wptr weak = shared_from_this();
+      app().post( priority::medium, [msg, weak{std::move(weak)}]() {
+         connection_ptr c = weak.lock();
+         if( !c ) return;
+         try {
+            controller& cc = my_impl->chain_plug->chain();
+            signed_block_ptr b = cc.fetch_block_by_id( msg.id );
+            if( !b ) {
+               fc_ilog( logger, "fetch block by id returned null, id ${id} for ${p}", ("id", msg.id)( "p", c->peer_address() ) );
+               return;
+            }
+
+            compact_block_transactions_message resp{ msg.id, {} };
+            resp.transactions.reserve( msg.missing.size() );
+            for( auto i : msg.missing ) {
+               if( i >= b->transactions.size() || !b->transactions[i].trx.contains<packed_transaction>() ) {
+                  fc_elog( logger, "invalid compact_block_request_message index ${i} for ${p}", ("i", i)( "p", c->peer_address() ) );
+                  return;
+               }
+               resp.transactions.push_back( b->transactions[i].trx.get<packed_transaction>() );
+            }
+            c->strand.post( [c, resp{std::move(resp)}]() {
+               c->enqueue( resp );
+            } );
+         } catch( const assert_exception& ex ) {
+            fc_elog( logger, "caught assert on fetch_block_by_id, ${ex}, id ${id} for ${p}",
+                     ("ex", ex.to_string())( "id", msg.id )( "p", c->peer_address() ) );
+         } catch( ... ) {
+            fc_elog( logger, "caught other exception fetching block id ${id} for ${p}",
+                     ("id", msg.id)( "p", c->peer_address() ) );
+         }
+      } );
    }
 
    // called from connection strand
    void connection::handle_message( const block_id_type& id, signed_block_ptr ptr ) {
       peer_dlog( this, "received signed_block ${id}", ("id", ptr->block_num() ) );
+      if( my_impl->sync_master->hold_sync_block( shared_from_this(), id, ptr ) ) return;
       auto priority = my_impl->sync_master->syncing_with_peer() ? priority::medium : priority::high;
       app().post(priority, [ptr{std::move(ptr)}, id, c = shared_from_this()]() mutable {
          c->process_signed_block( id, std::move( ptr ) );
@@ -3035,6 +3904,7 @@ namespace eosio {
       dispatcher->expire_blocks( lib );
       dispatcher->expire_txns( lib );
       fc_dlog( logger, "expire_txns ${n}us", ("n", time_point::now() - now) );
+      fc_dlog( logger, "send buffer pool hits ${h}, misses ${m}", ("h", send_buffers->hits())("m", send_buffers->misses()) );
 
       start_expire_timer();
    }
@@ -3087,10 +3957,9 @@ namespace eosio {
    // called from application thread
    void net_plugin_impl::on_accepted_block(const block_state_ptr& bs) {
       update_chain_info();
-      controller& cc = chain_plug->chain();
-      dispatcher->strand.post( [this, bs]() {
+      dispatcher->strand.post( [this, bs, upcoming = upcoming_producer_peers( *bs, bs->header.timestamp )]() {
          fc_dlog( logger, "signaled accepted_block, blk num = ${num}, id = ${id}", ("num", bs->block_num)("id", bs->id) );
-         dispatcher->bcast_block( bs->block, bs->id );
+         dispatcher->bcast_block( bs->block, bs->id, bs->packed_block(), upcoming );
       });
    }
 
@@ -3099,14 +3968,36 @@ namespace eosio {
       update_chain_info();
       controller& cc = chain_plug->chain();
       if( cc.is_trusted_producer(block->producer) ) {
-         dispatcher->strand.post( [this, block]() {
+         // the block is not applied yet, its schedule is taken to be the one of the head it builds on
+         dispatcher->strand.post( [this, block, upcoming = upcoming_producer_peers( *cc.head_block_state(), block->timestamp )]() {
             auto id = block->id();
             fc_dlog( logger, "signaled pre_accepted_block, blk num = ${num}, id = ${id}", ("num", block->block_num())("id", id) );
-            dispatcher->bcast_block( block, id );
+            dispatcher->bcast_block( block, id, {}, upcoming );
          });
       }
    }
 
+   // called from application thread
+   vector<string> net_plugin_impl::upcoming_producer_peers( const block_header_state& bhs, block_timestamp_type t ) const {
+      vector<string> peers;
+      const auto& producers = bhs.active_schedule.producers;
+      if( producer_peers.empty() || producers.empty() ) return peers;
+
+      // the producers of the slots after t in schedule order, up to def_upcoming_producers other than the current one
+      const auto current = bhs.get_scheduled_producer( t ).producer_name;
+      vector<chain::account_name> upcoming;
+      const uint32_t slots = producers.size() * chain::config::producer_repetitions;
+      for( uint32_t i = 1; i <= slots && upcoming.size() < def_upcoming_producers; ++i ) {
+         const auto p = bhs.get_scheduled_producer( block_timestamp_type( t.slot + i ) ).producer_name;
+         if( p != current && std::find( upcoming.begin(), upcoming.end(), p ) == upcoming.end() ) upcoming.push_back( p );
+      }
+      for( const auto& p : upcoming ) {
+         auto range = producer_peers.equal_range( p );
+         for( auto itr = range.first; itr != range.second; ++itr ) peers.push_back( itr->second );
+      }
+      return peers;
+   }
+
    // called from application thread
    void net_plugin_impl::on_irreversible_block( const block_state_ptr& block) {
       fc_dlog( logger, "on_irreversible_block, blk num = ${num}, id = ${id}", ("num", block->block_num)("id", block->id) );
@@ -3125,7 +4016,7 @@ namespace eosio {
             dispatcher->rejected_transaction(results.second->packed_trx(), head_blk_num);
          } else {
             fc_dlog( logger, "signaled ACK, trx-id = ${id}", ("id", id) );
-            dispatcher->bcast_transaction(*results.second->packed_trx());
+            dispatcher->bcast_transaction(results.second->packed_trx());
          }
       });
    }
@@ -3270,6 +4161,20 @@ namespace eosio {
            "    p2p.blk.eos.io:9876:blk\n")
          ( "p2p-max-nodes-per-host", bpo::value<int>()->default_value(def_max_nodes_per_host), "Maximum number of client nodes from any single IP address")
          ( "p2p-accept-transactions", bpo::value<bool>()->default_value(true), "Allow transactions received over p2p network to be evaluated and relayed if valid.")
+         ( "p2p-max-trx-in-progress-mb", bpo::value<uint32_t>()->default_value(def_max_trx_in_progress_size / (1024*1024)),
+           "Reading from a peer pauses while more than this many megabytes of the transactions it sent wait to be processed.")
+         ( "p2p-compress-blocks-threshold", bpo::value<uint32_t>()->default_value(0),
+           "Blocks sent to syncing peers that support it are compressed when their serialized size is at least this many bytes, use 0 to never compress.")
+         ( "p2p-compress-blocks-codec", bpo::value<string>()->default_value("zlib"),
+           "Codec of the blocks compressed for syncing peers: zlib, or zstd or lz4 when nodeos was built with them. Peers without the codec close the connection.")
+         ( "p2p-write-coalesce-us", bpo::value<uint32_t>()->default_value(0),
+           "Microseconds a connection waits for more messages before writing queued transactions and other non-sync messages, use 0 to write immediately.")
+         ( "p2p-write-coalesce-bytes", bpo::value<uint32_t>()->default_value(64*1024),
+           "Queued bytes at which a connection writes without waiting out p2p-write-coalesce-us.")
+         ( "p2p-producer-peer", bpo::value< vector<string> >()->composing(),
+           "A producer and the host:port of a peer that is it or relays to it, as producer=host:port. May be used multiple times.\n"
+           "  A new block is sent to the peers of the next scheduled producers before the other peers, ahead of their queued messages.\n"
+           "  The peer is matched against p2p-peer-address entries and against the p2p-server-address the peer identifies itself by.")
          ( "agent-name", bpo::value<string>()->default_value("\"EOS Test Agent\""), "The name supplied to identify this node amongst the peers.")
          ( "allowed-connection", bpo::value<vector<string>>()->multitoken()->default_value({"any"}, "any"), "Can be 'any' or 'producers' or 'specified' or 'none'. If 'specified', peer-key must be specified at least once. If only 'producers', peer-key is not required. 'producers' and 'specified' may be combined.")
          ( "peer-key", bpo::value<vector<string>>()->composing()->multitoken(), "Optional public key of peer allowed to connect.  May be used multiple times.")
@@ -3280,7 +4185,11 @@ namespace eosio {
          ( "max-cleanup-time-msec", bpo::value<int>()->default_value(10), "max connection cleanup time per cleanup call in millisec")
          ( "net-threads", bpo::value<uint16_t>()->default_value(my->thread_pool_size),
            "Number of worker threads in net_plugin thread pool" )
-         ( "sync-fetch-span", bpo::value<uint32_t>()->default_value(def_sync_fetch_span), "number of blocks to retrieve in a chunk from any individual peer during synchronization")
+         ( "net-transaction-threads", bpo::value<uint16_t>()->default_value(my->trx_thread_pool_size),
+           "Number of worker threads serving the transactions only peers of p2p-peer-address (host:port:trx), so a flood of "
+           "transactions does not hold up the net-threads relaying blocks; 0 serves them on net-threads. Incoming peers are "
+           "served on net-threads whatever their type." )
+         ( "sync-fetch-span", bpo::value<uint32_t>()->default_value(def_sync_fetch_span), "number of blocks to retrieve in a chunk from any individual peer during synchronization, adapts between a quarter and four times this value")
          ( "use-socket-read-watermark", bpo::value<bool>()->default_value(false), "Enable experimental socket read watermark optimization")
          ( "peer-log-format", bpo::value<string>()->default_value( "[\"${_name}\" ${_ip}:${_port}]" ),
            "The string used to format peers when logging messages about them.  Variables are escaped with ${<variable name>}.\n"
@@ -3314,6 +4223,14 @@ namespace eosio {
          my->max_client_count = options.at( "max-clients" ).as<int>();
          my->max_nodes_per_host = options.at( "p2p-max-nodes-per-host" ).as<int>();
          my->p2p_accept_transactions = options.at( "p2p-accept-transactions" ).as<bool>();
+         const uint32_t max_trx_in_progress_mb = options.at( "p2p-max-trx-in-progress-mb" ).as<uint32_t>();
+         EOS_ASSERT( max_trx_in_progress_mb > 0 && max_trx_in_progress_mb < 4096, chain::plugin_config_exception,
+                     "p2p-max-trx-in-progress-mb ${m} must be between 1 and 4095", ("m", max_trx_in_progress_mb) );
+         my->max_trx_in_progress_size = max_trx_in_progress_mb * 1024*1024;
+         my->p2p_compress_blocks_threshold = options.at( "p2p-compress-blocks-threshold" ).as<uint32_t>();
+         my->p2p_compress_blocks_codec = parse_block_codec( options.at( "p2p-compress-blocks-codec" ).as<string>() );
+         my->p2p_write_coalesce_period = std::chrono::microseconds( options.at( "p2p-write-coalesce-us" ).as<uint32_t>() );
+         my->p2p_write_coalesce_bytes = options.at( "p2p-write-coalesce-bytes" ).as<uint32_t>();
 
          my->use_socket_read_watermark = options.at( "use-socket-read-watermark" ).as<bool>();
 
@@ -3331,10 +4248,19 @@ namespace eosio {
          my->thread_pool_size = options.at( "net-threads" ).as<uint16_t>();
          EOS_ASSERT( my->thread_pool_size > 0, chain::plugin_config_exception,
                      "net-threads ${num} must be greater than 0", ("num", my->thread_pool_size) );
+         my->trx_thread_pool_size = options.at( "net-transaction-threads" ).as<uint16_t>();
 
          if( options.count( "p2p-peer-address" )) {
             my->supplied_peers = options.at( "p2p-peer-address" ).as<vector<string> >();
          }
+         if( options.count( "p2p-producer-peer" )) {
+            for( const auto& entry : options.at( "p2p-producer-peer" ).as<vector<string>>() ) {
+               const auto eq = entry.find( '=' );
+               EOS_ASSERT( eq != string::npos && eq > 0 && eq + 1 < entry.size(), chain::plugin_config_exception,
+                           "p2p-producer-peer ${e} is not producer=host:port", ("e", entry) );
+               my->producer_peers.emplace( chain::account_name( entry.substr( 0, eq ) ), entry.substr( eq + 1 ) );
+            }
+         }
          if( options.count( "agent-name" )) {
             my->user_agent_name = options.at( "agent-name" ).as<string>();
             EOS_ASSERT( my->user_agent_name.length() <= max_handshake_str_length, chain::plugin_config_exception,
@@ -3405,6 +4331,9 @@ namespace eosio {
       my->producer_plug = app().find_plugin<producer_plugin>();
 
       my->thread_pool.emplace( "net", my->thread_pool_size );
+      if( my->trx_thread_pool_size > 0 ) {
+         my->trx_thread_pool.emplace( "nettrx", my->trx_thread_pool_size );
+      }
 
       my->dispatcher.reset( new dispatch_manager( my_impl->thread_pool->get_executor() ) );
 
@@ -3531,6 +4460,9 @@ namespace eosio {
          if( my->thread_pool ) {
             my->thread_pool->stop();
          }
+         if( my->trx_thread_pool ) {
+            my->trx_thread_pool->stop();
+         }
 
          if( my->acceptor ) {
             boost::system::error_code ec;
@@ -3582,6 +4514,27 @@ namespace eosio {
       return optional<connection_status>();
    }
 
+   net_metrics net_plugin::metrics()const {
+      net_metrics result;
+      {
+         std::shared_lock<std::shared_mutex> g( my->connections_mtx );
+         result.connections.reserve( my->connections.size() );
+         for( const auto& c : my->connections ) {
+            result.connections.push_back( c->get_metrics() );
+         }
+      }
+      for( const auto& m : result.connections ) {
+         result.bytes_received += m.bytes_received;
+         result.bytes_written += m.bytes_written;
+         result.writes += m.writes;
+         result.blocks_received += m.blocks_received;
+         result.message_processing_us += m.message_processing_us;
+      }
+      result.send_buffer_pool_hits = send_buffers->hits();
+      result.send_buffer_pool_misses = send_buffers->misses();
+      return result;
+   }
+
    vector<connection_status> net_plugin::connections()const {
       vector<connection_status> result;
       std::shared_lock<std::shared_mutex> g( my->connections_mtx );
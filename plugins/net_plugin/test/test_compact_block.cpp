@@ -0,0 +1,128 @@
+#define BOOST_TEST_MODULE compact_block
+#include <boost/test/included/unit_test.hpp>
+
+#include <eosio/net_plugin/compact_block.hpp>
+#include <eosio/chain/merkle.hpp>
+
+#include <map>
+
+using namespace eosio;
+using namespace eosio::chain;
+
+namespace {
+   const chain_id_type chain_id = fc::sha256::hash( std::string( "compact_block" ) );
+
+   private_key_type key( const std::string& seed ) {
+      return private_key_type::regenerate<fc::ecc::private_key_shim>( fc::sha256::hash( seed ) );
+   }
+
+   signed_transaction make_transaction( uint32_t n ) {
+      signed_transaction trx;
+      trx.expiration = fc::time_point_sec( 1'600'000'000 + n );
+      trx.ref_block_num = n;
+      trx.actions.emplace_back( vector<permission_level>{ { N(alice), config::active_name } }, N(eosio.token), N(transfer), bytes( 8, char(n) ) );
+      return trx;
+   }
+
+   packed_transaction sign( signed_transaction trx, const std::string& seed ) {
+      trx.sign( key( seed ), chain_id );
+      return packed_transaction( std::move( trx ) );
+   }
+
+   struct block_fixture {
+      block_fixture() {
+         block.producer = N(producer);
+         for( uint32_t i = 0; i < 4; ++i ) {
+            trxs.push_back( std::make_shared<packed_transaction>( sign( make_transaction( i ), "a" ) ) );
+            block.transactions.emplace_back( *trxs.back() );
+         }
+         vector<digest_type> digests;
+         for( const auto& r : block.transactions ) digests.emplace_back( r.digest() );
+         block.transaction_mroot = merkle( std::move( digests ) );
+      }
+
+      /// a local transaction store holding the transactions of the block at @ref indexes
+      std::function<packed_transaction_ptr(const transaction_id_type&)> store( const vector<size_t>& indexes ) const {
+         auto known = std::make_shared<std::map<transaction_id_type, packed_transaction_ptr>>();
+         for( auto i : indexes ) known->emplace( trxs[i]->id(), trxs[i] );
+         return [known]( const transaction_id_type& id ) -> packed_transaction_ptr {
+            auto itr = known->find( id );
+            return itr == known->end() ? packed_transaction_ptr() : itr->second;
+         };
+      }
+
+      compact_block_message compact_all() const {
+         return make_compact_block( block, []( const transaction_id_type& ) { return true; } );
+      }
+
+      signed_block                   block;
+      vector<packed_transaction_ptr> trxs;
+   };
+}
+
+BOOST_AUTO_TEST_SUITE(compact_block_tests)
+
+   BOOST_FIXTURE_TEST_CASE(compacts_only_known_transactions, block_fixture)
+   {
+      auto msg = make_compact_block( block, [this]( const transaction_id_type& id ) { return id == trxs[1]->id(); } );
+      BOOST_REQUIRE_EQUAL( msg.compacted.size(), 1u );
+      BOOST_TEST( msg.compacted[0] == 1u );
+      BOOST_TEST( msg.transactions[1].trx.contains<transaction_id_type>() );
+      BOOST_TEST( msg.transactions[0].trx.contains<packed_transaction>() );
+      BOOST_TEST( msg.header.id() == block.id() );
+
+      auto none = make_compact_block( block, []( const transaction_id_type& ) { return false; } );
+      BOOST_TEST( none.compacted.empty() );
+   }
+
+   BOOST_FIXTURE_TEST_CASE(reconstructs_from_known_transactions, block_fixture)
+   {
+      auto restore = restore_compact_block( compact_all(), store( { 0, 1, 2, 3 } ) );
+      BOOST_REQUIRE( restore );
+      BOOST_TEST( restore->missing.empty() );
+      BOOST_TEST( restore->id == block.id() );
+      BOOST_TEST( matches_transaction_mroot( *restore->block ) );
+      BOOST_TEST( fc::raw::pack( *restore->block ) == fc::raw::pack( block ) );
+   }
+
+   BOOST_FIXTURE_TEST_CASE(requests_missing_transactions, block_fixture)
+   {
+      auto restore = restore_compact_block( compact_all(), store( { 0, 2 } ) );
+      BOOST_REQUIRE( restore );
+      BOOST_TEST( restore->missing == (vector<uint32_t>{ 1, 3 }) );
+      BOOST_TEST( !matches_transaction_mroot( *restore->block ) );
+
+      // one transaction per missing receipt, in their order
+      BOOST_TEST( !fill_compact_block( *restore, { *trxs[1] } ) );
+      BOOST_REQUIRE( fill_compact_block( *restore, { *trxs[1], *trxs[3] } ) );
+      BOOST_TEST( restore->missing.empty() );
+      BOOST_TEST( matches_transaction_mroot( *restore->block ) );
+      BOOST_TEST( fc::raw::pack( *restore->block ) == fc::raw::pack( block ) );
+   }
+
+   BOOST_FIXTURE_TEST_CASE(same_id_other_signature_fails_mroot, block_fixture)
+   {
+      // the local copy of transaction 2 was signed by another key, so it shares the id but not the receipt digest
+      auto other = std::make_shared<packed_transaction>( sign( make_transaction( 2 ), "b" ) );
+      BOOST_REQUIRE( other->id() == trxs[2]->id() );
+      auto restore = restore_compact_block( compact_all(), [&]( const transaction_id_type& id ) -> packed_transaction_ptr {
+         return id == other->id() ? other : store( { 0, 1, 3 } )( id );
+      } );
+      BOOST_REQUIRE( restore );
+      BOOST_TEST( restore->missing.empty() );
+      BOOST_TEST( !matches_transaction_mroot( *restore->block ) );
+   }
+
+   BOOST_FIXTURE_TEST_CASE(rejects_invalid_compacted_indexes, block_fixture)
+   {
+      auto out_of_range = compact_all();
+      out_of_range.compacted.push_back( out_of_range.transactions.size() );
+      BOOST_TEST( !restore_compact_block( out_of_range, store( {} ) ) );
+
+      // an index to a receipt that carries the full transaction
+      auto not_an_id = make_compact_block( block, [this]( const transaction_id_type& id ) { return id == trxs[0]->id(); } );
+      not_an_id.compacted.push_back( 1 );
+      BOOST_TEST( !restore_compact_block( not_an_id, store( {} ) ) );
+   }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -113,8 +113,14 @@ void producer_api_plugin::plugin_startup() {
             INVOKE_V_R(producer, set_whitelist_blacklist, producer_plugin::whitelist_blacklist), 201),
        CALL(producer, producer, get_integrity_hash,
             INVOKE_R_V(producer, get_integrity_hash), 201),
+       CALL(producer, producer, get_integrity_merkle_root,
+            INVOKE_R_V(producer, get_integrity_merkle_root), 201),
        CALL_ASYNC(producer, producer, create_snapshot, producer_plugin::snapshot_information,
             INVOKE_R_V_ASYNC(producer, create_snapshot), 201),
+       CALL(producer, producer, get_snapshot_status,
+            INVOKE_R_V(producer, get_snapshot_status), 201),
+       CALL(producer, producer, get_block_timings,
+            INVOKE_R_V(producer, get_block_timings), 201),
        CALL(producer, producer, get_scheduled_protocol_feature_activations,
             INVOKE_R_V(producer, get_scheduled_protocol_feature_activations), 201),
        CALL(producer, producer, schedule_protocol_feature_activations,
@@ -22,6 +22,8 @@ public:
       fc::optional<int32_t>   subjective_cpu_leeway_us;
       fc::optional<double>    incoming_defer_ratio;
       fc::optional<uint32_t>  greylist_limit;
+      fc::optional<bool>      adaptive_cpu_effort;
+      fc::optional<int64_t>   finalize_block_us; ///< reported only, ignored by update_runtime_options
    };
 
    struct whitelist_blacklist {
@@ -45,6 +47,42 @@ public:
    struct snapshot_information {
       chain::block_id_type head_block_id;
       std::string          snapshot_name;
+      std::string          delta_name; ///< the delta from snapshot-delta-base, empty without one
+   };
+
+   /// time spent, in microseconds, in each stage of producing one of our blocks
+   struct block_timing {
+      uint32_t             block_num = 0;
+      chain::block_id_type block_id;
+      fc::time_point       block_time;
+      chain::account_name  producer;
+      int64_t              start_block_us = 0;
+      int64_t              unapplied_trxs_us = 0;
+      int64_t              scheduled_trxs_us = 0; ///< includes incoming transactions interleaved with scheduled ones
+      int64_t              incoming_trxs_us = 0;
+      int64_t              finalize_us = 0;
+      int64_t              sign_us = 0;
+      int64_t              commit_us = 0;     ///< includes accepted_block subscribers, which queue the block for broadcast
+      uint32_t             trx_count = 0;
+      int64_t              trx_cpu_us = 0;    ///< billed cpu of the transactions in the block
+      int64_t              trx_wall_us = 0;   ///< wall clock time of executing them
+   };
+
+   struct get_block_timings_result {
+      std::vector<block_timing> blocks;
+   };
+
+   struct snapshot_status {
+      chain::block_id_type head_block_id;
+      uint32_t             head_block_num = 0;
+      std::string          snapshot_name;
+      std::string          status; ///< "writing" to disk, or "pending" until the block is irreversible
+      uint64_t             bytes_written = 0;
+      uint64_t             bytes_total = 0;
+   };
+
+   struct snapshot_status_result {
+      std::vector<snapshot_status> snapshots;
    };
 
    struct scheduled_protocol_feature_activations {
@@ -101,7 +139,11 @@ public:
    void set_whitelist_blacklist(const whitelist_blacklist& params);
 
    integrity_hash_information get_integrity_hash() const;
+   /// same as get_integrity_hash but reports controller::calculate_integrity_merkle_root as the integrity_hash
+   integrity_hash_information get_integrity_merkle_root() const;
    void create_snapshot(next_function<snapshot_information> next);
+   snapshot_status_result get_snapshot_status() const;
+   get_block_timings_result get_block_timings() const;
 
    scheduled_protocol_feature_activations get_scheduled_protocol_feature_activations() const;
    void schedule_protocol_feature_activations(const scheduled_protocol_feature_activations& schedule);
@@ -116,11 +158,16 @@ private:
 
 } //eosio
 
-FC_REFLECT(eosio::producer_plugin::runtime_options, (max_transaction_time)(max_irreversible_block_age)(produce_time_offset_us)(last_block_time_offset_us)(max_scheduled_transaction_time_per_block_ms)(subjective_cpu_leeway_us)(incoming_defer_ratio)(greylist_limit));
+FC_REFLECT(eosio::producer_plugin::runtime_options, (max_transaction_time)(max_irreversible_block_age)(produce_time_offset_us)(last_block_time_offset_us)(max_scheduled_transaction_time_per_block_ms)(subjective_cpu_leeway_us)(incoming_defer_ratio)(greylist_limit)(adaptive_cpu_effort)(finalize_block_us));
 FC_REFLECT(eosio::producer_plugin::greylist_params, (accounts));
 FC_REFLECT(eosio::producer_plugin::whitelist_blacklist, (actor_whitelist)(actor_blacklist)(contract_whitelist)(contract_blacklist)(action_blacklist)(key_blacklist) )
 FC_REFLECT(eosio::producer_plugin::integrity_hash_information, (head_block_id)(integrity_hash))
-FC_REFLECT(eosio::producer_plugin::snapshot_information, (head_block_id)(snapshot_name))
+FC_REFLECT(eosio::producer_plugin::snapshot_information, (head_block_id)(snapshot_name)(delta_name))
+FC_REFLECT(eosio::producer_plugin::block_timing, (block_num)(block_id)(block_time)(producer)(start_block_us)(unapplied_trxs_us)
+           (scheduled_trxs_us)(incoming_trxs_us)(finalize_us)(sign_us)(commit_us)(trx_count)(trx_cpu_us)(trx_wall_us))
+FC_REFLECT(eosio::producer_plugin::get_block_timings_result, (blocks))
+FC_REFLECT(eosio::producer_plugin::snapshot_status, (head_block_id)(head_block_num)(snapshot_name)(status)(bytes_written)(bytes_total))
+FC_REFLECT(eosio::producer_plugin::snapshot_status_result, (snapshots))
 FC_REFLECT(eosio::producer_plugin::scheduled_protocol_feature_activations, (protocol_features_to_activate))
 FC_REFLECT(eosio::producer_plugin::get_supported_protocol_features_params, (exclude_disabled)(exclude_unactivatable))
 FC_REFLECT(eosio::producer_plugin::get_account_ram_corrections_params, (lower_bound)(upper_bound)(limit)(reverse))
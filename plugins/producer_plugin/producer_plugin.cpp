@@ -2,7 +2,9 @@
 #include <eosio/chain/plugin_interface.hpp>
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/generated_transaction_object.hpp>
+#include <eosio/chain/state_prefetcher.hpp>
 #include <eosio/chain/snapshot.hpp>
+#include <eosio/chain/snapshot_delta.hpp>
 #include <eosio/chain/transaction_object.hpp>
 #include <eosio/chain/thread_utils.hpp>
 #include <eosio/chain/unapplied_transaction_queue.hpp>
@@ -17,6 +19,9 @@
 
 #include <iostream>
 #include <algorithm>
+#include <deque>
+#include <mutex>
+#include <set>
 #include <boost/algorithm/string.hpp>
 #include <boost/range/adaptor/map.hpp>
 #include <boost/function_output_iterator.hpp>
@@ -102,23 +107,233 @@ using transaction_id_with_expiry_index = multi_index_container<
    >
 >;
 
+/**
+ * Subjective failures of previously applied transactions, so that a transaction which keeps failing to fit is retried
+ * with an exponential backoff, in blocks, instead of on every block, and an account whose backlog keeps failing stops
+ * being retried for the rest of the block once it used up its failure budget.
+ */
+class subjective_failure_cache {
+public:
+   void set_max_backoff_blocks( uint32_t b ) { _max_backoff_blocks = b; }
+   void set_account_failure_budget( uint32_t b ) { _account_failure_budget = b; }
+
+   /// @return true if @ref trx should not be retried in block @ref block_num
+   bool should_skip( const transaction_id_type& id, const account_name& auth, uint32_t block_num ) {
+      reset_accounts( block_num );
+      if( _account_failure_budget > 0 ) {
+         auto aitr = _account_failures.find( auth );
+         if( aitr != _account_failures.end() && aitr->second >= _account_failure_budget ) return true;
+      }
+      auto itr = _failures.find( id );
+      return itr != _failures.end() && block_num < itr->retry_block_num;
+   }
+
+   void failed( const transaction_id_type& id, const account_name& auth, const fc::time_point& expiry, uint32_t block_num ) {
+      reset_accounts( block_num );
+      ++_account_failures[auth];
+      if( _max_backoff_blocks == 0 ) return;
+      auto itr = _failures.find( id );
+      if( itr == _failures.end() ) {
+         _failures.insert( failure{ id, expiry, 1, block_num + 1 } );
+      } else {
+         _failures.modify( itr, [&]( auto& f ) {
+            ++f.failures;
+            f.retry_block_num = block_num + std::min<uint32_t>( _max_backoff_blocks, 1u << std::min<uint32_t>( f.failures - 1, 31 ) );
+         } );
+      }
+   }
+
+   void succeeded( const transaction_id_type& id ) {
+      _failures.erase( id );
+   }
+
+   size_t remove_expired( const fc::time_point& lib_time ) {
+      size_t num_expired = 0;
+      auto& by_expiry_idx = _failures.get<by_expiry>();
+      while( !by_expiry_idx.empty() && by_expiry_idx.begin()->expiry <= lib_time ) {
+         by_expiry_idx.erase( by_expiry_idx.begin() );
+         ++num_expired;
+      }
+      return num_expired;
+   }
+
+   size_t size() const { return _failures.size(); }
+
+private:
+   void reset_accounts( uint32_t block_num ) {
+      if( block_num != _accounts_block_num ) {
+         _account_failures.clear();
+         _accounts_block_num = block_num;
+      }
+   }
+
+   struct failure {
+      transaction_id_type     trx_id;
+      fc::time_point          expiry;
+      uint32_t                failures = 0;
+      uint32_t                retry_block_num = 0;
+   };
+
+   multi_index_container<
+      failure,
+      indexed_by<
+         hashed_unique<tag<by_id>, BOOST_MULTI_INDEX_MEMBER(failure, transaction_id_type, trx_id)>,
+         ordered_non_unique<tag<by_expiry>, BOOST_MULTI_INDEX_MEMBER(failure, fc::time_point, expiry)>
+      >
+   >                                     _failures;
+   std::map<account_name, uint32_t>      _account_failures; ///< failures in block _accounts_block_num
+   uint32_t                              _accounts_block_num = 0;
+   uint32_t                              _max_backoff_blocks = 0;
+   uint32_t                              _account_failure_budget = 0;
+};
+
+/**
+ * Checks of incoming transactions that need no chain state beyond a few values published by the main thread, so that
+ * transactions bound to fail are rejected on the thread that received them, ahead of key recovery and the main thread.
+ * Every check is conservative: anything it cannot decide is left to the controller.
+ */
+class transaction_prevalidator {
+public:
+   /// main thread
+   void on_block( uint32_t head_num, const fc::time_point& head_time, uint32_t lib_num,
+                  uint32_t max_trx_lifetime_sec, uint32_t max_trx_net_usage ) {
+      _head_block_num = head_num;
+      _head_block_time_us = head_time.time_since_epoch().count();
+      _lib_num = lib_num;
+      _max_trx_lifetime_sec = max_trx_lifetime_sec;
+      _max_trx_net_usage = max_trx_net_usage;
+   }
+
+   /// main thread
+   void on_irreversible_block( uint32_t block_num, const block_id_type& id ) {
+      _irreversible_prefixes[block_num & 0xffff] = (uint64_t( block_num ) << 32) | uint32_t( id._hash[1] );
+   }
+
+   /// thread safe, @return the exception the controller would certainly fail @ref trx with, if any
+   fc::exception_ptr check( const packed_transaction& trx ) const {
+      if( _max_trx_lifetime_sec == 0 ) return nullptr; // no block seen yet
+      const transaction& t = trx.get_transaction();
+
+      // the pending block is always later than head
+      const fc::time_point head_time{ fc::microseconds( _head_block_time_us ) };
+      if( fc::time_point( t.expiration ) < head_time ) {
+         return std::make_shared<expired_tx_exception>( FC_LOG_MESSAGE( error, "expired transaction ${id}, expiration ${e}, head block time ${bt}",
+                                                                        ("id", trx.id())("e", t.expiration)("bt", head_time) ) );
+      }
+      // the pending block is never more than a couple of block intervals past now or past head block time
+      const auto latest_pending_time = std::max( fc::time_point::now(), head_time ) + fc::microseconds( 2 * config::block_interval_us );
+      if( fc::time_point( t.expiration ) > latest_pending_time + fc::seconds( _max_trx_lifetime_sec ) ) {
+         return std::make_shared<tx_exp_too_far_exception>( FC_LOG_MESSAGE( error, "transaction ${id} expiration ${e} is too far in the future",
+                                                                            ("id", trx.id())("e", t.expiration) ) );
+      }
+
+      // net usage is at least the unprunable size
+      uint64_t net_limit = _max_trx_net_usage;
+      if( t.max_net_usage_words.value > 0 ) net_limit = std::min<uint64_t>( net_limit, uint64_t( t.max_net_usage_words.value ) * 8 );
+      if( trx.get_unprunable_size() > net_limit ) {
+         return std::make_shared<tx_net_usage_exceeded>( FC_LOG_MESSAGE( error, "transaction ${id} size ${s} exceeds net usage limit ${l}",
+                                                                         ("id", trx.id())("s", trx.get_unprunable_size())("l", net_limit) ) );
+      }
+
+      // only a reference to an irreversible block which is still the latest block in its block summary slot, even
+      // after a few more blocks, is known to be checked against the block recorded here
+      const uint32_t head_num = _head_block_num + 1024;
+      const uint32_t ref_num = head_num - ((head_num - t.ref_block_num) & 0xffff);
+      const uint64_t recorded = _irreversible_prefixes[t.ref_block_num];
+      if( ref_num <= _lib_num && ref_num == (recorded >> 32) && t.ref_block_prefix != uint32_t( recorded ) ) {
+         return std::make_shared<invalid_ref_block_exception>( FC_LOG_MESSAGE( error, "transaction ${id} reference block ${n} did not match",
+                                                                               ("id", trx.id())("n", ref_num) ) );
+      }
+      return nullptr;
+   }
+
+   /// thread safe, @return false if @ref id is already between receipt and the main thread
+   bool start( const transaction_id_type& id ) {
+      std::lock_guard<std::mutex> g( _in_flight_mtx );
+      return _in_flight.insert( id ).second;
+   }
+
+   /// thread safe
+   void done( const transaction_id_type& id ) {
+      std::lock_guard<std::mutex> g( _in_flight_mtx );
+      _in_flight.erase( id );
+   }
+
+private:
+   std::atomic<uint32_t>                       _head_block_num{0};
+   std::atomic<int64_t>                        _head_block_time_us{0};
+   std::atomic<uint32_t>                       _lib_num{0};
+   std::atomic<uint32_t>                       _max_trx_lifetime_sec{0};
+   std::atomic<uint32_t>                       _max_trx_net_usage{0};
+   /// irreversible block number << 32 | ref_block_prefix, by ref_block_num
+   std::unique_ptr<std::atomic<uint64_t>[]>    _irreversible_prefixes{ new std::atomic<uint64_t>[0x10000]() };
+
+   std::mutex                                  _in_flight_mtx;
+   std::set<transaction_id_type>               _in_flight;
+};
+
 struct by_height;
 
+/// progress of a snapshot being written to disk on the snapshot thread
+struct snapshot_write_progress {
+   std::atomic<uint64_t> bytes_written{0};
+   uint64_t              bytes_total = 0;
+   std::atomic<bool>     done{false};
+};
+
+/// the delta of a snapshot file sits next to it at every stage, with the .delta extension
+static bfs::path snapshot_delta_path( bfs::path snapshot ) {
+   return snapshot.replace_extension( ".delta" );
+}
+
+/// writes the delta reproducing @ref snapshot from @ref base next to it
+static void write_snapshot_delta( const bfs::path& base, const bfs::path& snapshot ) {
+   auto base_in = std::ifstream( base.generic_string(), std::ios::in | std::ios::binary );
+   auto target_in = std::ifstream( snapshot.generic_string(), std::ios::in | std::ios::binary );
+   const auto delta = snapshot_delta_path( snapshot );
+   auto delta_out = std::ofstream( delta.generic_string(), std::ios::out | std::ios::binary );
+   const auto s = snapshot_delta::write( base_in, target_in, delta_out );
+   delta_out.flush();
+   delta_out.close();
+   EOS_ASSERT( !delta_out.fail(), snapshot_finalization_exception, "Unable to write snapshot delta ${p}", ("p", delta.generic_string()) );
+   ilog( "snapshot delta ${p}: ${c} bytes copied from the base, ${l} literal bytes",
+         ("p", delta.generic_string())("c", s.copied_bytes)("l", s.literal_bytes) );
+}
+
+/// moves the delta of snapshot @ref from, if it has one, along with the snapshot
+static void rename_snapshot_delta( const bfs::path& from, const bfs::path& to, boost::system::error_code& ec ) {
+   const auto delta = snapshot_delta_path( from );
+   if( !ec && bfs::exists( delta ) ) bfs::rename( delta, snapshot_delta_path( to ), ec );
+}
+
+/// @return the name of the delta of the final snapshot @ref p, empty without one
+static std::string snapshot_delta_name( const bfs::path& p ) {
+   const auto delta = snapshot_delta_path( p );
+   return bfs::exists( delta ) ? delta.generic_string() : std::string();
+}
+
 class pending_snapshot {
 public:
    using next_t = producer_plugin::next_function<producer_plugin::snapshot_information>;
 
-   pending_snapshot(const block_id_type& block_id, next_t& next, std::string pending_path, std::string final_path)
+   pending_snapshot(const block_id_type& block_id, next_t& next, std::string pending_path, std::string final_path,
+                    std::shared_ptr<snapshot_write_progress> progress = nullptr)
    : block_id(block_id)
    , next(next)
    , pending_path(pending_path)
    , final_path(final_path)
+   , progress(std::move(progress))
    {}
 
    uint32_t get_height() const {
       return block_header::num_from_id(block_id);
    }
 
+   /// false while the snapshot thread is still writing the pending file
+   bool is_written() const {
+      return !progress || progress->done;
+   }
+
    static bfs::path get_final_path(const block_id_type& block_id, const bfs::path& snapshots_dir) {
       return snapshots_dir / fc::format_string("snapshot-${id}.bin", fc::mutable_variant_object()("id", block_id));
    }
@@ -137,25 +352,28 @@ public:
 
       if (!in_chain) {
          bfs::remove(bfs::path(pending_path), ec);
+         bfs::remove(snapshot_delta_path(pending_path), ec);
          EOS_THROW(snapshot_finalization_exception,
                    "Snapshotted block was forked out of the chain.  ID: ${block_id}",
                    ("block_id", block_id));
       }
 
       bfs::rename(bfs::path(pending_path), bfs::path(final_path), ec);
+      rename_snapshot_delta(pending_path, final_path, ec);
       EOS_ASSERT(!ec, snapshot_finalization_exception,
                  "Unable to finalize valid snapshot of block number ${bn}: [code: ${ec}] ${message}",
                  ("bn", get_height())
                  ("ec", ec.value())
                  ("message", ec.message()));
 
-      return {block_id, final_path};
+      return {block_id, final_path, snapshot_delta_name(final_path)};
    }
 
    block_id_type     block_id;
    next_t            next;
    std::string       pending_path;
    std::string       final_path;
+   std::shared_ptr<snapshot_write_progress> progress;
 };
 
 using pending_snapshot_index = multi_index_container<
@@ -183,6 +401,8 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
       void schedule_production_loop();
       void schedule_maybe_produce_block( bool exhausted );
       void produce_block();
+      /// signs d with keys, all of whose providers are the same keosd, in one call to its sign_digests endpoint
+      vector<signature_type> sign_with_keosd( const fc::url& batch_url, const vector<public_key_type>& keys, const digest_type& d );
       bool maybe_produce_block();
       bool block_is_exhausted() const;
       bool remove_expired_persisted_trxs( const fc::time_point& deadline );
@@ -194,26 +414,47 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
       boost::program_options::variables_map _options;
       bool     _production_enabled                 = false;
       bool     _pause_production                   = false;
+      bool     _prebuild_block                     = false;
+      bool     _adaptive_cpu_effort                = false;
+
+      /// our next block, started speculatively on head before our production window and produced once it opens
+      struct prebuilt_block {
+         block_id_type         head_id;
+         fc::time_point        block_time;
+      };
+      fc::optional<prebuilt_block> _prebuilt_block;
 
       using signature_provider_type = std::function<chain::signature_type(chain::digest_type)>;
       std::map<chain::public_key_type, signature_provider_type> _signature_providers;
+      /// signs with all but one of the keys required by a block in parallel, only when more than one key is configured
+      fc::optional<named_thread_pool>                           _signing_thread_pool;
       std::set<chain::account_name>                             _producers;
       boost::asio::deadline_timer                               _timer;
       using producer_watermark = std::pair<uint32_t, block_timestamp_type>;
       std::map<chain::account_name, producer_watermark>         _producer_watermarks;
       pending_block_mode                                        _pending_block_mode = pending_block_mode::speculating;
       unapplied_transaction_queue                               _unapplied_transactions;
+      subjective_failure_cache                                  _subjective_failures;
+      transaction_prevalidator                                  _prevalidator;
       fc::optional<named_thread_pool>                           _thread_pool;
 
       std::atomic<int32_t>                                      _max_transaction_time_ms; // modified by app thread, read by net_plugin thread pool
       fc::microseconds                                          _max_irreversible_block_age_us;
       int32_t                                                   _produce_time_offset_us = 0;
       int32_t                                                   _last_block_time_offset_us = 0;
+      /// moving average of the time to finalize, sign and commit our blocks, -1 until one is produced
+      int64_t                                                   _finalize_block_us = -1;
+      /// the last block of our round, waiting for the next producer to build on it or not
+      fc::optional<std::pair<block_id_type, uint32_t>>          _handoff_block;
       uint32_t                                                  _max_block_cpu_usage_threshold_us = 0;
       uint32_t                                                  _max_block_net_usage_threshold_bytes = 0;
       int32_t                                                   _max_scheduled_transaction_time_per_block_ms = 0;
       fc::time_point                                            _irreversible_block_time;
       fc::microseconds                                          _keosd_provider_timeout_us;
+      /// sign_digests endpoint of the keosd of each KEOSD provider given its sign_digest endpoint, so that the keys a
+      /// block needs from one keosd are signed in one call
+      std::map<chain::public_key_type, fc::url>                 _keosd_batch_urls;
+      std::atomic<bool>                                         _keosd_batch_unsupported_logged{false};
 
       std::vector<chain::digest_type>                           _protocol_features_to_activate;
       bool                                                      _protocol_features_signaled = false; // to mark whether it has been signaled in start_block
@@ -234,6 +475,27 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
       fc::optional<scoped_connection>                          _accepted_block_connection;
       fc::optional<scoped_connection>                          _accepted_block_header_connection;
       fc::optional<scoped_connection>                          _irreversible_block_connection;
+      fc::optional<scoped_connection>                          _applied_transaction_connection;
+
+      /// timings of the block we are building, when recorded, and of the most recent blocks we produced
+      uint32_t                                                 _block_timings_size = 0;
+      fc::optional<producer_plugin::block_timing>              _block_timing;
+      std::deque<producer_plugin::block_timing>                _block_timings;
+
+      auto record_span( int64_t producer_plugin::block_timing::* span ) {
+         return fc::make_scoped_exit( [this, span, start = fc::time_point::now()]() {
+            if( _block_timing ) (*_block_timing).*span += (fc::time_point::now() - start).count();
+         } );
+      }
+
+      void on_applied_transaction( const transaction_trace_ptr& trace ) {
+         if( !_block_timing || !trace->receipt ) return;
+         const chain::controller& chain = chain_plug->chain();
+         if( !chain.is_building_block() || chain.pending_block_time() != _block_timing->block_time ) return;
+         ++_block_timing->trx_count;
+         _block_timing->trx_cpu_us += trace->receipt->cpu_usage_us;
+         _block_timing->trx_wall_us += trace->elapsed.count();
+      }
 
       /*
        * HACK ALERT
@@ -253,6 +515,13 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
       // path to write the snapshots to
       bfs::path _snapshots_dir;
 
+      // write snapshots with per-section zlib compression
+      bool _snapshot_compression = false;
+      bool _snapshot_background_write = false;
+      // with a base, every snapshot is also written as a delta from it
+      fc::optional<bfs::path> _snapshot_delta_base;
+      fc::optional<named_thread_pool> _snapshot_thread_pool;
+
       void consider_new_watermark( account_name producer, uint32_t block_num, block_timestamp_type timestamp) {
          auto itr = _producer_watermarks.find( producer );
          if( itr != _producer_watermarks.end() ) {
@@ -271,8 +540,21 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
          return itr->second;
       }
 
+      void update_prevalidator() {
+         const chain::controller& chain = chain_plug->chain();
+         const auto& cfg = chain.get_global_properties().configuration;
+         _prevalidator.on_block( chain.head_block_num(), chain.head_block_time(), chain.last_irreversible_block_num(),
+                                 cfg.max_transaction_lifetime, cfg.max_transaction_net_usage );
+      }
+
       void on_block( const block_state_ptr& bsp ) {
          _unapplied_transactions.clear_applied( bsp );
+         update_prevalidator();
+         if( _handoff_block && bsp->block_num > _handoff_block->second ) {
+            if( bsp->block_num == _handoff_block->second + 1 && _producers.count( bsp->header.producer ) == 0 )
+               adapt_last_block_offset( bsp->header.previous == _handoff_block->first );
+            _handoff_block.reset();
+         }
       }
 
       void on_block_header( const block_state_ptr& bsp ) {
@@ -281,13 +563,17 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
 
       void on_irreversible_block( const signed_block_ptr& lib ) {
          _irreversible_block_time = lib->timestamp.to_time_point();
-         const chain::controller& chain = chain_plug->chain();
+         _prevalidator.on_irreversible_block( lib->block_num(), lib->id() );
+         promote_pending_snapshots( lib->block_num() );
+      }
 
-         // promote any pending snapshots
+      void promote_pending_snapshots( uint32_t lib_height ) {
+         const chain::controller& chain = chain_plug->chain();
          auto& snapshots_by_height = _pending_snapshot_index.get<by_height>();
-         uint32_t lib_height = lib->block_num();
 
-         while (!snapshots_by_height.empty() && snapshots_by_height.begin()->get_height() <= lib_height) {
+         // snapshots still being written are promoted once the snapshot thread is done with them
+         while (!snapshots_by_height.empty() && snapshots_by_height.begin()->get_height() <= lib_height &&
+                snapshots_by_height.begin()->is_written()) {
             const auto& pending = snapshots_by_height.begin();
             auto next = pending->next;
 
@@ -359,7 +645,7 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
          if( existing ) { return false; }
 
          // start processing of block
-         auto bsf = chain.create_block_state_future( block );
+         auto bsf = chain.create_block_state_future( id, block );
 
          // abort the pending block
          _unapplied_transactions.add_aborted( chain.abort_block() );
@@ -410,14 +696,23 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
          return true;
       }
 
+      /**
+       * Incoming transactions ordered by the priority of their first authorizer, highest first, and in arrival order
+       * within a priority. Accounts not given a priority have priority 0.
+       */
       class incoming_transaction_queue {
          uint64_t max_incoming_transaction_queue_size = 0;
          uint64_t size_in_bytes = 0;
-         std::deque<std::tuple<transaction_metadata_ptr, bool, next_function<transaction_trace_ptr>>> _incoming_transactions;
+         using entry = std::tuple<transaction_metadata_ptr, bool, next_function<transaction_trace_ptr>>;
+         using key = std::pair<int64_t, int64_t>; // negated priority, sequence
+         std::map<key, entry>           _incoming_transactions;
+         std::map<account_name, int32_t> _account_priorities;
+         int64_t                        _next_back = 0;
+         int64_t                        _next_front = -1;
 
       private:
          static uint64_t calc_size( const transaction_metadata_ptr& trx ) {
-            return trx->packed_trx()->get_unprunable_size() + trx->packed_trx()->get_prunable_size() + sizeof( *trx );
+            return trx->get_estimated_size();
          }
 
          void add_size( const transaction_metadata_ptr& trx ) {
@@ -426,23 +721,36 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
             size_in_bytes += size;
          }
 
+         int64_t priority( const transaction_metadata_ptr& trx )const {
+            if( _account_priorities.empty() ) return 0;
+            auto itr = _account_priorities.find( trx->packed_trx()->get_transaction().first_authorizer() );
+            return itr != _account_priorities.end() ? itr->second : 0;
+         }
+
       public:
          void set_max_incoming_transaction_queue_size( uint64_t v ) { max_incoming_transaction_queue_size = v; }
+         void set_account_priority( account_name a, int32_t priority ) { _account_priorities[a] = priority; }
 
          void add( const transaction_metadata_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next ) {
             add_size( trx );
-            _incoming_transactions.emplace_back( trx, persist_until_expired, std::move( next ) );
+            _incoming_transactions.emplace( key{ -priority( trx ), _next_back++ }, entry{ trx, persist_until_expired, std::move( next ) } );
          }
 
+         /// ahead of the other transactions of the same priority
          void add_front( const transaction_metadata_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next ) {
             add_size( trx );
-            _incoming_transactions.emplace_front( trx, persist_until_expired, std::move( next ) );
+            _incoming_transactions.emplace( key{ -priority( trx ), _next_front-- }, entry{ trx, persist_until_expired, std::move( next ) } );
          }
 
          auto pop_front() {
             EOS_ASSERT( !_incoming_transactions.empty(), producer_exception, "logic error, front() called on empty incoming_transactions" );
-            auto intrx = _incoming_transactions.front();
-            _incoming_transactions.pop_front();
+            auto itr = _incoming_transactions.begin();
+            auto intrx = std::move( itr->second );
+            _incoming_transactions.erase( itr );
+            if( _incoming_transactions.empty() ) {
+               _next_back = 0;
+               _next_front = -1;
+            }
             const transaction_metadata_ptr& trx = std::get<0>( intrx );
             size_in_bytes -= calc_size( trx );
             return intrx;
@@ -459,12 +767,31 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
          const auto max_trx_time_ms = _max_transaction_time_ms.load();
          fc::microseconds max_trx_cpu_usage = max_trx_time_ms < 0 ? fc::microseconds::maximum() : fc::milliseconds( max_trx_time_ms );
 
-         auto future = transaction_metadata::start_recover_keys( trx, _thread_pool->get_executor(),
+         auto except = _prevalidator.check( *trx );
+         if( !except && !_prevalidator.start( trx->id() ) ) {
+            except = std::make_shared<tx_duplicate>( FC_LOG_MESSAGE( error, "duplicate transaction ${id}", ("id", trx->id()) ) );
+         }
+         if( except ) {
+            // responses and acks are only ever sent from the main thread
+            app().post( priority::low, [self = this, trx, except, next{std::move(next)}]() {
+               next( except );
+               self->_transaction_ack_channel.publish( priority::low, std::pair<fc::exception_ptr, transaction_metadata_ptr>(
+                     except, transaction_metadata::create_no_recover_keys( trx, transaction_metadata::trx_type::input ) ) );
+            } );
+            return;
+         }
+
+         // the pages of its contracts are read in while its keys are recovered and it waits for the main thread
+         if( auto* prefetcher = chain.get_state_prefetcher() )
+            prefetcher->prefetch( trx->get_transaction() );
+
+         auto future = transaction_metadata::start_recover_keys( trx, chain.get_key_recovery_queue(), prioritized_task_queue::priority::low,
                 chain.get_chain_id(), fc::microseconds( max_trx_cpu_usage ), chain.configured_subjective_signature_length_limit() );
-         boost::asio::post( _thread_pool->get_executor(), [self = this, future{std::move(future)}, persist_until_expired, next{std::move(next)}]() mutable {
+         boost::asio::post( _thread_pool->get_executor(), [self = this, id = trx->id(), future{std::move(future)}, persist_until_expired, next{std::move(next)}]() mutable {
             if( future.valid() ) {
                future.wait();
-               app().post( priority::low, [self, future{std::move(future)}, persist_until_expired, next{std::move( next )}]() mutable {
+               app().post( priority::low, [self, id, future{std::move(future)}, persist_until_expired, next{std::move( next )}]() mutable {
+                  self->_prevalidator.done( id );
                   try {
                      if( !self->process_incoming_transaction_async( future.get(), persist_until_expired, std::move( next ) ) ) {
                         if( self->_pending_block_mode == pending_block_mode::producing ) {
@@ -473,6 +800,8 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
                      }
                   } CATCH_AND_CALL(next);
                } );
+            } else {
+               self->_prevalidator.done( id );
             }
          });
       }
@@ -522,7 +851,7 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
                return true;
             }
 
-            if( chain.is_known_unexpired_transaction( id )) {
+            if( chain.is_known_unexpired_transaction( id, trx->packed_trx()->expiration() )) {
                send_response( std::static_pointer_cast<fc::exception>( std::make_shared<tx_duplicate>(
                      FC_LOG_MESSAGE( error, "duplicate transaction ${id}", ("id", id)))) );
                return true;
@@ -607,6 +936,7 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
 
       fc::time_point calculate_pending_block_time() const;
       fc::time_point calculate_block_deadline( const fc::time_point& ) const;
+      void adapt_last_block_offset( bool handed_off );
       void schedule_delayed_production_loop(const std::weak_ptr<producer_plugin_impl>& weak_this, optional<fc::time_point> wake_up_time);
       optional<fc::time_point> calculate_producer_wake_up_time( const block_timestamp_type& ref_block_time ) const;
 
@@ -652,6 +982,15 @@ void producer_plugin::set_program_options(
    producer_options.add_options()
          ("enable-stale-production,e", boost::program_options::bool_switch()->notifier([this](bool e){my->_production_enabled = e;}), "Enable block production, even if the chain is stale.")
          ("pause-on-startup,x", boost::program_options::bool_switch()->notifier([this](bool p){my->_pause_production = p;}), "Start this node in a state where production is paused")
+         ("prebuild-block", bpo::bool_switch()->notifier([this](bool p){my->_prebuild_block = p;}),
+          "Start our next block on head while waiting for its production window, so the block produced when the window opens already holds the transactions received meanwhile")
+         ("adaptive-cpu-effort", bpo::bool_switch()->notifier([this](bool a){my->_adaptive_cpu_effort = a;}),
+          "Adjust last-block-time-offset-us at runtime: shorten the last block of our round when the next producer does not build on it and lengthen it again while it does, "
+          "never leaving less than twice the time our blocks take to finalize, sign and commit")
+         ("subjective-failure-max-backoff-blocks", bpo::value<uint32_t>()->default_value(32),
+          "Previously applied transactions that fail to fit are retried after 1, 2, 4, ... blocks, up to this many. 0 retries them every block")
+         ("subjective-account-failure-budget", bpo::value<uint32_t>()->default_value(16),
+          "Number of previously applied transactions of an account, by first authorizer, that may fail to fit in a block before the rest of its transactions are skipped for that block. 0 for no limit")
          ("max-transaction-time", bpo::value<int32_t>()->default_value(30),
           "Limits the maximum time (in milliseconds) that is allowed a pushed transaction's code to execute before being considered invalid")
          ("max-irreversible-block-age", bpo::value<int32_t>()->default_value( -1 ),
@@ -669,7 +1008,8 @@ void producer_plugin::set_program_options(
           "   <provider-spec> \tis a string in the form <provider-type>:<data>\n\n"
           "   <provider-type> \tis KEY, or KEOSD\n\n"
           "   KEY:<data>      \tis a string form of a valid EOSIO private key which maps to the provided public key\n\n"
-          "   KEOSD:<data>    \tis the URL where keosd is available and the approptiate wallet(s) are unlocked")
+          "   KEOSD:<data>    \tis the URL where keosd is available and the approptiate wallet(s) are unlocked. "
+          "When it is the URL of /v1/wallet/sign_digest, the keys a block needs from the same keosd are signed in one call to its /v1/wallet/sign_digests")
          ("keosd-provider-timeout", boost::program_options::value<int32_t>()->default_value(5),
           "Limits the maximum time (in milliseconds) that is allowed for sending blocks to a keosd provider for signing")
          ("greylist-account", boost::program_options::value<vector<string>>()->composing()->multitoken(),
@@ -696,10 +1036,22 @@ void producer_plugin::set_program_options(
           "ratio between incoming transactions and deferred transactions when both are queued for execution")
          ("incoming-transaction-queue-size-mb", bpo::value<uint16_t>()->default_value( 1024 ),
           "Maximum size (in MiB) of the incoming transaction queue. Exceeding this value will subjectively drop transaction with resource exhaustion.")
+         ("incoming-transaction-priority", bpo::value<vector<string>>()->composing()->multitoken(),
+          "Account and priority, as account=priority, of the first authorizer of queued incoming transactions. Higher priorities are processed first, accounts not listed have priority 0. May be specified multiple times.")
          ("producer-threads", bpo::value<uint16_t>()->default_value(config::default_controller_thread_pool_size),
           "Number of worker threads in producer thread pool")
          ("snapshots-dir", bpo::value<bfs::path>()->default_value("snapshots"),
           "the location of the snapshots directory (absolute path or relative to application data dir)")
+         ("snapshot-compression", bpo::bool_switch()->default_value(false),
+          "write snapshots in the compressed format, where each section is an independently seekable zlib stream")
+         ("block-timing-history", bpo::value<uint32_t>()->default_value(0),
+          "number of our most recently produced blocks to keep per-stage timings for, readable through get_block_timings. 0 to not record them")
+         ("snapshot-background-write", bpo::bool_switch()->default_value(false),
+          "only serialize snapshots into memory while block processing is paused, and compress and write them to disk on a separate thread. "
+          "Needs enough memory to hold a whole uncompressed snapshot")
+         ("snapshot-delta-base", bpo::value<bfs::path>(),
+          "uncompressed snapshot file to write, next to every snapshot created, a .delta file reproducing that snapshot from it. "
+          "nodeos restores from a delta with --snapshot set to the base and --snapshot-delta")
          ;
    config_file_options.add(producer_options);
 }
@@ -745,16 +1097,22 @@ make_key_signature_provider(const private_key_type& key) {
    };
 }
 
-static producer_plugin_impl::signature_provider_type
-make_keosd_signature_provider(const std::shared_ptr<producer_plugin_impl>& impl, const string& url_str, const public_key_type pubkey) {
-   fc::url keosd_url;
+static fc::url
+make_keosd_url(const string& url_str) {
    if(boost::algorithm::starts_with(url_str, "unix://"))
       //send the entire string after unix:// to http_plugin. It'll auto-detect which part
       // is the unix socket path, and which part is the url to hit on the server
-      keosd_url = fc::url("unix", url_str.substr(7), ostring(), ostring(), ostring(), ostring(), ovariant_object(), fc::optional<uint16_t>());
+      return fc::url("unix", url_str.substr(7), ostring(), ostring(), ostring(), ostring(), ovariant_object(), fc::optional<uint16_t>());
    else
-      keosd_url = fc::url(url_str);
+      return fc::url(url_str);
+}
+
+static producer_plugin_impl::signature_provider_type
+make_keosd_signature_provider(const std::shared_ptr<producer_plugin_impl>& impl, const string& url_str, const public_key_type pubkey) {
+   fc::url keosd_url = make_keosd_url(url_str);
    std::weak_ptr<producer_plugin_impl> weak_impl = impl;
+   if(boost::algorithm::ends_with(url_str, "/sign_digest"))
+      impl->_keosd_batch_urls[pubkey] = make_keosd_url(url_str + "s");
 
    return [weak_impl, keosd_url, pubkey]( const chain::digest_type& digest ) {
       auto impl = weak_impl.lock();
@@ -762,7 +1120,7 @@ make_keosd_signature_provider(const std::shared_ptr<producer_plugin_impl>& impl,
          fc::variant params;
          fc::to_variant(std::make_pair(digest, pubkey), params);
          auto deadline = impl->_keosd_provider_timeout_us.count() >= 0 ? fc::time_point::now() + impl->_keosd_provider_timeout_us : fc::time_point::maximum();
-         return app().get_plugin<http_client_plugin>().get_client().post_sync(keosd_url, params, deadline).as<chain::signature_type>();
+         return app().get_plugin<http_client_plugin>().post_sync(keosd_url, params, deadline).as<chain::signature_type>();
       } else {
          return signature_type();
       }
@@ -791,6 +1149,7 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
          try {
             auto key_id_to_wif_pair = dejsonify<std::pair<public_key_type, private_key_type>>(key_id_to_wif_pair_string);
             my->_signature_providers[key_id_to_wif_pair.first] = make_key_signature_provider(key_id_to_wif_pair.second);
+            my->_keosd_batch_urls.erase(key_id_to_wif_pair.first);
             auto blanked_privkey = std::string(key_id_to_wif_pair.second.to_string().size(), '*' );
             wlog("\"private-key\" is DEPRECATED, use \"signature-provider=${pub}=KEY:${priv}\"", ("pub",key_id_to_wif_pair.first)("priv", blanked_privkey));
          } catch ( fc::exception& e ) {
@@ -817,6 +1176,7 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
 
             if (spec_type_str == "KEY") {
                my->_signature_providers[pubkey] = make_key_signature_provider(private_key_type(spec_data));
+               my->_keosd_batch_urls.erase(pubkey);
             } else if (spec_type_str == "KEOSD") {
                my->_signature_providers[pubkey] = make_keosd_signature_provider(my, spec_data, pubkey);
             }
@@ -829,6 +1189,10 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
 
    my->_keosd_provider_timeout_us = fc::milliseconds(options.at("keosd-provider-timeout").as<int32_t>());
 
+   if( my->_signature_providers.size() > 1 ) {
+      my->_signing_thread_pool.emplace( "sign", std::min<size_t>( my->_signature_providers.size() - 1, 8 ) );
+   }
+
    my->_produce_time_offset_us = options.at("produce-time-offset-us").as<int32_t>();
    EOS_ASSERT( my->_produce_time_offset_us <= 0 && my->_produce_time_offset_us >= -config::block_interval_us, plugin_config_exception,
                "produce-time-offset-us ${o} must be 0 .. -${bi}", ("bi", config::block_interval_us)("o", my->_produce_time_offset_us) );
@@ -862,6 +1226,9 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
 
    my->_max_scheduled_transaction_time_per_block_ms = options.at("max-scheduled-transaction-time-per-block-ms").as<int32_t>();
 
+   my->_subjective_failures.set_max_backoff_blocks( options.at( "subjective-failure-max-backoff-blocks" ).as<uint32_t>() );
+   my->_subjective_failures.set_account_failure_budget( options.at( "subjective-account-failure-budget" ).as<uint32_t>() );
+
    if( options.at( "subjective-cpu-leeway-us" ).as<int32_t>() != config::default_subjective_cpu_leeway_us ) {
       chain.set_subjective_cpu_leeway( fc::microseconds( options.at( "subjective-cpu-leeway-us" ).as<int32_t>() ) );
    }
@@ -877,6 +1244,16 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
 
    my->_pending_incoming_transactions.set_max_incoming_transaction_queue_size( max_incoming_transaction_queue_size );
 
+   if( options.count("incoming-transaction-priority") ) {
+      for( const auto& account_priority : options["incoming-transaction-priority"].as<vector<string>>() ) {
+         auto delim = account_priority.find("=");
+         EOS_ASSERT( delim != std::string::npos, plugin_config_exception,
+                     "Missing \"=\" in incoming-transaction-priority ${p}", ("p", account_priority) );
+         my->_pending_incoming_transactions.set_account_priority( account_name( account_priority.substr( 0, delim ) ),
+                                                                  std::stoi( account_priority.substr( delim + 1 ) ) );
+      }
+   }
+
    my->_incoming_defer_ratio = options.at("incoming-defer-ratio").as<double>();
 
    auto thread_pool_size = options.at( "producer-threads" ).as<uint16_t>();
@@ -899,6 +1276,20 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
                   "No such directory '${dir}'", ("dir", my->_snapshots_dir.generic_string()) );
    }
 
+   my->_snapshot_compression = options.at( "snapshot-compression" ).as<bool>();
+   my->_snapshot_background_write = options.at( "snapshot-background-write" ).as<bool>();
+   if( options.count( "snapshot-delta-base" ) ) {
+      my->_snapshot_delta_base = options.at( "snapshot-delta-base" ).as<bfs::path>();
+      EOS_ASSERT( fc::is_regular_file( *my->_snapshot_delta_base ), plugin_config_exception,
+                  "snapshot-delta-base ${p} does not exist", ("p", my->_snapshot_delta_base->generic_string()) );
+      // every row after a change shifts in the zlib streams of a compressed snapshot, leaving nothing to copy from the base
+      EOS_ASSERT( !my->_snapshot_compression, plugin_config_exception, "snapshot-delta-base needs uncompressed snapshots" );
+   }
+   my->_block_timings_size = options.at( "block-timing-history" ).as<uint32_t>();
+   if( my->_snapshot_background_write ) {
+      my->_snapshot_thread_pool.emplace( "snap", 1 );
+   }
+
    my->_incoming_block_subscription = app().get_channel<incoming::channels::block>().subscribe(
          [this](const signed_block_ptr& block) {
       try {
@@ -959,7 +1350,13 @@ void producer_plugin::plugin_startup()
    my->_accepted_block_connection.emplace(chain.accepted_block.connect( [this]( const auto& bsp ){ my->on_block( bsp ); } ));
    my->_accepted_block_header_connection.emplace(chain.accepted_block_header.connect( [this]( const auto& bsp ){ my->on_block_header( bsp ); } ));
    my->_irreversible_block_connection.emplace(chain.irreversible_block.connect( [this]( const auto& bsp ){ my->on_irreversible_block( bsp->block ); } ));
+   if( my->_block_timings_size > 0 ) {
+      my->_applied_transaction_connection.emplace(chain.applied_transaction.connect( [this]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> t ){
+         my->on_applied_transaction( std::get<0>(t) );
+      } ));
+   }
 
+   my->update_prevalidator();
    const auto lib_num = chain.last_irreversible_block_num();
    const auto lib = chain.fetch_block_by_number(lib_num);
    if (lib) {
@@ -999,6 +1396,14 @@ void producer_plugin::plugin_shutdown() {
       my->_thread_pool->stop();
    }
 
+   if( my->_snapshot_thread_pool ) {
+      my->_snapshot_thread_pool->stop();
+   }
+
+   if( my->_signing_thread_pool ) {
+      my->_signing_thread_pool->stop();
+   }
+
    app().post( 0, [me = my](){} ); // keep my pointer alive until queue is drained
 }
 
@@ -1052,6 +1457,10 @@ void producer_plugin::update_runtime_options(const runtime_options& options) {
       my->_last_block_time_offset_us = *options.last_block_time_offset_us;
    }
 
+   if (options.adaptive_cpu_effort) {
+      my->_adaptive_cpu_effort = *options.adaptive_cpu_effort;
+   }
+
    if (options.max_scheduled_transaction_time_per_block_ms) {
       my->_max_scheduled_transaction_time_per_block_ms = *options.max_scheduled_transaction_time_per_block_ms;
    }
@@ -1085,7 +1494,9 @@ producer_plugin::runtime_options producer_plugin::get_runtime_options() const {
             my->chain_plug->chain().get_subjective_cpu_leeway()->count() :
             fc::optional<int32_t>(),
       my->_incoming_defer_ratio,
-      my->chain_plug->chain().get_greylist_limit()
+      my->chain_plug->chain().get_greylist_limit(),
+      my->_adaptive_cpu_effort,
+      my->_finalize_block_us < 0 ? fc::optional<int64_t>() : my->_finalize_block_us
    };
 }
 
@@ -1153,6 +1564,23 @@ producer_plugin::integrity_hash_information producer_plugin::get_integrity_hash(
    return {chain.head_block_id(), chain.calculate_integrity_hash()};
 }
 
+producer_plugin::integrity_hash_information producer_plugin::get_integrity_merkle_root() const {
+   chain::controller& chain = my->chain_plug->chain();
+
+   auto reschedule = fc::make_scoped_exit([this](){
+      my->schedule_production_loop();
+   });
+
+   if (chain.is_building_block()) {
+      // abort the pending block
+      my->_unapplied_transactions.add_aborted( chain.abort_block() );
+   } else {
+      reschedule.cancel();
+   }
+
+   return {chain.head_block_id(), chain.calculate_integrity_merkle_root()};
+}
+
 void producer_plugin::create_snapshot(producer_plugin::next_function<producer_plugin::snapshot_information> next) {
    chain::controller& chain = my->chain_plug->chain();
 
@@ -1183,27 +1611,37 @@ void producer_plugin::create_snapshot(producer_plugin::next_function<producer_pl
 
       // create the snapshot
       auto snap_out = std::ofstream(p.generic_string(), (std::ios::out | std::ios::binary));
-      auto writer = std::make_shared<ostream_snapshot_writer>(snap_out);
-      chain.write_snapshot(writer);
-      writer->finalize();
+      if( my->_snapshot_compression ) {
+         auto writer = std::make_shared<compressed_ostream_snapshot_writer>(snap_out);
+         chain.write_snapshot(writer);
+         writer->finalize();
+      } else {
+         auto writer = std::make_shared<ostream_snapshot_writer>(snap_out);
+         chain.write_snapshot(writer);
+         writer->finalize();
+      }
       snap_out.flush();
       snap_out.close();
+
+      if( my->_snapshot_delta_base ) write_snapshot_delta( *my->_snapshot_delta_base, p );
    };
 
    // If in irreversible mode, create snapshot and return path to snapshot immediately.
-   if( chain.get_read_mode() == db_read_mode::IRREVERSIBLE ) {
+   // A snapshot written in the background is returned once written, when it is promoted as the head is irreversible.
+   if( chain.get_read_mode() == db_read_mode::IRREVERSIBLE && !my->_snapshot_background_write ) {
       try {
          write_snapshot( temp_path );
 
          boost::system::error_code ec;
          bfs::rename(temp_path, snapshot_path, ec);
+         rename_snapshot_delta(temp_path, snapshot_path, ec);
          EOS_ASSERT(!ec, snapshot_finalization_exception,
                "Unable to finalize valid snapshot of block number ${bn}: [code: ${ec}] ${message}",
                ("bn", chain.head_block_num())
                ("ec", ec.value())
                ("message", ec.message()));
 
-         next( producer_plugin::snapshot_information{head_id, snapshot_path.generic_string()} );
+         next( producer_plugin::snapshot_information{head_id, snapshot_path.generic_string(), snapshot_delta_name(snapshot_path)} );
       } CATCH_AND_CALL (next);
       return;
    }
@@ -1221,6 +1659,92 @@ void producer_plugin::create_snapshot(producer_plugin::next_function<producer_pl
             next(res);
          };
       });
+   } else if( my->_snapshot_background_write ) {
+      const auto& pending_path = pending_snapshot::get_pending_path(head_id, my->_snapshots_dir);
+
+      try {
+         // state can only be read consistently while block processing is paused, so serialize into memory now and
+         // leave compressing and writing the file to the snapshot thread
+         auto buffer = std::make_shared<std::stringstream>();
+         {
+            auto reschedule = fc::make_scoped_exit([this](){
+               my->schedule_production_loop();
+            });
+
+            if (chain.is_building_block()) {
+               // abort the pending block
+               my->_unapplied_transactions.add_aborted( chain.abort_block() );
+            } else {
+               reschedule.cancel();
+            }
+
+            auto writer = std::make_shared<ostream_snapshot_writer>(*buffer);
+            chain.write_snapshot(writer);
+            writer->finalize();
+         }
+
+         auto progress = std::make_shared<snapshot_write_progress>();
+         progress->bytes_total = buffer->tellp();
+         my->_pending_snapshot_index.emplace(head_id, next, pending_path.generic_string(), snapshot_path.generic_string(), progress);
+
+         boost::asio::post( my->_snapshot_thread_pool->get_executor(),
+               [weak_this = my->weak_from_this(), buffer, progress, head_id, temp_path, pending_path,
+                compress = my->_snapshot_compression, delta_base = my->_snapshot_delta_base]() mutable {
+            fc::exception_ptr except;
+            auto set_error = [&except]( const fc::exception_ptr& e ) { except = e; };
+            try {
+               bfs::create_directory( temp_path.parent_path() );
+               auto snap_out = std::ofstream(temp_path.generic_string(), (std::ios::out | std::ios::binary));
+               if( compress ) {
+                  compress_snapshot( *buffer, snap_out, [&progress]( uint64_t consumed ) {
+                     progress->bytes_written = consumed;
+                  } );
+               } else {
+                  std::vector<char> chunk( 1024*1024 );
+                  while( buffer->read( chunk.data(), chunk.size() ) || buffer->gcount() > 0 ) {
+                     snap_out.write( chunk.data(), buffer->gcount() );
+                     progress->bytes_written += buffer->gcount();
+                  }
+               }
+               snap_out.flush();
+               snap_out.close();
+               EOS_ASSERT( !snap_out.fail(), snapshot_finalization_exception,
+                           "Unable to write snapshot ${p}", ("p", temp_path.generic_string()) );
+               buffer.reset();
+
+               if( delta_base ) write_snapshot_delta( *delta_base, temp_path );
+
+               boost::system::error_code ec;
+               bfs::rename(temp_path, pending_path, ec);
+               rename_snapshot_delta(temp_path, pending_path, ec);
+               EOS_ASSERT(!ec, snapshot_finalization_exception,
+                     "Unable to promote temp snapshot to pending for block number ${bn}: [code: ${ec}] ${message}",
+                     ("bn", block_header::num_from_id(head_id))
+                     ("ec", ec.value())
+                     ("message", ec.message()));
+
+               progress->bytes_written = progress->bytes_total;
+               progress->done = true;
+            } CATCH_AND_CALL( set_error );
+            buffer.reset();
+
+            app().post( priority::medium, [weak_this, head_id, except]() {
+               auto self = weak_this.lock();
+               if( !self ) return;
+               if( except ) {
+                  auto& pending_by_id = self->_pending_snapshot_index.get<by_id>();
+                  auto itr = pending_by_id.find( head_id );
+                  if( itr != pending_by_id.end() ) {
+                     auto next = itr->next;
+                     pending_by_id.erase( itr );
+                     next( except );
+                  }
+               } else {
+                  self->promote_pending_snapshots( self->chain_plug->chain().last_irreversible_block_num() );
+               }
+            } );
+         } );
+      } CATCH_AND_CALL (next);
    } else {
       const auto& pending_path = pending_snapshot::get_pending_path(head_id, my->_snapshots_dir);
 
@@ -1229,6 +1753,7 @@ void producer_plugin::create_snapshot(producer_plugin::next_function<producer_pl
 
          boost::system::error_code ec;
          bfs::rename(temp_path, pending_path, ec);
+         rename_snapshot_delta(temp_path, pending_path, ec);
          EOS_ASSERT(!ec, snapshot_finalization_exception,
                "Unable to promote temp snapshot to pending for block number ${bn}: [code: ${ec}] ${message}",
                ("bn", chain.head_block_num())
@@ -1240,6 +1765,28 @@ void producer_plugin::create_snapshot(producer_plugin::next_function<producer_pl
    }
 }
 
+producer_plugin::get_block_timings_result producer_plugin::get_block_timings() const {
+   return { std::vector<block_timing>( my->_block_timings.begin(), my->_block_timings.end() ) };
+}
+
+producer_plugin::snapshot_status_result producer_plugin::get_snapshot_status() const {
+   snapshot_status_result result;
+   for( const auto& pending : my->_pending_snapshot_index.get<by_height>() ) {
+      snapshot_status status{ pending.block_id, pending.get_height(), pending.final_path };
+      if( pending.is_written() ) {
+         status.status = "pending";
+         boost::system::error_code ec;
+         status.bytes_total = status.bytes_written = bfs::file_size( pending.pending_path, ec );
+      } else {
+         status.status = "writing";
+         status.bytes_written = pending.progress->bytes_written;
+         status.bytes_total = pending.progress->bytes_total;
+      }
+      result.snapshots.emplace_back( std::move(status) );
+   }
+   return result;
+}
+
 producer_plugin::scheduled_protocol_feature_activations
 producer_plugin::get_scheduled_protocol_feature_activations()const {
    return {my->_protocol_features_to_activate};
@@ -1416,7 +1963,35 @@ fc::time_point producer_plugin_impl::calculate_pending_block_time() const {
 
 fc::time_point producer_plugin_impl::calculate_block_deadline( const fc::time_point& block_time ) const {
    bool last_block = ((block_timestamp_type(block_time).slot % config::producer_repetitions) == config::producer_repetitions - 1);
-   return block_time + fc::microseconds(last_block ? _last_block_time_offset_us : _produce_time_offset_us);
+   int64_t offset_us = last_block ? _last_block_time_offset_us : _produce_time_offset_us;
+   if( _adaptive_cpu_effort && _finalize_block_us > 0 ) {
+      offset_us = std::min<int64_t>( offset_us, -2 * _finalize_block_us );
+   }
+   return block_time + fc::microseconds(offset_us);
+}
+
+void producer_plugin_impl::adapt_last_block_offset( bool handed_off ) {
+   if( !_adaptive_cpu_effort ) return;
+
+   // additive increase of the last block's time while the next producer builds on it, a larger decrease when it does not,
+   // bounded by leaving room to finalize the block at one end and by half the block interval at the other
+   const int32_t relax_step_us = 5'000;
+   const int32_t tighten_step_us = 50'000;
+   const int32_t max_offset_us = _finalize_block_us > 0 ? -2 * std::min<int64_t>( _finalize_block_us, config::block_interval_us / 4 ) : 0;
+   const int32_t min_offset_us = -config::block_interval_us / 2;
+
+   int32_t offset_us = handed_off ? _last_block_time_offset_us + relax_step_us : _last_block_time_offset_us - tighten_step_us;
+   offset_us = std::max( min_offset_us, std::min( max_offset_us, offset_us ) );
+   if( offset_us == _last_block_time_offset_us ) return;
+
+   if( handed_off ) {
+      fc_dlog( _log, "Next producer built on our last block, last-block-time-offset-us ${o} -> ${n}",
+               ("o", _last_block_time_offset_us)("n", offset_us) );
+   } else {
+      ilog( "Next producer did not build on our last block, last-block-time-offset-us ${o} -> ${n}",
+            ("o", _last_block_time_offset_us)("n", offset_us) );
+   }
+   _last_block_time_offset_us = offset_us;
 }
 
 producer_plugin_impl::start_block_result producer_plugin_impl::start_block() {
@@ -1490,13 +2065,20 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block() {
          return start_block_result::waiting_for_block;
    }
 
+   bool prebuilding = false;
    if (_pending_block_mode == pending_block_mode::producing) {
       const auto start_block_time = block_time - fc::microseconds( config::block_interval_us );
       if( now < start_block_time ) {
-         fc_dlog(_log, "Not producing block waiting for production window ${n} ${bt}", ("n", hbs->block_num + 1)("bt", block_time) );
-         // start_block_time instead of block_time because schedule_delayed_production_loop calculates next block time from given time
-         schedule_delayed_production_loop(weak_from_this(), calculate_producer_wake_up_time(start_block_time));
-         return start_block_result::waiting_for_production;
+         const bool prebuilt = _prebuilt_block && _prebuilt_block->head_id == hbs->id && _prebuilt_block->block_time == block_time &&
+                               chain.is_building_block();
+         if( !_prebuild_block || prebuilt ) {
+            if( prebuilt ) _pending_block_mode = pending_block_mode::speculating;
+            fc_dlog(_log, "Not producing block waiting for production window ${n} ${bt}", ("n", hbs->block_num + 1)("bt", block_time) );
+            // start_block_time instead of block_time because schedule_delayed_production_loop calculates next block time from given time
+            schedule_delayed_production_loop(weak_from_this(), calculate_producer_wake_up_time(start_block_time));
+            return start_block_result::waiting_for_production;
+         }
+         prebuilding = true;
       }
    } else if (previous_pending_mode == pending_block_mode::producing) {
       // just produced our last block of our round
@@ -1530,7 +2112,17 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block() {
          blocks_to_confirm = (uint16_t)(std::min<uint32_t>(blocks_to_confirm, (uint32_t)(hbs->block_num - hbs->dpos_irreversible_blocknum)));
       }
 
-      _unapplied_transactions.add_aborted( chain.abort_block() );
+      // a block prebuilt on the same head for the same time, same confirmations as both come from the watermark, only
+      // needs the remaining queues processed. Not when activating protocol features, the pending block could have
+      // changed the preactivated ones.
+      const auto start_block_begin = fc::time_point::now();
+      const bool use_prebuilt = !prebuilding && _pending_block_mode == pending_block_mode::producing && _prebuilt_block &&
+                                _prebuilt_block->head_id == hbs->id && _prebuilt_block->block_time == block_time &&
+                                chain.is_building_block() && chain.pending_block_time() == block_time &&
+                                _protocol_features_to_activate.empty() && chain.get_preactivated_protocol_features().empty();
+      if( !use_prebuilt ) {
+         _unapplied_transactions.add_aborted( chain.abort_block() );
+      }
 
       auto features_to_activate = chain.get_preactivated_protocol_features();
       if( _pending_block_mode == pending_block_mode::producing && _protocol_features_to_activate.size() > 0 ) {
@@ -1567,9 +2159,37 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block() {
          }
       }
 
-      chain.start_block( block_time, blocks_to_confirm, features_to_activate );
+      if( use_prebuilt ) {
+         fc_dlog(_log, "Producing prebuilt block #${n} with ${t} transactions",
+                 ("n", hbs->block_num + 1)("t", chain.get_pending_trx_receipts().size()) );
+      } else {
+         chain.start_block( block_time, blocks_to_confirm, features_to_activate );
+      }
+      if( prebuilding && features_to_activate.empty() ) {
+         _prebuilt_block = prebuilt_block{ hbs->id, block_time };
+      } else {
+         _prebuilt_block.reset();
+      }
+
+      if( _block_timings_size > 0 && _pending_block_mode == pending_block_mode::producing ) {
+         // a prebuilt block keeps the timings recorded while it was built
+         if( !use_prebuilt || !_block_timing ) {
+            _block_timing.emplace();
+            _block_timing->block_num = hbs->block_num + 1;
+            _block_timing->block_time = block_time;
+            _block_timing->producer = scheduled_producer.producer_name;
+         }
+         _block_timing->start_block_us += (fc::time_point::now() - start_block_begin).count();
+      } else {
+         _block_timing.reset();
+      }
    } LOG_AND_DROP();
 
+   if( prebuilding ) {
+      // transactions are applied as for any speculative block until the production window opens
+      _pending_block_mode = pending_block_mode::speculating;
+   }
+
    if( chain.is_building_block() ) {
       const auto& pending_block_signing_authority = chain.pending_block_signing_authority();
       const fc::time_point preprocess_deadline = calculate_block_deadline(block_time);
@@ -1588,10 +2208,16 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block() {
          // limit execution of pending incoming to once per block
          size_t pending_incoming_process_limit = _pending_incoming_transactions.size();
 
-         if( !process_unapplied_trxs( preprocess_deadline ) )
+         bool unapplied_done;
+         {
+            auto span = record_span( &producer_plugin::block_timing::unapplied_trxs_us );
+            unapplied_done = process_unapplied_trxs( preprocess_deadline );
+         }
+         if( !unapplied_done )
             return start_block_result::exhausted;
 
          if (_pending_block_mode == pending_block_mode::producing) {
+            auto span = record_span( &producer_plugin::block_timing::scheduled_trxs_us );
             auto scheduled_trx_deadline = preprocess_deadline;
             if (_max_scheduled_transaction_time_per_block_ms >= 0) {
                scheduled_trx_deadline = std::min<fc::time_point>(
@@ -1608,6 +2234,7 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block() {
          if (preprocess_deadline <= fc::time_point::now() || block_is_exhausted()) {
             return start_block_result::exhausted;
          } else {
+            auto span = record_span( &producer_plugin::block_timing::incoming_trxs_us );
             if( !process_incoming_trxs( preprocess_deadline, pending_incoming_process_limit ) )
                return start_block_result::exhausted;
             return start_block_result::succeeded;
@@ -1703,8 +2330,10 @@ bool producer_plugin_impl::process_unapplied_trxs( const fc::time_point& deadlin
    bool exhausted = false;
    if( !_unapplied_transactions.empty() ) {
       chain::controller& chain = chain_plug->chain();
-      int num_applied = 0, num_failed = 0, num_processed = 0;
+      int num_applied = 0, num_failed = 0, num_processed = 0, num_skipped = 0;
       auto unapplied_trxs_size = _unapplied_transactions.size();
+      const uint32_t pending_block_num = chain.head_block_num() + 1;
+      _subjective_failures.remove_expired( chain.last_irreversible_block_time() );
       auto itr     = (_pending_block_mode == pending_block_mode::producing) ?
                      _unapplied_transactions.begin() : _unapplied_transactions.persisted_begin();
       auto end_itr = (_pending_block_mode == pending_block_mode::producing) ?
@@ -1716,6 +2345,12 @@ bool producer_plugin_impl::process_unapplied_trxs( const fc::time_point& deadlin
          }
 
          const transaction_metadata_ptr trx = itr->trx_meta;
+         const account_name auth = trx->packed_trx()->get_transaction().first_authorizer();
+         if( _subjective_failures.should_skip( trx->id(), auth, pending_block_num ) ) {
+            ++num_skipped;
+            ++itr;
+            continue;
+         }
          ++num_processed;
          try {
             auto trx_deadline = fc::time_point::now() + fc::milliseconds( _max_transaction_time_ms );
@@ -1734,14 +2369,18 @@ bool producer_plugin_impl::process_unapplied_trxs( const fc::time_point& deadlin
                      // don't erase, subjective failure so try again next time
                      break;
                   }
+                  // did not fit although the block still has room, back off before running it again
+                  _subjective_failures.failed( trx->id(), auth, trx->packed_trx()->expiration(), pending_block_num );
                } else {
                   // this failed our configured maximum transaction time, we don't want to replay it
                   ++num_failed;
+                  _subjective_failures.succeeded( trx->id() );
                   itr = _unapplied_transactions.erase( itr );
                   continue;
                }
             } else {
                ++num_applied;
+               _subjective_failures.succeeded( trx->id() );
                itr = _unapplied_transactions.erase( itr );
                continue;
             }
@@ -1749,8 +2388,8 @@ bool producer_plugin_impl::process_unapplied_trxs( const fc::time_point& deadlin
          ++itr;
       }
 
-      fc_dlog( _log, "Processed ${m} of ${n} previously applied transactions, Applied ${applied}, Failed/Dropped ${failed}",
-               ("m", num_processed)( "n", unapplied_trxs_size )("applied", num_applied)("failed", num_failed) );
+      fc_dlog( _log, "Processed ${m} of ${n} previously applied transactions, Applied ${applied}, Failed/Dropped ${failed}, Backed off ${skipped}",
+               ("m", num_processed)( "n", unapplied_trxs_size )("applied", num_applied)("failed", num_failed)("skipped", num_skipped) );
    }
    return !exhausted;
 }
@@ -1932,7 +2571,14 @@ void producer_plugin_impl::schedule_production_loop() {
       chain::controller& chain = chain_plug->chain();
       fc_dlog(_log, "Speculative Block Created; Scheduling Speculative/Production Change");
       EOS_ASSERT( chain.is_building_block(), missing_pending_block_state, "speculating without pending_block_state" );
-      schedule_delayed_production_loop(weak_from_this(), calculate_producer_wake_up_time(chain.pending_block_time()));
+      const auto pending_block_time = chain.pending_block_time();
+      if( _prebuilt_block && _prebuilt_block->block_time == pending_block_time ) {
+         // the prebuilt block is for our next slot, wake up when its production window opens not once it has passed
+         schedule_delayed_production_loop(weak_from_this(),
+               calculate_producer_wake_up_time(pending_block_time - fc::microseconds( config::block_interval_us )));
+      } else {
+         schedule_delayed_production_loop(weak_from_this(), calculate_producer_wake_up_time(pending_block_time));
+      }
    } else {
       fc_dlog(_log, "Speculative Block Created");
    }
@@ -2043,8 +2689,36 @@ static auto maybe_make_debug_time_logger() -> fc::optional<decltype(make_debug_t
    }
 }
 
+vector<signature_type> producer_plugin_impl::sign_with_keosd( const fc::url& batch_url, const vector<public_key_type>& keys, const digest_type& d ) {
+   try {
+      std::vector<std::pair<digest_type, public_key_type>> digests;
+      digests.reserve(keys.size());
+      for (const auto& k : keys) digests.emplace_back(d, k);
+      fc::variant params;
+      fc::to_variant(digests, params);
+      auto deadline = _keosd_provider_timeout_us.count() >= 0 ? fc::time_point::now() + _keosd_provider_timeout_us : fc::time_point::maximum();
+      auto sigs = app().get_plugin<http_client_plugin>().post_sync(batch_url, params, deadline).as<vector<signature_type>>();
+      EOS_ASSERT( sigs.size() == keys.size(), producer_exception, "keosd returned ${n} signatures for ${k} keys",
+                  ("n", sigs.size())("k", keys.size()) );
+      return sigs;
+   } catch( const fc::exception& e ) {
+      // a keosd without sign_digests, sign with each key's provider instead
+      if( !_keosd_batch_unsupported_logged.exchange(true) ) {
+         wlog( "batch signing with keosd at ${u} failed, signing one key at a time: ${e}",
+               ("u", std::string(batch_url))("e", e.to_detail_string()) );
+      }
+   }
+   vector<signature_type> sigs;
+   sigs.reserve(keys.size());
+   for (const auto& k : keys) {
+      sigs.emplace_back(_signature_providers.at(k)(d));
+   }
+   return sigs;
+}
+
 void producer_plugin_impl::produce_block() {
    //ilog("produce_block ${t}", ("t", fc::time_point::now())); // for testing _produce_time_offset_us
+   const auto start = fc::time_point::now();
    EOS_ASSERT(_pending_block_mode == pending_block_mode::producing, producer_exception, "called produce_block while not actually producing");
    chain::controller& chain = chain_plug->chain();
    const auto& hbs = chain.head_block_state();
@@ -2053,40 +2727,114 @@ void producer_plugin_impl::produce_block() {
 
    const auto& auth = chain.pending_block_signing_authority();
    std::vector<std::reference_wrapper<const signature_provider_type>> relevant_providers;
+   std::vector<public_key_type> relevant_keys;
 
    relevant_providers.reserve(_signature_providers.size());
+   relevant_keys.reserve(_signature_providers.size());
 
    producer_authority::for_each_key(auth, [&](const public_key_type& key){
       const auto& iter = _signature_providers.find(key);
       if (iter != _signature_providers.end()) {
          relevant_providers.emplace_back(iter->second);
+         relevant_keys.emplace_back(key);
       }
    });
 
    EOS_ASSERT(relevant_providers.size() > 0, producer_priv_key_not_found, "Attempting to produce a block for which we don't have any relevant private keys");
 
+   // each signer fills in the signatures of some of the relevant keys: one per keosd with several of the keys, which
+   // signs them all in one call, and one per remaining key
+   struct signer {
+      fc::optional<fc::url> batch_url;
+      std::vector<size_t>   indexes; ///< into relevant_providers
+   };
+   std::vector<signer> signers;
+   {
+      std::map<std::string, size_t> batch_signers;
+      for (size_t i = 0; i < relevant_keys.size(); ++i) {
+         auto url_itr = _keosd_batch_urls.find(relevant_keys[i]);
+         if (url_itr != _keosd_batch_urls.end()) {
+            auto inserted = batch_signers.emplace(std::string(url_itr->second), signers.size());
+            if (inserted.second) signers.emplace_back(signer{url_itr->second, {}});
+            signers[inserted.first->second].indexes.push_back(i);
+         } else {
+            signers.emplace_back(signer{{}, {i}});
+         }
+      }
+   }
+
    if (_protocol_features_signaled) {
       _protocol_features_to_activate.clear(); // clear _protocol_features_to_activate as it is already set in pending_block
       _protocol_features_signaled = false;
    }
 
    //idump( (fc::time_point::now() - chain.pending_block_time()) );
+   int64_t sign_us = 0;
    chain.finalize_block( [&]( const digest_type& d ) {
       auto debug_logger = maybe_make_debug_time_logger();
-      vector<signature_type> sigs;
-      sigs.reserve(relevant_providers.size());
+      const auto sign_start = fc::time_point::now();
+      auto sign_time = fc::make_scoped_exit( [&]() { sign_us = (fc::time_point::now() - sign_start).count(); } );
+      vector<signature_type> sigs(relevant_providers.size());
+
+      auto sign = [&]( const signer& s ) {
+         if (s.indexes.size() == 1) {
+            sigs[s.indexes[0]] = relevant_providers[s.indexes[0]].get()(d);
+            return;
+         }
+         vector<public_key_type> keys;
+         keys.reserve(s.indexes.size());
+         for (auto i : s.indexes) keys.emplace_back(relevant_keys[i]);
+         auto batch = sign_with_keosd(*s.batch_url, keys, d);
+         for (size_t i = 0; i < s.indexes.size(); ++i) sigs[s.indexes[i]] = std::move(batch[i]);
+      };
+
+      if( signers.size() == 1 || !_signing_thread_pool ) {
+         // sign with all relevant public keys
+         for (const auto& s : signers) {
+            sign(s);
+         }
+         return sigs;
+      }
 
-      // sign with all relevant public keys
-      for (const auto& p : relevant_providers) {
-         sigs.emplace_back(p.get()(d));
+      // a block_signing_authority with several of our signers, wait for the slowest signer rather than for all in turn
+      std::vector<std::future<void>> pending_sigs;
+      pending_sigs.reserve(signers.size() - 1);
+      auto wait_pending = fc::make_scoped_exit( [&pending_sigs]() {
+         for (auto& f : pending_sigs) f.wait();
+      } );
+      for (size_t i = 1; i < signers.size(); ++i) {
+         pending_sigs.emplace_back( async_thread_pool( _signing_thread_pool->get_executor(), [&sign, &s = signers[i]]() {
+            sign(s);
+         } ) );
+      }
+      sign(signers[0]);
+      for (auto& f : pending_sigs) {
+         f.get();
       }
       return sigs;
    } );
+   const auto commit_start = fc::time_point::now();
 
    chain.commit_block();
 
    block_state_ptr new_bs = chain.head_block_state();
 
+   const auto commit_end = fc::time_point::now();
+   const int64_t finalize_us = (commit_end - start).count();
+   if( _block_timing && _block_timing->block_time == new_bs->header.timestamp.to_time_point() ) {
+      _block_timing->block_id = new_bs->id;
+      _block_timing->sign_us = sign_us;
+      _block_timing->finalize_us = (commit_start - start).count() - sign_us;
+      _block_timing->commit_us = (commit_end - commit_start).count();
+      _block_timings.emplace_back( std::move(*_block_timing) );
+      while( _block_timings.size() > _block_timings_size ) _block_timings.pop_front();
+   }
+   _block_timing.reset();
+   _finalize_block_us = _finalize_block_us < 0 ? finalize_us : (_finalize_block_us * 7 + finalize_us) / 8;
+   if( (new_bs->header.timestamp.slot % config::producer_repetitions) == config::producer_repetitions - 1 ) {
+      _handoff_block.emplace( new_bs->id, new_bs->block_num );
+   }
+
    ilog("Produced block ${id}... #${n} @ ${t} signed by ${p} [trxs: ${count}, lib: ${lib}, confirmed: ${confs}]",
         ("p",new_bs->header.producer)("id",new_bs->id.str().substr(8,16))
         ("n",new_bs->block_num)("t",new_bs->header.timestamp)
@@ -2,10 +2,13 @@
 
 #include <boost/filesystem.hpp>
 #include <fstream>
+#include <map>
+#include <regex>
 #include <stdint.h>
 
 #include <eosio/chain/block_header.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/log_sync.hpp>
 #include <eosio/chain/types.hpp>
 #include <fc/log/logger.hpp>
 #include <fc/io/cfile.hpp>
@@ -26,13 +29,29 @@ namespace eosio {
  * each entry:
  *    state_history_log_header
  *    payload
+ *
+ * With segments enabled, the oldest blocks live in read only segments named <log>-<first>-<last>.log and .index
+ * next to the log, in the same format. The current log is renamed into a segment once it holds segment_blocks
+ * blocks, and whole segments are deleted once they fall outside of the retained blocks.
+ *
+ * payload of a version 0 entry:
+ *    uint32_t size, then size bytes compressed with zlib
+ *
+ * payload of a version 1 entry:
+ *    uint8_t state_history_codec, uint32_t size, then size bytes compressed with that codec
  */
 
 inline uint64_t       ship_magic(uint32_t version) { return N(ship).to_uint64_t() | version; }
 inline bool           is_ship(uint64_t magic) { return (magic & 0xffff'ffff'0000'0000) == N(ship).to_uint64_t(); }
 inline uint32_t       get_ship_version(uint64_t magic) { return magic; }
-inline bool           is_ship_supported_version(uint64_t magic) { return get_ship_version(magic) == 0; }
-static const uint32_t ship_current_version = 0;
+inline bool           is_ship_supported_version(uint64_t magic) { return get_ship_version(magic) <= 1; }
+static const uint32_t ship_current_version = 1;
+
+enum class state_history_codec : uint8_t {
+   zlib = 0,
+   zstd = 1,
+   lz4  = 2,
+};
 
 struct state_history_log_header {
    uint64_t             magic        = ship_magic(ship_current_version);
@@ -53,6 +72,19 @@ class state_history_log {
    uint32_t             _begin_block = 0;
    uint32_t             _end_block   = 0;
    chain::block_id_type last_block_id;
+   std::unique_ptr<chain::log_sync> sync;
+
+   struct segment {
+      uint32_t    begin_block = 0;
+      uint32_t    end_block   = 0;
+      std::string log_filename;
+      std::string index_filename;
+      fc::cfile   log;
+      fc::cfile   index;
+   };
+   std::map<uint32_t, std::unique_ptr<segment>> segments; // by begin_block, contiguous and ending at _begin_block
+   uint32_t                                     segment_blocks  = 0;
+   uint32_t                                     retained_blocks = 0;
 
  public:
    state_history_log(const char* const name, std::string log_filename, std::string index_filename)
@@ -61,14 +93,45 @@ class state_history_log {
        , index_filename(std::move(index_filename)) {
       open_log();
       open_index();
+      open_segments();
+   }
+
+   ~state_history_log() {
+      if (sync)
+         sync->flush_now([this]() { flush(); });
+   }
+
+   /// flush and optionally fsync entries in groups, see chain::log_sync; without it they are left to the file buffers
+   void set_durability(const chain::log_durability& durability) {
+      sync = std::make_unique<chain::log_sync>(std::string(name).substr(0, 10) + "-sync", durability,
+                                               std::vector<fc::path>{log_filename, index_filename});
+   }
+
+   void flush() {
+      log.flush();
+      index.flush();
    }
 
-   uint32_t begin_block() const { return _begin_block; }
+   /// @param segment_blocks   blocks per segment, 0 to keep a single log
+   /// @param retained_blocks  delete segments with no block among the newest retained_blocks, 0 to keep them all
+   void set_retention(uint32_t segment_blocks, uint32_t retained_blocks) {
+      EOS_ASSERT(!retained_blocks || segment_blocks, chain::plugin_config_exception,
+                 "retaining ${name}.log blocks needs segments", ("name", name));
+      this->segment_blocks  = segment_blocks;
+      this->retained_blocks = retained_blocks;
+      prune_segments();
+   }
+
+   uint32_t begin_block() const { return segments.empty() ? _begin_block : segments.begin()->first; }
    uint32_t end_block() const { return _end_block; }
 
    void read_header(state_history_log_header& header, bool assert_version = true) {
+      read_header(log, header, assert_version);
+   }
+
+   void read_header(fc::cfile& from, state_history_log_header& header, bool assert_version = true) {
       char bytes[state_history_log_header_serial_size];
-      log.read(bytes, sizeof(bytes));
+      from.read(bytes, sizeof(bytes));
       fc::datastream<const char*> ds(bytes, sizeof(bytes));
       fc::raw::unpack(ds, header);
       EOS_ASSERT(!ds.remaining(), chain::plugin_exception, "state_history_log_header_serial_size mismatch");
@@ -88,10 +151,16 @@ class state_history_log {
    template <typename F>
    void write_entry(const state_history_log_header& header, const chain::block_id_type& prev_id, F write_payload) {
       auto block_num = chain::block_header::num_from_id(header.block_id);
-      EOS_ASSERT(_begin_block == _end_block || block_num <= _end_block, chain::plugin_exception,
+      EOS_ASSERT((_begin_block == _end_block && segments.empty()) || block_num <= _end_block, chain::plugin_exception,
                  "missed a block in ${name}.log", ("name", name));
 
-      if (_begin_block != _end_block && block_num > _begin_block) {
+      // a fork reaching back into the segments turns the newest of them into the log again
+      while (!segments.empty() && block_num < _begin_block) {
+         truncate(block_num);
+         restore_last_segment();
+      }
+
+      if (begin_block() != _end_block && block_num > begin_block()) {
          if (block_num == _end_block) {
             EOS_ASSERT(prev_id == last_block_id, chain::plugin_exception, "missed a fork change in ${name}.log",
                        ("name", name));
@@ -120,12 +189,28 @@ class state_history_log {
          _begin_block = block_num;
       _end_block    = block_num + 1;
       last_block_id = header.block_id;
+      if (sync)
+         sync->appended([this]() { flush(); });
+
+      if (segment_blocks && _end_block - _begin_block >= segment_blocks) {
+         start_segment();
+         prune_segments();
+      }
    }
 
    // returns cfile positioned at payload
    fc::cfile& get_entry(uint32_t block_num, state_history_log_header& header) {
-      EOS_ASSERT(block_num >= _begin_block && block_num < _end_block, chain::plugin_exception,
+      EOS_ASSERT(block_num >= begin_block() && block_num < _end_block, chain::plugin_exception,
                  "read non-existing block in ${name}.log", ("name", name));
+      if (block_num < _begin_block) {
+         auto& seg = *std::prev(segments.upper_bound(block_num))->second;
+         uint64_t pos;
+         seg.index.seek((block_num - seg.begin_block) * sizeof(pos));
+         seg.index.read((char*)&pos, sizeof(pos));
+         seg.log.seek(pos);
+         read_header(seg.log, header);
+         return seg.log;
+      }
       log.seek(get_pos(block_num));
       read_header(header);
       return log;
@@ -276,7 +361,7 @@ class state_history_log {
          index.seek(0);
          boost::filesystem::resize_file(log_filename, 0);
          boost::filesystem::resize_file(index_filename, 0);
-         _begin_block = _end_block = 0;
+         _begin_block = _end_block = segments.empty() ? 0 : segments.rbegin()->second->end_block;
       } else {
          num_removed  = _end_block - block_num;
          uint64_t pos = get_pos(block_num);
@@ -290,6 +375,136 @@ class state_history_log {
       index.flush();
       ilog("fork or replay: removed ${n} blocks from ${name}.log", ("n", num_removed)("name", name));
    }
+
+   std::string segment_filename(uint32_t first, uint32_t last, const char* extension) const {
+      auto path = boost::filesystem::path(log_filename);
+      return (path.parent_path() / (path.stem().string() + "-" + std::to_string(first) + "-" +
+                                    std::to_string(last) + extension))
+          .string();
+   }
+
+   void open_segment_files(segment& seg) {
+      seg.log.set_file_path(seg.log_filename);
+      seg.log.open("rb");
+      seg.index.set_file_path(seg.index_filename);
+      seg.index.open("rb");
+   }
+
+   // the index of a segment is renamed before its log and removed after it, so a segment without a log is the
+   // leftover of an interrupted rename or removal
+   void open_segments() {
+      auto        path = boost::filesystem::path(log_filename);
+      std::regex  pattern(path.stem().string() + "-([0-9]+)-([0-9]+)\\.(log|index)");
+      std::smatch m;
+      std::map<uint32_t, std::unique_ptr<segment>> found;
+      std::vector<std::string>                     indexes;
+      for (auto& entry : boost::filesystem::directory_iterator(path.parent_path())) {
+         auto filename = entry.path().filename().string();
+         if (!std::regex_match(filename, m, pattern))
+            continue;
+         if (m[3] == "index") {
+            indexes.push_back(entry.path().string());
+            continue;
+         }
+         auto seg          = std::make_unique<segment>();
+         seg->begin_block = std::stoul(m[1].str());
+         seg->end_block   = std::stoul(m[2].str()) + 1;
+         seg->log_filename   = entry.path().string();
+         seg->index_filename = segment_filename(seg->begin_block, seg->end_block - 1, ".index");
+         found[seg->begin_block] = std::move(seg);
+      }
+      for (auto& index_filename : indexes) {
+         bool has_log = false;
+         for (auto& f : found)
+            has_log = has_log || f.second->index_filename == index_filename;
+         if (!has_log) {
+            ilog("removing ${f} left from an interrupted rename", ("f", index_filename));
+            boost::filesystem::remove(index_filename);
+         }
+      }
+
+      for (auto& f : found) {
+         auto& seg = *f.second;
+         EOS_ASSERT(boost::filesystem::exists(seg.index_filename) &&
+                        boost::filesystem::file_size(seg.index_filename) ==
+                            (seg.end_block - seg.begin_block) * sizeof(uint64_t),
+                    chain::plugin_exception, "corrupt ${f}", ("f", seg.index_filename));
+         EOS_ASSERT(segments.empty() || segments.rbegin()->second->end_block == seg.begin_block,
+                    chain::plugin_exception, "missing ${name}.log segment before ${f}",
+                    ("name", name)("f", seg.log_filename));
+         open_segment_files(seg);
+         segments[f.first] = std::move(f.second);
+      }
+      if (segments.empty())
+         return;
+
+      auto& last = *segments.rbegin()->second;
+      if (_begin_block == _end_block) {
+         _begin_block = _end_block = last.end_block;
+         state_history_log_header header;
+         get_entry(last.end_block - 1, header);
+         last_block_id = header.block_id;
+      }
+      EOS_ASSERT(_begin_block == last.end_block, chain::plugin_exception,
+                 "${name}.log begins at ${b} instead of after its last segment", ("name", name)("b", _begin_block));
+      ilog("${name}.log has ${n} segments, blocks ${b}-${e}",
+           ("name", name)("n", segments.size())("b", begin_block())("e", _end_block - 1));
+   }
+
+   /// the log becomes the newest segment and an empty log starts after it
+   void start_segment() {
+      if (sync)
+         sync->flush_now([this]() { flush(); });
+      else
+         flush();
+      auto seg            = std::make_unique<segment>();
+      seg->begin_block    = _begin_block;
+      seg->end_block      = _end_block;
+      seg->log_filename   = segment_filename(_begin_block, _end_block - 1, ".log");
+      seg->index_filename = segment_filename(_begin_block, _end_block - 1, ".index");
+      log.close();
+      index.close();
+      boost::filesystem::rename(index_filename, seg->index_filename);
+      boost::filesystem::rename(log_filename, seg->log_filename);
+      open_segment_files(*seg);
+      segments[seg->begin_block] = std::move(seg);
+
+      log.open("a+b");
+      index.open("a+b");
+      _begin_block = _end_block;
+      ilog("${name}.log continues at block ${b}", ("name", name)("b", _begin_block));
+   }
+
+   /// the newest segment becomes the log again, the log must be empty
+   void restore_last_segment() {
+      auto it  = std::prev(segments.end());
+      auto seg = std::move(it->second);
+      segments.erase(it);
+      seg->log.close();
+      seg->index.close();
+      log.close();
+      index.close();
+      boost::filesystem::rename(seg->log_filename, log_filename);
+      boost::filesystem::rename(seg->index_filename, index_filename);
+      _begin_block = _end_block = 0;
+      open_log();
+      open_index();
+      ilog("${name}.log reopened segment ${b}-${e} for a fork",
+           ("name", name)("b", seg->begin_block)("e", seg->end_block - 1));
+   }
+
+   void prune_segments() {
+      while (retained_blocks && !segments.empty() &&
+             _end_block - segments.begin()->second->end_block >= retained_blocks) {
+         auto seg = std::move(segments.begin()->second);
+         segments.erase(segments.begin());
+         seg->log.close();
+         seg->index.close();
+         boost::filesystem::remove(seg->log_filename);
+         boost::filesystem::remove(seg->index_filename);
+         ilog("removed ${name}.log blocks ${b}-${e}", ("name", name)("b", seg->begin_block)("e", seg->end_block - 1));
+      }
+   }
 }; // state_history_log
 
 } // namespace eosio
@@ -2,6 +2,7 @@
 #include <appbase/application.hpp>
 
 #include <eosio/chain_plugin/chain_plugin.hpp>
+#include <eosio/state_history_plugin/state_history_table_index.hpp>
 
 template <typename T>
 struct history_serial_big_vector_wrapper {
@@ -98,10 +99,50 @@ struct get_blocks_request_v0 {
    bool                        fetch_deltas           = false;
 };
 
+/// get_blocks_request_v0 with server side filters, an empty filter list does not filter
+struct get_blocks_request_v1 : get_blocks_request_v0 {
+   /// traces: only transactions with an action received by or sent to one of these accounts
+   /// deltas: only contract tables and rows of these contracts, and account and account_metadata rows of these
+   ///         accounts; no other tables
+   std::vector<chain::name> filter_accounts = {};
+   /// deltas: only contract tables and rows of these table names; no other tables besides account and
+   ///         account_metadata
+   std::vector<chain::name> filter_tables = {};
+   /// traces: only transactions with an action of one of these names
+   std::vector<chain::name> filter_actions = {};
+};
+
+/// get_blocks_request_v1 whose results are get_blocks_result_v1
+struct get_blocks_request_v2 : get_blocks_request_v1 {
+   bool decode_rows = false; ///< decode the contract_row rows of the deltas
+};
+
+/// get_blocks_request_v2 whose results are get_blocks_result_v2
+struct get_blocks_request_v3 : get_blocks_request_v2 {
+   /// send traces and deltas compressed as the log stores them, see get_blocks_result_v2; entries that are filtered,
+   /// decoded or compressed with a zstd dictionary are still sent decompressed
+   bool stored_entries = false;
+};
+
 struct get_blocks_ack_request_v0 {
    uint32_t num_messages = 0;
 };
 
+/// blocks with deltas of a contract table, from the optional chain state table index
+struct get_table_blocks_request_v0 {
+   chain::name code            = {};
+   chain::name table           = {};
+   chain::name scope           = {}; ///< empty for every scope
+   uint32_t    start_block_num = 0;
+   uint32_t    end_block_num   = 0;
+};
+
+struct get_table_blocks_result_v0 {
+   uint32_t                               index_begin_block = 0; ///< blocks outside of the index are not covered
+   uint32_t                               index_end_block   = 0;
+   std::vector<state_history_block_range> ranges            = {};
+};
+
 struct get_blocks_result_v0 {
    block_position               head;
    block_position               last_irreversible;
@@ -112,8 +153,33 @@ struct get_blocks_result_v0 {
    fc::optional<bytes>          deltas;
 };
 
-using state_request = fc::static_variant<get_status_request_v0, get_blocks_request_v0, get_blocks_ack_request_v0>;
-using state_result  = fc::static_variant<get_status_result_v0, get_blocks_result_v0>;
+/// a contract_row row of a block's deltas, its value decoded with the contract's abi at the time it is sent
+struct decoded_row {
+   bool        present     = false;
+   chain::name code        = {};
+   chain::name scope       = {};
+   chain::name table       = {};
+   uint64_t    primary_key = 0;
+   chain::name payer       = {};
+   std::string value       = {}; ///< JSON, empty when the abi has no type for the table or the value does not decode
+};
+
+struct get_blocks_result_v1 : get_blocks_result_v0 {
+   std::vector<decoded_row> decoded_rows = {}; ///< in the order of the deltas
+};
+
+/// traces and deltas with a codec are stored log entries: zlib, zstd without a dictionary, or lz4 preceded by the
+/// uint32_t decompressed size; without one they are not compressed
+struct get_blocks_result_v2 : get_blocks_result_v1 {
+   fc::optional<uint8_t> traces_codec = {}; ///< state_history_codec of traces
+   fc::optional<uint8_t> deltas_codec = {}; ///< state_history_codec of deltas
+};
+
+using state_request = fc::static_variant<get_status_request_v0, get_blocks_request_v0, get_blocks_ack_request_v0,
+                                         get_blocks_request_v1, get_table_blocks_request_v0, get_blocks_request_v2,
+                                         get_blocks_request_v3>;
+using state_result  = fc::static_variant<get_status_result_v0, get_blocks_result_v0, get_table_blocks_result_v0,
+                                         get_blocks_result_v1, get_blocks_result_v2>;
 
 class state_history_plugin : public plugin<state_history_plugin> {
  public:
@@ -140,5 +206,13 @@ FC_REFLECT(eosio::block_position, (block_num)(block_id));
 FC_REFLECT_EMPTY(eosio::get_status_request_v0);
 FC_REFLECT(eosio::get_status_result_v0, (head)(last_irreversible)(trace_begin_block)(trace_end_block)(chain_state_begin_block)(chain_state_end_block));
 FC_REFLECT(eosio::get_blocks_request_v0, (start_block_num)(end_block_num)(max_messages_in_flight)(have_positions)(irreversible_only)(fetch_block)(fetch_traces)(fetch_deltas));
+FC_REFLECT_DERIVED(eosio::get_blocks_request_v1, (eosio::get_blocks_request_v0), (filter_accounts)(filter_tables)(filter_actions));
+FC_REFLECT_DERIVED(eosio::get_blocks_request_v2, (eosio::get_blocks_request_v1), (decode_rows));
+FC_REFLECT_DERIVED(eosio::get_blocks_request_v3, (eosio::get_blocks_request_v2), (stored_entries));
 FC_REFLECT(eosio::get_blocks_ack_request_v0, (num_messages));
+FC_REFLECT(eosio::get_table_blocks_request_v0, (code)(table)(scope)(start_block_num)(end_block_num));
+FC_REFLECT(eosio::get_table_blocks_result_v0, (index_begin_block)(index_end_block)(ranges));
+FC_REFLECT(eosio::decoded_row, (present)(code)(scope)(table)(primary_key)(payer)(value));
+FC_REFLECT_DERIVED(eosio::get_blocks_result_v1, (eosio::get_blocks_result_v0), (decoded_rows));
+FC_REFLECT_DERIVED(eosio::get_blocks_result_v2, (eosio::get_blocks_result_v1), (traces_codec)(deltas_codec));
 // clang-format on
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <boost/filesystem.hpp>
+#include <map>
+#include <tuple>
+
+#include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/types.hpp>
+#include <fc/io/cfile.hpp>
+#include <fc/log/logger.hpp>
+
+namespace eosio {
+
+/*
+ *   *.table_index:
+ *   +----------+-------+-------+-----+----------+-------+-----+
+ *   | Marker i | Key 0 | Key 1 | ... | Marker j | Key 0 | ... |
+ *   +----------+-------+-------+-----+----------+-------+-----+
+ *
+ * each record:
+ *    uint32_t block_num, uint64_t code, uint64_t table, uint64_t scope
+ *
+ * Every block written to the chain state log gets a marker (code, table and scope all 0), followed by a record
+ * for each (code, table, scope) with deltas in that block. Records are in block order, so the file is truncated
+ * with the log on a fork.
+ */
+
+struct state_history_table_key {
+   chain::name code;
+   chain::name table;
+   chain::name scope;
+
+   friend bool operator<(const state_history_table_key& a, const state_history_table_key& b) {
+      return std::tie(a.code, a.table, a.scope) < std::tie(b.code, b.table, b.scope);
+   }
+   friend bool operator==(const state_history_table_key& a, const state_history_table_key& b) {
+      return std::tie(a.code, a.table, a.scope) == std::tie(b.code, b.table, b.scope);
+   }
+};
+
+struct state_history_block_range {
+   uint32_t first_block = 0;
+   uint32_t last_block  = 0;
+};
+
+class state_history_table_index {
+ private:
+   static const uint32_t record_size = sizeof(uint32_t) + 3 * sizeof(uint64_t);
+
+   std::string filename;
+   fc::cfile   file;
+   uint32_t    _begin_block = 0;
+   uint32_t    _end_block   = 0;
+   uint64_t    num_records  = 0;
+
+   std::map<state_history_table_key, std::vector<state_history_block_range>> ranges;
+
+ public:
+   /// @param log_end_block the chain state log's end block; an index not ending there is rebuilt from the next block
+   state_history_table_index(std::string filename, uint32_t log_end_block)
+       : filename(std::move(filename)) {
+      open(log_end_block);
+   }
+
+   /// first block indexed, blocks written before the index was enabled are not covered
+   uint32_t begin_block() const { return _begin_block; }
+   uint32_t end_block() const { return _end_block; }
+
+   /// called for every block written to the chain state log, in the same order
+   void add_block(uint32_t block_num, const std::vector<state_history_table_key>& keys) {
+      EOS_ASSERT(_begin_block == _end_block || block_num <= _end_block, chain::plugin_exception,
+                 "missed a block in ${f}", ("f", filename));
+      if (block_num < _end_block)
+         truncate(block_num);
+      file.seek_end(0);
+      write_record(block_num, {});
+      for (auto& key : keys) {
+         write_record(block_num, key);
+         add_range(block_num, key);
+      }
+      if (_begin_block == _end_block)
+         _begin_block = block_num;
+      _end_block = block_num + 1;
+   }
+
+   /// block ranges within [first_block, last_block] with deltas for the table; a scope of 0 matches every scope
+   std::vector<state_history_block_range> get_ranges(chain::name code, chain::name table, chain::name scope,
+                                                     uint32_t first_block, uint32_t last_block) const {
+      std::vector<state_history_block_range> found;
+      auto add = [&](const std::vector<state_history_block_range>& key_ranges) {
+         auto it = std::lower_bound(
+             key_ranges.begin(), key_ranges.end(), first_block,
+             [](const state_history_block_range& r, uint32_t block) { return r.last_block < block; });
+         for (; it != key_ranges.end() && it->first_block <= last_block; ++it)
+            found.push_back({std::max(it->first_block, first_block), std::min(it->last_block, last_block)});
+      };
+      if (scope != chain::name()) {
+         auto it = ranges.find({code, table, scope});
+         if (it != ranges.end())
+            add(it->second);
+         return found;
+      }
+      for (auto it = ranges.lower_bound({code, table, chain::name()});
+           it != ranges.end() && it->first.code == code && it->first.table == table; ++it)
+         add(it->second);
+
+      // merge the scopes' ranges
+      std::sort(found.begin(), found.end(),
+                [](const auto& a, const auto& b) { return a.first_block < b.first_block; });
+      std::vector<state_history_block_range> merged;
+      for (auto& r : found) {
+         if (!merged.empty() && r.first_block <= merged.back().last_block + 1)
+            merged.back().last_block = std::max(merged.back().last_block, r.last_block);
+         else
+            merged.push_back(r);
+      }
+      return merged;
+   }
+
+ private:
+   void write_record(uint32_t block_num, const state_history_table_key& key) {
+      char                  bytes[record_size];
+      fc::datastream<char*> ds(bytes, sizeof(bytes));
+      fc::raw::pack(ds, block_num);
+      fc::raw::pack(ds, key.code.to_uint64_t());
+      fc::raw::pack(ds, key.table.to_uint64_t());
+      fc::raw::pack(ds, key.scope.to_uint64_t());
+      file.write(bytes, sizeof(bytes));
+      ++num_records;
+   }
+
+   uint32_t read_record(uint64_t i, state_history_table_key& key) {
+      char bytes[record_size];
+      file.seek(i * record_size);
+      file.read(bytes, sizeof(bytes));
+      fc::datastream<const char*> ds(bytes, sizeof(bytes));
+      uint32_t                    block_num;
+      uint64_t                    code, table, scope;
+      fc::raw::unpack(ds, block_num);
+      fc::raw::unpack(ds, code);
+      fc::raw::unpack(ds, table);
+      fc::raw::unpack(ds, scope);
+      key = {chain::name(code), chain::name(table), chain::name(scope)};
+      return block_num;
+   }
+
+   void add_range(uint32_t block_num, const state_history_table_key& key) {
+      auto& key_ranges = ranges[key];
+      if (!key_ranges.empty() && key_ranges.back().last_block + 1 >= block_num)
+         key_ranges.back().last_block = block_num;
+      else
+         key_ranges.push_back({block_num, block_num});
+   }
+
+   void open(uint32_t log_end_block) {
+      file.set_file_path(filename);
+      file.open("a+b"); // std::ios_base::binary | std::ios_base::in | std::ios_base::out | std::ios_base::app
+      file.seek_end(0);
+      uint64_t size = file.tellp();
+      num_records   = size / record_size;
+      if (size % record_size) {
+         elog("dropping a partial record from ${f}", ("f", filename));
+         resize(num_records);
+      }
+      for (uint64_t i = 0; i < num_records; ++i) {
+         state_history_table_key key;
+         auto                    block_num = read_record(i, key);
+         if (block_num >= log_end_block) {
+            resize(i);
+            break;
+         }
+         if (key == state_history_table_key{}) {
+            if (_begin_block == _end_block)
+               _begin_block = block_num;
+            _end_block = block_num + 1;
+         } else {
+            add_range(block_num, key);
+         }
+      }
+      if (_begin_block != _end_block && _end_block != log_end_block) {
+         ilog("${f} does not cover the chain state log up to block ${b}, restarting it",
+              ("f", filename)("b", log_end_block));
+         resize(0);
+         ranges.clear();
+         _begin_block = _end_block = 0;
+      }
+      if (_begin_block != _end_block)
+         ilog("${f} covers blocks ${b}-${e}", ("f", filename)("b", _begin_block)("e", _end_block - 1));
+   }
+
+   void resize(uint64_t records) {
+      file.flush();
+      boost::filesystem::resize_file(filename, records * record_size);
+      file.seek_end(0);
+      num_records = records;
+   }
+
+   /// remove block_num and the blocks after it
+   void truncate(uint32_t block_num) {
+      file.flush();
+      // records are in block order, find the first one of block_num
+      uint64_t                low = 0, high = num_records;
+      state_history_table_key key;
+      while (low < high) {
+         auto mid = low + (high - low) / 2;
+         if (read_record(mid, key) < block_num)
+            low = mid + 1;
+         else
+            high = mid;
+      }
+      // only the keys of the removed records have ranges to trim
+      for (uint64_t i = low; i < num_records; ++i) {
+         read_record(i, key);
+         auto it = ranges.find(key);
+         if (it == ranges.end())
+            continue;
+         auto& key_ranges = it->second;
+         while (!key_ranges.empty() && key_ranges.back().first_block >= block_num)
+            key_ranges.pop_back();
+         if (!key_ranges.empty() && key_ranges.back().last_block >= block_num)
+            key_ranges.back().last_block = block_num - 1;
+         if (key_ranges.empty())
+            ranges.erase(it);
+      }
+      resize(low);
+      if (block_num <= _begin_block)
+         _begin_block = _end_block = 0;
+      else
+         _end_block = block_num;
+   }
+};
+
+} // namespace eosio
+
+FC_REFLECT(eosio::state_history_block_range, (first_block)(last_block))
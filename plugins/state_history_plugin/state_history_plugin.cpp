@@ -1,7 +1,13 @@
+#include <eosio/chain/abi_serializer_cache.hpp>
 #include <eosio/chain/config.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <eosio/state_history_plugin/state_history_log.hpp>
 #include <eosio/state_history_plugin/state_history_serialization.hpp>
 
+#include <fc/io/fstream.hpp>
+#include <fc/io/json.hpp>
+#include <fc/scoped_exit.hpp>
+
 #include <boost/asio/bind_executor.hpp>
 #include <boost/asio/ip/host_name.hpp>
 #include <boost/asio/ip/tcp.hpp>
@@ -13,6 +19,19 @@
 #include <boost/iostreams/filtering_stream.hpp>
 #include <boost/signals2/connection.hpp>
 
+#ifdef EOSIO_SHIP_ZSTD_ENABLED
+#include <zstd.h>
+#endif
+#ifdef EOSIO_SHIP_LZ4_ENABLED
+#include <lz4.h>
+#endif
+
+#include <atomic>
+#include <deque>
+#include <future>
+#include <limits>
+#include <mutex>
+
 using tcp    = boost::asio::ip::tcp;
 namespace ws = boost::beast::websocket;
 
@@ -38,7 +57,7 @@ auto catch_and_log(F f) {
 }
 
 namespace bio = boost::iostreams;
-static bytes zlib_compress_bytes(bytes in) {
+static bytes zlib_compress_bytes(const bytes& in) {
    bytes                  out;
    bio::filtering_ostream comp;
    comp.push(bio::zlib_compressor(bio::zlib::default_compression));
@@ -58,6 +77,119 @@ static bytes zlib_decompress(const bytes& in) {
    return out;
 }
 
+/// compression of the entries of one log; entries are decompressed with the codec they were written with
+struct log_compression {
+   state_history_codec codec = state_history_codec::zlib;
+   int                 level = 0; // 0 for the codec's default
+#ifdef EOSIO_SHIP_ZSTD_ENABLED
+   std::shared_ptr<ZSTD_CDict> zstd_cdict;
+   std::shared_ptr<ZSTD_DDict> zstd_ddict;
+#endif
+
+   static state_history_codec parse_codec(const std::string& name) {
+      if (name == "zlib")
+         return state_history_codec::zlib;
+#ifdef EOSIO_SHIP_ZSTD_ENABLED
+      if (name == "zstd")
+         return state_history_codec::zstd;
+#endif
+#ifdef EOSIO_SHIP_LZ4_ENABLED
+      if (name == "lz4")
+         return state_history_codec::lz4;
+#endif
+      EOS_THROW(plugin_config_exception, "unsupported state history compression ${c}", ("c", name));
+   }
+
+#ifdef EOSIO_SHIP_ZSTD_ENABLED
+   int zstd_level() const { return level ? level : 3; }
+#endif
+
+   void load_zstd_dictionary(const bfs::path& path) {
+#ifdef EOSIO_SHIP_ZSTD_ENABLED
+      std::string dict;
+      fc::read_file_contents(path, dict);
+      EOS_ASSERT(!dict.empty(), plugin_config_exception, "empty zstd dictionary ${p}", ("p", path.generic_string()));
+      zstd_cdict.reset(ZSTD_createCDict(dict.data(), dict.size(), zstd_level()), ZSTD_freeCDict);
+      zstd_ddict.reset(ZSTD_createDDict(dict.data(), dict.size()), ZSTD_freeDDict);
+      EOS_ASSERT(zstd_cdict && zstd_ddict, plugin_config_exception, "invalid zstd dictionary ${p}",
+                 ("p", path.generic_string()));
+#else
+      EOS_THROW(plugin_config_exception, "state history was built without zstd");
+#endif
+   }
+
+   bytes compress(const bytes& in) const {
+      switch (codec) {
+#ifdef EOSIO_SHIP_ZSTD_ENABLED
+         case state_history_codec::zstd: {
+            bytes                                      out(ZSTD_compressBound(in.size()));
+            std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)> ctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+            size_t size = zstd_cdict
+                ? ZSTD_compress_usingCDict(ctx.get(), out.data(), out.size(), in.data(), in.size(), zstd_cdict.get())
+                : ZSTD_compressCCtx(ctx.get(), out.data(), out.size(), in.data(), in.size(),
+                                    zstd_level());
+            EOS_ASSERT(!ZSTD_isError(size), plugin_exception, "zstd compression failed: ${e}",
+                       ("e", ZSTD_getErrorName(size)));
+            out.resize(size);
+            return out;
+         }
+#endif
+#ifdef EOSIO_SHIP_LZ4_ENABLED
+         case state_history_codec::lz4: {
+            // lz4 blocks do not record their decompressed size, so it precedes the block
+            EOS_ASSERT(in.size() <= LZ4_MAX_INPUT_SIZE, plugin_exception, "entry is too big for lz4");
+            uint32_t raw_size = in.size();
+            bytes    out(sizeof(raw_size) + LZ4_compressBound(raw_size));
+            memcpy(out.data(), &raw_size, sizeof(raw_size));
+            int size = LZ4_compress_default(in.data(), out.data() + sizeof(raw_size), raw_size,
+                                            out.size() - sizeof(raw_size));
+            EOS_ASSERT(size > 0 || raw_size == 0, plugin_exception, "lz4 compression failed");
+            out.resize(sizeof(raw_size) + size);
+            return out;
+         }
+#endif
+         default:
+            return zlib_compress_bytes(in);
+      }
+   }
+
+   bytes decompress(state_history_codec entry_codec, const bytes& in) const {
+      switch (entry_codec) {
+         case state_history_codec::zlib:
+            return zlib_decompress(in);
+#ifdef EOSIO_SHIP_ZSTD_ENABLED
+         case state_history_codec::zstd: {
+            auto raw_size = ZSTD_getFrameContentSize(in.data(), in.size());
+            EOS_ASSERT(raw_size != ZSTD_CONTENTSIZE_ERROR && raw_size != ZSTD_CONTENTSIZE_UNKNOWN, plugin_exception,
+                       "corrupt zstd entry");
+            bytes                                      out(raw_size);
+            std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx*)> ctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+            size_t size = zstd_ddict
+                ? ZSTD_decompress_usingDDict(ctx.get(), out.data(), out.size(), in.data(), in.size(), zstd_ddict.get())
+                : ZSTD_decompressDCtx(ctx.get(), out.data(), out.size(), in.data(), in.size());
+            EOS_ASSERT(!ZSTD_isError(size) && size == raw_size, plugin_exception, "zstd decompression failed: ${e}",
+                       ("e", ZSTD_isError(size) ? ZSTD_getErrorName(size) : "size mismatch"));
+            return out;
+         }
+#endif
+#ifdef EOSIO_SHIP_LZ4_ENABLED
+         case state_history_codec::lz4: {
+            uint32_t raw_size = 0;
+            EOS_ASSERT(in.size() >= sizeof(raw_size), plugin_exception, "corrupt lz4 entry");
+            memcpy(&raw_size, in.data(), sizeof(raw_size));
+            bytes out(raw_size);
+            int   size = LZ4_decompress_safe(in.data() + sizeof(raw_size), out.data(), in.size() - sizeof(raw_size),
+                                             raw_size);
+            EOS_ASSERT(size >= 0 && (uint32_t)size == raw_size, plugin_exception, "corrupt lz4 entry");
+            return out;
+         }
+#endif
+         default:
+            EOS_THROW(plugin_exception, "unsupported state history codec ${c}", ("c", (uint32_t)entry_codec));
+      }
+   }
+};
+
 template <typename T>
 bool include_delta(const T& old, const T& curr) {
    return true;
@@ -110,69 +242,393 @@ bool include_delta(const eosio::chain::protocol_state_object& old, const eosio::
    return old.activated_protocol_features != curr.activated_protocol_features;
 }
 
+static bool is_contract_table(const std::string& table) { return table.compare(0, 9, "contract_") == 0; }
+
+/// contract_table rows and the contract rows and indices all start with struct version, code, scope and table
+static state_history_table_key contract_row_key(const bytes& row) {
+   fc::datastream<const char*> ds(row.data(), row.size());
+   fc::unsigned_int            version;
+   state_history_table_key     key;
+   fc::raw::unpack(ds, version);
+   fc::raw::unpack(ds, key.code);
+   fc::raw::unpack(ds, key.scope);
+   fc::raw::unpack(ds, key.table);
+   return key;
+}
+
+/// server side filter of a get_blocks_request_v1
+struct block_filter {
+   flat_set<name> accounts;
+   flat_set<name> tables;
+   flat_set<name> actions;
+
+   explicit block_filter(const get_blocks_request_v1& req)
+       : accounts(req.filter_accounts.begin(), req.filter_accounts.end())
+       , tables(req.filter_tables.begin(), req.filter_tables.end())
+       , actions(req.filter_actions.begin(), req.filter_actions.end()) {}
+
+   bool filters_traces() const { return !accounts.empty() || !actions.empty(); }
+   bool filters_deltas() const { return !accounts.empty() || !tables.empty(); }
+
+   static name get_name(const fc::variant& v) { return name(v.as_string()); }
+
+   bool include_trace(const fc::variant& trace) const {
+      // each trace and action trace is a variant: [type, value]
+      for (auto& at : trace.get_array().at(1)["action_traces"].get_array()) {
+         auto& action_trace = at.get_array().at(1);
+         auto& act          = action_trace["act"];
+         if (!accounts.empty() && !accounts.count(get_name(action_trace["receiver"])) &&
+             !accounts.count(get_name(act["account"])))
+            continue;
+         if (!actions.empty() && !actions.count(get_name(act["name"])))
+            continue;
+         return true;
+      }
+      return false;
+   }
+
+   /// traces are only inspected here, so they go through the state history abi rather than a parser of their own
+   bytes filter_traces(const abi_serializer& abi, const bytes& traces, const fc::microseconds& max_time) const {
+      auto         all = abi.binary_to_variant("transaction_trace[]", traces, max_time);
+      fc::variants included;
+      for (auto& trace : all.get_array()) {
+         if (include_trace(trace))
+            included.push_back(trace);
+      }
+      return abi.variant_to_binary("transaction_trace[]", fc::variant(std::move(included)), max_time);
+   }
+
+   bool include_row(const std::string& table, const bytes& row) const {
+      if (table == "account" || table == "account_metadata") {
+         // both start with their struct version and the account name
+         fc::datastream<const char*> ds(row.data(), row.size());
+         fc::unsigned_int            version;
+         name                        account;
+         fc::raw::unpack(ds, version);
+         fc::raw::unpack(ds, account);
+         return accounts.empty() || accounts.count(account);
+      }
+      if (!is_contract_table(table))
+         return false;
+      auto key = contract_row_key(row);
+      return (accounts.empty() || accounts.count(key.code)) && (tables.empty() || tables.count(key.table));
+   }
+
+   bytes filter_deltas(const bytes& deltas) const {
+      fc::datastream<const char*> ds(deltas.data(), deltas.size());
+      fc::unsigned_int            num_deltas;
+      fc::raw::unpack(ds, num_deltas);
+      std::vector<table_delta> included;
+      for (uint32_t i = 0; i < num_deltas.value; ++i) {
+         table_delta      delta;
+         fc::unsigned_int num_rows;
+         fc::raw::unpack(ds, delta.struct_version);
+         fc::raw::unpack(ds, delta.name);
+         fc::raw::unpack(ds, num_rows);
+         for (uint32_t j = 0; j < num_rows.value; ++j) {
+            std::pair<bool, bytes> row;
+            fc::raw::unpack(ds, row.first);
+            fc::raw::unpack(ds, row.second);
+            if (include_row(delta.name, row.second))
+               delta.rows.obj.push_back(std::move(row));
+         }
+         if (!delta.rows.obj.empty())
+            included.push_back(std::move(delta));
+      }
+      return fc::raw::pack(included);
+   }
+};
+
 struct state_history_plugin_impl : std::enable_shared_from_this<state_history_plugin_impl> {
+   /// log entry whose payload is still being packed and compressed on the thread pool
+   struct pending_entry {
+      state_history_log*       log = nullptr;
+      state_history_codec      codec = state_history_codec::zlib;
+      uint32_t                 block_num = 0;
+      block_id_type            block_id;
+      block_id_type            previous;
+      std::future<bytes>       payload;
+      /// tables with deltas in a chain state entry, for the table index
+      std::vector<state_history_table_key> table_keys;
+   };
+
+   /// a block's parts as sent to sessions, each loaded on first use; an empty optional has not been loaded yet
+   struct cached_block {
+      block_id_type                     block_id;
+      fc::optional<fc::optional<bytes>> block;
+      fc::optional<fc::optional<bytes>> traces;
+      fc::optional<fc::optional<bytes>> deltas;
+   };
+
    chain_plugin*                                              chain_plug = nullptr;
    fc::optional<state_history_log>                            trace_log;
    fc::optional<state_history_log>                            chain_state_log;
+   fc::optional<state_history_table_index>                    chain_state_table_index;
    bool                                                       trace_debug_mode = false;
-   bool                                                       stopping = false;
+   bool                                                       initial_state = false;
+   uint32_t                                                   initial_state_chunk_rows = 10000;
+   std::atomic<bool>                                          stopping{false};
    fc::optional<scoped_connection>                            applied_transaction_connection;
    fc::optional<scoped_connection>                            accepted_block_connection;
    string                                                     endpoint_address = "0.0.0.0";
    uint16_t                                                   endpoint_port    = 8080;
    std::unique_ptr<tcp::acceptor>                             acceptor;
+   log_compression                                            trace_compression;
+   log_compression                                            chain_state_compression;
    std::map<transaction_id_type, augmented_transaction_trace> cached_traces;
    fc::optional<augmented_transaction_trace>                  onblock_trace;
+   uint16_t                                                   thread_pool_size = 2;
+   fc::optional<named_thread_pool>                            thread_pool;
+   std::deque<pending_entry>                                  pending_entries; // main thread only, in block order
+   fc::optional<abi_serializer>                               ship_abi; // for filtering traces
+   fc::microseconds                                           abi_serializer_max_time;
+   uint16_t                                                   session_thread_pool_size = 2;
+   fc::optional<named_thread_pool>                            session_thread_pool; // acceptor and session I/O
+
+   // shared by the main thread and the session threads, guarded by mtx
+   std::mutex                                                 mtx;
+   block_position                                             head;
+   block_position                                             last_irreversible;
+   uint32_t                                                   first_pending_block = ~uint32_t(0);
+   uint32_t                                                   block_cache_size = 32;
+   std::map<uint32_t, cached_block>                           block_cache; // the most recent blocks sent
+   std::map<uint32_t, signed_block_ptr>                       recent_blocks; // the most recent blocks accepted
+
+   /// run @ref f on the main thread and wait for it; returns nothing if the plugin stops first
+   template <typename F>
+   auto on_main_thread(F&& f) -> fc::optional<decltype(f())> {
+      auto task = std::make_shared<std::packaged_task<decltype(f())()>>(std::forward<F>(f));
+      auto result = task->get_future();
+      app().post(priority::medium, [task]() { (*task)(); });
+      while (result.wait_for(std::chrono::milliseconds(10)) != std::future_status::ready) {
+         if (stopping)
+            return {};
+      }
+      return result.get();
+   }
 
-   void get_log_entry(state_history_log& log, uint32_t block_num, fc::optional<bytes>& result) {
+   /// @return false if the log does not have block_num
+   bool read_log_entry(state_history_log& log, uint32_t block_num, state_history_codec& codec, bytes& compressed) {
+      std::lock_guard<std::mutex> g(mtx);
       if (block_num < log.begin_block() || block_num >= log.end_block())
-         return;
+         return false;
       state_history_log_header header;
       auto&                    stream = log.get_entry(block_num, header);
-      uint32_t                 s;
+      codec                           = state_history_codec::zlib;
+      if (get_ship_version(header.magic) >= 1)
+         stream.read((char*)&codec, sizeof(codec));
+      uint32_t s;
       stream.read((char*)&s, sizeof(s));
-      bytes compressed(s);
+      compressed.resize(s);
       if (s)
          stream.read(compressed.data(), s);
-      result = zlib_decompress(compressed);
+      return true;
+   }
+
+   /// read under the lock, decompress outside of it
+   void get_log_entry(state_history_log& log, const log_compression& compression, uint32_t block_num,
+                      fc::optional<bytes>& result) {
+      auto  codec = state_history_codec::zlib;
+      bytes compressed;
+      if (read_log_entry(log, block_num, codec, compressed))
+         result = compression.decompress(codec, compressed);
+   }
+
+   /// the entry as the log stores it, for clients catching up that decompress it themselves; an entry compressed
+   /// with a zstd dictionary, which clients do not have, is decompressed and result_codec left empty
+   void get_stored_log_entry(state_history_log& log, const log_compression& compression, uint32_t block_num,
+                             fc::optional<bytes>& result, fc::optional<uint8_t>& result_codec) {
+      auto  codec = state_history_codec::zlib;
+      bytes compressed;
+      if (!read_log_entry(log, block_num, codec, compressed))
+         return;
+#ifdef EOSIO_SHIP_ZSTD_ENABLED
+      if (codec == state_history_codec::zstd && compression.zstd_ddict)
+         return void(result = compression.decompress(codec, compressed));
+#endif
+      result_codec = static_cast<uint8_t>(codec);
+      result       = std::move(compressed);
    }
 
    void get_block(uint32_t block_num, fc::optional<bytes>& result) {
       chain::signed_block_ptr p;
-      try {
-         p = chain_plug->chain().fetch_block_by_number(block_num);
-      } catch (...) {
-         return;
+      {
+         std::lock_guard<std::mutex> g(mtx);
+         auto it = recent_blocks.find(block_num);
+         if (it != recent_blocks.end())
+            p = it->second;
+      }
+      if (!p) {
+         auto fetched = on_main_thread([this, block_num]() -> chain::signed_block_ptr {
+            try {
+               return chain_plug->chain().fetch_block_by_number(block_num);
+            } catch (...) {
+               return {};
+            }
+         });
+         if (fetched)
+            p = *fetched;
       }
       if (p)
          result = fc::raw::pack(*p);
    }
 
+   /// get a part of a block for a session; blocks near head are read, decompressed and packed once for every
+   /// session following head instead of once per session
+   template <typename F>
+   void get_shared(uint32_t block_num, const block_id_type& block_id,
+                   fc::optional<fc::optional<bytes>> cached_block::*part, fc::optional<bytes>& result, F&& load) {
+      bool shared;
+      {
+         std::lock_guard<std::mutex> g(mtx);
+         shared = block_num + block_cache_size > head.block_num;
+      }
+      if (!shared)
+         return load(result);
+      {
+         std::lock_guard<std::mutex> g(mtx);
+         auto& cached = block_cache[block_num];
+         if (cached.block_id != block_id)
+            cached = cached_block{block_id};
+         if (cached.*part) {
+            result = *(cached.*part);
+            return;
+         }
+      }
+      // sessions missing the same part at once may each load it, which is cheaper than loading under the lock
+      load(result);
+      std::lock_guard<std::mutex> g(mtx);
+      auto& cached = block_cache[block_num];
+      if (cached.block_id != block_id)
+         cached = cached_block{block_id};
+      cached.*part = result;
+      while (block_cache.size() > block_cache_size)
+         block_cache.erase(block_cache.begin());
+   }
+
    fc::optional<chain::block_id_type> get_block_id(uint32_t block_num) {
-      if (trace_log && block_num >= trace_log->begin_block() && block_num < trace_log->end_block())
-         return trace_log->get_block_id(block_num);
-      if (chain_state_log && block_num >= chain_state_log->begin_block() && block_num < chain_state_log->end_block())
-         return chain_state_log->get_block_id(block_num);
-      try {
-         auto block = chain_plug->chain().fetch_block_by_number(block_num);
-         if (block)
-            return block->id();
-      } catch (...) {
+      {
+         std::lock_guard<std::mutex> g(mtx);
+         if (trace_log && block_num >= trace_log->begin_block() && block_num < trace_log->end_block())
+            return trace_log->get_block_id(block_num);
+         if (chain_state_log && block_num >= chain_state_log->begin_block() &&
+             block_num < chain_state_log->end_block())
+            return chain_state_log->get_block_id(block_num);
+         auto it = recent_blocks.find(block_num);
+         if (it != recent_blocks.end())
+            return it->second->id();
       }
+      auto id = on_main_thread([this, block_num]() -> fc::optional<chain::block_id_type> {
+         try {
+            auto block = chain_plug->chain().fetch_block_by_number(block_num);
+            if (block)
+               return block->id();
+         } catch (...) {
+         }
+         return {};
+      });
+      if (id)
+         return *id;
       return {};
    }
 
+   /// updated by the main thread as blocks are accepted and their log entries written
+   /// decode the contract_row rows of @ref deltas with the abis of abi_serializer_cache, which the API plugins share;
+   /// called on a session thread, only the lookup of the abis runs on the main thread
+   std::vector<decoded_row> decode_contract_rows(const bytes& deltas) {
+      std::vector<decoded_row>    rows;
+      std::vector<bytes>          values;
+      fc::datastream<const char*> ds(deltas.data(), deltas.size());
+      fc::unsigned_int            num_deltas;
+      fc::raw::unpack(ds, num_deltas);
+      for (uint32_t i = 0; i < num_deltas.value; ++i) {
+         fc::unsigned_int struct_version, num_rows;
+         std::string      table_name;
+         fc::raw::unpack(ds, struct_version);
+         fc::raw::unpack(ds, table_name);
+         fc::raw::unpack(ds, num_rows);
+         for (uint32_t j = 0; j < num_rows.value; ++j) {
+            decoded_row row;
+            bytes       data;
+            fc::raw::unpack(ds, row.present);
+            fc::raw::unpack(ds, data);
+            if (table_name != "contract_row")
+               continue;
+            fc::datastream<const char*> rds(data.data(), data.size());
+            fc::unsigned_int            version;
+            bytes                       value;
+            fc::raw::unpack(rds, version);
+            fc::raw::unpack(rds, row.code);
+            fc::raw::unpack(rds, row.scope);
+            fc::raw::unpack(rds, row.table);
+            fc::raw::unpack(rds, row.primary_key);
+            fc::raw::unpack(rds, row.payer);
+            fc::raw::unpack(rds, value);
+            rows.push_back(std::move(row));
+            values.push_back(std::move(value));
+         }
+      }
+      if (rows.empty())
+         return rows;
+
+      flat_set<name> codes;
+      for (auto& row : rows)
+         codes.insert(row.code);
+      auto abis = on_main_thread([&]() {
+         std::map<name, abi_serializer_cache::cached_abi_ptr> result;
+         for (auto code : codes) {
+            try {
+               result[code] = abi_serializer_cache::get(chain_plug->chain().db(), code, abi_serializer_max_time);
+            } catch (const fc::exception&) {
+               // an abi that does not load decodes nothing
+            }
+         }
+         return result;
+      });
+      if (!abis)
+         return {};
+      for (size_t i = 0; i < rows.size(); ++i) {
+         auto& abi = (*abis)[rows[i].code];
+         if (!abi)
+            continue;
+         auto type = abi->serializer.get_table_type(rows[i].table);
+         if (type.empty())
+            continue;
+         try {
+            abi->serializer.binary_to_json(type, values[i], rows[i].value, abi_serializer_max_time);
+         } catch (const fc::exception&) {
+            rows[i].value.clear();
+         }
+      }
+      return rows;
+   }
+
+   void update_head() {
+      auto&                       chain = chain_plug->chain();
+      std::lock_guard<std::mutex> g(mtx);
+      head              = {chain.head_block_num(), chain.head_block_id()};
+      last_irreversible = {chain.last_irreversible_block_num(), chain.last_irreversible_block_id()};
+      first_pending_block =
+          pending_entries.empty() ? std::numeric_limits<uint32_t>::max() : pending_entries.front().block_num;
+   }
+
+   /// all members are only accessed through strand
    struct session : std::enable_shared_from_this<session> {
       std::shared_ptr<state_history_plugin_impl> plugin;
+      boost::asio::io_context::strand            strand;
       std::unique_ptr<ws::stream<tcp::socket>>   socket_stream;
       bool                                       sending  = false;
       bool                                       sent_abi = false;
       std::vector<std::vector<char>>             send_queue;
       fc::optional<get_blocks_request_v0>        current_request;
+      fc::optional<block_filter>                 filter;
+      bool                                       decode_rows = false;
+      bool                                       stored_entries = false;
       bool                                       need_to_send_update = false;
 
-      session(std::shared_ptr<state_history_plugin_impl> plugin)
-          : plugin(std::move(plugin)) {}
+      session(std::shared_ptr<state_history_plugin_impl> plugin, boost::asio::io_context& ioc)
+          : plugin(std::move(plugin))
+          , strand(ioc) {}
 
       void start(tcp::socket socket) {
          ilog("incoming connection");
@@ -181,18 +637,20 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
          socket_stream->next_layer().set_option(boost::asio::ip::tcp::no_delay(true));
          socket_stream->next_layer().set_option(boost::asio::socket_base::send_buffer_size(1024 * 1024));
          socket_stream->next_layer().set_option(boost::asio::socket_base::receive_buffer_size(1024 * 1024));
-         socket_stream->async_accept([self = shared_from_this()](boost::system::error_code ec) {
-            self->callback(ec, "async_accept", [self] {
-               self->start_read();
-               self->send(state_history_plugin_abi);
-            });
-         });
+         socket_stream->async_accept(
+             boost::asio::bind_executor(strand, [self = shared_from_this()](boost::system::error_code ec) {
+                self->callback(ec, "async_accept", [self] {
+                   self->start_read();
+                   self->send(state_history_plugin_abi);
+                });
+             }));
       }
 
       void start_read() {
          auto in_buffer = std::make_shared<boost::beast::flat_buffer>();
          socket_stream->async_read(
-             *in_buffer, [self = shared_from_this(), in_buffer](boost::system::error_code ec, size_t) {
+             *in_buffer, boost::asio::bind_executor(strand, [self = shared_from_this(), in_buffer](
+                                                               boost::system::error_code ec, size_t) {
                 self->callback(ec, "async_read", [self, in_buffer] {
                    auto d = boost::asio::buffer_cast<char const*>(boost::beast::buffers_front(in_buffer->data()));
                    auto s = boost::asio::buffer_size(in_buffer->data());
@@ -202,7 +660,7 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
                    req.visit(*self);
                    self->start_read();
                 });
-             });
+             }));
       }
 
       void send(const char* s) {
@@ -226,28 +684,30 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
          sent_abi = true;
          socket_stream->async_write( //
              boost::asio::buffer(send_queue[0]),
-             [self = shared_from_this()](boost::system::error_code ec, size_t) {
+             boost::asio::bind_executor(strand, [self = shared_from_this()](boost::system::error_code ec, size_t) {
                 self->callback(ec, "async_write", [self] {
                    self->send_queue.erase(self->send_queue.begin());
                    self->sending = false;
                    self->send();
                 });
-             });
+             }));
       }
 
       using result_type = void;
       void operator()(get_status_request_v0&) {
-         auto&                chain = plugin->chain_plug->chain();
          get_status_result_v0 result;
-         result.head              = {chain.head_block_num(), chain.head_block_id()};
-         result.last_irreversible = {chain.last_irreversible_block_num(), chain.last_irreversible_block_id()};
-         if (plugin->trace_log) {
-            result.trace_begin_block = plugin->trace_log->begin_block();
-            result.trace_end_block   = plugin->trace_log->end_block();
-         }
-         if (plugin->chain_state_log) {
-            result.chain_state_begin_block = plugin->chain_state_log->begin_block();
-            result.chain_state_end_block   = plugin->chain_state_log->end_block();
+         {
+            std::lock_guard<std::mutex> g(plugin->mtx);
+            result.head              = plugin->head;
+            result.last_irreversible = plugin->last_irreversible;
+            if (plugin->trace_log) {
+               result.trace_begin_block = plugin->trace_log->begin_block();
+               result.trace_end_block   = plugin->trace_log->end_block();
+            }
+            if (plugin->chain_state_log) {
+               result.chain_state_begin_block = plugin->chain_state_log->begin_block();
+               result.chain_state_end_block   = plugin->chain_state_log->end_block();
+            }
          }
          send(std::move(result));
       }
@@ -262,9 +722,50 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
          }
          req.have_positions.clear();
          current_request = req;
+         filter.reset();
+         decode_rows    = false;
+         stored_entries = false;
          send_update(true);
       }
 
+      void operator()(get_blocks_request_v1& req) {
+         (*this)(static_cast<get_blocks_request_v0&>(req));
+         if (!current_request)
+            return;
+         block_filter f(req);
+         if (f.filters_traces() || f.filters_deltas())
+            filter.emplace(std::move(f));
+      }
+
+      void operator()(get_blocks_request_v2& req) {
+         (*this)(static_cast<get_blocks_request_v1&>(req));
+         if (current_request)
+            decode_rows = req.decode_rows;
+      }
+
+      void operator()(get_blocks_request_v3& req) {
+         (*this)(static_cast<get_blocks_request_v2&>(req));
+         if (current_request)
+            stored_entries = req.stored_entries;
+      }
+
+      void operator()(get_table_blocks_request_v0& req) {
+         get_table_blocks_result_v0 result;
+         {
+            std::lock_guard<std::mutex> g(plugin->mtx);
+            auto& index = plugin->chain_state_table_index;
+            if (index && req.start_block_num < req.end_block_num) {
+               // blocks removed from the log by retention stay in the index
+               auto log_begin           = plugin->chain_state_log->begin_block();
+               result.index_begin_block = std::max(index->begin_block(), log_begin);
+               result.index_end_block   = index->end_block();
+               result.ranges = index->get_ranges(req.code, req.table, req.scope,
+                                                 std::max(req.start_block_num, log_begin), req.end_block_num - 1);
+            }
+         }
+         send(std::move(result));
+      }
+
       void operator()(get_blocks_ack_request_v0& req) {
          if (!current_request)
             return;
@@ -278,12 +779,17 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
          if (!send_queue.empty() || !need_to_send_update || !current_request ||
              !current_request->max_messages_in_flight)
             return;
-         auto&                chain = plugin->chain_plug->chain();
-         get_blocks_result_v0 result;
-         result.head              = {chain.head_block_num(), chain.head_block_id()};
-         result.last_irreversible = {chain.last_irreversible_block_num(), chain.last_irreversible_block_id()};
-         uint32_t current =
-             current_request->irreversible_only ? result.last_irreversible.block_num : result.head.block_num;
+         get_blocks_result_v0  result;
+         fc::optional<uint8_t> traces_codec, deltas_codec;
+         uint32_t              current;
+         {
+            std::lock_guard<std::mutex> g(plugin->mtx);
+            result.head              = plugin->head;
+            result.last_irreversible = plugin->last_irreversible;
+            current = current_request->irreversible_only ? result.last_irreversible.block_num : result.head.block_num;
+            // blocks whose log entries are still being serialized are sent once they have been written
+            current = std::min(current, plugin->first_pending_block - 1);
+         }
          if (current_request->start_block_num <= current &&
              current_request->start_block_num < current_request->end_block_num) {
             auto block_id = plugin->get_block_id(current_request->start_block_num);
@@ -292,21 +798,63 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
                auto prev_block_id = plugin->get_block_id(current_request->start_block_num - 1);
                if (prev_block_id)
                   result.prev_block = block_position{current_request->start_block_num - 1, *prev_block_id};
+               auto  block_num = current_request->start_block_num;
+               auto& p         = *plugin;
                if (current_request->fetch_block)
-                  plugin->get_block(current_request->start_block_num, result.block);
-               if (current_request->fetch_traces && plugin->trace_log)
-                  plugin->get_log_entry(*plugin->trace_log, current_request->start_block_num, result.traces);
-               if (current_request->fetch_deltas && plugin->chain_state_log)
-                  plugin->get_log_entry(*plugin->chain_state_log, current_request->start_block_num, result.deltas);
+                  p.get_shared(block_num, *block_id, &cached_block::block, result.block,
+                               [&](auto& r) { p.get_block(block_num, r); });
+               // stored entries skip decompression and the block cache, which holds decompressed entries
+               const bool stored_traces = stored_entries && !(filter && filter->filters_traces());
+               const bool stored_deltas = stored_entries && !(filter && filter->filters_deltas()) && !decode_rows;
+               if (current_request->fetch_traces && p.trace_log && stored_traces)
+                  p.get_stored_log_entry(*p.trace_log, p.trace_compression, block_num, result.traces, traces_codec);
+               else if (current_request->fetch_traces && p.trace_log)
+                  p.get_shared(block_num, *block_id, &cached_block::traces, result.traces, [&](auto& r) {
+                     p.get_log_entry(*p.trace_log, p.trace_compression, block_num, r);
+                  });
+               if (current_request->fetch_deltas && p.chain_state_log && stored_deltas)
+                  p.get_stored_log_entry(*p.chain_state_log, p.chain_state_compression, block_num, result.deltas,
+                                         deltas_codec);
+               else if (current_request->fetch_deltas && p.chain_state_log)
+                  p.get_shared(block_num, *block_id, &cached_block::deltas, result.deltas, [&](auto& r) {
+                     p.get_log_entry(*p.chain_state_log, p.chain_state_compression, block_num, r);
+                  });
+               if (filter && filter->filters_traces() && result.traces)
+                  result.traces = filter->filter_traces(*p.ship_abi, *result.traces, p.abi_serializer_max_time);
+               if (filter && filter->filters_deltas() && result.deltas)
+                  result.deltas = filter->filter_deltas(*result.deltas);
             }
             ++current_request->start_block_num;
          }
-         send(std::move(result));
+         if (stored_entries) {
+            get_blocks_result_v2 stored;
+            static_cast<get_blocks_result_v0&>(stored) = std::move(result);
+            if (decode_rows && stored.deltas)
+               stored.decoded_rows = plugin->decode_contract_rows(*stored.deltas);
+            stored.traces_codec = traces_codec;
+            stored.deltas_codec = deltas_codec;
+            send(std::move(stored));
+         } else if (decode_rows) {
+            get_blocks_result_v1 decoded;
+            static_cast<get_blocks_result_v0&>(decoded) = std::move(result);
+            if (decoded.deltas)
+               decoded.decoded_rows = plugin->decode_contract_rows(*decoded.deltas);
+            send(std::move(decoded));
+         } else {
+            send(std::move(result));
+         }
          --current_request->max_messages_in_flight;
          need_to_send_update = current_request->start_block_num <= current &&
                                current_request->start_block_num < current_request->end_block_num;
       }
 
+      /// a block was accepted or log entries were written
+      void on_update(uint32_t block_num) {
+         if (current_request && block_num < current_request->start_block_num)
+            current_request->start_block_num = block_num;
+         send_update(true);
+      }
+
       template <typename F>
       void catch_and_close(F f) {
          try {
@@ -325,13 +873,11 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
 
       template <typename F>
       void callback(boost::system::error_code ec, const char* what, F f) {
-         app().post( priority::medium, [=]() {
-            if( plugin->stopping )
-               return;
-            if( ec )
-               return on_fail( ec, what );
-            catch_and_close( f );
-         } );
+         if( plugin->stopping )
+            return;
+         if( ec )
+            return on_fail( ec, what );
+         catch_and_close( f );
       }
 
       void on_fail(boost::system::error_code ec, const char* what) {
@@ -344,18 +890,21 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
       }
 
       void close() {
-         socket_stream->next_layer().close();
+         if (socket_stream)
+            socket_stream->next_layer().close();
+         std::lock_guard<std::mutex> g(plugin->sessions_mtx);
          plugin->sessions.erase(this);
       }
    };
-   std::map<session*, std::shared_ptr<session>> sessions;
+   std::mutex                                   sessions_mtx;
+   std::map<session*, std::shared_ptr<session>> sessions; // guarded by sessions_mtx
 
    void listen() {
       boost::system::error_code ec;
 
       auto address  = boost::asio::ip::make_address(endpoint_address);
       auto endpoint = tcp::endpoint{address, endpoint_port};
-      acceptor      = std::make_unique<tcp::acceptor>(app().get_io_service());
+      acceptor      = std::make_unique<tcp::acceptor>(session_thread_pool->get_executor());
 
       auto check_ec = [&](const char* what) {
          if (!ec)
@@ -375,7 +924,7 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
    }
 
    void do_accept() {
-      auto socket = std::make_shared<tcp::socket>(app().get_io_service());
+      auto socket = std::make_shared<tcp::socket>(session_thread_pool->get_executor());
       acceptor->async_accept(*socket, [self = shared_from_this(), socket, this](const boost::system::error_code& ec) {
          if (stopping)
             return;
@@ -385,9 +934,12 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
             return;
          }
          catch_and_log([&] {
-            auto s            = std::make_shared<session>(self);
-            sessions[s.get()] = s;
-            s->start(std::move(*socket));
+            auto s = std::make_shared<session>(self, session_thread_pool->get_executor());
+            {
+               std::lock_guard<std::mutex> g(sessions_mtx);
+               sessions[s.get()] = s;
+            }
+            boost::asio::post(s->strand, [s, socket]() { s->catch_and_close([&] { s->start(std::move(*socket)); }); });
          });
          catch_and_log([&] { do_accept(); });
       });
@@ -419,13 +971,27 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
    void on_accepted_block(const block_state_ptr& block_state) {
       store_traces(block_state);
       store_chain_state(block_state);
+      {
+         std::lock_guard<std::mutex> g(mtx);
+         recent_blocks.erase(recent_blocks.lower_bound(block_state->block_num), recent_blocks.end());
+         recent_blocks[block_state->block_num] = block_state->block;
+         while (recent_blocks.size() > std::max<uint32_t>(block_cache_size, 1))
+            recent_blocks.erase(recent_blocks.begin());
+      }
+      update_head();
+      update_sessions(block_state->block_num);
+   }
+
+   /// the only work the main thread does for sessions: hand each of them the update on its own strand
+   void update_sessions(uint32_t block_num = std::numeric_limits<uint32_t>::max()) {
+      std::lock_guard<std::mutex> g(sessions_mtx);
       for (auto& s : sessions) {
-         auto& p = s.second;
-         if (p) {
-            if (p->current_request && block_state->block_num < p->current_request->start_block_num)
-               p->current_request->start_block_num = block_state->block_num;
-            p->send_update(true);
-         }
+         auto p = s.second;
+         if (p)
+            boost::asio::post(p->strand, [p, block_num]() {
+               if (!p->plugin->stopping)
+                  p->catch_and_close([&] { p->on_update(block_num); });
+            });
       }
    }
 
@@ -449,19 +1015,63 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
       cached_traces.clear();
       onblock_trace.reset();
 
-      auto& db         = chain_plug->chain().db();
-      auto  traces_bin = zlib_compress_bytes(fc::raw::pack(make_history_context_wrapper(db, trace_debug_mode, traces)));
-      EOS_ASSERT(traces_bin.size() == (uint32_t)traces_bin.size(), plugin_exception, "traces is too big");
-
-      state_history_log_header header{.magic        = ship_magic(ship_current_version),
-                                      .block_id     = block_state->block->id(),
-                                      .payload_size = sizeof(uint32_t) + traces_bin.size()};
-      trace_log->write_entry(header, block_state->block->previous, [&](auto& stream) {
-         uint32_t s = (uint32_t)traces_bin.size();
-         stream.write((char*)&s, sizeof(s));
-         if (!traces_bin.empty())
-            stream.write(traces_bin.data(), traces_bin.size());
+      // the traces are immutable and serializing them does not read the database, so all of it can run on the pool
+      auto& db = chain_plug->chain().db();
+      queue_entry(*trace_log, trace_compression, block_state,
+                  [&db, debug_mode = trace_debug_mode, traces = std::move(traces)]() {
+                     return fc::raw::pack(make_history_context_wrapper(db, debug_mode, traces));
+                  });
+   }
+
+   /// @param pack returns the uncompressed entry
+   template <typename F>
+   void queue_entry(state_history_log& log, const log_compression& compression, const block_state_ptr& block_state,
+                    F&& pack, std::vector<state_history_table_key> table_keys = {}) {
+      auto payload = async_thread_pool(thread_pool->get_executor(),
+                                       [self = shared_from_this(), &compression, pack = std::forward<F>(pack)]() {
+         auto on_exit = fc::make_scoped_exit([&self]() {
+            app().post(priority::medium, [self]() { self->write_entries(); });
+         });
+         return compression.compress(pack());
       });
+      // a block state loaded from a snapshot has no block
+      pending_entries.push_back(pending_entry{&log, compression.codec, block_state->block_num, block_state->id,
+                                              block_state->header.previous,
+                                              std::move(payload), std::move(table_keys)});
+   }
+
+   /// write the completed entries at the front of the queue, so the logs are always written in block order
+   void write_entries(bool wait = false) {
+      bool written = false;
+      while (!pending_entries.empty()) {
+         auto& entry = pending_entries.front();
+         if (!wait && entry.payload.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            break;
+         catch_and_log([&] {
+            auto                        bin = entry.payload.get();
+            std::lock_guard<std::mutex> g(mtx);
+            EOS_ASSERT(bin.size() == (uint32_t)bin.size(), plugin_exception, "${n} entry is too big",
+                       ("n", entry.log->name));
+            state_history_log_header header{.magic        = ship_magic(ship_current_version),
+                                            .block_id     = entry.block_id,
+                                            .payload_size = sizeof(entry.codec) + sizeof(uint32_t) + bin.size()};
+            entry.log->write_entry(header, entry.previous, [&](auto& stream) {
+               stream.write((char*)&entry.codec, sizeof(entry.codec));
+               uint32_t s = (uint32_t)bin.size();
+               stream.write((char*)&s, sizeof(s));
+               if (!bin.empty())
+                  stream.write(bin.data(), bin.size());
+            });
+            if (chain_state_table_index && entry.log == &*chain_state_log)
+               chain_state_table_index->add_block(entry.block_num, entry.table_keys);
+         });
+         pending_entries.pop_front();
+         written = true;
+      }
+      if (written && !stopping) {
+         update_head();
+         update_sessions();
+      }
    }
 
    void store_chain_state(const block_state_ptr& block_state) {
@@ -469,15 +1079,15 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
          return;
       bool fresh = chain_state_log->begin_block() == chain_state_log->end_block();
       if (fresh)
-         ilog("Placing initial state in block ${n}", ("n", block_state->block->block_num()));
+         ilog("Placing initial state in block ${n}", ("n", block_state->block_num));
 
-      std::vector<table_delta> deltas;
-      auto&                    db = chain_plug->chain().db();
+      auto& db = chain_plug->chain().db();
 
       const auto&                                table_id_index = db.get_index<table_id_multi_index>();
       std::map<uint64_t, const table_id_object*> removed_table_id;
-      for (auto& rem : table_id_index.stack().back().removed_values)
-         removed_table_id[rem.first._id] = &rem.second;
+      if (!table_id_index.stack().empty()) // no undo session right after a snapshot is loaded
+         for (auto& rem : table_id_index.stack().back().removed_values)
+            removed_table_id[rem.first._id] = &rem.second;
 
       auto get_table_id = [&](uint64_t tid) -> const table_id_object& {
          auto obj = table_id_index.find(tid);
@@ -494,24 +1104,37 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
          return fc::raw::pack(make_history_context_wrapper(db, get_table_id(row.t_id._id), row));
       };
 
+      // rows are packed from the database, which only holds this block's state until the signal returns, so the
+      // tables are packed concurrently while this thread waits; the database is not modified until they are done
+      std::vector<std::future<fc::optional<table_delta>>> tables;
       auto process_table = [&](auto* name, auto& index, auto& pack_row) {
          if (fresh) {
-            if (index.indices().empty())
-               return;
-            deltas.push_back({});
-            auto& delta = deltas.back();
-            delta.name  = name;
-            for (auto& row : index.indices())
-               delta.rows.obj.emplace_back(true, pack_row(row));
-         } else {
+            // the initial state of a table goes out as deltas of up to initial_state_chunk_rows rows each, packed
+            // concurrently, so that large tables are spread across the pool
+            auto& rows = index.indices();
+            for (auto it = rows.begin(); it != rows.end();) {
+               auto first = it;
+               for (uint32_t n = 0; n < initial_state_chunk_rows && it != rows.end(); ++n)
+                  ++it;
+               tables.push_back(async_thread_pool(
+                   thread_pool->get_executor(), [&pack_row, name, first, last = it]() -> fc::optional<table_delta> {
+                      table_delta delta;
+                      delta.name = name;
+                      for (auto row = first; row != last; ++row)
+                         delta.rows.obj.emplace_back(true, pack_row(*row));
+                      return delta;
+                   }));
+            }
+            return;
+         }
+         tables.push_back(async_thread_pool(thread_pool->get_executor(), [&, name]() -> fc::optional<table_delta> {
             if (index.stack().empty())
-               return;
+               return {};
             auto& undo = index.stack().back();
             if (undo.old_values.empty() && undo.new_ids.empty() && undo.removed_values.empty())
-               return;
-            deltas.push_back({});
-            auto& delta = deltas.back();
-            delta.name  = name;
+               return {};
+            table_delta delta;
+            delta.name = name;
             for (auto& old : undo.old_values) {
                auto& row = index.get(old.first);
                if (include_delta(old.second, row))
@@ -523,7 +1146,8 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
                auto& row = index.get(id);
                delta.rows.obj.emplace_back(true, pack_row(row));
             }
-         }
+            return delta;
+         }));
       };
 
       process_table("account", db.get_index<account_index>(), pack_row);
@@ -550,17 +1174,30 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
       process_table("resource_limits_state", db.get_index<resource_limits::resource_limits_state_index>(), pack_row);
       process_table("resource_limits_config", db.get_index<resource_limits::resource_limits_config_index>(), pack_row);
 
-      auto deltas_bin = zlib_compress_bytes(fc::raw::pack(deltas));
-      EOS_ASSERT(deltas_bin.size() == (uint32_t)deltas_bin.size(), plugin_exception, "deltas is too big");
-      state_history_log_header header{.magic        = ship_magic(ship_current_version),
-                                      .block_id     = block_state->block->id(),
-                                      .payload_size = sizeof(uint32_t) + deltas_bin.size()};
-      chain_state_log->write_entry(header, block_state->block->previous, [&](auto& stream) {
-         uint32_t s = (uint32_t)deltas_bin.size();
-         stream.write((char*)&s, sizeof(s));
-         if (!deltas_bin.empty())
-            stream.write(deltas_bin.data(), deltas_bin.size());
-      });
+      // every task refers to this frame, so all of them have finished before any exception is rethrown
+      for (auto& t : tables)
+         t.wait();
+      std::vector<table_delta> deltas;
+      for (auto& t : tables) {
+         auto delta = t.get();
+         if (delta)
+            deltas.push_back(std::move(*delta));
+      }
+
+      std::vector<state_history_table_key> table_keys;
+      if (chain_state_table_index) {
+         for (auto& delta : deltas) {
+            if (is_contract_table(delta.name)) {
+               for (auto& row : delta.rows.obj)
+                  table_keys.push_back(contract_row_key(row.second));
+            }
+         }
+         std::sort(table_keys.begin(), table_keys.end());
+         table_keys.erase(std::unique(table_keys.begin(), table_keys.end()), table_keys.end());
+      }
+
+      queue_entry(*chain_state_log, chain_state_compression, block_state,
+                  [deltas = std::move(deltas)]() { return fc::raw::pack(deltas); }, std::move(table_keys));
    } // store_chain_state
 };   // state_history_plugin_impl
 
@@ -581,6 +1218,48 @@ void state_history_plugin::set_program_options(options_description& cli, options
            "your internal network.");
    options("trace-history-debug-mode", bpo::bool_switch()->default_value(false),
            "enable debug mode for trace history");
+   options("trace-history-compression", bpo::value<string>()->default_value("zlib"),
+           "compression of new trace history entries: zlib, zstd or lz4 (when built with them); existing entries "
+           "stay readable with their own codec");
+   options("chain-state-history-compression", bpo::value<string>()->default_value("zlib"),
+           "compression of new chain state history entries: zlib, zstd or lz4 (when built with them); existing "
+           "entries stay readable with their own codec");
+   options("state-history-compression-level", bpo::value<int>()->default_value(0),
+           "zstd compression level of new state history entries, 0 for the zstd default");
+   options("trace-history-zstd-dictionary", bpo::value<bfs::path>(),
+           "trained zstd dictionary for trace history entries; it must stay configured to read entries written "
+           "with it");
+   options("chain-state-history-zstd-dictionary", bpo::value<bfs::path>(),
+           "trained zstd dictionary for chain state history entries; it must stay configured to read entries "
+           "written with it");
+   options("chain-state-history-initial-state", bpo::bool_switch()->default_value(false),
+           "when the chain state log is empty at startup, e.g. after starting from a snapshot, place the whole state "
+           "in an entry for the head block, so that consumers can bootstrap there; otherwise the whole state is "
+           "placed in the first block received");
+   options("chain-state-history-initial-state-chunk-rows", bpo::value<uint32_t>()->default_value(10000),
+           "maximum number of rows in each delta of an initial state; the chunks are packed in parallel");
+   options("chain-state-history-table-index", bpo::bool_switch()->default_value(false),
+           "index the blocks in which each contract table (code, table, scope) has chain state deltas");
+   options("state-history-flush-blocks", bpo::value<uint32_t>()->default_value(0),
+           "flush the state history logs once this many blocks were written; 0 leaves it to the file buffers unless "
+           "state-history-flush-interval-ms or state-history-fsync is set");
+   options("state-history-flush-interval-ms", bpo::value<uint32_t>()->default_value(0),
+           "also flush the state history logs at the first block written this long after the last flush");
+   options("state-history-fsync", bpo::bool_switch()->default_value(false),
+           "fsync the state history logs after each flush, on a thread of each log's own");
+   options("state-history-segment-blocks", bpo::value<uint32_t>()->default_value(0),
+           "move the oldest blocks of the state history logs into a read only segment file every this many blocks; "
+           "0 keeps each log in a single file");
+   options("state-history-retained-blocks", bpo::value<uint32_t>()->default_value(0),
+           "delete state history segments once all their blocks are older than this many blocks; 0 keeps them all. "
+           "Requires state-history-segment-blocks");
+   options("state-history-cache-blocks", bpo::value<uint32_t>()->default_value(32),
+           "number of blocks near head whose block, traces and deltas are kept once read for a session, so that "
+           "sessions following head share them; 0 disables the cache");
+   options("state-history-session-threads", bpo::value<uint16_t>()->default_value(2),
+           "number of threads running the websocket sessions: their I/O, log reads and decompression");
+   options("state-history-threads", bpo::value<uint16_t>()->default_value(2),
+           "number of worker threads packing and compressing state history log entries");
 }
 
 void state_history_plugin::plugin_initialize(const variables_map& options) {
@@ -622,24 +1301,100 @@ void state_history_plugin::plugin_initialize(const variables_map& options) {
          my->trace_debug_mode = true;
       }
 
+      auto configure_compression = [&](log_compression& compression, const char* codec_option,
+                                       const char* dictionary_option) {
+         compression.codec = log_compression::parse_codec(options.at(codec_option).as<string>());
+         compression.level = options.at("state-history-compression-level").as<int>();
+         if (options.count(dictionary_option)) {
+            auto dictionary = options.at(dictionary_option).as<bfs::path>();
+            if (dictionary.is_relative())
+               dictionary = app().config_dir() / dictionary;
+            compression.load_zstd_dictionary(dictionary);
+         }
+      };
+      configure_compression(my->trace_compression, "trace-history-compression", "trace-history-zstd-dictionary");
+      configure_compression(my->chain_state_compression, "chain-state-history-compression",
+                            "chain-state-history-zstd-dictionary");
+
+      my->initial_state            = options.at("chain-state-history-initial-state").as<bool>();
+      my->initial_state_chunk_rows = options.at("chain-state-history-initial-state-chunk-rows").as<uint32_t>();
+      EOS_ASSERT(my->initial_state_chunk_rows > 0, plugin_config_exception,
+                 "chain-state-history-initial-state-chunk-rows must be > 0");
+
+      my->block_cache_size = options.at("state-history-cache-blocks").as<uint32_t>();
+      my->abi_serializer_max_time = my->chain_plug->get_abi_serializer_max_time();
+      my->ship_abi.emplace(fc::json::from_string(state_history_plugin_abi).as<abi_def>(), my->abi_serializer_max_time);
+
+      my->session_thread_pool_size = options.at("state-history-session-threads").as<uint16_t>();
+      EOS_ASSERT(my->session_thread_pool_size > 0, plugin_config_exception,
+                 "state-history-session-threads ${n} must be > 0", ("n", my->session_thread_pool_size));
+      my->thread_pool_size = options.at("state-history-threads").as<uint16_t>();
+      EOS_ASSERT(my->thread_pool_size > 0, plugin_config_exception, "state-history-threads ${n} must be > 0",
+                 ("n", my->thread_pool_size));
+      // blocks replayed by the chain plugin's startup, which runs before ours, are already stored with it
+      my->thread_pool.emplace("ship", my->thread_pool_size);
+
       if (options.at("trace-history").as<bool>())
          my->trace_log.emplace("trace_history", (state_history_dir / "trace_history.log").string(),
                                (state_history_dir / "trace_history.index").string());
       if (options.at("chain-state-history").as<bool>())
          my->chain_state_log.emplace("chain_state_history", (state_history_dir / "chain_state_history.log").string(),
                                      (state_history_dir / "chain_state_history.index").string());
+      log_durability durability;
+      durability.flush_blocks   = options.at("state-history-flush-blocks").as<uint32_t>();
+      durability.flush_interval = fc::milliseconds(options.at("state-history-flush-interval-ms").as<uint32_t>());
+      durability.fsync          = options.at("state-history-fsync").as<bool>();
+      if (durability.flush_blocks || durability.flush_interval > fc::microseconds(0) || durability.fsync) {
+         if (my->trace_log)
+            my->trace_log->set_durability(durability);
+         if (my->chain_state_log)
+            my->chain_state_log->set_durability(durability);
+      }
+      auto segment_blocks  = options.at("state-history-segment-blocks").as<uint32_t>();
+      auto retained_blocks = options.at("state-history-retained-blocks").as<uint32_t>();
+      EOS_ASSERT(!retained_blocks || segment_blocks, plugin_config_exception,
+                 "state-history-retained-blocks requires state-history-segment-blocks");
+      if (my->trace_log)
+         my->trace_log->set_retention(segment_blocks, retained_blocks);
+      if (my->chain_state_log)
+         my->chain_state_log->set_retention(segment_blocks, retained_blocks);
+      if (options.at("chain-state-history-table-index").as<bool>()) {
+         EOS_ASSERT(my->chain_state_log, plugin_config_exception,
+                    "chain-state-history-table-index requires chain-state-history");
+         my->chain_state_table_index.emplace((state_history_dir / "chain_state_history.table_index").string(),
+                                             my->chain_state_log->end_block());
+      }
    }
    FC_LOG_AND_RETHROW()
 } // state_history_plugin::plugin_initialize
 
-void state_history_plugin::plugin_startup() { my->listen(); }
+void state_history_plugin::plugin_startup() {
+   my->session_thread_pool.emplace("shipio", my->session_thread_pool_size);
+   if (my->initial_state && my->chain_state_log &&
+       my->chain_state_log->begin_block() == my->chain_state_log->end_block()) {
+      my->store_chain_state(my->chain_plug->chain().head_block_state());
+      my->write_entries(true);
+   }
+   my->update_head();
+   my->listen();
+}
 
 void state_history_plugin::plugin_shutdown() {
    my->applied_transaction_connection.reset();
    my->accepted_block_connection.reset();
-   while (!my->sessions.empty())
-      my->sessions.begin()->second->close();
    my->stopping = true;
+   // the session threads are joined before the sessions and the acceptor are destroyed
+   if (my->session_thread_pool)
+      my->session_thread_pool->stop();
+   {
+      std::lock_guard<std::mutex> g(my->sessions_mtx);
+      my->sessions.clear();
+   }
+   my->acceptor.reset();
+   if (my->thread_pool) {
+      my->write_entries(true);
+      my->thread_pool->stop();
+   }
 }
 
 } // namespace eosio
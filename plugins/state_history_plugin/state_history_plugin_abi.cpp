@@ -32,6 +32,45 @@ extern const char* const state_history_plugin_abi = R"({
                 { "name": "fetch_deltas", "type": "bool" }
             ]
         },
+        {
+            "name": "get_blocks_request_v1", "base": "get_blocks_request_v0", "fields": [
+                { "name": "filter_accounts", "type": "name[]" },
+                { "name": "filter_tables", "type": "name[]" },
+                { "name": "filter_actions", "type": "name[]" }
+            ]
+        },
+        {
+            "name": "get_blocks_request_v2", "base": "get_blocks_request_v1", "fields": [
+                { "name": "decode_rows", "type": "bool" }
+            ]
+        },
+        {
+            "name": "get_blocks_request_v3", "base": "get_blocks_request_v2", "fields": [
+                { "name": "stored_entries", "type": "bool" }
+            ]
+        },
+        {
+            "name": "get_table_blocks_request_v0", "fields": [
+                { "name": "code", "type": "name" },
+                { "name": "table", "type": "name" },
+                { "name": "scope", "type": "name" },
+                { "name": "start_block_num", "type": "uint32" },
+                { "name": "end_block_num", "type": "uint32" }
+            ]
+        },
+        {
+            "name": "block_range", "fields": [
+                { "name": "first_block", "type": "uint32" },
+                { "name": "last_block", "type": "uint32" }
+            ]
+        },
+        {
+            "name": "get_table_blocks_result_v0", "fields": [
+                { "name": "index_begin_block", "type": "uint32" },
+                { "name": "index_end_block", "type": "uint32" },
+                { "name": "ranges", "type": "block_range[]" }
+            ]
+        },
         {
             "name": "get_blocks_ack_request_v0", "fields": [
                 { "name": "num_messages", "type": "uint32" }
@@ -48,6 +87,28 @@ extern const char* const state_history_plugin_abi = R"({
                 { "name": "deltas", "type": "bytes?" }
             ]
         },
+        {
+            "name": "decoded_row", "fields": [
+                { "name": "present", "type": "bool" },
+                { "name": "code", "type": "name" },
+                { "name": "scope", "type": "name" },
+                { "name": "table", "type": "name" },
+                { "name": "primary_key", "type": "uint64" },
+                { "name": "payer", "type": "name" },
+                { "name": "value", "type": "string" }
+            ]
+        },
+        {
+            "name": "get_blocks_result_v1", "base": "get_blocks_result_v0", "fields": [
+                { "name": "decoded_rows", "type": "decoded_row[]" }
+            ]
+        },
+        {
+            "name": "get_blocks_result_v2", "base": "get_blocks_result_v1", "fields": [
+                { "name": "traces_codec", "type": "uint8?" },
+                { "name": "deltas_codec", "type": "uint8?" }
+            ]
+        },
         {
             "name": "row", "fields": [
                 { "name": "present", "type": "bool" },
@@ -497,8 +558,8 @@ extern const char* const state_history_plugin_abi = R"({
         { "new_type_name": "transaction_id", "type": "checksum256" }
     ],
     "variants": [
-        { "name": "request", "types": ["get_status_request_v0", "get_blocks_request_v0", "get_blocks_ack_request_v0"] },
-        { "name": "result", "types": ["get_status_result_v0", "get_blocks_result_v0"] },
+        { "name": "request", "types": ["get_status_request_v0", "get_blocks_request_v0", "get_blocks_ack_request_v0", "get_blocks_request_v1", "get_table_blocks_request_v0", "get_blocks_request_v2", "get_blocks_request_v3"] },
+        { "name": "result", "types": ["get_status_result_v0", "get_blocks_result_v0", "get_table_blocks_result_v0", "get_blocks_result_v1", "get_blocks_result_v2"] },
 
         { "name": "action_receipt", "types": ["action_receipt_v0"] },
         { "name": "action_trace", "types": ["action_trace_v0"] },
@@ -0,0 +1,98 @@
+#include <eosio/trace_api/compression.hpp>
+#include <eosio/trace_api/common.hpp>
+
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#ifdef EOSIO_TRACE_API_ZSTD_ENABLED
+#include <zstd.h>
+#endif
+
+#include <memory>
+
+namespace eosio::trace_api {
+   namespace bio = boost::iostreams;
+
+   namespace {
+      chain::bytes zlib_filter(const chain::bytes& in, bool compressing) {
+         chain::bytes out;
+         bio::filtering_ostream filter;
+         if (compressing) {
+            filter.push(bio::zlib_compressor(bio::zlib::default_compression));
+         } else {
+            filter.push(bio::zlib_decompressor());
+         }
+         filter.push(bio::back_inserter(out));
+         bio::write(filter, in.data(), in.size());
+         bio::close(filter);
+         return out;
+      }
+   }
+
+   trace_codec parse_trace_codec(const std::string& name) {
+      if (name == "none") {
+         return trace_codec::none;
+      }
+      if (name == "zlib") {
+         return trace_codec::zlib;
+      }
+#ifdef EOSIO_TRACE_API_ZSTD_ENABLED
+      if (name == "zstd") {
+         return trace_codec::zstd;
+      }
+#endif
+      throw std::invalid_argument("unsupported trace compression: " + name);
+   }
+
+   chain::bytes compress(trace_codec codec, const chain::bytes& in) {
+      switch (codec) {
+         case trace_codec::none:
+            return in;
+         case trace_codec::zlib:
+            return zlib_filter(in, true);
+#ifdef EOSIO_TRACE_API_ZSTD_ENABLED
+         case trace_codec::zstd: {
+            chain::bytes out(ZSTD_compressBound(in.size()));
+            const size_t size = ZSTD_compress(out.data(), out.size(), in.data(), in.size(), 3);
+            if (ZSTD_isError(size)) {
+               throw std::runtime_error(std::string("zstd compression failed: ") + ZSTD_getErrorName(size));
+            }
+            out.resize(size);
+            return out;
+         }
+#endif
+         default:
+            throw std::invalid_argument("unsupported trace compression: " + std::to_string(static_cast<uint32_t>(codec)));
+      }
+   }
+
+   chain::bytes decompress(trace_codec codec, const chain::bytes& in) {
+      switch (codec) {
+         case trace_codec::none:
+            return in;
+         case trace_codec::zlib:
+            try {
+               return zlib_filter(in, false);
+            } catch (const bio::zlib_error& e) {
+               throw bad_data_exception(std::string("corrupt zlib trace frame: ") + e.what());
+            }
+#ifdef EOSIO_TRACE_API_ZSTD_ENABLED
+         case trace_codec::zstd: {
+            const auto raw_size = ZSTD_getFrameContentSize(in.data(), in.size());
+            if (raw_size == ZSTD_CONTENTSIZE_ERROR || raw_size == ZSTD_CONTENTSIZE_UNKNOWN) {
+               throw bad_data_exception("corrupt zstd trace frame");
+            }
+            chain::bytes out(raw_size);
+            const size_t size = ZSTD_decompress(out.data(), out.size(), in.data(), in.size());
+            if (ZSTD_isError(size) || size != raw_size) {
+               throw bad_data_exception("corrupt zstd trace frame");
+            }
+            return out;
+         }
+#endif
+         default:
+            throw bad_data_exception("unsupported trace compression: " + std::to_string(static_cast<uint32_t>(codec)));
+      }
+   }
+}
@@ -36,6 +36,8 @@ namespace eosio {
        * @param action - trace of the action including metadata necessary for finding the ABI
        * @param yield - a yield function to allow cooperation during long running tasks
        * @return variant representing the `data` field of the action interpreted by known ABIs OR an empty variant
+       *
+       * Once the ABIs are added this only reads the shared serializers, so it may be called from several threads.
        */
       fc::variant process_data( const action_trace_v0& action, const yield_function& yield = {});
 
@@ -3,9 +3,14 @@
 #include <eosio/trace_api/common.hpp>
 #include <eosio/trace_api/trace.hpp>
 #include <eosio/trace_api/extract_util.hpp>
+#include <fc/log/logger_config.hpp>
+#include <condition_variable>
+#include <deque>
 #include <exception>
 #include <functional>
 #include <map>
+#include <mutex>
+#include <thread>
 
 namespace eosio { namespace trace_api {
 
@@ -19,11 +24,34 @@ public:
     * Chain Extractor for capturing transaction traces, action traces, and block info.
     * @param store provider of append & append_lib
     * @param except_handler called on exceptions, logging if any is left to the user
+    * @param max_queued_entries when not 0, blocks and libs are converted and stored in order on a writer thread, with
+    *                           up to this many waiting for it; a signal waits while the queue is full.  An exception
+    *                           thrown by except_handler on the writer thread stops it and is rethrown by the next signal
     */
-   chain_extraction_impl_type( StoreProvider store, exception_handler except_handler )
+   chain_extraction_impl_type( StoreProvider store, exception_handler except_handler, uint32_t max_queued_entries = 0 )
    : store(std::move(store))
    , except_handler(std::move(except_handler))
-   {}
+   , max_queued_entries(max_queued_entries)
+   {
+      if( max_queued_entries > 0 ) {
+         writer = std::thread( [this]() {
+            fc::set_os_thread_name( "trace-ext" );
+            write_queued();
+         } );
+      }
+   }
+
+   /// stores the queued entries before returning
+   ~chain_extraction_impl_type() {
+      if( writer.joinable() ) {
+         {
+            std::lock_guard<std::mutex> g( mtx );
+            stopping = true;
+         }
+         queue_available.notify_all();
+         writer.join();
+      }
+   }
 
    /// connect to chain controller applied_transaction signal
    void signal_applied_transaction( const chain::transaction_trace_ptr& trace, const chain::signed_transaction& strx ) {
@@ -70,21 +98,73 @@ private:
    }
 
    void on_accepted_block(const chain::block_state_ptr& block_state) {
-      store_block_trace( block_state );
+      if( writer.joinable() ) {
+         // the traces are not modified once applied, the writer converts them
+         queue( [this, block_state, onblock = std::move( onblock_trace ), traces = std::move( cached_traces )]() {
+            store_block_trace( block_state, onblock, traces );
+         } );
+      } else {
+         store_block_trace( block_state, onblock_trace, cached_traces );
+      }
+      cached_traces.clear();
+      onblock_trace.reset();
    }
 
    void on_irreversible_block( const chain::block_state_ptr& block_state ) {
-      store_lib( block_state );
+      if( writer.joinable() ) {
+         queue( [this, block_state]() {
+            store_lib( block_state );
+         } );
+      } else {
+         store_lib( block_state );
+      }
    }
 
-   void store_block_trace( const chain::block_state_ptr& block_state ) {
+   void queue( std::function<void()> entry ) {
+      std::unique_lock<std::mutex> g( mtx );
+      queue_space.wait( g, [this]() { return queued.size() < max_queued_entries || writer_failure; } );
+      if( writer_failure ) {
+         std::rethrow_exception( writer_failure );
+      }
+      queued.push_back( std::move( entry ) );
+      g.unlock();
+      queue_available.notify_one();
+   }
+
+   void write_queued() {
+      std::unique_lock<std::mutex> g( mtx );
+      while( true ) {
+         queue_available.wait( g, [this]() { return !queued.empty() || stopping; } );
+         if( queued.empty() ) {
+            return;
+         }
+         // left in the queue while it is stored so that the queue bounds the entries not yet stored
+         auto entry = std::move( queued.front() );
+         g.unlock();
+         try {
+            entry();
+         } catch( ... ) {
+            g.lock();
+            writer_failure = std::current_exception();
+            queued.clear();
+            queue_space.notify_all();
+            return;
+         }
+         g.lock();
+         queued.pop_front();
+         queue_space.notify_all();
+      }
+   }
+
+   void store_block_trace( const chain::block_state_ptr& block_state, const fc::optional<chain::transaction_trace_ptr>& onblock,
+                           const std::map<transaction_id_type, chain::transaction_trace_ptr>& applied_traces ) {
       try {
          block_trace_v0 bt = create_block_trace_v0( block_state );
 
          std::vector<transaction_trace_v0>& traces = bt.transactions;
          traces.reserve( block_state->block->transactions.size() + 1 );
-         if( onblock_trace )
-            traces.emplace_back( to_transaction_trace_v0( *onblock_trace ));
+         if( onblock )
+            traces.emplace_back( to_transaction_trace_v0( *onblock ));
          for( const auto& r : block_state->block->transactions ) {
             transaction_id_type id;
             if( r.trx.contains<transaction_id_type>()) {
@@ -92,13 +172,11 @@ private:
             } else {
                id = r.trx.get<packed_transaction>().id();
             }
-            const auto it = cached_traces.find( id );
-            if( it != cached_traces.end() ) {
+            const auto it = applied_traces.find( id );
+            if( it != applied_traces.end() ) {
                traces.emplace_back( to_transaction_trace_v0( it->second ));
             }
          }
-         cached_traces.clear();
-         onblock_trace.reset();
 
          store.append( std::move( bt ) );
 
@@ -121,6 +199,15 @@ private:
    std::map<transaction_id_type, chain::transaction_trace_ptr>  cached_traces;
    fc::optional<chain::transaction_trace_ptr>                   onblock_trace;
 
+   const uint32_t                                               max_queued_entries;
+   std::thread                                                  writer;
+   std::mutex                                                   mtx;
+   std::condition_variable                                      queue_available;
+   std::condition_variable                                      queue_space;
+   std::deque<std::function<void()>>                            queued;
+   bool                                                         stopping = false;
+   std::exception_ptr                                           writer_failure;
+
 };
 
 }}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <eosio/chain/types.hpp>
+#include <string>
+
+namespace eosio::trace_api {
+
+   /**
+    * Codecs of the compressed frames of a trace data log, the value is stored in each frame
+    */
+   enum class trace_codec : uint8_t {
+      none = 0,
+      zlib = 1,
+      zstd = 2 ///< only available when built with zstd
+   };
+
+   /**
+    * @param name : "none", "zlib" or "zstd"
+    * @throws std::invalid_argument for an unknown codec or one this build does not support
+    */
+   trace_codec parse_trace_codec(const std::string& name);
+
+   chain::bytes compress(trace_codec codec, const chain::bytes& in);
+
+   /**
+    * @throws bad_data_exception if in is not valid data of codec
+    */
+   chain::bytes decompress(trace_codec codec, const chain::bytes& in);
+
+}
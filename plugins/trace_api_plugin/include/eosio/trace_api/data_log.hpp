@@ -6,8 +6,20 @@
 
 namespace eosio { namespace trace_api {
 
+   /**
+    * A frame holding a packed block_trace_v0 compressed with codec; readers of the data log only ever see the
+    * block_trace_v0
+    */
+   struct compressed_block_trace_v0 {
+      uint8_t      codec = 0; ///< trace_codec
+      chain::bytes data  = {};
+   };
+
    using data_log_entry = fc::static_variant<
-      block_trace_v0
+      block_trace_v0,
+      compressed_block_trace_v0
    >;
 
 }}
+
+FC_REFLECT(eosio::trace_api::compressed_block_trace_v0, (codec)(data));
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <set>
+#include <fc/io/json.hpp>
 #include <fc/variant.hpp>
 #include <eosio/trace_api/metadata_log.hpp>
 #include <eosio/trace_api/data_log.hpp>
@@ -8,19 +10,58 @@
 namespace eosio::trace_api {
    using data_handler_function = std::function<fc::variant(const action_trace_v0&, const yield_function&)>;
 
+   /**
+    * Calls task with each index in [0, count), possibly in parallel, and returns once every call has returned
+    * @throws the exception of a call that threw
+    */
+   using parallel_function = std::function<void(std::size_t count, const std::function<void(std::size_t)>& task)>;
+
+   /**
+    * Selects the actions of a response by receiver, account and action name; an empty set matches any name
+    */
+   struct action_filter {
+      std::set<chain::name> receivers;
+      std::set<chain::name> accounts;
+      std::set<chain::name> actions;
+
+      /// @return true if every action is selected
+      bool empty() const {
+         return receivers.empty() && accounts.empty() && actions.empty();
+      }
+
+      bool matches(const action_trace_v0& a) const {
+         return (receivers.empty() || receivers.count(a.receiver)) &&
+                (accounts.empty() || accounts.count(a.account)) &&
+                (actions.empty() || actions.count(a.action));
+      }
+   };
+
    namespace detail {
       class response_formatter {
       public:
-         static fc::variant process_block( const block_trace_v0& trace, bool irreversible, const data_handler_function& data_handler, const yield_function& yield );
+         /**
+          * When parallel is provided the data handler is called for all of the actions up front through it, so it
+          * must be safe to call concurrently, and with an empty yield.  The response is the same either way.
+          *
+          * Only the actions selected by filter are decoded and returned, along with the transactions that have any.
+          */
+         static fc::variant process_block( const block_trace_v0& trace, bool irreversible, const data_handler_function& data_handler, const yield_function& yield, const parallel_function& parallel = {}, const action_filter& filter = {} );
+         /// @return an empty variant if the block does not contain the transaction
+         static fc::variant process_transaction( const block_trace_v0& trace, bool irreversible, const chain::transaction_id_type& id, const data_handler_function& data_handler, const yield_function& yield, const parallel_function& parallel = {} );
       };
    }
 
    template<typename LogfileProvider, typename DataHandlerProvider>
    class request_handler {
    public:
-      request_handler(LogfileProvider&& logfile_provider, DataHandlerProvider&& data_handler_provider)
+      /**
+       * @param parallel - decodes the actions of a response in parallel when provided, which the data handler provider
+       * must then support
+       */
+      request_handler(LogfileProvider&& logfile_provider, DataHandlerProvider&& data_handler_provider, parallel_function parallel = {})
       :logfile_provider(std::move(logfile_provider))
       ,data_handler_provider(std::move(data_handler_provider))
+      ,parallel(std::move(parallel))
       {
       }
 
@@ -35,7 +76,7 @@ namespace eosio::trace_api {
        * @throws yield_exception if a call to `yield` throws.
        * @throws bad_data_exception when there are issues with the underlying data preventing processing.
        */
-      fc::variant get_block_trace( uint32_t block_height, const yield_function& yield = {}) {
+      fc::variant get_block_trace( uint32_t block_height, const yield_function& yield = {}, const action_filter& filter = {}) {
          auto data = logfile_provider.get_block(block_height, yield);
          if (!data) {
             return {};
@@ -47,12 +88,118 @@ namespace eosio::trace_api {
             return data_handler_provider.process_data(action, yield);
          };
 
-         return detail::response_formatter::process_block(std::get<0>(*data), std::get<1>(*data), data_handler, yield);
+         return detail::response_formatter::process_block(std::get<0>(*data), std::get<1>(*data), data_handler, yield, parallel, filter);
+      }
+
+      /**
+       * Fetch the traces of a range of blocks, selecting actions with a filter, and convert them to a fc::variant
+       * for conversion to a final format (eg JSON)
+       *
+       * @param first_block - the height of the first block of the range
+       * @param last_block - the height of the last block of the range
+       * @param filter - the actions to return
+       * @param yield - a yield function to allow cooperation during long running tasks
+       * @return an object whose "blocks" are the traces, as returned by get_block_trace, of the blocks of the range
+       * that exist, leaving out those without any selected action unless the filter is empty
+       * @throws yield_exception if a call to `yield` throws.
+       * @throws bad_data_exception when there are issues with the underlying data preventing processing.
+       */
+      fc::variant get_block_range_trace( uint32_t first_block, uint32_t last_block, const action_filter& filter, const yield_function& yield = {}) {
+         fc::variants blocks;
+         for (uint64_t height = first_block; height <= last_block; ++height) {
+            auto block = get_block_trace(static_cast<uint32_t>(height), yield, filter);
+            if (block.is_null()) {
+               continue;
+            }
+            if (!filter.empty() && block.get_object()["transactions"].get_array().empty()) {
+               continue;
+            }
+            blocks.emplace_back(std::move(block));
+         }
+         return fc::mutable_variant_object()("blocks", std::move(blocks));
+      }
+
+      /**
+       * Export the traces of a range of blocks as newline delimited JSON, reading the blocks in order
+       *
+       * @param first_block - the height of the first block of the range
+       * @param last_block - the height of the last block of the range
+       * @param yield - a yield function to allow cooperation during long running tasks
+       * @return a line with the object returned by get_block_trace for each block of the range that exists
+       * @throws yield_exception if a call to `yield` throws.
+       * @throws bad_data_exception when there are issues with the underlying data preventing processing.
+       */
+      std::string export_block_range_json( uint32_t first_block, uint32_t last_block, const yield_function& yield = {}) {
+         logfile_provider.prefetch_blocks(first_block, last_block);
+         std::string result;
+         for (uint64_t height = first_block; height <= last_block; ++height) {
+            auto block = get_block_trace(static_cast<uint32_t>(height), yield);
+            if (block.is_null()) {
+               continue;
+            }
+            result += fc::json::to_string(block, fc::time_point::maximum());
+            result += '\n';
+         }
+         return result;
+      }
+
+      /**
+       * Export the traces of a range of blocks packed, without decoding the action data, reading the blocks in order
+       *
+       * @param first_block - the height of the first block of the range
+       * @param last_block - the height of the last block of the range
+       * @param yield - a yield function to allow cooperation during long running tasks
+       * @return for each block of the range that exists, a uint8_t that is 1 if the block is irreversible and 0
+       * otherwise followed by its packed block_trace_v0
+       * @throws yield_exception if a call to `yield` throws.
+       * @throws bad_data_exception when there are issues with the underlying data preventing processing.
+       */
+      std::vector<char> export_block_range_packed( uint32_t first_block, uint32_t last_block, const yield_function& yield = {}) {
+         logfile_provider.prefetch_blocks(first_block, last_block);
+         std::vector<char> result;
+         for (uint64_t height = first_block; height <= last_block; ++height) {
+            auto data = logfile_provider.get_block(static_cast<uint32_t>(height), yield);
+            if (!data) {
+               continue;
+            }
+            yield();
+            result.push_back(std::get<1>(*data) ? 1 : 0);
+            const auto packed = fc::raw::pack(std::get<0>(*data));
+            result.insert(result.end(), packed.begin(), packed.end());
+         }
+         return result;
+      }
+
+      /**
+       * Fetch the trace of a transaction, along with the block that contains it, and convert it to a fc::variant
+       * for conversion to a final format (eg JSON)
+       *
+       * @param id - the id of the transaction whose trace is requested
+       * @param yield - a yield function to allow cooperation during long running tasks
+       * @return a properly formatted variant representing the trace of the transaction if a block on the current
+       * fork contains it, an empty variant otherwise.
+       * @throws yield_exception if a call to `yield` throws.
+       * @throws bad_data_exception when there are issues with the underlying data preventing processing.
+       */
+      fc::variant get_transaction_trace( const chain::transaction_id_type& id, const yield_function& yield = {}) {
+         auto data = logfile_provider.get_transaction_block(id, yield);
+         if (!data) {
+            return {};
+         }
+
+         yield();
+
+         auto data_handler = [this](const action_trace_v0& action, const yield_function& yield) -> fc::variant {
+            return data_handler_provider.process_data(action, yield);
+         };
+
+         return detail::response_formatter::process_transaction(std::get<0>(*data), std::get<1>(*data), id, data_handler, yield, parallel);
       }
 
    private:
       LogfileProvider logfile_provider;
       DataHandlerProvider data_handler_provider;
+      parallel_function parallel;
    };
 
 
@@ -1,12 +1,24 @@
 #pragma once
 
+#include <condition_variable>
+#include <functional>
 #include <ios>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 #include <fc/io/cfile.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <fc/variant.hpp>
 #include <eosio/trace_api/common.hpp>
+#include <eosio/trace_api/compression.hpp>
 #include <eosio/trace_api/metadata_log.hpp>
 #include <eosio/trace_api/data_log.hpp>
+#include <eosio/trace_api/trx_id_log.hpp>
 
 namespace eosio::trace_api {
    using namespace boost::filesystem;
@@ -52,15 +64,14 @@ namespace eosio::trace_api {
    };
 
    /**
-    * append an entry to the store
+    * append an already packed entry to the store
     *
-    * @param entry : the entry to append
+    * @param data : the packed entry to append
     * @param file : the file to append entry to
     * @return the offset in the file where that entry is written
     */
-   template<typename DataEntry, typename File>
-   static uint64_t append_store(const DataEntry &entry, File &file) {
-      auto data = fc::raw::pack(entry);
+   template<typename File>
+   static uint64_t append_packed_store(const std::vector<char>& data, File &file) {
       const auto offset = file.tellp();
       file.write(data.data(), data.size());
       file.flush();
@@ -68,6 +79,18 @@ namespace eosio::trace_api {
       return offset;
    }
 
+   /**
+    * append an entry to the store
+    *
+    * @param entry : the entry to append
+    * @param file : the file to append entry to
+    * @return the offset in the file where that entry is written
+    */
+   template<typename DataEntry, typename File>
+   static uint64_t append_store(const DataEntry &entry, File &file) {
+      return append_packed_store(fc::raw::pack(entry), file);
+   }
+
    /**
     * extract an entry from the data log
     *
@@ -83,11 +106,29 @@ namespace eosio::trace_api {
    }
 
 
+   /**
+    * Thrown out of a maintenance pass of the store_provider once it is being destroyed
+    */
+   class maintenance_stopped : public std::runtime_error {
+   public:
+      explicit maintenance_stopped(const char* what_arg) : std::runtime_error(what_arg) {}
+   };
+
    class store_provider;
 
    /**
     * Provides access to the slice directory.  It is only intended to be used by store_provider
     * and unit tests.
+    *
+    * Besides its trace (data log) and index (metadata log) files, a slice started by this version has a block offset
+    * file, trace_block_offset_<start>-<end>.log:
+    *    index_header, uint32_t lib, then a uint64_t for each block height of the slice that is 0 for a height without
+    *    a block, otherwise 1 + the data log offset of the last block appended at that height
+    * where lib is the highest lib appended to the slice.
+    *
+    * A slice's trace file is either written by append, with block_trace_v0 entries, or rewritten once the slice is
+    * far enough past lib with a compressed_block_trace_v0 frame for each block.  The other files of the slice then
+    * refer to the offsets of the frames.
     */
    class slice_directory {
    public:
@@ -95,6 +136,9 @@ namespace eosio::trace_api {
          uint32_t version;
       };
 
+      /// offset in a block offset file of the lib, the block offsets follow it
+      static constexpr uint64_t block_offset_lib_pos = sizeof(index_header);
+
       enum class open_state { read /*read from front to back*/, write /*write to end of file*/ };
       slice_directory(const boost::filesystem::path& slice_dir, uint32_t width, std::optional<uint32_t> minimum_irreversible_history_blocks);
 
@@ -156,6 +200,69 @@ namespace eosio::trace_api {
        */
       bool find_trace_slice(uint32_t slice_number, open_state state, fc::cfile& trace_file, bool open_file = true) const;
 
+      /**
+       * Find or create the transaction id file associated with the indicated slice_number
+       *
+       * @param slice_number : slice number of the requested slice file
+       * @param state : indicate if the file is going to be written to (appended) or read
+       * @param trx_id_file : the cfile that will be set to the appropriate slice filename
+       *                      and opened to that file
+       * @return the true if file was found (i.e. already existed)
+       */
+      bool find_or_create_trx_id_slice(uint32_t slice_number, open_state state, fc::cfile& trx_id_file) const;
+
+      /**
+       * Find the transaction id file associated with the indicated slice_number
+       *
+       * @param slice_number : slice number of the requested slice file
+       * @param state : indicate if the file is going to be written to (appended) or read
+       * @param trx_id_file : the cfile that will be set to the appropriate slice filename (always)
+       *                      and opened to that file (if it was found)
+       * @param open_file : indicate if the file should be opened (if found) or not
+       * @return the true if file was found (i.e. already existed), if not found trx_id_file
+       *         is set to the appropriate file, but not open
+       */
+      bool find_trx_id_slice(uint32_t slice_number, open_state state, fc::cfile& trx_id_file, bool open_file = true) const;
+
+      /**
+       * @return the slice numbers, in ascending order, of the slices that have a transaction id file
+       */
+      std::vector<uint32_t> trx_id_slice_numbers() const;
+
+      /**
+       * Create the block offset file associated with the indicated slice_number, with no blocks and a lib of 0
+       *
+       * @param slice_number : slice number of the requested slice file
+       * @param block_offset_file : the cfile that will be set to the appropriate slice filename
+       *                            and opened to that file for reading and writing at any position
+       */
+      void create_block_offset_slice(uint32_t slice_number, fc::cfile& block_offset_file) const;
+
+      /**
+       * Find the block offset file associated with the indicated slice_number
+       *
+       * @param slice_number : slice number of the requested slice file
+       * @param block_offset_file : the cfile that will be set to the appropriate slice filename (always)
+       *                            and opened to that file for reading and writing at any position (if it was found)
+       * @param open_file : indicate if the file should be opened (if found) or not
+       * @return the true if file was found (i.e. already existed)
+       */
+      bool find_block_offset_slice(uint32_t slice_number, fc::cfile& block_offset_file, bool open_file = true) const;
+
+      /**
+       * @return the position in a block offset file of the entry for block_height
+       */
+      uint64_t block_offset_pos(uint32_t block_height) const {
+         return block_offset_lib_pos + sizeof(uint32_t) + (block_height % _width) * sizeof(uint64_t);
+      }
+
+      /**
+       * @return the directory of the slice files
+       */
+      const boost::filesystem::path& slice_dir() const {
+         return _slice_dir;
+      }
+
       /**
        * Find or create a trace and index file pair
        *
@@ -170,8 +277,24 @@ namespace eosio::trace_api {
        * Cleans up all slices that are no longer needed to maintain the minimum number of blocks past lib
        *
        * @param lib : block number of the current lib
+       * @param remove : removes a slice file given its slice number and path, the file is removed directly if empty
        */
-      void cleanup_old_slices(uint32_t lib);
+      using slice_file_remover = std::function<void(uint32_t slice_number, const boost::filesystem::path& slice_file)>;
+      void cleanup_old_slices(uint32_t lib, const slice_file_remover& remove = {});
+
+      /**
+       * @return true if old slices are cleaned up
+       */
+      bool cleans_up_slices() const {
+         return _minimum_irreversible_history_blocks.has_value();
+      }
+
+      /**
+       * @return the highest slice number removed by cleanup_old_slices, if any
+       */
+      std::optional<uint32_t> last_cleaned_up_slice() const {
+         return _last_cleaned_up_slice;
+      }
 
    private:
       // returns true if slice is found, slice_file will always be set to the appropriate path for
@@ -190,6 +313,99 @@ namespace eosio::trace_api {
       std::optional<uint32_t> _last_cleaned_up_slice;
    };
 
+   /**
+    * Read only memory mappings of the trace files of the most recently read slices, and the data log entries most
+    * recently read from them, with compressed frames already decompressed.  Trace files only grow, so a mapping covers
+    * its file as it was when mapped and an entry at a given offset never changes; a mapping is only extended when an
+    * entry past its end is read.  A slice whose trace file is rewritten compressed is removed from the cache.
+    */
+   class slice_read_cache {
+   public:
+      static constexpr uint32_t default_max_mappings = 8;
+      static constexpr uint32_t default_max_entries  = 64;
+
+      slice_read_cache(uint32_t max_mappings, uint32_t max_entries)
+      :_max_mappings(max_mappings)
+      ,_max_entries(max_entries)
+      {}
+
+      /**
+       * Read the data log entry at an offset of a trace file
+       * @param slice_number : slice number of the trace file
+       * @param trace_file : path of the trace file
+       * @param offset : the offset of the entry
+       * @return empty optional if offset is past the end of the file, the entry otherwise
+       */
+      std::optional<data_log_entry> read(uint32_t slice_number, const boost::filesystem::path& trace_file, uint64_t offset);
+
+      /**
+       * Forget the slices up to and including slice_number, whose files are removed
+       */
+      void remove_slices_through(uint32_t slice_number);
+
+      /**
+       * Forget a slice, whose trace file is replaced
+       */
+      void remove_slice(uint32_t slice_number);
+
+      /**
+       * Map the trace file of a slice, if it is not mapped, and have the system read it ahead of the reads to come
+       */
+      void prefetch(uint32_t slice_number, const boost::filesystem::path& trace_file);
+
+      uint32_t max_mappings() const {
+         return _max_mappings;
+      }
+
+   private:
+      struct mapping {
+         boost::interprocess::file_mapping  file;
+         boost::interprocess::mapped_region region;
+      };
+      using entry_key = std::pair<uint32_t, uint64_t>; // slice number, offset
+
+      // callers hold _mtx
+      std::shared_ptr<mapping> map_slice(uint32_t slice_number, const boost::filesystem::path& trace_file, uint64_t min_size);
+
+      template<typename Key, typename Value>
+      struct lru {
+         std::list<Key>                                                     order; // most recently used first
+         std::map<Key, std::pair<typename std::list<Key>::iterator, Value>> values;
+
+         Value* find(const Key& k) {
+            auto itr = values.find(k);
+            if (itr == values.end()) {
+               return nullptr;
+            }
+            order.splice(order.begin(), order, itr->second.first);
+            return &itr->second.second;
+         }
+
+         void insert(const Key& k, Value v, uint32_t capacity) {
+            erase(k);
+            order.push_front(k);
+            values.emplace(k, std::make_pair(order.begin(), std::move(v)));
+            while (values.size() > capacity) {
+               erase(order.back());
+            }
+         }
+
+         void erase(const Key& k) {
+            auto itr = values.find(k);
+            if (itr != values.end()) {
+               order.erase(itr->second.first);
+               values.erase(itr);
+            }
+         }
+      };
+
+      const uint32_t                                        _max_mappings;
+      const uint32_t                                        _max_entries;
+      std::mutex                                            _mtx;
+      lru<uint32_t, std::shared_ptr<mapping>>               _mappings;
+      lru<entry_key, std::shared_ptr<const data_log_entry>> _entries;
+   };
+
    /**
     * Provides read and write access to block trace data.
     */
@@ -197,7 +413,25 @@ namespace eosio::trace_api {
    public:
       using open_state = slice_directory::open_state;
 
-      store_provider(const boost::filesystem::path& slice_dir, uint32_t stride_width, std::optional<uint32_t> minimum_irreversible_history_blocks);
+      store_provider(const boost::filesystem::path& slice_dir, uint32_t stride_width, std::optional<uint32_t> minimum_irreversible_history_blocks,
+                     uint32_t max_mapped_slices = slice_read_cache::default_max_mappings,
+                     uint32_t max_cached_entries = slice_read_cache::default_max_entries);
+      ~store_provider();
+
+      /**
+       * Compress the trace files of slices in the background, one slice at a time as lib advances, once all of their
+       * blocks are more than a number of blocks behind lib
+       * @param codec : the codec of the frames, none leaves the slices uncompressed
+       * @param minimum_uncompressed_irreversible_history_blocks : number of irreversible blocks kept uncompressed
+       */
+      void set_compression(trace_codec codec, uint32_t minimum_uncompressed_irreversible_history_blocks);
+
+      /**
+       * Limit the rate at which the maintenance thread, which removes old slices and compresses slices behind lib at
+       * idle I/O priority, reads and writes slice files
+       * @param max_bytes_per_second : the limit, 0 for no limit
+       */
+      void set_maintenance_rate(uint64_t max_bytes_per_second);
 
       void append(const block_trace_v0& bt);
       void append_lib(uint32_t lib);
@@ -210,7 +444,82 @@ namespace eosio::trace_api {
        */
       get_block_t get_block(uint32_t block_height, const yield_function& yield= {});
 
+      /**
+       * Read the trace of the block on the current fork that contains a given transaction, searching the
+       * transaction id files of the slices from the newest to the oldest
+       * @param id : the id of the transaction
+       * @return empty optional if no block on the current fork contains the transaction OTHERWISE
+       *         optional containing a 2-tuple of the block_trace and a flag indicating irreversibility
+       */
+      get_block_t get_transaction_block(const chain::transaction_id_type& id, const yield_function& yield = {});
+
+      /**
+       * Have the trace files of the slices of a range of blocks read ahead of reading those blocks in order, as many of
+       * them as stay mapped
+       */
+      void prefetch_blocks(uint32_t first_block, uint32_t last_block);
+
    protected:
+      /**
+       * Find the offset in the data log of the block at a given height on the current fork, which is the last
+       * block entry of that height in the metadata log.  It is read from the slice's block offset file, slices
+       * without one have their metadata log scanned.
+       * @param block_height : the height of the block
+       * @return empty optional if there is no such block OTHERWISE
+       *         optional containing a 2-tuple of the offset and a flag indicating irreversibility
+       */
+      std::optional<std::tuple<uint64_t, bool>> get_block_offset(uint32_t block_height, const yield_function& yield);
+
+      /**
+       * Open the block offset file of a slice to be written to
+       * @param new_slice : if the slice's index was just created, in which case the block offset file is created
+       * @return false if the slice was started without a block offset file, which is then left without one
+       */
+      bool open_block_offset_slice(uint32_t slice_number, bool new_slice, fc::cfile& block_offsets);
+
+      /**
+       * Rewrite the trace file of a slice with a compressed frame for each block, and the offsets in the slice's other
+       * files with the offsets of the frames.  The rewritten files are written next to the slice files and renamed
+       * into place once complete, the trace file last; the rename of the trace file to its ".compressed" name commits
+       * the rewrite, so that a restart completes it.  The frames are read back and checked against the blocks before
+       * the rewrite is committed.
+       * @return false if the slice has no trace file or it is already compressed
+       */
+      bool compress_slice(uint32_t slice_number);
+
+      /// hand lib to the maintenance thread, starting it on first use
+      void schedule_maintenance(uint32_t lib);
+
+      /// run maintenance passes for the latest lib handed over, until destroyed
+      void maintenance_loop();
+
+      /**
+       * Remove the slices no longer needed and compress the next slice that is far enough behind lib
+       * @return true if more slices are left to compress for this lib
+       */
+      bool run_maintenance(uint32_t lib);
+
+      /// block until the maintenance thread has nothing left to do for the lib last appended
+      void wait_for_maintenance();
+
+      /// account for bytes of slice files read or written by maintenance, throws maintenance_stopped once destroyed
+      void throttle_maintenance(uint64_t bytes);
+
+      /// take a slice file out of view of readers and remove it in steps
+      void remove_slice_file(uint32_t slice_number, const boost::filesystem::path& slice_file);
+
+      /**
+       * Compress the next slice that is far enough behind lib, if any
+       * @return true if more slices are left to compress for this lib
+       */
+      bool compress_next_slice(uint32_t lib);
+
+      /// rename the rewritten files of a slice into place
+      void install_compressed_slice(uint32_t slice_number);
+
+      /// complete the compressions committed before a restart, remove the files of the uncommitted ones and finish removals
+      void recover_slice_maintenance();
+
       /**
        * Read the metadata log font-to-back starting at an offset passing each entry to a provided functor/lambda
        *
@@ -256,20 +565,21 @@ namespace eosio::trace_api {
       std::optional<data_log_entry> read_data_log( uint32_t block_height, uint64_t offset ) {
          const uint32_t slice_number = _slice_directory.slice_number(block_height);
          fc::cfile trace;
-         if( !_slice_directory.find_trace_slice(slice_number, open_state::read, trace) ) {
+         // only checks that the file exists, it is read through the read cache
+         if( !_slice_directory.find_trace_slice(slice_number, open_state::read, trace, false) ) {
             const std::string offset_str = boost::lexical_cast<std::string>(offset);
             const std::string bh_str = boost::lexical_cast<std::string>(block_height);
             throw malformed_slice_file("Requested offset: " + offset_str + " to retrieve block number: " + bh_str + " but this trace file is new, so there are no traces present.");
          }
-         const uint64_t end = file_size(trace.get_file_path());
-         if( offset >= end ) {
+         auto entry = _read_cache.read(slice_number, trace.get_file_path(), offset);
+         if( !entry ) {
+            const uint64_t end = file_size(trace.get_file_path());
             const std::string offset_str = boost::lexical_cast<std::string>(offset);
             const std::string bh_str = boost::lexical_cast<std::string>(block_height);
             const std::string end_str = boost::lexical_cast<std::string>(end);
             throw malformed_slice_file("Requested offset: " + offset_str + " to retrieve block number: " + bh_str + " but this trace file only goes to offset: " + end_str);
          }
-         trace.seek(offset);
-         return extract_store<data_log_entry>(trace);
+         return entry;
       }
 
       /**
@@ -288,6 +598,21 @@ namespace eosio::trace_api {
       void validate_existing_index_slice_file(fc::cfile& index, open_state state);
 
       slice_directory _slice_directory;
+      slice_read_cache _read_cache;
+
+      trace_codec _codec = trace_codec::none;
+      uint32_t _minimum_uncompressed_irreversible_history_blocks = 0;
+      uint32_t _next_compression_slice = 0;
+      // shared by reads, exclusive while the files of a slice are renamed into or out of place
+      std::shared_mutex _compression_mtx;
+
+      uint64_t _maintenance_bytes_per_second = 0;
+      std::mutex _maintenance_mtx;
+      std::condition_variable _maintenance_cv;
+      std::optional<uint32_t> _maintenance_lib;
+      bool _maintenance_running = false;
+      bool _maintenance_stopping = false;
+      std::thread _maintenance_thread;
    };
 
 }
@@ -0,0 +1,20 @@
+#pragma once
+#include <fc/reflect/reflect.hpp>
+#include <eosio/chain/types.hpp>
+
+namespace eosio { namespace trace_api {
+   /**
+    * One entry per transaction of every block appended to a slice, forks included.  Entries are fixed size, so a
+    * slice's transaction id log can be read in large chunks.
+    */
+   struct trx_id_entry_v0 {
+      static constexpr uint64_t packed_size = sizeof(chain::transaction_id_type) + sizeof(uint32_t) + sizeof(uint64_t);
+
+      chain::transaction_id_type id;
+      uint32_t                   block_num;
+      uint64_t                   offset; ///< offset of the block in the slice's data log
+   };
+
+}}
+
+FC_REFLECT(eosio::trace_api::trx_id_entry_v0, (id)(block_num)(offset));
@@ -1,6 +1,7 @@
 #include <eosio/trace_api/request_handler.hpp>
 
 #include <algorithm>
+#include <unordered_map>
 
 #include <fc/variant_object.hpp>
 
@@ -27,13 +28,18 @@ namespace {
 
    }
 
-   fc::variants process_actions(const std::vector<action_trace_v0>& actions, const data_handler_function& data_handler, const yield_function& yield ) {
+   fc::variants process_actions(const std::vector<action_trace_v0>& actions, const data_handler_function& data_handler, const yield_function& yield, const action_filter& filter ) {
       fc::variants result;
       result.reserve(actions.size());
 
       // create a vector of indices to sort based on actions to avoid copies
-      std::vector<int> indices(actions.size());
-      std::iota(indices.begin(), indices.end(), 0);
+      std::vector<int> indices;
+      indices.reserve(actions.size());
+      for (int index = 0; index < static_cast<int>(actions.size()); ++index) {
+         if (filter.matches(actions.at(index))) {
+            indices.push_back(index);
+         }
+      }
       std::sort(indices.begin(), indices.end(), [&actions](const int& lhs, const int& rhs) -> bool {
          return actions.at(lhs).global_sequence < actions.at(rhs).global_sequence;
       });
@@ -61,25 +67,75 @@ namespace {
 
    }
 
-   fc::variants process_transactions(const std::vector<transaction_trace_v0>& transactions, const data_handler_function& data_handler, const yield_function& yield ) {
+   fc::variants process_transactions(const std::vector<transaction_trace_v0>& transactions, const data_handler_function& data_handler, const yield_function& yield, const action_filter& filter ) {
       fc::variants result;
       result.reserve(transactions.size());
       for ( const auto& t: transactions) {
          yield();
 
+         auto actions = process_actions(t.actions, data_handler, yield, filter);
+         if (actions.empty() && !filter.empty()) {
+            continue;
+         }
          result.emplace_back(fc::mutable_variant_object()
             ("id", t.id.str())
-            ("actions", process_actions(t.actions, data_handler, yield))
+            ("actions", std::move(actions))
          );
       }
 
       return result;
    }
 
+   /**
+    * Decode the data of actions up front, in parallel, decoding being most of the cost of a response
+    * @return a data handler that returns the decoded data of those actions
+    */
+   data_handler_function predecode_actions(const std::vector<const action_trace_v0*>& actions, const data_handler_function& data_handler, const parallel_function& parallel) {
+      if (!parallel || actions.size() < 2) {
+         return data_handler;
+      }
+
+      auto decoded = std::make_shared<std::unordered_map<const action_trace_v0*, fc::variant>>();
+      std::vector<fc::variant> params(actions.size());
+      parallel(actions.size(), [&actions, &params, &data_handler](std::size_t i) {
+         params[i] = data_handler(*actions[i], yield_function());
+      });
+      decoded->reserve(actions.size());
+      for (std::size_t i = 0; i < actions.size(); ++i) {
+         decoded->emplace(actions[i], std::move(params[i]));
+      }
+
+      return [decoded, data_handler](const action_trace_v0& a, const yield_function& yield) -> fc::variant {
+         const auto itr = decoded->find(&a);
+         return itr != decoded->end() ? itr->second : data_handler(a, yield);
+      };
+   }
+
+   std::vector<const action_trace_v0*> actions_of(const std::vector<action_trace_v0>& actions) {
+      std::vector<const action_trace_v0*> result;
+      result.reserve(actions.size());
+      for (const auto& a : actions) {
+         result.push_back(&a);
+      }
+      return result;
+   }
 }
 
 namespace eosio::trace_api::detail {
-   fc::variant response_formatter::process_block( const block_trace_v0& trace, bool irreversible, const data_handler_function& data_handler, const yield_function& yield ) {
+   fc::variant response_formatter::process_block( const block_trace_v0& trace, bool irreversible, const data_handler_function& data_handler, const yield_function& yield, const parallel_function& parallel, const action_filter& filter ) {
+      // all of the actions of the block are decoded together
+      std::vector<const action_trace_v0*> actions;
+      if (parallel) {
+         for (const auto& t : trace.transactions) {
+            for (const auto& a : t.actions) {
+               if (filter.matches(a)) {
+                  actions.push_back(&a);
+               }
+            }
+         }
+      }
+      const auto block_data_handler = predecode_actions(actions, data_handler, parallel);
+
       return fc::mutable_variant_object()
          ("id", trace.id.str() )
          ("number", trace.number )
@@ -87,6 +143,24 @@ namespace eosio::trace_api::detail {
          ("status", irreversible ? "irreversible" : "pending" )
          ("timestamp", to_iso8601_datetime(trace.timestamp))
          ("producer", trace.producer.to_string())
-         ("transactions", process_transactions(trace.transactions, data_handler, yield ));
+         ("transactions", process_transactions(trace.transactions, block_data_handler, yield, filter ));
+   }
+
+   fc::variant response_formatter::process_transaction( const block_trace_v0& trace, bool irreversible, const chain::transaction_id_type& id, const data_handler_function& data_handler, const yield_function& yield, const parallel_function& parallel ) {
+      const auto itr = std::find_if(trace.transactions.begin(), trace.transactions.end(), [&id](const transaction_trace_v0& t) {
+         return t.id == id;
+      });
+      if (itr == trace.transactions.end()) {
+         return {};
+      }
+
+      return fc::mutable_variant_object()
+         ("id", itr->id.str() )
+         ("block_num", trace.number )
+         ("block_id", trace.id.str() )
+         ("status", irreversible ? "irreversible" : "pending" )
+         ("timestamp", to_iso8601_datetime(trace.timestamp))
+         ("producer", trace.producer.to_string())
+         ("actions", process_actions(itr->actions, predecode_actions(actions_of(itr->actions), data_handler, parallel), yield, action_filter() ));
    }
 }
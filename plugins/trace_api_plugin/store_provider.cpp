@@ -1,28 +1,136 @@
 #include <eosio/trace_api/store_provider.hpp>
 
 #include <fc/variant_object.hpp>
+#include <fc/crypto/sha256.hpp>
+#include <fc/log/logger_config.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 namespace {
       static constexpr uint32_t _current_version = 1;
       static constexpr const char* _trace_prefix = "trace_";
       static constexpr const char* _trace_index_prefix = "trace_index_";
+      static constexpr const char* _trace_trx_id_prefix = "trace_trx_id_";
+      static constexpr const char* _trace_block_offset_prefix = "trace_block_offset_";
       static constexpr const char* _trace_ext = ".log";
-      static constexpr uint _max_filename_size = std::char_traits<char>::length(_trace_index_prefix) + 10 + 1 + 10 + std::char_traits<char>::length(_trace_ext) + 1; // "trace_index_" + 10-digits + '-' + 10-digits + ".log" + null-char
+      static constexpr uint _max_filename_size = std::char_traits<char>::length(_trace_block_offset_prefix) + 10 + 1 + 10 + std::char_traits<char>::length(_trace_ext) + 1; // "trace_block_offset_" + 10-digits + '-' + 10-digits + ".log" + null-char
+      static constexpr uint64_t _trx_id_entries_per_read = 4096;
+      static constexpr const char* _compressing_ext = ".compressing"; // a rewritten slice file, not yet in place
+      static constexpr const char* _compressed_ext = ".compressed";   // a rewritten trace file, commits the rewrite
+      static constexpr const char* _removing_ext = ".removing";       // a cleaned up slice file, being removed
+      static constexpr uint64_t _removal_chunk_size = 16 * 1024 * 1024;
 }
 
 namespace eosio::trace_api {
    namespace bfs = boost::filesystem;
-   store_provider::store_provider(const bfs::path& slice_dir, uint32_t stride_width, std::optional<uint32_t> minimum_irreversible_history_blocks)
-   : _slice_directory(slice_dir, stride_width, minimum_irreversible_history_blocks) {
+
+   namespace {
+      bfs::path with_ext(const bfs::path& p, const char* ext) {
+         return bfs::path(p.string() + ext);
+      }
+
+      // readers of the data log only see block_trace_v0 entries
+      void decode_frame(data_log_entry& entry) {
+         if (entry.contains<compressed_block_trace_v0>()) {
+            const auto& frame = entry.get<compressed_block_trace_v0>();
+            const auto raw = decompress(static_cast<trace_codec>(frame.codec), frame.data);
+            entry = fc::raw::unpack<block_trace_v0>(raw);
+         }
+      }
+
+      void write_and_sync(fc::cfile& file, const std::vector<char>& data) {
+         file.write(data.data(), data.size());
+         file.flush();
+         file.sync();
+      }
+
+      // the maintenance thread only gets the disk when nothing else wants it
+      void lower_io_priority() {
+#if defined(__linux__) && defined(SYS_ioprio_set)
+         constexpr int ioprio_who_process = 1;
+         constexpr int ioprio_class_idle = 3;
+         constexpr int ioprio_class_shift = 13;
+         // a process id of 0 is the calling thread
+         if (syscall(SYS_ioprio_set, ioprio_who_process, 0, ioprio_class_idle << ioprio_class_shift) != 0) {
+            wlog("Unable to lower the I/O priority of the trace maintenance thread");
+         }
+#endif
+      }
+   }
+
+   store_provider::store_provider(const bfs::path& slice_dir, uint32_t stride_width, std::optional<uint32_t> minimum_irreversible_history_blocks,
+                                  uint32_t max_mapped_slices, uint32_t max_cached_entries)
+   : _slice_directory(slice_dir, stride_width, minimum_irreversible_history_blocks)
+   , _read_cache(max_mapped_slices, max_cached_entries) {
+      recover_slice_maintenance();
+   }
+
+   store_provider::~store_provider() {
+      if (_maintenance_thread.joinable()) {
+         {
+            std::lock_guard<std::mutex> g(_maintenance_mtx);
+            _maintenance_stopping = true;
+         }
+         _maintenance_cv.notify_all();
+         _maintenance_thread.join();
+      }
+   }
+
+   void store_provider::set_compression(trace_codec codec, uint32_t minimum_uncompressed_irreversible_history_blocks) {
+      _codec = codec;
+      _minimum_uncompressed_irreversible_history_blocks = minimum_uncompressed_irreversible_history_blocks;
+   }
+
+   void store_provider::set_maintenance_rate(uint64_t max_bytes_per_second) {
+      _maintenance_bytes_per_second = max_bytes_per_second;
    }
 
    void store_provider::append(const block_trace_v0& bt) {
       fc::cfile trace;
       fc::cfile index;
       const uint32_t slice_number = _slice_directory.slice_number(bt.number);
+      const bool new_slice = !_slice_directory.find_index_slice(slice_number, open_state::read, index, false);
       _slice_directory.find_or_create_slice_pair(slice_number, open_state::write, trace, index);
-      // storing as static_variant to allow adding other data types to the trace file in the future
-      const uint64_t offset = append_store(data_log_entry { bt }, trace);
+      // storing as static_variant to allow adding other data types to the trace file in the future; packed the way
+      // data_log_entry { bt } packs, without first copying the data of every action of the block into the variant
+      static const fc::unsigned_int block_trace_tag = data_log_entry(block_trace_v0{}).which();
+      std::vector<char> packed(fc::raw::pack_size(block_trace_tag) + fc::raw::pack_size(bt));
+      fc::datastream<char*> ds(packed.data(), packed.size());
+      fc::raw::pack(ds, block_trace_tag);
+      fc::raw::pack(ds, bt);
+      const uint64_t offset = append_packed_store(packed, trace);
+
+      // written before the block entry, an entry for a block that never got into the metadata log is never on the current fork
+      if (!bt.transactions.empty()) {
+         fc::cfile trx_ids;
+         _slice_directory.find_or_create_trx_id_slice(slice_number, open_state::write, trx_ids);
+         std::vector<char> data;
+         data.reserve(bt.transactions.size() * trx_id_entry_v0::packed_size);
+         for (const auto& t : bt.transactions) {
+            const auto entry = fc::raw::pack(trx_id_entry_v0 { .id = t.id, .block_num = bt.number, .offset = offset });
+            data.insert(data.end(), entry.begin(), entry.end());
+         }
+         trx_ids.write(data.data(), data.size());
+         trx_ids.flush();
+         trx_ids.sync();
+      }
+
+      // also before the block entry, an offset is only found once the block it refers to is written
+      fc::cfile block_offsets;
+      if (open_block_offset_slice(slice_number, new_slice, block_offsets)) {
+         const uint64_t entry = offset + 1;
+         block_offsets.seek(_slice_directory.block_offset_pos(bt.number));
+         block_offsets.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+         block_offsets.flush();
+         block_offsets.sync();
+      }
 
       auto be = metadata_log_entry { block_entry_v0 { .id = bt.id, .number = bt.number, .offset = offset }};
       append_store(be, index);
@@ -31,13 +139,380 @@ namespace eosio::trace_api {
    void store_provider::append_lib(uint32_t lib) {
       fc::cfile index;
       const uint32_t slice_number = _slice_directory.slice_number(lib);
-      _slice_directory.find_or_create_index_slice(slice_number, open_state::write, index);
+      const bool new_slice = !_slice_directory.find_or_create_index_slice(slice_number, open_state::write, index);
       auto le = metadata_log_entry { lib_entry_v0 { .lib = lib }};
       append_store(le, index);
-      _slice_directory.cleanup_old_slices(lib);
+
+      fc::cfile block_offsets;
+      if (open_block_offset_slice(slice_number, new_slice, block_offsets)) {
+         block_offsets.seek(slice_directory::block_offset_lib_pos);
+         block_offsets.write(reinterpret_cast<const char*>(&lib), sizeof(lib));
+         block_offsets.flush();
+         block_offsets.sync();
+      }
+
+      schedule_maintenance(lib);
    }
 
-   get_block_t store_provider::get_block(uint32_t block_height, const yield_function& yield) {
+   void store_provider::schedule_maintenance(uint32_t lib) {
+      if (!_slice_directory.cleans_up_slices() && _codec == trace_codec::none) {
+         return;
+      }
+      {
+         std::lock_guard<std::mutex> g(_maintenance_mtx);
+         _maintenance_lib = lib;
+         if (!_maintenance_thread.joinable()) {
+            _maintenance_thread = std::thread([this]() {
+               fc::set_os_thread_name("trace-maint");
+               lower_io_priority();
+               maintenance_loop();
+            });
+         }
+      }
+      _maintenance_cv.notify_all();
+   }
+
+   void store_provider::maintenance_loop() {
+      std::unique_lock<std::mutex> g(_maintenance_mtx);
+      while (true) {
+         _maintenance_cv.wait(g, [this]() { return _maintenance_stopping || _maintenance_lib; });
+         if (_maintenance_stopping) {
+            return;
+         }
+         const uint32_t lib = *_maintenance_lib;
+         _maintenance_lib.reset();
+         _maintenance_running = true;
+         g.unlock();
+         bool more = false;
+         try {
+            more = run_maintenance(lib);
+         } catch (const maintenance_stopped&) {
+         } catch (const std::exception& e) {
+            elog("Trace slice maintenance failed: ${e}", ("e", e.what()));
+         }
+         g.lock();
+         _maintenance_running = false;
+         // continued for the same lib, unless a newer one came in meanwhile
+         if (more && !_maintenance_lib) {
+            _maintenance_lib = lib;
+         }
+         _maintenance_cv.notify_all();
+      }
+   }
+
+   bool store_provider::run_maintenance(uint32_t lib) {
+      _slice_directory.cleanup_old_slices(lib, [this](uint32_t slice_number, const bfs::path& slice_file) {
+         remove_slice_file(slice_number, slice_file);
+      });
+      if (const auto cleaned = _slice_directory.last_cleaned_up_slice()) {
+         _read_cache.remove_slices_through(*cleaned);
+      }
+      return compress_next_slice(lib);
+   }
+
+   void store_provider::wait_for_maintenance() {
+      std::unique_lock<std::mutex> g(_maintenance_mtx);
+      _maintenance_cv.wait(g, [this]() { return !_maintenance_lib && !_maintenance_running; });
+   }
+
+   void store_provider::throttle_maintenance(uint64_t bytes) {
+      std::unique_lock<std::mutex> g(_maintenance_mtx);
+      if (_maintenance_bytes_per_second > 0) {
+         const auto delay = std::chrono::microseconds(bytes * 1'000'000 / _maintenance_bytes_per_second);
+         _maintenance_cv.wait_for(g, delay, [this]() { return _maintenance_stopping; });
+      }
+      if (_maintenance_stopping) {
+         throw maintenance_stopped("trace slice maintenance stopped");
+      }
+   }
+
+   void store_provider::remove_slice_file(uint32_t slice_number, const bfs::path& slice_file) {
+      const auto removing = with_ext(slice_file, _removing_ext);
+      {
+         // once renamed no reader finds the file, and none has it mapped
+         std::unique_lock<std::shared_mutex> g(_compression_mtx);
+         bfs::rename(slice_file, removing);
+         _read_cache.remove_slice(slice_number);
+      }
+      // removing a large file at once can stall the disk for the appends
+      uint64_t size = file_size(removing);
+      while (size > _removal_chunk_size) {
+         size -= _removal_chunk_size;
+         bfs::resize_file(removing, size);
+         throttle_maintenance(_removal_chunk_size);
+      }
+      bfs::remove(removing);
+   }
+
+   bool store_provider::compress_next_slice(uint32_t lib) {
+      if (_codec == trace_codec::none) {
+         return false;
+      }
+      const int64_t uncompressed_block_number = static_cast<int64_t>(lib) - static_cast<int64_t>(_minimum_uncompressed_irreversible_history_blocks);
+      if (uncompressed_block_number <= 0) {
+         return false;
+      }
+      // every block of the slices before this one is far enough behind lib
+      const uint32_t end_slice = _slice_directory.slice_number(static_cast<uint32_t>(uncompressed_block_number));
+      if (const auto cleaned = _slice_directory.last_cleaned_up_slice()) {
+         _next_compression_slice = std::max(_next_compression_slice, *cleaned + 1);
+      }
+      for (; _next_compression_slice < end_slice; ++_next_compression_slice) {
+         fc::cfile trace;
+         if (!_slice_directory.find_trace_slice(_next_compression_slice, open_state::read, trace, false)) {
+            continue;
+         }
+         const uint32_t slice_number = _next_compression_slice++;
+         try {
+            if (compress_slice(slice_number)) {
+               ilog("Compressed trace slice ${s}", ("s", slice_number));
+            }
+         } catch (const maintenance_stopped&) {
+            throw;
+         } catch (const std::exception& e) {
+            elog("Unable to compress trace slice ${s}: ${e}", ("s", slice_number)("e", e.what()));
+         }
+         return _next_compression_slice < end_slice;
+      }
+      return false;
+   }
+
+   bool store_provider::compress_slice(uint32_t slice_number) {
+      fc::cfile trace;
+      if (!_slice_directory.find_trace_slice(slice_number, open_state::read, trace)) {
+         return false;
+      }
+      const uint64_t trace_end = file_size(trace.get_file_path());
+      if (trace_end == 0) {
+         return false;
+      }
+      // the variant tag of the first entry, a slice is rewritten as a whole
+      char tag = 0;
+      trace.read(&tag, sizeof(tag));
+      if (tag == data_log_entry(compressed_block_trace_v0{}).which()) {
+         return false;
+      }
+      trace.seek(0);
+
+      fc::cfile index;
+      fc::cfile block_offsets;
+      fc::cfile trx_ids;
+      const bool index_found = _slice_directory.find_index_slice(slice_number, open_state::read, index);
+      const bool block_offsets_found = _slice_directory.find_block_offset_slice(slice_number, block_offsets);
+      const bool trx_ids_found = _slice_directory.find_trx_id_slice(slice_number, open_state::read, trx_ids);
+      const std::vector<bfs::path> rewritten = {
+         with_ext(trace.get_file_path(), _compressing_ext), with_ext(index.get_file_path(), _compressing_ext),
+         with_ext(block_offsets.get_file_path(), _compressing_ext), with_ext(trx_ids.get_file_path(), _compressing_ext)
+      };
+
+      try {
+         // the frames, and the offset of the frame of the entry at each offset of the trace file
+         std::map<uint64_t, uint64_t> offsets;
+         fc::sha256::encoder original_traces;
+         fc::cfile out;
+         out.set_file_path(rewritten[0]);
+         out.open("wb");
+         uint64_t offset = 0;
+         while (offset < trace_end) {
+            auto entry = extract_store<data_log_entry>(trace);
+            if (entry.contains<block_trace_v0>()) {
+               const auto packed = fc::raw::pack(entry.get<block_trace_v0>());
+               original_traces.write(packed.data(), packed.size());
+               entry = compressed_block_trace_v0 { static_cast<uint8_t>(_codec), compress(_codec, packed) };
+            }
+            offsets.emplace(offset, out.tellp());
+            const auto data = fc::raw::pack(entry);
+            out.write(data.data(), data.size());
+            const uint64_t next_offset = trace.tellp();
+            throttle_maintenance(next_offset - offset + data.size());
+            offset = next_offset;
+         }
+         out.flush();
+         out.sync();
+         out.close();
+
+         // verify the frames as written decompress to the traces
+         fc::sha256::encoder written_traces;
+         out.open("rb");
+         const uint64_t out_end = file_size(rewritten[0]);
+         while (static_cast<uint64_t>(out.tellp()) < out_end) {
+            const uint64_t frame_offset = out.tellp();
+            auto entry = extract_store<data_log_entry>(out);
+            if (entry.contains<compressed_block_trace_v0>() && entry.get<compressed_block_trace_v0>().codec == static_cast<uint8_t>(_codec)) {
+               decode_frame(entry);
+               const auto packed = fc::raw::pack(entry.get<block_trace_v0>());
+               written_traces.write(packed.data(), packed.size());
+            }
+            throttle_maintenance(static_cast<uint64_t>(out.tellp()) - frame_offset);
+         }
+         out.close();
+         if (original_traces.result() != written_traces.result()) {
+            throw malformed_slice_file("The compressed trace file of slice " + std::to_string(slice_number) + " does not match its traces");
+         }
+
+         auto frame_offset = [&offsets, slice_number](uint64_t old_offset) {
+            const auto itr = offsets.find(old_offset);
+            if (itr == offsets.end()) {
+               throw malformed_slice_file("Slice " + std::to_string(slice_number) + " refers to offset " +
+                                          std::to_string(old_offset) + " which is not the start of an entry in its trace file");
+            }
+            return itr->second;
+         };
+
+         if (index_found) {
+            const uint64_t end = file_size(index.get_file_path());
+            auto data = fc::raw::pack(slice_directory::index_header { .version = _current_version });
+            while (static_cast<uint64_t>(index.tellp()) < end) {
+               auto entry = extract_store<metadata_log_entry>(index);
+               if (entry.contains<block_entry_v0>()) {
+                  auto& block = entry.get<block_entry_v0>();
+                  block.offset = frame_offset(block.offset);
+               }
+               const auto packed = fc::raw::pack(entry);
+               data.insert(data.end(), packed.begin(), packed.end());
+            }
+            out.set_file_path(rewritten[1]);
+            out.open("wb");
+            write_and_sync(out, data);
+            out.close();
+         }
+
+         if (block_offsets_found) {
+            std::vector<char> data(file_size(block_offsets.get_file_path()));
+            block_offsets.seek(0);
+            block_offsets.read(data.data(), data.size());
+            for (uint64_t pos = _slice_directory.block_offset_pos(0); pos + sizeof(uint64_t) <= data.size(); pos += sizeof(uint64_t)) {
+               uint64_t entry = 0;
+               std::memcpy(&entry, data.data() + pos, sizeof(entry));
+               if (entry != 0) {
+                  entry = frame_offset(entry - 1) + 1;
+                  std::memcpy(data.data() + pos, &entry, sizeof(entry));
+               }
+            }
+            out.set_file_path(rewritten[2]);
+            out.open("wb");
+            write_and_sync(out, data);
+            out.close();
+         }
+
+         if (trx_ids_found) {
+            out.set_file_path(rewritten[3]);
+            out.open("wb");
+            const auto header = fc::raw::pack(slice_directory::index_header { .version = _current_version });
+            out.write(header.data(), header.size());
+            const uint64_t end = file_size(trx_ids.get_file_path());
+            uint64_t pos = trx_ids.tellp();
+            std::vector<char> buffer;
+            while (pos + trx_id_entry_v0::packed_size <= end) {
+               const uint64_t entries = std::min(_trx_id_entries_per_read, (end - pos) / trx_id_entry_v0::packed_size);
+               buffer.resize(entries * trx_id_entry_v0::packed_size);
+               trx_ids.read(buffer.data(), buffer.size());
+               fc::datastream<const char*> in(buffer.data(), buffer.size());
+               std::vector<char> data;
+               data.reserve(buffer.size());
+               for (uint64_t i = 0; i < entries; ++i) {
+                  trx_id_entry_v0 entry;
+                  fc::raw::unpack(in, entry);
+                  entry.offset = frame_offset(entry.offset);
+                  const auto packed = fc::raw::pack(entry);
+                  data.insert(data.end(), packed.begin(), packed.end());
+               }
+               out.write(data.data(), data.size());
+               pos += buffer.size();
+               throttle_maintenance(2 * buffer.size());
+            }
+            out.flush();
+            out.sync();
+            out.close();
+         }
+
+         bfs::rename(rewritten[0], with_ext(trace.get_file_path(), _compressed_ext));
+      } catch (...) {
+         for (const auto& p : rewritten) {
+            bfs::remove(p);
+         }
+         throw;
+      }
+
+      install_compressed_slice(slice_number);
+      return true;
+   }
+
+   void store_provider::install_compressed_slice(uint32_t slice_number) {
+      fc::cfile trace;
+      fc::cfile index;
+      fc::cfile block_offsets;
+      fc::cfile trx_ids;
+      const bool dont_open_file = false;
+      _slice_directory.find_trace_slice(slice_number, open_state::read, trace, dont_open_file);
+      _slice_directory.find_index_slice(slice_number, open_state::read, index, dont_open_file);
+      _slice_directory.find_block_offset_slice(slice_number, block_offsets, dont_open_file);
+      _slice_directory.find_trx_id_slice(slice_number, open_state::read, trx_ids, dont_open_file);
+
+      std::unique_lock<std::shared_mutex> g(_compression_mtx);
+      for (const auto& p : { index.get_file_path(), block_offsets.get_file_path(), trx_ids.get_file_path() }) {
+         if (exists(with_ext(p, _compressing_ext))) {
+            bfs::rename(with_ext(p, _compressing_ext), p);
+         }
+      }
+      bfs::rename(with_ext(trace.get_file_path(), _compressed_ext), trace.get_file_path());
+      _read_cache.remove_slice(slice_number);
+   }
+
+   void store_provider::recover_slice_maintenance() {
+      const std::string prefix = _trace_prefix;
+      std::vector<uint32_t> committed;
+      std::vector<bfs::path> uncommitted;
+      for (const auto& entry : bfs::directory_iterator(_slice_directory.slice_dir())) {
+         const auto filename = entry.path().filename().string();
+         if (entry.path().extension() == _compressing_ext || entry.path().extension() == _removing_ext) {
+            uncommitted.push_back(entry.path());
+         } else if (entry.path().extension() == _compressed_ext && filename.compare(0, prefix.size(), prefix) == 0) {
+            try {
+               committed.push_back(_slice_directory.slice_number(std::stoul(filename.substr(prefix.size(), 10))));
+            } catch (const std::logic_error&) {
+               // not a slice file
+            }
+         }
+      }
+      for (const auto slice_number : committed) {
+         ilog("Completing the interrupted compression of trace slice ${s}", ("s", slice_number));
+         install_compressed_slice(slice_number);
+      }
+      for (const auto& p : uncommitted) {
+         if (exists(p)) {
+            bfs::remove(p);
+         }
+      }
+   }
+
+   bool store_provider::open_block_offset_slice(uint32_t slice_number, bool new_slice, fc::cfile& block_offsets) {
+      if (new_slice) {
+         _slice_directory.create_block_offset_slice(slice_number, block_offsets);
+         return true;
+      }
+      return _slice_directory.find_block_offset_slice(slice_number, block_offsets);
+   }
+
+   std::optional<std::tuple<uint64_t, bool>> store_provider::get_block_offset(uint32_t block_height, const yield_function& yield) {
+      fc::cfile block_offsets;
+      if (_slice_directory.find_block_offset_slice(_slice_directory.slice_number(block_height), block_offsets)) {
+         uint32_t lib = 0;
+         uint64_t entry = 0;
+         block_offsets.seek(slice_directory::block_offset_lib_pos);
+         block_offsets.read(reinterpret_cast<char*>(&lib), sizeof(lib));
+         const uint64_t pos = _slice_directory.block_offset_pos(block_height);
+         // the file only extends as far as the highest block written to it
+         if (pos + sizeof(entry) <= file_size(block_offsets.get_file_path())) {
+            block_offsets.seek(pos);
+            block_offsets.read(reinterpret_cast<char*>(&entry), sizeof(entry));
+         }
+         if (entry == 0) {
+            return {};
+         }
+         return std::make_tuple( entry - 1, lib >= block_height );
+      }
+
       std::optional<uint64_t> trace_offset;
       bool irreversible = false;
       uint64_t offset = scan_metadata_log_from(block_height, 0, [&block_height, &trace_offset, &irreversible](const metadata_log_entry& e) -> bool {
@@ -56,14 +531,172 @@ namespace eosio::trace_api {
          return true;
       }, yield);
       if (!trace_offset) {
+         return {};
+      }
+      return std::make_tuple( *trace_offset, irreversible );
+   }
+
+   get_block_t store_provider::get_block(uint32_t block_height, const yield_function& yield) {
+      std::shared_lock<std::shared_mutex> g(_compression_mtx);
+      const auto block_offset = get_block_offset(block_height, yield);
+      if (!block_offset) {
          return get_block_t{};
       }
-      std::optional<data_log_entry> entry = read_data_log(block_height, *trace_offset);
+      std::optional<data_log_entry> entry = read_data_log(block_height, std::get<0>(*block_offset));
       if (!entry) {
          return get_block_t{};
       }
       const auto bt = entry->get<block_trace_v0>();
-      return std::make_tuple( bt, irreversible );
+      return std::make_tuple( bt, std::get<1>(*block_offset) );
+   }
+
+   get_block_t store_provider::get_transaction_block(const chain::transaction_id_type& id, const yield_function& yield) {
+      std::shared_lock<std::shared_mutex> g(_compression_mtx);
+      const auto slices = _slice_directory.trx_id_slice_numbers();
+      std::vector<char> buffer;
+      for (auto slice = slices.rbegin(); slice != slices.rend(); ++slice) {
+         fc::cfile trx_ids;
+         if (!_slice_directory.find_trx_id_slice(*slice, open_state::read, trx_ids)) {
+            continue; // cleaned up since the directory was listed
+         }
+         std::vector<trx_id_entry_v0> matches;
+         const uint64_t end = file_size(trx_ids.get_file_path());
+         uint64_t offset = trx_ids.tellp();
+         while (offset + trx_id_entry_v0::packed_size <= end) {
+            yield();
+            const uint64_t entries = std::min(_trx_id_entries_per_read, (end - offset) / trx_id_entry_v0::packed_size);
+            buffer.resize(entries * trx_id_entry_v0::packed_size);
+            trx_ids.read(buffer.data(), buffer.size());
+            fc::datastream<const char*> ds(buffer.data(), buffer.size());
+            for (uint64_t i = 0; i < entries; ++i) {
+               trx_id_entry_v0 entry;
+               fc::raw::unpack(ds, entry);
+               if (entry.id == id) {
+                  matches.push_back(entry);
+               }
+            }
+            offset += buffer.size();
+         }
+
+         // a transaction has more than one entry only when it was in blocks of several forks, the last is the most recent
+         for (auto match = matches.rbegin(); match != matches.rend(); ++match) {
+            const auto block_offset = get_block_offset(match->block_num, yield);
+            if (!block_offset || std::get<0>(*block_offset) != match->offset) {
+               continue;
+            }
+            std::optional<data_log_entry> entry = read_data_log(match->block_num, match->offset);
+            if (!entry) {
+               return get_block_t{};
+            }
+            return std::make_tuple( entry->get<block_trace_v0>(), std::get<1>(*block_offset) );
+         }
+      }
+      return get_block_t{};
+   }
+
+   void store_provider::prefetch_blocks(uint32_t first_block, uint32_t last_block) {
+      if (_read_cache.max_mappings() == 0 || first_block > last_block) {
+         return;
+      }
+      std::shared_lock<std::shared_mutex> g(_compression_mtx);
+      const uint32_t first_slice = _slice_directory.slice_number(first_block);
+      const uint32_t last_slice = std::min<uint64_t>(_slice_directory.slice_number(last_block),
+                                                     uint64_t(first_slice) + _read_cache.max_mappings() - 1);
+      for (uint64_t slice_number = first_slice; slice_number <= last_slice; ++slice_number) {
+         fc::cfile trace;
+         if (_slice_directory.find_trace_slice(slice_number, open_state::read, trace, false)) {
+            _read_cache.prefetch(slice_number, trace.get_file_path());
+         }
+      }
+   }
+
+   std::optional<data_log_entry> slice_read_cache::read(uint32_t slice_number, const bfs::path& trace_file, uint64_t offset) {
+      std::lock_guard<std::mutex> g(_mtx);
+      const entry_key key { slice_number, offset };
+      if (auto* entry = _entries.find(key)) {
+         return **entry;
+      }
+
+      auto unpack = [&](const mapping& m) {
+         const char* data = static_cast<const char*>(m.region.get_address());
+         fc::datastream<const char*> ds(data + offset, m.region.get_size() - offset);
+         auto entry = std::make_shared<data_log_entry>();
+         fc::raw::unpack(ds, *entry);
+         decode_frame(*entry);
+         if (_max_entries > 0) {
+            _entries.insert(key, entry, _max_entries);
+         }
+         return *entry;
+      };
+
+      std::shared_ptr<mapping> m;
+      if (auto* mapped = _mappings.find(slice_number)) {
+         m = *mapped;
+      }
+      if (!m || offset >= m->region.get_size()) {
+         m = map_slice(slice_number, trace_file, offset + 1);
+         if (!m) {
+            return {};
+         }
+      }
+      try {
+         return unpack(*m);
+      } catch (const fc::out_of_range_exception&) {
+         // the entry was only partly written when the file was mapped
+         if (file_size(trace_file) <= m->region.get_size()) {
+            throw;
+         }
+      }
+      m = map_slice(slice_number, trace_file, offset + 1);
+      return unpack(*m);
+   }
+
+   std::shared_ptr<slice_read_cache::mapping> slice_read_cache::map_slice(uint32_t slice_number, const bfs::path& trace_file, uint64_t min_size) {
+      _mappings.erase(slice_number);
+      if (file_size(trace_file) < min_size) {
+         return {};
+      }
+      namespace bip = boost::interprocess;
+      auto m = std::make_shared<mapping>();
+      m->file = bip::file_mapping(trace_file.generic_string().c_str(), bip::read_only);
+      m->region = bip::mapped_region(m->file, bip::read_only);
+      if (_max_mappings > 0) {
+         _mappings.insert(slice_number, m, _max_mappings);
+      }
+      return m;
+   }
+
+   void slice_read_cache::remove_slices_through(uint32_t slice_number) {
+      std::lock_guard<std::mutex> g(_mtx);
+      while (!_mappings.values.empty() && _mappings.values.begin()->first <= slice_number) {
+         _mappings.erase(_mappings.values.begin()->first);
+      }
+      while (!_entries.values.empty() && _entries.values.begin()->first.first <= slice_number) {
+         _entries.erase(_entries.values.begin()->first);
+      }
+   }
+
+   void slice_read_cache::prefetch(uint32_t slice_number, const bfs::path& trace_file) {
+      std::lock_guard<std::mutex> g(_mtx);
+      std::shared_ptr<mapping> m;
+      if (auto* mapped = _mappings.find(slice_number)) {
+         m = *mapped;
+      } else {
+         m = map_slice(slice_number, trace_file, 1);
+      }
+      if (m) {
+         m->region.advise(boost::interprocess::mapped_region::advice_willneed);
+      }
+   }
+
+   void slice_read_cache::remove_slice(uint32_t slice_number) {
+      std::lock_guard<std::mutex> g(_mtx);
+      _mappings.erase(slice_number);
+      auto itr = _entries.values.lower_bound(entry_key { slice_number, 0 });
+      while (itr != _entries.values.end() && itr->first.first == slice_number) {
+         const auto key = (itr++)->first;
+         _entries.erase(key);
+      }
    }
 
    slice_directory::slice_directory(const bfs::path& slice_dir, uint32_t width, std::optional<uint32_t> minimum_irreversible_history_blocks)
@@ -111,6 +744,65 @@ namespace eosio::trace_api {
       }
    }
 
+   bool slice_directory::find_or_create_trx_id_slice(uint32_t slice_number, open_state state, fc::cfile& trx_id_file) const {
+      const bool found = find_trx_id_slice(slice_number, state, trx_id_file);
+      if( !found ) {
+         create_new_index_slice_file(trx_id_file);
+      }
+      return found;
+   }
+
+   bool slice_directory::find_trx_id_slice(uint32_t slice_number, open_state state, fc::cfile& trx_id_file, bool open_file) const {
+      const bool found = find_slice(_trace_trx_id_prefix, slice_number, trx_id_file, open_file);
+      if( !found || !open_file ) {
+         return found;
+      }
+
+      // same header as the index files
+      validate_existing_index_slice_file(trx_id_file, state);
+      return true;
+   }
+
+   void slice_directory::create_block_offset_slice(uint32_t slice_number, fc::cfile& block_offset_file) const {
+      find_slice(_trace_block_offset_prefix, slice_number, block_offset_file, false);
+      create_new_index_slice_file(block_offset_file);
+      const uint32_t lib = 0;
+      block_offset_file.write(reinterpret_cast<const char*>(&lib), sizeof(lib));
+      block_offset_file.flush();
+      block_offset_file.close();
+      // block offsets are written in place, which append mode does not allow
+      block_offset_file.open("rb+");
+   }
+
+   bool slice_directory::find_block_offset_slice(uint32_t slice_number, fc::cfile& block_offset_file, bool open_file) const {
+      const bool found = find_slice(_trace_block_offset_prefix, slice_number, block_offset_file, false);
+      if( !found || !open_file ) {
+         return found;
+      }
+
+      block_offset_file.open("rb+");
+      validate_existing_index_slice_file(block_offset_file, open_state::read);
+      return true;
+   }
+
+   std::vector<uint32_t> slice_directory::trx_id_slice_numbers() const {
+      const std::string prefix = _trace_trx_id_prefix;
+      std::vector<uint32_t> slice_numbers;
+      for (const auto& entry : bfs::directory_iterator(_slice_dir)) {
+         const auto filename = entry.path().filename().string();
+         if (filename.compare(0, prefix.size(), prefix) != 0 || entry.path().extension() != _trace_ext) {
+            continue;
+         }
+         try {
+            slice_numbers.push_back(slice_number(std::stoul(filename.substr(prefix.size(), 10))));
+         } catch (const std::logic_error&) {
+            // not a slice file
+         }
+      }
+      std::sort(slice_numbers.begin(), slice_numbers.end());
+      return slice_numbers;
+   }
+
    bool slice_directory::find_or_create_trace_slice(uint32_t slice_number, open_state state, fc::cfile& trace_file) const {
       const bool found = find_trace_slice(slice_number, state, trace_file);
 
@@ -175,7 +867,14 @@ namespace eosio::trace_api {
       }
    }
 
-   void slice_directory::cleanup_old_slices(uint32_t lib) {
+   void slice_directory::cleanup_old_slices(uint32_t lib, const slice_file_remover& remove) {
+      auto remove_file = [&remove](uint32_t slice_number, const bfs::path& slice_file) {
+         if (remove) {
+            remove(slice_number, slice_file);
+         } else {
+            bfs::remove(slice_file);
+         }
+      };
       if (!_minimum_irreversible_history_blocks)
          return;
       const uint32_t lib_slice_number = slice_number( lib );
@@ -194,13 +893,23 @@ namespace eosio::trace_api {
             const uint32_t slice_to_clean = _last_cleaned_up_slice ? *_last_cleaned_up_slice + 1 : 0;
             // cleanup index first to reduce the likelihood of reader finding index, but not finding trace
             const bool dont_open_file = false;
+            fc::cfile block_offsets;
+            const bool block_offset_found = find_block_offset_slice(slice_to_clean, block_offsets, dont_open_file);
+            if (block_offset_found) {
+               remove_file(slice_to_clean, block_offsets.get_file_path());
+            }
+            fc::cfile trx_ids;
+            const bool trx_id_found = find_trx_id_slice(slice_to_clean, open_state::read, trx_ids, dont_open_file);
+            if (trx_id_found) {
+               remove_file(slice_to_clean, trx_ids.get_file_path());
+            }
             const bool index_found = find_index_slice(slice_to_clean, open_state::read, index, dont_open_file);
             if (index_found) {
-               bfs::remove(index.get_file_path());
+               remove_file(slice_to_clean, index.get_file_path());
             }
             const bool trace_found = find_trace_slice(slice_to_clean, open_state::read, trace, dont_open_file);
             if (trace_found) {
-               bfs::remove(trace.get_file_path());
+               remove_file(slice_to_clean, trace.get_file_path());
             }
             _last_cleaned_up_slice = slice_to_clean;
          }
@@ -0,0 +1,199 @@
+#include <fc/filesystem.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include <eosio/trace_api/abi_data_handler.hpp>
+#include <eosio/trace_api/request_handler.hpp>
+#include <eosio/trace_api/store_provider.hpp>
+#include <eosio/trace_api/test_common.hpp>
+
+using namespace eosio;
+using namespace eosio::trace_api;
+using namespace eosio::trace_api::test_common;
+namespace bpo = boost::program_options;
+
+/**
+ * Measures the latency of get_block_trace over synthetic slices, for random and recent block access, with and without
+ * decoding the action data with an ABI.  Not run as a test, it is meant to compare read path changes.
+ */
+namespace {
+   struct bench_config {
+      uint32_t blocks = 0;
+      uint32_t transactions = 0;
+      uint32_t actions = 0;
+      uint32_t slice_width = 0;
+      uint32_t samples = 0;
+      uint32_t recent = 0;
+      trace_codec codec = trace_codec::none;
+   };
+
+   struct bench_store_provider : public store_provider {
+      using store_provider::store_provider;
+      using store_provider::wait_for_maintenance;
+   };
+
+   struct store_reference {
+      get_block_t get_block(uint32_t height, const yield_function& yield) {
+         return store.get_block(height, yield);
+      }
+
+      get_block_t get_transaction_block(const chain::transaction_id_type& id, const yield_function& yield) {
+         return store.get_transaction_block(id, yield);
+      }
+
+      void prefetch_blocks(uint32_t first_block, uint32_t last_block) {
+         store.prefetch_blocks(first_block, last_block);
+      }
+
+      store_provider& store;
+   };
+
+   struct null_data_handler_provider {
+      fc::variant process_data(const action_trace_v0&, const yield_function&) {
+         return {};
+      }
+   };
+
+   chain::abi_def token_abi() {
+      auto abi = chain::abi_def( {},
+         {
+            { "transfer", "", { {"from", "name"}, {"to", "name"}, {"quantity", "asset"}, {"memo", "string"} } }
+         },
+         {
+            { "transfer"_n, "transfer", "" }
+         },
+         {}, {}, {}
+      );
+      abi.version = "eosio::abi/1.";
+      return abi;
+   }
+
+   block_trace_v0 make_block_trace(uint32_t number, const bench_config& config) {
+      block_trace_v0 bt;
+      bt.number = number;
+      bt.id = fc::sha256::hash(std::to_string(number));
+      bt.previous_id = fc::sha256::hash(std::to_string(number - 1));
+      bt.timestamp = chain::block_timestamp_type(number);
+      bt.producer = "bp.one"_n;
+      bt.transactions.reserve(config.transactions);
+      for (uint32_t t = 0; t < config.transactions; ++t) {
+         transaction_trace_v0 trx;
+         trx.id = fc::sha256::hash(std::to_string(number) + "-" + std::to_string(t));
+         for (uint32_t a = 0; a < config.actions; ++a) {
+            const uint64_t global_sequence = (static_cast<uint64_t>(number) * config.transactions + t) * config.actions + a;
+            trx.actions.emplace_back(action_trace_v0 {
+               global_sequence, "eosio.token"_n, "eosio.token"_n, "transfer"_n,
+               {{"alice"_n, "active"_n}},
+               make_transfer_data("alice"_n, "bob"_n, "1.0000 SYS"_t, "memo " + std::to_string(global_sequence))
+            });
+         }
+         bt.transactions.emplace_back(std::move(trx));
+      }
+      return bt;
+   }
+
+   void report(const std::string& name, std::vector<double>& micros) {
+      std::sort(micros.begin(), micros.end());
+      auto percentile = [&micros](double p) {
+         const auto i = static_cast<std::size_t>(p * (micros.size() - 1));
+         return micros[i];
+      };
+      std::cout << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(1)
+                << std::setw(10) << percentile(0.5) << std::setw(10) << percentile(0.9)
+                << std::setw(10) << percentile(0.99) << std::setw(10) << micros.back() << "\n";
+   }
+
+   template<typename DataHandlerProvider>
+   void run(const std::string& name, store_provider& store, DataHandlerProvider&& data_handler, std::mt19937& gen,
+            uint32_t first_block, uint32_t last_block, uint32_t samples) {
+      request_handler<store_reference, DataHandlerProvider> handler(store_reference{store}, std::move(data_handler));
+      std::uniform_int_distribution<uint32_t> blocks(first_block, last_block);
+      std::vector<double> micros;
+      micros.reserve(samples);
+      for (uint32_t i = 0; i < samples; ++i) {
+         const auto height = blocks(gen);
+         const auto start = std::chrono::steady_clock::now();
+         const auto trace = handler.get_block_trace(height);
+         const auto end = std::chrono::steady_clock::now();
+         if (trace.is_null()) {
+            throw std::runtime_error("block " + std::to_string(height) + " was not found");
+         }
+         micros.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+      }
+      report(name, micros);
+   }
+}
+
+int main(int argc, char** argv) {
+   bench_config config;
+   std::string codec;
+   bpo::options_description options("bench_read_path");
+   options.add_options()
+      ("help,h", "print this help")
+      ("blocks", bpo::value<uint32_t>(&config.blocks)->default_value(20'000), "number of blocks to generate")
+      ("transactions", bpo::value<uint32_t>(&config.transactions)->default_value(20), "transactions per block")
+      ("actions", bpo::value<uint32_t>(&config.actions)->default_value(2), "actions per transaction")
+      ("slice-width", bpo::value<uint32_t>(&config.slice_width)->default_value(10'000), "blocks per slice")
+      ("samples", bpo::value<uint32_t>(&config.samples)->default_value(10'000), "reads per measurement")
+      ("recent", bpo::value<uint32_t>(&config.recent)->default_value(100), "number of newest blocks read for recent access")
+      ("compression", bpo::value<std::string>(&codec)->default_value("none"), "codec irreversible slices are compressed with");
+   bpo::variables_map vm;
+   try {
+      bpo::store(bpo::parse_command_line(argc, argv, options), vm);
+      bpo::notify(vm);
+      config.codec = parse_trace_codec(codec);
+   } catch (const std::exception& e) {
+      std::cerr << e.what() << "\n" << options;
+      return 1;
+   }
+   if (vm.count("help")) {
+      std::cout << options;
+      return 0;
+   }
+   if (config.blocks < 2 || config.slice_width == 0 || config.samples == 0) {
+      std::cerr << "blocks must be at least 2, slice-width and samples not 0\n" << options;
+      return 1;
+   }
+   config.recent = std::min(std::max(config.recent, 1u), config.blocks);
+
+   try {
+      fc::temp_directory tempdir;
+      bench_store_provider store(tempdir.path(), config.slice_width, std::optional<uint32_t>());
+      // everything but the newest slice is compressed, recent blocks are read uncompressed
+      store.set_compression(config.codec, config.slice_width);
+
+      const auto write_start = std::chrono::steady_clock::now();
+      for (uint32_t number = 1; number <= config.blocks; ++number) {
+         store.append(make_block_trace(number, config));
+         store.append_lib(number);
+      }
+      const auto write_end = std::chrono::steady_clock::now();
+      std::cout << "wrote " << config.blocks << " blocks of " << config.transactions * config.actions << " actions in "
+                << std::chrono::duration<double>(write_end - write_start).count() << "s\n";
+      // lets pending compressions finish, so that they do not compete with reads
+      store.wait_for_maintenance();
+
+      std::cout << std::left << std::setw(24) << "get_block_trace (us)" << std::right
+                << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99" << std::setw(10) << "max" << "\n";
+
+      auto decoder = std::make_shared<abi_data_handler>();
+      decoder->add_abi("eosio.token"_n, token_abi());
+      const uint32_t recent_block = config.blocks - config.recent + 1;
+      std::mt19937 gen(0);
+      run("random", store, null_data_handler_provider{}, gen, 1, config.blocks, config.samples);
+      run("recent", store, null_data_handler_provider{}, gen, recent_block, config.blocks, config.samples);
+      run("random with abi", store, abi_data_handler::shared_provider(decoder), gen, 1, config.blocks, config.samples);
+      run("recent with abi", store, abi_data_handler::shared_provider(decoder), gen, recent_block, config.blocks, config.samples);
+   } catch (const std::exception& e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+   }
+   return 0;
+}
@@ -306,4 +306,46 @@ BOOST_AUTO_TEST_SUITE(block_extraction)
       BOOST_REQUIRE_EQUAL(data_log.at(0).get<block_trace_v0>(), expected_trace);
    }
 
+   BOOST_FIXTURE_TEST_CASE(queued_extraction, extraction_test_fixture)
+   {
+      auto act1 = make_transfer_action( "alice"_n, "bob"_n, "0.0001 SYS"_t, "Memo!" );
+      auto act2 = make_transfer_action( "bob"_n, "alice"_n, "0.0001 SYS"_t, "Memo!" );
+      auto ptrx1 = make_packed_trx( { act1 } );
+      auto ptrx2 = make_packed_trx( { act2 } );
+      auto bsp1 = make_block_state( chain::block_id_type(), 1, 1, "bp.one"_n, { chain::packed_transaction(ptrx1) } );
+      auto bsp2 = make_block_state( bsp1->id, 2, 2, "bp.one"_n, { chain::packed_transaction(ptrx2) } );
+      auto bsp3 = make_block_state( bsp2->id, 3, 3, "bp.one"_n, {} );
+
+      {
+         chain_extraction_impl_type<mock_logfile_provider_type> queued_impl( mock_logfile_provider_type(*this), exception_handler{}, 1 );
+         queued_impl.signal_applied_transaction(
+               make_transaction_trace( ptrx1.id(), 1, 1, chain::transaction_receipt_header::executed,
+                     { make_action_trace( 0, act1, "eosio.token"_n ) } ),
+               ptrx1.get_signed_transaction() );
+         queued_impl.signal_accepted_block( bsp1 );
+         queued_impl.signal_applied_transaction(
+               make_transaction_trace( ptrx2.id(), 2, 1, chain::transaction_receipt_header::executed,
+                     { make_action_trace( 1, act2, "eosio.token"_n ) } ),
+               ptrx2.get_signed_transaction() );
+         queued_impl.signal_accepted_block( bsp2 );
+         queued_impl.signal_irreversible_block( bsp1 );
+         queued_impl.signal_accepted_block( bsp3 );
+         // the queued entries are stored before the extraction is destroyed
+      }
+
+      BOOST_REQUIRE_EQUAL(max_lib, 1);
+      BOOST_REQUIRE_EQUAL(data_log.size(), 3);
+      const auto& bt1 = data_log.at(0).get<block_trace_v0>();
+      BOOST_REQUIRE_EQUAL(bt1.number, 1);
+      BOOST_REQUIRE_EQUAL(bt1.transactions.size(), 1);
+      BOOST_REQUIRE(bt1.transactions.at(0).id == ptrx1.id());
+      const auto& bt2 = data_log.at(1).get<block_trace_v0>();
+      BOOST_REQUIRE_EQUAL(bt2.number, 2);
+      BOOST_REQUIRE_EQUAL(bt2.transactions.size(), 1);
+      BOOST_REQUIRE(bt2.transactions.at(0).id == ptrx2.id());
+      const auto& bt3 = data_log.at(2).get<block_trace_v0>();
+      BOOST_REQUIRE_EQUAL(bt3.number, 3);
+      BOOST_REQUIRE(bt3.transactions.empty());
+   }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,6 +3,11 @@
 
 #include <fc/variant_object.hpp>
 
+#include <atomic>
+#include <thread>
+
+#include <boost/algorithm/string.hpp>
+
 #include <eosio/trace_api/request_handler.hpp>
 #include <eosio/trace_api/test_common.hpp>
 
@@ -29,6 +34,14 @@ struct response_test_fixture {
       get_block_t get_block(uint32_t height, const yield_function& yield= {}) {
          return fixture.mock_get_block(height, yield);
       }
+
+      get_block_t get_transaction_block(const chain::transaction_id_type& id, const yield_function& yield= {}) {
+         return fixture.mock_get_transaction_block(id, yield);
+      }
+
+      void prefetch_blocks(uint32_t first_block, uint32_t last_block) {
+         fixture.prefetched.emplace_back(first_block, last_block);
+      }
       response_test_fixture& fixture;
    };
 
@@ -63,9 +76,15 @@ struct response_test_fixture {
       return response_impl.get_block_trace( block_height, yield );
    }
 
+   fc::variant get_transaction_trace( const chain::transaction_id_type& id, const yield_function& yield = {} ) {
+      return response_impl.get_transaction_trace( id, yield );
+   }
+
    // fixture data and methods
    std::function<get_block_t(uint32_t, const yield_function&)> mock_get_block;
+   std::function<get_block_t(const chain::transaction_id_type&, const yield_function&)> mock_get_transaction_block;
    std::function<fc::variant(const action_trace_v0&, const yield_function&)> mock_data_handler = default_mock_data_handler;
+   std::vector<std::pair<uint32_t, uint32_t>> prefetched;
 
    response_impl_type response_impl;
 
@@ -354,6 +373,78 @@ BOOST_AUTO_TEST_SUITE(trace_responses)
 
    }
 
+   BOOST_FIXTURE_TEST_CASE(basic_transaction_response, response_test_fixture)
+   {
+      auto block_trace = block_trace_v0 {
+         "b000000000000000000000000000000000000000000000000000000000000001"_h,
+         1,
+         "0000000000000000000000000000000000000000000000000000000000000000"_h,
+         chain::block_timestamp_type(0),
+         "bp.one"_n,
+         {
+            {
+               "0000000000000000000000000000000000000000000000000000000000000001"_h,
+               {}
+            },
+            {
+               "0000000000000000000000000000000000000000000000000000000000000002"_h,
+               {
+                  {
+                     0,
+                     "receiver"_n, "contract"_n, "action"_n,
+                     {{ "alice"_n, "active"_n }},
+                     { 0x00, 0x01, 0x02, 0x03 }
+                  }
+               }
+            }
+         }
+      };
+
+      fc::variant expected_response = fc::mutable_variant_object()
+         ("id", "0000000000000000000000000000000000000000000000000000000000000002")
+         ("block_num", 1)
+         ("block_id", "b000000000000000000000000000000000000000000000000000000000000001")
+         ("status", "irreversible")
+         ("timestamp", "2000-01-01T00:00:00.000Z")
+         ("producer", "bp.one")
+         ("actions", fc::variants({
+            fc::mutable_variant_object()
+               ("receiver", "receiver")
+               ("account", "contract")
+               ("action", "action")
+               ("authorization", fc::variants({
+                  fc::mutable_variant_object()
+                     ("account", "alice")
+                     ("permission", "active")
+               }))
+               ("data", "00010203")
+               ("params", fc::mutable_variant_object()
+                     ("hex", "00010203"))
+         }))
+      ;
+
+      const auto trx_id = "0000000000000000000000000000000000000000000000000000000000000002"_h;
+      mock_get_transaction_block = [&block_trace, &trx_id]( const chain::transaction_id_type& id, const yield_function& ) -> get_block_t {
+         BOOST_TEST(id == trx_id);
+         return std::make_tuple(block_trace, true);
+      };
+
+      fc::variant actual_response = get_transaction_trace( trx_id );
+
+      BOOST_TEST(to_kv(expected_response) == to_kv(actual_response), boost::test_tools::per_element());
+   }
+
+   BOOST_FIXTURE_TEST_CASE(missing_transaction_data, response_test_fixture)
+   {
+      mock_get_transaction_block = []( const chain::transaction_id_type&, const yield_function& ) -> get_block_t {
+         return {};
+      };
+
+      fc::variant null_response = get_transaction_trace( "0000000000000000000000000000000000000000000000000000000000000002"_h );
+
+      BOOST_TEST(null_response.is_null());
+   }
+
    BOOST_FIXTURE_TEST_CASE(corrupt_block_data, response_test_fixture)
    {
       mock_get_block = []( uint32_t height, const yield_function& ) -> get_block_t {
@@ -429,4 +520,170 @@ BOOST_AUTO_TEST_SUITE(trace_responses)
       BOOST_REQUIRE_THROW(get_block_trace( 1, yield ), yield_exception);
    }
 
+   BOOST_FIXTURE_TEST_CASE(parallel_decode_block_response, response_test_fixture)
+   {
+      auto make_action = [](uint64_t global_sequence, char data) {
+         return action_trace_v0 {
+            global_sequence,
+            "receiver"_n, "contract"_n, "action"_n,
+            {{ "alice"_n, "active"_n }},
+            { data, 0x01 }
+         };
+      };
+      auto block_trace = block_trace_v0 {
+         "b000000000000000000000000000000000000000000000000000000000000001"_h,
+         1,
+         "0000000000000000000000000000000000000000000000000000000000000000"_h,
+         chain::block_timestamp_type(0),
+         "bp.one"_n,
+         {
+            {
+               "0000000000000000000000000000000000000000000000000000000000000001"_h,
+               { make_action(2, 0x02), make_action(0, 0x00), make_action(1, 0x01) }
+            },
+            {
+               "0000000000000000000000000000000000000000000000000000000000000002"_h,
+               { make_action(4, 0x04), make_action(3, 0x03) }
+            }
+         }
+      };
+
+      const fc::variant expected_response = detail::response_formatter::process_block(block_trace, false, default_mock_data_handler, {});
+
+      // decode on a thread per action, started in reverse
+      std::atomic<std::size_t> decoded{0};
+      auto parallel = [&decoded](std::size_t count, const std::function<void(std::size_t)>& task) {
+         std::vector<std::thread> threads;
+         for (std::size_t i = count; i > 0; --i) {
+            threads.emplace_back([&task, i]() { task(i - 1); });
+         }
+         for (auto& t : threads) {
+            t.join();
+         }
+         decoded += count;
+      };
+      const fc::variant actual_response = detail::response_formatter::process_block(block_trace, false, default_mock_data_handler, {}, parallel);
+
+      BOOST_TEST(decoded == 5);
+      BOOST_TEST(to_kv(expected_response) == to_kv(actual_response), boost::test_tools::per_element());
+   }
+
+   BOOST_FIXTURE_TEST_CASE(filtered_block_range_response, response_test_fixture)
+   {
+      auto make_block = [](uint32_t number, chain::name account, chain::name action) {
+         return block_trace_v0 {
+            chain::block_id_type(), number, chain::block_id_type(), chain::block_timestamp_type(0), "bp.one"_n,
+            {
+               {
+                  "0000000000000000000000000000000000000000000000000000000000000001"_h,
+                  {
+                     { 0, "alice"_n, account, action, {{ "alice"_n, "active"_n }}, { 0x00 } },
+                     { 1, account, account, action, {{ "alice"_n, "active"_n }}, { 0x01 } }
+                  }
+               },
+               {
+                  "0000000000000000000000000000000000000000000000000000000000000002"_h,
+                  {
+                     { 2, "bob"_n, "other"_n, "other"_n, {{ "bob"_n, "active"_n }}, { 0x02 } }
+                  }
+               }
+            }
+         };
+      };
+      std::map<uint32_t, block_trace_v0> blocks = {
+         { 1, make_block(1, "eosio.token"_n, "transfer"_n) },
+         { 2, make_block(2, "eosio.token"_n, "issue"_n) },
+         { 4, make_block(4, "eosio.token"_n, "transfer"_n) }
+      };
+      mock_get_block = [&blocks]( uint32_t height, const yield_function& ) -> get_block_t {
+         const auto itr = blocks.find(height);
+         if (itr == blocks.end()) {
+            return {};
+         }
+         return std::make_tuple(itr->second, false);
+      };
+      std::vector<std::string> decoded;
+      mock_data_handler = [&decoded](const action_trace_v0& a, const yield_function&) -> fc::variant {
+         decoded.push_back(fc::to_hex(a.data.data(), a.data.size()));
+         return {};
+      };
+
+      action_filter filter;
+      filter.accounts = { "eosio.token"_n };
+      filter.actions = { "transfer"_n };
+      filter.receivers = { "eosio.token"_n };
+      fc::variant block = response_impl.get_block_trace(1, {}, filter);
+      // only the selected action is decoded, and transactions without one are left out
+      BOOST_TEST(decoded == std::vector<std::string>{ "01" }, boost::test_tools::per_element());
+      const auto& transactions = block.get_object()["transactions"].get_array();
+      BOOST_REQUIRE_EQUAL(transactions.size(), 1);
+      const auto& actions = transactions.at(0).get_object()["actions"].get_array();
+      BOOST_REQUIRE_EQUAL(actions.size(), 1);
+      BOOST_TEST(actions.at(0).get_object()["receiver"].as_string() == "eosio.token");
+
+      filter.receivers.clear();
+      fc::variant range = response_impl.get_block_range_trace(1, 5, filter);
+      const auto& range_blocks = range.get_object()["blocks"].get_array();
+      BOOST_REQUIRE_EQUAL(range_blocks.size(), 2);
+      BOOST_TEST(range_blocks.at(0).get_object()["number"].as_uint64() == 1);
+      BOOST_TEST(range_blocks.at(1).get_object()["number"].as_uint64() == 4);
+      BOOST_TEST(range_blocks.at(1).get_object()["transactions"].get_array().at(0).get_object()["actions"].get_array().size() == 2);
+
+      // without a filter every existing block is returned in full
+      range = response_impl.get_block_range_trace(1, 5, action_filter());
+      BOOST_REQUIRE_EQUAL(range.get_object()["blocks"].get_array().size(), 3);
+      BOOST_TEST(range.get_object()["blocks"].get_array().at(1).get_object()["transactions"].get_array().size() == 2);
+   }
+
+   BOOST_FIXTURE_TEST_CASE(export_block_range, response_test_fixture)
+   {
+      auto make_block = [](uint32_t number) {
+         return block_trace_v0 {
+            chain::block_id_type(), number, chain::block_id_type(), chain::block_timestamp_type(0), "bp.one"_n,
+            {
+               {
+                  "0000000000000000000000000000000000000000000000000000000000000001"_h,
+                  {
+                     { 0, "receiver"_n, "contract"_n, "action"_n, {{ "alice"_n, "active"_n }}, { 0x00, 0x01 } }
+                  }
+               }
+            }
+         };
+      };
+      const std::map<uint32_t, block_trace_v0> blocks = { { 1, make_block(1) }, { 3, make_block(3) } };
+      mock_get_block = [&blocks]( uint32_t height, const yield_function& ) -> get_block_t {
+         const auto itr = blocks.find(height);
+         if (itr == blocks.end()) {
+            return {};
+         }
+         return std::make_tuple(itr->second, height == 1);
+      };
+
+      const std::string json = response_impl.export_block_range_json(1, 4);
+      std::vector<std::string> lines;
+      boost::split(lines, json, boost::is_any_of("\n"));
+      BOOST_REQUIRE_EQUAL(lines.size(), 3);
+      BOOST_TEST(lines.at(2).empty());
+      BOOST_TEST(fc::json::from_string(lines.at(0)).get_object()["number"].as_uint64() == 1);
+      BOOST_TEST(fc::json::from_string(lines.at(0)).get_object()["status"].as_string() == "irreversible");
+      BOOST_TEST(fc::json::from_string(lines.at(1)).get_object()["number"].as_uint64() == 3);
+      BOOST_TEST(to_kv(fc::json::from_string(lines.at(1))) == to_kv(get_block_trace(3)), boost::test_tools::per_element());
+
+      const std::vector<char> packed = response_impl.export_block_range_packed(1, 4);
+      fc::datastream<const char*> ds(packed.data(), packed.size());
+      for (uint32_t number : { 1, 3 }) {
+         uint8_t irreversible = 0;
+         block_trace_v0 bt;
+         fc::raw::unpack(ds, irreversible);
+         fc::raw::unpack(ds, bt);
+         BOOST_TEST(irreversible == (number == 1 ? 1 : 0));
+         BOOST_REQUIRE_EQUAL(bt, blocks.at(number));
+      }
+      BOOST_TEST(ds.remaining() == 0);
+
+      BOOST_REQUIRE_EQUAL(prefetched.size(), 2);
+      BOOST_TEST(prefetched.at(0).first == 1);
+      BOOST_TEST(prefetched.at(0).second == 4);
+   }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -72,11 +72,15 @@ namespace {
    };
 
    struct test_store_provider : public store_provider {
-      test_store_provider(const bfs::path& slice_dir, uint32_t width, std::optional<uint32_t> minimum_irreversible_history_blocks = std::optional<uint32_t>())
-         : store_provider(slice_dir, width, minimum_irreversible_history_blocks) {
+      test_store_provider(const bfs::path& slice_dir, uint32_t width, std::optional<uint32_t> minimum_irreversible_history_blocks = std::optional<uint32_t>(),
+                          uint32_t max_mapped_slices = slice_read_cache::default_max_mappings,
+                          uint32_t max_cached_entries = slice_read_cache::default_max_entries)
+         : store_provider(slice_dir, width, minimum_irreversible_history_blocks, max_mapped_slices, max_cached_entries) {
       }
       using store_provider::scan_metadata_log_from;
       using store_provider::read_data_log;
+      using store_provider::compress_slice;
+      using store_provider::wait_for_maintenance;
    };
 
    class vslice_datastream;
@@ -613,6 +617,11 @@ BOOST_AUTO_TEST_SUITE(slice_tests)
       sp.append(bt);
       sp.append_lib(1);
       sp.append(bt2);
+      // a slice without a block offset file, as started by an older version, has its metadata log scanned
+      slice_directory sd(tempdir.path(), 100, std::optional<uint32_t>());
+      fc::cfile block_offsets;
+      BOOST_REQUIRE(sd.find_block_offset_slice(0, block_offsets, false));
+      bfs::remove(block_offsets.get_file_path());
       int count = 0;
       get_block_t block1 = sp.get_block(1,[&count]() {
          if (++count >= 3) {
@@ -655,4 +664,286 @@ BOOST_AUTO_TEST_SUITE(slice_tests)
       BOOST_REQUIRE(!block2);
    }
 
+   BOOST_FIXTURE_TEST_CASE(store_provider_read_cache, test_fixture)
+   {
+      fc::temp_directory tempdir;
+      // a single mapping and cached entry, so that every read below maps or decodes again
+      test_store_provider sp(tempdir.path(), 4, std::optional<uint32_t>(), 1, 1);
+      sp.append(bt);
+      get_block_t block1 = sp.get_block(1);
+      BOOST_REQUIRE(block1);
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block1), bt);
+
+      // the trace file grows past its mapping
+      auto bt3 = bt;
+      bt3.number = 2;
+      bt3.id = "0000000000000000000000000000000000000000000000000000000000000007"_h;
+      sp.append(bt3);
+      get_block_t block3 = sp.get_block(2);
+      BOOST_REQUIRE(block3);
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block3), bt3);
+
+      // another slice evicts the mapping, which is mapped again
+      sp.append(bt2);
+      sp.prefetch_blocks(4, 7);
+      get_block_t block2 = sp.get_block(5);
+      BOOST_REQUIRE(block2);
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block2), bt2);
+      block1 = sp.get_block(1);
+      BOOST_REQUIRE(block1);
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block1), bt);
+      block1 = sp.get_block(1);
+      BOOST_REQUIRE(block1);
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block1), bt);
+
+      BOOST_REQUIRE_THROW(sp.read_data_log(1, 100000), malformed_slice_file);
+   }
+
+   BOOST_FIXTURE_TEST_CASE(test_get_block_from_block_offsets, test_fixture)
+   {
+      fc::temp_directory tempdir;
+      store_provider sp(tempdir.path(), 100, std::optional<uint32_t>());
+      sp.append(bt);
+      sp.append_lib(1);
+      sp.append(bt2);
+      // a lookup reads no metadata log entries
+      const auto no_yield = []() { throw yield_exception(""); };
+
+      get_block_t block1 = sp.get_block(1, no_yield);
+      BOOST_REQUIRE(block1);
+      BOOST_REQUIRE(std::get<1>(*block1));
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block1), bt);
+
+      get_block_t block2 = sp.get_block(5, no_yield);
+      BOOST_REQUIRE(block2);
+      BOOST_REQUIRE(!std::get<1>(*block2));
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block2), bt2);
+
+      BOOST_REQUIRE(!sp.get_block(2, no_yield));
+      BOOST_REQUIRE(!sp.get_block(99, no_yield));
+
+      // the last block appended at a height is the one on the current fork
+      auto bt2_fork = bt2;
+      bt2_fork.id = "0000000000000000000000000000000000000000000000000000000000000006"_h;
+      sp.append(bt2_fork);
+      block2 = sp.get_block(5, no_yield);
+      BOOST_REQUIRE(block2);
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block2), bt2_fork);
+
+      sp.append_lib(5);
+      block2 = sp.get_block(5, no_yield);
+      BOOST_REQUIRE(block2);
+      BOOST_REQUIRE(std::get<1>(*block2));
+   }
+
+   BOOST_FIXTURE_TEST_CASE(test_get_transaction_block, test_fixture)
+   {
+      fc::temp_directory tempdir;
+      store_provider sp(tempdir.path(), 4, std::optional<uint32_t>());
+      sp.append(bt);
+      sp.append_lib(1);
+      sp.append(bt2);
+
+      // bt2 is in the second slice
+      std::set<bfs::path> trx_id_files;
+      for (const auto& entry : bfs::directory_iterator(tempdir.path())) {
+         if (entry.path().filename().string().find("trace_trx_id_") == 0) {
+            trx_id_files.insert(entry.path().filename());
+         }
+      }
+      BOOST_REQUIRE_EQUAL(trx_id_files.size(), 2);
+
+      get_block_t block = sp.get_transaction_block("0000000000000000000000000000000000000000000000000000000000000001"_h);
+      BOOST_REQUIRE(block);
+      BOOST_REQUIRE(std::get<1>(*block));
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block), bt);
+
+      block = sp.get_transaction_block("f000000000000000000000000000000000000000000000000000000000000004"_h);
+      BOOST_REQUIRE(block);
+      BOOST_REQUIRE(!std::get<1>(*block));
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block), bt2);
+
+      block = sp.get_transaction_block("f000000000000000000000000000000000000000000000000000000000000005"_h);
+      BOOST_REQUIRE(!block);
+
+      // a fork replaces block 5 with one without the transaction
+      auto bt2_fork = bt2;
+      bt2_fork.id = "0000000000000000000000000000000000000000000000000000000000000006"_h;
+      bt2_fork.transactions.clear();
+      sp.append(bt2_fork);
+      block = sp.get_transaction_block("f000000000000000000000000000000000000000000000000000000000000004"_h);
+      BOOST_REQUIRE(!block);
+
+      // and a later fork brings it back
+      sp.append(bt2);
+      block = sp.get_transaction_block("f000000000000000000000000000000000000000000000000000000000000004"_h);
+      BOOST_REQUIRE(block);
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block), bt2);
+
+      int count = 0;
+      try {
+         sp.get_transaction_block("f000000000000000000000000000000000000000000000000000000000000004"_h, [&count]() {
+            if (++count >= 1) {
+               throw yield_exception("");
+            }
+         });
+         BOOST_FAIL("Should not have completed search");
+      } catch (const yield_exception& ex) {
+      }
+   }
+
+   BOOST_FIXTURE_TEST_CASE(test_compress_slice, test_fixture)
+   {
+      fc::temp_directory tempdir;
+      test_store_provider sp(tempdir.path(), 4);
+      sp.set_compression(trace_codec::zlib, 0);
+      sp.append(bt);
+      sp.append_lib(1);
+      auto bt3 = bt;
+      bt3.number = 2;
+      bt3.id = "0000000000000000000000000000000000000000000000000000000000000007"_h;
+      bt3.transactions[0].id = "f000000000000000000000000000000000000000000000000000000000000007"_h;
+      sp.append(bt3);
+      sp.append(bt2);
+      // read before the compression, through the cache
+      BOOST_REQUIRE(sp.get_block(1));
+
+      BOOST_REQUIRE(sp.compress_slice(0));
+      BOOST_REQUIRE(!sp.compress_slice(0));
+      BOOST_REQUIRE(!sp.compress_slice(3));
+
+      slice_directory sd(tempdir.path(), 4, std::optional<uint32_t>());
+      fc::cfile trace;
+      BOOST_REQUIRE(sd.find_trace_slice(0, open_state::read, trace));
+      BOOST_REQUIRE(extract_store<data_log_entry>(trace).contains<compressed_block_trace_v0>());
+      for (const auto& entry : bfs::directory_iterator(tempdir.path())) {
+         BOOST_REQUIRE_EQUAL(entry.path().extension(), ".log");
+      }
+
+      get_block_t block = sp.get_block(1);
+      BOOST_REQUIRE(block);
+      BOOST_REQUIRE(std::get<1>(*block));
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block), bt);
+      block = sp.get_block(2);
+      BOOST_REQUIRE(block);
+      BOOST_REQUIRE(!std::get<1>(*block));
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block), bt3);
+      block = sp.get_block(5);
+      BOOST_REQUIRE(block);
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block), bt2);
+
+      block = sp.get_transaction_block("f000000000000000000000000000000000000000000000000000000000000007"_h);
+      BOOST_REQUIRE(block);
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block), bt3);
+
+      // the rewritten metadata log finds the frames too
+      fc::cfile block_offsets;
+      BOOST_REQUIRE(sd.find_block_offset_slice(0, block_offsets, false));
+      bfs::remove(block_offsets.get_file_path());
+      block = sp.get_block(2);
+      BOOST_REQUIRE(block);
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block), bt3);
+   }
+
+   BOOST_FIXTURE_TEST_CASE(test_background_slice_compression, test_fixture)
+   {
+      fc::temp_directory tempdir;
+      {
+         test_store_provider sp(tempdir.path(), 4, std::optional<uint32_t>());
+         sp.set_compression(trace_codec::zlib, 2);
+         sp.append(bt);
+         sp.append_lib(1);
+         sp.append(bt2);
+         // slice 0 is not yet more than 2 blocks behind lib
+         sp.append_lib(5);
+         sp.wait_for_maintenance();
+      }
+      slice_directory sd(tempdir.path(), 4, std::optional<uint32_t>());
+      fc::cfile trace;
+      BOOST_REQUIRE(sd.find_trace_slice(0, open_state::read, trace));
+      BOOST_REQUIRE(extract_store<data_log_entry>(trace).contains<block_trace_v0>());
+      trace.close();
+
+      {
+         test_store_provider sp(tempdir.path(), 4, std::optional<uint32_t>());
+         sp.set_compression(trace_codec::zlib, 2);
+         sp.set_maintenance_rate(1024 * 1024);
+         sp.append_lib(6);
+         sp.wait_for_maintenance();
+      }
+      BOOST_REQUIRE(sd.find_trace_slice(0, open_state::read, trace));
+      BOOST_REQUIRE(extract_store<data_log_entry>(trace).contains<compressed_block_trace_v0>());
+      trace.close();
+      BOOST_REQUIRE(sd.find_trace_slice(1, open_state::read, trace));
+      BOOST_REQUIRE(extract_store<data_log_entry>(trace).contains<block_trace_v0>());
+
+      store_provider sp(tempdir.path(), 4, std::optional<uint32_t>());
+      get_block_t block = sp.get_block(1);
+      BOOST_REQUIRE(block);
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block), bt);
+   }
+
+   BOOST_FIXTURE_TEST_CASE(test_background_slice_cleanup, test_fixture)
+   {
+      fc::temp_directory tempdir;
+      test_store_provider sp(tempdir.path(), 4, std::optional<uint32_t>(0));
+      sp.set_maintenance_rate(1024 * 1024);
+      sp.append(bt);
+      sp.append_lib(1);
+      sp.append(bt2);
+      // slice 0 is mapped when removed
+      BOOST_REQUIRE(sp.get_block(1));
+      sp.append_lib(7);
+      sp.wait_for_maintenance();
+
+      BOOST_REQUIRE(!sp.get_block(1));
+      get_block_t block = sp.get_block(5);
+      BOOST_REQUIRE(block);
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block), bt2);
+      for (const auto& entry : bfs::directory_iterator(tempdir.path())) {
+         const auto filename = entry.path().filename().string();
+         BOOST_REQUIRE_MESSAGE(filename.find("0000000000-") == std::string::npos, filename);
+         BOOST_REQUIRE_MESSAGE(entry.path().extension() != ".removing", filename);
+      }
+   }
+
+   BOOST_FIXTURE_TEST_CASE(test_slice_compression_recovery, test_fixture)
+   {
+      fc::temp_directory tempdir;
+      fc::cfile trace;
+      fc::cfile index;
+      slice_directory sd(tempdir.path(), 4, std::optional<uint32_t>());
+      {
+         test_store_provider sp(tempdir.path(), 4);
+         sp.set_compression(trace_codec::zlib, 0);
+         sp.append(bt);
+         sp.append_lib(1);
+         BOOST_REQUIRE(sp.compress_slice(0));
+      }
+      // interrupted after the rewrite was committed, but before its files were renamed into place
+      BOOST_REQUIRE(sd.find_trace_slice(0, open_state::read, trace, false));
+      BOOST_REQUIRE(sd.find_index_slice(0, open_state::read, index, false));
+      bfs::rename(trace.get_file_path(), trace.get_file_path().string() + ".compressed");
+      bfs::rename(index.get_file_path(), index.get_file_path().string() + ".compressing");
+      // and an uncommitted rewrite of another slice
+      const auto stray = tempdir.path() / "trace_0000000004-0000000008.log.compressing";
+      fc::cfile f;
+      f.set_file_path(stray);
+      f.open(fc::cfile::create_or_update_rw_mode);
+      f.close();
+      // and a removal of a cleaned up slice file
+      const auto removing = tempdir.path() / "trace_index_0000000008-0000000012.log.removing";
+      f.set_file_path(removing);
+      f.open(fc::cfile::create_or_update_rw_mode);
+      f.close();
+
+      store_provider sp(tempdir.path(), 4, std::optional<uint32_t>());
+      BOOST_REQUIRE(!bfs::exists(stray));
+      BOOST_REQUIRE(!bfs::exists(removing));
+      BOOST_REQUIRE(bfs::exists(index.get_file_path()));
+      get_block_t block = sp.get_block(1);
+      BOOST_REQUIRE(block);
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block), bt);
+   }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -6,6 +6,7 @@
 #include <eosio/trace_api/store_provider.hpp>
 
 #include <eosio/trace_api/configuration_utils.hpp>
+#include <eosio/chain/thread_utils.hpp>
 
 #include <boost/signals2/connection.hpp>
 
@@ -66,6 +67,22 @@ namespace {
       }
    }
 
+   /// @throws if a filter field of the request is not an array of names
+   action_filter parse_action_filter(const fc::variant_object& input) {
+      action_filter filter;
+      auto names = [&input](const char* field, std::set<chain::name>& result) {
+         if (input.contains(field)) {
+            for (const auto& n : input[field].get_array()) {
+               result.insert(chain::name(n.as_string()));
+            }
+         }
+      };
+      names("receivers", filter.receivers);
+      names("accounts", filter.accounts);
+      names("actions", filter.actions);
+      return filter;
+   }
+
    template<typename Store>
    struct shared_store_provider {
       shared_store_provider(const std::shared_ptr<Store>& store)
@@ -84,6 +101,14 @@ namespace {
          return store->get_block(height, yield);
       }
 
+      get_block_t get_transaction_block(const chain::transaction_id_type& id, const yield_function& yield) {
+         return store->get_transaction_block(id, yield);
+      }
+
+      void prefetch_blocks(uint32_t first_block, uint32_t last_block) {
+         store->prefetch_blocks(first_block, last_block);
+      }
+
       std::shared_ptr<Store> store;
    };
 }
@@ -103,6 +128,19 @@ struct trace_api_common_impl {
       cfg_options("trace-minimum-irreversible-history-blocks", boost::program_options::value<int32_t>()->default_value(-1),
                   "Number of blocks to ensure are kept past LIB for retrieval before \"slice\" files can be automatically removed.\n"
                   "A value of -1 indicates that automatic removal of \"slice\" files will be turned off.");
+      cfg_options("trace-read-mapped-slices", bpo::value<uint32_t>()->default_value(slice_read_cache::default_max_mappings),
+                  "the number of most recently read \"slice\" trace files kept memory mapped for reads");
+      cfg_options("trace-read-cache-blocks", bpo::value<uint32_t>()->default_value(slice_read_cache::default_max_entries),
+                  "the number of most recently read block traces kept decoded for reads");
+      cfg_options("trace-compression", bpo::value<std::string>()->default_value("none"),
+                  "codec of the compressed frames irreversible \"slice\" trace files are rewritten with in the background, one of:\n"
+                  "  none: \"slice\" trace files are not compressed\n"
+                  "  zlib\n"
+                  "  zstd: only when built with zstd");
+      cfg_options("trace-minimum-uncompressed-irreversible-history-blocks", bpo::value<uint32_t>()->default_value(0),
+                  "Number of blocks past LIB kept uncompressed before \"slice\" trace files are compressed, see trace-compression.");
+      cfg_options("trace-maintenance-max-bytes-per-second", bpo::value<uint64_t>()->default_value(0),
+                  "Maximum rate at which \"slice\" files are read and written while they are compressed or removed in the background, 0 for no limit.");
    }
 
    void plugin_initialize(const appbase::variables_map& options) {
@@ -121,7 +159,18 @@ struct trace_api_common_impl {
          minimum_irreversible_history_blocks = blocks;
       }
 
-      store = std::make_shared<store_provider>(trace_dir, slice_stride, minimum_irreversible_history_blocks);
+      store = std::make_shared<store_provider>(trace_dir, slice_stride, minimum_irreversible_history_blocks,
+                                               options.at("trace-read-mapped-slices").as<uint32_t>(),
+                                               options.at("trace-read-cache-blocks").as<uint32_t>());
+
+      trace_codec codec = trace_codec::none;
+      try {
+         codec = parse_trace_codec(options.at("trace-compression").as<std::string>());
+      } catch (const std::invalid_argument& e) {
+         EOS_THROW(chain::plugin_config_exception, "\"trace-compression\": ${e}", ("e", e.what()));
+      }
+      store->set_compression(codec, options.at("trace-minimum-uncompressed-irreversible-history-blocks").as<uint32_t>());
+      store->set_maintenance_rate(options.at("trace-maintenance-max-bytes-per-second").as<uint64_t>());
    }
 
    // common configuration paramters
@@ -157,6 +206,13 @@ struct trace_api_rpc_plugin_impl : public std::enable_shared_from_this<trace_api
             "Failure to specify this option when there are no trace-rpc-abi configuations will result in an Error.\n"
             "This option is mutually exclusive with trace-rpc-api"
       );
+      cfg_options("trace-rpc-max-block-range", bpo::value<uint32_t>()->default_value(100),
+                  "The maximum number of blocks returned by a single get_block_range request");
+      cfg_options("trace-rpc-max-export-blocks", bpo::value<uint32_t>()->default_value(10'000),
+                  "The maximum number of blocks returned by a single export_blocks request");
+      cfg_options("trace-rpc-decode-threads", bpo::value<uint16_t>()->default_value(2),
+                  "Number of worker threads decoding the action data of trace RPC responses in parallel.\n"
+                  "A value of 0 decodes the actions one after another on the main thread.");
    }
 
    void plugin_initialize(const appbase::variables_map& options) {
@@ -184,9 +240,41 @@ struct trace_api_rpc_plugin_impl : public std::enable_shared_from_this<trace_api
                     "Trace API is not configured with ABIs and trace-no-abis is not set");
       }
 
+      // the ABI serializers of the data handler are built once by add_abi, and only read while decoding
+      parallel_function parallel;
+      const uint16_t decode_threads = options.at("trace-rpc-decode-threads").as<uint16_t>();
+      if (decode_threads > 0) {
+         decode_thread_pool.emplace("trace", decode_threads);
+         parallel = [this, decode_threads](std::size_t count, const std::function<void(std::size_t)>& task) {
+            const std::size_t workers = std::min<std::size_t>(count, decode_threads);
+            std::vector<std::future<void>> done;
+            done.reserve(workers);
+            for (std::size_t w = 0; w < workers; ++w) {
+               done.push_back(chain::async_thread_pool(decode_thread_pool->get_executor(), [&task, w, workers, count]() {
+                  for (std::size_t i = w; i < count; i += workers) {
+                     task(i);
+                  }
+               }));
+            }
+            // every worker refers to task, so all of them finish before an exception is rethrown
+            for (auto& d : done) {
+               d.wait();
+            }
+            for (auto& d : done) {
+               d.get();
+            }
+         };
+      }
+
+      max_block_range = options.at("trace-rpc-max-block-range").as<uint32_t>();
+      EOS_ASSERT(max_block_range > 0, chain::plugin_config_exception, "\"trace-rpc-max-block-range\" must be greater than 0");
+      max_export_blocks = options.at("trace-rpc-max-export-blocks").as<uint32_t>();
+      EOS_ASSERT(max_export_blocks > 0, chain::plugin_config_exception, "\"trace-rpc-max-export-blocks\" must be greater than 0");
+
       req_handler = std::make_shared<request_handler_t>(
          shared_store_provider<store_provider>(common->store),
-         abi_data_handler::shared_provider(data_handler)
+         abi_data_handler::shared_provider(data_handler),
+         std::move(parallel)
       );
    }
 
@@ -221,9 +309,18 @@ struct trace_api_rpc_plugin_impl : public std::enable_shared_from_this<trace_api
             return;
          }
 
+         action_filter filter;
          try {
+            filter = parse_action_filter(fc::json::from_string(body).get_object());
+         } catch (...) {
+            error_results results{400, "Bad receivers, accounts or actions"};
+            cb( 400, fc::variant( results ));
+            return;
+         }
 
-            auto resp = that->req_handler->get_block_trace(*block_number);
+         try {
+
+            auto resp = that->req_handler->get_block_trace(*block_number, {}, filter);
             if (resp.is_null()) {
                error_results results{404, "Block trace missing"};
                cb( 404, fc::variant( results ));
@@ -234,13 +331,161 @@ struct trace_api_rpc_plugin_impl : public std::enable_shared_from_this<trace_api
             http_plugin::handle_exception("trace_api", "get_block", body, cb);
          }
       });
+
+      http.add_handler("/v1/trace_api/get_block_range", [wthis=weak_from_this()](std::string, std::string body, url_response_callback cb){
+         auto that = wthis.lock();
+         if (!that) {
+            return;
+         }
+
+         auto request = ([&body]() -> std::optional<std::tuple<uint32_t, uint32_t, action_filter>> {
+            if (body.empty()) {
+               return {};
+            }
+
+            try {
+               auto input = fc::json::from_string(body).get_object();
+               auto start_block_num = input["start_block_num"].as_uint64();
+               auto end_block_num = input["end_block_num"].as_uint64();
+               if (start_block_num > end_block_num || end_block_num > std::numeric_limits<uint32_t>::max()) {
+                  return {};
+               }
+               return std::make_tuple(static_cast<uint32_t>(start_block_num), static_cast<uint32_t>(end_block_num), parse_action_filter(input));
+            } catch (...) {
+               return {};
+            }
+         })();
+
+         if (!request) {
+            error_results results{400, "Bad or missing start_block_num, end_block_num, receivers, accounts or actions"};
+            cb( 400, fc::variant( results ));
+            return;
+         }
+
+         try {
+            const auto start_block_num = std::get<0>(*request);
+            // a longer range is continued by another request from last_block_num + 1
+            const auto last_block_num = static_cast<uint32_t>(std::min<uint64_t>(std::get<1>(*request),
+                                                                                 uint64_t(start_block_num) + that->max_block_range - 1));
+            auto resp = that->req_handler->get_block_range_trace(start_block_num, last_block_num, std::get<2>(*request));
+            cb( 200, fc::mutable_variant_object(resp.get_object())("last_block_num", last_block_num) );
+         } catch (...) {
+            http_plugin::handle_exception("trace_api", "get_block_range", body, cb);
+         }
+      });
+
+      // newline delimited JSON by default, packed traces for requests accepting application/octet-stream
+      http.add_json_handler("/v1/trace_api/export_blocks", [wthis=weak_from_this()](std::string, std::string body, url_response_callback cb, url_response_json_callback json_cb){
+         auto that = wthis.lock();
+         if (!that) {
+            return;
+         }
+
+         const auto range = that->parse_export_range(body);
+         if (!range) {
+            error_results results{400, "Bad or missing start_block_num or end_block_num"};
+            cb( 400, fc::variant( results ));
+            return;
+         }
+
+         try {
+            json_cb( 200, that->req_handler->export_block_range_json(range->first, range->second), false );
+         } catch (...) {
+            http_plugin::handle_exception("trace_api", "export_blocks", body, cb);
+         }
+      });
+      http.add_binary_handler("/v1/trace_api/export_blocks", [wthis=weak_from_this()](std::string, std::string body, url_response_callback cb, url_response_binary_callback binary_cb){
+         auto that = wthis.lock();
+         if (!that) {
+            return;
+         }
+
+         const auto range = that->parse_export_range(body);
+         if (!range) {
+            error_results results{400, "Bad or missing start_block_num or end_block_num"};
+            cb( 400, fc::variant( results ));
+            return;
+         }
+
+         try {
+            binary_cb( 200, that->req_handler->export_block_range_packed(range->first, range->second), false );
+         } catch (...) {
+            http_plugin::handle_exception("trace_api", "export_blocks", body, cb);
+         }
+      });
+
+      http.add_handler("/v1/trace_api/get_transaction_trace", [wthis=weak_from_this()](std::string, std::string body, url_response_callback cb){
+         auto that = wthis.lock();
+         if (!that) {
+            return;
+         }
+
+         auto trx_id = ([&body]() -> std::optional<chain::transaction_id_type> {
+            if (body.empty()) {
+               return {};
+            }
+
+            try {
+               auto input = fc::json::from_string(body);
+               return chain::transaction_id_type(input.get_object()["id"].as_string());
+            } catch (...) {
+               return {};
+            }
+         })();
+
+         if (!trx_id) {
+            error_results results{400, "Bad or missing id"};
+            cb( 400, fc::variant( results ));
+            return;
+         }
+
+         try {
+
+            auto resp = that->req_handler->get_transaction_trace(*trx_id);
+            if (resp.is_null()) {
+               error_results results{404, "Transaction trace missing"};
+               cb( 404, fc::variant( results ));
+            } else {
+               cb( 200, std::move(resp) );
+            }
+         } catch (...) {
+            http_plugin::handle_exception("trace_api", "get_transaction_trace", body, cb);
+         }
+      });
+   }
+
+   /// @return the range of an export_blocks request, limited to max_export_blocks blocks
+   std::optional<std::pair<uint32_t, uint32_t>> parse_export_range(const std::string& body) const {
+      if (body.empty()) {
+         return {};
+      }
+
+      try {
+         auto input = fc::json::from_string(body).get_object();
+         auto start_block_num = input["start_block_num"].as_uint64();
+         auto end_block_num = input["end_block_num"].as_uint64();
+         if (start_block_num > end_block_num || end_block_num > std::numeric_limits<uint32_t>::max()) {
+            return {};
+         }
+         end_block_num = std::min<uint64_t>(end_block_num, start_block_num + max_export_blocks - 1);
+         return std::make_pair(static_cast<uint32_t>(start_block_num), static_cast<uint32_t>(end_block_num));
+      } catch (...) {
+         return {};
+      }
    }
 
    void plugin_shutdown() {
+      if (decode_thread_pool) {
+         decode_thread_pool->stop();
+      }
    }
 
    std::shared_ptr<trace_api_common_impl> common;
 
+   fc::optional<chain::named_thread_pool> decode_thread_pool;
+   uint32_t max_block_range = 0;
+   uint32_t max_export_blocks = 0;
+
    using request_handler_t = request_handler<shared_store_provider<store_provider>, abi_data_handler::shared_provider>;
    std::shared_ptr<request_handler_t> req_handler;
 };
@@ -251,6 +496,9 @@ struct trace_api_plugin_impl {
 
    static void set_program_options(appbase::options_description& cli, appbase::options_description& cfg) {
       auto cfg_options = cfg.add_options();
+      cfg_options("trace-extraction-queue-size", bpo::value<uint32_t>()->default_value(32),
+                  "Number of blocks and LIB updates the trace writer thread may fall behind block application before it waits for the writer.\n"
+                  "A value of 0 converts and stores the traces on the main thread.");
    }
 
    void plugin_initialize(const appbase::variables_map& options) {
@@ -259,7 +507,8 @@ struct trace_api_plugin_impl {
          app().quit();
          throw yield_exception("shutting down");
       };
-      extraction = std::make_shared<chain_extraction_t>(shared_store_provider<store_provider>(common->store), log_exceptions_and_shutdown);
+      extraction = std::make_shared<chain_extraction_t>(shared_store_provider<store_provider>(common->store), log_exceptions_and_shutdown,
+                                                        options.at("trace-extraction-queue-size").as<uint32_t>());
 
       auto& chain = app().find_plugin<chain_plugin>()->chain();
 
@@ -290,6 +539,11 @@ struct trace_api_plugin_impl {
    }
 
    void plugin_shutdown() {
+      applied_transaction_connection.reset();
+      accepted_block_connection.reset();
+      irreversible_block_connection.reset();
+      // stores the traces still queued for the writer thread
+      extraction.reset();
    }
 
    std::shared_ptr<trace_api_common_impl> common;
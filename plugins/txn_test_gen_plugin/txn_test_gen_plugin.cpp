@@ -8,9 +8,12 @@
 #include <fc/exception/exception.hpp>
 #include <fc/reflect/variant.hpp>
 #include <fc/io/json.hpp>
+#include <fc/network/http/http_client.hpp>
 
 #include <boost/asio/high_resolution_timer.hpp>
 #include <boost/algorithm/clamp.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include <Inline/BasicTypes.h>
 #include <IR/Module.h>
@@ -21,6 +24,10 @@
 
 #include <contracts.hpp>
 
+#include <array>
+#include <atomic>
+#include <mutex>
+
 using namespace eosio::testing;
 
 namespace eosio { namespace detail {
@@ -28,10 +35,21 @@ namespace eosio { namespace detail {
   struct txn_test_gen_status {
      string status;
   };
+  struct txn_test_gen_stats {
+     double   target_tps = 0;
+     uint64_t sent = 0;
+     uint64_t accepted = 0;
+     uint64_t failed = 0;
+     uint64_t latency_p50_us = 0;
+     uint64_t latency_p90_us = 0;
+     uint64_t latency_p99_us = 0;
+     uint64_t latency_max_us = 0;
+  };
 }}
 
 FC_REFLECT(eosio::detail::txn_test_gen_empty, );
 FC_REFLECT(eosio::detail::txn_test_gen_status, (status));
+FC_REFLECT(eosio::detail::txn_test_gen_stats, (target_tps)(sent)(accepted)(failed)(latency_p50_us)(latency_p90_us)(latency_p99_us)(latency_max_us));
 
 namespace eosio {
 
@@ -61,6 +79,9 @@ using namespace eosio::chain;
      api_handle->call_name(vs.at(0).as<in_param0>(), vs.at(1).as<in_param1>()); \
      eosio::detail::txn_test_gen_empty result;
 
+#define INVOKE_R_V(api_handle, call_name) \
+     auto result = api_handle->call_name();
+
 #define INVOKE_V_V(api_handle, call_name) \
      api_handle->call_name(); \
      eosio::detail::txn_test_gen_empty result;
@@ -91,10 +112,143 @@ using namespace eosio::chain;
    const auto& vs = fc::json::json::from_string(body).as<fc::variants>(); \
    api_handle->call_name(vs.at(0).as<in_param0>(), vs.at(1).as<in_param1>(), result_handler);
 
+/// kinds of actions the generated transactions carry
+enum class txn_action_kind : uint8_t {
+   transfer,      ///< eosio.token transfer between the A and B accounts
+   table,         ///< ram_restrictions_test setdata, rewrites rows of two tables
+   inline_action, ///< get_sender_test sendinline, sends an inline action
+   count
+};
+
+/**
+ * Parses a mix like "transfer:8,table:1,inline:1" into the sequence of action kinds generated transactions cycle
+ * through, each kind repeated as many times as its weight.  A kind without a weight has weight 1.
+ */
+std::vector<txn_action_kind> parse_action_mix( const std::string& mix ) {
+   std::vector<txn_action_kind> schedule;
+   std::vector<std::string> entries;
+   boost::split( entries, mix, boost::is_any_of(",") );
+   for( auto& entry : entries ) {
+      boost::trim( entry );
+      if( entry.empty() )
+         continue;
+      const auto colon = entry.find(':');
+      const auto kind_name = entry.substr(0, colon);
+      uint32_t weight = 1;
+      if( colon != std::string::npos ) {
+         try {
+            weight = boost::lexical_cast<uint32_t>( entry.substr(colon + 1) );
+         } catch( const boost::bad_lexical_cast& ) {
+            EOS_THROW( chain::plugin_config_exception, "invalid weight in txn-test-gen-action-mix entry \"${e}\"", ("e", entry) );
+         }
+      }
+      EOS_ASSERT( weight <= 1000, chain::plugin_config_exception,
+                  "txn-test-gen-action-mix weight of \"${e}\" must not exceed 1000", ("e", entry) );
+      txn_action_kind kind;
+      if( kind_name == "transfer" )
+         kind = txn_action_kind::transfer;
+      else if( kind_name == "table" )
+         kind = txn_action_kind::table;
+      else if( kind_name == "inline" )
+         kind = txn_action_kind::inline_action;
+      else
+         EOS_THROW( chain::plugin_config_exception, "unknown action \"${k}\" in txn-test-gen-action-mix, expected transfer, table or inline", ("k", kind_name) );
+      schedule.insert( schedule.end(), weight, kind );
+   }
+   EOS_ASSERT( !schedule.empty(), chain::plugin_config_exception, "txn-test-gen-action-mix must give at least one action a weight" );
+   return schedule;
+}
+
+/**
+ * Latencies from handing generated transactions over to them being accepted, in power of two buckets of microseconds
+ */
+struct latency_histogram {
+   static constexpr size_t bucket_count = 40;
+
+   void add( const fc::microseconds& latency ) {
+      const uint64_t us = std::max<int64_t>( latency.count(), 0 );
+      ++buckets[ std::min<size_t>( bucket_count - 1, us == 0 ? 0 : 64 - __builtin_clzll( us ) ) ];
+      uint64_t m = max_us.load();
+      while( us > m && !max_us.compare_exchange_weak( m, us ) ) {}
+   }
+
+   uint64_t count() const {
+      uint64_t total = 0;
+      for( const auto& b : buckets )
+         total += b.load();
+      return total;
+   }
+
+   /// upper bound of the bucket holding the latency greater than the given fraction of all latencies
+   uint64_t percentile_us( double p ) const {
+      const uint64_t total = count();
+      if( total == 0 )
+         return 0;
+      const uint64_t rank = std::max<uint64_t>( 1, static_cast<uint64_t>( std::ceil( p * total ) ) );
+      uint64_t seen = 0;
+      for( size_t i = 0; i < bucket_count; ++i ) {
+         seen += buckets[i].load();
+         if( seen >= rank )
+            return std::min<uint64_t>( (uint64_t(1) << i) - 1, max_us.load() );
+      }
+      return max_us.load();
+   }
+
+   /// the non empty buckets, as in "<1024us: 10, <2048us: 500"
+   std::string to_string() const {
+      std::string result;
+      for( size_t i = 0; i < bucket_count; ++i ) {
+         const auto n = buckets[i].load();
+         if( n == 0 )
+            continue;
+         if( !result.empty() )
+            result += ", ";
+         result += "<" + std::to_string( uint64_t(1) << i ) + "us: " + std::to_string( n );
+      }
+      return result;
+   }
+
+   void reset() {
+      for( auto& b : buckets )
+         b = 0;
+      max_us = 0;
+   }
+
+   std::array<std::atomic<uint64_t>, bucket_count> buckets{};
+   std::atomic<uint64_t>                            max_us{0};
+};
+
+/**
+ * A node generated transactions are sent to over http, with the clients not currently sending to it.  Each client
+ * keeps its own connection, so a node has as many requests in flight as there are threads sending to it.
+ */
+struct txn_test_gen_node {
+   explicit txn_test_gen_node( const std::string& node_url )
+   : url( node_url + "/v1/chain/push_transactions" ) {}
+
+   std::unique_ptr<fc::http_client> take_client() {
+      std::lock_guard<std::mutex> g( mtx );
+      if( idle_clients.empty() )
+         return std::make_unique<fc::http_client>();
+      auto client = std::move( idle_clients.back() );
+      idle_clients.pop_back();
+      return client;
+   }
+
+   void return_client( std::unique_ptr<fc::http_client> client ) {
+      std::lock_guard<std::mutex> g( mtx );
+      idle_clients.push_back( std::move( client ) );
+   }
+
+   fc::url                                       url;
+   std::mutex                                    mtx;
+   std::vector<std::unique_ptr<fc::http_client>> idle_clients;
+};
+
 struct txn_test_gen_plugin_impl {
 
-   uint64_t _total_us = 0;
-   uint64_t _txcount = 0;
+   std::atomic<uint64_t> _total_us{0};
+   std::atomic<uint64_t> _txcount{0};
 
    uint16_t                                             thread_pool_size;
    fc::optional<eosio::chain::named_thread_pool>        thread_pool;
@@ -102,6 +256,12 @@ struct txn_test_gen_plugin_impl {
    name                                                 newaccountA;
    name                                                 newaccountB;
    name                                                 newaccountT;
+   name                                                 newaccountD;
+   name                                                 newaccountI;
+
+   std::vector<txn_action_kind>                         action_schedule;
+   std::vector<std::unique_ptr<txn_test_gen_node>>      nodes;
+   std::atomic<uint64_t>                                next_node{0};
 
    void push_next_transaction(const std::shared_ptr<std::vector<signed_transaction>>& trxs, const std::function<void(const fc::exception_ptr&)>& next ) {
       chain_plugin& cp = app().get_plugin<chain_plugin>();
@@ -130,7 +290,7 @@ struct txn_test_gen_plugin_impl {
    void create_test_accounts(const std::string& init_name, const std::string& init_priv_key, const std::function<void(const fc::exception_ptr&)>& next) {
       ilog("create_test_accounts");
       std::vector<signed_transaction> trxs;
-      trxs.reserve(2);
+      trxs.reserve(3);
 
       try {
          name creator(init_name);
@@ -176,6 +336,13 @@ struct txn_test_gen_plugin_impl {
 
             trx.actions.emplace_back(vector<chain::permission_level>{{creator,name("active")}}, newaccount{creator, newaccountT, owner_auth, active_auth});
             }
+            //create "D" and "I" accounts, for the table and inline actions
+            for (const auto& account : {newaccountD, newaccountI}) {
+            auto owner_auth   = eosio::chain::authority{1, {{txn_text_receiver_C_pub_key, 1}}, {}};
+            auto active_auth  = eosio::chain::authority{1, {{txn_text_receiver_C_pub_key, 1}}, {}};
+
+            trx.actions.emplace_back(vector<chain::permission_level>{{creator,name("active")}}, newaccount{creator, account, owner_auth, active_auth});
+            }
 
             trx.expiration = cc.head_block_time() + fc::seconds(180);
             trx.set_reference_block(cc.head_block_id());
@@ -253,6 +420,33 @@ struct txn_test_gen_plugin_impl {
             trx.sign(txn_test_receiver_C_priv_key, chainid);
             trxs.emplace_back(std::move(trx));
          }
+
+         //set newaccountD contract to ram_restrictions_test and newaccountI contract to get_sender_test
+         {
+            signed_transaction trx;
+
+            const std::vector<std::tuple<name, std::vector<uint8_t>, std::vector<char>>> contracts_to_set = {
+               { newaccountD, contracts::ram_restrictions_test_wasm(), contracts::ram_restrictions_test_abi() },
+               { newaccountI, contracts::get_sender_test_wasm(),       contracts::get_sender_test_abi() }
+            };
+            for (const auto& c : contracts_to_set) {
+               setcode code_handler;
+               code_handler.account = std::get<0>(c);
+               code_handler.code.assign(std::get<1>(c).begin(), std::get<1>(c).end());
+               trx.actions.emplace_back( vector<chain::permission_level>{{std::get<0>(c),name("active")}}, code_handler);
+
+               setabi abi_handler;
+               abi_handler.account = std::get<0>(c);
+               abi_handler.abi = fc::raw::pack(json::from_string(std::get<2>(c).data()).as<abi_def>());
+               trx.actions.emplace_back( vector<chain::permission_level>{{std::get<0>(c),name("active")}}, abi_handler);
+            }
+
+            trx.expiration = cc.head_block_time() + fc::seconds(180);
+            trx.set_reference_block(cc.head_block_id());
+            trx.max_net_usage_words = 5000;
+            trx.sign(txn_test_receiver_C_priv_key, chainid);
+            trxs.emplace_back(std::move(trx));
+         }
       } catch (const fc::exception& e) {
          next(e.dynamic_copy_exception());
          return;
@@ -278,32 +472,58 @@ struct txn_test_gen_plugin_impl {
       controller& cc = app().get_plugin<chain_plugin>().chain();
       auto abi_serializer_max_time = app().get_plugin<chain_plugin>().get_abi_serializer_max_time();
       abi_serializer eosio_token_serializer{fc::json::from_string(contracts::eosio_token_abi().data()).as<abi_def>(), abi_serializer_max_time};
-      //create the actions here
-      act_a_to_b.account = newaccountT;
-      act_a_to_b.name = N(transfer);
-      act_a_to_b.authorization = vector<permission_level>{{newaccountA,config::active_name}};
-      act_a_to_b.data = eosio_token_serializer.variant_to_binary("transfer",
+      abi_serializer table_serializer{fc::json::from_string(contracts::ram_restrictions_test_abi().data()).as<abi_def>(), abi_serializer_max_time};
+      abi_serializer inline_serializer{fc::json::from_string(contracts::get_sender_test_abi().data()).as<abi_def>(), abi_serializer_max_time};
+      //create the actions here, for each kind one sent by A and one by B
+      const std::array<name, 2> senders = {newaccountA, newaccountB};
+      for (size_t s = 0; s < senders.size(); ++s) {
+         const auto from = senders[s];
+         const auto to = senders[1 - s];
+
+         action& transfer = actions[static_cast<size_t>(txn_action_kind::transfer)][s];
+         transfer.account = newaccountT;
+         transfer.name = N(transfer);
+         transfer.authorization = vector<permission_level>{{from,config::active_name}};
+         transfer.data = eosio_token_serializer.variant_to_binary("transfer",
                                                                   fc::json::from_string(fc::format_string("{\"from\":\"${from}\",\"to\":\"${to}\",\"quantity\":\"1.0000 CUR\",\"memo\":\"${l}\"}",
-                                                                  fc::mutable_variant_object()("from",newaccountA.to_string())("to",newaccountB.to_string())("l", salt))),
+                                                                  fc::mutable_variant_object()("from",from.to_string())("to",to.to_string())("l", salt))),
                                                                   abi_serializer_max_time);
 
-      act_b_to_a.account = newaccountT;
-      act_b_to_a.name = N(transfer);
-      act_b_to_a.authorization = vector<permission_level>{{newaccountB,config::active_name}};
-      act_b_to_a.data = eosio_token_serializer.variant_to_binary("transfer",
-                                                                  fc::json::from_string(fc::format_string("{\"from\":\"${from}\",\"to\":\"${to}\",\"quantity\":\"1.0000 CUR\",\"memo\":\"${l}\"}",
-                                                                  fc::mutable_variant_object()("from",newaccountB.to_string())("to",newaccountA.to_string())("l", salt))),
-                                                                  abi_serializer_max_time);
+         action& table = actions[static_cast<size_t>(txn_action_kind::table)][s];
+         table.account = newaccountD;
+         table.name = N(setdata);
+         table.authorization = vector<permission_level>{{from,config::active_name}};
+         table.data = table_serializer.variant_to_binary("setdata",
+                                                         fc::mutable_variant_object()("len1", table_row_size)("len2", 2 * table_row_size)("payer", from),
+                                                         abi_serializer_max_time);
+
+         action& inline_act = actions[static_cast<size_t>(txn_action_kind::inline_action)][s];
+         inline_act.account = newaccountI;
+         inline_act.name = N(sendinline);
+         inline_act.authorization = vector<permission_level>{{from,config::active_name}};
+         inline_act.data = inline_serializer.variant_to_binary("sendinline",
+                                                               fc::mutable_variant_object()("to", newaccountI)("expected_sender", newaccountI),
+                                                               abi_serializer_max_time);
+      }
 
       timer_timeout = period;
-      batch = batch_size/2;
+      batch = batch_size;
       nonce_prefix = 0;
+      sent = accepted = failed = 0;
+      latencies.reset();
+      last_report = {fc::time_point::now(), 0, 0, 0};
+
+      update_reference_block();
+      accepted_block_connection.emplace( cc.accepted_block.connect( [this]( const block_state_ptr& ) {
+         update_reference_block();
+      } ) );
 
       thread_pool.emplace( "txntest", thread_pool_size );
       timer = std::make_shared<boost::asio::high_resolution_timer>(thread_pool->get_executor());
 
-      ilog("Started transaction test plugin; generating ${p} transactions every ${m} ms by ${t} load generation threads",
-         ("p", batch_size) ("m", period) ("t", thread_pool_size));
+      ilog("Started transaction test plugin; generating ${p} transactions every ${m} ms by ${t} load generation threads, ${tps} transactions per second ${where}",
+         ("p", batch_size) ("m", period) ("t", thread_pool_size) ("tps", target_tps())
+         ("where", nodes.empty() ? std::string("accepted locally") : "sent to " + std::to_string(nodes.size()) + " nodes"));
 
       boost::asio::post( thread_pool->get_executor(), [this]() {
          arm_timer(boost::asio::high_resolution_timer::clock_type::now());
@@ -311,77 +531,184 @@ struct txn_test_gen_plugin_impl {
       return "success";
    }
 
+   double target_tps() const {
+      return batch * 1000.0 / timer_timeout;
+   }
+
+   /// runs on the main thread, generation threads only ever read the snapshot
+   void update_reference_block() {
+      controller& cc = app().get_plugin<chain_plugin>().chain();
+      uint32_t reference_block_num = cc.last_irreversible_block_num();
+      if (txn_reference_block_lag >= 0) {
+         reference_block_num = cc.head_block_num();
+         if (reference_block_num <= (uint32_t)txn_reference_block_lag) {
+            reference_block_num = 0;
+         } else {
+            reference_block_num -= (uint32_t)txn_reference_block_lag;
+         }
+      }
+
+      std::lock_guard<std::mutex> g( reference_mtx );
+      reference_block_id = cc.get_block_id_for_num(reference_block_num);
+      reference_head_block_time = cc.head_block_time();
+   }
+
    void arm_timer(boost::asio::high_resolution_timer::time_point s) {
       timer->expires_at(s + std::chrono::milliseconds(timer_timeout));
-      boost::asio::post( thread_pool->get_executor(), [this]() {
-         send_transaction([this](const fc::exception_ptr& e){
-            if (e) {
-               elog("pushing transaction failed: ${e}", ("e", e->to_detail_string()));
-               if(running)
-                  stop_generation();
-            }
-         }, nonce_prefix++);
-      });
+      // every thread signs a share of the batch
+      const uint64_t round = nonce_prefix++;
+      const uint32_t shares = std::min<uint32_t>( thread_pool_size, batch );
+      for (uint32_t share = 0; share < shares; ++share) {
+         boost::asio::post( thread_pool->get_executor(), [this, round, first = batch * share / shares, last = batch * (share + 1) / shares]() {
+            send_transactions(round, first, last);
+         });
+      }
       timer->async_wait([this](const boost::system::error_code& ec) {
          if(!running || ec)
             return;
+         report_stats(false);
          arm_timer(timer->expires_at());
       });
    }
 
-   void send_transaction(std::function<void(const fc::exception_ptr&)> next, uint64_t nonce_prefix) {
+   void send_transactions(uint64_t round, uint32_t first, uint32_t last) {
       std::vector<signed_transaction> trxs;
-      trxs.reserve(2*batch);
+      trxs.reserve(last - first);
 
       try {
-         controller& cc = app().get_plugin<chain_plugin>().chain();
          auto chainid = app().get_plugin<chain_plugin>().get_chain_id();
+         block_id_type reference_block;
+         fc::time_point head_block_time;
+         {
+            std::lock_guard<std::mutex> g( reference_mtx );
+            reference_block = reference_block_id;
+            head_block_time = reference_head_block_time;
+         }
 
-         static fc::crypto::private_key a_priv_key = fc::crypto::private_key::regenerate(fc::sha256(std::string(64, 'a')));
-         static fc::crypto::private_key b_priv_key = fc::crypto::private_key::regenerate(fc::sha256(std::string(64, 'b')));
+         for (uint32_t i = first; i < last; ++i) {
+            const uint64_t n = round * batch + i;
+            // the sender alternates every time the schedule repeats, so transfers keep the balances of A and B even
+            const size_t sender = (n / action_schedule.size()) % 2;
+            signed_transaction trx;
+            trx.actions.push_back(actions[static_cast<size_t>(action_schedule[n % action_schedule.size()])][sender]);
+            trx.context_free_actions.emplace_back(action({}, config::null_account_name, name("nonce"), fc::raw::pack( std::to_string(round)+std::to_string(nonce++) )));
+            trx.set_reference_block(reference_block);
+            trx.expiration = head_block_time + fc::seconds(30);
+            trx.max_net_usage_words = 100;
+            trx.sign(sender == 0 ? a_priv_key : b_priv_key, chainid);
+            trxs.emplace_back(std::move(trx));
+         }
+      } catch ( const fc::exception& e ) {
+         record_failure(e.to_detail_string(), last - first);
+         return;
+      }
 
-         static uint64_t nonce = static_cast<uint64_t>(fc::time_point::now().sec_since_epoch()) << 32;
+      sent += trxs.size();
+      if (nodes.empty())
+         accept_transactions(std::move(trxs));
+      else
+         send_to_node(trxs);
+   }
 
-         uint32_t reference_block_num = cc.last_irreversible_block_num();
-         if (txn_reference_block_lag >= 0) {
-            reference_block_num = cc.head_block_num();
-            if (reference_block_num <= (uint32_t)txn_reference_block_lag) {
-               reference_block_num = 0;
-            } else {
-               reference_block_num -= (uint32_t)txn_reference_block_lag;
-            }
+   void accept_transactions(std::vector<signed_transaction>&& trxs) {
+      auto trxs_copy = std::make_shared<std::decay_t<decltype(trxs)>>(std::move(trxs));
+      const auto start = fc::time_point::now();
+      app().post(priority::low, [this, trxs_copy, start]() {
+         chain_plugin& cp = app().get_plugin<chain_plugin>();
+         for (const auto& trx : *trxs_copy) {
+            cp.accept_transaction( std::make_shared<packed_transaction>(trx), [this, start](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& result){
+               if (result.contains<fc::exception_ptr>()) {
+                  record_failure(result.get<fc::exception_ptr>()->to_detail_string(), 1);
+               } else if (result.get<transaction_trace_ptr>()->except) {
+                  record_failure(result.get<transaction_trace_ptr>()->except->to_detail_string(), 1);
+               } else {
+                  const auto& trace = result.get<transaction_trace_ptr>();
+                  record_accepted(fc::time_point::now() - start, trace->receipt ? trace->receipt->cpu_usage_us : 0);
+               }
+            });
          }
+      });
+   }
 
-         block_id_type reference_block_id = cc.get_block_id_for_num(reference_block_num);
+   /// sends the transactions of a share to the next node in one push_transactions request
+   void send_to_node(const std::vector<signed_transaction>& trxs) {
+      auto& node = *nodes[next_node++ % nodes.size()];
+      std::vector<packed_transaction> packed;
+      packed.reserve(trxs.size());
+      for (const auto& trx : trxs)
+         packed.emplace_back(trx);
 
-         for(unsigned int i = 0; i < batch; ++i) {
-         {
-         signed_transaction trx;
-         trx.actions.push_back(act_a_to_b);
-         trx.context_free_actions.emplace_back(action({}, config::null_account_name, name("nonce"), fc::raw::pack( std::to_string(nonce_prefix)+std::to_string(nonce++) )));
-         trx.set_reference_block(reference_block_id);
-         trx.expiration = cc.head_block_time() + fc::seconds(30);
-         trx.max_net_usage_words = 100;
-         trx.sign(a_priv_key, chainid);
-         trxs.emplace_back(std::move(trx));
+      auto client = node.take_client();
+      const auto start = fc::time_point::now();
+      try {
+         const auto results = client->post_sync(node.url, fc::variant(packed), start + fc::seconds(30));
+         const auto latency = fc::time_point::now() - start;
+         for (const auto& r : results.get_array()) {
+            const auto& processed = r.get_object()["processed"];
+            if (processed.is_object() && processed.get_object().contains("error")) {
+               record_failure(processed.get_object()["error"].as_string(), 1);
+            } else {
+               uint32_t cpu_usage_us = 0;
+               if (processed.is_object() && processed.get_object().contains("receipt"))
+                  cpu_usage_us = processed.get_object()["receipt"].get_object()["cpu_usage_us"].as_uint64();
+               record_accepted(latency, cpu_usage_us);
+            }
          }
+      } catch (const fc::exception& e) {
+         // the connection of the client is in an unknown state, it is not reused
+         record_failure(e.to_detail_string(), trxs.size());
+         return;
+      }
+      node.return_client(std::move(client));
+   }
 
-         {
-         signed_transaction trx;
-         trx.actions.push_back(act_b_to_a);
-         trx.context_free_actions.emplace_back(action({}, config::null_account_name, name("nonce"), fc::raw::pack( std::to_string(nonce_prefix)+std::to_string(nonce++) )));
-         trx.set_reference_block(reference_block_id);
-         trx.expiration = cc.head_block_time() + fc::seconds(30);
-         trx.max_net_usage_words = 100;
-         trx.sign(b_priv_key, chainid);
-         trxs.emplace_back(std::move(trx));
-         }
-         }
-      } catch ( const fc::exception& e ) {
-         next(e.dynamic_copy_exception());
+   void record_accepted(const fc::microseconds& latency, uint32_t cpu_usage_us) {
+      ++accepted;
+      latencies.add(latency);
+      if (cpu_usage_us) {
+         _total_us += cpu_usage_us;
+         ++_txcount;
       }
+   }
 
-      push_transactions(std::move(trxs), next);
+   void record_failure(const std::string& error, uint64_t count) {
+      failed += count;
+      std::lock_guard<std::mutex> g( last_error_mtx );
+      last_error = error;
+   }
+
+   detail::txn_test_gen_stats get_stats() const {
+      detail::txn_test_gen_stats stats;
+      stats.target_tps = running ? target_tps() : 0;
+      stats.sent = sent;
+      stats.accepted = accepted;
+      stats.failed = failed;
+      stats.latency_p50_us = latencies.percentile_us(0.5);
+      stats.latency_p90_us = latencies.percentile_us(0.9);
+      stats.latency_p99_us = latencies.percentile_us(0.99);
+      stats.latency_max_us = latencies.max_us;
+      return stats;
+   }
+
+   /// logs the rates since the last report at most every stats_report_interval, all of them if final
+   void report_stats(bool final) {
+      const auto now = fc::time_point::now();
+      if (!final && now - last_report.time < stats_report_interval)
+         return;
+      const double seconds = std::max<int64_t>((now - last_report.time).count(), 1) / 1e6;
+      const report_point current{now, sent, accepted, failed};
+      std::string error;
+      {
+         std::lock_guard<std::mutex> g( last_error_mtx );
+         std::swap(error, last_error);
+      }
+      ilog("txn_test_gen: ${a} accepted (${tps} per second of ${target}), ${s} sent, ${f} failed, acceptance latency p50 ${p50}us p90 ${p90}us p99 ${p99}us max ${max}us",
+           ("a", current.accepted - last_report.accepted)("tps", (current.accepted - last_report.accepted) / seconds)("target", target_tps())
+           ("s", current.sent - last_report.sent)("f", current.failed - last_report.failed)
+           ("p50", latencies.percentile_us(0.5))("p90", latencies.percentile_us(0.9))("p99", latencies.percentile_us(0.99))("max", latencies.max_us.load()));
+      if (!error.empty())
+         elog("txn_test_gen: last failure: ${e}", ("e", error));
+      last_report = current;
    }
 
    void stop_generation() {
@@ -391,23 +718,53 @@ struct txn_test_gen_plugin_impl {
       running = false;
       if( thread_pool )
          thread_pool->stop();
+      accepted_block_connection.reset();
 
       ilog("Stopping transaction generation test");
 
       if (_txcount) {
-         ilog("${d} transactions executed, ${t}us / transaction", ("d", _txcount)("t", _total_us / (double)_txcount));
+         ilog("${d} transactions executed, ${t}us / transaction", ("d", _txcount.load())("t", _total_us / (double)_txcount));
          _txcount = _total_us = 0;
       }
+      report_stats(true);
+      ilog("txn_test_gen: acceptance latency histogram: ${h}", ("h", latencies.to_string()));
    }
 
-   bool running{false};
+   struct report_point {
+      fc::time_point time;
+      uint64_t       sent = 0;
+      uint64_t       accepted = 0;
+      uint64_t       failed = 0;
+   };
+
+   static constexpr uint32_t table_row_size = 512;
+   const fc::microseconds stats_report_interval = fc::seconds(10);
+
+   std::atomic<bool> running{false};
 
    unsigned timer_timeout;
    unsigned batch;
    uint64_t nonce_prefix;
+   std::atomic<uint64_t> nonce{static_cast<uint64_t>(fc::time_point::now().sec_since_epoch()) << 32};
+
+   const fc::crypto::private_key a_priv_key = fc::crypto::private_key::regenerate(fc::sha256(std::string(64, 'a')));
+   const fc::crypto::private_key b_priv_key = fc::crypto::private_key::regenerate(fc::sha256(std::string(64, 'b')));
+
+   /// for each kind of action, the action sent by A and by B
+   std::array<std::array<action, 2>, static_cast<size_t>(txn_action_kind::count)> actions;
 
-   action act_a_to_b;
-   action act_b_to_a;
+   std::mutex     reference_mtx;
+   block_id_type  reference_block_id;
+   fc::time_point reference_head_block_time;
+   fc::optional<boost::signals2::scoped_connection> accepted_block_connection;
+
+   std::atomic<uint64_t> sent{0};
+   std::atomic<uint64_t> accepted{0};
+   std::atomic<uint64_t> failed{0};
+   latency_histogram     latencies;
+   report_point          last_report;
+   std::mutex            last_error_mtx;
+   std::string           last_error;
 
    int32_t txn_reference_block_lag;
 };
@@ -420,6 +777,14 @@ void txn_test_gen_plugin::set_program_options(options_description&, options_desc
       ("txn-reference-block-lag", bpo::value<int32_t>()->default_value(0), "Lag in number of blocks from the head block when selecting the reference block for transactions (-1 means Last Irreversible Block)")
       ("txn-test-gen-threads", bpo::value<uint16_t>()->default_value(2), "Number of worker threads in txn_test_gen thread pool")
       ("txn-test-gen-account-prefix", bpo::value<string>()->default_value("txn.test."), "Prefix to use for accounts generated and used by this plugin")
+      ("txn-test-gen-action-mix", bpo::value<string>()->default_value("transfer"),
+       "Actions of the generated transactions and their weights, as in \"transfer:8,table:1,inline:1\".\n"
+       "  transfer: token transfer between the test accounts\n"
+       "  table: rewrites rows of two tables\n"
+       "  inline: sends an inline action")
+      ("txn-test-gen-node-url", bpo::value<vector<string>>()->composing(),
+       "URL of the http API of a node generated transactions are sent to, instead of accepting them locally; "
+       "transactions are distributed over all nodes given (may specify multiple times)")
    ;
 }
 
@@ -432,6 +797,16 @@ void txn_test_gen_plugin::plugin_initialize(const variables_map& options) {
       my->newaccountA = eosio::chain::name(thread_pool_account_prefix + "a");
       my->newaccountB = eosio::chain::name(thread_pool_account_prefix + "b");
       my->newaccountT = eosio::chain::name(thread_pool_account_prefix + "t");
+      my->newaccountD = eosio::chain::name(thread_pool_account_prefix + "d");
+      my->newaccountI = eosio::chain::name(thread_pool_account_prefix + "i");
+      my->action_schedule = parse_action_mix( options.at( "txn-test-gen-action-mix" ).as<std::string>() );
+      if( options.count( "txn-test-gen-node-url" ) ) {
+         for( const auto& node_url : options.at( "txn-test-gen-node-url" ).as<vector<string>>() ) {
+            try {
+               my->nodes.emplace_back( std::make_unique<txn_test_gen_node>( boost::trim_right_copy_if( node_url, boost::is_any_of("/") ) ) );
+            } EOS_RETHROW_EXCEPTIONS( chain::plugin_config_exception, "invalid txn-test-gen-node-url ${u}", ("u", node_url) )
+         }
+      }
       EOS_ASSERT( my->thread_pool_size > 0, chain::plugin_config_exception,
                   "txn-test-gen-threads ${num} must be greater than 0", ("num", my->thread_pool_size) );
    } FC_LOG_AND_RETHROW()
@@ -441,6 +816,7 @@ void txn_test_gen_plugin::plugin_startup() {
    app().get_plugin<http_plugin>().add_api({
       CALL_ASYNC(txn_test_gen, my, create_test_accounts, INVOKE_ASYNC_R_R(my, create_test_accounts, std::string, std::string), 200),
       CALL(txn_test_gen, my, stop_generation, INVOKE_V_V(my, stop_generation), 200),
+      CALL(txn_test_gen, my, get_stats, INVOKE_R_V(my, get_stats), 200),
       CALL(txn_test_gen, my, start_generation, INVOKE_V_R_R_R(my, start_generation, std::string, uint64_t, uint64_t), 200)
    });
 }
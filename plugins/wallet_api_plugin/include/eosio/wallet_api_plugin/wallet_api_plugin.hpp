@@ -2,6 +2,7 @@
 
 #include <eosio/wallet_plugin/wallet_plugin.hpp>
 #include <eosio/http_plugin/http_plugin.hpp>
+#include <eosio/chain/thread_utils.hpp>
 
 #include <appbase/application.hpp>
 
@@ -20,12 +21,14 @@ public:
    wallet_api_plugin& operator=(wallet_api_plugin&&) = delete;
    virtual ~wallet_api_plugin() override = default;
 
-   virtual void set_program_options(options_description& cli, options_description& cfg) override {}
+   virtual void set_program_options(options_description& cli, options_description& cfg) override;
    void plugin_initialize(const variables_map& vm);
    void plugin_startup();
-   void plugin_shutdown() {}
+   void plugin_shutdown();
 
 private:
+   uint16_t                                      api_threads = 0;
+   fc::optional<eosio::chain::named_thread_pool> thread_pool;
 };
 
 }
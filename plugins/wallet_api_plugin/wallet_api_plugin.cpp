@@ -20,16 +20,21 @@ static appbase::abstract_plugin& _wallet_api_plugin = app().register_plugin<wall
 
 using namespace eosio;
 
+// runs on the wallet api thread pool when there is one, the wallet_manager serializes the calls
 #define CALL(api_name, api_handle, call_name, INVOKE, http_response_code) \
 {std::string("/v1/" #api_name "/" #call_name), \
-   [&api_handle](string, string body, url_response_callback cb) mutable { \
-          try { \
-             if (body.empty()) body = "{}"; \
-             INVOKE \
-             cb(http_response_code, fc::variant(result)); \
-          } catch (...) { \
-             http_plugin::handle_exception(#api_name, #call_name, body, cb); \
-          } \
+   [this, &api_handle](string, string body, url_response_callback cb) mutable { \
+          auto call = [&api_handle, body{std::move(body)}, cb{std::move(cb)}]() mutable { \
+             try { \
+                if (body.empty()) body = "{}"; \
+                INVOKE \
+                cb(http_response_code, fc::variant(result)); \
+             } catch (...) { \
+                http_plugin::handle_exception(#api_name, #call_name, body, cb); \
+             } \
+          }; \
+          if( thread_pool ) boost::asio::post( thread_pool->get_executor(), std::move(call) ); \
+          else call(); \
        }}
 
 #define INVOKE_R_R(api_handle, call_name, in_param) \
@@ -65,8 +70,21 @@ using namespace eosio;
      eosio::detail::wallet_api_plugin_empty result;
 
 
+// pairs of digest and public key, named as the comma would split the macro arguments
+using sign_digests_params = std::vector<std::pair<chain::digest_type, public_key_type>>;
+
+void wallet_api_plugin::set_program_options(options_description& cli, options_description& cfg) {
+   cfg.add_options()
+         ("wallet-api-threads", boost::program_options::value<uint16_t>()->default_value(0),
+          "Number of threads running wallet API calls, instead of the main thread. 0 runs them on the main thread")
+         ;
+}
+
 void wallet_api_plugin::plugin_startup() {
    ilog("starting wallet_api_plugin");
+   if( api_threads > 0 ) {
+      thread_pool.emplace( "walapi", api_threads );
+   }
    // lifetime of plugin is lifetime of application
    auto& wallet_mgr = app().get_plugin<wallet_plugin>().get_wallet_manager();
 
@@ -77,6 +95,8 @@ void wallet_api_plugin::plugin_startup() {
             INVOKE_R_R_R_R(wallet_mgr, sign_transaction, chain::signed_transaction, flat_set<public_key_type>, chain::chain_id_type), 201),
        CALL(wallet, wallet_mgr, sign_digest,
             INVOKE_R_R_R(wallet_mgr, sign_digest, chain::digest_type, public_key_type), 201),
+       CALL(wallet, wallet_mgr, sign_digests,
+            INVOKE_R_R(wallet_mgr, sign_digests, sign_digests_params), 201),
        CALL(wallet, wallet_mgr, create,
             INVOKE_R_R(wallet_mgr, create, std::string), 201),
        CALL(wallet, wallet_mgr, open,
@@ -104,6 +124,7 @@ void wallet_api_plugin::plugin_startup() {
 
 void wallet_api_plugin::plugin_initialize(const variables_map& options) {
    try {
+      api_threads = options.at( "wallet-api-threads" ).as<uint16_t>();
       const auto& _http_plugin = app().get_plugin<http_plugin>();
       if( !_http_plugin.is_on_loopback()) {
          if( !_http_plugin.is_secure()) {
@@ -132,6 +153,11 @@ void wallet_api_plugin::plugin_initialize(const variables_map& options) {
    } FC_LOG_AND_RETHROW()
 }
 
+void wallet_api_plugin::plugin_shutdown() {
+   if( thread_pool ) {
+      thread_pool->stop();
+   }
+}
 
 #undef INVOKE_R_R
 #undef INVOKE_R_R_R_R
@@ -179,6 +179,10 @@ class soft_wallet final : public wallet_api
       */
       fc::optional<signature_type> try_sign_digest( const digest_type digest, const public_key_type public_key ) override;
 
+      /* Signing only reads the unlocked keys
+      */
+      bool can_sign_concurrently() const override { return true; }
+
       std::shared_ptr<detail::soft_wallet_impl> my;
       void encrypt_keys();
 };
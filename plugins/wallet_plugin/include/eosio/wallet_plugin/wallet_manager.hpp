@@ -1,10 +1,12 @@
 #pragma once
 #include <eosio/chain/transaction.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <eosio/wallet_plugin/wallet_api.hpp>
 #include <boost/asio/deadline_timer.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/interprocess/sync/file_lock.hpp>
 #include <chrono>
+#include <mutex>
 
 namespace fc { class variant; }
 
@@ -15,6 +17,7 @@ namespace wallet {
 ///
 /// The name of the wallet is also used as part of the file name by soft_wallet. See wallet_manager::create.
 /// No const methods because timeout may cause lock_all() to be called.
+/// All methods may be called from any thread, they are serialized on an internal mutex.
 class wallet_manager {
 public:
    wallet_manager();
@@ -39,6 +42,11 @@ public:
    /// @see wallet_manager::set_timeout(const std::chrono::seconds& t)
    /// @param secs The timeout in seconds.
    void set_timeout(int64_t secs) { set_timeout(std::chrono::seconds(secs)); }
+
+   /// Sign the keys a transaction needs in parallel on this many threads, instead of one after another.
+   /// Only keys of wallets that support concurrent signing, see wallet_api::can_sign_concurrently, are signed in parallel.
+   /// @param num_threads 0 to sign every key on the calling thread.
+   void set_signing_threads(uint16_t num_threads);
       
    /// Sign transaction with the private keys specified via their public keys.
    /// Use chain_controller::get_required_keys to determine which keys are needed for txn.
@@ -58,6 +66,13 @@ public:
    /// @throws fc::exception if corresponding private keys not found in unlocked wallets
    chain::signature_type sign_digest(const chain::digest_type& digest, const public_key_type& key);
 
+   /// Sign many digests in one call, each with the private key of its public key.
+   /// The digests are signed in parallel on the signing threads, see set_signing_threads.
+   /// @param digests pairs of the digest to sign and the public key of the private key to sign it with
+   /// @return the signatures, in the order of digests
+   /// @throws fc::exception if any of the corresponding private keys is not found in unlocked wallets
+   std::vector<chain::signature_type> sign_digests(const std::vector<std::pair<chain::digest_type, public_key_type>>& digests);
+
    /// Create a new wallet.
    /// A new wallet is created in file dir/{name}.wallet see set_dir.
    /// The new wallet is unlocked after creation.
@@ -130,9 +145,25 @@ private:
    /// Calls lock_all() if timeout has passed.
    void check_timeout();
 
+   /// lock_all() and open() for callers already holding mtx.
+   void lock_all_wallets();
+   void open_wallet(const std::string& name);
+
+   /// Sign each digest with its key, on the signing threads when there are several to sign concurrently.
+   /// @pre mtx is held
+   std::vector<chain::signature_type> sign(const std::vector<std::pair<chain::digest_type, public_key_type>>& digests);
+
+   /// @return the unlocked wallet holding key, nullptr if none does.
+   /// Rebuilds the key index first when wallets or their keys changed since it was built.
+   wallet_api* find_wallet(const public_key_type& key);
+
 private:
    using timepoint_t = std::chrono::time_point<std::chrono::system_clock>;
+   std::mutex mtx; ///< guards everything below
    std::map<std::string, std::unique_ptr<wallet_api>> wallets;
+   std::map<public_key_type, wallet_api*> key_index; ///< keys of the unlocked wallets, valid while key_index_valid
+   bool key_index_valid = false;
+   fc::optional<eosio::chain::named_thread_pool> signing_thread_pool;
    std::chrono::seconds timeout = std::chrono::seconds::max(); ///< how long to wait before calling lock_all()
    mutable timepoint_t timeout_time = timepoint_t::max(); ///< when to call lock_all()
    boost::filesystem::path dir = ".";
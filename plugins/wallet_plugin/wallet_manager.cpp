@@ -3,6 +3,7 @@
 #include <eosio/wallet_plugin/wallet.hpp>
 #include <eosio/wallet_plugin/se_wallet.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <fc/scoped_exit.hpp>
 #include <boost/algorithm/string.hpp>
 namespace eosio {
 namespace wallet {
@@ -37,6 +38,7 @@ wallet_manager::~wallet_manager() {
 }
 
 void wallet_manager::set_timeout(const std::chrono::seconds& t) {
+   std::lock_guard<std::mutex> g(mtx);
    timeout = t;
    auto now = std::chrono::system_clock::now();
    timeout_time = now + timeout;
@@ -44,17 +46,25 @@ void wallet_manager::set_timeout(const std::chrono::seconds& t) {
              ("t", t.count())("now", now.time_since_epoch().count())("timeout_time", timeout_time.time_since_epoch().count()));
 }
 
+void wallet_manager::set_signing_threads(uint16_t num_threads) {
+   std::lock_guard<std::mutex> g(mtx);
+   signing_thread_pool.reset();
+   if (num_threads > 0)
+      signing_thread_pool.emplace("sign", num_threads);
+}
+
 void wallet_manager::check_timeout() {
    if (timeout_time != timepoint_t::max()) {
       const auto& now = std::chrono::system_clock::now();
       if (now >= timeout_time) {
-         lock_all();
+         lock_all_wallets();
       }
       timeout_time = now + timeout;
    }
 }
 
 std::string wallet_manager::create(const std::string& name) {
+   std::lock_guard<std::mutex> g(mtx);
    check_timeout();
 
    EOS_ASSERT(valid_filename(name), wallet_exception, "Invalid filename, path not allowed in wallet name ${n}", ("n", name));
@@ -84,13 +94,18 @@ std::string wallet_manager::create(const std::string& name) {
       wallets.erase(it);
    }
    wallets.emplace(name, std::move(wallet));
+   key_index_valid = false;
 
    return password;
 }
 
 void wallet_manager::open(const std::string& name) {
+   std::lock_guard<std::mutex> g(mtx);
    check_timeout();
+   open_wallet(name);
+}
 
+void wallet_manager::open_wallet(const std::string& name) {
    EOS_ASSERT(valid_filename(name), wallet_exception, "Invalid filename, path not allowed in wallet name ${n}", ("n", name));
 
    wallet_data d;
@@ -108,9 +123,11 @@ void wallet_manager::open(const std::string& name) {
       wallets.erase(it);
    }
    wallets.emplace(name, std::move(wallet));
+   key_index_valid = false;
 }
 
 std::vector<std::string> wallet_manager::list_wallets() {
+   std::lock_guard<std::mutex> g(mtx);
    check_timeout();
    std::vector<std::string> result;
    for (const auto& i : wallets) {
@@ -124,6 +141,7 @@ std::vector<std::string> wallet_manager::list_wallets() {
 }
 
 map<public_key_type,private_key_type> wallet_manager::list_keys(const string& name, const string& pw) {
+   std::lock_guard<std::mutex> g(mtx);
    check_timeout();
 
    if (wallets.count(name) == 0)
@@ -136,6 +154,7 @@ map<public_key_type,private_key_type> wallet_manager::list_keys(const string& na
 }
 
 flat_set<public_key_type> wallet_manager::get_public_keys() {
+   std::lock_guard<std::mutex> g(mtx);
    check_timeout();
    EOS_ASSERT(!wallets.empty(), wallet_not_available_exception, "You don't have any wallet!");
    flat_set<public_key_type> result;
@@ -152,15 +171,22 @@ flat_set<public_key_type> wallet_manager::get_public_keys() {
 
 
 void wallet_manager::lock_all() {
+   std::lock_guard<std::mutex> g(mtx);
    // no call to check_timeout since we are locking all anyway
+   lock_all_wallets();
+}
+
+void wallet_manager::lock_all_wallets() {
    for (auto& i : wallets) {
       if (!i.second->is_locked()) {
          i.second->lock();
       }
    }
+   key_index_valid = false;
 }
 
 void wallet_manager::lock(const std::string& name) {
+   std::lock_guard<std::mutex> g(mtx);
    check_timeout();
    if (wallets.count(name) == 0) {
       EOS_THROW(chain::wallet_nonexistent_exception, "Wallet not found: ${w}", ("w", name));
@@ -170,12 +196,14 @@ void wallet_manager::lock(const std::string& name) {
       return;
    }
    w->lock();
+   key_index_valid = false;
 }
 
 void wallet_manager::unlock(const std::string& name, const std::string& password) {
+   std::lock_guard<std::mutex> g(mtx);
    check_timeout();
    if (wallets.count(name) == 0) {
-      open( name );
+      open_wallet( name );
    }
    auto& w = wallets.at(name);
    if (!w->is_locked()) {
@@ -183,9 +211,11 @@ void wallet_manager::unlock(const std::string& name, const std::string& password
       return;
    }
    w->unlock(password);
+   key_index_valid = false;
 }
 
 void wallet_manager::import_key(const std::string& name, const std::string& wif_key) {
+   std::lock_guard<std::mutex> g(mtx);
    check_timeout();
    if (wallets.count(name) == 0) {
       EOS_THROW(chain::wallet_nonexistent_exception, "Wallet not found: ${w}", ("w", name));
@@ -195,9 +225,11 @@ void wallet_manager::import_key(const std::string& name, const std::string& wif_
       EOS_THROW(chain::wallet_locked_exception, "Wallet is locked: ${w}", ("w", name));
    }
    w->import_key(wif_key);
+   key_index_valid = false;
 }
 
 void wallet_manager::remove_key(const std::string& name, const std::string& password, const std::string& key) {
+   std::lock_guard<std::mutex> g(mtx);
    check_timeout();
    if (wallets.count(name) == 0) {
       EOS_THROW(chain::wallet_nonexistent_exception, "Wallet not found: ${w}", ("w", name));
@@ -208,9 +240,11 @@ void wallet_manager::remove_key(const std::string& name, const std::string& pass
    }
    w->check_password(password); //throws if bad password
    w->remove_key(key);
+   key_index_valid = false;
 }
 
 string wallet_manager::create_key(const std::string& name, const std::string& key_type) {
+   std::lock_guard<std::mutex> g(mtx);
    check_timeout();
    if (wallets.count(name) == 0) {
       EOS_THROW(chain::wallet_nonexistent_exception, "Wallet not found: ${w}", ("w", name));
@@ -221,55 +255,116 @@ string wallet_manager::create_key(const std::string& name, const std::string& ke
    }
 
    string upper_key_type = boost::to_upper_copy<std::string>(key_type);
+   key_index_valid = false;
    return w->create_key(upper_key_type);
 }
 
-chain::signed_transaction
-wallet_manager::sign_transaction(const chain::signed_transaction& txn, const flat_set<public_key_type>& keys, const chain::chain_id_type& id) {
-   check_timeout();
-   chain::signed_transaction stxn(txn);
-
-   for (const auto& pk : keys) {
-      bool found = false;
+wallet_api* wallet_manager::find_wallet(const public_key_type& key) {
+   if (!key_index_valid) {
+      key_index.clear();
       for (const auto& i : wallets) {
          if (!i.second->is_locked()) {
-            fc::optional<signature_type> sig = i.second->try_sign_digest(stxn.sig_digest(id, stxn.context_free_data), pk);
-            if (sig) {
-               stxn.signatures.push_back(*sig);
-               found = true;
-               break; // inner for
+            for (const auto& pk : i.second->list_public_keys()) {
+               key_index.emplace(pk, i.second.get()); // first wallet in name order wins, as when searching them in turn
             }
          }
       }
-      if (!found) {
-         EOS_THROW(chain::wallet_missing_pub_key_exception, "Public key not found in unlocked wallets ${k}", ("k", pk));
+      key_index_valid = true;
+   }
+   auto it = key_index.find(key);
+   return it != key_index.end() ? it->second : nullptr;
+}
+
+std::vector<chain::signature_type>
+wallet_manager::sign(const std::vector<std::pair<chain::digest_type, public_key_type>>& digests) {
+   std::vector<wallet_api*> signers;
+   signers.reserve(digests.size());
+   size_t concurrent = 0;
+   for (const auto& d : digests) {
+      wallet_api* w = find_wallet(d.second);
+      if (!w) {
+         EOS_THROW(chain::wallet_missing_pub_key_exception, "Public key not found in unlocked wallets ${k}", ("k", d.second));
+      }
+      signers.push_back(w);
+      if (w->can_sign_concurrently()) ++concurrent;
+   }
+
+   // holding mtx keeps the wallets unchanged while the signing threads use them
+   std::vector<std::future<fc::optional<signature_type>>> pending(digests.size());
+   auto wait_pending = fc::make_scoped_exit([&pending]() {
+      for (auto& p : pending) {
+         if (p.valid()) p.wait();
+      }
+   });
+   if (signing_thread_pool && concurrent > 1) {
+      for (size_t i = 0; i < signers.size(); ++i) {
+         if (signers[i]->can_sign_concurrently()) {
+            pending[i] = async_thread_pool(signing_thread_pool->get_executor(), [w = signers[i], &d = digests[i]]() {
+               return w->try_sign_digest(d.first, d.second);
+            });
+         }
+      }
+   }
+
+   std::vector<chain::signature_type> sigs;
+   sigs.reserve(digests.size());
+   for (size_t i = 0; i < signers.size(); ++i) {
+      fc::optional<signature_type> sig = pending[i].valid() ? pending[i].get() : signers[i]->try_sign_digest(digests[i].first, digests[i].second);
+      if (!sig) {
+         EOS_THROW(chain::wallet_missing_pub_key_exception, "Public key not found in unlocked wallets ${k}", ("k", digests[i].second));
       }
+      sigs.push_back(*sig);
    }
+   return sigs;
+}
+
+chain::signed_transaction
+wallet_manager::sign_transaction(const chain::signed_transaction& txn, const flat_set<public_key_type>& keys, const chain::chain_id_type& id) {
+   std::lock_guard<std::mutex> g(mtx);
+   check_timeout();
+   chain::signed_transaction stxn(txn);
+   const auto digest = stxn.sig_digest(id, stxn.context_free_data);
+
+   std::vector<std::pair<chain::digest_type, public_key_type>> digests;
+   digests.reserve(keys.size());
+   for (const auto& pk : keys) {
+      digests.emplace_back(digest, pk);
+   }
+   auto sigs = sign(digests);
+   stxn.signatures.insert(stxn.signatures.end(), sigs.begin(), sigs.end());
 
    return stxn;
 }
 
 chain::signature_type
 wallet_manager::sign_digest(const chain::digest_type& digest, const public_key_type& key) {
+   std::lock_guard<std::mutex> g(mtx);
    check_timeout();
 
    try {
-      for (const auto& i : wallets) {
-         if (!i.second->is_locked()) {
-            fc::optional<signature_type> sig = i.second->try_sign_digest(digest, key);
-            if (sig)
-               return *sig;
-         }
+      if (wallet_api* w = find_wallet(key)) {
+         fc::optional<signature_type> sig = w->try_sign_digest(digest, key);
+         if (sig)
+            return *sig;
       }
    } FC_LOG_AND_RETHROW();
 
    EOS_THROW(chain::wallet_missing_pub_key_exception, "Public key not found in unlocked wallets ${k}", ("k", key));
 }
 
+std::vector<chain::signature_type>
+wallet_manager::sign_digests(const std::vector<std::pair<chain::digest_type, public_key_type>>& digests) {
+   std::lock_guard<std::mutex> g(mtx);
+   check_timeout();
+   return sign(digests);
+}
+
 void wallet_manager::own_and_use_wallet(const string& name, std::unique_ptr<wallet_api>&& wallet) {
+   std::lock_guard<std::mutex> g(mtx);
    if(wallets.find(name) != wallets.end())
       EOS_THROW(wallet_exception, "Tried to use wallet name that already exists.");
    wallets.emplace(name, std::move(wallet));
+   key_index_valid = false;
 }
 
 void wallet_manager::start_lock_watch(std::shared_ptr<boost::asio::deadline_timer> t)
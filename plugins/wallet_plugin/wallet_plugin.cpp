@@ -27,6 +27,8 @@ void wallet_plugin::set_program_options(options_description& cli, options_descri
           "Timeout for unlocked wallet in seconds (default 900 (15 minutes)). "
           "Wallets will automatically lock after specified number of seconds of inactivity. "
           "Activity is defined as any wallet command e.g. list-wallets.")
+         ("wallet-signing-threads", bpo::value<uint16_t>()->default_value(0),
+          "Number of threads signing the keys a transaction needs in parallel, 0 to sign them one after another")
          ("yubihsm-url", bpo::value<string>()->value_name("URL"),
           "Override default URL of http://localhost:12345 for connecting to yubihsm-connector")
          ("yubihsm-authkey", bpo::value<uint16_t>()->value_name("key_num"),
@@ -52,6 +54,7 @@ void wallet_plugin::plugin_initialize(const variables_map& options) {
          std::chrono::seconds t(timeout);
          wallet_manager_ptr->set_timeout(t);
       }
+      wallet_manager_ptr->set_signing_threads(options.at("wallet-signing-threads").as<uint16_t>());
       if (options.count("yubihsm-authkey")) {
          uint16_t key = options.at("yubihsm-authkey").as<uint16_t>();
          string connector_endpoint = "http://localhost:12345";
@@ -10,7 +10,9 @@
 
 #include <iostream>
 #include <istream>
+#include <map>
 #include <ostream>
+#include <sstream>
 #include <string>
 #include <regex>
 #include <boost/algorithm/string.hpp>
@@ -30,20 +32,54 @@ using namespace eosio::chain;
 namespace eosio { namespace client { namespace http {
 
    namespace detail {
+      /**
+       * A connection to a server, kept open between calls when keep-alive is enabled
+       */
+      class http_connection {
+         public:
+            virtual ~http_connection() = default;
+
+            /**
+             * Send the request and read the response
+             * @param keep_alive in: the request asked to keep the connection open, out: the connection can be reused
+             */
+            virtual std::string txrx(const std::string& request, unsigned int& status_code, bool& keep_alive) = 0;
+      };
+
       class http_context_impl {
          public:
             boost::asio::io_service ios;
+            bool keep_alive = false;
+            // declared after ios so open connections are closed before it is destroyed
+            std::map<string, std::unique_ptr<http_connection>> idle_connections;
+            std::map<string, resolved_url> resolved_urls;
       };
 
       void http_context_deleter::operator()(http_context_impl* p) const {
          delete p;
       }
+
+      /**
+       * The server closed the connection before sending any of the response.  This is how a kept-alive connection the
+       * server timed out looks, the request was not processed and can be sent again on a new connection.
+       */
+      struct connection_closed : boost::system::system_error {
+         using boost::system::system_error::system_error;
+      };
    }
 
    http_context create_http_context() {
       return http_context(new detail::http_context_impl, detail::http_context_deleter());
    }
 
+   void set_keep_alive( const http_context& context, bool keep_alive ) {
+      context->keep_alive = keep_alive;
+      if( !keep_alive ) {
+         context->idle_connections.clear();
+         context->resolved_urls.clear();
+      }
+   }
+
    void do_connect(tcp::socket& sock, const resolved_url& url) {
       // Get a list of endpoints corresponding to the server name.
       vector<tcp::endpoint> endpoints;
@@ -55,15 +91,27 @@ namespace eosio { namespace client { namespace http {
    }
 
    template<class T>
-   std::string do_txrx(T& socket, boost::asio::streambuf& request_buff, unsigned int& status_code) {
+   std::string do_txrx(T& socket, const std::string& request, unsigned int& status_code, bool& keep_alive) {
       // Send the request.
-      boost::asio::write(socket, request_buff);
+      try {
+         boost::asio::write(socket, boost::asio::buffer(request));
+      } catch( const boost::system::system_error& e ) {
+         if( e.code() == boost::asio::error::broken_pipe || e.code() == boost::asio::error::connection_reset )
+            throw detail::connection_closed(e.code());
+         throw;
+      }
 
       // Read the response status line. The response streambuf will automatically
       // grow to accommodate the entire line. The growth may be limited by passing
       // a maximum size to the streambuf constructor.
       boost::asio::streambuf response;
-      boost::asio::read_until(socket, response, "\r\n");
+      try {
+         boost::asio::read_until(socket, response, "\r\n");
+      } catch( const boost::system::system_error& e ) {
+         if( response.size() == 0 && (e.code() == boost::asio::error::eof || e.code() == boost::asio::error::connection_reset) )
+            throw detail::connection_closed(e.code());
+         throw;
+      }
 
       // Check that response is OK.
       std::istream response_stream(&response);
@@ -83,11 +131,15 @@ namespace eosio { namespace client { namespace http {
       // Process the response headers.
       std::string header;
       int response_content_length = -1;
+      bool connection_close = http_version != "HTTP/1.1";
       std::regex clregex(R"xx(^content-length:\s+(\d+))xx", std::regex_constants::icase);
+      std::regex connregex(R"xx(^connection:\s+(\S+))xx", std::regex_constants::icase);
       while (std::getline(response_stream, header) && header != "\r") {
          std::smatch match;
          if(std::regex_search(header, match, clregex))
             response_content_length = std::stoi(match[1]);
+         else if(std::regex_search(header, match, connregex))
+            connection_close = boost::iequals(match.str(1), "close");
       }
 
       // Attempt to read the response body using the length indicated by the
@@ -96,10 +148,13 @@ namespace eosio { namespace client { namespace http {
          response_content_length -= response.size();
          if( response_content_length > 0 )
             boost::asio::read(socket, response, boost::asio::transfer_exactly(response_content_length));
+         // anything read past the body leaves the connection in an unknown state
+         keep_alive = keep_alive && !connection_close && response_content_length >= 0;
       } else {
          boost::system::error_code ec;
          boost::asio::read(socket, response, boost::asio::transfer_all(), ec);
          EOS_ASSERT(!ec || ec == boost::asio::ssl::error::stream_truncated, http_exception, "Unable to read http response: ${err}", ("err",ec.message()));
+         keep_alive = false;
       }
 
       std::stringstream re;
@@ -107,6 +162,46 @@ namespace eosio { namespace client { namespace http {
       return re.str();
    }
 
+   namespace detail {
+      boost::asio::ssl::context client_ssl_context() {
+         boost::asio::ssl::context ssl_context(boost::asio::ssl::context::sslv23_client);
+         fc::add_platform_root_cas_to_context(ssl_context);
+         return ssl_context;
+      }
+
+      template<typename Socket>
+      class socket_connection : public http_connection {
+         public:
+            template<typename... Args>
+            explicit socket_connection(Args&&... args) : socket(std::forward<Args>(args)...) {}
+
+            std::string txrx(const std::string& request, unsigned int& status_code, bool& keep_alive) override {
+               return do_txrx(socket, request, status_code, keep_alive);
+            }
+
+            Socket socket;
+      };
+
+      class https_connection : public http_connection {
+         public:
+            explicit https_connection(boost::asio::io_service& ios)
+            : ssl_context(client_ssl_context())
+            , socket(ios, ssl_context) {}
+
+            ~https_connection() override {
+               //try and do a clean shutdown; but swallow if this fails (other side could have already gave TCP the ax)
+               try {socket.shutdown();} catch(...) {}
+            }
+
+            std::string txrx(const std::string& request, unsigned int& status_code, bool& keep_alive) override {
+               return do_txrx(socket, request, status_code, keep_alive);
+            }
+
+            boost::asio::ssl::context ssl_context;
+            boost::asio::ssl::stream<boost::asio::ip::tcp::socket> socket;
+      };
+   }
+
    parsed_url parse_url( const string& server_url ) {
       parsed_url res;
 
@@ -141,6 +236,12 @@ namespace eosio { namespace client { namespace http {
       if(url.scheme == "unix")
          return resolved_url(url);
 
+      if( context->keep_alive ) {
+         auto itr = context->resolved_urls.find(url.scheme + "://" + url.server + ":" + url.port);
+         if( itr != context->resolved_urls.end() )
+            return resolved_url(url, vector<string>(itr->second.resolved_addresses), itr->second.resolved_port, itr->second.is_loopback);
+      }
+
       tcp::resolver resolver(context->ios);
       boost::system::error_code ec;
       auto result = resolver.resolve(tcp::v4(), url.server, url.port, ec);
@@ -168,7 +269,10 @@ namespace eosio { namespace client { namespace http {
          }
       }
 
-      return resolved_url(url, std::move(resolved_addresses), *resolved_port, is_loopback);
+      resolved_url resolved(url, std::move(resolved_addresses), *resolved_port, is_loopback);
+      if( context->keep_alive )
+         context->resolved_urls.emplace(url.scheme + "://" + url.server + ":" + url.port, resolved);
+      return resolved;
    }
 
    string format_host_header(const resolved_url& url) {
@@ -194,14 +298,14 @@ namespace eosio { namespace client { namespace http {
 
    const auto& url = cp.url;
 
-   boost::asio::streambuf request;
-   std::ostream request_stream(&request);
+   const bool keep_alive = cp.context->keep_alive;
+   std::ostringstream request_stream;
    auto host_header_value = format_host_header(url);
-   request_stream << "POST " << url.path << " HTTP/1.0\r\n";
+   request_stream << "POST " << url.path << (keep_alive ? " HTTP/1.1\r\n" : " HTTP/1.0\r\n");
    request_stream << "Host: " << host_header_value << "\r\n";
    request_stream << "content-length: " << postjson.size() << "\r\n";
    request_stream << "Accept: */*\r\n";
-   request_stream << "Connection: close\r\n";
+   request_stream << (keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n");
    // append more customized headers
    std::vector<string>::iterator itr;
    for (itr = cp.headers.begin(); itr != cp.headers.end(); itr++) {
@@ -209,35 +313,32 @@ namespace eosio { namespace client { namespace http {
    }
    request_stream << "\r\n";
    request_stream << postjson;
+   const std::string request = request_stream.str();
 
    if ( print_request ) {
-      string s(request.size(), '\0');
-      buffer_copy(boost::asio::buffer(s), request.data());
       std::cerr << "REQUEST:" << std::endl
                 << "---------------------" << std::endl
-                << s << std::endl
+                << request << std::endl
                 << "---------------------" << std::endl;
    }
 
    unsigned int status_code;
    std::string re;
 
-   try {
+   auto connect = [&]() -> std::unique_ptr<detail::http_connection> {
       if(url.scheme == "unix") {
-         boost::asio::local::stream_protocol::socket unix_socket(cp.context->ios);
-         unix_socket.connect(boost::asio::local::stream_protocol::endpoint(url.server));
-         re = do_txrx(unix_socket, request, status_code);
+         auto conn = std::make_unique<detail::socket_connection<boost::asio::local::stream_protocol::socket>>(cp.context->ios);
+         conn->socket.connect(boost::asio::local::stream_protocol::endpoint(url.server));
+         return conn;
       }
       else if(url.scheme == "http") {
-         tcp::socket socket(cp.context->ios);
-         do_connect(socket, url);
-         re = do_txrx(socket, request, status_code);
+         auto conn = std::make_unique<detail::socket_connection<tcp::socket>>(cp.context->ios);
+         do_connect(conn->socket, url);
+         return conn;
       }
       else { //https
-         boost::asio::ssl::context ssl_context(boost::asio::ssl::context::sslv23_client);
-         fc::add_platform_root_cas_to_context(ssl_context);
-
-         boost::asio::ssl::stream<boost::asio::ip::tcp::socket> socket(cp.context->ios, ssl_context);
+         auto conn = std::make_unique<detail::https_connection>(cp.context->ios);
+         auto& socket = conn->socket;
          SSL_set_tlsext_host_name(socket.native_handle(), url.server.c_str());
          if(cp.verify_cert) {
             socket.set_verify_mode(boost::asio::ssl::verify_peer);
@@ -245,10 +346,33 @@ namespace eosio { namespace client { namespace http {
          }
          do_connect(socket.next_layer(), url);
          socket.handshake(boost::asio::ssl::stream_base::client);
-         re = do_txrx(socket, request, status_code);
-         //try and do a clean shutdown; but swallow if this fails (other side could have already gave TCP the ax)
-         try {socket.shutdown();} catch(...) {}
+         return conn;
+      }
+   };
+
+   try {
+      const auto connection_key = url.scheme + "://" + url.server + ":" + url.port;
+      auto& idle = cp.context->idle_connections;
+      std::unique_ptr<detail::http_connection> conn;
+      bool reusable = keep_alive;
+      auto itr = idle.find(connection_key);
+      if( itr != idle.end() ) {
+         conn = std::move(itr->second);
+         idle.erase(itr);
+         try {
+            re = conn->txrx(request, status_code, reusable);
+         } catch( const detail::connection_closed& ) {
+            // the server closed the idle connection, send the request again on a new one
+            conn.reset();
+            reusable = keep_alive;
+         }
+      }
+      if( !conn ) {
+         conn = connect();
+         re = conn->txrx(request, status_code, reusable);
       }
+      if( reusable )
+         idle[connection_key] = std::move(conn);
    } catch ( invalid_http_request& e ) {
       e.append_log( FC_LOG_MESSAGE( info, "Please verify this url is valid: ${url}", ("url", url.scheme + "://" + url.server + ":" + url.port + url.path) ) );
       e.append_log( FC_LOG_MESSAGE( info, "If the condition persists, please contact the RPC server administrator for ${server}!", ("server", url.server) ) );
@@ -16,6 +16,13 @@ namespace eosio { namespace client { namespace http {
 
    http_context create_http_context();
 
+   /**
+    * When enabled, calls made with the context ask the server to keep the connection open, and the next call to the
+    * same server is sent over it instead of connecting (and for https, handshaking) again.  Server addresses are also
+    * only resolved once.  Disabled by default, each call then opens and closes its own connection.
+    */
+   void set_keep_alive( const http_context& context, bool keep_alive );
+
    struct parsed_url {
       string scheme;
       string server;
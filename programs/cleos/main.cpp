@@ -65,6 +65,11 @@ Options:
 */
 
 #include <pwd.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
 #include <string>
 #include <vector>
 #include <regex>
@@ -77,6 +82,7 @@ Options:
 #include <fc/exception/exception.hpp>
 #include <fc/variant_object.hpp>
 #include <fc/static_variant.hpp>
+#include <fc/scoped_exit.hpp>
 
 #include <eosio/chain/name.hpp>
 #include <eosio/chain/config.hpp>
@@ -929,8 +935,8 @@ void try_local_port(uint32_t duration) {
 void ensure_keosd_running(CLI::App* app) {
     if (no_auto_keosd)
         return;
-    // get, version, net, convert do not require keosd
-    if (tx_skip_sign || app->got_subcommand("get") || app->got_subcommand("version") || app->got_subcommand("net") || app->got_subcommand("convert"))
+    // get, version, net, convert do not require keosd, commands of a batch decide for themselves
+    if (tx_skip_sign || app->got_subcommand("batch") || app->got_subcommand("get") || app->got_subcommand("version") || app->got_subcommand("net") || app->got_subcommand("convert"))
         return;
     if (app->get_subcommand("create")->got_subcommand("key")) // create key does not require wallet
        return;
@@ -2391,6 +2397,319 @@ CLI::callback_t header_opt_callback = [](CLI::results_t res) {
    return true;
 };
 
+/// options of the main command, restored before each command of a batch so that one does not leak into the next
+struct global_options {
+   string           url = ::url;
+   string           wallet_url = ::wallet_url;
+   bool             no_verify = ::no_verify;
+   vector<string>   headers = ::headers;
+   fc::microseconds tx_expiration = ::tx_expiration;
+   string           tx_ref_block_num_or_id = ::tx_ref_block_num_or_id;
+   bool             tx_force_unique = ::tx_force_unique;
+   bool             tx_dont_broadcast = ::tx_dont_broadcast;
+   bool             tx_return_packed = ::tx_return_packed;
+   bool             tx_skip_sign = ::tx_skip_sign;
+   bool             tx_print_json = ::tx_print_json;
+   bool             tx_use_old_rpc = ::tx_use_old_rpc;
+   string           tx_json_save_file = ::tx_json_save_file;
+   bool             print_request = ::print_request;
+   bool             print_response = ::print_response;
+   bool             no_auto_keosd = ::no_auto_keosd;
+   bool             verbose = ::verbose;
+   uint8_t          tx_max_cpu_usage = ::tx_max_cpu_usage;
+   uint32_t         tx_max_net_usage = ::tx_max_net_usage;
+   uint32_t         delaysec = ::delaysec;
+   vector<string>   tx_permission = ::tx_permission;
+
+   void restore() const {
+      ::url = url;
+      ::wallet_url = wallet_url;
+      ::no_verify = no_verify;
+      ::headers = headers;
+      ::tx_expiration = tx_expiration;
+      ::tx_ref_block_num_or_id = tx_ref_block_num_or_id;
+      ::tx_force_unique = tx_force_unique;
+      ::tx_dont_broadcast = tx_dont_broadcast;
+      ::tx_return_packed = tx_return_packed;
+      ::tx_skip_sign = tx_skip_sign;
+      ::tx_print_json = tx_print_json;
+      ::tx_use_old_rpc = tx_use_old_rpc;
+      ::tx_json_save_file = tx_json_save_file;
+      ::print_request = print_request;
+      ::print_response = print_response;
+      ::no_auto_keosd = no_auto_keosd;
+      ::verbose = verbose;
+      ::tx_max_cpu_usage = tx_max_cpu_usage;
+      ::tx_max_net_usage = tx_max_net_usage;
+      ::delaysec = delaysec;
+      ::tx_permission = tx_permission;
+   }
+};
+
+/// the output and exit code of one command of a batch run by a job
+struct batch_result {
+   int32_t code = 1;
+   string  out;
+   string  err;
+};
+
+bool in_batch = false;
+string program_name;
+
+int run_command( int argc, char** argv );
+
+/// splits a line of a batch into arguments like a shell: whitespace separates them unless quoted or escaped, # starts a comment
+vector<string> split_command_line( const string& line ) {
+   vector<string> args;
+   string arg;
+   bool in_arg = false;
+   char quote = 0;
+   for( size_t i = 0; i < line.size(); ++i ) {
+      const char c = line[i];
+      if( quote == '\'' ) {
+         if( c == '\'' ) quote = 0;
+         else arg += c;
+      } else if( quote == '"' ) {
+         if( c == '"' ) quote = 0;
+         else if( c == '\\' && i + 1 < line.size() && (line[i + 1] == '"' || line[i + 1] == '\\') ) arg += line[++i];
+         else arg += c;
+      } else if( c == '\'' || c == '"' ) {
+         quote = c;
+         in_arg = true;
+      } else if( c == '\\' && i + 1 < line.size() ) {
+         arg += line[++i];
+         in_arg = true;
+      } else if( std::isspace( static_cast<unsigned char>(c) ) ) {
+         if( in_arg ) {
+            args.push_back( std::move(arg) );
+            arg.clear();
+            in_arg = false;
+         }
+      } else if( c == '#' && !in_arg ) {
+         break;
+      } else {
+         arg += c;
+         in_arg = true;
+      }
+   }
+   EOSC_ASSERT( quote == 0, "ERROR: Unterminated quote in batch command: ${line}", ("line", line) );
+   if( in_arg )
+      args.push_back( std::move(arg) );
+   return args;
+}
+
+int run_batch_command( const global_options& options, vector<string> args ) {
+   options.restore();
+   args.insert( args.begin(), program_name );
+   vector<char*> argv;
+   for( auto& arg : args )
+      argv.push_back( &arg[0] );
+   argv.push_back( nullptr );
+   try {
+      return run_command( argv.size() - 1, argv.data() );
+   } catch( const std::exception& e ) {
+      elog("Failed with error: ${e}", ("e", e.what()));
+      return 1;
+   }
+}
+
+string read_all( FILE* f ) {
+   string content;
+   char buffer[4096];
+   rewind( f );
+   size_t n;
+   while( (n = fread( buffer, 1, sizeof(buffer), f )) > 0 )
+      content.append( buffer, n );
+   return content;
+}
+
+/// runs a command with its stdout and stderr, including what is printed with printf or logged, captured
+batch_result run_captured( const global_options& options, const vector<string>& args ) {
+   FILE* out = tmpfile();
+   FILE* err = tmpfile();
+   EOSC_ASSERT( out && err, "ERROR: Unable to create a file to capture the output of a batch command" );
+   auto close_files = fc::make_scoped_exit([out, err]() { fclose( out ); fclose( err ); });
+
+   std::cout.flush();
+   fflush( stdout );
+   const int saved_out = dup( STDOUT_FILENO );
+   const int saved_err = dup( STDERR_FILENO );
+   dup2( fileno( out ), STDOUT_FILENO );
+   dup2( fileno( err ), STDERR_FILENO );
+
+   batch_result result;
+   result.code = run_batch_command( options, args );
+
+   std::cout.flush();
+   fflush( stdout );
+   std::cerr.flush();
+   fflush( stderr );
+   dup2( saved_out, STDOUT_FILENO );
+   dup2( saved_err, STDERR_FILENO );
+   close( saved_out );
+   close( saved_err );
+
+   result.out = read_all( out );
+   result.err = read_all( err );
+   return result;
+}
+
+bool write_all( int fd, const char* data, size_t size ) {
+   while( size > 0 ) {
+      const auto n = write( fd, data, size );
+      if( n < 0 && errno == EINTR ) continue;
+      if( n <= 0 ) return false;
+      data += n;
+      size -= n;
+   }
+   return true;
+}
+
+bool read_all( int fd, char* data, size_t size ) {
+   while( size > 0 ) {
+      const auto n = read( fd, data, size );
+      if( n < 0 && errno == EINTR ) continue;
+      if( n <= 0 ) return false;
+      data += n;
+      size -= n;
+   }
+   return true;
+}
+
+bool write_batch_result( int fd, const batch_result& result ) {
+   const uint64_t out_size = result.out.size();
+   const uint64_t err_size = result.err.size();
+   return write_all( fd, reinterpret_cast<const char*>(&result.code), sizeof(result.code) ) &&
+          write_all( fd, reinterpret_cast<const char*>(&out_size), sizeof(out_size) ) &&
+          write_all( fd, result.out.data(), out_size ) &&
+          write_all( fd, reinterpret_cast<const char*>(&err_size), sizeof(err_size) ) &&
+          write_all( fd, result.err.data(), err_size );
+}
+
+bool read_batch_result( int fd, batch_result& result ) {
+   uint64_t size = 0;
+   if( !read_all( fd, reinterpret_cast<char*>(&result.code), sizeof(result.code) ) ||
+       !read_all( fd, reinterpret_cast<char*>(&size), sizeof(size) ) )
+      return false;
+   result.out.resize( size );
+   if( !read_all( fd, &result.out[0], size ) || !read_all( fd, reinterpret_cast<char*>(&size), sizeof(size) ) )
+      return false;
+   result.err.resize( size );
+   return read_all( fd, &result.err[0], size );
+}
+
+/**
+ * Runs the commands in forked jobs, since the options of a command are globals a job runs one at a time.  Commands are
+ * given out in turn, job j runs commands j, j + jobs, ..., and their output is printed in the order of the commands as
+ * soon as the earlier ones are printed.
+ * @return the number of commands that failed
+ */
+uint32_t run_batch_jobs( const global_options& options, const vector<vector<string>>& commands, uint32_t jobs ) {
+   jobs = std::min<size_t>( jobs, commands.size() );
+   std::cout.flush();
+   fflush( stdout );
+   fflush( stderr );
+
+   vector<pid_t> pids;
+   vector<int> results;
+   for( uint32_t j = 0; j < jobs; ++j ) {
+      int fds[2];
+      EOSC_ASSERT( pipe( fds ) == 0, "ERROR: Unable to create a pipe for a batch job: ${e}", ("e", strerror(errno)) );
+      const pid_t pid = fork();
+      EOSC_ASSERT( pid >= 0, "ERROR: Unable to start a batch job: ${e}", ("e", strerror(errno)) );
+      if( pid == 0 ) {
+         close( fds[0] );
+         for( int fd : results )
+            close( fd );
+         // each job keeps its own connections
+         context = eosio::client::http::create_http_context();
+         set_keep_alive( context, true );
+         for( size_t i = j; i < commands.size(); i += jobs ) {
+            if( !write_batch_result( fds[1], run_captured( options, commands[i] ) ) )
+               break;
+         }
+         close( fds[1] );
+         _exit( 0 );
+      }
+      close( fds[1] );
+      pids.push_back( pid );
+      results.push_back( fds[0] );
+   }
+
+   uint32_t failed = 0;
+   for( size_t i = 0; i < commands.size(); ++i ) {
+      batch_result result;
+      if( !read_batch_result( results[i % jobs], result ) ) {
+         std::cerr << localized("ERROR: The batch job running command ${i} exited before completing it", ("i", i + 1)) << std::endl;
+         ++failed;
+         continue;
+      }
+      std::cout << result.out << std::flush;
+      std::cerr << result.err << std::flush;
+      if( result.code != 0 )
+         ++failed;
+   }
+
+   for( uint32_t j = 0; j < jobs; ++j ) {
+      close( results[j] );
+      waitpid( pids[j], nullptr, 0 );
+   }
+   return failed;
+}
+
+/**
+ * Runs the commands of a file, one per line, as if each was given to a separate cleos with the options of the batch.
+ * Connections to the servers are kept open from one command to the next.
+ */
+void run_batch( const string& file, uint32_t jobs ) {
+   EOSC_ASSERT( !in_batch, "ERROR: A batch can not run another batch" );
+   EOSC_ASSERT( jobs > 0, "ERROR: --jobs must be at least 1" );
+
+   std::ifstream in_file;
+   if( file != "-" ) {
+      in_file.open( file );
+      EOSC_ASSERT( in_file.is_open(), "ERROR: Unable to open batch file ${f}", ("f", file) );
+   }
+   std::istream& in = file == "-" ? std::cin : in_file;
+
+   in_batch = true;
+   const global_options options;
+   auto restore = fc::make_scoped_exit([&options]() {
+      in_batch = false;
+      options.restore();
+   });
+   set_keep_alive( context, true );
+
+   uint32_t count = 0;
+   uint32_t failed = 0;
+   vector<vector<string>> commands;
+   string line;
+   while( std::getline( in, line ) ) {
+      vector<string> args;
+      try {
+         args = split_command_line( line );
+      } catch( const explained_exception& ) {
+         ++count;
+         ++failed;
+         continue;
+      }
+      if( args.empty() )
+         continue;
+      ++count;
+      // without jobs commands are run as they are read
+      if( jobs == 1 ) {
+         if( run_batch_command( options, std::move(args) ) != 0 )
+            ++failed;
+      } else {
+         commands.push_back( std::move(args) );
+      }
+   }
+   if( !commands.empty() )
+      failed += run_batch_jobs( options, commands, jobs );
+
+   EOSC_ASSERT( failed == 0, "ERROR: ${f} of ${n} batch commands failed", ("f", failed)("n", count) );
+}
+
 int main( int argc, char** argv ) {
    setlocale(LC_ALL, "");
    bindtextdomain(locale_domain, locale_path);
@@ -2398,7 +2717,12 @@ int main( int argc, char** argv ) {
    fc::logger::get(DEFAULT_LOGGER).set_log_level(fc::log_level::debug);
    context = eosio::client::http::create_http_context();
    wallet_url = default_wallet_url;
+   program_name = argv[0];
 
+   return run_command( argc, argv );
+}
+
+int run_command( int argc, char** argv ) {
    CLI::App app{"Command Line Interface to EOSIO Client"};
    app.require_subcommand();
    app.add_option( "-H,--host", obsoleted_option_host_port, localized("the host where ${n} is running", ("n", node_executable_name)) )->group("hidden");
@@ -2692,10 +3016,12 @@ int main( int argc, char** argv ) {
    getTable->add_flag("-b,--binary", binary, localized("Return the value as BINARY rather than using abi to interpret as JSON"));
    getTable->add_flag("-r,--reverse", reverse, localized("Iterate in reverse order"));
    getTable->add_flag("--show-payer", show_payer, localized("show RAM payer"));
+   bool all_rows = false;
+   getTable->add_flag("--all", all_rows, localized("Retrieve all rows between the bounds, requesting --limit rows at a time"));
 
 
    getTable->set_callback([&] {
-      auto result = call(get_table_func, fc::mutable_variant_object("json", !binary)
+      auto params = fc::mutable_variant_object("json", !binary)
                          ("code",code)
                          ("scope",scope)
                          ("table",table)
@@ -2707,8 +3033,27 @@ int main( int argc, char** argv ) {
                          ("index_position", index_position)
                          ("encode_type", encode_type)
                          ("reverse", reverse)
-                         ("show_payer", show_payer)
-                         );
+                         ("show_payer", show_payer);
+      auto result = call(get_table_func, params);
+      if( all_rows ) {
+         auto rows = result["rows"].get_array();
+         while( result["more"].as_bool() ) {
+            // the cursor continues exactly where the page stopped, nodes without it only return the next key
+            const auto& page = result.get_object();
+            if( page.contains("next_cursor") && !page["next_cursor"].as_string().empty() ) {
+               params("cursor", page["next_cursor"].as_string());
+            } else {
+               const auto next_key = page.contains("next_key") ? page["next_key"].as_string() : string();
+               if( next_key.empty() )
+                  break;
+               params(reverse ? "upper_bound" : "lower_bound", next_key);
+            }
+            result = call(get_table_func, params);
+            const auto& more_rows = result["rows"].get_array();
+            rows.insert(rows.end(), more_rows.begin(), more_rows.end());
+         }
+         result = fc::mutable_variant_object("rows", std::move(rows))("more", false)("next_key", "");
+      }
 
       std::cout << fc::json::to_pretty_string(result)
                 << std::endl;
@@ -3993,6 +4338,15 @@ int main( int argc, char** argv ) {
    auto rexexec        = rexexec_subcommand(rex);
    auto closerex       = closerex_subcommand(rex);
 
+   // batch
+   string batch_file = "-";
+   uint32_t batch_jobs = 1;
+   auto batch = app.add_subcommand("batch", localized("Run commands from a file, one per line, reusing the connections to ${n} and ${k}", ("n", node_executable_name)("k", key_store_executable_name)), false);
+   batch->add_option("file", batch_file, localized("The file to read the commands from, - for stdin; each line holds the arguments of one command, quoted as in a shell"), true);
+   batch->add_option("-j,--jobs", batch_jobs, localized("The number of commands run at the same time, each job with its own connections; output is printed in the order of the commands"), true);
+   batch->set_callback([&] {
+      run_batch(batch_file, batch_jobs);
+   });
 
    try {
        app.parse(argc, argv);
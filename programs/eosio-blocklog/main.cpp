@@ -1,13 +1,18 @@
 #include <memory>
 #include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/block_header_state.hpp>
 #include <eosio/chain/block_log.hpp>
 #include <eosio/chain/config.hpp>
+#include <eosio/chain/merkle.hpp>
+#include <eosio/chain/protocol_feature_manager.hpp>
 #include <eosio/chain/reversible_block_object.hpp>
+#include <eosio/chain/thread_utils.hpp>
 
 #include <fc/io/json.hpp>
 #include <fc/filesystem.hpp>
 #include <fc/variant.hpp>
 #include <fc/bitutil.hpp>
+#include <fc/scoped_exit.hpp>
 
 #include <boost/exception/diagnostic_information.hpp>
 #include <boost/program_options.hpp>
@@ -15,6 +20,9 @@
 #include <boost/filesystem/path.hpp>
 
 #include <chrono>
+#include <deque>
+#include <iomanip>
+#include <thread>
 
 #ifndef _WIN32
 #define FOPEN(p, m) fopen(p, m)
@@ -47,9 +55,71 @@ struct blocklog {
    bool                             make_index = false;
    bool                             trim_log = false;
    bool                             smoke_test = false;
+   bool                             verify_log = false;
+   uint32_t                         verify_threads = 0;
+   bool                             extract_blocks = false;
+   bool                             split_log = false;
+   bool                             merge_logs = false;
+   uint32_t                         blocks_per_file = 0;
+   std::string                      shard_compression;
+   uint32_t                         blocks_per_chunk = 0;
+   bool                             binary = false;
+   uint32_t                         export_threads = 0;
+   uint32_t                         export_range_size = 0;
+   bfs::path                        output_dir;
+   std::map<account_name, abi_def>  abis;
    bool                             help = false;
 };
 
+/**
+ * Formats the packed blocks of the log for output, as JSON with the actions of the accounts with an ABI decoded, or
+ * as stored.  Holds its own ABI serializers, so that each export worker can have one.
+ */
+struct block_formatter {
+   explicit block_formatter(const blocklog& blog)
+   : no_pretty_print(blog.no_pretty_print)
+   , binary(blog.binary) {
+      for (const auto& abi : blog.abis) {
+         serializers.emplace(abi.first, abi_serializer(abi.second, deadline));
+      }
+   }
+
+   void format(const std::vector<char>& packed, std::ostream& out) {
+      if (binary) {
+         out.write(packed.data(), packed.size());
+         return;
+      }
+      signed_block block;
+      fc::datastream<const char*> ds(packed.data(), packed.size());
+      fc::raw::unpack(ds, block);
+      fc::variant pretty_output;
+      abi_serializer::to_variant(block,
+                                 pretty_output,
+                                 [this]( account_name n ) {
+                                    const auto it = serializers.find(n);
+                                    return it != serializers.end() ? optional<abi_serializer>(it->second) : optional<abi_serializer>();
+                                 },
+                                 deadline);
+      const auto block_id = block.id();
+      const uint32_t ref_block_prefix = block_id._hash[1];
+      const auto enhanced_object = fc::mutable_variant_object
+                 ("block_num",block.block_num())
+                 ("id", block_id)
+                 ("ref_block_prefix", ref_block_prefix)
+                 (pretty_output.get_object());
+      fc::variant v(std::move(enhanced_object));
+      if (no_pretty_print)
+         fc::json::to_stream(out, v, fc::time_point::maximum(), fc::json::stringify_large_ints_and_doubles);
+      else
+         out << fc::json::to_pretty_string(v) << "\n";
+   }
+
+   const fc::microseconds                   deadline = fc::seconds(10);
+   const bool                               no_pretty_print;
+   const bool                               binary;
+   std::map<account_name, abi_serializer>   serializers;
+};
+
 struct report_time {
     report_time(std::string desc)
     : _start(std::chrono::high_resolution_clock::now())
@@ -72,11 +142,11 @@ void blocklog::read_log() {
    EOS_ASSERT( end, block_log_exception, "No blocks found in block log" );
    EOS_ASSERT( end->block_num() > 1, block_log_exception, "Only one block found in block log" );
 
-   //fix message below, first block might not be 1, first_block_num is not set yet
+   // blocks before blocks.log are read from the block log shards next to it
    ilog( "existing block log contains block num ${first} through block num ${n}",
-         ("first",block_logger.first_block_num())("n",end->block_num()) );
-   if (first_block < block_logger.first_block_num()) {
-      first_block = block_logger.first_block_num();
+         ("first",block_logger.first_available_block_num())("n",end->block_num()) );
+   if (first_block < block_logger.first_available_block_num()) {
+      first_block = block_logger.first_available_block_num();
    }
 
    optional<chainbase::database> reversible_blocks;
@@ -100,66 +170,132 @@ void blocklog::read_log() {
       }
    }
 
-   std::ofstream output_blocks;
-   std::ostream* out;
-   if (!output_file.empty()) {
-      output_blocks.open(output_file.generic_string().c_str());
-      if (output_blocks.fail()) {
+   // the packed block from the block log, or from the reversible blocks past its end
+   auto read_block = [&](uint32_t block_num) {
+      auto packed = block_logger.read_serialized_block_by_num(block_num);
+      if (packed.empty() && reversible_blocks) {
+         if (const auto* obj = reversible_blocks->find<reversible_block_object,by_num>(block_num)) {
+            packed.assign(obj->packedblock.data(), obj->packedblock.data() + obj->packedblock.size());
+         }
+      }
+      return packed;
+   };
+   const bool json_array = as_json_array && !binary;
+   auto open_output = [&](std::ofstream& file, const bfs::path& path) {
+      file.open(path.generic_string().c_str(), binary ? std::ios::out | std::ios::binary : std::ios::out);
+      if (file.fail()) {
          std::ostringstream ss;
-         ss << "Unable to open file '" << output_file.string() << "'";
+         ss << "Unable to open file '" << path.string() << "'";
          throw std::runtime_error(ss.str());
       }
-      out = &output_blocks;
-   }
-   else
-      out = &std::cout;
-
-   if (as_json_array)
-      *out << "[";
-   uint32_t block_num = (first_block < 1) ? 1 : first_block;
-   signed_block_ptr next;
-   fc::variant pretty_output;
-   const fc::microseconds deadline = fc::seconds(10);
-   auto print_block = [&](signed_block_ptr& next) {
-      abi_serializer::to_variant(*next,
-                                 pretty_output,
-                                 []( account_name n ) { return optional<abi_serializer>(); },
-                                 deadline);
-      const auto block_id = next->id();
-      const uint32_t ref_block_prefix = block_id._hash[1];
-      const auto enhanced_object = fc::mutable_variant_object
-                 ("block_num",next->block_num())
-                 ("id", block_id)
-                 ("ref_block_prefix", ref_block_prefix)
-                 (pretty_output.get_object());
-      fc::variant v(std::move(enhanced_object));
-      if (no_pretty_print)
-         fc::json::to_stream(*out, v, fc::time_point::maximum(), fc::json::stringify_large_ints_and_doubles);
-      else
-         *out << fc::json::to_pretty_string(v) << "\n";
    };
-   bool contains_obj = false;
-   while((block_num <= last_block) && (next = block_logger.read_block_by_num( block_num ))) {
-      if (as_json_array && contains_obj)
-         *out << ",";
-      print_block(next);
-      ++block_num;
-      contains_obj = true;
+
+   std::ofstream output_blocks;
+   std::ostream* out = &std::cout;
+   if (export_range_size == 0) {
+      if (!output_file.empty()) {
+         open_output(output_blocks, output_file);
+         out = &output_blocks;
+      }
+      if (json_array)
+         *out << "[";
    }
+   uint32_t block_num = (first_block < 1) ? 1 : first_block;
 
-   if (reversible_blocks) {
-      const reversible_block_object* obj = nullptr;
-      while( (block_num <= last_block) && (obj = reversible_blocks->find<reversible_block_object,by_num>(block_num)) ) {
-         if (as_json_array && contains_obj)
+   if (export_threads == 0 && export_range_size == 0) {
+      block_formatter formatter(*this);
+      bool contains_obj = false;
+      std::vector<char> next;
+      while ((block_num <= last_block) && !(next = read_block(block_num)).empty()) {
+         if (json_array && contains_obj)
             *out << ",";
-         auto next = obj->get_block();
-         print_block(next);
+         formatter.format(next, *out);
          ++block_num;
          contains_obj = true;
       }
+   } else {
+      // blocks are read here in ranges, and ranges are formatted by the workers, each with its own formatter, and
+      // then written in order, or each to its own file as soon as formatted
+      const uint32_t range_size = export_range_size ? export_range_size : 1000;
+      const uint32_t num_workers = std::max<uint32_t>(export_threads, 1);
+      std::vector<std::unique_ptr<block_formatter>> formatters;
+      for (uint32_t i = 0; i < num_workers; ++i) {
+         formatters.emplace_back(std::make_unique<block_formatter>(*this));
+      }
+      std::mutex formatters_mtx;
+      std::deque<std::future<std::string>> pending;
+      bool contains_obj = false;
+      // last, so that on an exception its threads are joined before what their tasks refer to goes away
+      named_thread_pool pool("blklog", num_workers);
+      auto write_next = [&]() {
+         const auto text = pending.front().get();
+         pending.pop_front();
+         if (export_range_size || text.empty())
+            return;
+         if (json_array && contains_obj)
+            *out << ",";
+         *out << text;
+         contains_obj = true;
+      };
+      bool more = true;
+      while (more && block_num <= last_block) {
+         const uint32_t range_first = block_num;
+         std::vector<std::vector<char>> range;
+         while (block_num <= last_block && range.size() < range_size) {
+            auto packed = read_block(block_num);
+            if (packed.empty()) {
+               more = false;
+               break;
+            }
+            range.emplace_back(std::move(packed));
+            ++block_num;
+         }
+         if (range.empty())
+            break;
+         const uint32_t range_last = range_first + static_cast<uint32_t>(range.size()) - 1;
+         pending.emplace_back(async_thread_pool(pool.get_executor(), [&, range_first, range_last, range{std::move(range)}]() {
+            std::unique_ptr<block_formatter> formatter;
+            {
+               std::lock_guard<std::mutex> g(formatters_mtx);
+               formatter = std::move(formatters.back());
+               formatters.pop_back();
+            }
+            auto release = fc::make_scoped_exit([&]() {
+               std::lock_guard<std::mutex> g(formatters_mtx);
+               formatters.emplace_back(std::move(formatter));
+            });
+            std::ostringstream text;
+            std::ofstream range_file;
+            std::ostream& range_out = export_range_size ? static_cast<std::ostream&>(range_file) : text;
+            if (export_range_size) {
+               std::ostringstream name;
+               name << "blocks-" << std::setfill('0') << std::setw(10) << range_first << "-" << std::setw(10) << range_last
+                    << (binary ? ".bin" : ".json");
+               open_output(range_file, output_dir / name.str());
+               if (json_array)
+                  range_out << "[";
+            }
+            for (std::size_t i = 0; i < range.size(); ++i) {
+               if (json_array && i > 0)
+                  range_out << ",";
+               formatter->format(range[i], range_out);
+            }
+            if (export_range_size && json_array)
+               range_out << "]";
+            return text.str();
+         }));
+         // bounds the formatted ranges held in memory
+         if (pending.size() >= 2 * num_workers)
+            write_next();
+      }
+      while (!pending.empty())
+         write_next();
+      pool.stop();
+      if (export_range_size)
+         ilog("exported blocks ${f} through ${l} to ${d}", ("f", first_block < 1 ? 1 : first_block)("l", block_num - 1)("d", output_dir.generic_string()));
    }
 
-   if (as_json_array)
+   if (json_array && export_range_size == 0)
       *out << "]";
    rt.report();
 }
@@ -185,6 +321,32 @@ void blocklog::set_program_options(options_description& cli)
           "Trim blocks.log and blocks.index. Must give 'blocks-dir' and 'first and/or 'last'.")
          ("smoke-test", bpo::bool_switch(&smoke_test)->default_value(false),
           "Quick test that blocks.log and blocks.index are well formed and agree with each other.")
+         ("verify-blocklog", bpo::bool_switch(&verify_log)->default_value(false),
+          "Check every block of blocks.log: its index entry, block id links, transaction merkle root and, when the log starts at block 1, its signatures. Must give 'blocks-dir'.")
+         ("verify-threads", bpo::value<uint32_t>(&verify_threads)->default_value(std::max(std::thread::hardware_concurrency(), 1u)),
+          "Number of threads checking blocks for verify-blocklog.")
+         ("extract-blocks", bpo::bool_switch(&extract_blocks)->default_value(false),
+          "Copy blocks 'first' through 'last' into a new self contained blocks.log and blocks.index. Must give 'blocks-dir' and 'output-dir'.")
+         ("split-blocklog", bpo::bool_switch(&split_log)->default_value(false),
+          "Split blocks.log into self contained blocks-<first>-<last>.log and .index files of 'blocks-per-file' blocks. Must give 'blocks-dir' and 'output-dir'.")
+         ("blocks-per-file", bpo::value<uint32_t>(&blocks_per_file)->default_value(1'000'000),
+          "the number of blocks of each file written by split-blocklog, files end at multiples of it")
+         ("shard-compression", bpo::value<std::string>(&shard_compression)->default_value("none"),
+          "none, or the codec (zlib, zstd or lz4) of the compressed blocks-<first>-<last>.clog shards split-blocklog writes instead of block logs. Shards in 'blocks-dir' are read for the blocks before its blocks.log.")
+         ("blocks-per-chunk", bpo::value<uint32_t>(&blocks_per_chunk)->default_value(block_log::default_blocks_per_chunk),
+          "the number of blocks compressed together in a shard, a read decompresses the whole chunk of its block")
+         ("merge-blocklogs", bpo::bool_switch(&merge_logs)->default_value(false),
+          "Merge the consecutive blocks-<first>-<last>.log files in 'blocks-dir' into a single blocks.log and blocks.index in 'output-dir'.")
+         ("output-dir", bpo::value<bfs::path>(),
+          "the directory to write the extracted blocks.log and blocks.index, or the exported ranges of blocks, to (absolute or relative path).")
+         ("export-threads", bpo::value<uint32_t>(&export_threads)->default_value(0),
+          "Number of threads formatting the blocks printed, in ranges of blocks that are output in order. 0 formats them on the thread reading the log.")
+         ("export-range-size", bpo::value<uint32_t>(&export_range_size)->default_value(0),
+          "Write each range of this many blocks to its own file in 'output-dir', named blocks-<first>-<last>.json (or .bin), instead of to 'output-file'.")
+         ("abi-file", bpo::value<std::vector<std::string>>()->composing(),
+          "ABI used to decode the actions of an account in the printed blocks, as <account>=<abi-def file>. May be given more than once.")
+         ("binary", bpo::bool_switch(&binary)->default_value(false),
+          "Output the blocks packed as they are stored in the log, one after the other, instead of as JSON.")
          ("help,h", bpo::bool_switch(&help)->default_value(false), "Print this help message and exit.")
          ;
 }
@@ -204,6 +366,25 @@ void blocklog::initialize(const variables_map& options) {
          else
             output_file = bld;
       }
+
+      if (export_range_size) {
+         EOS_ASSERT( options.count( "output-dir" ), fc::invalid_arg_exception, "export-range-size requires 'output-dir'" );
+         output_dir = options.at( "output-dir" ).as<bfs::path>();
+         if( output_dir.is_relative())
+            output_dir = bfs::current_path() / output_dir;
+         if (!bfs::exists(output_dir))
+            bfs::create_directories(output_dir);
+      }
+
+      if (options.count( "abi-file" )) {
+         for (const auto& entry : options.at( "abi-file" ).as<std::vector<std::string>>()) {
+            const auto delim = entry.find('=');
+            EOS_ASSERT( delim != std::string::npos && delim > 0 && delim + 1 < entry.size(), fc::invalid_arg_exception,
+                        "Invalid abi-file '${e}', expected <account>=<abi-def file>", ("e", entry) );
+            const account_name account( entry.substr(0, delim) );
+            abis[account] = fc::json::from_file( entry.substr(delim + 1) ).as<abi_def>();
+         }
+      }
    } FC_LOG_AND_RETHROW()
 
 }
@@ -269,6 +450,210 @@ void smoke_test(bfs::path block_dir) {
    cout << "\nno problems found\n";                         //if get here there were no exceptions
 }
 
+// the builtin protocol features with their default digests, as nodeos has them unless configured otherwise
+protocol_feature_set default_protocol_features() {
+   protocol_feature_set pfs;
+   std::map<builtin_protocol_feature_t, digest_type> added;
+   std::function<digest_type(builtin_protocol_feature_t)> add_builtin = [&](builtin_protocol_feature_t codename) -> digest_type {
+      const auto it = added.find(codename);
+      if (it != added.end())
+         return it->second;
+      auto f = protocol_feature_set::make_default_builtin_protocol_feature(codename, add_builtin);
+      return added.emplace(codename, pfs.add_feature(f).feature_digest).first->second;
+   };
+   for (const auto& p : builtin_protocol_feature_codenames)
+      add_builtin(p.first);
+   return pfs;
+}
+
+/**
+ * Checks every block of blocks.log: that its index entry and trailing position agree, that it unpacks to exactly its
+ * bytes with the expected block number, its transaction merkle root, and that it links to the block before it.  A log
+ * starting at block 1 also has the header state of every block derived from the genesis state, and the block's
+ * signatures checked against the block signing authority of its producer.  Blocks are read here in ranges; ranges are
+ * unpacked and checked, and then their signatures recovered, on a pool of threads, only the header states and links
+ * are done in order.
+ */
+void verify_blocklog(bfs::path block_dir, uint32_t num_threads) {
+   report_time rt("verifying blocklog");
+   constexpr uint32_t range_size = 1000;
+   const auto start = fc::time_point::now();
+   trim_data td(block_dir);
+   const uint64_t log_end = fc::file_size(td.block_file_name);
+   num_threads = std::max<uint32_t>(num_threads, 1);
+
+   struct checked_block {
+      signed_block_ptr       block;
+      block_id_type          id;
+      vector<signature_type> additional_signatures;
+   };
+   struct signed_digest {
+      uint32_t                block_num;
+      digest_type             digest;
+      signature_type          producer_signature;
+      vector<signature_type>  additional_signatures;
+      block_signing_authority authority;
+   };
+
+   optional<block_header_state> header_state;
+   protocol_feature_set pfs;
+   if (td.first_block == 1) {
+      const auto genesis = block_log::extract_genesis_state(block_dir);
+      EOS_ASSERT( genesis, block_log_exception, "${file} starts at block 1 without a genesis state", ("file", td.block_file_name.string()) );
+      // the same as the controller's genesis state, which is block 1
+      producer_authority_schedule initial_schedule = { 0, { producer_authority{config::system_account_name, block_signing_authority_v0{ 1, {{genesis->initial_key, 1}} } } } };
+      legacy::producer_schedule_type initial_legacy_schedule{ 0, {{config::system_account_name, genesis->initial_key}} };
+      header_state.emplace();
+      header_state->active_schedule                = initial_schedule;
+      header_state->pending_schedule.schedule      = initial_schedule;
+      header_state->pending_schedule.schedule_hash = fc::sha256::hash(initial_legacy_schedule);
+      header_state->header.timestamp               = genesis->initial_timestamp;
+      header_state->header.action_mroot            = genesis->compute_chain_id();
+      header_state->id                             = header_state->header.id();
+      header_state->block_num                      = header_state->header.block_num();
+      header_state->activated_protocol_features    = std::make_shared<protocol_feature_activation_set>();
+      pfs = default_protocol_features();
+   } else {
+      wlog("${file} does not start at block 1, so block signatures are not checked", ("file", td.block_file_name.string()));
+   }
+   // protocol features are checked by nodeos on replay, not here
+   const auto accept_features = [](block_timestamp_type, const flat_set<digest_type>&, const vector<digest_type>&) {};
+
+   std::deque<std::future<std::vector<checked_block>>> pending_blocks;
+   std::deque<std::future<void>> pending_signatures;
+   optional<block_id_type> prev_id;
+   uint64_t blocks_checked = 0;
+   auto last_report = start;
+
+   // in order: links, header states, and then the signatures of the range on the pool
+   auto link_next = [&](boost::asio::io_context& pool) {
+      auto range = pending_blocks.front().get();
+      pending_blocks.pop_front();
+      std::vector<signed_digest> digests;
+      for (auto& cb : range) {
+         const uint32_t block_num = cb.block->block_num();
+         EOS_ASSERT( !prev_id || cb.block->previous == *prev_id, block_log_exception,
+                     "block ${n} does not link to the block before it", ("n", block_num) );
+         prev_id = cb.id;
+         if (!header_state)
+            continue;
+         if (block_num == 1) {
+            EOS_ASSERT( cb.id == header_state->id, block_log_exception, "block 1 is not the genesis block of the genesis state" );
+            continue;
+         }
+         header_state = header_state->next(*cb.block, std::move(cb.additional_signatures), pfs, accept_features, true);
+         EOS_ASSERT( header_state->id == cb.id, block_log_exception, "header state of block ${n} has another id", ("n", block_num) );
+         digests.push_back({block_num, header_state->sig_digest(), header_state->header.producer_signature,
+                            header_state->additional_signatures, header_state->valid_block_signing_authority});
+      }
+      blocks_checked += range.size();
+      if (digests.empty())
+         return;
+      pending_signatures.emplace_back(async_thread_pool(pool, [digests{std::move(digests)}]() {
+         for (const auto& d : digests) {
+            std::set<public_key_type> keys;
+            keys.emplace(d.producer_signature, d.digest, true);
+            for (const auto& s : d.additional_signatures) {
+               EOS_ASSERT( keys.emplace(s, d.digest, true).second, block_log_exception,
+                           "block ${n} is signed by the same key twice", ("n", d.block_num) );
+            }
+            bool is_satisfied = false;
+            size_t relevant_sig_count = 0;
+            std::tie(is_satisfied, relevant_sig_count) = producer_authority::keys_satisfy_and_relevant(keys, d.authority);
+            EOS_ASSERT( is_satisfied && relevant_sig_count == keys.size(), block_log_exception,
+                        "signatures of block ${n} do not satisfy its block signing authority", ("n", d.block_num)("keys", keys) );
+         }
+      }));
+      if (pending_signatures.size() >= 2 * num_threads) {
+         pending_signatures.front().get();
+         pending_signatures.pop_front();
+      }
+   };
+
+   // last, so that on an exception its threads are joined before what their tasks refer to goes away
+   named_thread_pool pool("verify", num_threads);
+   std::vector<uint64_t> positions;
+   for (uint32_t n = td.first_block; n <= td.last_block;) {
+      const uint32_t count = std::min<uint64_t>(uint64_t(td.last_block) - n + 1, range_size);
+      // the positions of blocks n through n + count - 1, followed by where the last of them ends
+      const bool ends_at_log_end = n + count - 1 == td.last_block;
+      positions.resize(count + (ends_at_log_end ? 0 : 1));
+      auto status = fseek(td.ind_in, td.block_index(n), SEEK_SET);
+      EOS_ASSERT( status == 0, block_log_exception, "cannot seek to ${file} entry for block ${b}", ("file", td.index_file_name.string())("b", n) );
+      EOS_ASSERT( fread(positions.data(), sizeof(uint64_t), positions.size(), td.ind_in) == positions.size(), block_log_exception,
+                  "cannot read ${file} entries from block ${b}", ("file", td.index_file_name.string())("b", n) );
+      if (ends_at_log_end)
+         positions.push_back(log_end);
+      for (uint32_t i = 0; i < count; ++i) {
+         EOS_ASSERT( positions[i + 1] > positions[i] + sizeof(uint64_t) && positions[i + 1] <= log_end, block_log_exception,
+                     "invalid position of block ${n} in ${file}", ("n", n + i)("file", td.index_file_name.string()) );
+      }
+      std::vector<char> data(positions[count] - positions[0]);
+      status = fseek(td.blk_in, positions[0], SEEK_SET);
+      EOS_ASSERT( status == 0, block_log_exception, "blocks.log seek failed" );
+      EOS_ASSERT( fread(data.data(), data.size(), 1, td.blk_in) == 1, block_log_exception, "blocks.log read of block ${n} failed", ("n", n) );
+
+      pending_blocks.emplace_back(async_thread_pool(pool.get_executor(), [n, count, positions, data{std::move(data)}]() {
+         std::vector<checked_block> range;
+         range.reserve(count);
+         for (uint32_t i = 0; i < count; ++i) {
+            const uint32_t block_num = n + i;
+            const char* begin = data.data() + (positions[i] - positions[0]);
+            const uint64_t size = positions[i + 1] - positions[i] - sizeof(uint64_t);
+            uint64_t trailing_pos;
+            memcpy(&trailing_pos, begin + size, sizeof(trailing_pos));
+            EOS_ASSERT( trailing_pos == positions[i], block_log_exception,
+                        "block ${n} does not end with the position the index has for it", ("n", block_num) );
+            auto block = std::make_shared<signed_block>();
+            fc::datastream<const char*> ds(begin, size);
+            fc::raw::unpack(ds, *block);
+            EOS_ASSERT( ds.remaining() == 0, block_log_exception, "block ${n} does not fill its space in the log", ("n", block_num) );
+            EOS_ASSERT( block->block_num() == block_num, block_log_exception,
+                        "the index has block ${n} where block ${b} is", ("n", block_num)("b", block->block_num()) );
+            vector<digest_type> trx_digests;
+            trx_digests.reserve(block->transactions.size());
+            for (const auto& r : block->transactions)
+               trx_digests.emplace_back(r.digest());
+            EOS_ASSERT( block->transaction_mroot == merkle(std::move(trx_digests)), block_log_exception,
+                        "transaction merkle root of block ${n} does not match its transactions", ("n", block_num) );
+            checked_block cb{block, block->id(), {}};
+            const auto exts = block->validate_and_extract_extensions();
+            const auto sigs = exts.find(additional_block_signatures_extension::extension_id());
+            if (sigs != exts.end())
+               cb.additional_signatures = sigs->second.get<additional_block_signatures_extension>().signatures;
+            range.emplace_back(std::move(cb));
+         }
+         return range;
+      }));
+      n += count;
+
+      if (pending_blocks.size() >= 2 * num_threads)
+         link_next(pool.get_executor());
+      const auto now = fc::time_point::now();
+      if (now - last_report > fc::seconds(10)) {
+         ilog("verified ${n} blocks, at ${r} blocks/s", ("n", blocks_checked)
+              ("r", blocks_checked * 1'000'000 / std::max<int64_t>((now - start).count(), 1)));
+         last_report = now;
+      }
+   }
+   while (!pending_blocks.empty())
+      link_next(pool.get_executor());
+   while (!pending_signatures.empty()) {
+      pending_signatures.front().get();
+      pending_signatures.pop_front();
+   }
+   pool.stop();
+
+   const auto elapsed = std::max<int64_t>((fc::time_point::now() - start).count(), 1);
+   const uint64_t bytes = log_end - td.first_block_pos;
+   std::cout << "verified blocks " << td.first_block << " through " << td.last_block << ", "
+             << (header_state ? "including" : "without") << " signatures, in " << elapsed / 1'000'000.0 << " s: "
+             << blocks_checked * 1'000'000 / elapsed << " blocks/s, "
+             << bytes * 1'000'000 / elapsed / (1024 * 1024) << " MiB/s\n"
+             << "no problems found\n";
+   rt.report();
+}
+
 int main(int argc, char** argv) {
    std::ios::sync_with_stdio(false); // for potential performance boost for large block log files
    options_description cli ("eosio-blocklog command line options");
@@ -286,6 +671,10 @@ int main(int argc, char** argv) {
          smoke_test(vmap.at("blocks-dir").as<bfs::path>());
          return 0;
       }
+      if (blog.verify_log) {
+         verify_blocklog(vmap.at("blocks-dir").as<bfs::path>(), blog.verify_threads);
+         return 0;
+      }
       if (blog.trim_log) {
          if (blog.first_block == 0 && blog.last_block == std::numeric_limits<uint32_t>::max()) {
             std::cerr << "trim-blocklog does nothing unless specify first and/or last block.";
@@ -301,6 +690,41 @@ int main(int argc, char** argv) {
          }
          return 0;
       }
+      if (blog.extract_blocks) {
+         if (vmap.count("output-dir") == 0) {
+            std::cerr << "extract-blocks requires 'output-dir'.";
+            return -1;
+         }
+         report_time rt("extracting blocks");
+         auto n = block_log::extract_block_range(vmap.at("blocks-dir").as<bfs::path>(), vmap.at("output-dir").as<bfs::path>(),
+                                                 blog.first_block, blog.last_block);
+         ilog("extracted ${n} blocks", ("n", n));
+         rt.report();
+         return 0;
+      }
+      if (blog.split_log || blog.merge_logs) {
+         if (vmap.count("output-dir") == 0) {
+            std::cerr << (blog.split_log ? "split-blocklog" : "merge-blocklogs") << " requires 'output-dir'.";
+            return -1;
+         }
+         const bfs::path blocks_dir = vmap.at("blocks-dir").as<bfs::path>();
+         const bfs::path output_dir = vmap.at("output-dir").as<bfs::path>();
+         if (blog.split_log) {
+            report_time rt("splitting blocklog");
+            optional<block_codec> codec;
+            if (blog.shard_compression != "none")
+               codec = parse_block_codec(blog.shard_compression);
+            auto n = block_log::split_block_log(blocks_dir, output_dir, blog.blocks_per_file, codec, blog.blocks_per_chunk);
+            ilog("wrote ${n} block logs", ("n", n));
+            rt.report();
+         } else {
+            report_time rt("merging blocklogs");
+            auto n = block_log::merge_block_logs(blocks_dir, output_dir);
+            ilog("merged ${n} blocks", ("n", n));
+            rt.report();
+         }
+         return 0;
+      }
       if (blog.make_index) {
          const bfs::path blocks_dir = vmap.at("blocks-dir").as<bfs::path>();
          bfs::path out_file = blocks_dir / "blocks.index";
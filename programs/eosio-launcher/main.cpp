@@ -23,12 +23,20 @@
 #include <fc/io/json.hpp>
 #include <fc/optional.hpp>
 #include <fc/network/ip.hpp>
+#include <fc/network/http/http_client.hpp>
+#include <fc/network/url.hpp>
 #include <fc/reflect/variant.hpp>
 #include <fc/log/logger_config.hpp>
 #include <ifaddrs.h>
 #include <sys/types.h>
 #include <netinet/in.h>
 #include <net/if.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
 #include <eosio/chain/genesis_state.hpp>
 
 #include "config.hpp"
@@ -428,6 +436,9 @@ struct launcher_def {
    fc::optional<uint32_t> max_block_cpu_usage;
    fc::optional<uint32_t> max_transaction_cpu_usage;
    eosio::chain::genesis_state genesis_from_file;
+   bool snapshot_boot = false;
+   bfs::path seed_snapshot;
+   bfs::path seed_blocks_dir;
 
    void assign_name (eosd_def &node, bool is_bios);
 
@@ -464,6 +475,9 @@ struct launcher_def {
    bool do_ssh (const string &cmd, const string &host_name);
    void prep_remote_config_dir (eosd_def &node, host_def *host);
    void launch (eosd_def &node, string &gts);
+   void seed_node (eosd_def &node);
+   void boot_bios_snapshot (string &gts);
+   void run_boot_script ();
    void kill (launch_modes mode, string sig_opt);
    static string get_node_num(uint16_t node_num);
    pair<host_def, eosd_def> find_node(uint16_t node_num);
@@ -506,6 +520,9 @@ launcher_def::set_options (bpo::options_description &cfg) {
     ("script",bpo::value<string>(&start_script)->default_value("bios_boot.sh"),"the generated startup script name")
     ("max-block-cpu-usage",bpo::value<uint32_t>(),"Provide the \"max-block-cpu-usage\" value to use in the genesis.json file")
     ("max-transaction-cpu-usage",bpo::value<uint32_t>(),"Provide the \"max-transaction-cpu-usage\" value to use in the genesis.json file")
+    ("snapshot-boot",bpo::bool_switch(&snapshot_boot)->default_value(false),"Launch only the bios node and invoke the boot script, then create a snapshot on the bios node and launch all other local nodes from it at once, instead of having them sync from genesis. The bios node must be local.")
+    ("seed-snapshot",bpo::value<string>(),"launch all local nodes at once from this snapshot, e.g. one saved by an earlier --snapshot-boot, instead of from genesis")
+    ("seed-blocks-dir",bpo::value<string>(),"give each node launched from a snapshot a copy on write clone of the block log in this directory, on file systems supporting reflinks")
         ;
 }
 
@@ -567,6 +584,24 @@ launcher_def::initialize (const variables_map &vmap) {
      max_transaction_cpu_usage = vmap["max-transaction-cpu-usage"].as<uint32_t>();
   }
 
+  if (vmap.count("seed-snapshot")) {
+     seed_snapshot = bfs::absolute(vmap["seed-snapshot"].as<string>());
+     if (snapshot_boot) {
+        cerr << "--seed-snapshot cannot be combined with --snapshot-boot, which creates the snapshot" << endl;
+        exit (-1);
+     }
+     if (!bfs::exists(seed_snapshot)) {
+        cerr << "seed snapshot " << seed_snapshot << " does not exist" << endl;
+        exit (-1);
+     }
+  }
+  if (vmap.count("seed-blocks-dir")) {
+     seed_blocks_dir = bfs::absolute(vmap["seed-blocks-dir"].as<string>());
+  }
+  if (snapshot_boot) {
+     boot = true;
+  }
+
   genesis = vmap["genesis"].as<string>();
   if (vmap.count("host-map")) {
      host_map_file = vmap["host-map"].as<string>();
@@ -1141,6 +1176,10 @@ launcher_def::write_config_file (tn_node_def &node) {
   if( instance.has_db ) {
     cfg << "plugin = eosio::mongo_db_plugin\n";
   }
+  if (is_bios && snapshot_boot) {
+    // creates the snapshot the other nodes start from
+    cfg << "plugin = eosio::producer_api_plugin\n";
+  }
   cfg << "plugin = eosio::net_plugin\n";
   cfg << "plugin = eosio::chain_api_plugin\n"
       << "plugin = eosio::history_api_plugin\n";
@@ -1534,6 +1573,12 @@ launcher_def::launch (eosd_def &instance, string &gts) {
   node_rt_info info;
   info.remote = !host->is_local();
 
+  // nodes on other hosts do not have the snapshot, they sync from genesis
+  const bool seeded = !seed_snapshot.empty() && host->is_local();
+  if (seeded) {
+    seed_node (instance);
+  }
+
   string install_path;
   if (instance.name != "bios" && !specific_nodeos_installation_paths.empty()) {
      const auto node_num = boost::lexical_cast<uint16_t,string>(instance.get_node_num());
@@ -1572,9 +1617,14 @@ launcher_def::launch (eosd_def &instance, string &gts) {
   }
 
   eosdcmd += " --config-dir " + instance.config_dir_name + " --data-dir " + instance.data_dir_name;
-  eosdcmd += " --genesis-json " + instance.config_dir_name + "/genesis.json";
-  if (gts.length()) {
-    eosdcmd += " --genesis-timestamp " + gts;
+  if (seeded) {
+    // the snapshot holds the genesis state
+    eosdcmd += " --snapshot " + seed_snapshot.string();
+  } else {
+    eosdcmd += " --genesis-json " + instance.config_dir_name + "/genesis.json";
+    if (gts.length()) {
+      eosdcmd += " --genesis-timestamp " + gts;
+    }
   }
 
   if (!host->is_local()) {
@@ -1637,6 +1687,75 @@ launcher_def::kill_instance(eosd_def, string sig_opt) {
 }
 #endif
 
+// copy on write clone of source, fails where the file system does not support reflinks
+static bool
+clone_file (const bfs::path &source, const bfs::path &destination) {
+#ifdef FICLONE
+  int in = ::open (source.c_str(), O_RDONLY);
+  if (in < 0) {
+    return false;
+  }
+  int out = ::open (destination.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  bool cloned = out >= 0 && ::ioctl (out, FICLONE, in) == 0;
+  if (out >= 0) {
+    ::close (out);
+  }
+  ::close (in);
+  if (!cloned) {
+    boost::system::error_code ec;
+    bfs::remove (destination, ec);
+  }
+  return cloned;
+#else
+  return false;
+#endif
+}
+
+void
+launcher_def::seed_node (eosd_def &instance) {
+  if (seed_blocks_dir.empty()) {
+    return;
+  }
+  // nodeos appends to its block log, so the nodes cannot share one hard linked file
+  bfs::path blocks = bfs::path (find_host (instance.host)->eosio_home) / instance.data_dir_name / block_dir;
+  boost::system::error_code ec;
+  bfs::create_directories (blocks, ec);
+  for (const char *file : {"blocks.log", "blocks.index"}) {
+    if (!clone_file (seed_blocks_dir / file, blocks / file)) {
+      cerr << "unable to clone " << seed_blocks_dir / file << " for " << instance.name
+           << ", it starts from the snapshot without the block log" << endl;
+      bfs::remove (blocks / "blocks.log", ec);
+      bfs::remove (blocks / "blocks.index", ec);
+      return;
+    }
+  }
+}
+
+void
+launcher_def::boot_bios_snapshot (string &gts) {
+  eosd_def &bios = *network.nodes["bios"].instance;
+  host_def *host = find_host (bios.host);
+  if (!host->is_local()) {
+    cerr << "--snapshot-boot requires a local bios node" << endl;
+    exit (-1);
+  }
+  cerr << "launching bios" << endl;
+  launch (bios, gts);
+  run_boot_script ();
+
+  const string url = "http://" + host->host_name + ":" + boost::lexical_cast<string>(bios.http_port) + "/v1/producer/create_snapshot";
+  try {
+    fc::http_client client;
+    auto result = client.post_sync (fc::url (url), fc::variant (fc::mutable_variant_object ()),
+                                    fc::time_point::now () + fc::seconds (60));
+    seed_snapshot = bfs::absolute (result["snapshot_name"].as_string ());
+  } catch (fc::exception& fce) {
+    cerr << "unable to create a snapshot on the bios node with " << url << " fc::exception=" << fce.to_detail_string() << endl;
+    exit (-1);
+  }
+  cerr << "launching the other nodes from " << seed_snapshot << endl;
+}
+
 void
 launcher_def::kill (launch_modes mode, string sig_opt) {
   switch (mode) {
@@ -1815,22 +1934,29 @@ launcher_def::roll (const string& host_names) {
    }
 }
 
+void
+launcher_def::run_boot_script() {
+   cerr << "Invoking the blockchain boot script, " << start_script << "\n";
+   string script("bash " + start_script);
+   bp::child c(script);
+   try {
+      boost::system::error_code ec;
+      cerr << "waiting for script completion\n";
+      c.wait();
+   } catch (bfs::filesystem_error &ex) {
+      cerr << "wait threw error " << ex.what() << "\n";
+   }
+   catch (...) {
+      // when script dies wait throws an exception but that is ok
+   }
+}
+
 void
 launcher_def::ignite() {
-   if (boot) {
-      cerr << "Invoking the blockchain boot script, " << start_script << "\n";
-      string script("bash " + start_script);
-      bp::child c(script);
-      try {
-         boost::system::error_code ec;
-         cerr << "waiting for script completion\n";
-         c.wait();
-      } catch (bfs::filesystem_error &ex) {
-         cerr << "wait threw error " << ex.what() << "\n";
-      }
-      catch (...) {
-         // when script dies wait throws an exception but that is ok
-      }
+   if (snapshot_boot) {
+      // booted before the other nodes were launched
+   } else if (boot) {
+      run_boot_script();
    } else {
       cerr << "**********************************************************************\n"
            << "run 'bash " << start_script << "' to kick off delegated block production\n"
@@ -1866,10 +1992,16 @@ launcher_def::start_all (string &gts, launch_modes mode) {
   case LM_REMOTE:
   case LM_LOCAL: {
 
+    if (snapshot_boot) {
+      boot_bios_snapshot (gts);
+    }
     for (auto &h : bindings ) {
       if (mode == LM_ALL ||
           (h.is_local() ? mode == LM_LOCAL : mode == LM_REMOTE)) {
         for (auto &inst : h.instances) {
+          if (snapshot_boot && inst.name == "bios") {
+            continue;
+          }
           try {
              cerr << "launching " << inst.name << endl;
              launch (inst, gts);
@@ -1880,7 +2012,10 @@ launcher_def::start_all (string &gts, launch_modes mode) {
           } catch (...) {
             cerr << "unable to launch " << inst.name << endl;
           }
-          sleep (start_delay);
+          // nodes started from a snapshot do not sync from each other first
+          if (seed_snapshot.empty() || !h.is_local()) {
+            sleep (start_delay);
+          }
         }
       }
     }
@@ -118,4 +118,39 @@ BOOST_FIXTURE_TEST_CASE( get_block_with_invalid_abi, TESTER ) try {
 
 } FC_LOG_AND_RETHROW() /// get_block_with_invalid_abi
 
+BOOST_FIXTURE_TEST_CASE( parse_packed_transaction_test, TESTER ) try {
+   signed_transaction trx;
+   trx.actions.emplace_back( vector<permission_level>{{config::system_account_name, config::active_name}},
+                             config::system_account_name, N(nonce), bytes{'a', 'b'} );
+   set_transaction_headers( trx );
+   trx.sign( get_private_key( config::system_account_name, "active" ), control->get_chain_id() );
+
+   using chain_apis::read_write;
+   for( auto compression : { packed_transaction::compression_type::none, packed_transaction::compression_type::zlib } ) {
+      const packed_transaction expected( trx, compression );
+      const auto json = fc::json::to_string( expected, fc::time_point::maximum() );
+
+      auto parsed = read_write::parse_packed_transaction( json );
+      BOOST_REQUIRE( parsed );
+      BOOST_CHECK_EQUAL( parsed->id(), expected.id() );
+      BOOST_CHECK( parsed->get_signatures() == expected.get_signatures() );
+      BOOST_CHECK( parsed->get_compression() == expected.get_compression() );
+      BOOST_CHECK( parsed->get_packed_context_free_data() == expected.get_packed_context_free_data() );
+      BOOST_CHECK( parsed->get_packed_transaction() == expected.get_packed_transaction() );
+
+      // whitespace is fine, anything the fc::variant path has to handle is left to it
+      BOOST_CHECK( read_write::parse_packed_transaction( " \n" + json + " " ) );
+      auto with_key = json;
+      with_key.insert( 1, R"("extra":1,)" );
+      BOOST_CHECK( !read_write::parse_packed_transaction( with_key ) );
+   }
+
+   BOOST_CHECK( !read_write::parse_packed_transaction( "" ) );
+   BOOST_CHECK( !read_write::parse_packed_transaction( R"({"signatures":[],"compression":"none","transaction":{}})" ) );
+   BOOST_CHECK( !read_write::parse_packed_transaction( R"({"signatures":[],"compression":"none","packed_trx":"0\u0030"})" ) );
+   BOOST_CHECK( !read_write::parse_packed_transaction( R"({"signatures":[],"compression":"none","packed_trx":"abc"})" ) );
+   BOOST_CHECK( !read_write::parse_packed_transaction( R"({"signatures":[],"compression":"bogus","packed_trx":"00"})" ) );
+
+} FC_LOG_AND_RETHROW() /// parse_packed_transaction_test
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -670,4 +670,116 @@ BOOST_FIXTURE_TEST_CASE( get_table_next_key_test, TESTER ) try {
 
 } FC_LOG_AND_RETHROW() /// get_table_next_key_test
 
+BOOST_FIXTURE_TEST_CASE( get_table_cursor_test, TESTER ) try {
+   create_account(N(test));
+
+   set_code( N(test), contracts::get_table_test_wasm() );
+   set_abi( N(test), contracts::get_table_test_abi().data() );
+   produce_block();
+
+   // sec64 repeats, which lower_bound = next_key can not page through
+   for( uint64_t input : { 2, 5, 5, 7 } ) {
+      push_action(N(test), N(addnumobj), N(test), mutable_variant_object()("input", input));
+   }
+   produce_block();
+
+   chain_apis::read_only plugin(*(this->control), fc::microseconds::maximum());
+   chain_apis::read_only::get_table_rows_params params{
+      .json=true,
+      .code=N(test),
+      .scope="test",
+      .table=N(numobjs),
+      .limit=1,
+      .key_type="i64",
+      .index_position="2"
+   };
+
+   auto page_keys = [&]() {
+      vector<uint64_t> keys;
+      params.cursor.reset();
+      while( true ) {
+         auto res = plugin.get_table_rows(params);
+         BOOST_REQUIRE_EQUAL(res.rows.size(), 1u);
+         keys.push_back(res.rows[0].get_object()["key"].as<uint64_t>());
+         BOOST_REQUIRE_EQUAL(res.more, !res.next_cursor.empty());
+         if( !res.more ) break;
+         params.cursor = res.next_cursor;
+      }
+      return keys;
+   };
+
+   BOOST_CHECK( page_keys() == (vector<uint64_t>{ 0, 1, 2, 3 }) );
+   params.reverse = true;
+   BOOST_CHECK( page_keys() == (vector<uint64_t>{ 3, 2, 1, 0 }) );
+   params.reverse.reset();
+
+   // primary index, rows as binary need no ABI
+   params.index_position = "1";
+   params.json = false;
+   BOOST_CHECK( page_keys().size() == 4 );
+
+   // a cursor continues only the query it came from
+   params.cursor.reset();
+   auto cursor = plugin.get_table_rows(params).next_cursor;
+   params.index_position = "2";
+   params.cursor = cursor;
+   BOOST_CHECK_THROW( plugin.get_table_rows(params), chain::contract_table_query_exception );
+   params.cursor = "0011";
+   BOOST_CHECK_THROW( plugin.get_table_rows(params), chain::contract_table_query_exception );
+
+   // JSON written directly is the JSON of the result
+   params.cursor.reset();
+   for( bool json : { true, false } ) {
+      for( bool show_payer : { true, false } ) {
+         params.json = json;
+         params.show_payer = show_payer;
+         BOOST_CHECK_EQUAL( plugin.get_table_rows_json(params),
+                            fc::json::to_string(plugin.get_table_rows(params), fc::time_point::maximum()) );
+      }
+   }
+
+} FC_LOG_AND_RETHROW() /// get_table_cursor_test
+
+BOOST_FIXTURE_TEST_CASE( get_table_packed_test, TESTER ) try {
+   create_account(N(test));
+
+   set_code( N(test), contracts::get_table_test_wasm() );
+   set_abi( N(test), contracts::get_table_test_abi().data() );
+   produce_block();
+
+   for( uint64_t input : { 2, 5, 7 } ) {
+      push_action(N(test), N(addnumobj), N(test), mutable_variant_object()("input", input));
+   }
+   produce_block();
+
+   chain_apis::read_only plugin(*(this->control), fc::microseconds::maximum());
+   chain_apis::read_only::get_table_rows_params params{
+      .json=true,
+      .code=N(test),
+      .scope="test",
+      .table=N(numobjs),
+      .limit=2
+   };
+
+   // rows are packed as stored whatever json asks for, payers only when asked for
+   for( bool show_payer : { true, false } ) {
+      params.show_payer = show_payer;
+      auto packed = fc::raw::unpack<chain_apis::read_only::get_table_rows_packed_result>( plugin.get_table_rows_packed(params) );
+      params.json = false;
+      auto res = plugin.get_table_rows(params);
+      params.json = true;
+
+      BOOST_REQUIRE_EQUAL( packed.rows.size(), res.rows.size() );
+      for( size_t i = 0; i < res.rows.size(); ++i ) {
+         const auto& row = res.rows[i];
+         BOOST_CHECK( packed.rows[i].data == (show_payer ? row["data"] : row).as<bytes>() );
+         BOOST_CHECK_EQUAL( packed.rows[i].payer, show_payer ? N(test) : name() );
+      }
+      BOOST_CHECK_EQUAL( packed.more, res.more );
+      BOOST_CHECK_EQUAL( packed.next_key, res.next_key );
+      BOOST_CHECK_EQUAL( packed.next_cursor, res.next_cursor );
+   }
+
+} FC_LOG_AND_RETHROW() /// get_table_packed_test
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+
+from testUtils import Utils
+from Cluster import Cluster
+from WalletMgr import WalletMgr
+from Node import Node
+from TestHelper import TestHelper
+
+import datetime
+import time
+
+###############################################################
+# nodeos_prebuild_block_test
+#
+#  Runs producers with --prebuild-block and verifies that no slot of the schedule is left out. A producer that
+#  prebuilds its next block has to wake up when that block's production window opens, not one slot later.
+#
+# --dump-error-details <Upon error print etc/eosio/node_*/config.ini and var/lib/node_*/stderr.log to stdout>
+# --keep-logs <Don't delete var/lib/node_* folders upon test completion>
+###############################################################
+
+Print=Utils.Print
+errorExit=Utils.errorExit
+
+def blockTime(node, blockNum):
+    block=node.getBlock(blockNum, exitOnError=True)
+    return datetime.datetime.strptime(block["timestamp"], "%Y-%m-%dT%H:%M:%S.%f")
+
+args = TestHelper.parse_args({"--dump-error-details","--keep-logs","-v","--leave-running","--clean-run","--wallet-port"})
+Utils.Debug=args.v
+totalNodes=2
+cluster=Cluster(walletd=True)
+dumpErrorDetails=args.dump_error_details
+keepLogs=args.keep_logs
+dontKill=args.leave_running
+killAll=args.clean_run
+walletPort=args.wallet_port
+
+walletMgr=WalletMgr(True, port=walletPort)
+testSuccessful=False
+killEosInstances=not dontKill
+killWallet=not dontKill
+
+blocksToCheck=48 # two rounds of both producers
+maxMissedSlots=2 # a handoff may lose a slot on a loaded test host, every second block is lost without the fix
+
+try:
+    TestHelper.printSystemInfo("BEGIN")
+    cluster.setWalletMgr(walletMgr)
+
+    cluster.killall(allInstances=killAll)
+    cluster.cleanup()
+    Print("Stand up cluster")
+    if cluster.launch(prodCount=1, onlyBios=False, pnodes=totalNodes, totalNodes=totalNodes, totalProducers=totalNodes,
+                      useBiosBootFile=False, onlySetProds=True,
+                      extraNodeosArgs=" --prebuild-block --http-max-response-time-ms 990000 ") is False:
+        Utils.cmdError("launcher")
+        errorExit("Failed to stand up eos cluster.")
+
+    node=cluster.getNode(0)
+
+    Print("Wait for the producers to take over from eosio")
+    tries=30
+    while tries > 0:
+        node.infoValid = False
+        info = node.getInfo()
+        if node.infoValid and node.lastRetrievedHeadBlockProducer != "eosio":
+            break
+        time.sleep(1)
+        tries = tries-1
+    if tries == 0:
+        errorExit("failed to wait for the producer schedule")
+
+    startBlockNum=node.getHeadBlockNum() + 1
+    endBlockNum=startBlockNum + blocksToCheck
+    Print("Wait for blocks %d to %d" % (startBlockNum, endBlockNum))
+    if not node.waitForBlock(endBlockNum, timeout=blocksToCheck):
+        errorExit("head did not reach block %d" % (endBlockNum))
+
+    missedSlots=0
+    lastTime=blockTime(node, startBlockNum)
+    for blockNum in range(startBlockNum + 1, endBlockNum + 1):
+        thisTime=blockTime(node, blockNum)
+        slots=int((thisTime - lastTime).total_seconds() * 2)
+        if slots > 1:
+            Print("block %d is %d slots after block %d" % (blockNum, slots, blockNum - 1))
+            missedSlots+=slots - 1
+        lastTime=thisTime
+
+    Print("missed %d slots in %d blocks" % (missedSlots, blocksToCheck))
+    if missedSlots > maxMissedSlots:
+        errorExit("producers with --prebuild-block missed %d slots, at most %d expected" % (missedSlots, maxMissedSlots))
+
+    testSuccessful=True
+finally:
+    TestHelper.shutdown(cluster, walletMgr, testSuccessful=testSuccessful, killEosInstances=killEosInstances, killWallet=killWallet, keepLogs=keepLogs, cleanRun=killAll, dumpErrorDetails=dumpErrorDetails)
+
+exit(0)
@@ -262,6 +262,65 @@ BOOST_AUTO_TEST_CASE(wallet_manager_create_test) {
    } FC_LOG_AND_RETHROW()
 }
 
+/// Test signing on the signing threads, and that the key index follows locking and key changes
+BOOST_AUTO_TEST_CASE(wallet_manager_signing_threads_test)
+{ try {
+   using namespace eosio::wallet;
+
+   if (fc::exists("test.wallet")) fc::remove("test.wallet");
+
+   constexpr auto key1 = "5JktVNHnRX48BUdtewU7N1CyL4Z886c42x7wYW7XhNWkDQRhdcS";
+   constexpr auto key2 = "5Ju5RTcVDo35ndtzHioPMgebvBM6LkJ6tvuU6LTNQv8yaz3ggZr";
+   constexpr auto key3 = "5KQwrPbwdL6PhXujxW37FSSQZ1JiwsST4cqQzDeyXtP79zkvFD3";
+
+   wallet_manager wm;
+   wm.set_signing_threads(2);
+   auto pw = wm.create("test");
+   flat_set<public_key_type> pubkeys;
+   for (const auto* key : {key1, key2, key3}) {
+      wm.import_key("test", key);
+      pubkeys.emplace(private_key_type(std::string(key)).get_public_key());
+   }
+
+   auto chain_id = genesis_state().compute_chain_id();
+   auto check_signed = [&]() {
+      auto trx = wm.sign_transaction(chain::signed_transaction(), pubkeys, chain_id);
+      flat_set<public_key_type> pks;
+      trx.get_signature_keys(chain_id, fc::time_point::maximum(), pks);
+      BOOST_CHECK(pks == pubkeys);
+   };
+   check_signed();
+
+   wm.lock("test");
+   BOOST_CHECK_THROW(wm.sign_transaction(chain::signed_transaction(), pubkeys, chain_id), wallet_missing_pub_key_exception);
+   wm.unlock("test", pw);
+   check_signed();
+
+   const auto removed = private_key_type(std::string(key3)).get_public_key();
+   wm.remove_key("test", pw, removed.to_string());
+   BOOST_CHECK_THROW(wm.sign_transaction(chain::signed_transaction(), pubkeys, chain_id), wallet_missing_pub_key_exception);
+   BOOST_CHECK_THROW(wm.sign_digest(chain::digest_type(), removed), wallet_missing_pub_key_exception);
+   pubkeys.erase(removed);
+   check_signed();
+
+   std::vector<std::pair<chain::digest_type, public_key_type>> digests;
+   for (const auto& pk : pubkeys) {
+      digests.emplace_back(fc::sha256::hash(pk.to_string()), pk);
+   }
+   const auto sigs = wm.sign_digests(digests);
+   BOOST_REQUIRE_EQUAL(digests.size(), sigs.size());
+   for (size_t i = 0; i < sigs.size(); ++i) {
+      BOOST_CHECK(public_key_type(sigs[i], digests[i].first) == digests[i].second);
+   }
+   digests.emplace_back(chain::digest_type(), removed);
+   BOOST_CHECK_THROW(wm.sign_digests(digests), wallet_missing_pub_key_exception);
+
+   wm.set_signing_threads(0);
+   check_signed();
+
+   fc::remove("test.wallet");
+} FC_LOG_AND_RETHROW() }
+
 
 BOOST_AUTO_TEST_SUITE_END()
 
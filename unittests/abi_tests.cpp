@@ -13,6 +13,7 @@
 
 #include <eosio/chain/contract_types.hpp>
 #include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/abi_serializer_cache.hpp>
 #include <eosio/chain/eosio_contract.hpp>
 #include <eosio/testing/tester.hpp>
 
@@ -2787,4 +2788,240 @@ BOOST_AUTO_TEST_CASE(serialize_optional_struct_type)
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE(abi_decode_plans)
+{
+   auto abi = R"({
+      "version": "eosio::abi/1.1",
+      "types": [ {"new_type_name": "alias", "type": "s1"} ],
+      "structs": [
+         {"name": "base1", "base": "", "fields": [ {"name": "a", "type": "uint8"} ]},
+         {"name": "s1", "base": "base1", "fields": [
+            {"name": "b", "type": "string"},
+            {"name": "c", "type": "int16[]"},
+            {"name": "d", "type": "v1?"},
+            {"name": "e", "type": "uint32$"}
+         ]}
+      ],
+      "variants": [ {"name": "v1", "types": ["uint8", "alias"]} ]
+   })";
+
+   try {
+      abi_serializer abis( fc::json::from_string(abi).as<abi_def>(), max_serialization_time );
+
+      verify_round_trip_conversion(abis, "s1", R"({"a":1,"b":"hi","c":[2,3],"d":null})", "010268690202000300");
+      verify_round_trip_conversion(abis, "alias",
+                                   R"({"a":1,"b":"hi","c":[2,3],"d":["alias",{"a":4,"b":"","c":[],"d":null,"e":7}],"e":5})",
+                                   "0102686902020003000101040000000700000005000000");
+
+      // copies share the plans
+      abi_serializer copy = abis;
+      verify_round_trip_conversion(copy, "v1", R"(["uint8",9])", "0009");
+
+      // JSON written directly matches the JSON of the variant
+      for( const auto& hex : { "010268690202000300", "0102686902020003000101040000000700000005000000" } ) {
+         auto bin = fc::variant(hex).as<bytes>();
+         string json = "prefix";
+         abis.binary_to_json("alias", bin, json, max_serialization_time);
+         BOOST_CHECK_EQUAL( json, "prefix" + fc::json::to_string(abis.binary_to_variant("alias", bin, max_serialization_time), fc::time_point::maximum()) );
+      }
+
+      // failures are redone step by step for the detailed error
+      string json;
+      BOOST_CHECK_EXCEPTION( abis.binary_to_json("s1", fc::variant("0102").as<bytes>(), json, max_serialization_time),
+                             unpack_exception, fc_exception_message_is("Unable to unpack built-in type 'string' while processing 's1.b'") );
+      BOOST_CHECK( json.empty() );
+      BOOST_CHECK_EXCEPTION( abis.binary_to_variant("s1", fc::variant("0102").as<bytes>(), max_serialization_time),
+                             unpack_exception, fc_exception_message_is("Unable to unpack built-in type 'string' while processing 's1.b'") );
+      BOOST_CHECK_EXCEPTION( abis.binary_to_variant("s1", fc::variant("01026869020200030001020400").as<bytes>(), max_serialization_time),
+                             unpack_exception, fc_exception_message_is("Unpacked invalid tag (2) for variant 's1.d'") );
+
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE(abi_binary_to_json_repeated_field)
+{
+   // the variant keeps the value of the last field of a repeated name
+   auto abi = R"({
+      "version": "eosio::abi/1.0",
+      "structs": [
+         {"name": "b", "base": "", "fields": [ {"name": "f", "type": "uint8"} ]},
+         {"name": "s", "base": "b", "fields": [ {"name": "f", "type": "uint16"} ]}
+      ]
+   })";
+
+   try {
+      abi_serializer abis( fc::json::from_string(abi).as<abi_def>(), max_serialization_time );
+      string json;
+      abis.binary_to_json("s", fc::variant("010200").as<bytes>(), json, max_serialization_time);
+      BOOST_CHECK_EQUAL( json, R"({"f":2})" );
+   } FC_LOG_AND_RETHROW()
+}
+
+// rebuilds JSON from the pieces a value_writer receives
+struct json_value_writer : abi_serializer::value_writer {
+   string       out;
+   vector<bool> first{true};
+
+   void next() {
+      if( !first.back() ) out += ',';
+      first.back() = false;
+   }
+   void start_object() override { next(); out += '{'; first.push_back(true); }
+   void key( const string& name ) override {
+      next();
+      out += fc::json::to_string( fc::variant(name), fc::time_point::maximum() ) + ':';
+      first.back() = true;
+   }
+   void end_object() override { first.pop_back(); out += '}'; }
+   void start_array() override { next(); out += '['; first.push_back(true); }
+   void end_array() override { first.pop_back(); out += ']'; }
+   void value( const fc::variant& v ) override { next(); out += fc::json::to_string( v, fc::time_point::maximum() ); }
+};
+
+BOOST_AUTO_TEST_CASE(abi_binary_to_writer)
+{
+   auto abi = R"({
+      "version": "eosio::abi/1.1",
+      "structs": [
+         {"name": "base1", "base": "", "fields": [ {"name": "a", "type": "uint8"} ]},
+         {"name": "s1", "base": "base1", "fields": [
+            {"name": "b", "type": "string"},
+            {"name": "c", "type": "int16[]"},
+            {"name": "d", "type": "v1?"},
+            {"name": "e", "type": "uint32$"}
+         ]},
+         {"name": "s2", "base": "base1", "fields": [ {"name": "a", "type": "uint16"} ]}
+      ],
+      "variants": [ {"name": "v1", "types": ["uint8", "s1"]} ]
+   })";
+
+   try {
+      abi_serializer abis( fc::json::from_string(abi).as<abi_def>(), max_serialization_time );
+
+      for( const auto& hex : { "010268690202000300", "0102686902020003000101040000000700000005000000" } ) {
+         auto bin = fc::variant(hex).as<bytes>();
+         json_value_writer w;
+         BOOST_CHECK( abis.binary_to_writer("s1", bin, w, max_serialization_time) );
+         BOOST_CHECK_EQUAL( w.out, fc::json::to_string(abis.binary_to_variant("s1", bin, max_serialization_time), fc::time_point::maximum()) );
+      }
+
+      // failures and repeated field names are left to binary_to_variant
+      json_value_writer w;
+      BOOST_CHECK( !abis.binary_to_writer("s1", fc::variant("0102").as<bytes>(), w, max_serialization_time) );
+      BOOST_CHECK( !abis.binary_to_writer("s2", fc::variant("010200").as<bytes>(), w, max_serialization_time) );
+      BOOST_CHECK( !abis.binary_to_writer("unknown", fc::variant("01").as<bytes>(), w, max_serialization_time) );
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE(abi_encode_plans)
+{
+   auto abi = R"({
+      "version": "eosio::abi/1.1",
+      "types": [ {"new_type_name": "alias", "type": "s1"} ],
+      "structs": [
+         {"name": "base1", "base": "", "fields": [ {"name": "a", "type": "uint8"} ]},
+         {"name": "s1", "base": "base1", "fields": [
+            {"name": "b", "type": "string"},
+            {"name": "c", "type": "int16[]"},
+            {"name": "d", "type": "v1?"},
+            {"name": "e", "type": "uint32$"}
+         ]},
+         {"name": "s2", "base": "", "fields": [
+            {"name": "x", "type": "uint8"},
+            {"name": "y", "type": "string"},
+            {"name": "z", "type": "uint16$"}
+         ]}
+      ],
+      "variants": [ {"name": "v1", "types": ["uint8", "alias"]} ]
+   })";
+
+   try {
+      abi_serializer abis( fc::json::from_string(abi).as<abi_def>(), max_serialization_time );
+
+      auto to_hex = [&]( const char* type, const char* json ) {
+         return fc::to_hex( abis.variant_to_binary(type, fc::json::from_string(json), max_serialization_time) );
+      };
+      BOOST_CHECK_EQUAL( to_hex("s2", R"([1,"hi"])"), "01026869" );
+      BOOST_CHECK_EQUAL( to_hex("s2", R"([1,"hi",3])"), "010268690300" );
+      BOOST_CHECK_EQUAL( to_hex("s2", R"({"x":1,"y":"hi"})"), "01026869" );
+      BOOST_CHECK_EQUAL( to_hex("alias", R"({"a":1,"b":"hi","c":[2,3],"d":["uint8",9],"e":5})"), "01026869020200030001000905000000" );
+
+      // stream overload
+      bytes buf( 64 );
+      fc::datastream<char*> ds( buf.data(), buf.size() );
+      abis.variant_to_binary( "v1", fc::json::from_string(R"(["uint8",9])"), ds, max_serialization_time );
+      BOOST_CHECK_EQUAL( fc::to_hex( buf.data(), ds.tellp() ), "0009" );
+
+      // failures are redone step by step for the detailed error
+      BOOST_CHECK_EXCEPTION( to_hex("s1", R"({"a":1,"c":[],"d":null})"),
+                             pack_exception, fc_exception_message_starts_with("Missing field 'b' in input object") );
+      BOOST_CHECK_EXCEPTION( to_hex("s1", R"({"a":1,"b":"","c":[],"d":["int9",1]})"),
+                             pack_exception, fc_exception_message_starts_with("Specified type 'int9' in input array is not valid within the variant") );
+      // a binary extension can only be left out at the end of the value
+      BOOST_CHECK_EXCEPTION( to_hex("s1", R"({"a":1,"b":"","c":[],"d":["alias",{"a":4,"b":"","c":[],"d":null}],"e":5})"),
+                             pack_exception, fc_exception_message_starts_with("Missing field 'e' in input object") );
+      BOOST_CHECK_EXCEPTION( to_hex("s2", R"([1])"),
+                             pack_exception, fc_exception_message_starts_with("Early end to input array") );
+
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE(abi_serializer_cache_test)
+{ try {
+   auto abi1 = R"({
+      "version": "eosio::abi/1.0",
+      "structs": [ {"name": "act1", "base": "", "fields": [ {"name": "i0", "type": "int8"} ]} ],
+      "actions": [ {"name": "act1", "type": "act1", "ricardian_contract": ""} ]
+   })";
+   auto abi2 = R"({
+      "version": "eosio::abi/1.0",
+      "structs": [ {"name": "act2", "base": "", "fields": [ {"name": "i0", "type": "int16"} ]} ],
+      "actions": [ {"name": "act2", "type": "act2", "ricardian_contract": ""} ]
+   })";
+
+   testing::tester chain;
+   chain.create_accounts( {N(abicache)} );
+   const auto& db = chain.control->db();
+
+   abi_serializer_cache::clear();
+   BOOST_CHECK( !abi_serializer_cache::get( db, N(abicache), max_serialization_time ) );
+   BOOST_CHECK( !abi_serializer_cache::get( db, N(nosuchacct), max_serialization_time ) );
+
+   chain.set_abi( N(abicache), abi1 );
+   auto first = abi_serializer_cache::get( db, N(abicache), max_serialization_time );
+   BOOST_REQUIRE( first );
+   BOOST_CHECK_EQUAL( first->serializer.get_action_type( N(act1) ), "act1" );
+   BOOST_CHECK( first == abi_serializer_cache::get( db, N(abicache), max_serialization_time ) );
+   auto serializer = abi_serializer_cache::get_serializer( db, N(abicache), max_serialization_time );
+   BOOST_CHECK( serializer.get() == &first->serializer );
+
+   auto stats = abi_serializer_cache::get_stats();
+   BOOST_CHECK_EQUAL( stats.misses, 1u );
+   BOOST_CHECK_EQUAL( stats.hits, 2u );
+   BOOST_CHECK_EQUAL( stats.size, 1u );
+
+   // a new abi_sequence is loaded again, the entry of the previous one stays until evicted
+   chain.set_abi( N(abicache), abi2 );
+   auto second = abi_serializer_cache::get( db, N(abicache), max_serialization_time );
+   BOOST_REQUIRE( second );
+   BOOST_CHECK( second != first );
+   BOOST_CHECK( second->serializer.get_action_type( N(act1) ).empty() );
+   BOOST_CHECK_EQUAL( second->serializer.get_action_type( N(act2) ), "act2" );
+
+   stats = abi_serializer_cache::get_stats();
+   BOOST_CHECK_EQUAL( stats.misses, 2u );
+   BOOST_CHECK_EQUAL( stats.size, 2u );
+
+   abi_serializer_cache::set_capacity( 1 );
+   stats = abi_serializer_cache::get_stats();
+   BOOST_CHECK_EQUAL( stats.evictions, 1u );
+   BOOST_CHECK_EQUAL( stats.size, 1u );
+   BOOST_CHECK( second == abi_serializer_cache::get( db, N(abicache), max_serialization_time ) );
+   // entries handed out stay usable after eviction
+   BOOST_CHECK_EQUAL( first->serializer.get_action_type( N(act1) ), "act1" );
+
+   abi_serializer_cache::set_capacity( abi_serializer_cache::default_capacity );
+   abi_serializer_cache::clear();
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
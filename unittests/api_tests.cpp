@@ -1686,6 +1686,136 @@ BOOST_FIXTURE_TEST_CASE(db_tests, TESTER) { try {
    BOOST_REQUIRE_EQUAL( validate(), true );
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE(db_tests_with_table_lookup_cache) { try {
+   fc::temp_directory tempdir;
+   auto conf_genesis = tester::default_config( tempdir );
+   conf_genesis.first.table_lookup_cache = true;
+   tester chain( conf_genesis.first, conf_genesis.second );
+
+   chain.create_account( N(testapi) );
+   chain.set_code( N(testapi), contracts::test_api_db_wasm() );
+   chain.set_abi(  N(testapi), contracts::test_api_db_abi().data() );
+   chain.produce_block();
+
+   // the contract asserts on every lookup result, so these only pass if cached lookups agree with the database
+   chain.push_action( N(testapi), N(pg),  N(testapi), mutable_variant_object() ); // primary_i64_general
+   chain.push_action( N(testapi), N(pl),  N(testapi), mutable_variant_object() ); // primary_i64_lowerbound
+   chain.push_action( N(testapi), N(pu),  N(testapi), mutable_variant_object() ); // primary_i64_upperbound
+   chain.push_action( N(testapi), N(s1g), N(testapi), mutable_variant_object() ); // idx64_general
+   chain.push_action( N(testapi), N(s1l), N(testapi), mutable_variant_object() ); // idx64_lowerbound
+   chain.push_action( N(testapi), N(s1u), N(testapi), mutable_variant_object() ); // idx64_upperbound
+   chain.produce_block();
+
+   const auto& stats = chain.control->get_table_lookup_stats();
+   auto itr = stats.find( N(testapi) );
+   BOOST_REQUIRE( itr != stats.end() );
+   BOOST_CHECK_GT( itr->second.hits + itr->second.misses, 0u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(db_tests_with_state_prefetch) { try {
+   fc::temp_directory tempdir;
+   auto conf_genesis = tester::default_config( tempdir );
+   conf_genesis.first.db_map_mode = pinnable_mapped_file::map_mode::mapped;
+   conf_genesis.first.state_prefetch_pages = 4;
+   tester chain( conf_genesis.first, conf_genesis.second );
+   auto* prefetcher = chain.control->get_state_prefetcher();
+   BOOST_REQUIRE( prefetcher );
+
+   chain.create_account( N(testapi) );
+   chain.set_code( N(testapi), contracts::test_api_db_wasm() );
+   chain.set_abi(  N(testapi), contracts::test_api_db_abi().data() );
+   chain.produce_block();
+   BOOST_CHECK_EQUAL( prefetcher->pages( N(testapi) ), 0u );
+
+   chain.push_action( N(testapi), N(pg),  N(testapi), mutable_variant_object() ); // primary_i64_general
+   chain.push_action( N(testapi), N(s1g), N(testapi), mutable_variant_object() ); // idx64_general
+   chain.produce_block();
+   // the rows the actions were handed are remembered, at most as many pages as configured
+   BOOST_CHECK_GT( prefetcher->pages( N(testapi) ), 0u );
+   BOOST_CHECK_LE( prefetcher->pages( N(testapi) ), 4u );
+
+   // prefetching only advises the kernel, the next actions see the same rows
+   chain.push_action( N(testapi), N(pl), N(testapi), mutable_variant_object() ); // primary_i64_lowerbound
+   chain.produce_block();
+
+   // in heap mode the pages are memory already
+   fc::temp_directory heap_dir;
+   auto heap_conf_genesis = tester::default_config( heap_dir );
+   heap_conf_genesis.first.db_map_mode = pinnable_mapped_file::map_mode::heap;
+   heap_conf_genesis.first.state_prefetch_pages = 4;
+   tester heap( heap_conf_genesis.first, heap_conf_genesis.second );
+   BOOST_CHECK( !heap.control->get_state_prefetcher() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(contract_profiler_counts) { try {
+   tester chain;
+   chain.create_account( N(testapi) );
+   chain.set_code( N(testapi), contracts::test_api_db_wasm() );
+   chain.set_abi(  N(testapi), contracts::test_api_db_abi().data() );
+   chain.produce_block();
+   chain.push_action( N(testapi), N(pg), N(testapi), mutable_variant_object() ); // primary_i64_general
+   chain.produce_block();
+
+   auto find = []( const vector<contract_profiler::entry>& entries, account_name receiver, action_name act ) {
+      auto itr = std::find_if( entries.begin(), entries.end(), [&]( const auto& e ) {
+         return e.receiver == receiver && e.action == act;
+      } );
+      BOOST_REQUIRE( itr != entries.end() );
+      return *itr;
+   };
+   const auto entries = chain.control->get_contract_profiler().entries();
+   BOOST_REQUIRE( std::is_sorted( entries.begin(), entries.end(), []( const auto& a, const auto& b ) {
+      return a.billed_cpu_us > b.billed_cpu_us;
+   } ) );
+
+   const auto pg = find( entries, N(testapi), N(pg) );
+   BOOST_CHECK_EQUAL( pg.account, N(testapi) );
+   BOOST_CHECK_EQUAL( pg.calls, 1u );
+   BOOST_CHECK_EQUAL( pg.failures, 0u );
+   BOOST_CHECK_GT( pg.db_ops, 0u );
+   BOOST_CHECK_GE( pg.intrinsic_calls, pg.db_ops );
+   BOOST_CHECK_GE( pg.wall_us, pg.billed_cpu_us );
+
+   // native handlers are counted too
+   BOOST_CHECK_GE( find( entries, config::system_account_name, N(newaccount) ).calls, 1u );
+
+   BOOST_CHECK_EQUAL( chain.control->get_contract_profiler().entries( 1 ).size(), 1u );
+
+   fc::temp_directory tempdir;
+   auto conf_genesis = tester::default_config( tempdir );
+   conf_genesis.first.profile_contracts = false;
+   tester unprofiled( conf_genesis.first, conf_genesis.second );
+   unprofiled.create_account( N(testapi) );
+   unprofiled.produce_block();
+   BOOST_CHECK( unprofiled.control->get_contract_profiler().entries().empty() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(action_trace_levels) { try {
+   auto newaccount_trace = []( trace_level level ) {
+      fc::temp_directory tempdir;
+      auto conf_genesis = tester::default_config( tempdir );
+      conf_genesis.first.action_trace_level = level;
+      tester chain( conf_genesis.first, conf_genesis.second );
+      auto trace = chain.create_account( N(alice) );
+      BOOST_REQUIRE( trace && trace->receipt );
+      BOOST_REQUIRE_EQUAL( trace->action_traces.size(), 1u );
+      BOOST_CHECK_EQUAL( trace->action_traces[0].act.name, N(newaccount) );
+      return trace->action_traces[0];
+   };
+
+   const auto full = newaccount_trace( trace_level::FULL );
+   BOOST_CHECK( full.receipt );
+   BOOST_CHECK( !full.account_ram_deltas.empty() );
+
+   const auto minimal = newaccount_trace( trace_level::MINIMAL );
+   BOOST_CHECK( minimal.receipt );
+   BOOST_CHECK( minimal.account_ram_deltas.empty() );
+
+   const auto none = newaccount_trace( trace_level::NONE );
+   BOOST_CHECK( !none.receipt );
+   BOOST_CHECK( none.account_ram_deltas.empty() );
+} FC_LOG_AND_RETHROW() }
+
 /*************************************************************************************
  * multi_index_tests test case
  *************************************************************************************/
@@ -522,4 +522,69 @@ BOOST_AUTO_TEST_CASE( linkauth_special ) { try {
 } FC_LOG_AND_RETHROW() }
 
 
+BOOST_AUTO_TEST_CASE( authority_cache_required_keys ) { try {
+   TESTER chain;
+   chain.create_account(name("alice"));
+   chain.produce_blocks();
+
+   const auto& auth_manager = chain.control->get_authorization_manager();
+   const auto active_pub_key = chain.get_public_key(name("alice"), "active");
+   const auto new_active_pub_key = chain.get_public_key(name("alice"), "new_active");
+
+   signed_transaction trx;
+   trx.actions.emplace_back( vector<permission_level>{{name("alice"), config::active_name}}, name("eosio"), name("nonce"), bytes() );
+
+   const flat_set<public_key_type> candidate_keys{ active_pub_key, new_active_pub_key };
+   BOOST_TEST( auth_manager.get_required_keys( trx, candidate_keys ) == flat_set<public_key_type>{ active_pub_key } );
+   const auto hits = auth_manager.get_authority_cache_stats().hits;
+   BOOST_TEST( auth_manager.get_required_keys( trx, candidate_keys ) == flat_set<public_key_type>{ active_pub_key } );
+   BOOST_TEST( auth_manager.get_authority_cache_stats().hits > hits );
+
+   // an updated permission is expanded again, both before and after the block updating it
+   chain.set_authority(name("alice"), name("active"), authority(new_active_pub_key), name("owner"),
+                       { permission_level{name("alice"), name("active")} }, { chain.get_private_key(name("alice"), "active") });
+   BOOST_TEST( auth_manager.get_required_keys( trx, candidate_keys ) == flat_set<public_key_type>{ new_active_pub_key } );
+   chain.produce_blocks();
+   BOOST_TEST( auth_manager.get_required_keys( trx, candidate_keys ) == flat_set<public_key_type>{ new_active_pub_key } );
+
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( key_account_index_lookups ) { try {
+   fc::temp_directory tempdir;
+   auto conf_genesis = tester::default_config( tempdir );
+   conf_genesis.first.key_account_index = true;
+   tester chain( conf_genesis.first, conf_genesis.second );
+   chain.create_accounts( {name("alice"), name("bob")} );
+   chain.produce_blocks();
+
+   const auto& auth_manager = chain.control->get_authorization_manager();
+   BOOST_REQUIRE( auth_manager.key_account_index_enabled() );
+   const auto alice_active = chain.get_public_key(name("alice"), "active");
+   const auto bob_owner = chain.get_public_key(name("bob"), "owner");
+   const auto new_active = chain.get_public_key(name("alice"), "new_active");
+
+   auto matches = auth_manager.find_key_accounts( { alice_active } );
+   BOOST_REQUIRE_EQUAL( matches.size(), 1u );
+   BOOST_TEST( matches[0].permission == (permission_level{name("alice"), config::active_name}) );
+   BOOST_TEST( matches[0].weight == 1 );
+   BOOST_TEST( matches[0].threshold == 1u );
+
+   // a batch returns the permissions of every key
+   matches = auth_manager.find_key_accounts( { alice_active, bob_owner, new_active } );
+   BOOST_REQUIRE_EQUAL( matches.size(), 2u );
+
+   // a replaced key is not found, before and after the block updating it becomes irreversible
+   chain.set_authority(name("alice"), name("active"), authority(new_active), name("owner"),
+                       { permission_level{name("alice"), name("active")} }, { chain.get_private_key(name("alice"), "active") });
+   BOOST_TEST( auth_manager.find_key_accounts( { alice_active } ).empty() );
+   BOOST_REQUIRE_EQUAL( auth_manager.find_key_accounts( { new_active } ).size(), 1u );
+   chain.produce_blocks( 3 );
+   BOOST_TEST( auth_manager.find_key_accounts( { alice_active } ).empty() );
+   BOOST_TEST( auth_manager.find_key_accounts( { new_active } )[0].permission == (permission_level{name("alice"), config::active_name}) );
+
+   TESTER plain;
+   BOOST_TEST( !plain.control->get_authorization_manager().key_account_index_enabled() );
+
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,282 @@
+#include <eosio/testing/tester.hpp>
+#include <eosio/chain/abi_serializer.hpp>
+
+#include <fc/variant_object.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+#include <contracts.hpp>
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+using mvo = fc::mutable_variant_object;
+namespace bpo = boost::program_options;
+
+/**
+ * Calibrates objective CPU billing on the machine it runs on: pushes the same small set of reference actions over and
+ * over, one per transaction, on each wasm runtime, and reports the distribution of the CPU the transaction_context
+ * billed for them. The minimum billable CPU is set to 0, so the numbers are what update_billed_cpu_time measured.
+ *
+ * The spread between the median and the tail is the noise of billing on this node; subjective-cpu-leeway-us and
+ * cpu-effort-percent can be sized from it instead of guessed. Not run as a test, run it on the producing hardware.
+ */
+namespace {
+   enum class reference_op {
+      noop,        ///< noop anyaction, an action that does nothing beyond running the contract
+      transfer,    ///< eosio.token transfer, a few table reads and writes
+      multi_index  ///< integration_test store, emplaces rows in a table of the sender
+   };
+
+   const std::vector<std::pair<reference_op, std::string>> op_names = {
+      { reference_op::noop,        "noop" },
+      { reference_op::transfer,    "transfer" },
+      { reference_op::multi_index, "multi-index" }
+   };
+
+   const std::vector<std::pair<wasm_interface::vm_type, std::string>> runtime_names = {
+      { wasm_interface::vm_type::wabt,       "wabt" },
+#ifdef EOSIO_EOS_VM_RUNTIME_ENABLED
+      { wasm_interface::vm_type::eos_vm,     "eos-vm" },
+#endif
+#ifdef EOSIO_EOS_VM_JIT_RUNTIME_ENABLED
+      { wasm_interface::vm_type::eos_vm_jit, "eos-vm-jit" },
+#endif
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+      { wasm_interface::vm_type::eos_vm_oc,  "eos-vm-oc" },
+#endif
+   };
+
+   struct bench_config {
+      uint32_t samples = 0;
+      uint32_t warmup = 0;
+      uint32_t per_block = 0;
+   };
+
+   const symbol bench_symbol = symbol(4, "BEN");
+   const name op_account = N(bench.op);
+   const name sender_account = N(bench.from);
+   const name receiver_account = N(bench.to);
+
+   /// distribution of the billed CPU of one reference op, in microseconds
+   struct distribution {
+      std::vector<uint32_t> billed_us;
+
+      uint32_t percentile(double p) const {
+         return billed_us[std::min<size_t>(billed_us.size() - 1, static_cast<size_t>(p / 100 * billed_us.size()))];
+      }
+      double mean() const {
+         double sum = 0;
+         for (auto us : billed_us)
+            sum += us;
+         return sum / billed_us.size();
+      }
+      double stddev() const {
+         const double m = mean();
+         double sum = 0;
+         for (auto us : billed_us)
+            sum += (us - m) * (us - m);
+         return std::sqrt(sum / billed_us.size());
+      }
+   };
+
+   class bench_chain {
+   public:
+      bench_chain(const fc::temp_directory& dir, wasm_interface::vm_type runtime, reference_op op)
+      : op(op)
+      , chain(make_config(dir, runtime), make_genesis())
+      {
+         chain.execute_setup_policy(setup_policy::full);
+         chain.produce_block();
+         setup();
+      }
+
+      /// @return the CPU billed for one transaction of the reference op
+      uint32_t run_one(uint64_t n) {
+         signed_transaction trx;
+         trx.actions.emplace_back(make_action());
+         // keeps the transactions of a block distinct, the context free action is not billed differently for any op
+         trx.context_free_actions.emplace_back(action({}, eosio::chain::config::null_account_name, N(nonce), fc::raw::pack(n)));
+         chain.set_transaction_headers(trx);
+         trx.sign(base_tester::get_private_key(sender_account, "active"), chain.control->get_chain_id());
+         auto trace = chain.push_transaction(trx, fc::time_point::maximum(), 0);
+         return trace->receipt->cpu_usage_us;
+      }
+
+      void produce_block() {
+         chain.produce_block();
+      }
+
+   private:
+      static controller::config make_config(const fc::temp_directory& dir, wasm_interface::vm_type runtime) {
+         auto cfg = base_tester::default_config(dir).first;
+         cfg.wasm_runtime = runtime;
+         cfg.contracts_console = false;
+         return cfg;
+      }
+
+      static genesis_state make_genesis() {
+         auto genesis = base_tester::default_genesis();
+         genesis.initial_configuration.min_transaction_cpu_usage = 0;
+         genesis.initial_configuration.max_block_cpu_usage = 100'000'000;
+         return genesis;
+      }
+
+      void setup() {
+         chain.create_accounts({op_account, sender_account, receiver_account});
+         chain.produce_block();
+         switch (op) {
+            case reference_op::noop:
+               chain.set_code(op_account, contracts::noop_wasm());
+               chain.set_abi(op_account, contracts::noop_abi().data());
+               serializer.emplace(fc::json::from_string(contracts::noop_abi().data()).as<abi_def>(), base_tester::abi_serializer_max_time);
+               break;
+            case reference_op::transfer:
+               chain.set_code(op_account, contracts::eosio_token_wasm());
+               chain.set_abi(op_account, contracts::eosio_token_abi().data());
+               chain.push_action(op_account, N(create), op_account,
+                                 mvo()("issuer", op_account)("maximum_supply", asset(1'000'000'000'0000, bench_symbol)));
+               chain.push_action(op_account, N(issue), op_account,
+                                 mvo()("to", sender_account)("quantity", asset(1'000'000'000'0000, bench_symbol))("memo", ""));
+               serializer.emplace(fc::json::from_string(contracts::eosio_token_abi().data()).as<abi_def>(), base_tester::abi_serializer_max_time);
+               break;
+            case reference_op::multi_index:
+               chain.set_code(op_account, contracts::integration_test_wasm());
+               chain.set_abi(op_account, contracts::integration_test_abi().data());
+               serializer.emplace(fc::json::from_string(contracts::integration_test_abi().data()).as<abi_def>(), base_tester::abi_serializer_max_time);
+               break;
+         }
+         chain.produce_block();
+      }
+
+      action make_action() const {
+         const vector<permission_level> auth{{sender_account, eosio::chain::config::active_name}};
+         switch (op) {
+            case reference_op::noop:
+               return action(auth, op_account, N(anyaction), serializer->variant_to_binary("anyaction",
+                  mvo()("from", sender_account)("type", "")("data", ""), base_tester::abi_serializer_max_time));
+            case reference_op::transfer:
+               return action(auth, op_account, N(transfer), serializer->variant_to_binary("transfer",
+                  mvo()("from", sender_account)("to", receiver_account)("quantity", asset(1, bench_symbol))("memo", ""), base_tester::abi_serializer_max_time));
+            case reference_op::multi_index:
+            default:
+               return action(auth, op_account, N(store), serializer->variant_to_binary("store",
+                  mvo()("from", sender_account)("to", receiver_account)("num", 1), base_tester::abi_serializer_max_time));
+         }
+      }
+
+      const reference_op           op;
+      tester                       chain;
+      fc::optional<abi_serializer> serializer;
+   };
+
+   distribution run(wasm_interface::vm_type runtime, reference_op op, const bench_config& config) {
+      fc::temp_directory dir;
+      bench_chain chain(dir, runtime, op);
+
+      distribution d;
+      d.billed_us.reserve(config.samples);
+      for (uint64_t n = 0; n < config.warmup + config.samples; ++n) {
+         const uint32_t billed = chain.run_one(n);
+         if (n >= config.warmup)
+            d.billed_us.push_back(billed);
+         if (n % config.per_block == config.per_block - 1)
+            chain.produce_block();
+      }
+      std::sort(d.billed_us.begin(), d.billed_us.end());
+      return d;
+   }
+
+   void report(const std::string& runtime_name, const std::string& op_name, const distribution& d) {
+      std::cout << std::left << std::setw(12) << runtime_name << std::setw(13) << op_name << std::right
+                << std::setw(8) << d.percentile(0) << std::setw(8) << d.percentile(50) << std::setw(8) << d.percentile(90)
+                << std::setw(8) << d.percentile(99) << std::setw(8) << d.billed_us.back()
+                << std::fixed << std::setprecision(1) << std::setw(9) << d.mean() << std::setw(9) << d.stddev() << "\n";
+   }
+
+   template<typename T>
+   std::vector<T> parse_names(const std::vector<std::string>& names, const std::vector<std::pair<T, std::string>>& known,
+                              const std::string& what) {
+      std::vector<T> result;
+      for (const auto& n : names) {
+         auto itr = std::find_if(known.begin(), known.end(), [&n](const auto& k) { return k.second == n; });
+         if (itr == known.end())
+            throw std::runtime_error("unknown or not compiled in " + what + " " + n);
+         result.push_back(itr->first);
+      }
+      return result;
+   }
+
+   template<typename T>
+   const std::string& name_of(T value, const std::vector<std::pair<T, std::string>>& known) {
+      return std::find_if(known.begin(), known.end(), [value](const auto& k) { return k.first == value; })->second;
+   }
+}
+
+int main(int argc, char** argv) {
+   bench_config config;
+   std::vector<std::string> runtimes;
+   std::vector<std::string> ops;
+   bpo::options_description options("bench_billing_calibration");
+   options.add_options()
+      ("help,h", "print this help")
+      ("samples", bpo::value<uint32_t>(&config.samples)->default_value(5000), "measured transactions of each reference op")
+      ("warmup", bpo::value<uint32_t>(&config.warmup)->default_value(200), "transactions pushed before measuring, to compile and cache the contracts")
+      ("per-block", bpo::value<uint32_t>(&config.per_block)->default_value(500), "transactions per block")
+      ("runtime", bpo::value<std::vector<std::string>>(&runtimes)->multitoken(), "wasm runtimes to measure, defaults to all compiled in")
+      ("op", bpo::value<std::vector<std::string>>(&ops)->multitoken(), "reference ops to run: noop, transfer, multi-index; defaults to all");
+   bpo::variables_map vm;
+   std::vector<wasm_interface::vm_type> selected_runtimes;
+   std::vector<reference_op> selected_ops;
+   try {
+      bpo::store(bpo::parse_command_line(argc, argv, options), vm);
+      bpo::notify(vm);
+      if (vm.count("help")) {
+         std::cout << options;
+         return 0;
+      }
+      for (const auto& r : runtime_names)
+         if (runtimes.empty()) selected_runtimes.push_back(r.first);
+      for (const auto& o : op_names)
+         if (ops.empty()) selected_ops.push_back(o.first);
+      if (!runtimes.empty())
+         selected_runtimes = parse_names(runtimes, runtime_names, "runtime");
+      if (!ops.empty())
+         selected_ops = parse_names(ops, op_names, "op");
+      if (config.samples == 0 || config.per_block == 0)
+         throw std::runtime_error("samples and per-block must not be 0");
+   } catch (const std::exception& e) {
+      std::cerr << e.what() << "\n" << options;
+      return 1;
+   }
+
+   fc::logger::get(DEFAULT_LOGGER).set_log_level(fc::log_level::warn);
+   std::cout << "billed cpu (us) of " << config.samples << " transactions of each op\n"
+             << std::left << std::setw(12) << "runtime" << std::setw(13) << "op" << std::right
+             << std::setw(8) << "min" << std::setw(8) << "p50" << std::setw(8) << "p90" << std::setw(8) << "p99"
+             << std::setw(8) << "max" << std::setw(9) << "mean" << std::setw(9) << "stddev" << "\n";
+   uint32_t worst_tail_us = 0;
+   try {
+      for (auto runtime : selected_runtimes) {
+         for (auto op : selected_ops) {
+            const distribution d = run(runtime, op, config);
+            report(name_of(runtime, runtime_names), name_of(op, op_names), d);
+            worst_tail_us = std::max(worst_tail_us, d.percentile(99) - d.percentile(50));
+         }
+      }
+   } catch (const fc::exception& e) {
+      std::cerr << e.to_detail_string() << "\n";
+      return 1;
+   } catch (const std::exception& e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+   }
+   // the same transaction is billed this much more than its median one time in a hundred on this node
+   std::cout << "\nlargest p99 - p50: " << worst_tail_us << "us\n";
+   return 0;
+}
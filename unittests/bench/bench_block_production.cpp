@@ -0,0 +1,358 @@
+#include <eosio/testing/tester.hpp>
+#include <eosio/chain/abi_serializer.hpp>
+
+#include <fc/variant_object.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include <contracts.hpp>
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+using mvo = fc::mutable_variant_object;
+namespace bpo = boost::program_options;
+
+/**
+ * Measures block production directly on a controller: preloads accounts, pushes repeatable workloads into blocks and
+ * reports transactions per second, cpu per transaction and where the time of a block goes, for each wasm runtime.
+ * Not run as a test, it is meant to compare releases.
+ */
+namespace {
+   enum class workload_type {
+      transfer,    ///< eosio.token transfers between the accounts
+      multi_index, ///< integration_test store, emplaces rows in a table of the sender
+      deferred     ///< deferred_test defercall, schedules a deferred transaction executed in the next block
+   };
+
+   const std::vector<std::pair<workload_type, std::string>> workload_names = {
+      { workload_type::transfer,    "transfer" },
+      { workload_type::multi_index, "multi-index" },
+      { workload_type::deferred,    "deferred" }
+   };
+
+   const std::vector<std::pair<wasm_interface::vm_type, std::string>> runtime_names = {
+      { wasm_interface::vm_type::wabt,       "wabt" },
+#ifdef EOSIO_EOS_VM_RUNTIME_ENABLED
+      { wasm_interface::vm_type::eos_vm,     "eos-vm" },
+#endif
+#ifdef EOSIO_EOS_VM_JIT_RUNTIME_ENABLED
+      { wasm_interface::vm_type::eos_vm_jit, "eos-vm-jit" },
+#endif
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+      { wasm_interface::vm_type::eos_vm_oc,  "eos-vm-oc" },
+#endif
+   };
+
+   struct bench_config {
+      uint32_t accounts = 0;
+      uint32_t transactions = 0;
+      uint32_t blocks = 0;
+      uint32_t warmup_blocks = 0;
+      uint64_t state_size_mb = 0;
+   };
+
+   /// wall time of each stage of producing the measured blocks, and the cpu the chain measured for their transactions
+   struct stage_times {
+      std::chrono::nanoseconds sign{0};     ///< building and signing the transactions, client side
+      std::chrono::nanoseconds recover{0};  ///< recovering the keys of the transactions on the controller thread pool
+      std::chrono::nanoseconds apply{0};    ///< pushing the transactions into the pending block
+      std::chrono::nanoseconds produce{0};  ///< executing scheduled transactions, finalizing, signing and committing
+      uint64_t transactions = 0;
+      uint64_t scheduled = 0;
+      uint64_t cpu_us = 0;
+   };
+
+   const symbol bench_symbol = symbol(4, "BEN");
+   const name token_account = N(eosio.token);
+   const name table_account = N(bench.table);
+   const name deferred_account = N(bench.defer);
+
+   name bench_account(uint32_t i) {
+      static const char digits[] = "abcdefghijklmnopqrstuvwxyz12345";
+      std::string s = "bench";
+      for (int d = 0; d < 7; ++d) {
+         s += digits[i % 31];
+         i /= 31;
+      }
+      return name(s);
+   }
+
+   double micros(std::chrono::nanoseconds d) {
+      return std::chrono::duration<double, std::micro>(d).count();
+   }
+
+   class bench_chain {
+   public:
+      bench_chain(const fc::temp_directory& dir, wasm_interface::vm_type runtime, workload_type workload,
+                  const bench_config& config)
+      : workload(workload)
+      , config(config)
+      , chain(make_config(dir, runtime, config), make_genesis())
+      {
+         chain.execute_setup_policy(setup_policy::full);
+         chain.produce_block();
+         setup();
+      }
+
+      /// pushes one block of the workload and produces it, adding the time of each stage to times
+      void run_block(uint32_t block, stage_times& times) {
+         const auto chain_id = chain.control->get_chain_id();
+         const auto& head = chain.control->head_block_state();
+
+         auto start = std::chrono::steady_clock::now();
+         std::vector<packed_transaction_ptr> trxs;
+         trxs.reserve(config.transactions);
+         for (uint32_t t = 0; t < config.transactions; ++t) {
+            const uint64_t n = static_cast<uint64_t>(block) * config.transactions + t;
+            const uint32_t from = n % config.accounts;
+            signed_transaction trx;
+            trx.actions.emplace_back(make_action(from, n));
+            trx.context_free_actions.emplace_back(action({}, eosio::chain::config::null_account_name, N(nonce), fc::raw::pack(n)));
+            trx.expiration = head->header.timestamp.to_time_point() + fc::seconds(60);
+            trx.set_reference_block(head->id);
+            trx.sign(keys[from], chain_id);
+            trxs.emplace_back(std::make_shared<packed_transaction>(std::move(trx)));
+         }
+         auto end = std::chrono::steady_clock::now();
+         times.sign += end - start;
+
+         start = end;
+         std::vector<recover_keys_future> futures;
+         futures.reserve(trxs.size());
+         for (auto& trx : trxs)
+            futures.emplace_back(transaction_metadata::start_recover_keys(trx, chain.control->get_thread_pool(), chain_id, fc::microseconds::maximum()));
+         std::vector<transaction_metadata_ptr> metas;
+         metas.reserve(futures.size());
+         for (auto& f : futures)
+            metas.emplace_back(f.get());
+         end = std::chrono::steady_clock::now();
+         times.recover += end - start;
+
+         start = end;
+         for (const auto& meta : metas) {
+            auto trace = chain.control->push_transaction(meta, fc::time_point::maximum(), 0, false);
+            if (trace->except)
+               throw *trace->except;
+            times.cpu_us += trace->elapsed.count();
+         }
+         end = std::chrono::steady_clock::now();
+         times.apply += end - start;
+         times.transactions += metas.size();
+
+         start = end;
+         std::vector<transaction_trace_ptr> scheduled;
+         chain.produce_block(scheduled);
+         end = std::chrono::steady_clock::now();
+         times.produce += end - start;
+         for (const auto& trace : scheduled) {
+            if (trace->except)
+               throw *trace->except;
+            times.cpu_us += trace->elapsed.count();
+         }
+         times.scheduled += scheduled.size();
+      }
+
+   private:
+      static controller::config make_config(const fc::temp_directory& dir, wasm_interface::vm_type runtime, const bench_config& config) {
+         auto cfg = base_tester::default_config(dir).first;
+         cfg.wasm_runtime = runtime;
+         cfg.state_size = config.state_size_mb * 1024 * 1024;
+         cfg.reversible_cache_size = 1024 * 1024 * 256;
+         cfg.contracts_console = false;
+         return cfg;
+      }
+
+      static genesis_state make_genesis() {
+         auto genesis = base_tester::default_genesis();
+         // blocks hold whatever a block of the workload needs, the limits are not what is measured
+         genesis.initial_configuration.max_block_cpu_usage = 100'000'000;
+         genesis.initial_configuration.max_block_net_usage = 256 * 1024 * 1024;
+         return genesis;
+      }
+
+      void setup() {
+         std::vector<name> accounts;
+         accounts.reserve(config.accounts);
+         keys.reserve(config.accounts);
+         for (uint32_t i = 0; i < config.accounts; ++i) {
+            accounts.emplace_back(bench_account(i));
+            keys.emplace_back(base_tester::get_private_key(accounts.back(), "active"));
+         }
+         for (uint32_t i = 0; i < accounts.size(); ++i) {
+            chain.create_account(accounts[i]);
+            if (i % 500 == 499)
+               chain.produce_block();
+         }
+         chain.produce_block();
+
+         switch (workload) {
+            case workload_type::transfer: {
+               chain.create_account(token_account);
+               chain.set_code(token_account, contracts::eosio_token_wasm());
+               chain.set_abi(token_account, contracts::eosio_token_abi().data());
+               chain.push_action(token_account, N(create), token_account,
+                                 mvo()("issuer", token_account)("maximum_supply", asset(1'000'000'000'0000, bench_symbol)));
+               chain.push_action(token_account, N(issue), token_account,
+                                 mvo()("to", token_account)("quantity", asset(1'000'000'000'0000, bench_symbol))("memo", ""));
+               chain.produce_block();
+               for (uint32_t i = 0; i < accounts.size(); ++i) {
+                  chain.push_action(token_account, N(transfer), token_account,
+                                    mvo()("from", token_account)("to", accounts[i])("quantity", asset(1000'0000, bench_symbol))("memo", ""));
+                  if (i % 500 == 499)
+                     chain.produce_block();
+               }
+               serializer.emplace(fc::json::from_string(contracts::eosio_token_abi().data()).as<abi_def>(), base_tester::abi_serializer_max_time);
+               break;
+            }
+            case workload_type::multi_index:
+               chain.create_account(table_account);
+               chain.set_code(table_account, contracts::integration_test_wasm());
+               chain.set_abi(table_account, contracts::integration_test_abi().data());
+               serializer.emplace(fc::json::from_string(contracts::integration_test_abi().data()).as<abi_def>(), base_tester::abi_serializer_max_time);
+               break;
+            case workload_type::deferred:
+               chain.create_account(deferred_account);
+               chain.set_code(deferred_account, contracts::deferred_test_wasm());
+               chain.set_abi(deferred_account, contracts::deferred_test_abi().data());
+               serializer.emplace(fc::json::from_string(contracts::deferred_test_abi().data()).as<abi_def>(), base_tester::abi_serializer_max_time);
+               break;
+         }
+         chain.produce_block();
+         accounts_ = std::move(accounts);
+      }
+
+      action make_action(uint32_t from, uint64_t n) const {
+         const auto& sender = accounts_[from];
+         const auto& receiver = accounts_[(from + 1) % accounts_.size()];
+         const vector<permission_level> auth{{sender, eosio::chain::config::active_name}};
+         switch (workload) {
+            case workload_type::transfer:
+               return action(auth, token_account, N(transfer), serializer->variant_to_binary("transfer",
+                  mvo()("from", sender)("to", receiver)("quantity", asset(1, bench_symbol))("memo", ""), base_tester::abi_serializer_max_time));
+            case workload_type::multi_index:
+               return action(auth, table_account, N(store), serializer->variant_to_binary("store",
+                  mvo()("from", sender)("to", receiver)("num", 8), base_tester::abi_serializer_max_time));
+            case workload_type::deferred:
+            default:
+               return action(auth, deferred_account, N(defercall), serializer->variant_to_binary("defercall",
+                  mvo()("payer", sender)("sender_id", n)("contract", deferred_account)("payload", 1), base_tester::abi_serializer_max_time));
+         }
+      }
+
+      const workload_type           workload;
+      const bench_config            config;
+      tester                        chain;
+      std::vector<name>             accounts_;
+      std::vector<private_key_type> keys;
+      fc::optional<abi_serializer>  serializer;
+   };
+
+   void run(wasm_interface::vm_type runtime, const std::string& runtime_name, workload_type workload,
+            const std::string& workload_name, const bench_config& config) {
+      fc::temp_directory dir;
+      bench_chain chain(dir, runtime, workload, config);
+
+      stage_times warmup;
+      for (uint32_t b = 0; b < config.warmup_blocks; ++b)
+         chain.run_block(b, warmup);
+
+      stage_times times;
+      for (uint32_t b = config.warmup_blocks; b < config.warmup_blocks + config.blocks; ++b)
+         chain.run_block(b, times);
+
+      const auto executed = times.transactions + times.scheduled;
+      const auto chain_time = times.recover + times.apply + times.produce;
+      std::cout << std::left << std::setw(12) << runtime_name << std::setw(13) << workload_name << std::right
+                << std::fixed << std::setprecision(1)
+                << std::setw(10) << executed * 1e6 / std::max(micros(chain_time), 1.0)
+                << std::setw(10) << static_cast<double>(times.cpu_us) / std::max<uint64_t>(executed, 1)
+                << std::setw(10) << micros(times.sign) / std::max<uint64_t>(times.transactions, 1)
+                << std::setw(10) << micros(times.recover) / config.blocks / 1000
+                << std::setw(10) << micros(times.apply) / config.blocks / 1000
+                << std::setw(10) << micros(times.produce) / config.blocks / 1000 << "\n";
+   }
+
+   template<typename T>
+   std::vector<T> parse_names(const std::vector<std::string>& names, const std::vector<std::pair<T, std::string>>& known,
+                              const std::string& what) {
+      std::vector<T> result;
+      for (const auto& n : names) {
+         auto itr = std::find_if(known.begin(), known.end(), [&n](const auto& k) { return k.second == n; });
+         if (itr == known.end())
+            throw std::runtime_error("unknown or not compiled in " + what + " " + n);
+         result.push_back(itr->first);
+      }
+      return result;
+   }
+
+   template<typename T>
+   const std::string& name_of(T value, const std::vector<std::pair<T, std::string>>& known) {
+      return std::find_if(known.begin(), known.end(), [value](const auto& k) { return k.first == value; })->second;
+   }
+}
+
+int main(int argc, char** argv) {
+   bench_config config;
+   std::vector<std::string> runtimes;
+   std::vector<std::string> workloads;
+   bpo::options_description options("bench_block_production");
+   options.add_options()
+      ("help,h", "print this help")
+      ("accounts", bpo::value<uint32_t>(&config.accounts)->default_value(1000), "number of accounts sending transactions")
+      ("transactions", bpo::value<uint32_t>(&config.transactions)->default_value(1000), "transactions per block")
+      ("blocks", bpo::value<uint32_t>(&config.blocks)->default_value(20), "number of measured blocks")
+      ("warmup-blocks", bpo::value<uint32_t>(&config.warmup_blocks)->default_value(2), "blocks produced before measuring, to compile and cache the contracts")
+      ("state-size-mb", bpo::value<uint64_t>(&config.state_size_mb)->default_value(1024), "size of the chain state")
+      ("runtime", bpo::value<std::vector<std::string>>(&runtimes)->multitoken(), "wasm runtimes to measure, defaults to all compiled in")
+      ("workload", bpo::value<std::vector<std::string>>(&workloads)->multitoken(), "workloads to run: transfer, multi-index, deferred; defaults to all");
+   bpo::variables_map vm;
+   std::vector<wasm_interface::vm_type> selected_runtimes;
+   std::vector<workload_type> selected_workloads;
+   try {
+      bpo::store(bpo::parse_command_line(argc, argv, options), vm);
+      bpo::notify(vm);
+      if (vm.count("help")) {
+         std::cout << options;
+         return 0;
+      }
+      for (const auto& r : runtime_names)
+         if (runtimes.empty()) selected_runtimes.push_back(r.first);
+      for (const auto& w : workload_names)
+         if (workloads.empty()) selected_workloads.push_back(w.first);
+      if (!runtimes.empty())
+         selected_runtimes = parse_names(runtimes, runtime_names, "runtime");
+      if (!workloads.empty())
+         selected_workloads = parse_names(workloads, workload_names, "workload");
+      if (config.accounts < 2 || config.transactions == 0 || config.blocks == 0)
+         throw std::runtime_error("accounts must be at least 2, transactions and blocks not 0");
+   } catch (const std::exception& e) {
+      std::cerr << e.what() << "\n" << options;
+      return 1;
+   }
+
+   fc::logger::get(DEFAULT_LOGGER).set_log_level(fc::log_level::warn);
+   std::cout << config.transactions << " transactions per block, " << config.blocks << " blocks, "
+             << config.accounts << " accounts\n"
+             << std::left << std::setw(12) << "runtime" << std::setw(13) << "workload" << std::right
+             << std::setw(10) << "trx/s" << std::setw(10) << "cpu us" << std::setw(10) << "sign us"
+             << std::setw(10) << "recov ms" << std::setw(10) << "apply ms" << std::setw(10) << "prod ms" << "\n";
+   try {
+      for (auto runtime : selected_runtimes) {
+         for (auto workload : selected_workloads) {
+            run(runtime, name_of(runtime, runtime_names), workload, name_of(workload, workload_names), config);
+         }
+      }
+   } catch (const fc::exception& e) {
+      std::cerr << e.to_detail_string() << "\n";
+      return 1;
+   } catch (const std::exception& e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+   }
+   return 0;
+}
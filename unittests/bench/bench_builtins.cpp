@@ -0,0 +1,122 @@
+#include <compiler_builtins.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace bpo = boost::program_options;
+using namespace eosio;
+
+/**
+ * Measures the 128 bit integer conversions behind the compiler builtins intrinsics, the portable implementations
+ * against the native fast paths of compiler_builtins.hpp, and the native 128 bit arithmetic the intrinsics use.  Inputs
+ * are drawn so that most of them are in the range contracts use for asset math.  Not run as a test.
+ */
+namespace {
+   template<typename T, typename Op>
+   double ns_per_call( const std::vector<T>& inputs, uint32_t rounds, Op op ) {
+      unsigned __int128 checksum = 0;
+      const auto start = std::chrono::steady_clock::now();
+      for( uint32_t r = 0; r < rounds; ++r )
+         for( std::size_t i = 1; i < inputs.size(); ++i )
+            checksum += op( inputs[i - 1], inputs[i] );
+      const auto end = std::chrono::steady_clock::now();
+      // keeps the loop from being optimized away
+      if( checksum == 42 ) std::cout << "";
+      return std::chrono::duration<double, std::nano>( end - start ).count() / ( double( rounds ) * ( inputs.size() - 1 ) );
+   }
+
+   void report( const std::string& name, double portable, double native ) {
+      std::cout << std::left << std::setw(14) << name << std::right << std::fixed << std::setprecision(2)
+                << std::setw(12) << portable << std::setw(12) << native << std::setw(10) << portable / native << "x\n";
+   }
+
+   uint64_t bits( double d ) { uint64_t v; memcpy( &v, &d, sizeof(v) ); return v; }
+   uint32_t bits( float f ) { uint32_t v; memcpy( &v, &f, sizeof(v) ); return v; }
+}
+
+int main( int argc, char** argv ) {
+   uint32_t count = 0;
+   uint32_t rounds = 0;
+   double large = 0;
+   bpo::options_description options("bench_builtins");
+   options.add_options()
+      ("help,h", "print this help")
+      ("inputs", bpo::value<uint32_t>(&count)->default_value(1'000'000), "number of random inputs")
+      ("rounds", bpo::value<uint32_t>(&rounds)->default_value(10), "passes over the inputs per measurement")
+      ("large", bpo::value<double>(&large)->default_value(0.05), "fraction of inputs outside of the native fast paths");
+   bpo::variables_map vm;
+   try {
+      bpo::store( bpo::parse_command_line( argc, argv, options ), vm );
+      bpo::notify( vm );
+   } catch( const std::exception& e ) {
+      std::cerr << e.what() << "\n" << options;
+      return 1;
+   }
+   if( vm.count("help") ) {
+      std::cout << options;
+      return 0;
+   }
+   if( count < 2 || rounds == 0 || large < 0 || large > 1 ) {
+      std::cerr << "inputs must be at least 2, rounds not 0 and large between 0 and 1\n" << options;
+      return 1;
+   }
+
+   std::mt19937_64 gen(0);
+   std::uniform_real_distribution<double> is_large(0, 1);
+   std::vector<uint64_t> doubles;
+   std::vector<uint32_t> floats;
+   std::vector<unsigned __int128> ints;
+   for( uint32_t i = 0; i < count; ++i ) {
+      const bool l = is_large( gen ) < large;
+      // amounts of up to 10^15 with 4 decimals, or up to 10^30
+      const double d = std::uniform_real_distribution<double>( -1, 1 )( gen ) * ( l ? 1e30 : 1e15 );
+      doubles.push_back( bits( d ) );
+      floats.push_back( bits( static_cast<float>( d ) ) );
+      ints.push_back( builtins::make_uint128( gen() >> ( l ? 0 : 14 ), l ? gen() : 0 ) );
+   }
+
+   std::cout << "native builtins " <<
+#ifdef EOSIO_NATIVE_BUILTINS
+      "enabled"
+#else
+      "disabled, both columns are portable"
+#endif
+      << "\n";
+   std::cout << std::left << std::setw(14) << "op (ns)" << std::right
+             << std::setw(12) << "portable" << std::setw(12) << "native" << std::setw(11) << "speedup" << "\n";
+   report( "fixdfti",
+      ns_per_call( doubles, rounds, []( uint64_t, uint64_t a ) { return ___fixdfti( a ); } ),
+      ns_per_call( doubles, rounds, []( uint64_t, uint64_t a ) { return builtins::fixdfti( a ); } ) );
+   report( "fixunsdfti",
+      ns_per_call( doubles, rounds, []( uint64_t, uint64_t a ) { return ___fixunsdfti( a ); } ),
+      ns_per_call( doubles, rounds, []( uint64_t, uint64_t a ) { return builtins::fixunsdfti( a ); } ) );
+   report( "fixsfti",
+      ns_per_call( floats, rounds, []( uint32_t, uint32_t a ) { return ___fixsfti( a ); } ),
+      ns_per_call( floats, rounds, []( uint32_t, uint32_t a ) { return builtins::fixsfti( a ); } ) );
+   report( "fixunssfti",
+      ns_per_call( floats, rounds, []( uint32_t, uint32_t a ) { return ___fixunssfti( a ); } ),
+      ns_per_call( floats, rounds, []( uint32_t, uint32_t a ) { return builtins::fixunssfti( a ); } ) );
+   report( "floattidf",
+      ns_per_call( ints, rounds, []( unsigned __int128, unsigned __int128 a ) { return bits( ___floattidf( a ) ); } ),
+      ns_per_call( ints, rounds, []( unsigned __int128, unsigned __int128 a ) { return bits( builtins::floattidf( a ) ); } ) );
+   report( "floatuntidf",
+      ns_per_call( ints, rounds, []( unsigned __int128, unsigned __int128 a ) { return bits( ___floatuntidf( a ) ); } ),
+      ns_per_call( ints, rounds, []( unsigned __int128, unsigned __int128 a ) { return bits( builtins::floatuntidf( a ) ); } ) );
+
+   std::cout << "\n" << std::left << std::setw(14) << "native (ns)" << "\n";
+   auto native = []( const std::string& name, double ns ) {
+      std::cout << std::left << std::setw(14) << name << std::right << std::fixed << std::setprecision(2) << std::setw(12) << ns << "\n";
+   };
+   native( "multi3", ns_per_call( ints, rounds, []( unsigned __int128 a, unsigned __int128 b ) { return a * b; } ) );
+   native( "udivti3", ns_per_call( ints, rounds, []( unsigned __int128 a, unsigned __int128 b ) { return a / ( b | 1 ); } ) );
+   native( "umodti3", ns_per_call( ints, rounds, []( unsigned __int128 a, unsigned __int128 b ) { return a % ( b | 1 ); } ) );
+   native( "ashlti3", ns_per_call( ints, rounds, []( unsigned __int128 a, unsigned __int128 b ) {
+      return builtins::shl( a, static_cast<uint32_t>( b ) % 130 ); } ) );
+   return 0;
+}
@@ -0,0 +1,104 @@
+#include <eosio/chain/hardware_float.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace eosio::chain;
+namespace bpo = boost::program_options;
+
+/**
+ * Measures the float operations behind the WASM float intrinsics, softfloat against the hardware fast path, over random
+ * operands that are not NaN.  Not run as a test, it is meant to compare changes to eosio/chain/hardware_float.hpp.
+ */
+namespace {
+   template<typename F>
+   std::vector<F> without_nans( std::vector<F> v ) {
+      v.erase( std::remove_if( v.begin(), v.end(), []( const F& f ) {
+         if constexpr( sizeof( f.v ) == 4 ) return f32_is_nan( f );
+         else return f64_is_nan( f );
+      } ), v.end() );
+      return v;
+   }
+
+   template<typename F, typename Op>
+   double binary_ns( const std::vector<F>& operands, uint32_t rounds, Op op ) {
+      uint64_t checksum = 0;
+      const auto start = std::chrono::steady_clock::now();
+      for( uint32_t r = 0; r < rounds; ++r )
+         for( std::size_t i = 1; i < operands.size(); ++i )
+            checksum += op( operands[i - 1], operands[i] ).v;
+      const auto end = std::chrono::steady_clock::now();
+      // keeps the loop from being optimized away
+      if( checksum == 42 ) std::cout << "";
+      return std::chrono::duration<double, std::nano>( end - start ).count() / ( double( rounds ) * ( operands.size() - 1 ) );
+   }
+
+   template<typename F, typename Op>
+   double unary_ns( const std::vector<F>& operands, uint32_t rounds, Op op ) {
+      return binary_ns( operands, rounds, [&op]( const F&, const F& b ) { return op( b ); } );
+   }
+
+   void report( const std::string& name, double soft, double hard ) {
+      std::cout << std::left << std::setw(12) << name << std::right << std::fixed << std::setprecision(2)
+                << std::setw(12) << soft << std::setw(12) << hard << std::setw(10) << soft / hard << "x\n";
+   }
+}
+
+int main( int argc, char** argv ) {
+   uint32_t count = 0;
+   uint32_t rounds = 0;
+   bpo::options_description options("bench_softfloat");
+   options.add_options()
+      ("help,h", "print this help")
+      ("operands", bpo::value<uint32_t>(&count)->default_value(1'000'000), "number of random operands")
+      ("rounds", bpo::value<uint32_t>(&rounds)->default_value(10), "passes over the operands per measurement");
+   bpo::variables_map vm;
+   try {
+      bpo::store( bpo::parse_command_line( argc, argv, options ), vm );
+      bpo::notify( vm );
+   } catch( const std::exception& e ) {
+      std::cerr << e.what() << "\n" << options;
+      return 1;
+   }
+   if( vm.count("help") ) {
+      std::cout << options;
+      return 0;
+   }
+   if( count < 2 || rounds == 0 ) {
+      std::cerr << "operands must be at least 2, rounds not 0\n" << options;
+      return 1;
+   }
+
+   std::mt19937_64 gen(0);
+   std::vector<float32_t> f32s;
+   std::vector<float64_t> f64s;
+   for( uint32_t i = 0; i < count; ++i ) {
+      f32s.push_back( float32_t{ static_cast<uint32_t>( gen() ) } );
+      f64s.push_back( float64_t{ gen() } );
+   }
+   f32s = without_nans( std::move( f32s ) );
+   f64s = without_nans( std::move( f64s ) );
+
+   std::cout << "hardware fast path " << ( hardware_float::supported ? "enabled" : "not supported, both columns are softfloat" ) << "\n";
+   std::cout << std::left << std::setw(12) << "op (ns)" << std::right
+             << std::setw(12) << "softfloat" << std::setw(12) << "hardware" << std::setw(11) << "speedup" << "\n";
+   report( "f32.add",  binary_ns( f32s, rounds, ::f32_add ),    binary_ns( f32s, rounds, hardware_float::f32_add ) );
+   report( "f32.sub",  binary_ns( f32s, rounds, ::f32_sub ),    binary_ns( f32s, rounds, hardware_float::f32_sub ) );
+   report( "f32.mul",  binary_ns( f32s, rounds, ::f32_mul ),    binary_ns( f32s, rounds, hardware_float::f32_mul ) );
+   report( "f32.div",  binary_ns( f32s, rounds, ::f32_div ),    binary_ns( f32s, rounds, hardware_float::f32_div ) );
+   report( "f32.sqrt", unary_ns( f32s, rounds, ::f32_sqrt ),    unary_ns( f32s, rounds, hardware_float::f32_sqrt ) );
+   report( "f64.add",  binary_ns( f64s, rounds, ::f64_add ),    binary_ns( f64s, rounds, hardware_float::f64_add ) );
+   report( "f64.sub",  binary_ns( f64s, rounds, ::f64_sub ),    binary_ns( f64s, rounds, hardware_float::f64_sub ) );
+   report( "f64.mul",  binary_ns( f64s, rounds, ::f64_mul ),    binary_ns( f64s, rounds, hardware_float::f64_mul ) );
+   report( "f64.div",  binary_ns( f64s, rounds, ::f64_div ),    binary_ns( f64s, rounds, hardware_float::f64_div ) );
+   report( "f64.sqrt", unary_ns( f64s, rounds, ::f64_sqrt ),    unary_ns( f64s, rounds, hardware_float::f64_sqrt ) );
+   report( "promote",  unary_ns( f32s, rounds, ::f32_to_f64 ),  unary_ns( f32s, rounds, hardware_float::f32_to_f64 ) );
+   report( "demote",   unary_ns( f64s, rounds, ::f64_to_f32 ),  unary_ns( f64s, rounds, hardware_float::f64_to_f32 ) );
+   return 0;
+}
@@ -0,0 +1,140 @@
+#include <eosio/chain/wasm_eosio_injection.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+
+#include "IR/Module.h"
+#include "IR/Validate.h"
+#include "WASM/WASM.h"
+#include "Inline/Serialization.h"
+
+#include <contracts.hpp>
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+namespace bpo = boost::program_options;
+
+/**
+ * Measures WASM::serialize, the binary reader that decodes, validates and re-encodes a module to the WAVM IR on every
+ * setcode and cold instantiation, on the system and test contracts or on the given wasm files, alone and followed by
+ * the injection pass.  Not run as a test; to compare two versions of the reader, run it built from each.
+ */
+namespace {
+   struct measurement {
+      double   parse_us  = 0;
+      double   inject_us = 0;
+      uint64_t checksum  = 0;
+   };
+
+   measurement measure( const std::vector<uint8_t>& wasm, uint32_t rounds ) {
+      measurement m;
+      for( uint32_t r = 0; r < rounds; ++r ) {
+         IR::Module module;
+         const auto start = std::chrono::steady_clock::now();
+         Serialization::MemoryInputStream stream( wasm.data(), wasm.size() );
+         WASM::serialize( stream, module );
+         const auto parsed = std::chrono::steady_clock::now();
+         wasm_injections::wasm_binary_injection<false> injector( module );
+         injector.inject();
+         const auto end = std::chrono::steady_clock::now();
+
+         m.parse_us += std::chrono::duration<double, std::micro>( parsed - start ).count();
+         m.inject_us += std::chrono::duration<double, std::micro>( end - parsed ).count();
+         // keeps the work from being optimized away, and shows both versions decode the same modules
+         for( const IR::FunctionDef& f : module.functions.defs )
+            m.checksum += f.code.size() + f.nonParameterLocalTypes.size();
+      }
+      m.parse_us /= rounds;
+      m.inject_us /= rounds;
+      m.checksum /= rounds;
+      return m;
+   }
+
+   void report( const std::string& name, size_t size, const measurement& m ) {
+      std::cout << std::left << std::setw(24) << name << std::right << std::setw(10) << size
+                << std::fixed << std::setprecision(1) << std::setw(12) << m.parse_us
+                << std::setw(10) << size / m.parse_us << std::setw(12) << m.inject_us
+                << std::setw(14) << m.checksum << "\n";
+   }
+}
+
+int main( int argc, char** argv ) {
+   uint32_t rounds = 0;
+   std::vector<std::string> files;
+   bpo::options_description options("bench_wasm_deserialize");
+   options.add_options()
+      ("help,h", "print this help")
+      ("rounds", bpo::value<uint32_t>(&rounds)->default_value(100), "deserializations of each module per measurement")
+      ("wasm", bpo::value<std::vector<std::string>>(&files)->composing(), "wasm file to measure instead of the bundled contracts, may be repeated");
+   bpo::variables_map vm;
+   try {
+      bpo::store( bpo::parse_command_line( argc, argv, options ), vm );
+      bpo::notify( vm );
+   } catch( const std::exception& e ) {
+      std::cerr << e.what() << "\n" << options;
+      return 1;
+   }
+   if( vm.count("help") ) {
+      std::cout << options;
+      return 0;
+   }
+   if( rounds == 0 ) {
+      std::cerr << "rounds must not be 0\n" << options;
+      return 1;
+   }
+
+   std::vector<std::pair<std::string, std::vector<uint8_t>>> modules;
+   if( files.empty() ) {
+      modules = {
+         { "eosio.system",     contracts::eosio_system_wasm() },
+         { "eosio.msig",       contracts::eosio_msig_wasm() },
+         { "eosio.token",      contracts::eosio_token_wasm() },
+         { "eosio.bios",       contracts::eosio_bios_wasm() },
+         { "test_api",         contracts::test_api_wasm() },
+         { "test_api_multi_index", contracts::test_api_multi_index_wasm() },
+         { "integration_test", contracts::integration_test_wasm() },
+         { "noop",             contracts::noop_wasm() }
+      };
+   } else {
+      for( const auto& f : files ) {
+         std::ifstream in( f, std::ios::binary );
+         if( !in ) {
+            std::cerr << "cannot read " << f << "\n";
+            return 1;
+         }
+         modules.emplace_back( f, std::vector<uint8_t>( std::istreambuf_iterator<char>( in ), std::istreambuf_iterator<char>() ) );
+      }
+   }
+
+   std::cout << std::left << std::setw(24) << "module" << std::right << std::setw(10) << "bytes"
+             << std::setw(12) << "parse (us)" << std::setw(10) << "MB/s" << std::setw(12) << "inject (us)"
+             << std::setw(14) << "checksum" << "\n";
+   size_t total_size = 0;
+   double total_us = 0;
+   for( const auto& [name, wasm] : modules ) {
+      try {
+         const measurement m = measure( wasm, rounds );
+         report( name, wasm.size(), m );
+         total_size += wasm.size();
+         total_us += m.parse_us;
+      } catch( const Serialization::FatalSerializationException& e ) {
+         std::cerr << name << ": " << e.message << "\n";
+         return 1;
+      } catch( const IR::ValidationException& e ) {
+         std::cerr << name << ": " << e.message << "\n";
+         return 1;
+      } catch( const fc::exception& e ) {
+         std::cerr << name << ": " << e.to_detail_string() << "\n";
+         return 1;
+      }
+   }
+   if( total_us > 0 )
+      std::cout << "\n" << std::fixed << std::setprecision(1) << total_size / total_us << " MB/s over all modules\n";
+   return 0;
+}
@@ -0,0 +1,280 @@
+#include <eosio/testing/tester.hpp>
+#include <eosio/chain/abi_serializer.hpp>
+
+#include <fc/variant_object.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include <contracts.hpp>
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+using mvo = fc::mutable_variant_object;
+namespace bpo = boost::program_options;
+
+/**
+ * Compares the wasm runtimes on the same contracts: actions of the test contracts and of the token and system
+ * contracts, one per transaction, on a chain per runtime. For each action it reports the percentiles of the elapsed
+ * time of the action trace, which covers the contract run and not the transaction around it, and the elapsed time of
+ * its first run, which also pays for whatever the runtime does to instantiate a contract the first time it is called.
+ * The resident memory the chain of each runtime added to the process is reported once per runtime.
+ *
+ * Not run as a test; bench_billing_calibration measures what is billed for similar actions instead.
+ */
+namespace {
+   const std::vector<std::pair<wasm_interface::vm_type, std::string>> runtime_names = {
+      { wasm_interface::vm_type::wabt,       "wabt" },
+#ifdef EOSIO_EOS_VM_RUNTIME_ENABLED
+      { wasm_interface::vm_type::eos_vm,     "eos-vm" },
+#endif
+#ifdef EOSIO_EOS_VM_JIT_RUNTIME_ENABLED
+      { wasm_interface::vm_type::eos_vm_jit, "eos-vm-jit" },
+#endif
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+      { wasm_interface::vm_type::eos_vm_oc,  "eos-vm-oc" },
+#endif
+   };
+
+   const name sender_account = N(bench.from);
+   const name receiver_account = N(bench.to);
+
+   /// an action run over and over, on its own contract account
+   struct workload {
+      std::string                                 name;
+      account_name                                contract;
+      std::function<std::vector<uint8_t>()>       wasm;
+      std::function<std::vector<char>()>          abi;
+      action_name                                 action;
+      account_name                                authorizer;
+      std::function<fc::variant(uint64_t n)>      data;
+   };
+
+   const std::vector<workload>& workloads() {
+      static const std::vector<workload> w = {
+         { "noop", N(bench.noop), contracts::noop_wasm, contracts::noop_abi, N(anyaction), sender_account,
+           [](uint64_t) { return fc::variant(mvo()("from", sender_account)("type", "")("data", "")); } },
+         { "payloadless", N(bench.pay), contracts::payloadless_wasm, contracts::payloadless_abi, N(doit), sender_account,
+           [](uint64_t) { return fc::variant(mvo()); } },
+         { "asserter", N(bench.assert), contracts::asserter_wasm, contracts::asserter_abi, N(procassert), sender_account,
+           [](uint64_t) { return fc::variant(mvo()("condition", 1)("message", "")); } },
+         { "snapshot-test", N(bench.snap), contracts::snapshot_test_wasm, contracts::snapshot_test_abi, N(increment), N(bench.snap),
+           [](uint64_t) { return fc::variant(mvo()("value", 1)); } },
+         { "get-table-test", N(bench.table), contracts::get_table_test_wasm, contracts::get_table_test_abi, N(addnumobj), sender_account,
+           [](uint64_t n) { return fc::variant(mvo()("input", n)); } },
+         { "multi-index", N(bench.multi), contracts::integration_test_wasm, contracts::integration_test_abi, N(store), sender_account,
+           [](uint64_t) { return fc::variant(mvo()("from", sender_account)("to", receiver_account)("num", 1)); } },
+         { "token-transfer", N(eosio.token), contracts::eosio_token_wasm, contracts::eosio_token_abi, N(transfer), sender_account,
+           [](uint64_t) { return fc::variant(mvo()("from", sender_account)("to", receiver_account)("quantity", core_from_string("0.0001"))("memo", "")); } },
+         { "system-buyrambytes", config::system_account_name, contracts::eosio_system_wasm, contracts::eosio_system_abi, N(buyrambytes), sender_account,
+           [](uint64_t) { return fc::variant(mvo()("payer", sender_account)("receiver", sender_account)("bytes", 100)); } },
+      };
+      return w;
+   }
+
+   struct bench_config {
+      uint32_t samples = 0;
+      uint32_t per_block = 0;
+   };
+
+   /// resident set size of the process in KiB, 0 where /proc is not available
+   uint64_t resident_kib() {
+      std::ifstream status("/proc/self/status");
+      std::string line;
+      while (std::getline(status, line)) {
+         if (line.compare(0, 6, "VmRSS:") == 0)
+            return std::stoull(line.substr(6));
+      }
+      return 0;
+   }
+
+   struct distribution {
+      std::vector<int64_t> elapsed_us;
+      int64_t              first_us = 0;
+
+      int64_t percentile(double p) const {
+         return elapsed_us[std::min<size_t>(elapsed_us.size() - 1, static_cast<size_t>(p / 100 * elapsed_us.size()))];
+      }
+   };
+
+   class bench_chain {
+   public:
+      bench_chain(const fc::temp_directory& dir, wasm_interface::vm_type runtime)
+      : chain(make_config(dir, runtime), base_tester::default_genesis())
+      {
+         chain.execute_setup_policy(setup_policy::full);
+         chain.produce_block();
+         setup();
+      }
+
+      /// @return the elapsed time of the action of @ref w in one transaction
+      int64_t run_one(const workload& w, uint64_t n) {
+         signed_transaction trx;
+         trx.actions.emplace_back(vector<permission_level>{{w.authorizer, eosio::chain::config::active_name}}, w.contract, w.action,
+                                  serializers.at(w.contract).variant_to_binary(serializers.at(w.contract).get_action_type(w.action),
+                                                                               w.data(n), base_tester::abi_serializer_max_time));
+         // keeps the transactions of a block distinct
+         trx.context_free_actions.emplace_back(action({}, eosio::chain::config::null_account_name, N(nonce), fc::raw::pack(n)));
+         chain.set_transaction_headers(trx);
+         trx.sign(base_tester::get_private_key(w.authorizer, "active"), chain.control->get_chain_id());
+         auto trace = chain.push_transaction(trx, fc::time_point::maximum(), 0);
+         const auto itr = std::find_if(trace->action_traces.begin(), trace->action_traces.end(), [&w](const auto& at) {
+            return at.receiver == w.contract && at.act.name == w.action;
+         });
+         return itr == trace->action_traces.end() ? 0 : itr->elapsed.count();
+      }
+
+      void produce_block() {
+         chain.produce_block();
+      }
+
+   private:
+      static controller::config make_config(const fc::temp_directory& dir, wasm_interface::vm_type runtime) {
+         auto cfg = base_tester::default_config(dir).first;
+         cfg.wasm_runtime = runtime;
+         cfg.contracts_console = false;
+         cfg.state_size = 1024 * 1024 * 256;
+         return cfg;
+      }
+
+      void set_contract(const workload& w) {
+         chain.set_code(w.contract, w.wasm());
+         chain.set_abi(w.contract, w.abi().data());
+         serializers.emplace(w.contract, abi_serializer(fc::json::from_string(w.abi().data()).as<abi_def>(), base_tester::abi_serializer_max_time));
+      }
+
+      void setup() {
+         // the accounts are created before the system contract, which would have them buy their ram
+         vector<account_name> accounts{ sender_account, receiver_account, N(eosio.ram), N(eosio.ramfee), N(eosio.stake),
+                                        N(eosio.bpay), N(eosio.vpay), N(eosio.saving), N(eosio.names) };
+         for (const auto& w : workloads())
+            if (w.contract != config::system_account_name)
+               accounts.push_back(w.contract);
+         chain.create_accounts(accounts);
+         chain.produce_block();
+
+         for (const auto& w : workloads())
+            if (w.contract != config::system_account_name)
+               set_contract(w);
+         const auto supply = core_from_string("10000000000.0000");
+         chain.push_action(N(eosio.token), N(create), N(eosio.token), mvo()("issuer", config::system_account_name)("maximum_supply", supply));
+         chain.push_action(N(eosio.token), N(issue), config::system_account_name,
+                           mvo()("to", config::system_account_name)("quantity", core_from_string("1000000000.0000"))("memo", ""));
+         chain.push_action(N(eosio.token), N(transfer), config::system_account_name,
+                           mvo()("from", config::system_account_name)("to", sender_account)("quantity", core_from_string("100000000.0000"))("memo", ""));
+         chain.produce_block();
+
+         for (const auto& w : workloads())
+            if (w.contract == config::system_account_name)
+               set_contract(w);
+         chain.push_action(config::system_account_name, N(init), config::system_account_name,
+                           mvo()("version", 0)("core", symbol(4, CORE_SYMBOL_NAME)));
+         chain.produce_block();
+      }
+
+      tester                               chain;
+      std::map<account_name, abi_serializer> serializers;
+   };
+
+   void report(const std::string& runtime_name, const std::string& workload_name, const distribution& d) {
+      std::cout << std::left << std::setw(12) << runtime_name << std::setw(20) << workload_name << std::right
+                << std::setw(9) << d.first_us << std::setw(8) << d.percentile(50) << std::setw(8) << d.percentile(90)
+                << std::setw(8) << d.percentile(99) << std::setw(8) << d.elapsed_us.back() << "\n";
+   }
+
+   template<typename T>
+   std::vector<T> parse_names(const std::vector<std::string>& names, const std::vector<std::pair<T, std::string>>& known,
+                              const std::string& what) {
+      std::vector<T> result;
+      for (const auto& n : names) {
+         auto itr = std::find_if(known.begin(), known.end(), [&n](const auto& k) { return k.second == n; });
+         if (itr == known.end())
+            throw std::runtime_error("unknown or not compiled in " + what + " " + n);
+         result.push_back(itr->first);
+      }
+      return result;
+   }
+}
+
+int main(int argc, char** argv) {
+   bench_config config;
+   std::vector<std::string> runtimes;
+   std::vector<std::string> selected;
+   bpo::options_description options("bench_wasm_runtimes");
+   options.add_options()
+      ("help,h", "print this help")
+      ("samples", bpo::value<uint32_t>(&config.samples)->default_value(2000), "measured transactions of each action, after its first")
+      ("per-block", bpo::value<uint32_t>(&config.per_block)->default_value(500), "transactions per block")
+      ("runtime", bpo::value<std::vector<std::string>>(&runtimes)->multitoken(), "wasm runtimes to compare, defaults to all compiled in")
+      ("workload", bpo::value<std::vector<std::string>>(&selected)->multitoken(),
+       "actions to run: noop, payloadless, asserter, snapshot-test, get-table-test, multi-index, token-transfer, "
+       "system-buyrambytes; defaults to all");
+   bpo::variables_map vm;
+   std::vector<wasm_interface::vm_type> selected_runtimes;
+   try {
+      bpo::store(bpo::parse_command_line(argc, argv, options), vm);
+      bpo::notify(vm);
+      if (vm.count("help")) {
+         std::cout << options;
+         return 0;
+      }
+      for (const auto& r : runtime_names)
+         if (runtimes.empty()) selected_runtimes.push_back(r.first);
+      if (!runtimes.empty())
+         selected_runtimes = parse_names(runtimes, runtime_names, "runtime");
+      for (const auto& s : selected) {
+         if (std::none_of(workloads().begin(), workloads().end(), [&s](const auto& w) { return w.name == s; }))
+            throw std::runtime_error("unknown workload " + s);
+      }
+      if (config.samples == 0 || config.per_block == 0)
+         throw std::runtime_error("samples and per-block must not be 0");
+   } catch (const std::exception& e) {
+      std::cerr << e.what() << "\n" << options;
+      return 1;
+   }
+
+   fc::logger::get(DEFAULT_LOGGER).set_log_level(fc::log_level::warn);
+   std::cout << "action elapsed (us), first run and percentiles of the next " << config.samples << "\n"
+             << std::left << std::setw(12) << "runtime" << std::setw(20) << "action" << std::right
+             << std::setw(9) << "first" << std::setw(8) << "p50" << std::setw(8) << "p90" << std::setw(8) << "p99"
+             << std::setw(8) << "max" << "\n";
+   try {
+      for (auto runtime : selected_runtimes) {
+         const auto& runtime_name = std::find_if(runtime_names.begin(), runtime_names.end(),
+                                                 [runtime](const auto& r) { return r.first == runtime; })->second;
+         const uint64_t rss_before = resident_kib();
+         fc::temp_directory dir;
+         bench_chain chain(dir, runtime);
+         uint64_t n = 0;
+         for (const auto& w : workloads()) {
+            if (!selected.empty() && std::find(selected.begin(), selected.end(), w.name) == selected.end())
+               continue;
+            distribution d;
+            d.first_us = chain.run_one(w, n++);
+            d.elapsed_us.reserve(config.samples);
+            for (uint32_t i = 0; i < config.samples; ++i) {
+               d.elapsed_us.push_back(chain.run_one(w, n++));
+               if (n % config.per_block == 0)
+                  chain.produce_block();
+            }
+            std::sort(d.elapsed_us.begin(), d.elapsed_us.end());
+            report(runtime_name, w.name, d);
+         }
+         const uint64_t rss_after = resident_kib();
+         std::cout << std::left << std::setw(12) << runtime_name << "resident memory added: "
+                   << (rss_after > rss_before ? (rss_after - rss_before) / 1024 : 0) << " MiB\n";
+      }
+   } catch (const fc::exception& e) {
+      std::cerr << e.to_detail_string() << "\n";
+      return 1;
+   } catch (const std::exception& e) {
+      std::cerr << e.what() << "\n";
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,449 @@
+#include <eosio/testing/tester.hpp>
+#include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/apply_context.hpp>
+#include <eosio/chain/asset.hpp>
+#include <eosio/chain/authority.hpp>
+#include <eosio/chain/authority_checker.hpp>
+#include <eosio/chain/block.hpp>
+#include <eosio/chain/incremental_merkle.hpp>
+#include <eosio/chain/merkle.hpp>
+#include <eosio/chain/name.hpp>
+#include <eosio/chain/platform_timer.hpp>
+#include <eosio/chain/transaction_context.hpp>
+#include <eosio/chain/unapplied_transaction_queue.hpp>
+#include <eosio/chain/wasm_eosio_injection.hpp>
+
+#include <fc/crypto/ripemd160.hpp>
+#include <fc/crypto/sha1.hpp>
+#include <fc/crypto/sha256.hpp>
+#include <fc/crypto/sha512.hpp>
+#include <fc/io/json.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "IR/Module.h"
+#include "WASM/WASM.h"
+#include "Inline/Serialization.h"
+
+#include <contracts.hpp>
+
+using namespace eosio::chain;
+namespace bpo = boost::program_options;
+
+/**
+ * Measures the core data structures on the hot paths of a node: name and asset string conversion, fc::raw of blocks and
+ * transactions, merkle roots, authority checks, abi_serializer conversions, the db_*_i64 intrinsics, what the memory and
+ * hashing intrinsics call, the wasm injection of setcode and the unapplied transaction queue.  The inputs are generated from a fixed
+ * seed, so two builds measure the same work; each line reports the fastest and the median of the rounds.  Not run as a
+ * test; to compare two versions, run it built from each, --csv output is meant to be kept and diffed between releases.
+ */
+namespace {
+   struct benchmark {
+      std::string                name;
+      uint64_t                   ops; ///< operations per call of run
+      std::function<uint64_t()>  run; ///< returns a checksum of its results, which keeps the work from being optimized away
+   };
+
+   struct result {
+      double   min_ns    = 0;
+      double   median_ns = 0;
+      uint64_t checksum  = 0;
+   };
+
+   result measure( const benchmark& b, uint32_t rounds ) {
+      std::vector<double> ns;
+      result r;
+      for( uint32_t i = 0; i < rounds; ++i ) {
+         const auto start = std::chrono::steady_clock::now();
+         r.checksum += b.run();
+         const auto end = std::chrono::steady_clock::now();
+         ns.push_back( std::chrono::duration<double, std::nano>( end - start ).count() / b.ops );
+      }
+      std::sort( ns.begin(), ns.end() );
+      r.min_ns = ns.front();
+      r.median_ns = ns[ns.size() / 2];
+      r.checksum /= rounds;
+      return r;
+   }
+
+   std::string random_name( std::mt19937_64& gen ) {
+      static const char chars[] = "12345abcdefghijklmnopqrstuvwxyz";
+      std::string s( 1 + gen() % 12, 'a' );
+      for( auto& c : s ) c = chars[gen() % ( sizeof( chars ) - 1 )];
+      return s;
+   }
+
+   digest_type random_digest( std::mt19937_64& gen ) {
+      digest_type d;
+      for( auto& w : d._hash ) w = gen();
+      return d;
+   }
+
+   private_key_type key( const std::string& seed ) {
+      return private_key_type::regenerate<fc::ecc::private_key_shim>( fc::sha256::hash( seed ) );
+   }
+
+   /// an apply_context of an implicit transaction on a test chain, over one contract table of count rows
+   struct table_fixture {
+      eosio::testing::tester                 chain{ eosio::testing::setup_policy::none };
+      platform_timer                         timer;
+      signed_transaction                     trx;
+      std::unique_ptr<transaction_context>   trx_ctx;
+      std::unique_ptr<apply_context>         context;
+      uint32_t                               ordinal = 0;
+      std::vector<uint64_t>                  keys; ///< primary keys in random order
+      const name                             code{ "bench" };
+      const name                             table{ "rows" };
+
+      table_fixture( uint32_t count, std::mt19937_64& gen ) {
+         chain.produce_block();
+         auto& db = chain.control->mutable_db();
+         const auto& t = db.create<table_id_object>( [&]( table_id_object& t ) {
+            t.code = code;
+            t.scope = code;
+            t.table = table;
+            t.payer = code;
+            t.count = count;
+         } );
+         const char value[16] = {};
+         for( uint32_t i = 0; i < count; ++i ) {
+            const uint64_t key = gen();
+            db.create<key_value_object>( [&]( key_value_object& o ) {
+               o.t_id = t.id;
+               o.primary_key = key;
+               o.payer = code;
+               o.value.assign( value, sizeof( value ) );
+            } );
+            keys.push_back( key );
+         }
+
+         trx_ctx = std::make_unique<transaction_context>( *chain.control, trx, trx.id(), transaction_checktime_timer( timer ) );
+         trx_ctx->init_for_implicit_trx();
+         ordinal = trx_ctx->schedule_action( action( vector<permission_level>{}, code, name( "bench" ), bytes() ), code, false, 0, 0 );
+         context = std::make_unique<apply_context>( *chain.control, *trx_ctx, ordinal );
+      }
+   };
+
+   /// hashes @ref size bytes the way the crypto intrinsics do, in hashing_checktime_block_size pieces
+   template<typename Encoder>
+   uint64_t encode( const char* data, size_t size ) {
+      Encoder e;
+      const size_t bs = config::hashing_checktime_block_size;
+      while( size > bs ) {
+         e.write( data, bs );
+         data += bs;
+         size -= bs;
+      }
+      e.write( data, size );
+      return e.result().data()[0];
+   }
+
+   const char* token_abi = R"({
+      "version": "eosio::abi/1.1",
+      "structs": [
+         {"name": "transfer", "base": "", "fields": [
+            {"name": "from", "type": "name"},
+            {"name": "to", "type": "name"},
+            {"name": "quantity", "type": "asset"},
+            {"name": "memo", "type": "string"}
+         ]}
+      ],
+      "actions": [ {"name": "transfer", "type": "transfer", "ricardian_contract": ""} ]
+   })";
+
+   std::vector<benchmark> make_benchmarks( uint32_t count ) {
+      std::mt19937_64 gen(0);
+      std::vector<benchmark> benchmarks;
+
+      // name
+      auto name_strings = std::make_shared<std::vector<std::string>>();
+      auto names = std::make_shared<std::vector<name>>();
+      for( uint32_t i = 0; i < count; ++i ) {
+         name_strings->push_back( random_name( gen ) );
+         names->emplace_back( name_strings->back() );
+      }
+      benchmarks.push_back( { "name.from_string", count, [name_strings]() {
+         uint64_t sum = 0;
+         for( const auto& s : *name_strings ) sum += name( s ).to_uint64_t();
+         return sum;
+      } } );
+      benchmarks.push_back( { "name.to_string", count, [names]() {
+         uint64_t sum = 0;
+         for( const auto& n : *names ) sum += n.to_string().size();
+         return sum;
+      } } );
+
+      // asset
+      auto asset_strings = std::make_shared<std::vector<std::string>>();
+      auto assets = std::make_shared<std::vector<asset>>();
+      for( uint32_t i = 0; i < count; ++i ) {
+         asset a( static_cast<int64_t>( gen() % 10'000'000'000 ), symbol( 4, "SYS" ) );
+         asset_strings->push_back( a.to_string() );
+         assets->push_back( a );
+      }
+      benchmarks.push_back( { "asset.from_string", count, [asset_strings]() {
+         uint64_t sum = 0;
+         for( const auto& s : *asset_strings ) sum += asset::from_string( s ).get_amount();
+         return sum;
+      } } );
+      benchmarks.push_back( { "asset.to_string", count, [assets]() {
+         uint64_t sum = 0;
+         for( const auto& a : *assets ) sum += a.to_string().size();
+         return sum;
+      } } );
+
+      // fc::raw of transactions and blocks, transfers signed by one key from fixed seeds
+      const chain_id_type chain_id = fc::sha256::hash( std::string( "chain_benchmarks" ) );
+      const uint32_t trxs_per_block = std::max<uint32_t>( 1, std::min<uint32_t>( count, 1000 ) );
+      auto block = std::make_shared<signed_block>();
+      block->producer = name( "producer" );
+      for( uint32_t i = 0; i < trxs_per_block; ++i ) {
+         signed_transaction trx;
+         trx.expiration = fc::time_point_sec( 1'600'000'000 + i );
+         trx.ref_block_num = i;
+         trx.ref_block_prefix = static_cast<uint32_t>( gen() );
+         bytes data( 40 );
+         for( auto& c : data ) c = static_cast<char>( gen() );
+         trx.actions.emplace_back( vector<permission_level>{ { (*names)[i % count], config::active_name } },
+                                   name( "eosio.token" ), name( "transfer" ), std::move( data ) );
+         trx.sign( key( std::to_string( i ) ), chain_id );
+         block->transactions.emplace_back( packed_transaction( std::move( trx ) ) );
+      }
+      auto block_bytes = std::make_shared<std::vector<char>>( fc::raw::pack( *block ) );
+      auto trx_bytes = std::make_shared<std::vector<char>>( fc::raw::pack( block->transactions.front().trx.get<packed_transaction>() ) );
+      benchmarks.push_back( { "packed_transaction.pack", 1, [block]() {
+         return uint64_t( fc::raw::pack( block->transactions.front().trx.get<packed_transaction>() ).size() );
+      } } );
+      benchmarks.push_back( { "packed_transaction.unpack", 1, [trx_bytes]() {
+         return uint64_t( fc::raw::unpack<packed_transaction>( *trx_bytes ).get_transaction().actions.size() );
+      } } );
+      benchmarks.push_back( { "signed_block.pack", 1, [block]() {
+         return uint64_t( fc::raw::pack( *block ).size() );
+      } } );
+      benchmarks.push_back( { "signed_block.unpack", 1, [block_bytes]() {
+         return uint64_t( fc::raw::unpack<signed_block>( *block_bytes ).transactions.size() );
+      } } );
+
+      // the libc routines behind the memcpy, memmove, memset and memcmp intrinsics, and the fc encoders behind the
+      // hashing intrinsics, on a 64 KiB buffer
+      constexpr size_t mem_size = 64 * 1024;
+      auto mem_src = std::make_shared<std::vector<char>>( mem_size );
+      for( auto& c : *mem_src ) c = static_cast<char>( gen() );
+      auto mem_dst = std::make_shared<std::vector<char>>( *mem_src );
+      auto mem_equal = std::make_shared<const std::vector<char>>( *mem_src );
+      benchmarks.push_back( { "memcpy.64KiB", 1, [mem_src, mem_dst]() {
+         ::memcpy( mem_dst->data(), mem_src->data(), mem_size );
+         return uint64_t( (*mem_dst)[mem_size / 2] );
+      } } );
+      benchmarks.push_back( { "memmove.64KiB", 1, [mem_dst]() {
+         ::memmove( mem_dst->data() + 1, mem_dst->data(), mem_size - 1 );
+         return uint64_t( (*mem_dst)[mem_size / 2] );
+      } } );
+      benchmarks.push_back( { "memset.64KiB", 1, [mem_dst]() {
+         ::memset( mem_dst->data(), 0x5a, mem_size );
+         return uint64_t( (*mem_dst)[mem_size / 2] );
+      } } );
+      benchmarks.push_back( { "memcmp.64KiB", 1, [mem_src, mem_equal]() {
+         // equal buffers, so every byte is compared
+         return uint64_t( ::memcmp( mem_equal->data(), mem_src->data(), mem_size ) == 0 );
+      } } );
+      benchmarks.push_back( { "sha1.64KiB", 1, [mem_src]() {
+         return encode<fc::sha1::encoder>( mem_src->data(), mem_size );
+      } } );
+      benchmarks.push_back( { "sha256.64KiB", 1, [mem_src]() {
+         return encode<fc::sha256::encoder>( mem_src->data(), mem_size );
+      } } );
+      benchmarks.push_back( { "sha512.64KiB", 1, [mem_src]() {
+         return encode<fc::sha512::encoder>( mem_src->data(), mem_size );
+      } } );
+      benchmarks.push_back( { "ripemd160.64KiB", 1, [mem_src]() {
+         return encode<fc::ripemd160::encoder>( mem_src->data(), mem_size );
+      } } );
+
+      // merkle
+      auto digests = std::make_shared<vector<digest_type>>();
+      for( uint32_t i = 0; i < count; ++i ) digests->push_back( random_digest( gen ) );
+      benchmarks.push_back( { "merkle", count, [digests]() {
+         return merkle( *digests )._hash[0];
+      } } );
+      benchmarks.push_back( { "incremental_merkle.append", count, [digests]() {
+         incremental_merkle m;
+         for( const auto& d : *digests ) m.append( d );
+         return m.get_root()._hash[0];
+      } } );
+
+      // authority_checker, a 2 of 3 key authority given the 2 keys that satisfy it
+      auto keys = std::make_shared<vector<public_key_type>>();
+      for( const char* s : { "a", "b", "c" } ) keys->push_back( key( s ).get_public_key() );
+      auto auth = std::make_shared<authority>( 2, vector<key_weight>{ { (*keys)[0], 1 }, { (*keys)[1], 1 }, { (*keys)[2], 1 } } );
+      auto provided = std::make_shared<flat_set<public_key_type>>( flat_set<public_key_type>{ (*keys)[0], (*keys)[2] } );
+      benchmarks.push_back( { "authority_checker.satisfied", count, [auth, provided, count]() {
+         auto no_authority = []( const permission_level& ) -> authority { abort(); };
+         uint64_t sum = 0;
+         for( uint32_t i = 0; i < count; ++i ) {
+            auto checker = make_auth_checker( no_authority, 2, *provided );
+            sum += checker.satisfied( *auth );
+         }
+         return sum;
+      } } );
+
+      // abi_serializer, the token transfer action
+      const auto max_time = fc::microseconds::maximum();
+      auto abis = std::make_shared<abi_serializer>( fc::json::from_string( token_abi ).as<abi_def>(), max_time );
+      auto transfers = std::make_shared<std::vector<fc::variant>>();
+      auto transfer_bytes = std::make_shared<std::vector<bytes>>();
+      for( uint32_t i = 0; i < count; ++i ) {
+         transfers->push_back( fc::mutable_variant_object()
+                                  ( "from", (*names)[i] )( "to", (*names)[( i + 1 ) % count] )
+                                  ( "quantity", (*assets)[i] )( "memo", (*name_strings)[i] ) );
+         transfer_bytes->push_back( abis->variant_to_binary( "transfer", transfers->back(), max_time ) );
+      }
+      benchmarks.push_back( { "abi_serializer.variant_to_binary", count, [abis, transfers, max_time]() {
+         uint64_t sum = 0;
+         for( const auto& t : *transfers ) sum += abis->variant_to_binary( "transfer", t, max_time ).size();
+         return sum;
+      } } );
+      benchmarks.push_back( { "abi_serializer.binary_to_variant", count, [abis, transfer_bytes, max_time]() {
+         uint64_t sum = 0;
+         for( const auto& b : *transfer_bytes ) sum += abis->binary_to_variant( "transfer", b, max_time ).get_object().size();
+         return sum;
+      } } );
+
+      // unapplied_transaction_queue, a backlog of 100 * count transactions re-queued by an abort and then cleared by the
+      // blocks applying them
+      const uint32_t backlog = 100 * count;
+      auto queued_trxs = std::make_shared<std::vector<transaction_metadata_ptr>>();
+      auto applied_blocks = std::make_shared<std::vector<block_state_ptr>>();
+      for( uint32_t i = 0; i < backlog; ++i ) {
+         signed_transaction trx;
+         trx.expiration = fc::time_point_sec( 1'600'000'000 + i % 3600 );
+         trx.actions.emplace_back( vector<permission_level>{ { config::system_account_name, config::active_name } },
+                                   config::system_account_name, name( "nonce" ), fc::raw::pack( uint64_t( i ) ) );
+         queued_trxs->push_back( transaction_metadata::create_no_recover_keys( packed_transaction( std::move( trx ) ),
+                                                                              transaction_metadata::trx_type::input ) );
+         if( i % trxs_per_block == 0 ) {
+            applied_blocks->push_back( std::make_shared<block_state>() );
+            applied_blocks->back()->block = std::make_shared<signed_block>();
+         }
+         applied_blocks->back()->block->transactions.emplace_back( *queued_trxs->back()->packed_trx() );
+      }
+      benchmarks.push_back( { "unapplied_queue.add_aborted", backlog, [queued_trxs]() {
+         unapplied_transaction_queue queue;
+         queue.add_aborted( *queued_trxs );
+         return uint64_t( queue.size() );
+      } } );
+      benchmarks.push_back( { "unapplied_queue.requeue_and_clear", backlog, [queued_trxs, applied_blocks]() {
+         unapplied_transaction_queue queue;
+         queue.add_aborted( *queued_trxs );
+         for( const auto& bs : *applied_blocks ) queue.clear_applied( bs );
+         return uint64_t( queue.size() );
+      } } );
+
+      // wasm_binary_injection of the system contract, on a freshly decoded module each call as setcode does; the
+      // decode alone is measured too, so the injection is the difference of the two
+      auto system_wasm = std::make_shared<std::vector<uint8_t>>( eosio::testing::contracts::eosio_system_wasm() );
+      benchmarks.push_back( { "wasm.decode", 1, [system_wasm]() {
+         IR::Module module;
+         Serialization::MemoryInputStream stream( system_wasm->data(), system_wasm->size() );
+         WASM::serialize( stream, module );
+         return uint64_t( module.functions.defs.size() );
+      } } );
+      benchmarks.push_back( { "wasm_binary_injection.inject", 1, [system_wasm]() {
+         IR::Module module;
+         Serialization::MemoryInputStream stream( system_wasm->data(), system_wasm->size() );
+         WASM::serialize( stream, module );
+         wasm_injections::wasm_binary_injection<false> injector( module );
+         injector.inject();
+         uint64_t sum = 0;
+         for( const IR::FunctionDef& f : module.functions.defs ) sum += f.code.size();
+         return sum;
+      } } );
+
+      // db_find_i64 and db_next_i64, each round starting from the empty iterator cache of a new action
+      auto tables = std::make_shared<table_fixture>( count, gen );
+      benchmarks.push_back( { "apply_context.db_find_i64", count, [tables]() {
+         auto& c = *tables->context;
+         c.reset( tables->ordinal, 0 );
+         uint64_t sum = 0;
+         for( uint64_t k : tables->keys ) sum += c.db_find_i64( tables->code, tables->code, tables->table, k );
+         return sum;
+      } } );
+      benchmarks.push_back( { "apply_context.db_next_i64", count, [tables]() {
+         auto& c = *tables->context;
+         c.reset( tables->ordinal, 0 );
+         uint64_t sum = 0;
+         uint64_t primary = 0;
+         int itr = c.db_lowerbound_i64( tables->code, tables->code, tables->table, 0 );
+         while( itr >= 0 ) {
+            sum += primary;
+            itr = c.db_next_i64( itr, primary );
+         }
+         return sum;
+      } } );
+
+      return benchmarks;
+   }
+}
+
+int main( int argc, char** argv ) {
+   uint32_t count = 0;
+   uint32_t rounds = 0;
+   std::string filter;
+   bpo::options_description options("chain_benchmarks");
+   options.add_options()
+      ("help,h", "print this help")
+      ("count", bpo::value<uint32_t>(&count)->default_value(1000), "number of generated inputs per benchmark, the transactions of the block are capped at 1000 and the unapplied queue backlog is 100 times this")
+      ("rounds", bpo::value<uint32_t>(&rounds)->default_value(20), "measurements per benchmark")
+      ("filter", bpo::value<std::string>(&filter), "only run the benchmarks whose name contains this")
+      ("csv", "print name,min_ns,median_ns,checksum lines instead of a table");
+   bpo::variables_map vm;
+   try {
+      bpo::store( bpo::parse_command_line( argc, argv, options ), vm );
+      bpo::notify( vm );
+   } catch( const std::exception& e ) {
+      std::cerr << e.what() << "\n" << options;
+      return 1;
+   }
+   if( vm.count("help") ) {
+      std::cout << options;
+      return 0;
+   }
+   if( count < 2 || rounds == 0 ) {
+      std::cerr << "count must be at least 2, rounds not 0\n" << options;
+      return 1;
+   }
+   const bool csv = vm.count("csv");
+
+   try {
+      const auto benchmarks = make_benchmarks( count );
+      if( csv ) {
+         std::cout << "name,min_ns,median_ns,checksum\n";
+      } else {
+         std::cout << std::left << std::setw(36) << "benchmark (ns/op)" << std::right
+                   << std::setw(14) << "min" << std::setw(14) << "median" << "\n";
+      }
+      for( const auto& b : benchmarks ) {
+         if( !filter.empty() && b.name.find( filter ) == std::string::npos ) continue;
+         const auto r = measure( b, rounds );
+         if( csv ) {
+            std::cout << b.name << ',' << std::fixed << std::setprecision(2) << r.min_ns << ',' << r.median_ns << ',' << r.checksum << "\n";
+         } else {
+            std::cout << std::left << std::setw(36) << b.name << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(14) << r.min_ns << std::setw(14) << r.median_ns << "\n";
+         }
+      }
+   } catch( const fc::exception& e ) {
+      std::cerr << e.to_detail_string() << "\n";
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,61 @@
+#include <eosio/chain/block_compression.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace eosio::chain;
+
+namespace {
+   bytes make_payload( size_t size ) {
+      bytes b( size );
+      for( size_t i = 0; i < size; ++i ) b[i] = static_cast<char>( (i / 7) % 13 );
+      return b;
+   }
+
+   std::vector<block_codec> built_codecs() {
+      std::vector<block_codec> codecs;
+      for( auto c : { block_codec::zlib, block_codec::zstd, block_codec::lz4 } ) {
+         if( block_codec_supported( c ) ) codecs.push_back( c );
+      }
+      return codecs;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE(block_compression_tests)
+
+BOOST_AUTO_TEST_CASE(round_trip) {
+   const auto payload = make_payload( 100'000 );
+   for( auto codec : built_codecs() ) {
+      BOOST_TEST_CONTEXT( "codec " << static_cast<uint32_t>( codec ) ) {
+         const auto compressed = compress_block( codec, payload.data(), payload.size() );
+         BOOST_REQUIRE_LT( compressed.size(), payload.size() );
+         BOOST_REQUIRE( decompress_block( codec, compressed, payload.size() ) == payload );
+      }
+   }
+}
+
+BOOST_AUTO_TEST_CASE(decompression_limit) {
+   const auto payload = make_payload( 100'000 );
+   for( auto codec : built_codecs() ) {
+      BOOST_TEST_CONTEXT( "codec " << static_cast<uint32_t>( codec ) ) {
+         const auto compressed = compress_block( codec, payload.data(), payload.size() );
+         BOOST_REQUIRE_THROW( decompress_block( codec, compressed, payload.size() - 1 ), fc::exception );
+      }
+   }
+}
+
+BOOST_AUTO_TEST_CASE(codec_names) {
+   BOOST_REQUIRE( parse_block_codec( "zlib" ) == block_codec::zlib );
+   BOOST_REQUIRE_THROW( parse_block_codec( "brotli" ), plugin_config_exception );
+   for( auto name : { "zstd", "lz4" } ) {
+      const auto codec = std::string( name ) == "zstd" ? block_codec::zstd : block_codec::lz4;
+      if( block_codec_supported( codec ) ) {
+         BOOST_REQUIRE( parse_block_codec( name ) == codec );
+      } else {
+         BOOST_REQUIRE_THROW( parse_block_codec( name ), plugin_config_exception );
+      }
+   }
+   BOOST_REQUIRE( !block_codec_supported( static_cast<block_codec>( 9 ) ) );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
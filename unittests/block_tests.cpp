@@ -53,6 +53,30 @@ BOOST_AUTO_TEST_CASE(block_with_invalid_tx_test)
 
 }
 
+BOOST_AUTO_TEST_CASE(block_with_given_id_test)
+{
+   tester main;
+   auto b = main.produce_block();
+   auto b2 = main.produce_block();
+
+   tester validator;
+   validator.control->abort_block();
+   auto bsf = validator.control->create_block_state_future( b->id(), b );
+   validator.control->push_block( bsf, forked_branch_callback{}, trx_meta_cache_lookup{} );
+   BOOST_CHECK_EQUAL( validator.control->head_block_id(), b->id() );
+
+   // an id that is not the one of the block is rejected instead of entering the fork database under it
+   block_id_type wrong_id = b2->id();
+   wrong_id._hash[3] ^= 1;
+   validator.control->abort_block();
+   auto wrong = validator.control->create_block_state_future( wrong_id, b2 );
+   BOOST_REQUIRE_EXCEPTION( validator.control->push_block( wrong, forked_branch_callback{}, trx_meta_cache_lookup{} ), fc::exception,
+   [] (const fc::exception &e)->bool {
+      return e.code() == block_validate_exception::code_value;
+   });
+   BOOST_CHECK_EQUAL( validator.control->head_block_id(), b->id() );
+}
+
 std::pair<signed_block_ptr, signed_block_ptr> corrupt_trx_in_block(validating_tester& main, account_name act_name) {
    // First we create a valid block with valid transaction
    main.create_account(act_name);
@@ -193,6 +217,42 @@ BOOST_AUTO_TEST_CASE(broadcasted_block_test)
   BOOST_CHECK(std::equal(bcasted_blk_by_prod_node_packed.begin(), bcasted_blk_by_prod_node_packed.end(), bcasted_blk_by_recv_node_packed.begin()));
 }
 
+/**
+ * Ensure serialized blocks served from the block log and from reversible state match packing the block
+ */
+BOOST_AUTO_TEST_CASE(fetch_serialized_block_test) { try {
+   tester chain;
+   chain.create_account( N(alice) );
+   chain.produce_blocks( 10 );
+
+   const auto lib = chain.control->last_irreversible_block_num();
+   const auto head = chain.control->head_block_num();
+   BOOST_REQUIRE( lib > 1 );
+   for( uint32_t n = 1; n <= head; ++n ) {
+      auto packed = chain.control->fetch_serialized_block_by_number( n );
+      auto expected = fc::raw::pack( *chain.control->fetch_block_by_number( n ) );
+      BOOST_CHECK_MESSAGE( packed == expected, "block " << n );
+   }
+   BOOST_CHECK( chain.control->fetch_serialized_block_by_number( head + 1 ).empty() );
+
+   // the head block was packed once when committed and every later caller shares those bytes
+   const auto bsp = chain.control->head_block_state();
+   BOOST_CHECK( bsp->packed_block() == bsp->packed_block() );
+   BOOST_CHECK( *bsp->packed_block() == fc::raw::pack( *bsp->block ) );
+} FC_LOG_AND_RETHROW() }
+
+/**
+ * The transactions of a produced block are packed while it is signed, the bytes must match packing the signed block
+ */
+BOOST_AUTO_TEST_CASE(produced_block_packed_while_signing_test) { try {
+   tester chain;
+   chain.create_accounts( { N(alice), N(bob), N(carol) }, false, false );
+   const auto b = chain.produce_block();
+   BOOST_REQUIRE_EQUAL( b->transactions.size(), 3u );
+   BOOST_CHECK( *chain.control->head_block_state()->packed_block() == fc::raw::pack( *b ) );
+   BOOST_CHECK( b->transaction_mroot != checksum256_type() );
+} FC_LOG_AND_RETHROW() }
+
 /**
  * Verify abort block returns applied transactions in block
  */
@@ -0,0 +1,104 @@
+#include <compiler_builtins.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include <fc/exception/exception.hpp>
+
+#include <random>
+#include <vector>
+
+using namespace eosio;
+
+namespace {
+   // every sign and exponent of a double, each with some mantissas, NaNs and infinities included
+   std::vector<uint64_t> f64_inputs() {
+      std::vector<uint64_t> result;
+      const uint64_t mantissas[] = { 0, 1, 0x7FFFFFFFFFFFFull, 0x8000000000000ull, 0xFFFFFFFFFFFFFull };
+      for( uint64_t sign = 0; sign < 2; ++sign )
+         for( uint64_t e = 0; e <= 0x7FF; ++e )
+            for( auto m : mantissas )
+               result.push_back( sign << 63 | e << 52 | m );
+      return result;
+   }
+
+   std::vector<uint32_t> f32_inputs() {
+      std::vector<uint32_t> result;
+      const uint32_t mantissas[] = { 0, 1, 0x3FFFFF, 0x400000, 0x7FFFFF };
+      for( uint32_t sign = 0; sign < 2; ++sign )
+         for( uint32_t e = 0; e <= 0xFF; ++e )
+            for( auto m : mantissas )
+               result.push_back( sign << 31 | e << 23 | m );
+      return result;
+   }
+
+   // values around every power of two, positive and negative
+   std::vector<unsigned __int128> int128_inputs() {
+      std::vector<unsigned __int128> result;
+      for( uint32_t bit = 0; bit < 128; ++bit ) {
+         const auto p = static_cast<unsigned __int128>(1) << bit;
+         for( auto v : { p - 1, p, p + 1 } ) {
+            result.push_back( v );
+            result.push_back( -v );
+         }
+      }
+      return result;
+   }
+
+   bool same( double a, double b ) {
+      return memcmp( &a, &b, sizeof(a) ) == 0;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE(compiler_builtins_tests)
+
+BOOST_AUTO_TEST_CASE(float_to_int128) { try {
+   auto check_f64 = []( uint64_t a ) {
+      BOOST_REQUIRE( builtins::fixdfti( a ) == ___fixdfti( a ) );
+      BOOST_REQUIRE( builtins::fixunsdfti( a ) == ___fixunsdfti( a ) );
+   };
+   auto check_f32 = []( uint32_t a ) {
+      BOOST_REQUIRE( builtins::fixsfti( a ) == ___fixsfti( a ) );
+      BOOST_REQUIRE( builtins::fixunssfti( a ) == ___fixunssfti( a ) );
+   };
+   for( auto a : f64_inputs() )
+      check_f64( a );
+   for( auto a : f32_inputs() )
+      check_f32( a );
+
+   std::mt19937_64 gen(0);
+   for( int i = 0; i < 1'000'000; ++i ) {
+      check_f64( gen() );
+      check_f32( static_cast<uint32_t>( gen() ) );
+   }
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(int128_to_float) { try {
+   auto check = []( unsigned __int128 a ) {
+      BOOST_REQUIRE( same( builtins::floattidf( static_cast<__int128>( a ) ), ___floattidf( static_cast<__int128>( a ) ) ) );
+      BOOST_REQUIRE( same( builtins::floatuntidf( a ), ___floatuntidf( a ) ) );
+   };
+   for( auto a : int128_inputs() )
+      check( a );
+
+   std::mt19937_64 gen(1);
+   for( int i = 0; i < 1'000'000; ++i ) {
+      const auto v = builtins::make_uint128( gen(), gen() );
+      // shifted so that every magnitude is covered
+      check( v >> ( gen() % 128 ) );
+   }
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(shifts) { try {
+   const auto v = builtins::make_uint128( 0x0123456789ABCDEFull, 0xFEDCBA9876543210ull );
+   BOOST_CHECK( builtins::shl( v, 0 ) == v );
+   BOOST_CHECK( builtins::shl( v, 64 ) == builtins::make_uint128( 0, 0x0123456789ABCDEFull ) );
+   BOOST_CHECK( builtins::lshr( v, 64 ) == builtins::make_uint128( 0xFEDCBA9876543210ull, 0 ) );
+   BOOST_CHECK( builtins::shl( v, 127 ) == builtins::make_uint128( 0, 0x8000000000000000ull ) );
+   BOOST_CHECK( builtins::lshr( v, 127 ) == 1 );
+   BOOST_CHECK( builtins::shl( v, 128 ) == 0 );
+   BOOST_CHECK( builtins::lshr( v, 128 ) == 0 );
+   BOOST_CHECK( builtins::shl( v, 0xFFFFFFFF ) == 0 );
+   BOOST_CHECK( builtins::lshr( v, 0xFFFFFFFF ) == 0 );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,152 @@
+#include <eosio/chain/hardware_float.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include <fc/exception/exception.hpp>
+
+#include <random>
+#include <vector>
+
+using namespace eosio::chain;
+
+namespace {
+   float32_t f32( uint32_t v ) { float32_t f; f.v = v; return f; }
+   float64_t f64( uint64_t v ) { float64_t f; f.v = v; return f; }
+
+   // every sign and exponent, each with mantissas that exercise rounding, plus NaNs and infinities
+   std::vector<float32_t> f32_operands() {
+      std::vector<float32_t> result;
+      const uint32_t mantissas[] = { 0, 1, 2, 0x3FFFFF, 0x400000, 0x400001, 0x555555, 0x7FFFFE, 0x7FFFFF };
+      for( uint32_t sign = 0; sign < 2; ++sign )
+         for( uint32_t exponent = 0; exponent <= 0xFF; ++exponent )
+            for( auto m : mantissas )
+               result.push_back( f32( sign << 31 | exponent << 23 | m ) );
+      return result;
+   }
+
+   std::vector<float64_t> f64_operands() {
+      std::vector<float64_t> result;
+      const uint64_t mantissas[] = { 0, 1, 0x7FFFFFFFFFFFFull, 0x8000000000000ull, 0x8000000000001ull, 0xFFFFFFFFFFFFFull };
+      const uint64_t exponents[] = { 0, 1, 2, 0x36A, 0x380, 0x3FE, 0x3FF, 0x400, 0x47F, 0x7FD, 0x7FE, 0x7FF };
+      for( uint64_t sign = 0; sign < 2; ++sign )
+         for( auto e : exponents )
+            for( auto m : mantissas )
+               result.push_back( f64( sign << 63 | e << 52 | m ) );
+      return result;
+   }
+
+   template<typename F, typename S, typename H>
+   void check_binary( const std::vector<F>& operands, S soft, H hard ) {
+      for( const auto& a : operands ) {
+         for( const auto& b : operands ) {
+            const auto expected = soft( a, b );
+            const auto actual = hard( a, b );
+            if( expected.v != actual.v )
+               BOOST_FAIL( "operands " << std::hex << a.v << " and " << b.v << " give " << actual.v << ", softfloat " << expected.v );
+         }
+      }
+   }
+
+   template<typename F, typename S, typename H>
+   void check_random( std::mt19937_64& gen, S soft, H hard ) {
+      for( int i = 0; i < 1'000'000; ++i ) {
+         const F a{ static_cast<decltype(F::v)>( gen() ) };
+         const F b{ static_cast<decltype(F::v)>( gen() ) };
+         const auto expected = soft( a, b );
+         const auto actual = hard( a, b );
+         if( expected.v != actual.v )
+            BOOST_FAIL( "operands " << std::hex << a.v << " and " << b.v << " give " << actual.v << ", softfloat " << expected.v );
+      }
+   }
+}
+
+BOOST_AUTO_TEST_SUITE(hardware_float_tests)
+
+BOOST_AUTO_TEST_CASE(default_nan) {
+   const float32_t inf32 = f32( 0x7F800000 );
+   const float64_t inf64 = f64( 0x7FF0000000000000ull );
+   // the hardware path is only bit identical if softfloat was built for the 8086-SSE default NaN
+   BOOST_CHECK_EQUAL( ::f32_sub( inf32, inf32 ).v, 0xFFC00000u );
+   BOOST_CHECK_EQUAL( ::f64_sub( inf64, inf64 ).v, 0xFFF8000000000000ull );
+   BOOST_CHECK_EQUAL( hardware_float::f32_sub( inf32, inf32 ).v, 0xFFC00000u );
+   BOOST_CHECK_EQUAL( hardware_float::f64_sub( inf64, inf64 ).v, 0xFFF8000000000000ull );
+   BOOST_CHECK_EQUAL( hardware_float::f32_sqrt( f32( 0xBF800000 ) ).v, 0xFFC00000u );
+   BOOST_CHECK_EQUAL( hardware_float::f64_sqrt( f64( 0xBFF0000000000000ull ) ).v, 0xFFF8000000000000ull );
+   BOOST_CHECK_EQUAL( hardware_float::f32_div( f32( 0 ), f32( 0 ) ).v, 0xFFC00000u );
+   BOOST_CHECK_EQUAL( hardware_float::f64_mul( f64( 0 ), inf64 ).v, 0xFFF8000000000000ull );
+}
+
+BOOST_AUTO_TEST_CASE(f32_binops) { try {
+   const auto operands = f32_operands();
+   check_binary( operands, ::f32_add, hardware_float::f32_add );
+   check_binary( operands, ::f32_sub, hardware_float::f32_sub );
+   check_binary( operands, ::f32_mul, hardware_float::f32_mul );
+   check_binary( operands, ::f32_div, hardware_float::f32_div );
+
+   std::mt19937_64 gen(0);
+   check_random<float32_t>( gen, ::f32_add, hardware_float::f32_add );
+   check_random<float32_t>( gen, ::f32_sub, hardware_float::f32_sub );
+   check_random<float32_t>( gen, ::f32_mul, hardware_float::f32_mul );
+   check_random<float32_t>( gen, ::f32_div, hardware_float::f32_div );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(f64_binops) { try {
+   const auto operands = f64_operands();
+   check_binary( operands, ::f64_add, hardware_float::f64_add );
+   check_binary( operands, ::f64_sub, hardware_float::f64_sub );
+   check_binary( operands, ::f64_mul, hardware_float::f64_mul );
+   check_binary( operands, ::f64_div, hardware_float::f64_div );
+
+   std::mt19937_64 gen(1);
+   check_random<float64_t>( gen, ::f64_add, hardware_float::f64_add );
+   check_random<float64_t>( gen, ::f64_sub, hardware_float::f64_sub );
+   check_random<float64_t>( gen, ::f64_mul, hardware_float::f64_mul );
+   check_random<float64_t>( gen, ::f64_div, hardware_float::f64_div );
+} FC_LOG_AND_RETHROW() }
+
+// the unary operations on 32 bit inputs are swept over a quarter of a million points spread over the whole range
+BOOST_AUTO_TEST_CASE(unary_ops) { try {
+   for( uint64_t v = 0; v <= 0xFFFFFFFFull; v += 16411 ) {
+      const auto a = f32( static_cast<uint32_t>( v ) );
+      BOOST_REQUIRE_EQUAL( hardware_float::f32_sqrt( a ).v, ::f32_sqrt( a ).v );
+      BOOST_REQUIRE_EQUAL( hardware_float::f32_to_f64( a ).v, ::f32_to_f64( a ).v );
+      BOOST_REQUIRE_EQUAL( hardware_float::i32_to_f32( static_cast<int32_t>( v ) ).v, ::i32_to_f32( static_cast<int32_t>( v ) ).v );
+      BOOST_REQUIRE_EQUAL( hardware_float::i32_to_f64( static_cast<int32_t>( v ) ).v, ::i32_to_f64( static_cast<int32_t>( v ) ).v );
+      BOOST_REQUIRE_EQUAL( hardware_float::ui32_to_f32( static_cast<uint32_t>( v ) ).v, ::ui32_to_f32( static_cast<uint32_t>( v ) ).v );
+      BOOST_REQUIRE_EQUAL( hardware_float::ui32_to_f64( static_cast<uint32_t>( v ) ).v, ::ui32_to_f64( static_cast<uint32_t>( v ) ).v );
+   }
+   for( const auto& a : f64_operands() ) {
+      BOOST_REQUIRE_EQUAL( hardware_float::f64_sqrt( a ).v, ::f64_sqrt( a ).v );
+      BOOST_REQUIRE_EQUAL( hardware_float::f64_to_f32( a ).v, ::f64_to_f32( a ).v );
+   }
+   std::mt19937_64 gen(2);
+   for( int i = 0; i < 1'000'000; ++i ) {
+      const uint64_t v = gen();
+      const auto a = f64( v );
+      BOOST_REQUIRE_EQUAL( hardware_float::f64_sqrt( a ).v, ::f64_sqrt( a ).v );
+      BOOST_REQUIRE_EQUAL( hardware_float::f64_to_f32( a ).v, ::f64_to_f32( a ).v );
+      // shifted so that small magnitudes, which need no rounding, are covered too
+      const auto n = static_cast<int64_t>( v ) >> ( v % 64 );
+      BOOST_REQUIRE_EQUAL( hardware_float::i64_to_f32( n ).v, ::i64_to_f32( n ).v );
+      BOOST_REQUIRE_EQUAL( hardware_float::i64_to_f64( n ).v, ::i64_to_f64( n ).v );
+   }
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(non_default_environment) { try {
+   if( !hardware_float::supported )
+      return;
+#if EOSIO_HARDWARE_FLOAT_SUPPORTED
+   const auto csr = _mm_getcsr();
+   // round toward zero, the hardware would round 1 + 2^-24 * 1.5 differently than softfloat
+   _mm_setcsr( csr | 0x6000 );
+   BOOST_CHECK( !hardware_float::default_environment() );
+   const auto a = f32( 0x3F800000 ), b = f32( 0x33C00000 );
+   const auto sum = hardware_float::f32_add( a, b );
+   _mm_setcsr( csr );
+   BOOST_CHECK( hardware_float::default_environment() );
+   BOOST_CHECK_EQUAL( sum.v, ::f32_add( a, b ).v );
+   BOOST_CHECK_EQUAL( sum.v, 0x3F800001u );
+#endif
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -3,7 +3,13 @@
 #include <eosio/chain/authority_checker.hpp>
 #include <eosio/chain/chain_config.hpp>
 #include <eosio/chain/types.hpp>
+#include <eosio/chain/merkle.hpp>
 #include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/table_access_set.hpp>
+#include <eosio/chain/recovered_key_cache.hpp>
+#include <eosio/chain/state_checkpoint_log.hpp>
+#include <eosio/chain/log_sync.hpp>
+#include <eosio/chain/transaction_dedup_filter.hpp>
 #include <eosio/testing/tester.hpp>
 
 #include <fc/io/json.hpp>
@@ -13,6 +19,9 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <fstream>
+#include <pthread.h>
+
 #ifdef NON_VALIDATING_TEST
 #define TESTER tester
 #else
@@ -832,6 +841,10 @@ BOOST_AUTO_TEST_CASE(transaction_metadata_test) { try {
       BOOST_CHECK_EQUAL(trx.id(), ptrx->id());
       BOOST_CHECK_EQUAL(trx.id(), ptrx2->id());
 
+      // retained memory includes the unpacked transaction, so it is more than both serialized forms
+      BOOST_CHECK_GT(pkt.get_estimated_size(), pkt.get_unprunable_size() + pkt.get_prunable_size() + sizeof(pkt));
+      BOOST_CHECK_GT(pkt2.get_estimated_size(), pkt2.get_unprunable_size() + pkt2.get_prunable_size() + sizeof(pkt2));
+
       named_thread_pool thread_pool( "misc", 5 );
 
       auto fut = transaction_metadata::start_recover_keys( ptrx, thread_pool.get_executor(), test.control->get_chain_id(), fc::microseconds::maximum() );
@@ -845,6 +858,7 @@ BOOST_AUTO_TEST_CASE(transaction_metadata_test) { try {
       const auto& keys = mtrx->recovered_keys();
       BOOST_CHECK_EQUAL(1u, keys.size());
       BOOST_CHECK_EQUAL(public_key, *keys.begin());
+      BOOST_CHECK_GE(mtrx->get_estimated_size(), ptrx->get_estimated_size() + sizeof(public_key_type));
 
       // again, can be called multiple times, current implementation it is just an attribute of transaction_metadata
       const auto& keys2 = mtrx->recovered_keys();
@@ -860,6 +874,83 @@ BOOST_AUTO_TEST_CASE(transaction_metadata_test) { try {
 
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE(prioritized_task_queue_test) { try {
+   named_thread_pool thread_pool( "misc", 1 );
+   prioritized_task_queue queue( thread_pool.get_executor() );
+   using priority = prioritized_task_queue::priority;
+
+   // hold the only thread so that everything below is queued before any of it runs
+   std::promise<void> release;
+   auto blocker = queue.post( priority::low, [f = release.get_future().share()]() { f.wait(); return 0; } );
+
+   std::vector<int> order;
+   std::vector<std::future<void>> futs;
+   for( int i = 1; i <= 3; ++i )
+      futs.emplace_back( queue.post( priority::low, [&order, i]() { order.push_back( i ); } ) );
+   futs.emplace_back( queue.post( priority::high, [&order]() { order.push_back( 0 ); } ) );
+   auto thrower = queue.post( priority::high, []() -> int { throw std::runtime_error( "recovery failed" ); } );
+
+   release.set_value();
+   BOOST_CHECK_EQUAL( blocker.get(), 0 );
+   for( auto& f : futs ) f.get();
+   BOOST_CHECK_THROW( thrower.get(), std::runtime_error );
+   BOOST_CHECK( order == std::vector<int>({0, 1, 2, 3}) );
+
+   thread_pool.stop();
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(named_thread_pool_test) { try {
+   // cpu 0 always exists, every thread of the pool is pinned to it
+   named_thread_pool thread_pool( "misc", 2, { 0 } );
+
+#ifdef __linux__
+   std::vector<std::future<bool>> pinned;
+   for( int i = 0; i < 4; ++i ) {
+      pinned.emplace_back( async_thread_pool( thread_pool.get_executor(), []() {
+         cpu_set_t set;
+         CPU_ZERO( &set );
+         pthread_getaffinity_np( pthread_self(), sizeof( set ), &set );
+         return CPU_COUNT( &set ) == 1 && CPU_ISSET( 0, &set );
+      } ) );
+   }
+   for( auto& f : pinned )
+      BOOST_CHECK( f.get() );
+#endif
+
+   // tasks only need to be movable
+   auto value = std::make_unique<int>( 42 );
+   auto moved = async_thread_pool( thread_pool.get_executor(), [value{std::move( value )}]() { return *value; } );
+   BOOST_CHECK_EQUAL( moved.get(), 42 );
+
+   thread_pool.stop();
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(parallel_merkle_test) { try {
+   named_thread_pool thread_pool( "misc", 4 );
+
+   // odd sizes on either side of the parallel threshold, so levels duplicate their last digest in both modes
+   for( size_t n : { 1u, 7u, 4095u, 4097u, 20001u } ) {
+      vector<digest_type> ids;
+      for( size_t i = 0; i < n; ++i )
+         ids.emplace_back( digest_type::hash( i ) );
+      BOOST_CHECK_EQUAL( merkle( ids ), merkle( ids, &thread_pool.get_executor() ) );
+   }
+
+   thread_pool.stop();
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(merkle_accumulator_test) { try {
+   merkle_accumulator acc;
+   BOOST_CHECK_EQUAL( acc.get_root(), merkle( {} ) );
+
+   vector<digest_type> ids;
+   for( size_t i = 0; i < 300; ++i ) {
+      ids.emplace_back( digest_type::hash( i ) );
+      acc.append( ids.back() );
+      BOOST_CHECK_EQUAL( acc.get_root(), merkle( ids ) );
+   }
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE(reflector_init_test) {
    try {
 
@@ -1121,6 +1212,153 @@ BOOST_AUTO_TEST_CASE(bad_alloc_test) {
    BOOST_CHECK( ptr == nullptr );
 }
 
+BOOST_AUTO_TEST_CASE(recovered_key_cache_test) { try {
+   const auto priv_a = private_key_type::regenerate<fc::ecc::private_key_shim>( fc::sha256::hash( std::string("a") ) );
+   const auto priv_b = private_key_type::regenerate<fc::ecc::private_key_shim>( fc::sha256::hash( std::string("b") ) );
+   const auto digest = fc::sha256::hash( std::string("payload") );
+   const auto sig_a = priv_a.sign( digest );
+   const auto sig_b = priv_b.sign( digest );
+
+   recovered_key_cache::clear();
+   // a hit must return the same key as the first recovery, whichever canonical requirement filled the entry
+   BOOST_CHECK_EQUAL( recovered_key_cache::recover( sig_a, digest, false ), priv_a.get_public_key() );
+   BOOST_CHECK_EQUAL( recovered_key_cache::recover( sig_a, digest, true ), priv_a.get_public_key() );
+   BOOST_CHECK_EQUAL( recovered_key_cache::recover( sig_a, digest, false ), priv_a.get_public_key() );
+   BOOST_CHECK_EQUAL( recovered_key_cache::recover( sig_b, digest, true ), priv_b.get_public_key() );
+
+   // the same signature over a different digest recovers a different key
+   BOOST_CHECK( recovered_key_cache::recover( sig_a, fc::sha256::hash( std::string("other") ), false ) != priv_a.get_public_key() );
+
+   // with nothing retained every call still recovers
+   recovered_key_cache::set_capacity( 0 );
+   BOOST_CHECK_EQUAL( recovered_key_cache::recover( sig_b, digest, true ), priv_b.get_public_key() );
+   BOOST_CHECK_EQUAL( recovered_key_cache::recover( sig_b, digest, true ), priv_b.get_public_key() );
+   recovered_key_cache::set_capacity( recovered_key_cache::default_capacity );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(state_checkpoint_log_test) { try {
+   fc::temp_directory tempdir;
+   const auto path = tempdir.path() / "state-checkpoints.log";
+   const auto id_a = fc::sha256::hash( std::string("a") );
+   const auto id_b = fc::sha256::hash( std::string("b") );
+   const auto root_a = fc::sha256::hash( std::string("root a") );
+   const auto root_b = fc::sha256::hash( std::string("root b") );
+
+   {
+      state_checkpoint_log log( path );
+      BOOST_CHECK_EQUAL( log.size(), 0u );
+      log.append( {id_a, root_a} );
+      log.append( {id_b, root_b} );
+      BOOST_REQUIRE( log.find( id_a ) );
+      BOOST_CHECK_EQUAL( *log.find( id_a ), root_a );
+   }
+
+   // a torn entry at the end, as left by a crash mid append, is dropped on open
+   {
+      std::ofstream f( path.generic_string(), std::ios::binary | std::ios::app );
+      f.write( "torn", 4 );
+   }
+
+   state_checkpoint_log log( path );
+   BOOST_CHECK_EQUAL( log.size(), 2u );
+   BOOST_REQUIRE( log.find( id_b ) );
+   BOOST_CHECK_EQUAL( *log.find( id_b ), root_b );
+   BOOST_CHECK( !log.find( fc::sha256::hash( std::string("c") ) ) );
+
+   // entries appended after the torn one was dropped line up again
+   log.append( {id_a, root_b} );
+   BOOST_CHECK_EQUAL( state_checkpoint_log( path ).size(), 2u );
+   BOOST_CHECK_EQUAL( *state_checkpoint_log( path ).find( id_a ), root_b );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(log_sync_group_commit_test) { try {
+   fc::temp_directory tempdir;
+   const auto path = tempdir.path() / "test.log";
+   { std::ofstream f( path.generic_string() ); f << "entries"; }
+
+   uint32_t flushes = 0;
+   auto flush = [&]() { ++flushes; };
+
+   {
+      log_sync every_three( "test-sync", log_durability{ 3, fc::microseconds(), true }, { path } );
+      for( int i = 0; i < 7; ++i )
+         every_three.appended( flush );
+      BOOST_CHECK_EQUAL( flushes, 2u );
+      every_three.flush_now( flush );
+      BOOST_CHECK_EQUAL( flushes, 3u );
+   }
+
+   // flushes due to the interval only, which the first append after it has passed triggers
+   flushes = 0;
+   log_sync by_time( "test-sync", log_durability{ 0, fc::milliseconds( 10 ), false }, { path } );
+   by_time.appended( flush );
+   BOOST_CHECK_EQUAL( flushes, 0u );
+   std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+   by_time.appended( flush );
+   BOOST_CHECK_EQUAL( flushes, 1u );
+
+   // without a count or an interval every append is flushed
+   flushes = 0;
+   log_sync always( "test-sync", log_durability{ 0, fc::microseconds(), false }, { path } );
+   always.appended( flush );
+   always.appended( flush );
+   BOOST_CHECK_EQUAL( flushes, 2u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(table_access_waves_test) { try {
+   table_access_set read_a;  read_a.add_read( N(token), N(alice), N(accounts) );
+   table_access_set read_b;  read_b.add_read( N(token), N(bob), N(accounts) );
+   table_access_set write_a; write_a.add_write( N(token), N(alice), N(accounts) );
+   table_access_set write_b; write_b.add_write( N(token), N(bob), N(accounts) );
+
+   BOOST_CHECK( !read_a.conflicts_with( read_a ) );
+   BOOST_CHECK( !read_a.conflicts_with( write_b ) );
+   BOOST_CHECK( read_a.conflicts_with( write_a ) );
+   BOOST_CHECK( write_a.conflicts_with( read_a ) );
+   BOOST_CHECK( write_a.conflicts_with( write_a ) );
+
+   auto waves = partition_into_waves( { read_a, write_b, read_b, write_a, read_a } );
+   BOOST_REQUIRE_EQUAL( waves.size(), 5u );
+   BOOST_CHECK_EQUAL( waves[0], 0u );
+   BOOST_CHECK_EQUAL( waves[1], 0u );
+   BOOST_CHECK_EQUAL( waves[2], 1u ); // reads what write_b wrote
+   BOOST_CHECK_EQUAL( waves[3], 1u ); // must follow read_a
+   BOOST_CHECK_EQUAL( waves[4], 2u ); // must follow write_a
+
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(transaction_dedup_filter_test) { try {
+   transaction_dedup_filter filter;
+   const auto a = fc::sha256::hash( std::string("a") );
+   const auto b = fc::sha256::hash( std::string("b") );
+   const fc::time_point_sec exp( 1'600'000'000 );
+
+   filter.add( a, exp );
+   BOOST_CHECK( filter.may_contain( a, exp ) );
+   BOOST_CHECK( !filter.may_contain( b, exp ) );
+   BOOST_CHECK( !filter.may_contain( a, exp + transaction_dedup_filter::bucket_seconds ) );
+
+   // kept until its whole bucket is expired
+   filter.remove_expired( fc::time_point( exp ) );
+   BOOST_CHECK( filter.may_contain( a, exp ) );
+   filter.remove_expired( fc::time_point( exp + transaction_dedup_filter::bucket_seconds ) );
+   BOOST_CHECK( !filter.may_contain( a, exp ) );
+   BOOST_CHECK_EQUAL( filter.buckets(), 0u );
+
+   // the controller's filter covers the transactions of the state it opens
+   testing::tester test;
+   test.create_account( N(alice) );
+   auto block = test.produce_block();
+   const auto& ptrx = block->transactions.back().trx.get<packed_transaction>();
+   BOOST_CHECK( test.control->is_known_unexpired_transaction( ptrx.id(), ptrx.expiration() ) );
+   BOOST_CHECK( !test.control->is_known_unexpired_transaction( b, ptrx.expiration() ) );
+   test.close();
+   test.open();
+   BOOST_CHECK( test.control->is_known_unexpired_transaction( ptrx.id(), ptrx.expiration() ) );
+   BOOST_CHECK( !test.control->is_known_unexpired_transaction( b, ptrx.expiration() ) );
+
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } // namespace eosio
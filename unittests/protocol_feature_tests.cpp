@@ -1739,4 +1739,56 @@ BOOST_AUTO_TEST_CASE( wtmsig_block_signing_inflight_extension_test ) { try {
 
 } FC_LOG_AND_RETHROW() }
 
+static const char import_db_read_range_wast[] = R"=====(
+(module
+ (import "env" "db_store_i64" (func $db_store_i64 (param i64 i64 i64 i64 i32 i32) (result i32)))
+ (import "env" "db_read_range_i64" (func $db_read_range_i64 (param i64 i64 i64 i64 i32 i32 i32) (result i32)))
+ (import "env" "eosio_assert" (func $eosio_assert (param i32 i32)))
+ (memory $0 1)
+ (export "apply" (func $apply))
+ (func $apply (param $0 i64) (param $1 i64) (param $2 i64)
+   (drop (call $db_store_i64 (get_local $0) (i64.const 1) (get_local $0) (i64.const 1) (i32.const 8) (i32.const 4)))
+   (drop (call $db_store_i64 (get_local $0) (i64.const 1) (get_local $0) (i64.const 2) (i32.const 8) (i32.const 4)))
+   (drop (call $db_store_i64 (get_local $0) (i64.const 1) (get_local $0) (i64.const 3) (i32.const 8) (i32.const 4)))
+   (call $eosio_assert
+     (i32.eq (call $db_read_range_i64 (get_local $0) (get_local $0) (i64.const 1) (i64.const 2) (i32.const 10) (i32.const 1024) (i32.const 256))
+             (i32.const 2))
+     (i32.const 16))
+   (call $eosio_assert (i64.eq (i64.load (i32.const 1024)) (i64.const 2)) (i32.const 16))
+   (call $eosio_assert (i32.eq (i32.load (i32.const 1032)) (i32.const 4)) (i32.const 16))
+   (call $eosio_assert (i64.eq (i64.load (i32.const 1040)) (i64.const 3)) (i32.const 16))
+   (call $eosio_assert
+     (i32.eq (call $db_read_range_i64 (get_local $0) (get_local $0) (i64.const 1) (i64.const 0) (i32.const 10) (i32.const 1024) (i32.const 8))
+             (i32.const -16))
+     (i32.const 16))
+ )
+ (data (i32.const 8) "abcd")
+ (data (i32.const 16) "bad range read\00")
+)
+)=====";
+
+BOOST_AUTO_TEST_CASE( db_read_range_test ) { try {
+   tester c( setup_policy::preactivate_feature_and_new_bios );
+
+   const auto& pfm = c.control->get_protocol_feature_manager();
+   const auto& d = pfm.get_builtin_digest(builtin_protocol_feature_t::db_read_range);
+   BOOST_REQUIRE(d);
+
+   const auto& alice_account = account_name("alice");
+   c.create_accounts( {alice_account} );
+   c.produce_block();
+
+   BOOST_CHECK_EXCEPTION(  c.set_code( alice_account, import_db_read_range_wast ),
+                           wasm_exception,
+                           fc_exception_message_is( "env.db_read_range_i64 unresolveable" ) );
+
+   c.preactivate_protocol_features( {*d} );
+   c.produce_block();
+
+   c.set_code( alice_account, import_db_read_range_wast );
+   BOOST_REQUIRE_EQUAL(c.push_action(action({{ alice_account, permission_name("active") }}, alice_account, action_name(), {} ), alice_account.to_uint64_t()), c.success());
+
+   c.produce_block();
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,82 @@
+#include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/contract_types.hpp>
+#include <eosio/testing/tester.hpp>
+
+#include <fc/variant_object.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include <contracts.hpp>
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+
+using mvo = fc::mutable_variant_object;
+
+namespace {
+   transaction_trace_ptr push_read_only( tester& chain, const signed_transaction& trx ) {
+      auto ptrx = std::make_shared<packed_transaction>( trx );
+      auto fut = transaction_metadata::start_recover_keys( ptrx, chain.control->get_thread_pool(), chain.control->get_chain_id(),
+                                                           fc::microseconds::maximum() );
+      return chain.control->push_read_only_transaction( fut.get(), fc::time_point::maximum() );
+   }
+}
+
+BOOST_AUTO_TEST_SUITE(read_only_trx_tests)
+
+BOOST_AUTO_TEST_CASE( read_only_trx_rejects_writes ) try {
+   tester chain;
+
+   chain.create_accounts( { N(eosio.token), N(alice) } );
+   chain.set_code( N(eosio.token), contracts::eosio_token_wasm() );
+   chain.set_abi( N(eosio.token), contracts::eosio_token_abi().data() );
+   chain.produce_block();
+
+   signed_transaction trx;
+   trx.actions.emplace_back( chain.get_action( N(eosio.token), N(create),
+                                               vector<permission_level>{{N(eosio.token), config::active_name}},
+                                               mvo()("issuer", "alice")("maximum_supply", "1000.0000 TKN") ) );
+   chain.set_transaction_headers( trx );
+   trx.sign( chain.get_private_key( N(eosio.token), "active" ), chain.control->get_chain_id() );
+
+   auto trace = push_read_only( chain, trx );
+
+   BOOST_REQUIRE( trace->except );
+   BOOST_CHECK_EQUAL( trace->except->code(), read_only_trx_write_exception::code_value );
+   BOOST_CHECK( chain.get_row_by_account( N(eosio.token), name(symbol(4, "TKN").to_symbol_code().value),
+                                          N(stat), name(symbol(4, "TKN").to_symbol_code().value) ).empty() );
+
+   // the read-only attempt must not be recorded for dedup, so the same transaction is still accepted
+   chain.push_transaction( trx );
+   chain.produce_block();
+   BOOST_CHECK( !chain.get_row_by_account( N(eosio.token), name(symbol(4, "TKN").to_symbol_code().value),
+                                           N(stat), name(symbol(4, "TKN").to_symbol_code().value) ).empty() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( read_only_trx_rejects_native_actions_and_missing_auth ) try {
+   tester chain;
+   chain.create_accounts( { N(alice) } );
+   chain.produce_block();
+
+   // native handlers write to state directly rather than through the contract table intrinsics
+   signed_transaction trx;
+   authority auth( chain.get_public_key( N(alice), "other" ) );
+   trx.actions.emplace_back( vector<permission_level>{{N(alice), config::active_name}},
+                             updateauth{ N(alice), N(other), config::active_name, auth } );
+   chain.set_transaction_headers( trx );
+   trx.sign( chain.get_private_key( N(alice), "active" ), chain.control->get_chain_id() );
+   auto trace = push_read_only( chain, trx );
+   BOOST_REQUIRE( trace->except );
+   BOOST_CHECK_EQUAL( trace->except->code(), read_only_trx_write_exception::code_value );
+
+   // the authorization of the transaction is checked as for any other transaction
+   signed_transaction unsigned_trx;
+   unsigned_trx.actions = trx.actions;
+   chain.set_transaction_headers( unsigned_trx );
+   trace = push_read_only( chain, unsigned_trx );
+   BOOST_REQUIRE( trace->except );
+   BOOST_CHECK_EQUAL( trace->except->code(), unsatisfied_authorization::code_value );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -1,3 +1,4 @@
+#include <fstream>
 #include <sstream>
 
 #include <eosio/chain/block_log.hpp>
@@ -78,4 +79,188 @@ BOOST_AUTO_TEST_CASE(test_restart_with_different_chain_id)
    BOOST_REQUIRE_EXCEPTION(other.open(chain_id), chain_id_type_exception, fc_exception_message_starts_with("chain ID in state "));
 }
 
+BOOST_AUTO_TEST_CASE(test_replay_terminate_at_block)
+{
+   fc::temp_directory tempdir;
+   auto def_conf = tester::default_config( tempdir );
+   block_id_type id_at_10;
+   {
+      tester chain( def_conf.first, def_conf.second );
+      chain.produce_blocks( 20 );
+      id_at_10 = chain.control->get_block_id_for_num( 10 );
+      chain.close();
+   }
+   BOOST_REQUIRE_GT( block_log( def_conf.first.blocks_dir ).head()->block_num(), 10u );
+
+   // replay from genesis, stopping at block 10 even though the block log goes further
+   fc::remove_all( def_conf.first.state_dir );
+   fc::remove_all( def_conf.first.blocks_dir / config::reversible_blocks_dir_name );
+   auto cfg = def_conf.first;
+   cfg.terminate_at_block = 10;
+   tester replayed( cfg, def_conf.second );
+   BOOST_CHECK_EQUAL( replayed.control->head_block_num(), 10u );
+   BOOST_CHECK_EQUAL( replayed.control->head_block_id(), id_at_10 );
+}
+
+BOOST_AUTO_TEST_CASE(test_replay_profile)
+{
+   fc::temp_directory tempdir;
+   auto def_conf = tester::default_config( tempdir );
+   {
+      tester chain( def_conf.first, def_conf.second );
+      chain.produce_blocks( 20 );
+      chain.close();
+   }
+   const uint32_t log_head = block_log( def_conf.first.blocks_dir ).head()->block_num();
+
+   fc::remove_all( def_conf.first.state_dir );
+   fc::remove_all( def_conf.first.blocks_dir / config::reversible_blocks_dir_name );
+   auto cfg = def_conf.first;
+   cfg.replay_profile_file = tempdir.path() / "replay.csv";
+   {
+      tester replayed( cfg, def_conf.second );
+      BOOST_CHECK_EQUAL( replayed.control->head_block_num(), log_head );
+   }
+
+   std::ifstream profile( cfg.replay_profile_file.generic_string() );
+   std::string line;
+   BOOST_REQUIRE( std::getline( profile, line ) );
+   BOOST_CHECK_EQUAL( line, "block_num,timestamp,apply_us,transactions,actions,slowest_contract,slowest_contract_us" );
+   // every block after genesis is replayed and only runs the onblock action of eosio
+   uint32_t expected_num = 2;
+   while( std::getline( profile, line ) ) {
+      BOOST_CHECK_EQUAL( line.substr( 0, line.find( ',' ) ), std::to_string( expected_num ) );
+      BOOST_CHECK( line.find( ",0,1,eosio," ) != std::string::npos );
+      ++expected_num;
+   }
+   BOOST_CHECK_EQUAL( expected_num, log_head + 1 );
+}
+
+BOOST_AUTO_TEST_CASE(test_extract_block_range)
+{
+   tester chain;
+   chain.produce_blocks(20);
+   chain.close();
+
+   fc::temp_directory temp_dir;
+   auto shard_dir = temp_dir.path() / "shard";
+   BOOST_CHECK_EQUAL( block_log::extract_block_range( chain.get_config().blocks_dir, shard_dir, 5, 12 ), 8u );
+
+   block_log original( chain.get_config().blocks_dir );
+   block_log shard( shard_dir );
+   BOOST_CHECK_EQUAL( shard.first_block_num(), 5u );
+   BOOST_CHECK_EQUAL( shard.head()->block_num(), 12u );
+   BOOST_CHECK_EQUAL( block_log::extract_chain_id( shard_dir ), block_log::extract_chain_id( chain.get_config().blocks_dir ) );
+   for( uint32_t n = 5; n <= 12; ++n ) {
+      BOOST_CHECK( shard.read_serialized_block_by_num( n ) == original.read_serialized_block_by_num( n ) );
+   }
+   BOOST_CHECK( !shard.read_block_by_num( 4 ) );
+   BOOST_CHECK( !shard.read_block_by_num( 13 ) );
+
+   // invalid arguments are rejected before any output is created
+   auto other_dir = temp_dir.path() / "other";
+   BOOST_CHECK_THROW( block_log::extract_block_range( chain.get_config().blocks_dir, other_dir, 12, 5 ), block_log_exception );
+   BOOST_CHECK_THROW( block_log::extract_block_range( chain.get_config().blocks_dir, other_dir, 100, 200 ), block_log_exception );
+   BOOST_CHECK( !fc::exists( other_dir ) );
+   // an existing shard is not overwritten, and the source directory under another name is refused
+   const auto shard_size = fc::file_size( shard_dir / "blocks.log" );
+   const auto log_size = fc::file_size( chain.get_config().blocks_dir / "blocks.log" );
+   BOOST_CHECK_THROW( block_log::extract_block_range( chain.get_config().blocks_dir, shard_dir, 1, 3 ), block_log_exception );
+   BOOST_CHECK_EQUAL( fc::file_size( shard_dir / "blocks.log" ), shard_size );
+   BOOST_CHECK_THROW( block_log::extract_block_range( chain.get_config().blocks_dir, chain.get_config().blocks_dir / ".", 1, 3 ),
+                      block_log_exception );
+   BOOST_CHECK_EQUAL( fc::file_size( chain.get_config().blocks_dir / "blocks.log" ), log_size );
+}
+
+BOOST_AUTO_TEST_CASE(test_split_and_merge_block_log)
+{
+   tester chain;
+   chain.produce_blocks(20);
+   chain.close();
+   const auto blocks_dir = chain.get_config().blocks_dir;
+   block_log original( blocks_dir );
+   const uint32_t head = original.head()->block_num();
+
+   fc::temp_directory temp_dir;
+   auto split_dir = temp_dir.path() / "split";
+   BOOST_CHECK_EQUAL( block_log::split_block_log( blocks_dir, split_dir, 8 ), (head + 7) / 8 );
+   BOOST_CHECK( fc::exists( split_dir / "blocks-1-8.log" ) );
+   BOOST_CHECK( fc::exists( split_dir / "blocks-9-16.index" ) );
+
+   // the first file keeps the genesis state of the original
+   auto first_dir = temp_dir.path() / "first";
+   fc::create_directories( first_dir );
+   fc::copy( split_dir / "blocks-1-8.log", first_dir / "blocks.log" );
+   fc::copy( split_dir / "blocks-1-8.index", first_dir / "blocks.index" );
+   BOOST_CHECK( block_log::extract_genesis_state( first_dir ) );
+
+   auto merged_dir = temp_dir.path() / "merged";
+   BOOST_CHECK_EQUAL( block_log::merge_block_logs( split_dir, merged_dir ), head );
+   block_log merged( merged_dir );
+   BOOST_CHECK_EQUAL( merged.first_block_num(), 1u );
+   BOOST_CHECK_EQUAL( merged.head()->block_num(), head );
+   for( uint32_t n = 1; n <= head; ++n ) {
+      BOOST_CHECK( merged.read_serialized_block_by_num( n ) == original.read_serialized_block_by_num( n ) );
+   }
+
+   // a gap in the files is refused
+   fc::remove( split_dir / "blocks-9-16.log" );
+   BOOST_CHECK_THROW( block_log::merge_block_logs( split_dir, temp_dir.path() / "gap" ), block_log_exception );
+}
+
+BOOST_AUTO_TEST_CASE(test_compressed_block_log_shards)
+{
+   tester chain;
+   chain.produce_blocks(20);
+   chain.close();
+   const auto blocks_dir = chain.get_config().blocks_dir;
+   block_log original( blocks_dir );
+   const uint32_t head = original.head()->block_num();
+
+   for( auto codec : { block_codec::zlib, block_codec::zstd, block_codec::lz4 } ) {
+      if( !block_codec_supported( codec ) ) continue;
+      BOOST_TEST_CONTEXT( "codec " << static_cast<uint32_t>( codec ) ) {
+         fc::temp_directory temp_dir;
+         auto shard_dir = temp_dir.path() / "shards";
+         BOOST_CHECK_EQUAL( block_log::split_block_log( blocks_dir, shard_dir, 8, codec, 3 ), (head + 7) / 8 );
+         BOOST_CHECK( fc::exists( shard_dir / "blocks-1-8.clog" ) );
+         BOOST_CHECK( !fc::exists( shard_dir / "blocks-1-8.log" ) );
+
+         // blocks trimmed from the front of blocks.log are read from the shards next to it
+         auto trimmed_dir = temp_dir.path() / "trimmed";
+         fc::create_directories( trimmed_dir );
+         fc::copy( blocks_dir / "blocks.log", trimmed_dir / "blocks.log" );
+         fc::copy( blocks_dir / "blocks.index", trimmed_dir / "blocks.index" );
+         BOOST_REQUIRE( block_log::trim_blocklog_front( trimmed_dir, temp_dir.path() / "tmp", 17 ) );
+         fc::copy( shard_dir / "blocks-1-8.clog", trimmed_dir / "blocks-1-8.clog" );
+         fc::copy( shard_dir / "blocks-9-16.clog", trimmed_dir / "blocks-9-16.clog" );
+         {
+            block_log trimmed( trimmed_dir );
+            BOOST_CHECK_EQUAL( trimmed.first_block_num(), 17u );
+            BOOST_CHECK_EQUAL( trimmed.first_available_block_num(), 1u );
+            // backwards as well, so that reads do not only hit the chunk read before
+            for( uint32_t n = head; n >= 1; --n ) {
+               BOOST_CHECK( trimmed.read_serialized_block_by_num( n ) == original.read_serialized_block_by_num( n ) );
+               BOOST_CHECK_EQUAL( trimmed.read_block_id_by_num( n ), original.read_block_id_by_num( n ) );
+            }
+            BOOST_CHECK_EQUAL( trimmed.read_block_by_num( 5 )->id(), original.read_block_by_num( 5 )->id() );
+            BOOST_CHECK( !trimmed.read_block_by_num( head + 1 ) );
+         }
+
+         // a shard is dropped on its own
+         fc::remove( trimmed_dir / "blocks-1-8.clog" );
+         {
+            block_log trimmed( trimmed_dir );
+            BOOST_CHECK_EQUAL( trimmed.first_available_block_num(), 9u );
+            BOOST_CHECK( !trimmed.read_block_by_num( 8 ) );
+            BOOST_CHECK( trimmed.read_serialized_block_by_num( 9 ) == original.read_serialized_block_by_num( 9 ) );
+         }
+
+         // a shard that does not hold the blocks its name says is refused
+         fc::copy( shard_dir / "blocks-1-8.clog", trimmed_dir / "blocks-1-7.clog" );
+         BOOST_CHECK_THROW( block_log{ trimmed_dir }, block_log_exception );
+      }
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,6 +3,7 @@
 #include <eosio/chain/block_log.hpp>
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/snapshot.hpp>
+#include <eosio/chain/snapshot_delta.hpp>
 #include <eosio/testing/tester.hpp>
 
 #include <boost/mpl/list.hpp>
@@ -167,9 +168,50 @@ struct buffered_snapshot_suite {
    }
 };
 
+struct mapped_snapshot_suite {
+   using writer_t = buffered_snapshot_suite::writer_t;
+   using reader_t = mapped_snapshot_reader;
+   using write_storage_t = buffered_snapshot_suite::write_storage_t;
+   using snapshot_t = std::string;
+
+   using writer = buffered_snapshot_suite::writer;
+
+   struct storage_holder {
+      explicit storage_holder(const snapshot_t& buffer)
+      :storage(buffer)
+      {}
+
+      snapshot_t storage;
+   };
+
+   struct reader : private storage_holder, public reader_t {
+      explicit reader(const snapshot_t& buffer)
+      :storage_holder(buffer)
+      ,reader_t(storage.data(), storage.size())
+      {}
+   };
+
+   static auto get_writer() {
+      return buffered_snapshot_suite::get_writer();
+   }
+
+   static auto finalize(const std::shared_ptr<writer>& w) {
+      return buffered_snapshot_suite::finalize(w);
+   }
+
+   static auto get_reader( const snapshot_t& buffer) {
+      return std::make_shared<reader>(buffer);
+   }
+
+   template<typename Snapshot>
+   static snapshot_t load_from_file() {
+      return Snapshot::bin();
+   }
+};
+
 BOOST_AUTO_TEST_SUITE(snapshot_tests)
 
-using snapshot_suites = boost::mpl::list<variant_snapshot_suite, buffered_snapshot_suite>;
+using snapshot_suites = boost::mpl::list<variant_snapshot_suite, buffered_snapshot_suite, mapped_snapshot_suite>;
 
 namespace {
    void variant_diff_helper(const fc::variant& lhs, const fc::variant& rhs, std::function<void(const std::string&, const fc::variant&, const fc::variant&)>&& out){
@@ -429,6 +471,230 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(test_chain_id_in_snapshot, SNAPSHOT_SUITE, snapsho
    verify_integrity_hash<SNAPSHOT_SUITE>(*chain.control, *snap_chain.control);
 }
 
+BOOST_AUTO_TEST_CASE(test_parallel_binary_snapshot)
+{
+   tester chain;
+
+   chain.create_account(N(snapshot));
+   chain.produce_blocks(1);
+   chain.set_code(N(snapshot), contracts::snapshot_test_wasm());
+   chain.set_abi(N(snapshot), contracts::snapshot_test_abi().data());
+   chain.produce_blocks(1);
+   chain.control->abort_block();
+
+   // sections serialized concurrently must still come out in a fixed order
+   auto first_writer = buffered_snapshot_suite::get_writer();
+   chain.control->write_snapshot(first_writer);
+   auto first = buffered_snapshot_suite::finalize(first_writer);
+
+   auto second_writer = buffered_snapshot_suite::get_writer();
+   chain.control->write_snapshot(second_writer);
+   auto second = buffered_snapshot_suite::finalize(second_writer);
+
+   BOOST_REQUIRE(first == second);
+
+   auto reader = buffered_snapshot_suite::get_reader(first);
+   reader->validate();
+   BOOST_REQUIRE(reader->has_section("contract_tables"));
+   BOOST_REQUIRE(!reader->has_section("no_such_section"));
+   BOOST_REQUIRE_THROW(reader->set_section("no_such_section"), snapshot_exception);
+
+   snapshotted_tester snap_chain(chain.get_config(), buffered_snapshot_suite::get_reader(first), 0);
+   verify_integrity_hash<buffered_snapshot_suite>(*chain.control, *snap_chain.control);
+}
+
+BOOST_AUTO_TEST_CASE(test_integrity_merkle_root)
+{
+   tester chain;
+
+   chain.create_account(N(snapshot));
+   chain.produce_blocks(1);
+   chain.set_code(N(snapshot), contracts::snapshot_test_wasm());
+   chain.set_abi(N(snapshot), contracts::snapshot_test_abi().data());
+   chain.produce_blocks(1);
+   chain.control->abort_block();
+
+   auto writer = buffered_snapshot_suite::get_writer();
+   chain.control->write_snapshot(writer);
+   auto snapshot = buffered_snapshot_suite::finalize(writer);
+
+   snapshotted_tester snap_chain(chain.get_config(), buffered_snapshot_suite::get_reader(snapshot), 0);
+   const auto root = chain.control->calculate_integrity_merkle_root();
+   BOOST_REQUIRE_EQUAL(root, snap_chain.control->calculate_integrity_merkle_root());
+
+   chain.push_action(N(snapshot), N(increment), N(snapshot), mutable_variant_object()
+      ( "value", 1 )
+   );
+   chain.produce_block();
+   chain.control->abort_block();
+   BOOST_REQUIRE_NE(root, chain.control->calculate_integrity_merkle_root());
+}
+
+BOOST_AUTO_TEST_CASE(test_compressed_snapshot)
+{
+   tester chain;
+
+   chain.create_account(N(snapshot));
+   chain.produce_blocks(1);
+   chain.set_code(N(snapshot), contracts::snapshot_test_wasm());
+   chain.set_abi(N(snapshot), contracts::snapshot_test_abi().data());
+   chain.produce_blocks(1);
+   chain.control->abort_block();
+
+   std::ostringstream compressed_out;
+   auto compressed_writer = std::make_shared<compressed_ostream_snapshot_writer>(compressed_out);
+   chain.control->write_snapshot(compressed_writer);
+   compressed_writer->finalize();
+
+   auto uncompressed_writer = buffered_snapshot_suite::get_writer();
+   chain.control->write_snapshot(uncompressed_writer);
+   auto uncompressed = buffered_snapshot_suite::finalize(uncompressed_writer);
+
+   const auto compressed = compressed_out.str();
+   BOOST_REQUIRE_LT(compressed.size(), uncompressed.size());
+
+   auto compressed_in = std::make_shared<std::istringstream>(compressed);
+   BOOST_REQUIRE(compressed_istream_snapshot_reader::is_compressed(*compressed_in));
+   auto uncompressed_in = std::istringstream(uncompressed);
+   BOOST_REQUIRE(!compressed_istream_snapshot_reader::is_compressed(uncompressed_in));
+
+   auto reader = std::make_shared<compressed_istream_snapshot_reader>(*compressed_in);
+   reader->validate();
+   BOOST_REQUIRE(reader->has_section("contract_tables"));
+   BOOST_REQUIRE(!reader->has_section("no_such_section"));
+
+   snapshotted_tester snap_chain(chain.get_config(), reader, 0);
+   verify_integrity_hash<buffered_snapshot_suite>(*chain.control, *snap_chain.control);
+}
+
+BOOST_AUTO_TEST_CASE(test_compress_binary_snapshot)
+{
+   tester chain;
+
+   chain.create_account(N(snapshot));
+   chain.produce_blocks(1);
+   chain.set_code(N(snapshot), contracts::snapshot_test_wasm());
+   chain.set_abi(N(snapshot), contracts::snapshot_test_abi().data());
+   chain.produce_blocks(1);
+   chain.control->abort_block();
+
+   auto uncompressed_writer = buffered_snapshot_suite::get_writer();
+   chain.control->write_snapshot(uncompressed_writer);
+   auto uncompressed = buffered_snapshot_suite::finalize(uncompressed_writer);
+
+   std::istringstream uncompressed_in(uncompressed);
+   std::ostringstream compressed_out;
+   uint64_t consumed = 0;
+   compress_snapshot(uncompressed_in, compressed_out, [&consumed](uint64_t c) {
+      BOOST_REQUIRE_GT(c, consumed);
+      consumed = c;
+   });
+   BOOST_REQUIRE_EQUAL(consumed + sizeof(uint64_t), uncompressed.size());
+   BOOST_REQUIRE_LT(compressed_out.str().size(), uncompressed.size());
+
+   std::istringstream truncated_in(uncompressed.substr(0, uncompressed.size() / 2));
+   std::ostringstream truncated_out;
+   BOOST_REQUIRE_THROW(compress_snapshot(truncated_in, truncated_out), snapshot_exception);
+
+   auto compressed_in = std::make_shared<std::istringstream>(compressed_out.str());
+   auto reader = std::make_shared<compressed_istream_snapshot_reader>(*compressed_in);
+   reader->validate();
+   snapshotted_tester snap_chain(chain.get_config(), reader, 0);
+   verify_integrity_hash<buffered_snapshot_suite>(*chain.control, *snap_chain.control);
+}
+
+BOOST_AUTO_TEST_CASE(test_snapshot_delta_chain)
+{
+   tester chain;
+
+   chain.create_account(N(snapshot));
+   chain.produce_blocks(1);
+   chain.set_code(N(snapshot), contracts::snapshot_test_wasm());
+   chain.set_abi(N(snapshot), contracts::snapshot_test_abi().data());
+   chain.produce_blocks(1);
+   chain.control->abort_block();
+
+   auto take_snapshot = [&chain]() {
+      auto writer = buffered_snapshot_suite::get_writer();
+      chain.control->write_snapshot(writer);
+      return buffered_snapshot_suite::finalize(writer);
+   };
+
+   auto advance = [&chain]() {
+      chain.push_action(N(snapshot), N(increment), N(snapshot), mutable_variant_object()
+         ( "value", 1 )
+      );
+      chain.produce_block();
+      chain.control->abort_block();
+   };
+
+   const auto base = take_snapshot();
+   advance();
+   const auto second = take_snapshot();
+   advance();
+   const auto third = take_snapshot();
+
+   auto make_delta = [](const std::string& from, const std::string& to) {
+      std::istringstream from_in(from), to_in(to);
+      std::ostringstream delta_out;
+      snapshot_delta::write(from_in, to_in, delta_out);
+      return delta_out.str();
+   };
+
+   auto apply_delta = [](const std::string& from, const std::string& delta) {
+      std::istringstream from_in(from), delta_in(delta);
+      std::ostringstream out;
+      snapshot_delta::apply(from_in, delta_in, out);
+      return out.str();
+   };
+
+   const auto first_delta = make_delta(base, second);
+   const auto second_delta = make_delta(second, third);
+
+   // apply the chain of deltas onto the base
+   const auto rebuilt = apply_delta(apply_delta(base, first_delta), second_delta);
+   BOOST_REQUIRE(rebuilt == third);
+
+   // a delta only applies to the base it was made against
+   BOOST_REQUIRE_THROW(apply_delta(base, second_delta), snapshot_exception);
+
+   snapshotted_tester snap_chain(chain.get_config(), buffered_snapshot_suite::get_reader(rebuilt), 0);
+   verify_integrity_hash<buffered_snapshot_suite>(*chain.control, *snap_chain.control);
+}
+
+BOOST_AUTO_TEST_CASE(test_chunked_section_buffer)
+{
+   // writes across chunk boundaries and patches a header back at the start, like a section spanning chunks
+   eosio::chain::detail::chunked_streambuf buf;
+   std::ostream chunked(&buf);
+   std::stringstream expected;
+
+   const auto size = 3 * eosio::chain::detail::chunked_streambuf::chunk_size + 17;
+   std::string data(size, '\0');
+   for( size_t i = 0; i < data.size(); ++i ) data[i] = static_cast<char>(i * 31 + 7);
+   const std::string header = "header!!";
+
+   for( auto* out : std::initializer_list<std::ostream*>{ &chunked, &expected } ) {
+      const auto start = out->tellp();
+      out->write(std::string(header.size(), '\0').data(), header.size());
+      out->write(data.data(), 5);
+      out->put('x');
+      out->write(data.data(), data.size());
+      const auto end = out->tellp();
+      out->seekp(start);
+      out->write(header.data(), header.size());
+      out->seekp(end);
+      out->write(header.data(), header.size());
+   }
+
+   BOOST_REQUIRE(chunked.tellp() == expected.tellp());
+   std::ostringstream written;
+   chunked.flush();
+   buf.write_to(written);
+   BOOST_REQUIRE(written.str() == expected.str());
+   BOOST_REQUIRE(chunked.tellp() == 0);
+}
+
 BOOST_AUTO_TEST_CASE_TEMPLATE(test_compatible_versions, SNAPSHOT_SUITE, snapshot_suites)
 {
    tester chain(setup_policy::preactivate_feature_and_new_bios);
@@ -6,6 +6,7 @@
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/resource_limits.hpp>
 #include <eosio/chain/wasm_eosio_constraints.hpp>
+#include <eosio/chain/wasm_module_cache.hpp>
 #include <eosio/chain/wast_to_wasm.hpp>
 #include <eosio/testing/tester.hpp>
 
@@ -953,6 +954,50 @@ BOOST_FIXTURE_TEST_CASE( offset_check, TESTER ) try {
 } FC_LOG_AND_RETHROW()
 
 
+// large enough that function bodies are validated across the controller thread pool
+BOOST_FIXTURE_TEST_CASE( parallel_validation, TESTER ) try {
+   produce_blocks(2);
+
+   create_accounts( {N(bigcode)} );
+   produce_block();
+
+   const size_t function_count = 48;
+   const size_t nops_per_function = 6000;
+   auto make_module = [&]( fc::optional<size_t> nested_in, fc::optional<size_t> large_offset_in ) {
+      std::stringstream ss;
+      ss << "(module (memory $0 1)";
+      for( size_t f = 0; f < function_count; ++f ) {
+         ss << "(func $f" << f;
+         for( size_t i = 0; i < nops_per_function; ++i )
+            ss << " (nop)";
+         if( nested_in && *nested_in == f ) {
+            for( size_t i = 0; i < 1100; ++i ) ss << "(block ";
+            for( size_t i = 0; i < 1100; ++i ) ss << ")";
+         }
+         if( large_offset_in && *large_offset_in == f )
+            ss << "(drop (i32.load offset=" << eosio::chain::wasm_constraints::maximum_linear_memory+4 << " (i32.const 0)))";
+         ss << ")";
+      }
+      ss << "(func $apply (param $0 i64) (param $1 i64) (param $2 i64)) (export \"apply\" (func $apply)) )";
+      return ss.str();
+   };
+
+   set_code( N(bigcode), make_module( {}, {} ).c_str() );
+   produce_block();
+
+   BOOST_CHECK_EXCEPTION( set_code( N(bigcode), make_module( {}, function_count - 1 ).c_str() ), wasm_execution_error,
+                          fc_exception_message_is( "Smart contract used an invalid large memory store/load offset" ) );
+   produce_block();
+
+   // the error of the earlier function is the one reported, whichever thread finished first
+   BOOST_CHECK_EXCEPTION( set_code( N(bigcode), make_module( size_t(10), size_t(40) ).c_str() ), wasm_execution_error,
+                          fc_exception_message_is( "Nested depth exceeded" ) );
+   produce_block();
+   BOOST_CHECK_EXCEPTION( set_code( N(bigcode), make_module( size_t(40), size_t(10) ).c_str() ), wasm_execution_error,
+                          fc_exception_message_is( "Smart contract used an invalid large memory store/load offset" ) );
+   produce_block();
+} FC_LOG_AND_RETHROW()
+
 BOOST_FIXTURE_TEST_CASE(noop, TESTER) try {
    produce_blocks(2);
    create_accounts( {N(noop), N(alice)} );
@@ -2144,4 +2189,146 @@ BOOST_FIXTURE_TEST_CASE(weighted_net_usage_tests, tester ) try {
 } FC_LOG_AND_RETHROW()
 #endif
 
+static boost::filesystem::path cache_entry_file( const boost::filesystem::path& dir, const digest_type& code_hash ) {
+   for( auto& f : boost::filesystem::directory_iterator( dir ) ) {
+      if( f.path().filename().string().find( code_hash.str() ) == 0 )
+         return f.path();
+   }
+   BOOST_FAIL( "no cache entry for " + code_hash.str() );
+   return {};
+}
+
+BOOST_AUTO_TEST_CASE( wasm_module_cache_round_trip ) try {
+   fc::temp_directory tempdir;
+   wasm_module_cache cache( tempdir.path() / "cache", 1, "build", 0 );
+
+   const auto code_hash = fc::sha256::hash( std::string("code") );
+   BOOST_CHECK( !cache.get( code_hash, 0, 0 ) );
+
+   cache.put( code_hash, 0, 0, wasm_module_cache::entry{ {1, 2, 3}, {4, 5} } );
+   auto e = cache.get( code_hash, 0, 0 );
+   BOOST_REQUIRE( e );
+   BOOST_CHECK( e->code == std::vector<uint8_t>({1, 2, 3}) );
+   BOOST_CHECK( e->initial_memory == std::vector<uint8_t>({4, 5}) );
+
+   // entries are specific to the vm version and to the runtime they were prepared for
+   BOOST_CHECK( !cache.get( code_hash, 0, 1 ) );
+   BOOST_CHECK( !wasm_module_cache( tempdir.path() / "cache", 2, "build", 0 ).get( code_hash, 0, 0 ) );
+   BOOST_CHECK( cache.get( code_hash, 0, 0 ) );
+
+   // a damaged entry is discarded rather than used
+   for( auto& f : boost::filesystem::directory_iterator( tempdir.path() / "cache" ) ) {
+      std::fstream out( f.path().generic_string(), std::ios::in | std::ios::out | std::ios::binary );
+      out.seekp( -1, std::ios::end );
+      out.put( 0x7f );
+   }
+   BOOST_CHECK( !cache.get( code_hash, 0, 0 ) );
+   BOOST_CHECK( boost::filesystem::is_empty( tempdir.path() / "cache" ) );
+   BOOST_CHECK_EQUAL( cache.size(), 0u );
+
+   // and to the build, whose injection passes and codegen may differ
+   cache.put( code_hash, 0, 0, wasm_module_cache::entry{ {1, 2, 3}, {4, 5} } );
+   BOOST_CHECK( !wasm_module_cache( tempdir.path() / "cache", 1, "other build", 0 ).get( code_hash, 0, 0 ) );
+   BOOST_CHECK( !cache.get( code_hash, 0, 0 ) );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( wasm_module_cache_eviction ) try {
+   fc::temp_directory tempdir;
+   const auto dir = tempdir.path() / "cache";
+   const auto hash_of = []( int i ) { return fc::sha256::hash( "code" + std::to_string(i) ); };
+   const wasm_module_cache::entry e{ std::vector<uint8_t>( 1000, 1 ), {} };
+
+   uint64_t entry_size = 0;
+   {
+      wasm_module_cache sizing( tempdir.path() / "sizing", 1, "build", 0 );
+      sizing.put( hash_of( 0 ), 0, 0, e );
+      entry_size = sizing.size();
+   }
+
+   // room for two entries, the least recently used goes when a third is put
+   wasm_module_cache cache( dir, 1, "build", 2 * entry_size );
+   cache.put( hash_of( 1 ), 0, 0, e );
+   cache.put( hash_of( 2 ), 0, 0, e );
+   BOOST_CHECK_EQUAL( cache.size(), 2 * entry_size );
+   // the modification times order the entries, and have a resolution of a second
+   boost::filesystem::last_write_time( cache_entry_file( dir, hash_of( 1 ) ), std::time( nullptr ) - 10 );
+   cache.put( hash_of( 3 ), 0, 0, e );
+   BOOST_CHECK_EQUAL( cache.size(), 2 * entry_size );
+   BOOST_CHECK( !cache.get( hash_of( 1 ), 0, 0 ) );
+   BOOST_CHECK( cache.get( hash_of( 2 ), 0, 0 ) );
+   BOOST_CHECK( cache.get( hash_of( 3 ), 0, 0 ) );
+
+   // a smaller limit is applied on the next start
+   BOOST_CHECK_EQUAL( wasm_module_cache( dir, 1, "build", entry_size ).size(), entry_size );
+
+   // entries of codes no longer referenced are pruned
+   wasm_module_cache reopened( dir, 1, "build", 0 );
+   reopened.put( hash_of( 4 ), 0, 0, e );
+   reopened.prune( [&]( const digest_type& code_hash, uint8_t, uint8_t ) { return code_hash == hash_of( 4 ); } );
+   BOOST_CHECK_EQUAL( reopened.size(), entry_size );
+   BOOST_CHECK( reopened.get( hash_of( 4 ), 0, 0 ) );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( wasm_module_cache_survives_restart ) try {
+   fc::temp_directory tempdir;
+   auto conf_genesis = tester::default_config( tempdir );
+   conf_genesis.first.persistent_wasm_module_cache = true;
+   tester chain( conf_genesis.first, conf_genesis.second );
+
+   chain.create_accounts( {N(asserter)} );
+   chain.set_code( N(asserter), contracts::asserter_wasm() );
+   chain.produce_block();
+
+   auto push_assert = [&chain]( uint32_t nonce ) {
+      signed_transaction trx;
+      trx.actions.emplace_back( vector<permission_level>{{N(asserter),config::active_name}},
+                                assertdef {1, "Should Not Assert! " + std::to_string(nonce)} );
+      chain.set_transaction_headers( trx );
+      trx.sign( chain.get_private_key( N(asserter), "active" ), chain.control->get_chain_id() );
+      chain.push_transaction( trx );
+      chain.produce_block();
+   };
+
+   const auto cache_dir = chain.get_config().state_dir / "wasm_module_cache";
+   push_assert( 1 );
+   BOOST_REQUIRE( boost::filesystem::exists( cache_dir ) );
+   BOOST_REQUIRE( !boost::filesystem::is_empty( cache_dir ) );
+
+   chain.close();
+   chain.open();
+   push_assert( 2 );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( wasm_instantiation_cache_budget ) try {
+   fc::temp_directory tempdir;
+   auto conf_genesis = tester::default_config( tempdir );
+   conf_genesis.first.wasm_instantiation_cache_size = 1; // any module is over budget on its own
+   tester chain( conf_genesis.first, conf_genesis.second );
+
+   chain.create_accounts( {N(payloadless), N(noop)} );
+   chain.produce_block();
+   chain.set_code( N(payloadless), contracts::payloadless_wasm() );
+   chain.set_abi( N(payloadless), contracts::payloadless_abi().data() );
+   chain.set_code( N(noop), contracts::noop_wasm() );
+   chain.set_abi( N(noop), contracts::noop_abi().data() );
+   chain.produce_block();
+
+   auto& wasmif = chain.control->get_wasm_interface();
+   const auto before = wasmif.get_cache_stats();
+
+   chain.push_action( N(payloadless), N(doit), N(payloadless), mutable_variant_object() );
+   chain.produce_block();
+   chain.push_action( N(noop), N(anyaction), N(noop), mutable_variant_object()
+                      ("from", "noop")("type", "some type")("data", "some data goes here") );
+   chain.produce_block();
+   chain.push_action( N(payloadless), N(doit), N(payloadless), mutable_variant_object() );
+   chain.produce_block();
+
+   // the most recently used module is always kept, the other one is evicted each time
+   const auto after = wasmif.get_cache_stats();
+   BOOST_CHECK_EQUAL( after.misses - before.misses, 3u );
+   BOOST_CHECK_EQUAL( after.evictions - before.evictions, 2u );
+   BOOST_CHECK_GT( after.instantiated_bytes, 0u );
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()